@@ -103,8 +103,8 @@ IMPLEMENT_ASN1_FUNCTIONS(OTHER_INFO)
 ASN1_SEQUENCE(CMC_STATUS_INFO) = {
 	ASN1_SIMPLE(CMC_STATUS_INFO, cMCStatusInfo, ASN1_INTEGER),
 	ASN1_SEQUENCE_OF(CMC_STATUS_INFO, bodyList, ASN1_INTEGER),
-	ASN1_OPT(CMC_STATUS_INFO_EX, statusString, ASN1_UTF8STRING),
-	ASN1_SIMPLE(CMC_STATUS_INFO_EX, otherInfo, OTHER_INFO)
+	ASN1_OPT(CMC_STATUS_INFO, statusString, ASN1_UTF8STRING),
+	ASN1_OPT(CMC_STATUS_INFO, otherInfo, OTHER_INFO)
 } ASN1_SEQUENCE_END(CMC_STATUS_INFO)
 
 IMPLEMENT_ASN1_FUNCTIONS(CMC_STATUS_INFO)
@@ -338,12 +338,14 @@ IMPLEMENT_ASN1_FUNCTIONS(X509_POP)
 ASN1_SEQUENCE(CERT_REQ_MSG) = {
 	ASN1_SIMPLE(CERT_REQ_MSG, certReq, X509_REQ ),
 	ASN1_OPT(CERT_REQ_MSG, pop, X509_POP ),
-	ASN1_SEQUENCE_OF_OPT(CERT_REQ_MSG, certReq, X509_REQ )
+	ASN1_SEQUENCE_OF_OPT(CERT_REQ_MSG, regInfo, X509_ATTRIBUTE )
 } ASN1_SEQUENCE_END(CERT_REQ_MSG)
 
 IMPLEMENT_ASN1_FUNCTIONS(CERT_REQ_MSG)
 
 /*
+   The CMC module uses IMPLICIT tags (RFC 5272)
+
    TaggedRequest ::= CHOICE {
 	tcr		[0] TaggedCertificationRequest,
 	crm		[1] CertReqMsg,
@@ -364,9 +366,13 @@ ASN1_SEQUENCE(OTHER_REQ_MSG) = {
 IMPLEMENT_ASN1_FUNCTIONS(OTHER_REQ_MSG)
 
 ASN1_CHOICE(TAGGED_REQUEST) = {
-	ASN1_EXP(TAGGED_REQUEST, value.tcr, TAGGED_CERTIFICATION_REQUEST, 0),
-	ASN1_EXP(TAGGED_REQUEST, value.crm, CERT_REQ_MSG, 1),
-	ASN1_EXP(TAGGED_REQUEST, value.orm, OTHER_REQ_MSG, 2)
+	ASN1_IMP(TAGGED_REQUEST, value.tcr, TAGGED_CERTIFICATION_REQUEST, 0),
+#ifdef PKI_CMC_CRMF
+	ASN1_IMP(TAGGED_REQUEST, value.crm, OSSL_CRMF_MSG, 1),
+#else
+	ASN1_IMP(TAGGED_REQUEST, value.crm, CERT_REQ_MSG, 1),
+#endif
+	ASN1_IMP(TAGGED_REQUEST, value.orm, OTHER_REQ_MSG, 2)
 } ASN1_CHOICE_END(TAGGED_REQUEST)
 
 IMPLEMENT_ASN1_FUNCTIONS(TAGGED_REQUEST)
@@ -381,10 +387,10 @@ IMPLEMENT_ASN1_FUNCTIONS(TAGGED_REQUEST)
 */
 
 ASN1_SEQUENCE(PKI_DATA) = {
-	 ASN1_EXP_SEQUENCE_OF_OPT(PKI_DATA, controlSequence, TAGGED_ATTRIBUTE, 0),
-	 ASN1_EXP_SEQUENCE_OF_OPT(PKI_DATA, reqSequence, TAGGED_REQUEST, 1),
-	 ASN1_EXP_SEQUENCE_OF_OPT(PKI_DATA, cmsSequence, TAGGED_CONTENT_INFO, 2),
-	 ASN1_EXP_SEQUENCE_OF_OPT(PKI_DATA, otherMsgSequence, OTHER_MSG, 3)
+	 ASN1_SEQUENCE_OF(PKI_DATA, controlSequence, TAGGED_ATTRIBUTE),
+	 ASN1_SEQUENCE_OF(PKI_DATA, reqSequence, TAGGED_REQUEST),
+	 ASN1_SEQUENCE_OF(PKI_DATA, cmsSequence, TAGGED_CONTENT_INFO),
+	 ASN1_SEQUENCE_OF(PKI_DATA, otherMsgSequence, OTHER_MSG)
 } ASN1_SEQUENCE_END(PKI_DATA)
 
 IMPLEMENT_ASN1_FUNCTIONS(PKI_DATA)
@@ -398,9 +404,9 @@ IMPLEMENT_ASN1_FUNCTIONS(PKI_DATA)
 */
 
 ASN1_SEQUENCE(RESPONSE_BODY) = {
-	 ASN1_EXP_SEQUENCE_OF_OPT(RESPONSE_BODY, controlSequence, TAGGED_ATTRIBUTE, 0),
-	 ASN1_EXP_SEQUENCE_OF_OPT(RESPONSE_BODY, cmsSequence, TAGGED_CONTENT_INFO, 1),
-	 ASN1_EXP_SEQUENCE_OF_OPT(RESPONSE_BODY, otherMsgSequence, OTHER_MSG, 2)
+	 ASN1_SEQUENCE_OF(RESPONSE_BODY, controlSequence, TAGGED_ATTRIBUTE),
+	 ASN1_SEQUENCE_OF(RESPONSE_BODY, cmsSequence, TAGGED_CONTENT_INFO),
+	 ASN1_SEQUENCE_OF(RESPONSE_BODY, otherMsgSequence, OTHER_MSG)
 } ASN1_SEQUENCE_END(RESPONSE_BODY)
 
 IMPLEMENT_ASN1_FUNCTIONS(RESPONSE_BODY)
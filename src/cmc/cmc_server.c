@@ -0,0 +1,816 @@
+/* CMC Full PKI Request processing (RFC 5272)
+ * (c) 2019 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ *
+ * This software is released under the GPL2 License included
+ * in the archive. You can not remove this copyright notice.
+ *
+ * The PKCS#10 requests are taken out of the decoded PKIData (no copies)
+ * and issued by a set of threads (the calling thread takes the first
+ * job, as in the bulk loader). The statuses and the certificates are
+ * kept in the order of the TaggedRequests and encoded in a single pass.
+ */
+
+#include <libpki/pki.h>
+
+struct pki_cmc_server_st {
+	/* CA credentials (wrappers around referenced values) */
+	PKI_X509_KEYPAIR *ca_key;
+	PKI_X509_CERT *ca_cert;
+
+	/* Issuance (the profile is a reference) */
+	PKI_X509_PROFILE *profile;
+	uint64_t validity;
+
+	/* Trusted signers of the requests (optional) */
+	X509_STORE *trusted;
+
+	PKI_CMC_SERVER_AUTH_CB auth_cb;
+	void *auth_ctx;
+
+	/* Threads for the issuance */
+	int threads;
+
+	PKI_CMC_SERVER_STATS stats;
+};
+
+/* A TaggedRequest and its outcome */
+typedef struct cmc_body_part_st {
+	long id;
+	PKI_X509_REQ *req;
+	PKI_X509_CERT *cert;
+	PKI_CMC_STATUS status;
+	PKI_CMC_FAIL fail;
+} CMC_BODY_PART;
+
+/* A slice of the TaggedRequests */
+typedef struct cmc_batch_job_st {
+	PKI_CMC_SERVER *srv;
+	const PKI_X509_CERT *signer;
+	CMC_BODY_PART *parts;
+	int first;
+	int num;
+} CMC_BATCH_JOB;
+
+// ==================
+// Helpers
+// ==================
+
+static void _count(uint64_t *counter, uint64_t val) {
+
+	__atomic_fetch_add(counter, val, __ATOMIC_RELAXED);
+}
+
+/* DER of a SignedData with the given eContentType */
+static PKI_MEM * _signed_data(const unsigned char *data, int size, int nid,
+		const PKI_X509_KEYPAIR *k, const PKI_X509_CERT *x, X509 * const *certs,
+		int num) {
+
+	CMS_ContentInfo *cms = NULL;
+	PKI_MEM *ret = NULL;
+	BIO *bio = NULL;
+	unsigned char *p = NULL;
+	int flags = CMS_BINARY | CMS_PARTIAL | CMS_NOSMIMECAP;
+	int len = 0, i = 0;
+
+	if ((bio = BIO_new_mem_buf(data, size)) == NULL
+			|| (cms = CMS_sign((X509 *) x->value, (EVP_PKEY *) k->value,
+				NULL, NULL, (unsigned int) flags)) == NULL
+			|| !CMS_set1_eContentType(cms, OBJ_nid2obj(nid))) goto end;
+
+	for (i = 0; i < num; i++) {
+		if (certs[i] && !CMS_add1_cert(cms, certs[i])) goto end;
+	}
+
+	if (!CMS_final(cms, bio, NULL, (unsigned int) flags)
+			|| (len = i2d_CMS_ContentInfo(cms, NULL)) <= 0
+			|| (ret = PKI_MEM_new((size_t) len)) == NULL) goto end;
+
+	p = ret->data;
+	i2d_CMS_ContentInfo(cms, &p);
+
+end:
+	if (cms) CMS_ContentInfo_free(cms);
+	if (bio) BIO_free(bio);
+	if (!ret) PKI_ERROR(PKI_ERR_X509_CMS_DATA_FINALIZE, NULL);
+
+	return ret;
+}
+
+/* Parses a SignedData and returns its eContent (when of the given type) */
+static CMS_ContentInfo * _signed_data_get(const PKI_MEM *mem, int nid,
+		ASN1_OCTET_STRING **content) {
+
+	CMS_ContentInfo *cms = NULL;
+	ASN1_OCTET_STRING **pos = NULL;
+	const unsigned char *p = NULL;
+
+	if (!mem || !mem->data || mem->size == 0) return NULL;
+
+	p = mem->data;
+	if ((cms = d2i_CMS_ContentInfo(NULL, &p, (long) mem->size)) == NULL) return NULL;
+
+	if (OBJ_obj2nid(CMS_get0_type(cms)) != NID_pkcs7_signed
+			|| OBJ_obj2nid(CMS_get0_eContentType(cms)) != nid
+			|| (pos = CMS_get0_content(cms)) == NULL || *pos == NULL) {
+		PKI_ERROR(PKI_ERR_X509_CMS_WRONG_TYPE, NULL);
+		CMS_ContentInfo_free(cms);
+		return NULL;
+	}
+
+	*content = *pos;
+
+	return cms;
+}
+
+/* CMCStatusInfo control for one body part */
+static TAGGED_ATTRIBUTE * _status_info(long ctrl_id, const CMC_BODY_PART *part) {
+
+	TAGGED_ATTRIBUTE *ret = NULL;
+	CMC_STATUS_INFO *si = NULL;
+	ASN1_INTEGER *id = NULL;
+	ASN1_TYPE *val = NULL;
+
+	if ((si = CMC_STATUS_INFO_new()) == NULL
+			|| !ASN1_INTEGER_set(si->cMCStatusInfo, part->status)
+			|| (id = ASN1_INTEGER_new()) == NULL || !ASN1_INTEGER_set(id, part->id)
+			|| !sk_ASN1_INTEGER_push(si->bodyList, id)) goto err;
+	id = NULL;
+
+	if (part->fail != PKI_CMC_FAIL_NONE) {
+		if ((si->otherInfo = OTHER_INFO_new()) == NULL
+				|| (si->otherInfo->value.failInfo = ASN1_INTEGER_new()) == NULL
+				|| !ASN1_INTEGER_set(si->otherInfo->value.failInfo, part->fail))
+			goto err;
+		si->otherInfo->type = 0;
+	}
+
+	if ((val = ASN1_TYPE_pack_sequence(ASN1_ITEM_rptr(CMC_STATUS_INFO), si, NULL)) == NULL
+			|| (ret = TAGGED_ATTRIBUTE_new()) == NULL
+			|| !ASN1_INTEGER_set(ret->bodyPartID, ctrl_id)
+			|| !sk_ASN1_TYPE_push(ret->attrValues, val)) goto err;
+
+	ASN1_OBJECT_free(ret->attrType);
+	ret->attrType = OBJ_nid2obj(NID_id_cmc_statusInfo);
+
+	CMC_STATUS_INFO_free(si);
+
+	return ret;
+
+err:
+	if (ret) TAGGED_ATTRIBUTE_free(ret);
+	if (val) ASN1_TYPE_free(val);
+	if (id) ASN1_INTEGER_free(id);
+	if (si) CMC_STATUS_INFO_free(si);
+
+	return NULL;
+}
+
+/* Proof of possession, authorization and issuance of one body part */
+static void _issue(PKI_CMC_SERVER *srv, const PKI_X509_CERT *signer,
+		CMC_BODY_PART *part) {
+
+	X509_REQ *val = (X509_REQ *) part->req->value;
+	EVP_PKEY *pkey = NULL;
+
+	part->status = PKI_CMC_STATUS_FAILED;
+
+	if ((pkey = X509_REQ_get0_pubkey(val)) == NULL || X509_REQ_verify(val, pkey) != 1) {
+		PKI_DEBUG("CMC: invalid PKCS#10 signature (bodyPartID %ld)", part->id);
+		part->fail = PKI_CMC_FAIL_POP_FAILED;
+		return;
+	}
+
+	if (srv->auth_cb && srv->auth_cb(part->req, signer, part->id,
+			srv->auth_ctx) != PKI_OK) {
+		part->fail = PKI_CMC_FAIL_BAD_REQUEST;
+		return;
+	}
+
+	if ((part->cert = PKI_X509_CERT_new(srv->ca_cert, srv->ca_key, part->req,
+			NULL, NULL, srv->validity, srv->profile, NULL, NULL, NULL)) == NULL) {
+		part->fail = PKI_CMC_FAIL_INTERNAL_CA_ERROR;
+		return;
+	}
+
+	part->status = PKI_CMC_STATUS_SUCCESS;
+	part->fail = PKI_CMC_FAIL_NONE;
+}
+
+static void * _batch_job(void *arg) {
+
+	CMC_BATCH_JOB *job = arg;
+	int i = 0;
+
+	for (i = job->first; i < job->first + job->num; i++) {
+		if (job->parts[i].req) _issue(job->srv, job->signer, &job->parts[i]);
+	}
+
+	return NULL;
+}
+
+/* Issues the PKCS#10 body parts with multiple threads */
+static int _issue_all(PKI_CMC_SERVER *srv, const PKI_X509_CERT *signer,
+		CMC_BODY_PART *parts, int num) {
+
+	CMC_BATCH_JOB *jobs = NULL;
+	PKI_THREAD **th = NULL;
+	int threads = 0, per_job = 0, first = 0, n = 0, k = 0;
+
+	if ((threads = srv->threads) <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	if (threads > (num + PKI_CMC_SERVER_BATCH_MIN_JOB - 1) / PKI_CMC_SERVER_BATCH_MIN_JOB)
+		threads = (num + PKI_CMC_SERVER_BATCH_MIN_JOB - 1) / PKI_CMC_SERVER_BATCH_MIN_JOB;
+
+	if ((jobs = PKI_Malloc((size_t) threads * sizeof(CMC_BATCH_JOB))) == NULL
+			|| (th = PKI_Malloc((size_t) threads * sizeof(PKI_THREAD *))) == NULL) {
+		if (jobs) PKI_Free(jobs);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	per_job = (num + threads - 1) / threads;
+
+	for (n = 0, first = 0; first < num; n++, first += per_job) {
+		jobs[n].srv = srv;
+		jobs[n].signer = signer;
+		jobs[n].parts = parts;
+		jobs[n].first = first;
+		jobs[n].num = (num - first < per_job ? num - first : per_job);
+	}
+
+	// The calling thread takes the first job
+	for (k = 1; k < n; k++) th[k] = PKI_THREAD_new(_batch_job, &jobs[k]);
+	_batch_job(&jobs[0]);
+
+	for (k = 1; k < n; k++) {
+		if (th[k]) {
+			PKI_THREAD_join(th[k], NULL);
+			PKI_Free(th[k]);
+		} else {
+			// Could not start the thread, runs the job here
+			_batch_job(&jobs[k]);
+		}
+	}
+
+	PKI_Free(th);
+	PKI_Free(jobs);
+
+	return PKI_OK;
+}
+
+/* Takes the TaggedRequests out of the PKIData */
+static CMC_BODY_PART * _body_parts(PKI_DATA *data, int *num) {
+
+	CMC_BODY_PART *ret = NULL;
+	TAGGED_REQUEST *tr = NULL;
+	TAGGED_CERTIFICATION_REQUEST *tcr = NULL;
+	int i = 0, n = 0;
+
+	*num = 0;
+
+	if ((n = sk_TAGGED_REQUEST_num(data->reqSequence)) <= 0) return NULL;
+
+	if (n > PKI_CMC_SERVER_BATCH_MAX) {
+		PKI_ERROR(PKI_ERR_PARAM_RANGE, "Too many requests (%d)", n);
+		return NULL;
+	}
+
+	if ((ret = PKI_Malloc((size_t) n * sizeof(CMC_BODY_PART))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	for (i = 0; i < n; i++) {
+
+		tr = sk_TAGGED_REQUEST_value(data->reqSequence, i);
+
+		ret[*num].status = PKI_CMC_STATUS_NOSUPPORT;
+		ret[*num].fail = PKI_CMC_FAIL_NONE;
+
+		switch (tr->type) {
+
+			case 0:
+				tcr = tr->value.tcr;
+				ret[*num].id = ASN1_INTEGER_get(tcr->bodyPartID);
+				if ((ret[*num].req = PKI_X509_new_value(PKI_DATATYPE_X509_REQ,
+						tcr->certificationRequest, NULL)) == NULL) {
+					ret[*num].status = PKI_CMC_STATUS_FAILED;
+					ret[*num].fail = PKI_CMC_FAIL_INTERNAL_CA_ERROR;
+					break;
+				}
+				// Now owned by the wrapper
+				tcr->certificationRequest = NULL;
+				break;
+
+			case 2:
+				ret[*num].id = ASN1_INTEGER_get(tr->value.orm->bodyPartID);
+				break;
+
+			default:
+				PKI_DEBUG("CMC: CRMF requests are not supported");
+#ifdef PKI_CMC_CRMF
+				// The certReqId is the bodyPartID of a CRMF request
+				ret[*num].id = OSSL_CRMF_MSG_get_certReqId(tr->value.crm);
+				break;
+#else
+				// The CertReqMsg of this module carries no bodyPartID
+				continue;
+#endif
+		}
+
+		(*num)++;
+	}
+
+	return ret;
+}
+
+/* Signature of the Full PKI Request, returns the signer */
+static PKI_X509_CERT * _verify(PKI_CMC_SERVER *srv, CMS_ContentInfo *cms) {
+
+	PKI_X509_CERT *ret = NULL;
+	STACK_OF(X509) *signers = NULL;
+	X509 *x = NULL;
+	unsigned int flags = CMS_BINARY;
+
+	if (!srv->trusted) flags |= CMS_NO_SIGNER_CERT_VERIFY;
+
+	if (CMS_verify(cms, NULL, srv->trusted, NULL, NULL, flags) != 1) {
+		PKI_DEBUG("CMC: invalid Full PKI Request signature");
+		return NULL;
+	}
+
+	if ((signers = CMS_get0_signers(cms)) == NULL
+			|| (x = sk_X509_value(signers, 0)) == NULL || !X509_up_ref(x)) goto end;
+
+	if ((ret = PKI_X509_new_value(PKI_DATATYPE_X509_CERT, x, NULL)) == NULL) X509_free(x);
+
+end:
+	if (signers) sk_X509_free(signers);
+
+	return ret;
+}
+
+/* Full PKI Response with the statuses and the issued certificates */
+static PKI_MEM * _response(PKI_CMC_SERVER *srv, const CMC_BODY_PART *parts, int num) {
+
+	RESPONSE_BODY *body = NULL;
+	TAGGED_ATTRIBUTE *attr = NULL;
+	PKI_MEM *ret = NULL;
+	X509 **certs = NULL;
+	unsigned char *der = NULL;
+	long ctrl_id = 0;
+	int len = 0, i = 0, n = 0;
+
+	if ((body = RESPONSE_BODY_new()) == NULL
+			|| (num > 0 && (certs = PKI_Malloc((size_t) num * sizeof(X509 *))) == NULL)) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		goto end;
+	}
+
+	// The controls take bodyPartIDs after the ones of the request
+	for (i = 0; i < num; i++) if (parts[i].id > ctrl_id) ctrl_id = parts[i].id;
+
+	for (i = 0; i < num; i++) {
+		if ((attr = _status_info(++ctrl_id, &parts[i])) == NULL
+				|| !sk_TAGGED_ATTRIBUTE_push(body->controlSequence, attr)) {
+			if (attr) TAGGED_ATTRIBUTE_free(attr);
+			PKI_ERROR(PKI_ERR_DATA_ASN1_ENCODING, NULL);
+			goto end;
+		}
+		if (parts[i].cert) certs[n++] = (X509 *) parts[i].cert->value;
+	}
+
+	if ((len = i2d_RESPONSE_BODY(body, &der)) <= 0) {
+		PKI_ERROR(PKI_ERR_DATA_ASN1_ENCODING, NULL);
+		goto end;
+	}
+
+	ret = _signed_data(der, len, NID_id_cct_PKIResponse, srv->ca_key,
+		srv->ca_cert, certs, n);
+
+end:
+	if (der) OPENSSL_free(der);
+	if (certs) PKI_Free(certs);
+	if (body) RESPONSE_BODY_free(body);
+
+	return ret;
+}
+
+// ==================
+// Server
+// ==================
+
+/*! \brief Returns a new (empty) CMC server engine */
+
+PKI_CMC_SERVER * PKI_CMC_SERVER_new(void) {
+
+	PKI_CMC_SERVER *srv = NULL;
+
+	if ((srv = calloc(1, sizeof(PKI_CMC_SERVER))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	srv->validity = PKI_CMC_SERVER_VALIDITY;
+
+	return srv;
+}
+
+/*! \brief Frees the memory associated with a PKI_CMC_SERVER */
+
+void PKI_CMC_SERVER_free(PKI_CMC_SERVER *srv) {
+
+	if (!srv) return;
+
+	if (srv->ca_key) PKI_X509_KEYPAIR_free(srv->ca_key);
+	if (srv->ca_cert) PKI_X509_CERT_free(srv->ca_cert);
+	if (srv->trusted) X509_STORE_free(srv->trusted);
+
+	free(srv);
+}
+
+/*! \brief Sets the CA keypair and certificate used to issue the
+ *         certificates and to sign the responses */
+
+int PKI_CMC_SERVER_set_ca(PKI_CMC_SERVER *srv, PKI_X509_KEYPAIR *k,
+			  PKI_X509_CERT *x) {
+
+	PKI_X509_KEYPAIR *ca_key = NULL;
+	PKI_X509_CERT *ca_cert = NULL;
+
+	if (!srv || !k || !k->value || !x || !x->value)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	// The values are shared with the caller's objects
+	EVP_PKEY_up_ref((EVP_PKEY *) k->value);
+	X509_up_ref((X509 *) x->value);
+
+	if ((ca_key = PKI_X509_new_value(PKI_DATATYPE_X509_KEYPAIR, k->value, NULL)) == NULL
+			|| (ca_cert = PKI_X509_new_value(PKI_DATATYPE_X509_CERT, x->value, NULL)) == NULL) {
+		if (ca_key) PKI_X509_KEYPAIR_free(ca_key);
+		else EVP_PKEY_free((EVP_PKEY *) k->value);
+		X509_free((X509 *) x->value);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	if (srv->ca_key) PKI_X509_KEYPAIR_free(srv->ca_key);
+	if (srv->ca_cert) PKI_X509_CERT_free(srv->ca_cert);
+
+	srv->ca_key = ca_key;
+	srv->ca_cert = ca_cert;
+
+	return PKI_OK;
+}
+
+/*! \brief Sets the profile (must outlive the server) and the validity
+ *         (secs, 0 for the default) of the issued certificates */
+
+int PKI_CMC_SERVER_set_profile(PKI_CMC_SERVER *srv, PKI_X509_PROFILE *profile,
+			       uint64_t validity) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->profile = profile;
+	srv->validity = validity > 0 ? validity : PKI_CMC_SERVER_VALIDITY;
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Sets the certificates the signers of the requests must chain
+ *        up to. Without trusted certificates only the signature of the
+ *        requests is checked (the callback authorizes the signers).
+ */
+
+int PKI_CMC_SERVER_set_trusted(PKI_CMC_SERVER *srv, PKI_X509_CERT_STACK *trusted) {
+
+	PKI_X509_CERT *x = NULL;
+	X509_STORE *store = NULL;
+	int i = 0;
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (trusted && PKI_STACK_X509_CERT_elements(trusted) > 0) {
+
+		if ((store = X509_STORE_new()) == NULL)
+			return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+		for (i = 0; i < PKI_STACK_X509_CERT_elements(trusted); i++) {
+			if ((x = PKI_STACK_X509_CERT_get_num(trusted, i)) != NULL && x->value
+					&& !X509_STORE_add_cert(store, (X509 *) x->value)) {
+				X509_STORE_free(store);
+				return PKI_ERROR(PKI_ERR_GENERAL, "Can not add a trusted certificate");
+			}
+		}
+	}
+
+	if (srv->trusted) X509_STORE_free(srv->trusted);
+	srv->trusted = store;
+
+	return PKI_OK;
+}
+
+/*! \brief Sets the callback that authorizes the requests */
+
+int PKI_CMC_SERVER_set_auth_cb(PKI_CMC_SERVER *srv, PKI_CMC_SERVER_AUTH_CB cb,
+			       void *ctx) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->auth_cb = cb;
+	srv->auth_ctx = ctx;
+
+	return PKI_OK;
+}
+
+/*! \brief Sets the number of issuing threads (0 for the number of CPUs) */
+
+int PKI_CMC_SERVER_set_threads(PKI_CMC_SERVER *srv, int threads) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->threads = threads > 0 ? threads : 0;
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Processes a (DER) Full PKI Request and returns the (DER) Full
+ *        PKI Response. When the message check fails, every body part is
+ *        answered with badMessageCheck. NULL is returned for the messages
+ *        that can not be decoded.
+ */
+
+PKI_MEM * PKI_CMC_SERVER_process(PKI_CMC_SERVER *srv, const PKI_MEM *req) {
+
+	CMS_ContentInfo *cms = NULL;
+	ASN1_OCTET_STRING *content = NULL;
+	PKI_DATA *data = NULL;
+	PKI_X509_CERT *signer = NULL;
+	CMC_BODY_PART *parts = NULL;
+	PKI_MEM *ret = NULL;
+	const unsigned char *p = NULL;
+	int num = 0, i = 0, k = 0, bad = 1;
+
+	if (!srv || !srv->ca_key || !req) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	_count(&srv->stats.requests, 1);
+
+	if ((cms = _signed_data_get(req, NID_id_cct_PKIData, &content)) == NULL) goto end;
+
+	p = content->data;
+	if ((data = d2i_PKI_DATA(NULL, &p, content->length)) == NULL) {
+		PKI_ERROR(PKI_ERR_DATA_ASN1_ENCODING, "Can not decode the PKIData");
+		goto end;
+	}
+
+	if ((parts = _body_parts(data, &num)) == NULL
+			&& sk_TAGGED_REQUEST_num(data->reqSequence) > 0) goto end;
+
+	if ((signer = _verify(srv, cms)) == NULL) {
+		// Nothing is issued, every body part reports the failure
+		if (num == 0) goto end;
+		for (i = 0; i < num; i++) {
+			parts[i].status = PKI_CMC_STATUS_FAILED;
+			parts[i].fail = PKI_CMC_FAIL_BAD_MESSAGE_CHECK;
+		}
+		_count(&srv->stats.rejected, (uint64_t) num);
+	} else {
+		bad = 0;
+		if (num > 0 && _issue_all(srv, signer, parts, num) != PKI_OK) goto end;
+		for (i = 0; i < num; i++) if (parts[i].cert) k++;
+		_count(&srv->stats.issued, (uint64_t) k);
+		_count(&srv->stats.rejected, (uint64_t) (num - k));
+	}
+
+	ret = _response(srv, parts, num);
+
+end:
+	if (bad) _count(&srv->stats.bad_messages, 1);
+	for (i = 0; parts && i < num; i++) {
+		if (parts[i].req) PKI_X509_REQ_free(parts[i].req);
+		if (parts[i].cert) PKI_X509_CERT_free(parts[i].cert);
+	}
+	if (parts) PKI_Free(parts);
+	if (signer) PKI_X509_CERT_free(signer);
+	if (data) PKI_DATA_free(data);
+	if (cms) CMS_ContentInfo_free(cms);
+
+	return ret;
+}
+
+/*! \brief Copies the server counters */
+
+int PKI_CMC_SERVER_get_stats(const PKI_CMC_SERVER *srv, PKI_CMC_SERVER_STATS *stats) {
+
+	if (!srv || !stats) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	stats->requests = __atomic_load_n(&srv->stats.requests, __ATOMIC_RELAXED);
+	stats->bad_messages = __atomic_load_n(&srv->stats.bad_messages, __ATOMIC_RELAXED);
+	stats->issued = __atomic_load_n(&srv->stats.issued, __ATOMIC_RELAXED);
+	stats->rejected = __atomic_load_n(&srv->stats.rejected, __ATOMIC_RELAXED);
+
+	return PKI_OK;
+}
+
+/*! \brief Resets the server counters */
+
+void PKI_CMC_SERVER_reset_stats(PKI_CMC_SERVER *srv) {
+
+	if (!srv) return;
+
+	__atomic_store_n(&srv->stats.requests, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&srv->stats.bad_messages, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&srv->stats.issued, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&srv->stats.rejected, 0, __ATOMIC_RELAXED);
+}
+
+static int _cmc_http_handler(const PKI_HTTP *req, PKI_HTTP *resp, void *ctx) {
+
+	PKI_CMC_SERVER *srv = ctx;
+
+	if (req->method != PKI_HTTP_METHOD_POST) {
+		resp->code = 405;
+		return PKI_ERR;
+	}
+
+	if (!req->body || (resp->body = PKI_CMC_SERVER_process(srv, req->body)) == NULL) {
+		resp->code = 400;
+		return PKI_ERR;
+	}
+
+	resp->code = 200;
+	resp->type = strdup(PKI_CMC_SERVER_TYPE_RESPONSE);
+
+	return PKI_OK;
+}
+
+/*! \brief Serves the Full PKI Requests (POST, RFC 5273) under the path
+ *         ("/" if NULL) of an HTTP server */
+
+int PKI_CMC_SERVER_attach(PKI_CMC_SERVER *srv, PKI_HTTP_SERVER *http,
+			  const char *path) {
+
+	if (!srv || !http) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	return PKI_HTTP_SERVER_add_handler(http, path ? path : "/",
+		_cmc_http_handler, srv);
+}
+
+// ==================
+// Client
+// ==================
+
+/*! \brief Returns a (DER) Full PKI Request for the PKCS#10 requests
+ *         (bodyPartIDs from 1) signed with the given key and certificate */
+
+PKI_MEM * PKI_CMC_REQUEST_new(PKI_X509_REQ_STACK *reqs, const PKI_X509_KEYPAIR *k,
+			      const PKI_X509_CERT *x) {
+
+	PKI_DATA *data = NULL;
+	TAGGED_REQUEST *tr = NULL;
+	PKI_X509_REQ *req = NULL;
+	PKI_MEM *ret = NULL;
+	unsigned char *der = NULL;
+	int len = 0, i = 0;
+
+	if (!reqs || !k || !k->value || !x || !x->value) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((data = PKI_DATA_new()) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	for (i = 0; i < PKI_STACK_X509_REQ_elements(reqs); i++) {
+
+		if ((req = PKI_STACK_X509_REQ_get_num(reqs, i)) == NULL || !req->value) continue;
+
+		if ((tr = TAGGED_REQUEST_new()) == NULL
+				|| (tr->value.tcr = TAGGED_CERTIFICATION_REQUEST_new()) == NULL) {
+			if (tr) TAGGED_REQUEST_free(tr);
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			goto end;
+		}
+		tr->type = 0;
+
+		if (!sk_TAGGED_REQUEST_push(data->reqSequence, tr)) {
+			TAGGED_REQUEST_free(tr);
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			goto end;
+		}
+
+		X509_REQ_free(tr->value.tcr->certificationRequest);
+		if ((tr->value.tcr->certificationRequest = X509_REQ_dup((X509_REQ *) req->value)) == NULL
+				|| !ASN1_INTEGER_set(tr->value.tcr->bodyPartID, i + 1)) {
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			goto end;
+		}
+	}
+
+	if ((len = i2d_PKI_DATA(data, &der)) <= 0) {
+		PKI_ERROR(PKI_ERR_DATA_ASN1_ENCODING, NULL);
+		goto end;
+	}
+
+	ret = _signed_data(der, len, NID_id_cct_PKIData, k, x, NULL, 0);
+
+end:
+	if (der) OPENSSL_free(der);
+	if (data) PKI_DATA_free(data);
+
+	return ret;
+}
+
+/*!
+ * \brief Returns the status (and the failInfo, if any) of a body part
+ *        from a (DER) Full PKI Response. The signature of the response
+ *        is not checked here.
+ */
+
+PKI_CMC_STATUS PKI_CMC_RESPONSE_get_status(const PKI_MEM *resp, long body_part_id,
+					   PKI_CMC_FAIL *fail) {
+
+	CMS_ContentInfo *cms = NULL;
+	ASN1_OCTET_STRING *content = NULL;
+	RESPONSE_BODY *body = NULL;
+	TAGGED_ATTRIBUTE *attr = NULL;
+	CMC_STATUS_INFO *si = NULL;
+	PKI_CMC_STATUS ret = PKI_CMC_STATUS_UNKNOWN;
+	const unsigned char *p = NULL;
+	int i = 0, j = 0;
+
+	if (fail) *fail = PKI_CMC_FAIL_NONE;
+
+	if ((cms = _signed_data_get(resp, NID_id_cct_PKIResponse, &content)) == NULL)
+		return ret;
+
+	p = content->data;
+	if ((body = d2i_RESPONSE_BODY(NULL, &p, content->length)) == NULL) goto end;
+
+	for (i = 0; ret == PKI_CMC_STATUS_UNKNOWN
+			&& i < sk_TAGGED_ATTRIBUTE_num(body->controlSequence); i++) {
+
+		attr = sk_TAGGED_ATTRIBUTE_value(body->controlSequence, i);
+		if (OBJ_obj2nid(attr->attrType) != NID_id_cmc_statusInfo
+				|| sk_ASN1_TYPE_num(attr->attrValues) < 1) continue;
+
+		if ((si = ASN1_TYPE_unpack_sequence(ASN1_ITEM_rptr(CMC_STATUS_INFO),
+				sk_ASN1_TYPE_value(attr->attrValues, 0))) == NULL) continue;
+
+		for (j = 0; j < sk_ASN1_INTEGER_num(si->bodyList); j++) {
+			if (ASN1_INTEGER_get(sk_ASN1_INTEGER_value(si->bodyList, j)) != body_part_id)
+				continue;
+			ret = (PKI_CMC_STATUS) ASN1_INTEGER_get(si->cMCStatusInfo);
+			if (fail && si->otherInfo && si->otherInfo->type == 0)
+				*fail = (PKI_CMC_FAIL) ASN1_INTEGER_get(si->otherInfo->value.failInfo);
+			break;
+		}
+
+		CMC_STATUS_INFO_free(si);
+	}
+
+end:
+	if (body) RESPONSE_BODY_free(body);
+	if (cms) CMS_ContentInfo_free(cms);
+
+	return ret;
+}
+
+/*! \brief Returns the certificates of a (DER) Full PKI Response (the
+ *         issued certificates and the CA certificate) */
+
+PKI_X509_CERT_STACK * PKI_CMC_RESPONSE_get_certs(const PKI_MEM *resp) {
+
+	CMS_ContentInfo *cms = NULL;
+	ASN1_OCTET_STRING *content = NULL;
+	STACK_OF(X509) *certs = NULL;
+	PKI_X509_CERT_STACK *ret = NULL;
+	PKI_X509_CERT *x = NULL;
+	X509 *val = NULL;
+
+	if ((cms = _signed_data_get(resp, NID_id_cct_PKIResponse, &content)) == NULL)
+		return NULL;
+
+	if ((certs = CMS_get1_certs(cms)) == NULL
+			|| (ret = PKI_STACK_X509_CERT_new()) == NULL) goto end;
+
+	while ((val = sk_X509_shift(certs)) != NULL) {
+		if ((x = PKI_X509_new_value(PKI_DATATYPE_X509_CERT, val, NULL)) == NULL) {
+			X509_free(val);
+			continue;
+		}
+		PKI_STACK_X509_CERT_push(ret, x);
+	}
+
+end:
+	if (certs) sk_X509_pop_free(certs, X509_free);
+	if (cms) CMS_ContentInfo_free(cms);
+
+	return ret;
+}
@@ -170,6 +170,8 @@ char *HSM_get_errdesc ( unsigned long err, const HSM *hsm )
  */
  
 const HSM *HSM_get_default( void ) {
+	// Loads the providers and the PQC/Composite methods
+	PKI_init_crypto_methods();
 	return HSM_OPENSSL_get_default();
 }
 
@@ -192,6 +194,9 @@ HSM *HSM_new( const char * const dir,
 
 	PKI_init_all();
 
+	// Loads the providers and the PQC/Composite methods
+	PKI_init_crypto_methods();
+
 	if( !name ) {
 		/* If no name is passed, we generate a new software token */
 		return HSM_OPENSSL_new( NULL );
@@ -518,6 +523,9 @@ int PKI_X509_sign(PKI_X509               * x,
 	if (!x || !x->value || !key || !key->value ) 
 		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 	
+	// The signature changes the object's encoding
+	PKI_X509_CACHE_clear(x);
+
 	// Extracts the internal value
 	pkey = PKI_X509_get_value(key);
 	if (!pkey) {
@@ -953,8 +961,8 @@ int PKI_X509_verify(const PKI_X509 *x, const PKI_X509_KEYPAIR *key ) {
 	// PKI_STRING *sig_value = NULL;
 	// PKI_X509_ALGOR_VALUE *alg = NULL;
 
-	// Make sure the library is initialized
-	PKI_init_all();
+	// Make sure the library (and the crypto methods) are initialized
+	PKI_init_crypto_methods();
 
 	// Input Checks
 	if (!x || !x->value || !key || !key->value) {
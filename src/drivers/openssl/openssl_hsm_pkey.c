@@ -135,6 +135,17 @@ int _pki_rand_seed( void ) {
     return(1);
 }
 
+static pthread_once_t _pki_rand_seed_once = PTHREAD_ONCE_INIT;
+
+static void _pki_rand_seed_init( void ) {
+#if OPENSSL_VERSION_NUMBER < 0x10101000L
+    if( _pki_rand_seed() == 0 ) {
+        /* Probably low level of randomization available */
+        PKI_log_debug("WARNING, low rand available!");
+    }
+#endif
+}
+
 PKI_RSA_KEY * _pki_rsakey_new( PKI_KEYPARAMS *kp ) {
 
     PKI_RSA_KEY *rsa = NULL;
@@ -747,10 +758,9 @@ PKI_X509_KEYPAIR *HSM_OPENSSL_X509_KEYPAIR_new(PKI_KEYPARAMS * kp,
     //     return NULL;
     // }
 
-    if( _pki_rand_seed() == 0 ) {
-        /* Probably low level of randomization available */
-        PKI_log_debug("WARNING, low rand available!");
-    }
+    // Seeds the PRNG once (newer versions of OpenSSL seed and
+    // reseed the DRBG automatically)
+    pthread_once(&_pki_rand_seed_once, _pki_rand_seed_init);
 
     switch (type) {
 
@@ -0,0 +1,893 @@
+/*
+ * OpenCA EST - Server side engine (RFC 7030)
+ * (c) 2019 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ *
+ * The CA certificates response is encoded once when the CA is set. The
+ * enrollment responses are certs-only SignedData built directly around
+ * the issued X509 values, a bulkenroll is issued by a set of threads
+ * (the calling thread takes the first job, as in the bulk loader) and
+ * encoded in a single pass.
+ */
+
+#include <libpki/pki.h>
+
+struct pki_est_server_st {
+	/* CA credentials (wrappers around referenced values) */
+	PKI_X509_KEYPAIR *ca_key;
+	PKI_X509_CERT *ca_cert;
+
+	/* cacerts response (base64 certs-only) */
+	unsigned char *ca_certs;
+	size_t ca_certs_size;
+
+	/* Issuance (the profile is a reference) */
+	PKI_X509_PROFILE *profile;
+	uint64_t validity;
+
+	PKI_EST_SERVER_AUTH_CB auth_cb;
+	void *auth_ctx;
+
+	/* Server-side key generation */
+	PKI_KEYPAIR_POOL *pool;
+	PKI_SCHEME_ID scheme;
+	int bits;
+
+	/* Threads for the bulk enrollments */
+	int threads;
+
+	PKI_EST_SERVER_STATS stats;
+};
+
+/* A slice of a bulk enrollment */
+typedef struct est_batch_job_st {
+	PKI_EST_SERVER *srv;
+	const PKI_X509_CERT *peer;
+	PKI_X509_REQ **reqs;
+	PKI_X509_CERT **certs;
+	int first;
+	int num;
+} EST_BATCH_JOB;
+
+/* Header of the base64 encoded responses */
+static const char _est_cte[] = "Content-Transfer-Encoding: base64\r\n";
+
+static const char * _est_ops[PKI_EST_SERVER_OP_NUM] = {
+	"cacerts", "simpleenroll", "simplereenroll", "serverkeygen", "bulkenroll"
+};
+
+// ==================
+// Helpers
+// ==================
+
+static void _count(uint64_t *counter, uint64_t val) {
+
+	__atomic_fetch_add(counter, val, __ATOMIC_RELAXED);
+}
+
+/* Base64 (with line breaks) of a certs-only SignedData */
+static PKI_MEM * _certs_only(X509 * const *certs, int num) {
+
+	PKCS7 *p7 = NULL;
+	PKI_MEM *ret = NULL;
+	unsigned char *p = NULL;
+	int len = 0, i = 0;
+
+	if ((p7 = PKCS7_new()) == NULL || !PKCS7_set_type(p7, NID_pkcs7_signed)
+			|| !PKCS7_content_new(p7, NID_pkcs7_data)) goto end;
+
+	for (i = 0; i < num; i++) {
+		if (certs[i] && !PKCS7_add_certificate(p7, certs[i])) goto end;
+	}
+
+	if ((len = i2d_PKCS7(p7, NULL)) <= 0 || (ret = PKI_MEM_new((size_t) len)) == NULL)
+		goto end;
+
+	p = ret->data;
+	i2d_PKCS7(p7, &p);
+
+	if (PKI_MEM_encode(ret, PKI_DATA_FORMAT_B64, 1) != PKI_OK) {
+		PKI_MEM_free(ret);
+		ret = NULL;
+	}
+
+end:
+	if (p7) PKCS7_free(p7);
+	if (!ret) PKI_ERROR(PKI_ERR_X509_PKCS7_, NULL);
+
+	return ret;
+}
+
+/* Checks the request and asks the authorization callback */
+static int _authorize(PKI_EST_SERVER *srv, const PKI_X509_REQ *req,
+		const PKI_X509_CERT *peer, PKI_EST_SERVER_OP op) {
+
+	X509_REQ *val = NULL;
+	EVP_PKEY *pkey = NULL;
+
+	if (!req || (val = (X509_REQ *) req->value) == NULL) return PKI_ERR;
+
+	// Proof of possession (signature of the request)
+	if ((pkey = X509_REQ_get0_pubkey(val)) == NULL || X509_REQ_verify(val, pkey) != 1) {
+		PKI_DEBUG("EST: invalid PKCS#10 signature");
+		return PKI_ERR;
+	}
+
+	// Renewals must keep the subject of the authenticating certificate
+	if (op == PKI_EST_SERVER_OP_SIMPLEREENROLL) {
+		if (!peer || !peer->value || X509_NAME_cmp(X509_REQ_get_subject_name(val),
+				X509_get_subject_name((X509 *) peer->value)) != 0) {
+			PKI_DEBUG("EST: renewal subject does not match the client certificate");
+			return PKI_ERR;
+		}
+	}
+
+	if (srv->auth_cb && srv->auth_cb(req, peer, op, srv->auth_ctx) != PKI_OK)
+		return PKI_ERR;
+
+	return PKI_OK;
+}
+
+static PKI_X509_CERT * _issue(PKI_EST_SERVER *srv, const PKI_X509_REQ *req) {
+
+	return PKI_X509_CERT_new(srv->ca_cert, srv->ca_key, req, NULL, NULL,
+		srv->validity, srv->profile, NULL, NULL, NULL);
+}
+
+// ==================
+// Server
+// ==================
+
+/*! \brief Returns a new (empty) EST server engine */
+
+PKI_EST_SERVER * PKI_EST_SERVER_new(void) {
+
+	PKI_EST_SERVER *srv = NULL;
+
+	if ((srv = calloc(1, sizeof(PKI_EST_SERVER))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	srv->validity = PKI_EST_SERVER_VALIDITY;
+	srv->scheme = PKI_SCHEME_RSA;
+	srv->bits = 2048;
+
+	return srv;
+}
+
+/*! \brief Frees the memory associated with a PKI_EST_SERVER */
+
+void PKI_EST_SERVER_free(PKI_EST_SERVER *srv) {
+
+	if (!srv) return;
+
+	if (srv->ca_key) PKI_X509_KEYPAIR_free(srv->ca_key);
+	if (srv->ca_cert) PKI_X509_CERT_free(srv->ca_cert);
+	free(srv->ca_certs);
+
+	free(srv);
+}
+
+/*!
+ * \brief Sets the CA keypair and certificate used to issue the
+ *        certificates. The CA certificate and the chain (if any) are
+ *        returned for cacerts.
+ */
+
+int PKI_EST_SERVER_set_ca(PKI_EST_SERVER *srv, PKI_X509_KEYPAIR *k,
+			  PKI_X509_CERT *x, PKI_X509_CERT_STACK *chain) {
+
+	PKI_X509_KEYPAIR *ca_key = NULL;
+	PKI_X509_CERT *ca_cert = NULL, *c = NULL;
+	X509 **certs = NULL;
+	PKI_MEM *mem = NULL;
+	unsigned char *der = NULL;
+	size_t der_size = 0;
+	int num = 0, i = 0;
+
+	if (!srv || !k || !k->value || !x || !x->value)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	num = 1 + (chain ? PKI_STACK_X509_CERT_elements(chain) : 0);
+	if ((certs = calloc((size_t) num, sizeof(X509 *))) == NULL)
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+	certs[0] = (X509 *) x->value;
+	for (i = 1; i < num; i++) {
+		if ((c = PKI_STACK_X509_CERT_get_num(chain, i - 1)) != NULL)
+			certs[i] = (X509 *) c->value;
+	}
+
+	mem = _certs_only(certs, num);
+	free(certs);
+
+	if (!mem) return PKI_ERR;
+
+	// Long-lived copy (never from a request arena)
+	if ((der = malloc(mem->size)) == NULL) {
+		PKI_MEM_free(mem);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+	memcpy(der, mem->data, mem->size);
+	der_size = mem->size;
+	PKI_MEM_free(mem);
+
+	// The values are shared with the caller's objects
+	EVP_PKEY_up_ref((EVP_PKEY *) k->value);
+	X509_up_ref((X509 *) x->value);
+
+	if ((ca_key = PKI_X509_new_value(PKI_DATATYPE_X509_KEYPAIR, k->value, NULL)) == NULL
+			|| (ca_cert = PKI_X509_new_value(PKI_DATATYPE_X509_CERT, x->value, NULL)) == NULL) {
+		if (ca_key) PKI_X509_KEYPAIR_free(ca_key);
+		else EVP_PKEY_free((EVP_PKEY *) k->value);
+		X509_free((X509 *) x->value);
+		free(der);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	if (srv->ca_key) PKI_X509_KEYPAIR_free(srv->ca_key);
+	if (srv->ca_cert) PKI_X509_CERT_free(srv->ca_cert);
+	free(srv->ca_certs);
+
+	srv->ca_key = ca_key;
+	srv->ca_cert = ca_cert;
+
+	srv->ca_certs = der;
+	srv->ca_certs_size = der_size;
+
+	return PKI_OK;
+}
+
+/*! \brief Sets the profile (must outlive the server) and the validity
+ *         (secs, 0 for the default) of the issued certificates */
+
+int PKI_EST_SERVER_set_profile(PKI_EST_SERVER *srv, PKI_X509_PROFILE *profile,
+			       uint64_t validity) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->profile = profile;
+	srv->validity = validity > 0 ? validity : PKI_EST_SERVER_VALIDITY;
+
+	return PKI_OK;
+}
+
+/*! \brief Sets the callback that authorizes the requests */
+
+int PKI_EST_SERVER_set_auth_cb(PKI_EST_SERVER *srv, PKI_EST_SERVER_AUTH_CB cb,
+			       void *ctx) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->auth_cb = cb;
+	srv->auth_ctx = ctx;
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Sets the scheme and size of the server generated keys. When a
+ *        pool is given (and the scheme is configured in it) the keys are
+ *        taken from the pool, otherwise they are generated on request.
+ */
+
+int PKI_EST_SERVER_set_keygen(PKI_EST_SERVER *srv, PKI_KEYPAIR_POOL *pool,
+			      PKI_SCHEME_ID scheme, int bits) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->pool = pool;
+	srv->scheme = scheme;
+	srv->bits = bits;
+
+	return PKI_OK;
+}
+
+/*! \brief Sets the number of threads for the bulk enrollments (0 for the
+ *         number of CPUs) */
+
+int PKI_EST_SERVER_set_threads(PKI_EST_SERVER *srv, int threads) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->threads = threads > 0 ? threads : 0;
+
+	return PKI_OK;
+}
+
+// ==================
+// Operations
+// ==================
+
+/*! \brief Returns the cacerts response (base64 certs-only SignedData) */
+
+PKI_MEM * PKI_EST_SERVER_get_ca_certs(const PKI_EST_SERVER *srv) {
+
+	if (!srv || !srv->ca_certs) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	return PKI_MEM_new_data(srv->ca_certs_size, srv->ca_certs);
+}
+
+/*!
+ * \brief Issues a certificate for a simpleenroll (renew = 0) or a
+ *        simplereenroll (renew = 1) request. The peer is the TLS client
+ *        certificate (required for the renewals).
+ */
+
+PKI_X509_CERT * PKI_EST_SERVER_enroll(PKI_EST_SERVER *srv, const PKI_X509_REQ *req,
+				      const PKI_X509_CERT *peer, int renew) {
+
+	PKI_X509_CERT *ret = NULL;
+
+	if (!srv || !srv->ca_key || !req) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (_authorize(srv, req, peer, renew ? PKI_EST_SERVER_OP_SIMPLEREENROLL
+			: PKI_EST_SERVER_OP_SIMPLEENROLL) == PKI_OK)
+		ret = _issue(srv, req);
+
+	_count(ret ? &srv->stats.issued : &srv->stats.rejected, 1);
+
+	return ret;
+}
+
+/*!
+ * \brief Issues a certificate for a server generated key (serverkeygen).
+ *        The subject and the attributes are taken from the request, the
+ *        new keypair is returned in *key.
+ */
+
+PKI_X509_CERT * PKI_EST_SERVER_keygen(PKI_EST_SERVER *srv, const PKI_X509_REQ *req,
+				      const PKI_X509_CERT *peer, PKI_X509_KEYPAIR **key) {
+
+	PKI_X509_KEYPAIR *k = NULL;
+	PKI_X509_REQ *tmp = NULL;
+	X509_REQ *val = NULL;
+	PKI_X509_CERT *ret = NULL;
+
+	if (!srv || !srv->ca_key || !req || !key) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	*key = NULL;
+
+	if (_authorize(srv, req, peer, PKI_EST_SERVER_OP_SERVERKEYGEN) != PKI_OK) goto end;
+
+	// Pre-generated keys first
+	if (srv->pool) k = PKI_KEYPAIR_POOL_get(srv->pool, srv->scheme, srv->bits);
+	if (!k) k = PKI_X509_KEYPAIR_new(srv->scheme, srv->bits, NULL, NULL, NULL);
+	if (!k) goto end;
+
+	// Same request, with the generated public key
+	if ((val = X509_REQ_dup((X509_REQ *) req->value)) == NULL
+			|| !X509_REQ_set_pubkey(val, (EVP_PKEY *) k->value)
+			|| (tmp = PKI_X509_new_value(PKI_DATATYPE_X509_REQ, val, NULL)) == NULL) {
+		if (val) X509_REQ_free(val);
+		goto end;
+	}
+
+	ret = _issue(srv, tmp);
+
+end:
+	if (tmp) PKI_X509_REQ_free(tmp);
+
+	if (ret) *key = k;
+	else if (k) PKI_X509_KEYPAIR_free(k);
+
+	_count(ret ? &srv->stats.issued : &srv->stats.rejected, 1);
+
+	return ret;
+}
+
+static void * _batch_job(void *arg) {
+
+	EST_BATCH_JOB *job = arg;
+	int i = 0;
+
+	for (i = job->first; i < job->first + job->num; i++) {
+		// Requests that could not be parsed are rejected
+		if (job->reqs[i] && _authorize(job->srv, job->reqs[i], job->peer,
+				PKI_EST_SERVER_OP_BULKENROLL) == PKI_OK)
+			job->certs[i] = _issue(job->srv, job->reqs[i]);
+	}
+
+	return NULL;
+}
+
+/* Issues the requests of a bulkenroll into certs[] (same positions, NULL
+ * for the requests that are missing or rejected), returns the issued */
+static int _enroll_batch(PKI_EST_SERVER *srv, PKI_X509_REQ **items, int num,
+		const PKI_X509_CERT *peer, PKI_X509_CERT **certs) {
+
+	EST_BATCH_JOB *jobs = NULL;
+	PKI_THREAD **th = NULL;
+	int threads = 0, per_job = 0, first = 0, n = 0, i = 0, k = 0;
+
+	if ((threads = srv->threads) <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	if (threads > (num + PKI_EST_SERVER_BATCH_MIN_JOB - 1) / PKI_EST_SERVER_BATCH_MIN_JOB)
+		threads = (num + PKI_EST_SERVER_BATCH_MIN_JOB - 1) / PKI_EST_SERVER_BATCH_MIN_JOB;
+
+	if ((jobs = PKI_Malloc((size_t) threads * sizeof(EST_BATCH_JOB))) == NULL
+			|| (th = PKI_Malloc((size_t) threads * sizeof(PKI_THREAD *))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		if (jobs) PKI_Free(jobs);
+		return -1;
+	}
+
+	per_job = (num + threads - 1) / threads;
+
+	for (n = 0, first = 0; first < num; n++, first += per_job) {
+		jobs[n].srv = srv;
+		jobs[n].peer = peer;
+		jobs[n].reqs = items;
+		jobs[n].certs = certs;
+		jobs[n].first = first;
+		jobs[n].num = (num - first < per_job ? num - first : per_job);
+	}
+
+	// The calling thread takes the first job
+	for (k = 1; k < n; k++) th[k] = PKI_THREAD_new(_batch_job, &jobs[k]);
+	_batch_job(&jobs[0]);
+
+	for (k = 1; k < n; k++) {
+		if (th[k]) {
+			PKI_THREAD_join(th[k], NULL);
+			PKI_Free(th[k]);
+		} else {
+			// Could not start the thread, runs the job here
+			_batch_job(&jobs[k]);
+		}
+	}
+
+	for (i = 0, k = 0; i < num; i++) if (certs[i]) k++;
+
+	_count(&srv->stats.issued, (uint64_t) k);
+	_count(&srv->stats.rejected, (uint64_t) (num - k));
+
+	PKI_Free(th);
+	PKI_Free(jobs);
+
+	return k;
+}
+
+/*!
+ * \brief Issues the certificates for a set of requests (bulkenroll). The
+ *        returned stack has the issued certificates in the order of the
+ *        requests, the number of requests that were not issued is set in
+ *        *rejected and, if status is not NULL, status[i] is set to 1 if
+ *        the i-th request was issued and to 0 if it was rejected (status
+ *        must have room for all the requests).
+ */
+
+PKI_X509_CERT_STACK * PKI_EST_SERVER_enroll_batch(PKI_EST_SERVER *srv,
+		PKI_X509_REQ_STACK *reqs, const PKI_X509_CERT *peer, int *rejected,
+		int *status) {
+
+	PKI_X509_REQ **items = NULL;
+	PKI_X509_CERT **certs = NULL;
+	PKI_X509_CERT_STACK *ret = NULL;
+	int num = 0, i = 0, k = 0;
+
+	if (rejected) *rejected = 0;
+
+	if (!srv || !srv->ca_key || !reqs) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((num = PKI_STACK_X509_REQ_elements(reqs)) <= 0) return NULL;
+
+	if (num > PKI_EST_SERVER_BATCH_MAX) {
+		PKI_ERROR(PKI_ERR_PARAM_RANGE, "Too many requests (%d)", num);
+		return NULL;
+	}
+
+	if ((items = PKI_Malloc((size_t) num * sizeof(PKI_X509_REQ *))) == NULL
+			|| (certs = PKI_Malloc((size_t) num * sizeof(PKI_X509_CERT *))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		goto end;
+	}
+
+	for (i = 0; i < num; i++) items[i] = PKI_STACK_X509_REQ_get_num(reqs, i);
+
+	if ((k = _enroll_batch(srv, items, num, peer, certs)) < 0) goto end;
+
+	if ((ret = PKI_STACK_X509_CERT_new()) == NULL
+			|| PKI_STACK_reserve(ret, k) != PKI_OK) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		for (i = 0; i < num; i++) if (certs[i]) PKI_X509_CERT_free(certs[i]);
+		if (ret) PKI_STACK_X509_CERT_free(ret);
+		ret = NULL;
+		goto end;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (status) status[i] = (certs[i] != NULL);
+		if (certs[i]) PKI_STACK_X509_CERT_push(ret, certs[i]);
+	}
+
+	if (rejected) *rejected = num - k;
+
+end:
+	if (certs) PKI_Free(certs);
+	if (items) PKI_Free(items);
+
+	return ret;
+}
+
+/*! \brief Copies the counters of the server */
+
+int PKI_EST_SERVER_get_stats(const PKI_EST_SERVER *srv, PKI_EST_SERVER_STATS *stats) {
+
+	const uint64_t *src = NULL;
+	uint64_t *dst = NULL;
+	size_t i = 0;
+
+	if (!srv || !stats) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	src = (const uint64_t *) &srv->stats;
+	dst = (uint64_t *) stats;
+
+	for (i = 0; i < sizeof(PKI_EST_SERVER_STATS) / sizeof(uint64_t); i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+
+	return PKI_OK;
+}
+
+/*! \brief Resets the counters of the server */
+
+void PKI_EST_SERVER_reset_stats(PKI_EST_SERVER *srv) {
+
+	uint64_t *dst = NULL;
+	size_t i = 0;
+
+	if (!srv) return;
+
+	dst = (uint64_t *) &srv->stats;
+
+	for (i = 0; i < sizeof(PKI_EST_SERVER_STATS) / sizeof(uint64_t); i++)
+		__atomic_store_n(&dst[i], 0, __ATOMIC_RELAXED);
+}
+
+// ==================
+// HTTP
+// ==================
+
+/* Operation from the last segment of the path (labels are ignored) */
+static int _est_op(const char *path) {
+
+	const char *p = NULL, *end = NULL;
+	size_t len = 0;
+	int i = 0;
+
+	if (!path) return -1;
+
+	if ((end = strchr(path, '?')) == NULL) end = path + strlen(path);
+	while (end > path && end[-1] == '/') end--;
+
+	for (p = end; p > path && p[-1] != '/'; p--);
+	len = (size_t) (end - p);
+
+	for (i = 0; i < PKI_EST_SERVER_OP_NUM; i++) {
+		if (strlen(_est_ops[i]) == len && strncmp(p, _est_ops[i], len) == 0) return i;
+	}
+
+	return -1;
+}
+
+/* Decodes the body (base64 or DER) of a request */
+static PKI_MEM * _est_body(const PKI_HTTP *req) {
+
+	PKI_MEM *ret = NULL;
+
+	if (!req->body || !req->body->data || req->body->size == 0) return NULL;
+
+	if ((ret = PKI_MEM_new_data(req->body->size, req->body->data)) == NULL) return NULL;
+
+	// RFC 7030 uses base64, DER (and PEM) is accepted as well
+	if (ret->data[0] != (V_ASN1_CONSTRUCTED | V_ASN1_SEQUENCE)
+			&& (ret->size <= 10 || strncmp((const char *) ret->data, "-----BEGIN", 10) != 0)
+			&& PKI_MEM_decode(ret, PKI_DATA_FORMAT_B64, 0) != PKI_OK) {
+		PKI_MEM_free(ret);
+		return NULL;
+	}
+
+	return ret;
+}
+
+static PKI_X509_REQ * _est_csr(const PKI_HTTP *req) {
+
+	PKI_X509_REQ *ret = NULL;
+	PKI_MEM *der = NULL;
+	const unsigned char *p = NULL;
+	X509_REQ *val = NULL;
+
+	if ((der = _est_body(req)) == NULL) return NULL;
+
+	p = der->data;
+	if ((val = d2i_X509_REQ(NULL, &p, (long) der->size)) != NULL
+			&& (ret = PKI_X509_new_value(PKI_DATATYPE_X509_REQ, val, NULL)) == NULL)
+		X509_REQ_free(val);
+
+	PKI_MEM_free(der);
+
+	return ret;
+}
+
+/* One request of a bulkenroll (NULL if it can not be parsed) */
+static PKI_X509_REQ * _est_bulk_req(const unsigned char *der, long len) {
+
+	PKI_X509_REQ *ret = NULL;
+	X509_REQ *val = NULL;
+
+	if ((val = d2i_X509_REQ(NULL, &der, len)) != NULL
+			&& (ret = PKI_X509_new_value(PKI_DATATYPE_X509_REQ, val, NULL)) == NULL)
+		X509_REQ_free(val);
+
+	return ret;
+}
+
+/* Parses the requests of a bulkenroll body in order (identical requests
+ * are kept), the requests that can not be parsed are NULL slots. Returns
+ * the number of slots, or -1 if the body can not be split at all */
+static int _est_bulk_reqs(const PKI_MEM *body, PKI_X509_REQ ***reqs) {
+
+	PKI_X509_REQ **ret = NULL;
+	const unsigned char *p = NULL, *q = NULL, *end = NULL;
+	BIO *bio = NULL;
+	char *name = NULL, *header = NULL;
+	unsigned char *data = NULL;
+	long len = 0;
+	size_t max = 0;
+	int num = 0, tag = 0, cls = 0, rc = 0;
+
+	*reqs = NULL;
+
+	// Every DER value takes two bytes at least
+	if ((max = body->size / 2 + 1) > PKI_EST_SERVER_BATCH_MAX + 1)
+		max = PKI_EST_SERVER_BATCH_MAX + 1;
+
+	if ((ret = PKI_Malloc(max * sizeof(PKI_X509_REQ *))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return -1;
+	}
+
+	if (body->size > 10 && strncmp((const char *) body->data, "-----BEGIN", 10) == 0) {
+
+		// PEM bundle
+		if ((bio = BIO_new_mem_buf(body->data, (int) body->size)) == NULL) goto err;
+
+		while ((size_t) num < max) {
+			ERR_clear_error();
+			if (!PEM_read_bio(bio, &name, &header, &data, &len)) {
+				// A damaged block is one more rejected request
+				if (ERR_GET_REASON(ERR_peek_last_error()) != PEM_R_NO_START_LINE)
+					num++;
+				break;
+			}
+			if (strcmp(name, PEM_STRING_X509_REQ) == 0
+					|| strcmp(name, PEM_STRING_X509_REQ_OLD) == 0)
+				ret[num] = _est_bulk_req(data, len);
+			num++;
+			OPENSSL_free(name);
+			OPENSSL_free(header);
+			OPENSSL_free(data);
+		}
+		ERR_clear_error();
+		BIO_free(bio);
+
+	} else {
+
+		// Concatenated DER values
+		for (p = body->data, end = p + body->size; p < end && (size_t) num < max; num++) {
+
+			q = p;
+			rc = ASN1_get_object(&q, &len, &tag, &cls, (long) (end - p));
+
+			// The rest of the body can not be split
+			if ((rc & 0x80) || rc == (V_ASN1_CONSTRUCTED | 1)) {
+				num++;
+				break;
+			}
+
+			ret[num] = _est_bulk_req(p, (long) (q - p) + len);
+			p = q + len;
+		}
+		ERR_clear_error();
+	}
+
+	if (num > PKI_EST_SERVER_BATCH_MAX) {
+		PKI_ERROR(PKI_ERR_PARAM_RANGE, "Too many requests");
+		goto err;
+	}
+
+	*reqs = ret;
+
+	return num;
+
+err:
+	while (num-- > 0) if (ret[num]) PKI_X509_REQ_free(ret[num]);
+	PKI_Free(ret);
+
+	return -1;
+}
+
+/* multipart/mixed with the PKCS#8 key and the certs-only certificate */
+static PKI_MEM * _est_keygen_body(const PKI_X509_KEYPAIR *k, const PKI_X509_CERT *x) {
+
+	PKCS8_PRIV_KEY_INFO *p8 = NULL;
+	PKI_MEM *key = NULL, *cert = NULL, *ret = NULL;
+	X509 *val = (X509 *) x->value;
+	unsigned char *p = NULL;
+	char head[256];
+	int len = 0;
+
+	if ((p8 = EVP_PKEY2PKCS8((EVP_PKEY *) k->value)) == NULL
+			|| (len = i2d_PKCS8_PRIV_KEY_INFO(p8, NULL)) <= 0
+			|| (key = PKI_MEM_new((size_t) len)) == NULL) goto end;
+
+	p = key->data;
+	i2d_PKCS8_PRIV_KEY_INFO(p8, &p);
+
+	if (PKI_MEM_encode(key, PKI_DATA_FORMAT_B64, 1) != PKI_OK
+			|| (cert = _certs_only(&val, 1)) == NULL
+			|| (ret = PKI_MEM_new_null()) == NULL) goto end;
+
+	len = snprintf(head, sizeof(head), "--%s\r\nContent-Type: %s\r\n"
+		"Content-Transfer-Encoding: base64\r\n\r\n", PKI_EST_SERVER_BOUNDARY,
+		PKI_EST_SERVER_TYPE_KEY);
+	PKI_MEM_add(ret, (unsigned char *) head, (size_t) len);
+	PKI_MEM_add(ret, key->data, key->size);
+
+	len = snprintf(head, sizeof(head), "\r\n--%s\r\nContent-Type: %s\r\n"
+		"Content-Transfer-Encoding: base64\r\n\r\n", PKI_EST_SERVER_BOUNDARY,
+		PKI_EST_SERVER_TYPE_CERTS);
+	PKI_MEM_add(ret, (unsigned char *) head, (size_t) len);
+	PKI_MEM_add(ret, cert->data, cert->size);
+
+	len = snprintf(head, sizeof(head), "\r\n--%s--\r\n", PKI_EST_SERVER_BOUNDARY);
+	if (PKI_MEM_add(ret, (unsigned char *) head, (size_t) len) != PKI_OK) {
+		PKI_MEM_free(ret);
+		ret = NULL;
+	}
+
+end:
+	if (p8) PKCS8_PRIV_KEY_INFO_free(p8);
+	if (key) {
+		// The private key does not linger in memory
+		OPENSSL_cleanse(key->data, key->size);
+		PKI_MEM_free(key);
+	}
+	if (cert) PKI_MEM_free(cert);
+
+	return ret;
+}
+
+static int _est_http_handler(const PKI_HTTP *req, PKI_HTTP *resp, void *ctx) {
+
+	PKI_EST_SERVER *srv = ctx;
+	PKI_X509_CERT *peer = NULL, *x = NULL;
+	PKI_X509_KEYPAIR *k = NULL;
+	PKI_X509_REQ *csr = NULL;
+	PKI_X509_REQ **csrs = NULL;
+	PKI_X509_CERT **issued = NULL;
+	PKI_MEM *der = NULL;
+	X509 **certs = NULL, *val = NULL;
+	char head[128], *p = NULL;
+	int op = -1, num = 0, len = 0, i = 0;
+
+	if ((op = _est_op(req->path)) < 0) {
+		resp->code = 404;
+		return PKI_ERR;
+	}
+
+	if ((op == PKI_EST_SERVER_OP_CACERTS) != (req->method == PKI_HTTP_METHOD_GET)) {
+		resp->code = 405;
+		return PKI_ERR;
+	}
+
+	_count(&srv->stats.requests[op], 1);
+
+	resp->code = 400;
+
+	if (op == PKI_EST_SERVER_OP_CACERTS) {
+
+		resp->body = PKI_EST_SERVER_get_ca_certs(srv);
+
+	} else if (op == PKI_EST_SERVER_OP_BULKENROLL) {
+
+		if ((der = _est_body(req)) == NULL
+				|| (num = _est_bulk_reqs(der, &csrs)) <= 0) goto end;
+
+		if ((issued = PKI_Malloc((size_t) num * sizeof(PKI_X509_CERT *))) == NULL
+				|| (certs = PKI_Malloc((size_t) num * sizeof(X509 *))) == NULL) goto end;
+
+		// Malformed requests are rejected in their position
+		peer = PKI_HTTP_SERVER_get_peer_cert();
+		resp->code = 403;
+		if (_enroll_batch(srv, csrs, num, peer, issued) <= 0) goto end;
+
+		for (i = 0; i < num; i++) certs[i] = issued[i] ? (X509 *) issued[i]->value : NULL;
+
+		// Status of every request, in order (e.g., "issued=1,0,1")
+		len = snprintf(head, sizeof(head), "%s%s: issued=", _est_cte,
+			PKI_EST_SERVER_HEADER_BATCH);
+		if ((resp->head = PKI_MEM_new((size_t) len + 2 * (size_t) num + 1)) == NULL) {
+			resp->code = 500;
+			goto end;
+		}
+		p = (char *) resp->head->data;
+		memcpy(p, head, (size_t) len);
+		p += len;
+		for (i = 0; i < num; i++) {
+			if (i > 0) *p++ = ',';
+			*p++ = issued[i] ? '1' : '0';
+		}
+		memcpy(p, "\r\n", 2);
+
+		resp->body = _certs_only(certs, num);
+
+	} else {
+
+		if ((csr = _est_csr(req)) == NULL) goto end;
+
+		peer = PKI_HTTP_SERVER_get_peer_cert();
+		resp->code = 403;
+
+		if (op == PKI_EST_SERVER_OP_SERVERKEYGEN) {
+			if ((x = PKI_EST_SERVER_keygen(srv, csr, peer, &k)) != NULL
+					&& (resp->body = _est_keygen_body(k, x)) != NULL)
+				resp->type = strdup(PKI_EST_SERVER_TYPE_MULTIPART);
+		} else if ((x = PKI_EST_SERVER_enroll(srv, csr, peer,
+				op == PKI_EST_SERVER_OP_SIMPLEREENROLL)) != NULL) {
+			val = (X509 *) x->value;
+			resp->body = _certs_only(&val, 1);
+		}
+	}
+
+	if (resp->body && !resp->type) {
+		resp->type = strdup(PKI_EST_SERVER_TYPE_CERTS);
+		if (!resp->head) resp->head = PKI_MEM_new_data(strlen(_est_cte),
+			(const unsigned char *) _est_cte);
+	}
+
+end:
+	for (i = 0; i < num; i++) {
+		if (issued && issued[i]) PKI_X509_CERT_free(issued[i]);
+		if (csrs && csrs[i]) PKI_X509_REQ_free(csrs[i]);
+	}
+	if (certs) PKI_Free(certs);
+	if (issued) PKI_Free(issued);
+	if (csrs) PKI_Free(csrs);
+	if (der) PKI_MEM_free(der);
+	if (csr) PKI_X509_REQ_free(csr);
+	if (x) PKI_X509_CERT_free(x);
+	if (k) PKI_X509_KEYPAIR_free(k);
+	if (peer) PKI_X509_CERT_free(peer);
+
+	if (!resp->body) return PKI_ERR;
+
+	resp->code = 200;
+
+	return PKI_OK;
+}
+
+/*! \brief Serves the EST operations under the path (PKI_EST_SERVER_PATH
+ *         if NULL) of an HTTP server (that should use TLS) */
+
+int PKI_EST_SERVER_attach(PKI_EST_SERVER *srv, PKI_HTTP_SERVER *http,
+			  const char *path) {
+
+	if (!srv || !http) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	return PKI_HTTP_SERVER_add_handler(http, path ? path : PKI_EST_SERVER_PATH,
+		_est_http_handler, srv);
+}
@@ -2,6 +2,9 @@
 
 #include <libpki/pki.h>
 
+static PKI_X509_STACK * _x509_stack_get_url(URL *url, PKI_DATATYPE type,
+			PKI_DATA_FORMAT format, PKI_CRED *cred, HSM *hsm, int bulk);
+
 /*! \brief Returns the PKI_X509_XXX_VALUE * from the passed URL */
 
 void *PKI_get_value ( char *url_s, PKI_DATATYPE type, PKI_DATA_FORMAT format,
@@ -79,8 +82,9 @@ PKI_X509 *PKI_X509_get_url(URL * url,
 		return (NULL);
 	}
 
-	// Gets the stack of PKI_X509 from the provided URL
-	if ((sk = PKI_X509_STACK_get_url(url, type, format, cred, hsm)) == NULL) {
+	// Gets the stack of PKI_X509 from the provided URL (single objects
+	// are not decoded via the bulk loader)
+	if ((sk = _x509_stack_get_url(url, type, format, cred, hsm, 0)) == NULL) {
 		return (NULL);
 	}
 
@@ -92,8 +96,9 @@ PKI_X509 *PKI_X509_get_url(URL * url,
 			return NULL;
 	}
  
-	// Gets the first element as the one to keep
-	ret = PKI_STACK_X509_pop(sk);
+	// Gets the first element as the one to keep (objects are in the
+	// same order as in the retrieved data)
+	ret = PKI_STACK_X509_del_num(sk, 0);
 
 	// Free all the other elements in the stack
 	PKI_STACK_X509_free_all(sk);
@@ -148,6 +153,13 @@ PKI_X509_STACK *PKI_X509_STACK_get ( char *url_s, PKI_DATATYPE type,
 
 PKI_X509_STACK *PKI_X509_STACK_get_url ( URL *url, PKI_DATATYPE type,
 						PKI_DATA_FORMAT format, PKI_CRED *cred, HSM *hsm ) {
+
+	// Bundles are split and decoded in parallel
+	return _x509_stack_get_url(url, type, format, cred, hsm, 1);
+}
+
+static PKI_X509_STACK * _x509_stack_get_url(URL *url, PKI_DATATYPE type,
+			PKI_DATA_FORMAT format, PKI_CRED *cred, HSM *hsm, int bulk) {
 	
 	PKI_X509_STACK *ret = NULL;
 		// Return Stack of X509
@@ -188,6 +200,9 @@ PKI_X509_STACK *PKI_X509_STACK_get_url ( URL *url, PKI_DATATYPE type,
 
 	if(!url) return NULL;
 
+	// Loads the providers and the PQC/Composite methods
+	PKI_init_crypto_methods();
+
 	// Checks for the use of the ID protocol (for HSM/Hardware)
 	if ( url->proto == URI_PROTO_ID ) {
 
@@ -282,8 +297,8 @@ PKI_X509_STACK *PKI_X509_STACK_get_url ( URL *url, PKI_DATATYPE type,
 								       hsm)) != NULL) {
 
 					// For each of the returned objects (if any) we get
-					// the next PKI_X509 generic structure
-					while ((x = PKI_STACK_X509_pop(tmp_x_sk)) != NULL) {
+					// the next PKI_X509 generic structure (in order)
+					while ((x = PKI_STACK_X509_del_num(tmp_x_sk, 0)) != NULL) {
 
 						// Updates the counter
 						count++;
@@ -317,14 +332,21 @@ PKI_X509_STACK *PKI_X509_STACK_get_url ( URL *url, PKI_DATATYPE type,
 
 			// Here we have a specific datatype we are looking for so we
 			// do not have to cycle through all the supported datatypes
-			if ((tmp_x_sk = PKI_X509_STACK_get_mem(mem_data,
-							       type,
-							       format,
-							       cred,
-							       hsm)) != NULL) {
+			if (bulk) {
+				tmp_x_sk = PKI_X509_STACK_get_mem_bulk(mem_data, type,
+							format, 0, cred, hsm);
+			} else {
+				tmp_x_sk = PKI_X509_STACK_get_mem(mem_data, type,
+							format, cred, hsm);
+			}
+
+			if (tmp_x_sk != NULL) {
+
+				// Processes the elements from the inner stack (in order)
+				for (j = 0; j < PKI_STACK_X509_elements(tmp_x_sk); j++) {
 
-				// Processes (removes) next element from the inner stack
-				while ((x = PKI_STACK_X509_pop(tmp_x_sk)) != NULL ) {
+					// Gets the next element
+					x = PKI_STACK_X509_get_num(tmp_x_sk, j);
 
 					// Updates the counter
 					count++;
@@ -352,8 +374,8 @@ PKI_X509_STACK *PKI_X509_STACK_get_url ( URL *url, PKI_DATATYPE type,
 					}
 				}
 
-				// Nothing more to do with the stack, let's free it
-				PKI_STACK_X509_free_all(tmp_x_sk);
+				// The elements were moved (or freed), let's free the stack
+				PKI_STACK_X509_free(tmp_x_sk);
 			}
 		}
 	}
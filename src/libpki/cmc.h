@@ -136,7 +136,7 @@ DECLARE_ASN1_FUNCTIONS(CMC_STATUS_INFO)
 typedef struct TaggedAttribute_st {
 	ASN1_INTEGER *bodyPartID;
 	ASN1_OBJECT *attrType;
-	STACK_OF(X509_ATTRIBUTE) *attrValues;
+	STACK_OF(ASN1_TYPE) *attrValues;
 } TAGGED_ATTRIBUTE;
 
 DECLARE_ASN1_FUNCTIONS(TAGGED_ATTRIBUTE)
@@ -159,6 +159,8 @@ typedef struct OtherMsg_st {
 
 DECLARE_ASN1_FUNCTIONS( OTHER_MSG )
 
+DECLARE_STACK_OF(OTHER_MSG)
+
 /*
    CMC_UNSIGNED_DATA ::= SEQUENCE {
 	bodyPartPath		SEQUENCE SIZE (1..MAX) OF BodyPartID,
@@ -202,6 +204,8 @@ typedef struct TaggedContentInfo_st {
 
 DECLARE_ASN1_FUNCTIONS(TAGGED_CONTENT_INFO)
 
+DECLARE_STACK_OF(TAGGED_CONTENT_INFO)
+
 /*
    TaggedCertificationRequest ::= SEQUENCE {
 	bodyPartID		BodyPartID,
@@ -371,6 +375,13 @@ typedef struct CertReqMsg_st {
 
 DECLARE_ASN1_FUNCTIONS(CERT_REQ_MSG)
 
+/* CRMF messages (RFC 4211) of the TaggedRequests are decoded by the
+ * crypto library (when available) */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_CRMF)
+# include <openssl/crmf.h>
+# define PKI_CMC_CRMF
+#endif
+
 /*
    TaggedRequest ::= CHOICE {
 	tcr		[0] TaggedCertificationRequest,
@@ -395,13 +406,19 @@ typedef struct TaggedRequest_st {
 	int type;
 	union {
 		TAGGED_CERTIFICATION_REQUEST *tcr;
+#ifdef PKI_CMC_CRMF
+		OSSL_CRMF_MSG *crm;
+#else
 		CERT_REQ_MSG *crm;
+#endif
 		OTHER_REQ_MSG *orm;
 	} value;
 } TAGGED_REQUEST;
 
 DECLARE_ASN1_FUNCTIONS(TAGGED_REQUEST)
 
+DECLARE_STACK_OF(TAGGED_REQUEST)
+
 
 /*
    PKI_DATA ::= SEQUENCE {
@@ -438,6 +455,7 @@ typedef struct ResponseBody_st {
 DECLARE_ASN1_FUNCTIONS(RESPONSE_BODY)
 
 #include <libpki/cmc/cmc_cert_req.h>
+#include <libpki/cmc/cmc_server.h>
 
 /* End _LIBPKI_CMS_H */
 #endif
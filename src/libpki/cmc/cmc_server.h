@@ -0,0 +1,140 @@
+/* CMC Full PKI Request processing (RFC 5272)
+ * (c) 2019 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ *
+ * This software is released under the GPL2 License included
+ * in the archive. You can not remove this copyright notice.
+ */
+
+#ifndef _LIBPKI_CMC_SERVER_H
+#define _LIBPKI_CMC_SERVER_H
+
+/*!
+ * \brief CMC (RFC 5272) Full PKI Request engine
+ *
+ * A Full PKI Request is a SignedData (id-cct-PKIData) with any number of
+ * TaggedRequests. The signature of the message is checked against the
+ * signer certificate carried in the SignedData (and against the trusted
+ * certificates, if configured), then the PKCS#10 requests (tcr) are
+ * checked for proof of possession and issued by multiple threads.
+ *
+ * The Full PKI Response is a SignedData (id-cct-PKIResponse) signed by
+ * the CA with the issued certificates in its certificates field and one
+ * CMCStatusInfo control per bodyPartID of the request in the ResponseBody.
+ * CRMF (crm) and other (orm) requests are answered with noSupport, the
+ * status of a CRMF request refers to its certReqId (RFC 5272, 3.2.1.2.2).
+ * CRMF requests need the crypto library's CRMF support (PKI_CMC_CRMF).
+ */
+
+/* Content Types (RFC 5273) */
+#define PKI_CMC_SERVER_TYPE_REQUEST	"application/pkcs7-mime; smime-type=CMC-request"
+#define PKI_CMC_SERVER_TYPE_RESPONSE	"application/pkcs7-mime; smime-type=CMC-response"
+
+/* Default validity of the issued certificates */
+#define PKI_CMC_SERVER_VALIDITY		PKI_VALIDITY_ONE_YEAR
+
+/* Maximum number of TaggedRequests in a Full PKI Request */
+#define PKI_CMC_SERVER_BATCH_MAX	4096
+
+/* Requests issued by each thread (at least) */
+#define PKI_CMC_SERVER_BATCH_MIN_JOB	16
+
+/* CMCStatus */
+typedef enum {
+	PKI_CMC_STATUS_UNKNOWN		= -1,
+	PKI_CMC_STATUS_SUCCESS		= 0,
+	PKI_CMC_STATUS_FAILED		= 2,
+	PKI_CMC_STATUS_PENDING		= 3,
+	PKI_CMC_STATUS_NOSUPPORT	= 4,
+	PKI_CMC_STATUS_CONFIRM_REQUIRED	= 5,
+	PKI_CMC_STATUS_POP_REQUIRED	= 6,
+	PKI_CMC_STATUS_PARTIAL		= 7
+} PKI_CMC_STATUS;
+
+/* CMCFailInfo */
+typedef enum {
+	PKI_CMC_FAIL_NONE		= -1,
+	PKI_CMC_FAIL_BAD_ALG		= 0,
+	PKI_CMC_FAIL_BAD_MESSAGE_CHECK	= 1,
+	PKI_CMC_FAIL_BAD_REQUEST	= 2,
+	PKI_CMC_FAIL_BAD_TIME		= 3,
+	PKI_CMC_FAIL_BAD_CERT_ID	= 4,
+	PKI_CMC_FAIL_UNSUPPORTED_EXT	= 5,
+	PKI_CMC_FAIL_MUST_ARCHIVE_KEYS	= 6,
+	PKI_CMC_FAIL_BAD_IDENTITY	= 7,
+	PKI_CMC_FAIL_POP_REQUIRED	= 8,
+	PKI_CMC_FAIL_POP_FAILED		= 9,
+	PKI_CMC_FAIL_NO_KEY_REUSE	= 10,
+	PKI_CMC_FAIL_INTERNAL_CA_ERROR	= 11,
+	PKI_CMC_FAIL_TRY_LATER		= 12,
+	PKI_CMC_FAIL_AUTH_DATA_FAIL	= 13
+} PKI_CMC_FAIL;
+
+typedef struct pki_cmc_server_stats_st {
+	/* Full PKI Requests (and the ones that failed the message check) */
+	uint64_t requests;
+	uint64_t bad_messages;
+	/* Issued certificates and rejected TaggedRequests */
+	uint64_t issued;
+	uint64_t rejected;
+} PKI_CMC_SERVER_STATS;
+
+typedef struct pki_cmc_server_st PKI_CMC_SERVER;
+
+/*!
+ * \brief Authorization callback
+ *
+ * Called (possibly by multiple threads at once) for every PKCS#10
+ * request that passed the proof of possession check, with the signer
+ * of the Full PKI Request. Returns PKI_OK to issue the certificate.
+ */
+typedef int (*PKI_CMC_SERVER_AUTH_CB)(const PKI_X509_REQ  * req,
+				      const PKI_X509_CERT * signer,
+				      long                  body_part_id,
+				      void                * ctx);
+
+PKI_CMC_SERVER * PKI_CMC_SERVER_new ( void );
+void PKI_CMC_SERVER_free ( PKI_CMC_SERVER * srv );
+
+int PKI_CMC_SERVER_set_ca ( PKI_CMC_SERVER   * srv,
+			    PKI_X509_KEYPAIR * k,
+			    PKI_X509_CERT    * x );
+
+int PKI_CMC_SERVER_set_profile ( PKI_CMC_SERVER   * srv,
+				 PKI_X509_PROFILE * profile,
+				 uint64_t           validity );
+
+int PKI_CMC_SERVER_set_trusted ( PKI_CMC_SERVER      * srv,
+				 PKI_X509_CERT_STACK * trusted );
+
+int PKI_CMC_SERVER_set_auth_cb ( PKI_CMC_SERVER         * srv,
+				 PKI_CMC_SERVER_AUTH_CB   cb,
+				 void                   * ctx );
+
+int PKI_CMC_SERVER_set_threads ( PKI_CMC_SERVER * srv,
+				 int              threads );
+
+PKI_MEM * PKI_CMC_SERVER_process ( PKI_CMC_SERVER * srv,
+				   const PKI_MEM  * req );
+
+int PKI_CMC_SERVER_get_stats ( const PKI_CMC_SERVER * srv,
+			       PKI_CMC_SERVER_STATS * stats );
+
+void PKI_CMC_SERVER_reset_stats ( PKI_CMC_SERVER * srv );
+
+int PKI_CMC_SERVER_attach ( PKI_CMC_SERVER  * srv,
+			    PKI_HTTP_SERVER * http,
+			    const char      * path );
+
+/* Client side */
+PKI_MEM * PKI_CMC_REQUEST_new ( PKI_X509_REQ_STACK     * reqs,
+				const PKI_X509_KEYPAIR * k,
+				const PKI_X509_CERT    * x );
+
+PKI_CMC_STATUS PKI_CMC_RESPONSE_get_status ( const PKI_MEM * resp,
+					     long            body_part_id,
+					     PKI_CMC_FAIL  * fail );
+
+PKI_X509_CERT_STACK * PKI_CMC_RESPONSE_get_certs ( const PKI_MEM * resp );
+
+#endif
@@ -99,6 +99,7 @@ typedef enum {
 #include <libpki/est/pki_x509_est_data.h>
 #include <libpki/est/pki_x509_est_attrs.h>
 #include <libpki/est/pki_x509_est_msg.h>
+#include <libpki/est/est_server.h>
 
 
 #endif
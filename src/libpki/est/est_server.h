@@ -0,0 +1,142 @@
+/*
+ * OpenCA EST - Server side engine (RFC 7030)
+ * (c) 2019 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ */
+
+#ifndef _LIBPKI_EST_SERVER_H
+#define _LIBPKI_EST_SERVER_H
+
+/*!
+ * \brief EST (RFC 7030) server engine
+ *
+ * The engine issues the certificates directly with the configured CA
+ * keypair and certificate (and optional profile). Attached to a TLS
+ * PKI_HTTP_SERVER it serves the following operations under the path
+ * (by default PKI_EST_SERVER_PATH, an optional CA label is ignored):
+ *
+ *   GET  cacerts         the CA certificates (certs-only)
+ *   POST simpleenroll    one PKCS#10 request
+ *   POST simplereenroll  one PKCS#10 request, authenticated with the
+ *                        TLS client certificate being renewed
+ *   POST serverkeygen    the key is generated by the server (from the
+ *                        keypair pool, if configured)
+ *   POST bulkenroll      (extension) many PKCS#10 requests at once
+ *
+ * A bulkenroll body carries the requests as concatenated DER values
+ * (base64 as for the other operations) or as a PEM bundle. The requests
+ * are parsed in order (identical requests are kept), issued by multiple
+ * threads and the certificates are returned as one certs-only bundle in
+ * the order of the requests. Requests that can not be parsed or issued
+ * have no certificate, the PKI_EST_SERVER_HEADER_BATCH header reports
+ * the status of every request in order (e.g., "issued=1,0,1").
+ */
+
+/* Default path of the operations */
+#define PKI_EST_SERVER_PATH		"/.well-known/est"
+
+/* Default validity of the issued certificates */
+#define PKI_EST_SERVER_VALIDITY		PKI_VALIDITY_ONE_YEAR
+
+/* Maximum number of requests in a bulkenroll */
+#define PKI_EST_SERVER_BATCH_MAX	4096
+
+/* Requests issued by each thread of a bulkenroll (at least) */
+#define PKI_EST_SERVER_BATCH_MIN_JOB	16
+
+/* Content Types */
+#define PKI_EST_SERVER_TYPE_CERTS	"application/pkcs7-mime; smime-type=certs-only"
+#define PKI_EST_SERVER_TYPE_CSR		"application/pkcs10"
+#define PKI_EST_SERVER_TYPE_KEY		"application/pkcs8"
+#define PKI_EST_SERVER_TYPE_MULTIPART	"multipart/mixed; boundary=" PKI_EST_SERVER_BOUNDARY
+
+#define PKI_EST_SERVER_BOUNDARY		"libpki-est-boundary"
+
+/* Status (1 issued, 0 rejected) of every request of a bulkenroll */
+#define PKI_EST_SERVER_HEADER_BATCH	"X-EST-Batch"
+
+typedef enum {
+	PKI_EST_SERVER_OP_CACERTS		= 0,
+	PKI_EST_SERVER_OP_SIMPLEENROLL,
+	PKI_EST_SERVER_OP_SIMPLEREENROLL,
+	PKI_EST_SERVER_OP_SERVERKEYGEN,
+	PKI_EST_SERVER_OP_BULKENROLL,
+	PKI_EST_SERVER_OP_NUM
+} PKI_EST_SERVER_OP;
+
+typedef struct pki_est_server_stats_st {
+	/* Served requests per operation */
+	uint64_t requests[PKI_EST_SERVER_OP_NUM];
+	/* Issued certificates and rejected PKCS#10 requests */
+	uint64_t issued;
+	uint64_t rejected;
+} PKI_EST_SERVER_STATS;
+
+typedef struct pki_est_server_st PKI_EST_SERVER;
+
+/*!
+ * \brief Authorization callback
+ *
+ * Called (possibly by multiple threads at once) for every request that
+ * passed the built-in checks (request signature and, for the renewals,
+ * the subject of the TLS client certificate). The peer is NULL if the
+ * client did not authenticate. Returns PKI_OK to issue the certificate.
+ */
+typedef int (*PKI_EST_SERVER_AUTH_CB)(const PKI_X509_REQ  * req,
+				      const PKI_X509_CERT * peer,
+				      PKI_EST_SERVER_OP     op,
+				      void                * ctx);
+
+PKI_EST_SERVER * PKI_EST_SERVER_new ( void );
+void PKI_EST_SERVER_free ( PKI_EST_SERVER * srv );
+
+int PKI_EST_SERVER_set_ca ( PKI_EST_SERVER      * srv,
+			    PKI_X509_KEYPAIR    * k,
+			    PKI_X509_CERT       * x,
+			    PKI_X509_CERT_STACK * chain );
+
+int PKI_EST_SERVER_set_profile ( PKI_EST_SERVER   * srv,
+				 PKI_X509_PROFILE * profile,
+				 uint64_t           validity );
+
+int PKI_EST_SERVER_set_auth_cb ( PKI_EST_SERVER         * srv,
+				 PKI_EST_SERVER_AUTH_CB   cb,
+				 void                   * ctx );
+
+int PKI_EST_SERVER_set_keygen ( PKI_EST_SERVER   * srv,
+				PKI_KEYPAIR_POOL * pool,
+				PKI_SCHEME_ID      scheme,
+				int                bits );
+
+int PKI_EST_SERVER_set_threads ( PKI_EST_SERVER * srv,
+				 int              threads );
+
+/* Operations (also usable without the HTTP listener) */
+PKI_MEM * PKI_EST_SERVER_get_ca_certs ( const PKI_EST_SERVER * srv );
+
+PKI_X509_CERT * PKI_EST_SERVER_enroll ( PKI_EST_SERVER      * srv,
+					const PKI_X509_REQ  * req,
+					const PKI_X509_CERT * peer,
+					int                   renew );
+
+PKI_X509_CERT * PKI_EST_SERVER_keygen ( PKI_EST_SERVER      * srv,
+					const PKI_X509_REQ  * req,
+					const PKI_X509_CERT * peer,
+					PKI_X509_KEYPAIR   ** key );
+
+PKI_X509_CERT_STACK * PKI_EST_SERVER_enroll_batch ( PKI_EST_SERVER       * srv,
+						    PKI_X509_REQ_STACK   * reqs,
+						    const PKI_X509_CERT  * peer,
+						    int                  * rejected,
+						    int                  * status );
+
+int PKI_EST_SERVER_get_stats ( const PKI_EST_SERVER * srv,
+			       PKI_EST_SERVER_STATS * stats );
+
+void PKI_EST_SERVER_reset_stats ( PKI_EST_SERVER * srv );
+
+int PKI_EST_SERVER_attach ( PKI_EST_SERVER  * srv,
+			    PKI_HTTP_SERVER * http,
+			    const char      * path );
+
+#endif
@@ -26,6 +26,9 @@
 #define LIBPKI_HTTP_BUF_SIZE		8192
 #define LIBPKI_HTTPS_BUF_SIZE		8192
 
+/* Redirections followed by PKI_HTTP_GET_message_url() */
+#define PKI_HTTP_MAX_REDIRECTS		5
+
 /* ----------------------------- HTTP HELP Functions -------------------- */
 
 void PKI_HTTP_free(PKI_HTTP *rv);
@@ -77,6 +80,11 @@ int PKI_HTTP_GET_data_url(const URL      * url,
 					      PKI_MEM_STACK ** ret,
 					      PKI_SSL  * ssl);
 
+PKI_HTTP *PKI_HTTP_GET_message_url(const URL  * url,
+		                           const char * headers,
+		                           int          timeout,
+		                           size_t       max_size);
+
 int PKI_HTTP_GET_data_socket(const PKI_SOCKET * url,
 		                     int                timeout,
 							 size_t             max_size,
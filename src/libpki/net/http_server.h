@@ -0,0 +1,70 @@
+/* libpki/net/http_server.h */
+
+#ifndef _LIBPKI_HTTP_SERVER_H
+#define _LIBPKI_HTTP_SERVER_H
+
+/*!
+ * \brief Embedded HTTP listener for the PKI responders
+ *
+ * One listening socket is shared by all the registered handlers (e.g.,
+ * a PRQP responder on "/prqp" and a SCEP server on "/scep"). Accepted
+ * connections are queued and served by a fixed pool of worker threads,
+ * one request per connection.
+ *
+ * The listener can serve TLS instead of plain HTTP (see
+ * PKI_HTTP_SERVER_set_tls), the handshake runs on the worker threads.
+ *
+ * Handlers are selected by the longest matching path prefix and must be
+ * registered before PKI_HTTP_SERVER_start(). The handler fills in the
+ * code, type (PKI_Malloc'd string) and body of the response, extra header
+ * lines ("Name: value\r\n") can be provided in the response head.
+ */
+
+/* Default number of worker threads */
+#define PKI_HTTP_SERVER_WORKERS		4
+
+/* Connections waiting for a worker */
+#define PKI_HTTP_SERVER_QUEUE_SIZE	256
+
+/* Read timeout (secs) for the requests */
+#define PKI_HTTP_SERVER_TIMEOUT		10
+
+/* Maximum size of a request (header and body) */
+#define PKI_HTTP_SERVER_MAX_SIZE	(1024 * 1024)
+
+/* Maximum number of handlers */
+#define PKI_HTTP_SERVER_MAX_HANDLERS	16
+
+typedef struct pki_http_server_st PKI_HTTP_SERVER;
+
+/* Returns PKI_OK, or PKI_ERR for an internal error (500) */
+typedef int (*PKI_HTTP_SERVER_HANDLER)(const PKI_HTTP * req,
+				       PKI_HTTP       * resp,
+				       void           * ctx);
+
+PKI_HTTP_SERVER * PKI_HTTP_SERVER_new ( const char * host,
+					int          port,
+					int          workers );
+
+void PKI_HTTP_SERVER_free ( PKI_HTTP_SERVER * srv );
+
+int PKI_HTTP_SERVER_add_handler ( PKI_HTTP_SERVER         * srv,
+				  const char              * path,
+				  PKI_HTTP_SERVER_HANDLER   cb,
+				  void                    * ctx );
+
+int PKI_HTTP_SERVER_start ( PKI_HTTP_SERVER * srv );
+int PKI_HTTP_SERVER_stop ( PKI_HTTP_SERVER * srv );
+
+int PKI_HTTP_SERVER_get_port ( const PKI_HTTP_SERVER * srv );
+
+int PKI_HTTP_SERVER_set_tls ( PKI_HTTP_SERVER           * srv,
+			      const PKI_X509_KEYPAIR    * k,
+			      const PKI_X509_CERT       * x,
+			      const PKI_X509_CERT_STACK * chain,
+			      const PKI_X509_CERT_STACK * trusted );
+
+/* Only valid inside a handler */
+PKI_X509_CERT * PKI_HTTP_SERVER_get_peer_cert ( void );
+
+#endif
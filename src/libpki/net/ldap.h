@@ -20,9 +20,30 @@
 	defined(LDAP_VENDOR_MICROSOFT)
 #include <ldap.h>
 
+/* Searches sent to the server before waiting for the results */
+#define URL_LDAP_PIPELINE_DEPTH		64
+
+/* Default number of entries per page (paged searches) */
+#define URL_LDAP_PAGE_SIZE		500
+
+/* Timeout (secs) for checking idle sessions */
+#define URL_LDAP_PING_TIMEOUT		5
+
+#ifndef LDAP_NO_ATTRS
+#define LDAP_NO_ATTRS			"1.1"
+#endif
+
 LDAP *URL_LDAP_connect(const URL *url, int timeout );
 PKI_MEM_STACK *URL_get_data_ldap_url(const URL *url, int timeout, ssize_t size);
 
+PKI_MEM_STACK *URL_get_data_ldap_url_dns(const URL *url, const char * const *dns,
+				int dns_num, int timeout, ssize_t size);
+
+PKI_MEM_STACK *URL_get_data_ldap_url_paged(const URL *url, const char *filter,
+				int page_size, int timeout, ssize_t size);
+
 #endif
 
+void URL_ldap_pool_flush ( void );
+
 #endif
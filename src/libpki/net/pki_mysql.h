@@ -21,4 +21,6 @@ PKI_MEM_STACK *URL_get_data_mysql_url ( const URL *url, ssize_t size );
 int URL_put_data_mysql ( const char *url_s, const PKI_MEM *data );
 int URL_put_data_mysql_url ( const URL *url, const PKI_MEM *data );
 
+void URL_mysql_pool_flush ( void );
+
 #endif /* _LIBPKI_URL_MYSQL_H */
@@ -0,0 +1,49 @@
+/* libpki/net/url_cache.h */
+
+#ifndef _LIBPKI_URL_CACHE_H
+#define _LIBPKI_URL_CACHE_H
+
+/*!
+ * \brief Fetch cache for remote objects (http://, ldap:// and dns://)
+ *
+ * URL_get_data_url() serves the remote objects from this cache while they
+ * are fresh. The freshness comes from the HTTP Cache-Control/Expires headers
+ * and from the nextUpdate of the retrieved CRLs and OCSP responses (objects
+ * are never served past their nextUpdate). Stale HTTP objects with an ETag
+ * or Last-Modified header are revalidated with a conditional GET.
+ *
+ * Concurrent requests for the same URL are coalesced into a single fetch.
+ * Entries can also be stored in a directory (URL_CACHE_set_dir), shared
+ * across processes.
+ *
+ * URLs with credentials (usr/pwd) and https:// URLs are never cached.
+ */
+
+/* Default number of cached URLs */
+#define URL_CACHE_DEFAULT_SIZE		256
+
+/* Upper limit for the freshness lifetime (secs) */
+#define URL_CACHE_MAX_TTL		(7 * 86400)
+
+/* Upper limit for the Last-Modified heuristic freshness (secs) */
+#define URL_CACHE_HEURISTIC_MAX_TTL	86400
+
+/* ------------------------ Configuration --------------------------- */
+
+int URL_CACHE_set_size ( int entries );
+int URL_CACHE_set_default_ttl ( int secs );
+int URL_CACHE_set_dir ( const char * dir );
+
+/* --------------------------- Lookups ------------------------------ */
+
+PKI_MEM_STACK * URL_CACHE_get_data_url ( const URL * url,
+					 int         timeout,
+					 ssize_t     size );
+
+int URL_CACHE_is_cacheable ( const URL * url );
+
+int URL_CACHE_invalidate ( const char * url_s );
+
+void URL_CACHE_flush ( void );
+
+#endif /* _LIBPKI_URL_CACHE_H */
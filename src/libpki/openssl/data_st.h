@@ -1320,6 +1320,8 @@ typedef struct pki_digest_data {
 	const PKI_DIGEST_ALG *algor;
 	unsigned char *digest;
 	size_t size;
+	/* Streaming context (from PKI_DIGEST_init to PKI_DIGEST_final) */
+	EVP_MD_CTX *ctx;
 } PKI_DIGEST;
 
 typedef struct pki_store_st {
@@ -246,7 +246,9 @@ typedef enum {
 #include <libpki/pki_err.h>
 #include <libpki/pki_cred.h>
 #include <libpki/support.h>
+#include <libpki/pki_arena.h>
 #include <libpki/pki_mem.h>
+#include <libpki/pki_b64.h>
 #include <libpki/stack.h>
 #include <libpki/crypto.h>
 #include <libpki/net/sock.h>
@@ -254,6 +256,8 @@ typedef enum {
 #include <libpki/net/pki_socket.h>
 #include <libpki/net/url.h>
 #include <libpki/net/http_s.h>
+#include <libpki/net/http_server.h>
+#include <libpki/net/url_cache.h>
 #include <libpki/net/ldap.h>
 #include <libpki/net/dns.h>
 
@@ -283,6 +287,7 @@ typedef enum {
 #include <libpki/pki_kdf.h>
 #include <libpki/pki_config.h>
 #include <libpki/pki_keypair.h>
+#include <libpki/pki_keypair_pool.h>
 #include <libpki/pki_x509_item.h>
 #include <libpki/pki_x509_attribute.h>
 #include <libpki/pki_x509_signature.h>
@@ -338,11 +343,14 @@ typedef enum {
 #include <libpki/token_data.h>
 #include <libpki/token_id.h>
 #include <libpki/token.h>
+#include <libpki/token_handle.h>
 
 /* Log Subsystem Support */
 #include <libpki/pki_log.h>
 
 /* DBMS support */
+#include <libpki/net/pki_db.h>
+
 #ifdef __LIB_BUILD__
 #include <libpki/net/pki_mysql.h>
 #include <libpki/net/pki_pg.h>
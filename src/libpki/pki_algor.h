@@ -21,9 +21,15 @@ PKI_X509_ALGOR_VALUE * PKI_X509_ALGOR_VALUE_new_pkey(const PKI_X509_KEYPAIR_VALU
 // /*! \brief Returns a new PKI_X509_ALGORITHM_VALIE from the passed PKI_DIGEST_ALG structure */
 // PKI_X509_ALGOR_VALUE * PKI_X509_ALGOR_VALUE_new_digest ( PKI_DIGEST_ALG *alg );
 
-/*! \brief Get PKI_X509_ALGOR (AlgorithmIdentifier) from a specified algorithm ID */
+/*! \brief Get PKI_X509_ALGOR (AlgorithmIdentifier) from a specified algorithm ID
+ *
+ * The returned value is shared across calls and must not be modified or freed.
+ */
 PKI_X509_ALGOR_VALUE *PKI_X509_ALGOR_VALUE_get ( PKI_ALGOR_ID algor );
 
+/*! \brief Returns 1 if the value is shared (i.e., from PKI_X509_ALGOR_VALUE_get) */
+int PKI_X509_ALGOR_VALUE_is_interned(const PKI_X509_ALGOR_VALUE * algor);
+
 // /*! \brief Get the PKI_X509_ALGOR (AlgorithmIdentifier) for a pubkey and digest combination */
 // PKI_X509_ALGOR_VALUE *PKI_X509_ALGOR_VALUE_get_ex(PKI_ALGOR_ID pubkey_id, PKI_ALGOR_ID digest_id);
 
@@ -33,7 +39,7 @@ PKI_X509_ALGOR_VALUE *PKI_X509_ALGOR_VALUE_get ( PKI_ALGOR_ID algor );
  * name. Names are in the form of "RSA-SHA1", "RSA-SHA512", or "DSA-SHA1".
  * 
  * @param alg_s The string describing the algorithm name
- * @retval The pointer to the newly allocated PKI_X509_ALGOR_VALUE
+ * @retval The pointer to the shared PKI_X509_ALGOR_VALUE (do not free)
  */
 PKI_X509_ALGOR_VALUE *PKI_X509_ALGOR_VALUE_get_by_name ( const char *alg_s );
 
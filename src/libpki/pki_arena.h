@@ -0,0 +1,57 @@
+/* Arena (bump) allocator for request-scoped allocations */
+
+#ifndef _LIBPKI_ARENA_H
+#define _LIBPKI_ARENA_H
+
+/*!
+ * \brief Arena allocator for the objects of a single request
+ *
+ * When an arena is bound to the current thread (PKI_ARENA_bind), the
+ * memory returned by PKI_Malloc() on that thread is carved from the
+ * arena chunks, PKI_Free() on that memory does nothing and all of it
+ * is released at once by PKI_ARENA_reset() or PKI_ARENA_free().
+ *
+ * Objects allocated while the arena is bound MUST NOT be used after
+ * the reset. PKI_Free() recognizes arena memory also after the unbind
+ * and on other threads, and leaves it to the arena. Data that outlives
+ * the request (library initialization, configuration registry, token
+ * snapshots, etc.) is allocated from the heap by suspending the arena
+ * (PKI_ARENA_suspend). Memory allocated by OpenSSL is not affected.
+ */
+
+/* Default size of the arena chunks */
+#define PKI_ARENA_CHUNK_SIZE		65536
+
+typedef struct pki_arena_chunk_st PKI_ARENA_CHUNK;
+
+typedef struct pki_arena_st {
+	/*! \brief Chunks list (the first one is the current) */
+	PKI_ARENA_CHUNK * chunks;
+	/*! \brief Size of the chunks */
+	size_t chunk_size;
+	/*! \brief Arena bound before this one (nested scopes) */
+	struct pki_arena_st * prev;
+	/*! \brief Non-zero while bound to a thread */
+	int bound;
+} PKI_ARENA;
+
+PKI_ARENA * PKI_ARENA_new(size_t chunk_size);
+void PKI_ARENA_free(PKI_ARENA * arena);
+
+void * PKI_ARENA_alloc(PKI_ARENA * arena, size_t size);
+void * PKI_ARENA_realloc(PKI_ARENA * arena, void * ptr, size_t size);
+int PKI_ARENA_owns(const PKI_ARENA * arena, const void * ptr);
+PKI_ARENA * PKI_ARENA_find(const void * ptr);
+size_t PKI_ARENA_size(const void * ptr);
+void PKI_ARENA_reset(PKI_ARENA * arena);
+
+/* Thread binding */
+int PKI_ARENA_bind(PKI_ARENA * arena);
+int PKI_ARENA_unbind(PKI_ARENA * arena);
+PKI_ARENA * PKI_ARENA_get_current(void);
+
+/* Heap allocations while an arena is bound */
+PKI_ARENA * PKI_ARENA_suspend(void);
+void PKI_ARENA_resume(PKI_ARENA * arena);
+
+#endif
@@ -0,0 +1,32 @@
+/* Base64 Encoding and Decoding */
+
+#ifndef _LIBPKI_B64_H
+#define _LIBPKI_B64_H
+
+/*!
+ * \brief Base64 (RFC 4648) codec used by the PKI_MEM and PEM functions
+ *
+ * On x86 processors the encoder and the decoder process 12 (SSSE3) or
+ * 24 (AVX2) bytes per step, the implementation is selected at runtime
+ * and falls back to a table-driven scalar code. The decoder skips line
+ * breaks and blanks while decoding (single pass).
+ */
+
+/* Line length used for multi-line output (as in PEM) */
+#define PKI_B64_LINE_LEN		64
+
+/* Output Sizes */
+size_t PKI_B64_encoded_size(size_t len, int line_len);
+size_t PKI_B64_decoded_size(size_t len);
+
+/* Encoding / Decoding */
+size_t PKI_B64_encode(unsigned char       * dst,
+		      const unsigned char * src,
+		      size_t                len,
+		      int                   line_len);
+
+ssize_t PKI_B64_decode(unsigned char       * dst,
+		       const unsigned char * src,
+		       size_t                len);
+
+#endif
@@ -31,6 +31,47 @@ PKI_DIGEST *PKI_DIGEST_URL_new(const PKI_DIGEST_ALG * alg,
 PKI_DIGEST *PKI_DIGEST_URL_new_by_name(const char * alg_name,
                                        const URL  * url);
 
+/* Batch (many small buffers) */
+int PKI_DIGEST_batch(const PKI_DIGEST_ALG        * alg,
+                     const unsigned char * const * data,
+                     const size_t                * sizes,
+                     size_t                        num,
+                     unsigned char               * out,
+                     size_t                        out_size);
+
+/* Streaming */
+PKI_DIGEST *PKI_DIGEST_init(const PKI_DIGEST_ALG *alg);
+
+int PKI_DIGEST_update(PKI_DIGEST          * dgst,
+                      const unsigned char * data,
+                      size_t                size);
+
+int PKI_DIGEST_update_multi(PKI_DIGEST          ** dgsts,
+                            int                    num,
+                            const unsigned char  * data,
+                            size_t                 size);
+
+int PKI_DIGEST_update_fd(PKI_DIGEST ** dgsts,
+                         int           num,
+                         int           fd);
+
+int PKI_DIGEST_final(PKI_DIGEST *dgst);
+
+PKI_DIGEST *PKI_DIGEST_new_fd(const PKI_DIGEST_ALG * alg,
+                              int                    fd);
+
+/* Parallel (ParallelHash128/256, NIST SP 800-185) */
+PKI_DIGEST *PKI_DIGEST_PARALLEL_new(int                   bits,
+                                    size_t                block,
+                                    int                   threads,
+                                    const unsigned char * data,
+                                    size_t                size);
+
+PKI_DIGEST *PKI_DIGEST_PARALLEL_new_fd(int    bits,
+                                       size_t block,
+                                       int    threads,
+                                       int    fd);
+
 ssize_t PKI_DIGEST_get_size(const PKI_DIGEST_ALG *alg);
 
 int PKI_DIGEST_get_size_by_name(const char *alg_name);
@@ -44,4 +85,11 @@ char * PKI_DIGEST_get_parsed(const PKI_DIGEST *digest);
 /* Default Algorithm */
 #define PKI_DIGEST_DEFAULT_ALG PKI_DIGEST_ALG_SHA256
 
+/* Read buffers size for the file descriptors (two are used) */
+#define PKI_DIGEST_FD_BUFFER_SIZE		(1024 * 1024)
+
+/* Default chunk size and max threads for the parallel digests */
+#define PKI_DIGEST_PARALLEL_BLOCK_SIZE		65536
+#define PKI_DIGEST_PARALLEL_MAX_THREADS		64
+
 #endif
@@ -9,8 +9,13 @@
 #ifndef _LIBPKI_ERR_H
 #define _LIBPKI_ERR_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /// @brief PKI Errors Enum
 typedef enum {
+	// No Error (empty queue)
+	PKI_ERR_NONE		= -1,
 	// General Errors
 	PKI_ERR_UNKNOWN 	= 0,
 	PKI_ERR_GENERAL,
@@ -154,6 +159,8 @@ typedef enum {
 	PKI_ERR_X509_CMS_RECIPIENT_ADD,
 	PKI_ERR_X509_CMS_RECIPIENT_GET,
 	PKI_ERR_X509_CMS_SET_DETACHED,
+	PKI_ERR_X509_CMS_VERIFY,
+	PKI_ERR_X509_CMS_DECRYPT,
 	PKI_ERR_X509_CMS_,
 	// Generic PKI_X509_AUX_DATA Errors
 	PKI_ERR_X509_AUX_DATA_MEMORY_FREE_CB_NULL,
@@ -203,13 +210,57 @@ typedef enum {
 	// CMP Related Errors
 	PKI_ERR_CMP_ATTRIBUTE_UNKNOWN,
 	PKI_ERR_CMP_,
+	// List Boundary
+	PKI_ERR_CODE_SIZE
 } PKI_ERR_CODE;
 
+// Number of errors kept in the per-thread queue
+#define PKI_ERR_QUEUE_SIZE			16
+
+// Max size of the formatted detail message
+#define PKI_ERR_DETAIL_SIZE			256
+
+// Max number of arguments kept for the detail format
+#define PKI_ERR_ARGS_SIZE			16
+
+/// @brief Argument of the detail format (until the detail is read)
+typedef union pki_err_arg_un {
+	int i;
+	long l;
+	long long ll;
+	size_t z;
+	intmax_t j;
+	ptrdiff_t t;
+	double d;
+	const void * p;
+} PKI_ERR_ARG;
+
+/// @brief Error Queue Entry
+typedef struct pki_err_entry_st {
+	// Error Code
+	PKI_ERR_CODE code;
+	// Source file and line where the error was raised
+	const char * file;
+	int line;
+	// Detail message (copy of the info string, formatted when it has
+	// arguments), empty if no info was given
+	char detail[PKI_ERR_DETAIL_SIZE];
+	// Format of the detail and its arguments (the string arguments are
+	// copied in the detail), NULL once the detail is formatted
+	const char * fmt;
+	PKI_ERR_ARG args[PKI_ERR_ARGS_SIZE];
+} PKI_ERR_ENTRY;
+
 // ------------------------- Useful Macros --------------------------- //
 
-// Second Argument is a const char *
+// Evaluates to 1 if there are (up to 16) arguments after the info string
+#define __PKI_ERR_ARGS_N(_0,_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,N,...) N
+
+// Second Argument is a const char * (a format only if followed by arguments,
+// the format is kept and the detail formatted when the error is read)
 #define PKI_ERROR(a,b,args...) \
-  __pki_error(__FILE__, __LINE__, a, b, ## args)
+  __pki_error_ex(__FILE__, __LINE__, a, \
+    __PKI_ERR_ARGS_N(0, ## args, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 0), b, ## args)
 
 #define PKI_ERROR_crypto_get_errno() \
   HSM_get_errno(NULL)
@@ -220,5 +271,20 @@ typedef enum {
 // --------------------- Function Prototypes ------------------------- //
 
 int __pki_error ( const char *file, int line, int err, const char *info, ... );
+int __pki_error_ex ( const char *file, int line, int err, int has_args,
+			const char *info, ... );
+
+const char * PKI_ERR_get_descr(PKI_ERR_CODE code);
+
+PKI_ERR_CODE PKI_ERR_get(PKI_ERR_ENTRY * entry);
+PKI_ERR_CODE PKI_ERR_peek(PKI_ERR_ENTRY * entry);
+PKI_ERR_CODE PKI_ERR_peek_last(PKI_ERR_ENTRY * entry);
+
+int PKI_ERR_count(void);
+void PKI_ERR_clear(void);
+
+const char * PKI_ERR_ENTRY_get_detail(const PKI_ERR_ENTRY * entry);
+
+void PKI_ERR_set_log(int enabled);
 
 #endif
@@ -47,6 +47,15 @@ int PKI_HMAC_update_mem(PKI_HMAC *hmac, PKI_MEM *data);
 
 int PKI_HMAC_finalize(PKI_HMAC *hmac);
 
+int PKI_HMAC_batch(PKI_HMAC                    * hmac,
+                   const unsigned char * const * data,
+                   const size_t                * sizes,
+                   size_t                        num,
+                   unsigned char               * out,
+                   size_t                        out_size);
+
+PKI_MEM *PKI_HMAC_new_data(PKI_MEM *data, PKI_MEM *key, PKI_DIGEST_ALG *digest);
+
 PKI_MEM *PKI_HMAC_get_value(PKI_HMAC *hmac);
 PKI_MEM *PKI_HMAC_get_value_b64(PKI_HMAC *hmac);
 
@@ -14,6 +14,18 @@
 #define PKI_STATUS_NOT_INIT			0
 #define PKI_STATUS_INIT				1
 
+// Subsystems that are initialized on first use
+typedef enum {
+	PKI_INIT_SUBSYSTEM_PROVIDERS = 0,
+	PKI_INIT_SUBSYSTEM_PQC,
+	PKI_INIT_SUBSYSTEM_COMPOSITE,
+	PKI_INIT_SUBSYSTEM_PRQP,
+	PKI_INIT_SUBSYSTEM_SCEP,
+	PKI_INIT_SUBSYSTEM_XML,
+	PKI_INIT_SUBSYSTEM_MYSQL,
+	PKI_INIT_SUBSYSTEM_SIZE
+} PKI_INIT_SUBSYSTEM;
+
 // ===================
 // Function Prototypes
 // ===================
@@ -23,6 +35,11 @@ void PKI_final_all ( void );
 
 int PKI_get_init_status ( void );
 
+int PKI_init_subsystem(PKI_INIT_SUBSYSTEM id);
+int PKI_get_subsystem_status(PKI_INIT_SUBSYSTEM id);
+
+int PKI_init_crypto_methods(void);
+
 int PKI_is_fips_mode();
 int PKI_set_fips_mode(int k);
 
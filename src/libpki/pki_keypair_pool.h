@@ -0,0 +1,42 @@
+/* Pre-generated Keypairs Pool */
+
+#ifndef _LIBPKI_KEYPAIR_POOL_H
+#define _LIBPKI_KEYPAIR_POOL_H
+
+/*!
+ * \brief Pool of pre-generated (software) keypairs
+ *
+ * The pool keeps a queue of keypairs for each configured scheme and
+ * size (RSA bits, or security bits that select the EC curve or the
+ * PQC algorithm, as in PKI_X509_KEYPAIR_new()). Low priority threads
+ * refill a queue up to its high watermark when it drops to its low
+ * watermark, so that server-side key generation is a queue pop.
+ */
+typedef struct pki_keypair_pool_st PKI_KEYPAIR_POOL;
+
+/* Default number of background generation threads */
+#define PKI_KEYPAIR_POOL_THREADS		1
+
+/* Memory Management */
+PKI_KEYPAIR_POOL * PKI_KEYPAIR_POOL_new(int threads);
+void PKI_KEYPAIR_POOL_free(PKI_KEYPAIR_POOL *pool);
+
+/* Queues Configuration */
+int PKI_KEYPAIR_POOL_add_scheme(PKI_KEYPAIR_POOL *pool,
+				PKI_SCHEME_ID     scheme,
+				int               bits,
+				int               low,
+				int               high);
+
+int PKI_KEYPAIR_POOL_fill(PKI_KEYPAIR_POOL *pool);
+
+/* Keypairs */
+PKI_X509_KEYPAIR * PKI_KEYPAIR_POOL_get(PKI_KEYPAIR_POOL *pool,
+					PKI_SCHEME_ID     scheme,
+					int               bits);
+
+int PKI_KEYPAIR_POOL_size(PKI_KEYPAIR_POOL *pool,
+			  PKI_SCHEME_ID     scheme,
+			  int               bits);
+
+#endif
@@ -79,6 +79,8 @@ int PKI_log_init ( PKI_LOG_TYPE type, PKI_LOG_LEVEL level, char *resource,
 
 void PKI_log( int level, const char *fmt, ... );
 
+int PKI_log_is_enabled( int level );
+
 void PKI_log_debug_simple( const char *fmt, ... );
 
 void PKI_log_err_simple( const char *fmt, ... );
@@ -91,10 +93,31 @@ int PKI_log_end( void );
 #define PKI_log_line(a, b, args...) \
 	PKI_log(a, "[%s:%d] " b, __FILE__, __LINE__, ## args)
 
+/* Inline-readable copies of the log configuration (do not set directly) */
+extern int __libpki_log_level;
+extern int __libpki_log_flags;
+
+/* Checks if debug statements are to be processed. When the library is
+ * configured with --disable-debug-log, debug statements are removed at
+ * compile time (arguments are still type-checked) */
+#ifdef DISABLE_DEBUG_LOG
+# define PKI_log_debug_enabled() 0
+#else
+# define PKI_log_debug_enabled() \
+	__builtin_expect((__libpki_log_flags & PKI_LOG_FLAGS_ENABLE_DEBUG) != 0, 0)
+#endif
+
+/* Checks if entries at the given level are to be processed */
+#define PKI_log_level_enabled(l) \
+	__builtin_expect((l) == PKI_LOG_ALWAYS || \
+		((l) > PKI_LOG_NONE && (l) <= __libpki_log_level), 0)
+
 /* Macro To Automatically add [__FILE__:__LINE__]::DEBUG:: to the message */
-#define PKI_log_debug(a, args...) \
-	PKI_log_debug_simple((const char *)"[%s:%d] [%s()] [DEBUG] " a, \
-			     __FILE__, __LINE__, __func__, ## args)
+#define PKI_log_debug(a, args...) do { \
+	if (PKI_log_debug_enabled()) \
+		PKI_log_debug_simple((const char *)"[%s:%d] [%s()] [DEBUG] " a, \
+			     __FILE__, __LINE__, __func__, ## args); \
+	} while (0)
 
 #define PKI_log_err(a, args...) \
 	PKI_log_err_simple((const char *) "[%s:%d] [%s()] [ERROR] " a, \
@@ -104,9 +127,11 @@ int PKI_log_end( void );
 	PKI_log_err_simple("[%s:%d] [%s()] [ERROR] %d:%s", __FILE__, __LINE__, \
 			__func__, HSM_get_errno(a), HSM_get_errdesc(HSM_get_errno(a), a))
 
-#define PKI_DEBUG(a, args...) \
-	PKI_log_debug_simple((const char *)"[%s:%d] [%s()] [DEBUG]: " a, \
-			     __FILE__, __LINE__, __func__, ## args)
+#define PKI_DEBUG(a, args...) do { \
+	if (PKI_log_debug_enabled()) \
+		PKI_log_debug_simple((const char *)"[%s:%d] [%s()] [DEBUG]: " a, \
+			     __FILE__, __LINE__, __func__, ## args); \
+	} while (0)
 
 END_C_DECLS
 
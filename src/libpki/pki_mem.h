@@ -31,6 +31,7 @@ typedef struct pki_mem_st {
 
 void *PKI_Malloc( size_t size );
 void PKI_Free( void *ret );
+void *PKI_Realloc( void *ptr, size_t size );
 void PKI_ZFree ( void *pnt, size_t size );
 void PKI_ZFree_str ( char *str );
 
@@ -63,6 +64,7 @@ PKI_MEM *PKI_MEM_get_url_encoded( PKI_MEM *mem, int skip_newlines);
 PKI_MEM *PKI_MEM_get_url_decoded( PKI_MEM *mem);
 PKI_MEM *PKI_MEM_get_b64_encoded( PKI_MEM *mem, int addNewLines);
 PKI_MEM *PKI_MEM_get_b64_decoded( PKI_MEM *mem, int withNewLines);
+PKI_MEM *PKI_MEM_get_pem_decoded( const PKI_MEM *mem, char *label, size_t label_size);
 
 // Generic Format Encoding / Decoding
 PKI_MEM * PKI_MEM_get_encoded(PKI_MEM *mem, PKI_DATA_FORMAT format, int opt);
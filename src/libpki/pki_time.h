@@ -18,5 +18,20 @@ char *PKI_TIME_get_parsed(const PKI_TIME *t );
 int PKI_TIME_print (const PKI_TIME *time );
 int PKI_TIME_print_fp (const FILE *fp, const PKI_TIME *time );
 
+/* Coarse clock (per thread, formatted once per second) */
+
+/* Size of the local time string ("YYYY-MM-DD HH:MM:SS") */
+#define PKI_TIME_LOG_SIZE	20
+
+/* Size of the DER of a GeneralizedTime ("YYYYMMDDHHMMSSZ") */
+#define PKI_TIME_DER_SIZE	17
+
+time_t PKI_TIME_now_coarse( long *nsec );
+
+const PKI_TIME * PKI_TIME_now( void );
+const unsigned char * PKI_TIME_now_der( size_t *size );
+
+char * PKI_TIME_now_log_s( char *buf, size_t size );
+
 
 #endif
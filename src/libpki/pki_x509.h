@@ -7,6 +7,17 @@
 #include <libpki/drivers/hsm_main.h>
 #endif
 
+// ===========
+// Cache Types
+// ===========
+
+typedef enum {
+	PKI_X509_CACHE_DIGEST_FINGERPRINT	= 0,
+	PKI_X509_CACHE_DIGEST_KEY_HASH,
+} PKI_X509_CACHE_DIGEST;
+
+#define PKI_X509_CACHE_DIGEST_SIZE		4
+
 // ===================
 // Function Prototypes
 // ===================
@@ -22,6 +33,27 @@ void PKI_X509_free ( PKI_X509 *x );
 
 int PKI_X509_set_modified ( PKI_X509 *x );
 
+/*! \brief Drops the cached encoding and digests of a PKI_X509 object */
+void PKI_X509_CACHE_clear ( PKI_X509 *x );
+
+/*! \brief Returns the (cached) DER encoding of a PKI_X509 object. The returned
+ *         buffer belongs to the object and it is valid until the next change */
+const PKI_MEM * PKI_X509_get_der (const PKI_X509 *x );
+
+/*! \brief Copies the (cached) DER encoding of a PKI_X509 object in a new
+ *         PKI_MEM (mem is NULL), in *mem (*mem is NULL) or at its end */
+PKI_MEM * PKI_X509_get_der_copy (const PKI_X509 *x, PKI_MEM **mem );
+
+/*! \brief Returns a copy of a cached digest (NULL if not cached) */
+PKI_DIGEST * PKI_X509_CACHE_get_digest(const PKI_X509           * x,
+                                       PKI_X509_CACHE_DIGEST      type,
+                                       const PKI_DIGEST_ALG     * alg);
+
+/*! \brief Stores a digest in the object's cache */
+int PKI_X509_CACHE_set_digest(const PKI_X509        * x,
+                              PKI_X509_CACHE_DIGEST   type,
+                              const PKI_DIGEST      * digest);
+
 int PKI_X509_set_hsm ( PKI_X509 *x, struct hsm_st *hsm );
 struct hsm_st *PKI_X509_get_hsm (const PKI_X509 *x );
 int PKI_X509_set_reference ( PKI_X509 *x, URL *url );
@@ -128,6 +128,43 @@ int PKI_X509_CMS_stream_write(PKI_IO              * cms_io,
 int PKI_X509_CMS_stream_final(PKI_X509_CMS * cms,
                               PKI_IO       * cms_io);
 
+/* ---------------------- Streaming (PKI_IO) Functions ------------------ */
+
+int PKI_X509_CMS_data_set_io(PKI_X509_CMS    * cms,
+                             PKI_IO          * in,
+                             PKI_IO          * out,
+                             PKI_DATA_FORMAT   format);
+
+int PKI_X509_CMS_data_set_fd(PKI_X509_CMS    * cms,
+                             int               in_fd,
+                             int               out_fd,
+                             PKI_DATA_FORMAT   format);
+
+PKI_X509_CMS * PKI_X509_CMS_get_io(PKI_IO          * io,
+                                   PKI_DATA_FORMAT   format);
+
+int PKI_X509_CMS_verify_io(const PKI_X509_CMS        * const cms,
+                           const PKI_X509_CERT_STACK * const trusted,
+                           PKI_IO                    * content,
+                           PKI_IO                    * out);
+
+int PKI_X509_CMS_verify_fd(const PKI_X509_CMS        * const cms,
+                           const PKI_X509_CERT_STACK * const trusted,
+                           int                         content_fd,
+                           int                         out_fd);
+
+int PKI_X509_CMS_decrypt_io(const PKI_X509_CMS     * const cms,
+                            const PKI_X509_KEYPAIR * const k,
+                            const PKI_X509_CERT    * const x,
+                            PKI_IO                 * content,
+                            PKI_IO                 * out);
+
+int PKI_X509_CMS_decrypt_fd(const PKI_X509_CMS     * const cms,
+                            const PKI_X509_KEYPAIR * const k,
+                            const PKI_X509_CERT    * const x,
+                            int                      content_fd,
+                            int                      out_fd);
+
 PKI_X509_CMS * PKI_X509_CMS_wrap(PKI_X509_CMS      ** cms,
                                  PKI_X509_CMS_TYPE    type);
 
@@ -76,6 +76,9 @@ typedef struct pki_x509_all_callbacks_st {
 	const PKI_X509_CALLBACKS * x509_prqp_resp_cb_set;
 } PKI_X509_CALLBACKS_FULL;
 
+/* Cached encodings and digests (see pki_x509.c) */
+struct pki_x509_cache_st;
+
 /* PKI_X509 general object */
 typedef struct pki_x509_st {
 
@@ -115,6 +118,9 @@ typedef struct pki_x509_st {
 	/* For KeyPairs, indicates the need for digest when signing */
 	int signature_digest_required;
 
+	/* Cached DER encoding and digests, dropped by PKI_X509_set_modified() */
+	struct pki_x509_cache_st * cache;
+
 } PKI_X509;
 
 /* End of _LIBPKI_PKI_X509_DATA_ST_H */
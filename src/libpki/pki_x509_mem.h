@@ -3,7 +3,13 @@
 #ifndef _LIBPKI_PKI_X509_MEM_H
 #define _LIBPKI_PKI_X509_MEM_H
 
+/* Bulk loader: maximum number of threads and minimum objects per thread */
+#define PKI_X509_BULK_MAX_THREADS		64
+#define PKI_X509_BULK_MIN_OBJECTS		32
+
 /* --------------------------- PKI_MEM get ------------------------------- */
+PKI_DATA_FORMAT PKI_X509_get_mem_format(const PKI_MEM *mem, PKI_DATATYPE *type);
+
 PKI_X509 *PKI_X509_get_mem ( PKI_MEM *mem, PKI_DATATYPE type, 
 					PKI_DATA_FORMAT format, PKI_CRED *cred, HSM *hsm );
 
@@ -13,6 +19,9 @@ void *PKI_X509_get_mem_value ( PKI_MEM *mem, PKI_DATATYPE type,
 PKI_X509_STACK *PKI_X509_STACK_get_mem ( PKI_MEM *mem, PKI_DATATYPE type,
 					PKI_DATA_FORMAT format, PKI_CRED *cred, HSM *hsm );
 
+PKI_X509_STACK *PKI_X509_STACK_get_mem_bulk ( PKI_MEM *mem, PKI_DATATYPE type,
+			PKI_DATA_FORMAT format, int threads, PKI_CRED *cred, HSM *hsm );
+
 /* --------------------------- PKI_MEM put ------------------------------- */
 PKI_MEM *PKI_X509_put_mem ( PKI_X509 *x, PKI_DATA_FORMAT format, 
 					PKI_MEM **pki_mem, PKI_CRED *cred );
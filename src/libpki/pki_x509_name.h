@@ -27,4 +27,27 @@ PKI_X509_NAME_TYPE PKI_X509_NAME_RDN_type_id ( const PKI_X509_NAME_RDN *rdn );
 const char *PKI_X509_NAME_RDN_type_text ( const PKI_X509_NAME_RDN *rdn );
 const char *PKI_X509_NAME_RDN_type_descr ( const PKI_X509_NAME_RDN *rdn );
 
+/* Interned names */
+
+/* Maximum number of interned encodings */
+#define PKI_X509_NAME_INTERN_MAX	65536
+
+typedef struct pki_x509_name_ref_st PKI_X509_NAME_REF;
+
+const PKI_X509_NAME_REF * PKI_X509_NAME_intern ( const PKI_X509_NAME *name );
+
+int PKI_X509_NAME_REF_cmp ( const PKI_X509_NAME_REF *a,
+			    const PKI_X509_NAME_REF *b );
+
+const PKI_X509_NAME * PKI_X509_NAME_REF_get_name ( const PKI_X509_NAME_REF *ref );
+uint64_t PKI_X509_NAME_REF_get_hash ( const PKI_X509_NAME_REF *ref );
+
+const unsigned char * PKI_X509_NAME_REF_get_canon ( const PKI_X509_NAME_REF *ref,
+						    size_t *size );
+const unsigned char * PKI_X509_NAME_REF_get_name_hash ( const PKI_X509_NAME_REF *ref,
+							size_t *size );
+
+int PKI_X509_NAME_intern_num ( void );
+void PKI_X509_NAME_intern_flush ( void );
+
 #endif
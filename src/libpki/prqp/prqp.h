@@ -177,6 +177,8 @@ static char *prqp_exts[] = {
 #include <libpki/prqp/prqp_lib.h>
 #include <libpki/prqp/http_client.h>
 #include <libpki/prqp/prqp_srv.h>
+#include <libpki/prqp/prqp_cache.h>
+#include <libpki/prqp/prqp_server.h>
 
 
 /* Macros for PKI_MEM conversion */
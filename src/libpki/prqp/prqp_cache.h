@@ -0,0 +1,44 @@
+/*
+ * PKI Resource Query Protocol (PRQP) - Service Map Cache
+ * (c) 2006-2010 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ */
+
+#ifndef _LIBPKI_X509_PRQP_CACHE_H
+#define _LIBPKI_X509_PRQP_CACHE_H
+
+/*!
+ * \brief Cache of the resolved PRQP services (service -> URLs) per CA
+ *
+ * The entries are keyed by the CA certificate identifier and the RQA
+ * address. The URLs are kept until the nextUpdate of the PRQP response
+ * (or for the default lifetime) and are refreshed in the background
+ * before they expire, as long as they are used.
+ */
+
+/* Lifetime (secs) of responses without nextUpdate */
+#define PKI_PRQP_CACHE_DEFAULT_TTL		3600
+
+/* Upper limit for the lifetime (secs) */
+#define PKI_PRQP_CACHE_MAX_TTL			(7 * 86400)
+
+/* Entries are refreshed after 80% of their lifetime */
+#define PKI_PRQP_CACHE_REFRESH_PCT		80
+
+/* Delay (secs) before retrying a failed refresh */
+#define PKI_PRQP_CACHE_RETRY			30
+
+/* Maximum number of cached CAs */
+#define PKI_PRQP_CACHE_MAX_CAS			64
+
+PKI_STACK * PKI_PRQP_CACHE_get_service_sk ( PKI_X509_CERT * caCert,
+					    const char    * srv,
+					    const char    * url_s );
+
+int PKI_PRQP_CACHE_set_default_ttl ( int secs );
+
+int PKI_PRQP_CACHE_invalidate ( PKI_X509_CERT * caCert );
+
+void PKI_PRQP_CACHE_flush ( void );
+
+#endif
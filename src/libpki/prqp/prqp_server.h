@@ -0,0 +1,77 @@
+/*
+ * PKI Resource Query Protocol (PRQP) - Embedded Responder
+ * (c) 2006-2010 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ */
+
+#ifndef _LIBPKI_X509_PRQP_SERVER_H
+#define _LIBPKI_X509_PRQP_SERVER_H
+
+/*!
+ * \brief PRQP responder (RQA) for a configured set of CAs
+ *
+ * The CA -> service map is loaded from an XML configuration (or added
+ * with PKI_PRQP_SERVER_add_service) and the DER encoding of the status,
+ * the CA identifier and the service tokens is computed once. For each
+ * request only the response data carrying the nonce and the times is
+ * assembled around these fragments and signed.
+ *
+ * The configuration must be completed before serving the requests, the
+ * server can then be used by multiple threads (e.g., the workers of a
+ * PKI_HTTP_SERVER, see PKI_PRQP_SERVER_attach).
+ *
+ * Configuration example:
+ *
+ * <pki:prqpConfig xmlns:pki="http://www.openca.org/openca/pki/1/0/0">
+ *   <pki:token>rqa</pki:token>
+ *   <pki:validity>3600</pki:validity>
+ *   <pki:ca>
+ *     <pki:caCert>file:///etc/pki/ca.pem</pki:caCert>
+ *     <pki:service>
+ *       <pki:name>scepGateway</pki:name>
+ *       <pki:url>http://ca.openca.org/scep</pki:url>
+ *     </pki:service>
+ *   </pki:ca>
+ * </pki:prqpConfig>
+ */
+
+/* Default lifetime (secs) of the responses (nextUpdate) */
+#define PKI_PRQP_SERVER_VALIDITY	3600
+
+/* Maximum number of services per CA */
+#define PKI_PRQP_SERVER_MAX_SERVICES	64
+
+typedef struct pki_prqp_server_st PKI_PRQP_SERVER;
+
+PKI_PRQP_SERVER * PKI_PRQP_SERVER_new ( void );
+void PKI_PRQP_SERVER_free ( PKI_PRQP_SERVER * srv );
+
+int PKI_PRQP_SERVER_load_config ( PKI_PRQP_SERVER * srv,
+				  const char      * url_s,
+				  const char      * token_dir );
+
+int PKI_PRQP_SERVER_set_signer ( PKI_PRQP_SERVER     * srv,
+				 PKI_X509_KEYPAIR    * k,
+				 PKI_X509_CERT       * x,
+				 PKI_DIGEST_ALG      * dgst,
+				 PKI_X509_CERT_STACK * certs );
+
+int PKI_PRQP_SERVER_set_token ( PKI_PRQP_SERVER * srv,
+				PKI_TOKEN       * tk,
+				PKI_DIGEST_ALG  * dgst );
+
+int PKI_PRQP_SERVER_set_validity ( PKI_PRQP_SERVER * srv, long secs );
+
+int PKI_PRQP_SERVER_add_service ( PKI_PRQP_SERVER * srv,
+				  PKI_X509_CERT   * caCert,
+				  const char      * service,
+				  const char      * url );
+
+PKI_MEM * PKI_PRQP_SERVER_process ( PKI_PRQP_SERVER * srv,
+				    const PKI_MEM   * req );
+
+int PKI_PRQP_SERVER_attach ( PKI_PRQP_SERVER * srv,
+			     PKI_HTTP_SERVER * http,
+			     const char      * path );
+
+#endif
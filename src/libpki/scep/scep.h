@@ -101,6 +101,7 @@ typedef enum {
 #include <libpki/scep/pki_x509_scep_data.h>
 #include <libpki/scep/pki_x509_scep_attrs.h>
 #include <libpki/scep/pki_x509_scep_msg.h>
+#include <libpki/scep/scep_server.h>
 
 
 #endif
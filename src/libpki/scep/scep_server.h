@@ -0,0 +1,113 @@
+/*
+ * OpenCA SCEP - Server side message pipeline
+ * (c) 2009 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ */
+
+#ifndef _LIBPKI_SCEP_SERVER_H
+#define _LIBPKI_SCEP_SERVER_H
+
+/*!
+ * \brief SCEP server (CA/RA side) message pipeline
+ *
+ * A PKIOperation request is decoded once and the same structures are
+ * used by all the stages: the signed attributes and the signer
+ * certificate are read from the outer SignedData, the signature is
+ * verified over the embedded content, the EnvelopedData is decrypted
+ * with the RA key and the certificate request is passed to the issuance
+ * callback. The CertRep is encrypted for the request's signer with the
+ * same content cipher and signed by the RA.
+ *
+ * The server is configured once (RA credentials and issuance callback)
+ * and can then be used by multiple threads: when attached to a
+ * PKI_HTTP_SERVER the decrypt/issue/sign stages run on its worker pool.
+ * Each stage keeps latency counters (see PKI_SCEP_SERVER_get_stats).
+ */
+
+/* Size of the senderNonce of the responses */
+#define PKI_SCEP_SERVER_NONCE_SIZE	NONCE_SIZE
+
+/* HTTP Content Types */
+#define PKI_SCEP_SERVER_TYPE_MESSAGE	"application/x-pki-message"
+#define PKI_SCEP_SERVER_TYPE_CA_RA_CERT	"application/x-x509-ca-ra-cert"
+#define PKI_SCEP_SERVER_TYPE_CAPS	"text/plain"
+
+/* Capabilities returned for GetCACaps */
+#define PKI_SCEP_SERVER_CAPS		"POSTPKIOperation\nRenewal\nSHA-256\nAES\nSCEPStandard\n"
+
+typedef enum {
+	PKI_SCEP_SERVER_STAGE_DECODE		= 0,
+	PKI_SCEP_SERVER_STAGE_VERIFY,
+	PKI_SCEP_SERVER_STAGE_DECRYPT,
+	PKI_SCEP_SERVER_STAGE_ISSUE,
+	PKI_SCEP_SERVER_STAGE_ENCRYPT,
+	PKI_SCEP_SERVER_STAGE_SIGN,
+	PKI_SCEP_SERVER_STAGE_NUM
+} PKI_SCEP_SERVER_STAGE;
+
+typedef struct pki_scep_server_stats_st {
+	/* Processed requests and CertRep status */
+	uint64_t requests;
+	uint64_t success;
+	uint64_t pending;
+	uint64_t failure;
+	/* Requests that could not be answered (no CertRep) */
+	uint64_t errors;
+	/* Per-stage executions and latency (nanosecs) */
+	uint64_t stage_count[PKI_SCEP_SERVER_STAGE_NUM];
+	uint64_t stage_ns[PKI_SCEP_SERVER_STAGE_NUM];
+	uint64_t stage_max_ns[PKI_SCEP_SERVER_STAGE_NUM];
+} PKI_SCEP_SERVER_STATS;
+
+typedef struct pki_scep_server_st PKI_SCEP_SERVER;
+
+/*!
+ * \brief Issuance callback
+ *
+ * Called for PKCSReq and RenewalReq messages with the (decrypted and
+ * self-signature checked) request and the certificate that signed the
+ * message. On SCEP_STATUS_SUCCESS the issued certificate is returned in
+ * *issued (ownership is transferred to the server), on
+ * SCEP_STATUS_FAILURE the reason can be set in *fail (badRequest by
+ * default). The callback can be invoked by multiple threads at once.
+ */
+typedef SCEP_STATUS (*PKI_SCEP_SERVER_ISSUE_CB)(const PKI_X509_REQ  * req,
+						const PKI_X509_CERT * signer,
+						SCEP_MESSAGE_TYPE     type,
+						const char          * trans_id,
+						PKI_X509_CERT      ** issued,
+						SCEP_FAILURE        * fail,
+						void                * ctx);
+
+PKI_SCEP_SERVER * PKI_SCEP_SERVER_new ( void );
+void PKI_SCEP_SERVER_free ( PKI_SCEP_SERVER * srv );
+
+int PKI_SCEP_SERVER_set_ra ( PKI_SCEP_SERVER     * srv,
+			     PKI_X509_KEYPAIR    * k,
+			     PKI_X509_CERT       * x,
+			     PKI_DIGEST_ALG      * dgst,
+			     PKI_X509_CERT_STACK * ca_certs );
+
+int PKI_SCEP_SERVER_set_token ( PKI_SCEP_SERVER * srv,
+				PKI_TOKEN       * tk,
+				PKI_DIGEST_ALG  * dgst );
+
+int PKI_SCEP_SERVER_set_issue_cb ( PKI_SCEP_SERVER          * srv,
+				   PKI_SCEP_SERVER_ISSUE_CB   cb,
+				   void                     * ctx );
+
+PKI_MEM * PKI_SCEP_SERVER_process ( PKI_SCEP_SERVER * srv,
+				    const PKI_MEM   * req );
+
+PKI_MEM * PKI_SCEP_SERVER_get_ca_certs ( const PKI_SCEP_SERVER * srv );
+
+int PKI_SCEP_SERVER_get_stats ( const PKI_SCEP_SERVER * srv,
+				PKI_SCEP_SERVER_STATS * stats );
+
+void PKI_SCEP_SERVER_reset_stats ( PKI_SCEP_SERVER * srv );
+
+int PKI_SCEP_SERVER_attach ( PKI_SCEP_SERVER * srv,
+			     PKI_HTTP_SERVER * http,
+			     const char      * path );
+
+#endif
@@ -27,6 +27,9 @@
 
 /*!
  * \brief Data structure for PKI_STACK nodes (INTERNAL ONLY)
+ *
+ * The PKI_STACK is now backed by an array, this type is not used by the
+ * library anymore and it is kept for source compatibility only.
  */
 typedef struct pki_stack_node_st {
 	struct pki_stack_node_st *next;
@@ -47,10 +50,10 @@ typedef struct pki_stack_st {
 	/*!  \brief Number of elements in the PKI_STACK */
 	int elements;
 
-	/*! \brief Pointer to the first node of the PKI_STACK */
-	PKI_STACK_NODE *head;
-	/*! \brief Pointer to the last node of the PKI_STACK */
-	PKI_STACK_NODE *tail;
+	/*! \brief Array of pointers to the stored elements */
+	void **data;
+	/*! \brief Number of allocated slots in the array */
+	int size;
 
 	/*! \brief Pointer to the function called to free the data object */
 	void (*free)( void *);
@@ -65,6 +68,7 @@ int     PKI_STACK_free ( PKI_STACK * st );
 int     PKI_STACK_free_all ( PKI_STACK * st );
 
 int     PKI_STACK_elements ( PKI_STACK *st );
+int     PKI_STACK_reserve ( PKI_STACK *st, int num );
 
 int     PKI_STACK_push ( PKI_STACK *st, void *obj );
 
@@ -0,0 +1,57 @@
+/* TOKEN Handle (hot-reloadable tokens) Management Functions */
+
+#ifndef _LIBPKI_TOKEN_HANDLE_HEADERS_H
+#define _LIBPKI_TOKEN_HANDLE_HEADERS_H
+
+/*!
+ * \brief Hot-reloadable handle for a configured PKI_TOKEN
+ *
+ * The handle holds the current token snapshot. Readers acquire a
+ * reference-counted snapshot without taking any lock, reloads build a
+ * new token on the side and swap it in atomically: operations that
+ * are using the old snapshot complete with it and the old token is
+ * freed when its last reference is released.
+ */
+typedef struct pki_token_handle_st PKI_TOKEN_HANDLE;
+
+/*! \brief Immutable token snapshot acquired from a PKI_TOKEN_HANDLE */
+typedef struct pki_token_snapshot_st PKI_TOKEN_SNAPSHOT;
+
+/*!
+ * \brief Setup callback executed on every (re)loaded token before it
+ *        is published (e.g., to set the credentials and login). The
+ *        callback returns PKI_OK, or PKI_ERR to discard the token.
+ */
+typedef int (*PKI_TOKEN_HANDLE_SETUP_CB)(PKI_TOKEN *tk, void *arg);
+
+/* Default polling interval for the background reload (msecs) */
+#define PKI_TOKEN_HANDLE_WATCH_INTERVAL		1000
+
+/* --------------------------- Handle ------------------------------ */
+
+PKI_TOKEN_HANDLE * PKI_TOKEN_HANDLE_new(const char * const config_dir,
+					const char * const name,
+					PKI_TOKEN_HANDLE_SETUP_CB setup_cb,
+					void * setup_arg);
+
+void PKI_TOKEN_HANDLE_free(PKI_TOKEN_HANDLE *h);
+
+int PKI_TOKEN_HANDLE_reload(PKI_TOKEN_HANDLE *h);
+int PKI_TOKEN_HANDLE_refresh(PKI_TOKEN_HANDLE *h);
+
+int PKI_TOKEN_HANDLE_watch_start(PKI_TOKEN_HANDLE *h, int interval_ms);
+int PKI_TOKEN_HANDLE_watch_stop(PKI_TOKEN_HANDLE *h);
+
+unsigned long PKI_TOKEN_HANDLE_get_generation(const PKI_TOKEN_HANDLE *h);
+
+/* -------------------------- Snapshots ---------------------------- */
+
+PKI_TOKEN_SNAPSHOT * PKI_TOKEN_HANDLE_acquire(PKI_TOKEN_HANDLE *h);
+
+void PKI_TOKEN_SNAPSHOT_release(PKI_TOKEN_SNAPSHOT *s);
+
+PKI_TOKEN * PKI_TOKEN_SNAPSHOT_get_token(const PKI_TOKEN_SNAPSHOT *s);
+
+unsigned long PKI_TOKEN_SNAPSHOT_get_generation(const PKI_TOKEN_SNAPSHOT *s);
+
+#endif
@@ -0,0 +1,504 @@
+/* src/net/db.c */
+/*
+ * Database URL Queries and Connection Pools (MySQL/PostgreSQL)
+ * Copyright (c) 2007 by Massimiliano Pala and OpenCA Project
+ * OpenCA Licensed Code
+ */
+
+#include <libpki/pki.h>
+
+/*
+ * NOTE: pools, connections and cached statements outlive the single
+ *       requests, their memory is allocated with calloc()/strdup()
+ *       directly so it is never taken from a request arena.
+ */
+
+struct pki_db_pool_st {
+	const PKI_DB_POOL_CALLBACKS * cb;
+	PKI_MUTEX lock;
+	PKI_DB_CONN * idle;
+	int idle_num;
+};
+
+// ==================
+// Internal Functions
+// ==================
+
+// Keywords that are never accepted as names
+static const char * _db_keywords[] = {
+	"SELECT", "FROM", "WHERE", "UNION", "INTO", "VALUES", "SET",
+	"AND", "OR", "NOT", "AS", "ON", "JOIN", "LIMIT", "ORDER", "GROUP",
+	"HAVING", "INSERT", "UPDATE", "DELETE", "DROP", NULL
+};
+
+// An identifier, optionally qualified (e.g., "certs.data")
+static int _db_is_ident(const char *s, size_t len) {
+
+	size_t i = 0;
+
+	if (len == 0) return 0;
+
+	for (i = 0; i < len; i++) {
+		if (s[i] == '.') {
+			if (i == 0 || i == len - 1 || s[i-1] == '.') return 0;
+		} else if (isdigit((unsigned char) s[i])) {
+			if (i == 0 || s[i-1] == '.') return 0;
+		} else if (!isalpha((unsigned char) s[i]) && s[i] != '_') {
+			return 0;
+		}
+	}
+
+	for (i = 0; _db_keywords[i] != NULL; i++) {
+		if (strlen(_db_keywords[i]) == len
+				&& strncasecmp(_db_keywords[i], s, len) == 0) return 0;
+	}
+
+	return 1;
+}
+
+// Table, column and attribute names are part of the SQL text, lists
+// are comma-separated identifiers (or "*") without spaces
+static int _db_is_name(const char *s, int list) {
+
+	const char *end = NULL;
+	size_t len = 0;
+
+	if (!s || !*s) return 0;
+
+	if (!list) return _db_is_ident(s, strlen(s));
+
+	for (;;) {
+		end = strchr(s, ',');
+		len = end ? (size_t)(end - s) : strlen(s);
+
+		if (!(len == 1 && *s == '*') && !_db_is_ident(s, len)) return 0;
+
+		if (!end) break;
+		s = end + 1;
+	}
+
+	return 1;
+}
+
+static char * _db_strndup(const char *s, size_t len) {
+
+	char *ret = NULL;
+
+	if ((ret = PKI_Malloc(len + 1)) == NULL) return NULL;
+	memcpy(ret, s, len);
+	ret[len] = '\x0';
+
+	return ret;
+}
+
+static char * _db_dsn(const URL *url) {
+
+	char *ret = NULL;
+	char *dbname = NULL;
+	size_t len = 0;
+
+	dbname = parse_url_dbname(url);
+
+	len = strlen(url->usr ? url->usr : "") + strlen(url->pwd ? url->pwd : "")
+		+ strlen(url->addr ? url->addr : "") + strlen(dbname ? dbname : "") + 32;
+
+	if ((ret = calloc(1, len)) != NULL) {
+		snprintf(ret, len, "%s\n%s\n%s\n%d\n%s", url->usr ? url->usr : "",
+			url->pwd ? url->pwd : "", url->addr ? url->addr : "", url->port,
+			dbname ? dbname : "");
+	}
+
+	if (dbname) PKI_Free(dbname);
+
+	return ret;
+}
+
+static void _db_conn_close(PKI_DB_CONN *conn) {
+
+	PKI_DB_STMT *st = NULL;
+
+	while ((st = conn->stmts) != NULL) {
+		conn->stmts = st->next;
+		if (conn->pool->cb->stmt_free) conn->pool->cb->stmt_free(conn->handle, st->stmt);
+		free(st->sql);
+		free(st);
+	}
+
+	if (conn->handle) conn->pool->cb->close(conn->handle);
+
+	free(conn->dsn);
+	free(conn);
+}
+
+// ==================
+// Exported Functions
+// ==================
+
+/*! \brief Parses the query shape (table, attributes and conditions) from a DB URL */
+
+PKI_DB_QUERY * PKI_DB_QUERY_new_url ( const URL * url ) {
+
+	PKI_DB_QUERY *ret = NULL;
+	const char *p = NULL, *eq = NULL, *end = NULL;
+	size_t len = 0;
+
+	if (!url || !url->path) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((ret = PKI_Malloc(sizeof(PKI_DB_QUERY))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	ret->dbname = parse_url_dbname(url);
+	ret->table = parse_url_table(url);
+	if (url->attrs) ret->attrs = _db_strndup(url->attrs, strlen(url->attrs));
+
+	if (!_db_is_name(ret->table, 0) || (ret->attrs && !_db_is_name(ret->attrs, 1))) {
+		PKI_ERROR(PKI_ERR_URI_PARSE, "Invalid table or attributes in DB URL");
+		PKI_DB_QUERY_free(ret);
+		return NULL;
+	}
+
+	// The conditions are in the last component of the path
+	if ((p = strrchr(url->path, '/')) != NULL) p++;
+	else p = url->path;
+
+	while (*p == '(') {
+
+		if ((eq = strchr(p, '=')) == NULL || (end = strchr(eq, ')')) == NULL) break;
+
+		if (ret->params_num >= PKI_DB_QUERY_MAX_PARAMS) {
+			PKI_ERROR(PKI_ERR_PARAM_RANGE, "Too many conditions in DB URL");
+			PKI_DB_QUERY_free(ret);
+			return NULL;
+		}
+
+		// Values can be quoted
+		len = (size_t)(end - eq - 1);
+		if (len >= 2 && eq[1] == '"' && end[-1] == '"') {
+			ret->vals[ret->params_num] = _db_strndup(eq + 2, len - 2);
+		} else {
+			ret->vals[ret->params_num] = _db_strndup(eq + 1, len);
+		}
+		ret->cols[ret->params_num] = _db_strndup(p + 1, (size_t)(eq - p - 1));
+
+		if (!_db_is_name(ret->cols[ret->params_num++], 0)) {
+			PKI_ERROR(PKI_ERR_URI_PARSE, "Invalid column name in DB URL");
+			PKI_DB_QUERY_free(ret);
+			return NULL;
+		}
+
+		p = end + 1;
+	}
+
+	return ret;
+}
+
+/*! \brief Frees a PKI_DB_QUERY */
+
+void PKI_DB_QUERY_free ( PKI_DB_QUERY * q ) {
+
+	int i = 0;
+
+	if (!q) return;
+
+	if (q->dbname) PKI_Free(q->dbname);
+	if (q->table) PKI_Free(q->table);
+	if (q->attrs) PKI_Free(q->attrs);
+
+	for (i = 0; i < q->params_num; i++) {
+		if (q->cols[i]) PKI_Free(q->cols[i]);
+		if (q->vals[i]) PKI_Free(q->vals[i]);
+	}
+
+	PKI_Free(q);
+}
+
+/*!
+ * \brief Returns the SQL text (with placeholders) for the query shape
+ *
+ * The SELECT statement takes the condition values as parameters. The PUT
+ * statement is an INSERT (no conditions) or an UPDATE, the data is its
+ * first parameter followed by the condition values.
+ */
+
+char * PKI_DB_QUERY_get_sql ( const PKI_DB_QUERY * q, PKI_DB_QUERY_TYPE type,
+				PKI_DB_PARAM_STYLE style ) {
+
+	PKI_MEM *buf = NULL;
+	char tmp[256];
+	char *ret = NULL;
+	int i = 0, n = 0;
+
+	if (!q || !q->table || !q->attrs) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((buf = PKI_MEM_new_null()) == NULL) return NULL;
+
+	if (type == PKI_DB_QUERY_SELECT) {
+		PKI_MEM_add(buf, (const unsigned char *) "SELECT ", 7);
+		PKI_MEM_add(buf, (const unsigned char *) q->attrs, strlen(q->attrs));
+		PKI_MEM_add(buf, (const unsigned char *) " FROM ", 6);
+		PKI_MEM_add(buf, (const unsigned char *) q->table, strlen(q->table));
+	} else if (q->params_num == 0) {
+		n++;
+		snprintf(tmp, sizeof(tmp), ") VALUES (%s)", style == PKI_DB_PARAM_DOLLAR ? "$1" : "?");
+		PKI_MEM_add(buf, (const unsigned char *) "INSERT INTO ", 12);
+		PKI_MEM_add(buf, (const unsigned char *) q->table, strlen(q->table));
+		PKI_MEM_add(buf, (const unsigned char *) " (", 2);
+		PKI_MEM_add(buf, (const unsigned char *) q->attrs, strlen(q->attrs));
+		PKI_MEM_add(buf, (const unsigned char *) tmp, strlen(tmp));
+	} else {
+		n++;
+		snprintf(tmp, sizeof(tmp), "=%s", style == PKI_DB_PARAM_DOLLAR ? "$1" : "?");
+		PKI_MEM_add(buf, (const unsigned char *) "UPDATE ", 7);
+		PKI_MEM_add(buf, (const unsigned char *) q->table, strlen(q->table));
+		PKI_MEM_add(buf, (const unsigned char *) " SET ", 5);
+		PKI_MEM_add(buf, (const unsigned char *) q->attrs, strlen(q->attrs));
+		PKI_MEM_add(buf, (const unsigned char *) tmp, strlen(tmp));
+	}
+
+	for (i = 0; i < q->params_num; i++) {
+		if (style == PKI_DB_PARAM_DOLLAR) snprintf(tmp, sizeof(tmp), "%s%s=$%d",
+				i == 0 ? " WHERE " : " AND ", q->cols[i], ++n);
+		else snprintf(tmp, sizeof(tmp), "%s%s=?", i == 0 ? " WHERE " : " AND ", q->cols[i]);
+		PKI_MEM_add(buf, (const unsigned char *) tmp, strlen(tmp));
+	}
+
+	if ((ret = PKI_Malloc(buf->size + 1)) != NULL) memcpy(ret, buf->data, buf->size);
+
+	PKI_MEM_free(buf);
+
+	return ret;
+}
+
+/*! \brief Allocates a new (empty) connection pool */
+
+PKI_DB_POOL * PKI_DB_POOL_new ( const PKI_DB_POOL_CALLBACKS * cb ) {
+
+	PKI_DB_POOL *ret = NULL;
+
+	if (!cb || !cb->connect || !cb->close) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((ret = calloc(1, sizeof(PKI_DB_POOL))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	ret->cb = cb;
+	PKI_MUTEX_init(&ret->lock);
+
+	return ret;
+}
+
+/*! \brief Closes the idle connections and frees the pool */
+
+void PKI_DB_POOL_free ( PKI_DB_POOL * pool ) {
+
+	if (!pool) return;
+
+	PKI_DB_POOL_flush(pool);
+	PKI_MUTEX_destroy(&pool->lock);
+
+	free(pool);
+}
+
+/*! \brief Closes all the idle connections of the pool */
+
+void PKI_DB_POOL_flush ( PKI_DB_POOL * pool ) {
+
+	PKI_DB_CONN *conn = NULL, *list = NULL;
+
+	if (!pool) return;
+
+	PKI_MUTEX_acquire(&pool->lock);
+	list = pool->idle;
+	pool->idle = NULL;
+	pool->idle_num = 0;
+	PKI_MUTEX_release(&pool->lock);
+
+	while ((conn = list) != NULL) {
+		list = conn->next;
+		_db_conn_close(conn);
+	}
+}
+
+/*! \brief Returns the number of idle connections in the pool */
+
+int PKI_DB_POOL_idle_num ( PKI_DB_POOL * pool ) {
+
+	int ret = 0;
+
+	if (!pool) return -1;
+
+	PKI_MUTEX_acquire(&pool->lock);
+	ret = pool->idle_num;
+	PKI_MUTEX_release(&pool->lock);
+
+	return ret;
+}
+
+/*!
+ * \brief Returns a connection for the URL's DSN (user, host, port and db)
+ *
+ * Idle connections are reused (most recently used first), the ones that
+ * have been idle for PKI_DB_POOL_PING_INTERVAL seconds are checked first.
+ * A new connection is opened when no idle one is available.
+ */
+
+PKI_DB_CONN * PKI_DB_POOL_get ( PKI_DB_POOL * pool, const URL * url ) {
+
+	PKI_DB_CONN *conn = NULL, **pp = NULL;
+	char *dsn = NULL;
+	time_t now = 0;
+
+	if (!pool || !url) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((dsn = _db_dsn(url)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	for (;;) {
+
+		PKI_MUTEX_acquire(&pool->lock);
+		for (pp = &pool->idle; *pp != NULL; pp = &(*pp)->next) {
+			if (strcmp((*pp)->dsn, dsn) == 0) break;
+		}
+		if ((conn = *pp) != NULL) {
+			*pp = conn->next;
+			conn->next = NULL;
+			pool->idle_num--;
+		}
+		PKI_MUTEX_release(&pool->lock);
+
+		if (!conn) break;
+
+		now = time(NULL);
+		if (now - conn->last_used < PKI_DB_POOL_PING_INTERVAL || !pool->cb->ping
+				|| pool->cb->ping(conn->handle) == PKI_OK) {
+			free(dsn);
+			return conn;
+		}
+
+		// Stale connection, let's try the next one
+		PKI_DEBUG("Closing stale DB connection");
+		_db_conn_close(conn);
+	}
+
+	if ((conn = calloc(1, sizeof(PKI_DB_CONN))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		free(dsn);
+		return NULL;
+	}
+
+	conn->dsn = dsn;
+	conn->pool = pool;
+
+	if ((conn->handle = pool->cb->connect(url)) == NULL) {
+		PKI_log_err("Can not connect to the DB (%s)", url->addr ? url->addr : "local");
+		_db_conn_close(conn);
+		return NULL;
+	}
+
+	return conn;
+}
+
+/*!
+ * \brief Returns a connection to the pool
+ *
+ * Connections that are not reusable (e.g., after a communication error)
+ * or that exceed the PKI_DB_POOL_MAX_IDLE limit for their DSN are closed.
+ */
+
+void PKI_DB_POOL_put ( PKI_DB_CONN * conn, int reusable ) {
+
+	PKI_DB_POOL *pool = NULL;
+	PKI_DB_CONN *c = NULL;
+	int num = 0;
+
+	if (!conn) return;
+
+	pool = conn->pool;
+
+	if (reusable) {
+
+		conn->last_used = time(NULL);
+
+		PKI_MUTEX_acquire(&pool->lock);
+		for (c = pool->idle; c != NULL; c = c->next) {
+			if (strcmp(c->dsn, conn->dsn) == 0) num++;
+		}
+		if (num < PKI_DB_POOL_MAX_IDLE) {
+			conn->next = pool->idle;
+			pool->idle = conn;
+			pool->idle_num++;
+			conn = NULL;
+		}
+		PKI_MUTEX_release(&pool->lock);
+	}
+
+	if (conn) _db_conn_close(conn);
+}
+
+/*! \brief Returns the statement prepared on the connection for the SQL text */
+
+void * PKI_DB_CONN_get_stmt ( PKI_DB_CONN * conn, const char * sql ) {
+
+	PKI_DB_STMT *st = NULL;
+
+	if (!conn || !sql) return NULL;
+
+	for (st = conn->stmts; st != NULL; st = st->next) {
+		if (strcmp(st->sql, sql) == 0) return st->stmt;
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Caches a statement prepared on the connection
+ *
+ * When PKI_DB_CONN_MAX_STMTS statements are cached, the oldest one is
+ * released via the pool's stmt_free callback.
+ */
+
+int PKI_DB_CONN_add_stmt ( PKI_DB_CONN * conn, const char * sql, void * stmt ) {
+
+	PKI_DB_STMT *st = NULL, **pp = NULL;
+
+	if (!conn || !sql || !stmt) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if ((st = calloc(1, sizeof(PKI_DB_STMT))) == NULL || (st->sql = strdup(sql)) == NULL) {
+		if (st) free(st);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	st->stmt = stmt;
+	st->next = conn->stmts;
+	conn->stmts = st;
+	conn->stmts_count++;
+
+	if (++conn->stmts_num > PKI_DB_CONN_MAX_STMTS) {
+		for (pp = &conn->stmts; (*pp)->next != NULL; pp = &(*pp)->next);
+		st = *pp;
+		*pp = NULL;
+		conn->stmts_num--;
+		if (conn->pool->cb->stmt_free) conn->pool->cb->stmt_free(conn->handle, st->stmt);
+		free(st->sql);
+		free(st);
+	}
+
+	return PKI_OK;
+}
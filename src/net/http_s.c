@@ -379,8 +379,9 @@ PKI_HTTP *PKI_HTTP_get_message (const PKI_SOCKET * sock,
       free -= read;
       m->data[size] = '\x0';
 
-      // If we don't have a header yet, let's look for it
-      if (!eoh && ((eoh = __find_end_of_header(m, idx)) != NULL))
+      // If we don't have a header yet, let's look for it (the end of
+      // the header can start in the previous read)
+      if (!eoh && ((eoh = __find_end_of_header(m, idx > 3 ? idx - 3 : 0)) != NULL))
       {
     	  // We want the header to finish with just one '\r\n' - since the
     	  // pointer we receive is at the end of the '\r\n\r\n' sequence,
@@ -895,6 +896,99 @@ int PKI_HTTP_GET_data_url (const URL      * url,
 			PKI_HTTP_METHOD_GET, timeout, max_size, ret, ssl );
 }
 
+/*!
+ * \brief Sends a GET request and returns the full HTTP response
+ *
+ * The extra headers (if any) must be CRLF terminated lines. Redirections
+ * are followed (up to PKI_HTTP_MAX_REDIRECTS), all the other responses
+ * (including errors and 304 Not Modified) are returned to the caller.
+ */
+
+PKI_HTTP * PKI_HTTP_GET_message_url (const URL  * url,
+				     const char * headers,
+				     int          timeout,
+				     size_t       max_size ) {
+
+	PKI_SOCKET *sock = NULL;
+	PKI_HTTP *ret = NULL;
+	URL *next = NULL;
+	char *head = NULL;
+	char new_url[2048];
+	size_t len = 0;
+	int hops = 0;
+
+	const char *head_get =
+			"GET %s HTTP/1.1\r\n"
+			"Host: %s\r\n"
+			"User-Agent: LibPKI\r\n"
+			"Connection: close\r\n"
+			"%s\r\n";
+
+	if (!url || !url->addr) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (!headers) headers = "";
+	if (timeout < 0) timeout = 0;
+
+	for (hops = 0; hops <= PKI_HTTP_MAX_REDIRECTS; hops++) {
+
+		if ((sock = PKI_SOCKET_new()) == NULL) break;
+
+		if (PKI_SOCKET_open_url(sock, url, timeout) == PKI_ERR) {
+			PKI_SOCKET_free(sock);
+			break;
+		}
+
+		len = strlen(head_get) + strlen(url->path ? url->path : "/")
+			+ strlen(url->addr) + strlen(headers) + 1;
+
+		if ((head = PKI_Malloc(len)) != NULL) {
+			len = (size_t) snprintf(head, len, head_get, url->path ? url->path : "/",
+				url->addr, headers);
+			if (PKI_SOCKET_write(sock, head, len) >= 0) {
+				ret = PKI_HTTP_get_message(sock, timeout, max_size);
+			} else PKI_log_err("Can not write HTTP header to socket");
+			PKI_Free(head);
+		}
+
+		PKI_SOCKET_close(sock);
+		PKI_SOCKET_free(sock);
+
+		if (!ret || ret->code < 300 || ret->code >= 400 || ret->code == 304) break;
+
+		/* Redirection - let's try that */
+		if (ret->location == NULL) {
+			PKI_log_debug("HTTP Redirection but no location provided!");
+			break;
+		}
+
+		if (strstr(ret->location, "://") != NULL) {
+			snprintf(new_url, sizeof(new_url), "%s", ret->location);
+		} else {
+			snprintf(new_url, sizeof(new_url), "%s://%s:%d%s",
+				URL_proto_to_string(url->proto), url->addr, url->port, ret->location);
+		}
+
+		PKI_log_debug("HTTP Redirection Detected [URL: %s]", new_url);
+
+		PKI_HTTP_free(ret);
+		ret = NULL;
+
+		if (next) URL_free(next);
+		if ((next = URL_new(new_url)) == NULL) {
+			PKI_log_debug("HTTP location is not a valid URI (%s)", new_url);
+			break;
+		}
+		url = next;
+	}
+
+	if (next) URL_free(next);
+
+	return ret;
+}
+
 /*! \brief Returns HTTP data from a PKI_SOCKET by using the GET command */
 
 int PKI_HTTP_GET_data_socket (const PKI_SOCKET * sock,
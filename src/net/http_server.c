@@ -0,0 +1,650 @@
+/* src/net/http_server.c */
+/*
+ * Embedded HTTP Listener
+ * Copyright (c) 2007 by Massimiliano Pala and OpenCA Project
+ * OpenCA Licensed Code
+ */
+
+#include <libpki/pki.h>
+
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+/*
+ * NOTE: the server structures live as long as the server, their memory
+ *       is allocated with malloc()/calloc() directly so it is never taken
+ *       from a request arena.
+ */
+
+typedef struct http_server_handler_st {
+	char * path;
+	size_t path_len;
+	PKI_HTTP_SERVER_HANDLER cb;
+	void * ctx;
+} HTTP_SERVER_HANDLER;
+
+struct pki_http_server_st {
+	/* Listening socket */
+	int fd;
+	int port;
+	/* Wakes up the acceptor on stop */
+	int wake[2];
+
+	HTTP_SERVER_HANDLER handlers[PKI_HTTP_SERVER_MAX_HANDLERS];
+	int handlers_num;
+
+	/* Accepted connections (ring) */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int queue[PKI_HTTP_SERVER_QUEUE_SIZE];
+	int queue_head;
+	int queue_num;
+
+	int running;
+	int stop;
+
+	PKI_THREAD acceptor;
+	PKI_THREAD * workers;
+	int workers_num;
+
+	/* TLS (NULL for plain HTTP) */
+	SSL_CTX * tls_ctx;
+};
+
+/* A served connection (ssl is NULL for plain HTTP) */
+typedef struct http_conn_st {
+	int fd;
+	SSL * ssl;
+} HTTP_CONN;
+
+/* TLS session of the request being handled by the calling worker */
+static __thread SSL * _http_tls_current = NULL;
+
+// ==================
+// Responses
+// ==================
+
+static const char * _http_reason(int code) {
+
+	switch (code) {
+		case 200: return "OK";
+		case 301: return "Moved Permanently";
+		case 302: return "Found";
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 413: return "Payload Too Large";
+		case 503: return "Service Unavailable";
+		default: break;
+	}
+
+	return code < 500 ? "Error" : "Internal Server Error";
+}
+
+static int _http_write(const HTTP_CONN *conn, const void *data, size_t size) {
+
+	const unsigned char *p = data;
+	ssize_t rv = 0;
+	int n = 0;
+
+	while (size > 0) {
+		if (conn->ssl) {
+			n = size > INT_MAX ? INT_MAX : (int) size;
+			if ((rv = SSL_write(conn->ssl, p, n)) <= 0) return PKI_ERR;
+		} else if ((rv = send(conn->fd, p, size, MSG_NOSIGNAL)) < 0) {
+			if (errno == EINTR) continue;
+			return PKI_ERR;
+		}
+		p += rv;
+		size -= (size_t) rv;
+	}
+
+	return PKI_OK;
+}
+
+static void _http_reply(const HTTP_CONN *conn, const PKI_HTTP *resp) {
+
+	static const char failed[] = "HTTP/1.1 500 Internal Server Error\r\n"
+		"Content-Length: 0\r\nConnection: close\r\n\r\n";
+	char head[1024], *buf = NULL;
+	size_t body_size = 0, extra_len = 0;
+	int code = 0, len = 0, rv = 0;
+
+	code = resp->code > 0 ? resp->code : 200;
+	body_size = (resp->body && resp->body->data) ? resp->body->size : 0;
+
+	len = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n"
+		"Content-Type: %s\r\nContent-Length: %lu\r\n%s%s%s"
+		"Cache-Control: no-cache\r\nConnection: close\r\n",
+		code, _http_reason(code),
+		resp->type ? resp->type : "text/plain",
+		(unsigned long) body_size,
+		resp->location ? "Location: " : "",
+		resp->location ? resp->location : "",
+		resp->location ? "\r\n" : "");
+
+	// The response can not be sent, the client still gets an answer
+	if (len <= 0 || (size_t) len >= sizeof(head)) {
+		PKI_log_err("HTTP Server: response head too long (%d)", len);
+		_http_write(conn, failed, sizeof(failed) - 1);
+		return;
+	}
+
+	// The extra header lines (not NUL terminated) can be of any size, the
+	// head is sent in one write
+	if (resp->head && resp->head->data) extra_len = resp->head->size;
+
+	buf = head;
+	if ((size_t) len + extra_len + 2 > sizeof(head)) {
+		if ((buf = PKI_Malloc((size_t) len + extra_len + 2)) == NULL) {
+			PKI_log_err("HTTP Server: can not allocate the response head");
+			_http_write(conn, failed, sizeof(failed) - 1);
+			return;
+		}
+		memcpy(buf, head, (size_t) len);
+	}
+
+	if (extra_len > 0) memcpy(buf + len, resp->head->data, extra_len);
+	memcpy(buf + len + extra_len, "\r\n", 2);
+	len += (int) extra_len + 2;
+
+	rv = _http_write(conn, buf, (size_t) len);
+	if (buf != head) PKI_Free(buf);
+
+	if (rv == PKI_OK && body_size > 0) _http_write(conn, resp->body->data, body_size);
+}
+
+static void _http_error(const HTTP_CONN *conn, int code) {
+
+	PKI_HTTP resp;
+
+	memset(&resp, 0, sizeof(resp));
+	resp.code = code;
+
+	_http_reply(conn, &resp);
+}
+
+// ==================
+// Workers
+// ==================
+
+static const HTTP_SERVER_HANDLER * _http_handler(const PKI_HTTP_SERVER *srv,
+							const char *path) {
+
+	const HTTP_SERVER_HANDLER *h = NULL, *ret = NULL;
+	int i = 0;
+
+	if (!path) return NULL;
+
+	for (i = 0; i < srv->handlers_num; i++) {
+
+		h = &srv->handlers[i];
+
+		if (strncmp(path, h->path, h->path_len) != 0) continue;
+
+		// Matches whole path segments only ("/prqp" is not "/prqpx")
+		if (h->path_len > 0 && h->path[h->path_len - 1] != '/'
+				&& path[h->path_len] != '\x0' && path[h->path_len] != '/'
+				&& path[h->path_len] != '?') continue;
+
+		if (!ret || h->path_len > ret->path_len) ret = h;
+	}
+
+	return ret;
+}
+
+static void _http_serve(PKI_HTTP_SERVER *srv, const HTTP_CONN *conn) {
+
+	const HTTP_SERVER_HANDLER *h = NULL;
+	PKI_HTTP *req = NULL, *resp = NULL;
+	PKI_SOCKET sock;
+	PKI_SSL tls;
+
+	memset(&sock, 0, sizeof(sock));
+	sock.type = PKI_SOCKET_FD;
+	sock.status = PKI_SOCKET_CONNECTED;
+	sock.fd = conn->fd;
+
+	// The accepted session is read through the PKI_SSL interface
+	if (conn->ssl) {
+		memset(&tls, 0, sizeof(tls));
+		tls.ssl = conn->ssl;
+		tls.connected = 1;
+		sock.type = PKI_SOCKET_SSL;
+		sock.ssl = &tls;
+	}
+
+	if ((req = PKI_HTTP_get_message(&sock, PKI_HTTP_SERVER_TIMEOUT,
+			PKI_HTTP_SERVER_MAX_SIZE)) == NULL) {
+		_http_error(conn, 400);
+		return;
+	}
+
+	if (req->method != PKI_HTTP_METHOD_GET && req->method != PKI_HTTP_METHOD_POST) {
+		_http_error(conn, 405);
+	} else if ((h = _http_handler(srv, req->path)) == NULL) {
+		_http_error(conn, 404);
+	} else if ((resp = PKI_HTTP_new()) == NULL) {
+		_http_error(conn, 503);
+	} else {
+		_http_tls_current = conn->ssl;
+		if (h->cb(req, resp, h->ctx) != PKI_OK)
+			_http_error(conn, resp->code >= 400 ? resp->code : 500);
+		else
+			_http_reply(conn, resp);
+		_http_tls_current = NULL;
+	}
+
+	if (resp) PKI_HTTP_free(resp);
+	PKI_HTTP_free(req);
+}
+
+static void _http_serve_tls(PKI_HTTP_SERVER *srv, int fd) {
+
+	HTTP_CONN conn = { fd, NULL };
+	struct timeval tv = { PKI_HTTP_SERVER_TIMEOUT, 0 };
+
+	// Reads on the session block, the timeout bounds the handshake too
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	if ((conn.ssl = SSL_new(srv->tls_ctx)) == NULL) return;
+
+	if (SSL_set_fd(conn.ssl, fd) == 1 && SSL_accept(conn.ssl) == 1) {
+		_http_serve(srv, &conn);
+		SSL_shutdown(conn.ssl);
+	} else {
+		PKI_DEBUG("TLS handshake failed (%s)",
+			ERR_error_string(ERR_get_error(), NULL));
+	}
+
+	SSL_free(conn.ssl);
+}
+
+static void * _http_worker(void *arg) {
+
+	PKI_HTTP_SERVER *srv = arg;
+	HTTP_CONN conn = { -1, NULL };
+	int fd = -1, stop = 0;
+
+	pthread_mutex_lock(&srv->lock);
+
+	for (;;) {
+
+		while (!srv->stop && srv->queue_num == 0)
+			pthread_cond_wait(&srv->cond, &srv->lock);
+
+		if (srv->queue_num == 0) break;
+
+		fd = conn.fd = srv->queue[srv->queue_head];
+		srv->queue_head = (srv->queue_head + 1) % PKI_HTTP_SERVER_QUEUE_SIZE;
+		srv->queue_num--;
+		stop = srv->stop;
+
+		// Wakes up the acceptor if the queue was full
+		pthread_cond_broadcast(&srv->cond);
+
+		pthread_mutex_unlock(&srv->lock);
+
+		// Connections still queued at stop time are not served
+		if (stop) {
+			if (!srv->tls_ctx) _http_error(&conn, 503);
+		} else if (srv->tls_ctx) {
+			_http_serve_tls(srv, fd);
+		} else {
+			_http_serve(srv, &conn);
+		}
+
+		close(fd);
+
+		pthread_mutex_lock(&srv->lock);
+	}
+
+	pthread_mutex_unlock(&srv->lock);
+
+	return NULL;
+}
+
+static void * _http_acceptor(void *arg) {
+
+	PKI_HTTP_SERVER *srv = arg;
+	struct pollfd fds[2];
+	int fd = -1;
+
+	fds[0].fd = srv->fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = srv->wake[0];
+	fds[1].events = POLLIN;
+
+	while (!srv->stop) {
+
+		fds[0].revents = fds[1].revents = 0;
+
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) continue;
+			PKI_log_err("HTTP Server: poll failed (%s)", strerror(errno));
+			break;
+		}
+
+		if (fds[1].revents) break;
+		if (!(fds[0].revents & POLLIN)) continue;
+
+		if ((fd = accept(srv->fd, NULL, NULL)) < 0) {
+			if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+				PKI_log_err("HTTP Server: accept failed (%s)", strerror(errno));
+			continue;
+		}
+
+		pthread_mutex_lock(&srv->lock);
+
+		// Back pressure: waits for a free slot in the queue
+		while (!srv->stop && srv->queue_num == PKI_HTTP_SERVER_QUEUE_SIZE)
+			pthread_cond_wait(&srv->cond, &srv->lock);
+
+		if (srv->stop) {
+			pthread_mutex_unlock(&srv->lock);
+			close(fd);
+			break;
+		}
+
+		srv->queue[(srv->queue_head + srv->queue_num) % PKI_HTTP_SERVER_QUEUE_SIZE] = fd;
+		srv->queue_num++;
+
+		pthread_cond_signal(&srv->cond);
+		pthread_mutex_unlock(&srv->lock);
+	}
+
+	return NULL;
+}
+
+// ==================
+// Server
+// ==================
+
+/*! \brief Binds a new HTTP listener (port 0 for an ephemeral port) */
+
+PKI_HTTP_SERVER * PKI_HTTP_SERVER_new(const char *host, int port, int workers) {
+
+	PKI_HTTP_SERVER *srv = NULL;
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+
+	if (port < 0 || port > 65535) {
+		PKI_ERROR(PKI_ERR_PARAM_RANGE, "Invalid port %d", port);
+		return NULL;
+	}
+
+	if ((srv = calloc(1, sizeof(PKI_HTTP_SERVER))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	srv->fd = -1;
+	srv->wake[0] = srv->wake[1] = -1;
+	srv->workers_num = workers > 0 ? workers : PKI_HTTP_SERVER_WORKERS;
+
+	pthread_mutex_init(&srv->lock, NULL);
+	pthread_cond_init(&srv->cond, NULL);
+
+	if ((srv->fd = PKI_NET_listen(host, port, PKI_NET_SOCK_STREAM)) < 0) {
+		PKI_ERROR(PKI_ERR_NET_OPEN, "Can not listen on %s:%d",
+			host ? host : "*", port);
+		srv->fd = -1;
+		PKI_HTTP_SERVER_free(srv);
+		return NULL;
+	}
+
+	if (getsockname(srv->fd, (struct sockaddr *) &addr, &addr_len) == 0) {
+		if (addr.ss_family == AF_INET)
+			srv->port = ntohs(((struct sockaddr_in *) &addr)->sin_port);
+		else if (addr.ss_family == AF_INET6)
+			srv->port = ntohs(((struct sockaddr_in6 *) &addr)->sin6_port);
+	}
+	if (srv->port == 0) srv->port = port;
+
+	return srv;
+}
+
+/*! \brief Stops the server (if running) and frees its resources */
+
+void PKI_HTTP_SERVER_free(PKI_HTTP_SERVER *srv) {
+
+	int i = 0;
+
+	if (!srv) return;
+
+	PKI_HTTP_SERVER_stop(srv);
+
+	for (i = 0; i < srv->handlers_num; i++) free(srv->handlers[i].path);
+
+	if (srv->fd >= 0) close(srv->fd);
+	if (srv->tls_ctx) SSL_CTX_free(srv->tls_ctx);
+
+	pthread_cond_destroy(&srv->cond);
+	pthread_mutex_destroy(&srv->lock);
+
+	free(srv);
+}
+
+/*! \brief Registers the handler for the requests under the path prefix */
+
+int PKI_HTTP_SERVER_add_handler(PKI_HTTP_SERVER *srv, const char *path,
+				PKI_HTTP_SERVER_HANDLER cb, void *ctx) {
+
+	HTTP_SERVER_HANDLER *h = NULL;
+
+	if (!srv || !path || !cb) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (srv->running) {
+		PKI_DEBUG("Handlers can not be added to a running server");
+		return PKI_ERR;
+	}
+
+	if (srv->handlers_num >= PKI_HTTP_SERVER_MAX_HANDLERS)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Too many HTTP handlers");
+
+	h = &srv->handlers[srv->handlers_num];
+	if ((h->path = strdup(path)) == NULL)
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+	h->path_len = strlen(path);
+	h->cb = cb;
+	h->ctx = ctx;
+
+	srv->handlers_num++;
+
+	return PKI_OK;
+}
+
+/*! \brief Starts the acceptor and the worker threads */
+
+int PKI_HTTP_SERVER_start(PKI_HTTP_SERVER *srv) {
+
+	int i = 0;
+
+	if (!srv || srv->fd < 0) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (srv->running) return PKI_OK;
+
+	if (pipe(srv->wake) != 0) {
+		srv->wake[0] = srv->wake[1] = -1;
+		return PKI_ERROR(PKI_ERR_GENERAL, "Can not create the wake up pipe");
+	}
+
+	if ((srv->workers = calloc((size_t) srv->workers_num, sizeof(PKI_THREAD))) == NULL)
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+	srv->stop = 0;
+
+	for (i = 0; i < srv->workers_num; i++) {
+		if (PKI_THREAD_create(&srv->workers[i], NULL, _http_worker, srv) != 0) break;
+	}
+
+	if (i == srv->workers_num
+			&& PKI_THREAD_create(&srv->acceptor, NULL, _http_acceptor, srv) == 0) {
+		srv->running = 1;
+		return PKI_OK;
+	}
+
+	// Stops the started workers
+	pthread_mutex_lock(&srv->lock);
+	srv->stop = 1;
+	pthread_cond_broadcast(&srv->cond);
+	pthread_mutex_unlock(&srv->lock);
+
+	srv->workers_num = i;
+	for (i = 0; i < srv->workers_num; i++) PKI_THREAD_join(&srv->workers[i], NULL);
+
+	free(srv->workers);
+	srv->workers = NULL;
+
+	close(srv->wake[0]);
+	close(srv->wake[1]);
+	srv->wake[0] = srv->wake[1] = -1;
+
+	return PKI_ERROR(PKI_ERR_GENERAL, "Can not start the HTTP server threads");
+}
+
+/*! \brief Stops the server, requests in progress are completed */
+
+int PKI_HTTP_SERVER_stop(PKI_HTTP_SERVER *srv) {
+
+	int i = 0;
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (!srv->running) return PKI_OK;
+
+	pthread_mutex_lock(&srv->lock);
+	srv->stop = 1;
+	pthread_cond_broadcast(&srv->cond);
+	pthread_mutex_unlock(&srv->lock);
+
+	if (write(srv->wake[1], "x", 1) != 1)
+		PKI_log_err("HTTP Server: can not wake up the acceptor");
+
+	PKI_THREAD_join(&srv->acceptor, NULL);
+	for (i = 0; i < srv->workers_num; i++) PKI_THREAD_join(&srv->workers[i], NULL);
+
+	free(srv->workers);
+	srv->workers = NULL;
+
+	close(srv->wake[0]);
+	close(srv->wake[1]);
+	srv->wake[0] = srv->wake[1] = -1;
+
+	srv->running = 0;
+
+	return PKI_OK;
+}
+
+/*! \brief Returns the listening port (useful with ephemeral ports) */
+
+int PKI_HTTP_SERVER_get_port(const PKI_HTTP_SERVER *srv) {
+
+	if (!srv) return -1;
+
+	return srv->port;
+}
+
+/*! \brief Serves the connections over TLS with the given credentials
+ *
+ * When trusted certificates are provided, clients are asked for a
+ * certificate issued by one of them (the certificate is optional, see
+ * PKI_HTTP_SERVER_get_peer_cert). Must be called before starting.
+ */
+
+int PKI_HTTP_SERVER_set_tls(PKI_HTTP_SERVER           * srv,
+			    const PKI_X509_KEYPAIR    * k,
+			    const PKI_X509_CERT       * x,
+			    const PKI_X509_CERT_STACK * chain,
+			    const PKI_X509_CERT_STACK * trusted) {
+
+	SSL_CTX *ctx = NULL;
+	X509_STORE *store = NULL;
+	PKI_X509_CERT *c = NULL;
+	int i = 0;
+
+	if (!srv || !k || !k->value || !x || !x->value)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (srv->running) {
+		PKI_DEBUG("TLS can not be enabled on a running server");
+		return PKI_ERR;
+	}
+
+	if ((ctx = SSL_CTX_new(TLS_server_method())) == NULL)
+		return PKI_ERROR(PKI_ERR_NET_SSL_INIT, NULL);
+
+	if (!SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION)
+			|| !SSL_CTX_use_certificate(ctx, (X509 *) x->value)
+			|| !SSL_CTX_use_PrivateKey(ctx, (EVP_PKEY *) k->value)
+			|| !SSL_CTX_check_private_key(ctx)) {
+		PKI_ERROR(PKI_ERR_NET_SSL_INIT, ERR_error_string(ERR_get_error(), NULL));
+		goto err;
+	}
+
+	for (i = 0; chain && i < PKI_STACK_X509_CERT_elements(chain); i++) {
+		if ((c = PKI_STACK_X509_CERT_get_num(chain, i)) == NULL || !c->value) continue;
+		if (!SSL_CTX_add1_chain_cert(ctx, (X509 *) c->value)) {
+			PKI_ERROR(PKI_ERR_NET_SSL_INIT, NULL);
+			goto err;
+		}
+	}
+
+	if (trusted && PKI_STACK_X509_CERT_elements(trusted) > 0) {
+
+		store = SSL_CTX_get_cert_store(ctx);
+
+		for (i = 0; i < PKI_STACK_X509_CERT_elements(trusted); i++) {
+			if ((c = PKI_STACK_X509_CERT_get_num(trusted, i)) == NULL || !c->value)
+				continue;
+			if (!X509_STORE_add_cert(store, (X509 *) c->value)
+					|| !SSL_CTX_add_client_CA(ctx, (X509 *) c->value)) {
+				PKI_ERROR(PKI_ERR_NET_SSL_INIT, NULL);
+				goto err;
+			}
+		}
+
+		// Client certificates are requested but not required
+		SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_CLIENT_ONCE, NULL);
+		SSL_CTX_set_session_id_context(ctx, (const unsigned char *) "libpki", 6);
+	}
+
+	if (srv->tls_ctx) SSL_CTX_free(srv->tls_ctx);
+	srv->tls_ctx = ctx;
+
+	return PKI_OK;
+
+err:
+	SSL_CTX_free(ctx);
+	return PKI_ERR;
+}
+
+/*! \brief Returns the verified TLS client certificate of the request
+ *         being handled by the calling thread (NULL if none) */
+
+PKI_X509_CERT * PKI_HTTP_SERVER_get_peer_cert(void) {
+
+	PKI_X509_CERT *ret = NULL;
+	X509 *x = NULL;
+
+	if (!_http_tls_current) return NULL;
+
+	if (SSL_get_verify_result(_http_tls_current) != X509_V_OK) return NULL;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	x = SSL_get1_peer_certificate(_http_tls_current);
+#else
+	x = SSL_get_peer_certificate(_http_tls_current);
+#endif
+	if (!x) return NULL;
+
+	if ((ret = PKI_X509_new_value(PKI_DATATYPE_X509_CERT, x, NULL)) == NULL)
+		X509_free(x);
+
+	return ret;
+}
@@ -21,15 +21,15 @@
 LDAP *URL_LDAP_connect(const URL *url, int tout ) {
 
 	LDAP		*ld = NULL;
-	int			protocol = -1;
+	int			protocol = LDAP_VERSION3;
 
 	char		*ldap_server = NULL;
 
 	struct berval cred;
 	int			rc = 0;
 
-    cred.bv_val = NULL;
-    cred.bv_len = 0;
+    cred.bv_val = url && url->pwd ? url->pwd : NULL;
+    cred.bv_len = cred.bv_val ? strlen( cred.bv_val ) : 0;
 
 #if (LIBPKI_OS_CLASS == LIBPKI_OS_POSIX)
 	(void) signal( SIGPIPE, SIG_IGN );
@@ -86,7 +86,7 @@ LDAP *URL_LDAP_connect(const URL *url, int tout ) {
 #  endif
 	PKI_log_debug("LDAP: SASL bind_s");
 
-	if(( rc = ldap_sasl_bind_s( ld, NULL, LDAP_SASL_SIMPLE, &cred,
+	if(( rc = ldap_sasl_bind_s( ld, url->usr, LDAP_SASL_SIMPLE, &cred,
                     NULL, NULL, NULL )) != LDAP_SUCCESS ) {
 
         switch ( rc ) {
@@ -116,117 +116,450 @@ err:
 	return NULL;
 }
 
+
+static void _ldap_unbind ( LDAP *ld ) {
+#if defined(LDAP_VENDOR_OPENLDAP)
+	ldap_unbind_ext ( ld, NULL, NULL );
+#else
+	ldap_unbind ( ld );
+#endif
+}
+
+/* ---------------------------- Sessions Pool --------------------------- */
+
+/*
+ * LDAP sessions are kept in a PKI_DB_POOL, the pool key is the server
+ * (address and port) and the bind credentials (usr and pwd) of the URL
+ */
+
+static PKI_DB_POOL *ldap_pool = NULL;
+static pthread_once_t ldap_pool_once = PTHREAD_ONCE_INIT;
+
+static void * _ldap_pool_connect ( const URL *url ) {
+	return URL_LDAP_connect ( url, 0 );
+}
+
+static int _ldap_pool_ping ( void *handle ) {
+
+#ifdef _WINDOWS
+	struct l_timeval tv;
+#else
+	struct timeval tv;
+#endif
+	char *attrs[] = { LDAP_NO_ATTRS, NULL };
+	LDAPMessage *res = NULL;
+	int rc = 0;
+
+	tv.tv_sec = URL_LDAP_PING_TIMEOUT;
+	tv.tv_usec = 0L;
+
+	// Reads the root DSE (no attributes)
+#if defined(LDAP_VENDOR_OPENLDAP) || defined(LDAP_VENDOR_MICROSOFT)
+	rc = ldap_search_ext_s((LDAP *) handle, "", LDAP_SCOPE_BASE, "(objectClass=*)",
+			attrs, 0, NULL, NULL, &tv, 1, &res);
+#else
+	rc = ldap_search_st((LDAP *) handle, "", LDAP_SCOPE_BASE, "(objectClass=*)",
+			attrs, 0, &tv, &res);
+#endif
+	if (res) ldap_msgfree(res);
+
+	return rc == LDAP_SUCCESS ? PKI_OK : PKI_ERR;
+}
+
+static void _ldap_pool_close ( void *handle ) {
+	_ldap_unbind( (LDAP *) handle );
+}
+
+static const PKI_DB_POOL_CALLBACKS ldap_pool_cb = {
+	_ldap_pool_connect,
+	_ldap_pool_ping,
+	_ldap_pool_close,
+	NULL
+};
+
+static void _ldap_pool_init ( void ) {
+	ldap_pool = PKI_DB_POOL_new ( &ldap_pool_cb );
+}
+
+static PKI_DB_CONN * _ldap_pool_get ( const URL *url ) {
+
+	pthread_once(&ldap_pool_once, _ldap_pool_init);
+	if (!ldap_pool) return NULL;
+
+	return PKI_DB_POOL_get ( ldap_pool, url );
+}
+
+/* Errors after which the session can not be reused */
+static int _ldap_is_reusable ( int rc ) {
+
+	switch ( rc ) {
+		case LDAP_SERVER_DOWN:
+		case LDAP_TIMEOUT:
+		case LDAP_CONNECT_ERROR:
+		case LDAP_LOCAL_ERROR:
+		case LDAP_DECODING_ERROR:
+		case LDAP_ENCODING_ERROR:
+		case LDAP_NO_MEMORY:
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Copies the values of the attribute into the stack. The value buffers
+ * belong to the LDAP library (its allocator can be replaced) and are
+ * released with ldap_value_free_len().
+ */
+static int _ldap_push_values ( LDAP *ld, LDAPMessage *entry, char *attr,
+				PKI_MEM_STACK *sk ) {
+
+	struct berval **vals = NULL;
+	PKI_MEM *obj = NULL;
+	int i = 0;
+
+	if ((vals = ldap_get_values_len(ld, entry, attr)) == NULL) return 0;
+
+	for (i = 0; vals[i] != NULL; i++) {
+
+		if ((obj = PKI_MEM_new_null()) == NULL) break;
+
+		if (vals[i]->bv_len > 0 && PKI_MEM_add(obj, (unsigned char *) vals[i]->bv_val,
+				(size_t) vals[i]->bv_len) == PKI_ERR) {
+			/* ERROR in memory growth */
+			PKI_MEM_free(obj);
+			break;
+		}
+		PKI_STACK_MEM_push( sk, obj );
+	}
+
+	ldap_value_free_len( vals );
+
+	return i;
+}
+
+static int _ldap_push_entries ( LDAP *ld, LDAPMessage *res, char *attr,
+				PKI_MEM_STACK *sk ) {
+
+	LDAPMessage *entry = NULL;
+	int ret = 0;
+
+	for (entry = ldap_first_entry(ld, res); entry != NULL;
+			entry = ldap_next_entry(ld, entry)) {
+		ret += _ldap_push_values(ld, entry, attr, sk);
+	}
+
+	return ret;
+}
+
+/* ------------------------------ Searches ------------------------------ */
+
 PKI_MEM_STACK *URL_get_data_ldap_url(const URL *url, int timeout, ssize_t size ) {
 
+	if( (!url) || (!url->addr) || (!url->path)) {
+		return NULL;
+	}
+
+	return URL_get_data_ldap_url_dns( url, (const char * const *) &url->path, 1,
+			timeout, size );
+}
+
+/*!
+ * \brief Retrieves the values of the URL attribute from many entries
+ *
+ * The server, bind credentials and attribute are taken from the URL, the
+ * entries are read with a base search for each of the passed DNs (the URL
+ * path is not used). With OpenLDAP the searches are sent asynchronously,
+ * up to URL_LDAP_PIPELINE_DEPTH of them are outstanding at any time.
+ * The values are returned in the order of the DNs.
+ */
+
+PKI_MEM_STACK *URL_get_data_ldap_url_dns(const URL *url, const char * const *dns,
+				int dns_num, int timeout, ssize_t size ) {
+
 #ifdef _WINDOWS
 	struct l_timeval	zerotime;
-	struct l_timeval	*time;
+	struct l_timeval	*time = NULL;
 #else
 	struct timeval		zerotime;
-	struct timeval		*time;
+	struct timeval		*time = NULL;
 #endif
 
+	PKI_DB_CONN *conn = NULL;
 	LDAP	*ld = NULL;
-	int  	i,rc;
-	char	*attrs[] = { url->attrs, NULL } ;
+	int  	i = 0, rc = LDAP_SUCCESS;
+	char	*attrs[] = { NULL, NULL } ;
 	char    *filter = "objectclass=*";
-	struct berval **vals = NULL;
-#if defined(LDAP_VENDOR_OPENLDAP) || defined(LDAP_VENDOR_MICROSOFT)
-	// int		msgid = 0;
-#endif
-	LDAPMessage *res = NULL;
+	LDAPMessage **res = NULL;
 	PKI_MEM_STACK *ret = NULL;
-	PKI_MEM *obj = NULL;
+	int reusable = 1;
 
-	if( (!url) || (!url->addr) || (!url->path)) {
+#if defined(LDAP_VENDOR_OPENLDAP)
+	LDAPMessage *msg = NULL;
+	int *msgids = NULL;
+	int next = 0, pending = 0, id = 0;
+#endif
+
+	if( (!url) || (!url->addr) || (!url->attrs) || (!dns) || dns_num <= 0 ) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 		return NULL;
 	}
 
+	attrs[0] = url->attrs;
+
 	/* We search for the exact match, so LDAP_SCOPE_BASE is used here */
 	if ( timeout > 0 ) {
 		zerotime.tv_sec = timeout;
 		zerotime.tv_usec = 0L;
 		time = &zerotime;
-	} else {
-		time = NULL;
-		timeout = 0;
-		zerotime.tv_sec =  0L;
-		zerotime.tv_usec = 0L;
 	}
 
 	PKI_log_debug("LDAP: Search Timeout is %d", timeout );
 
-	if((ld = URL_LDAP_connect ( url, timeout )) == NULL ) {
+	if((conn = _ldap_pool_get ( url )) == NULL ) {
 		PKI_log_debug("LDAP: can not connect to server (%s)",
 						url->url_s );
 		return NULL;
 	};
+	ld = (LDAP *) conn->handle;
 
-
-#if defined(LDAP_VENDOR_OPENLDAP) || defined(LDAP_VENDOR_MICROSOFT)
-	if ((rc = ldap_search_ext_s(ld, url->path, LDAP_SCOPE_BASE,
-			filter, attrs, 0, NULL, NULL, time, (int) size, &res )) != LDAP_SUCCESS)
-	{
-		PKI_log_err("LDAP: Search Error (0x%8.8x)", rc);
+	if ((res = PKI_Malloc(sizeof(LDAPMessage *) * (size_t) dns_num)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 		goto end;
 	}
 
-	/*
-	if (( rc = ldap_result (ld, msgid, LDAP_MSG_ONE,
-                       				&zerotime, &res)) <= 0 ) {
-		PKI_log_err("LDAP: [%s] object not found (0x%8.8x)", 
-			url->path, rc);
+#if defined(LDAP_VENDOR_OPENLDAP)
+	if ((msgids = PKI_Malloc(sizeof(int) * (size_t) dns_num)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 		goto end;
 	}
-	*/
 
-#else
-	if (( rc = ldap_search_s( ld, url->path, LDAP_SCOPE_BASE,
-			filter, attrs, 0, &res )) != LDAP_SUCCESS ) {
+	while (next < dns_num || pending > 0) {
+
+		// Sends the searches without waiting for the results
+		while (next < dns_num && pending < URL_LDAP_PIPELINE_DEPTH) {
+			if ((rc = ldap_search_ext(ld, dns[next], LDAP_SCOPE_BASE, filter, attrs,
+					0, NULL, NULL, time, (int) size, &msgids[next])) != LDAP_SUCCESS) {
+				PKI_log_err("LDAP: Search Error for %s (0x%8.8x)", dns[next], rc);
+				msgids[next++] = -1;
+				if (!_ldap_is_reusable(rc)) break;
+			} else {
+				pending++;
+				next++;
+			}
+		}
 
-		PKI_log_err("LDAP: [%s] object not found (0x%8.8x)", url->path, rc);
+		// The session is broken, the other searches are not sent
+		if (pending == 0 || !_ldap_is_reusable(rc)) break;
 
-		goto end;
+		if ((rc = ldap_result(ld, LDAP_RES_ANY, LDAP_MSG_ALL, time, &msg)) <= 0) {
+			PKI_log_err("LDAP: Can not retrieve search results (0x%8.8x)",
+				rc < 0 ? rc : LDAP_TIMEOUT);
+			rc = (rc < 0 ? LDAP_SERVER_DOWN : LDAP_TIMEOUT);
+			break;
+		}
+
+		id = ldap_msgid(msg);
+		for (i = 0; i < next; i++) {
+			if (msgids[i] == id) break;
+		}
+
+		if (i < next && !res[i]) {
+			res[i] = msg;
+			pending--;
+		} else ldap_msgfree(msg);
+
+		rc = LDAP_SUCCESS;
 	}
-#endif
 
-	if (( i = ldap_count_entries( ld, res )) <= 0 ) {
-		PKI_log_err("No Returned Entries (%s)", i);
+	if (pending > 0) {
+		// Outstanding searches are abandoned, the session is not reused
+		for (i = 0; i < next; i++) {
+			if (msgids[i] >= 0 && !res[i]) ldap_abandon_ext(ld, msgids[i], NULL, NULL);
+		}
+		reusable = 0;
+	}
+#else
+	for (i = 0; i < dns_num; i++) {
+# if defined(LDAP_VENDOR_MICROSOFT)
+		rc = ldap_search_ext_s(ld, (char *) dns[i], LDAP_SCOPE_BASE, filter, attrs,
+				0, NULL, NULL, time, (int) size, &res[i]);
+# else
+		rc = ldap_search_s(ld, (char *) dns[i], LDAP_SCOPE_BASE, filter, attrs,
+				0, &res[i]);
+# endif
+		if (rc != LDAP_SUCCESS) {
+			PKI_log_err("LDAP: [%s] object not found (0x%8.8x)", dns[i], rc);
+			if (!_ldap_is_reusable(rc)) break;
+		}
 	}
+#endif
+
+	if (!_ldap_is_reusable(rc)) reusable = 0;
 
 	if((ret = PKI_STACK_MEM_new()) == NULL ) {
 		/* ERROR: Allocating memory */
 		goto end;
 	}
-	if((vals = ldap_get_values_len (ld, res, attrs[0])) != NULL ) {
 
-		for( i=0; vals[i] != NULL; i++ ) {
-			if((obj = PKI_MEM_new_null()) == NULL ) {
-				goto end;
-			}
-			if(PKI_MEM_add( obj, (char *) vals[i]->bv_val, 
-					vals[i]->bv_len) == PKI_ERR) {
-				/* ERROR in memory growth */;
-				break;
-			}
-			PKI_STACK_MEM_push( ret, obj );
+	for (i = 0; i < dns_num; i++) {
+		if (res[i]) _ldap_push_entries(ld, res[i], attrs[0], ret);
+	}
+
+	if (PKI_STACK_MEM_elements(ret) <= 0) {
+		PKI_log_debug("LDAP: No Returned Entries");
+		PKI_STACK_MEM_free(ret);
+		ret = NULL;
+	}
+
+end:
+	if (res) {
+		for (i = 0; i < dns_num; i++) {
+			if (res[i]) ldap_msgfree(res[i]);
 		}
+		PKI_Free(res);
+	}
+#if defined(LDAP_VENDOR_OPENLDAP)
+	if (msgids) PKI_Free(msgids);
+#endif
+	PKI_DB_POOL_put(conn, reusable);
+
+	return (ret);
+}
+
+/*!
+ * \brief Retrieves the values of the URL attribute from a subtree
+ *
+ * The subtree search starts at the URL path, the filter defaults to
+ * (objectClass=*). With OpenLDAP the results are retrieved in pages of
+ * page_size entries (RFC 2696), the other vendors use a single search.
+ */
 
-		ldap_value_free_len( vals );
-		vals = NULL;
-	} else {
+PKI_MEM_STACK *URL_get_data_ldap_url_paged(const URL *url, const char *filter,
+				int page_size, int timeout, ssize_t size ) {
+
+#ifdef _WINDOWS
+	struct l_timeval	zerotime;
+	struct l_timeval	*time = NULL;
+#else
+	struct timeval		zerotime;
+	struct timeval		*time = NULL;
+#endif
+
+	PKI_DB_CONN *conn = NULL;
+	LDAP	*ld = NULL;
+	int  	rc = LDAP_SUCCESS;
+	char	*attrs[] = { NULL, NULL } ;
+	LDAPMessage *res = NULL;
+	PKI_MEM_STACK *ret = NULL;
+
+#if defined(LDAP_VENDOR_OPENLDAP)
+	LDAPControl *page_ctrl = NULL;
+	LDAPControl *ctrls[] = { NULL, NULL };
+	LDAPControl **res_ctrls = NULL;
+	LDAPControl *ctrl = NULL;
+	struct berval cookie = { 0, NULL };
+	ber_int_t count = 0;
+	int err = 0;
+#endif
+
+	if( (!url) || (!url->addr) || (!url->path) || (!url->attrs)) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	attrs[0] = url->attrs;
+	if (!filter) filter = "(objectClass=*)";
+	if (page_size <= 0) page_size = URL_LDAP_PAGE_SIZE;
+
+	if ( timeout > 0 ) {
+		zerotime.tv_sec = timeout;
+		zerotime.tv_usec = 0L;
+		time = &zerotime;
+	}
+
+	if((conn = _ldap_pool_get ( url )) == NULL ) {
+		PKI_log_debug("LDAP: can not connect to server (%s)",
+						url->url_s );
+		return NULL;
+	};
+	ld = (LDAP *) conn->handle;
+
+	if((ret = PKI_STACK_MEM_new()) == NULL ) {
+		PKI_DB_POOL_put(conn, 1);
 		return NULL;
 	}
 
-end:
-	if(res) ldap_msgfree( res );
 #if defined(LDAP_VENDOR_OPENLDAP)
-	if(ld) ldap_unbind_ext( ld, NULL, NULL );
+	do {
+		if ((rc = ldap_create_page_control(ld, page_size,
+				cookie.bv_val ? &cookie : NULL, 0, &page_ctrl)) != LDAP_SUCCESS) {
+			PKI_log_err("LDAP: Can not create the paged results control (0x%8.8x)", rc);
+			break;
+		}
+		ctrls[0] = page_ctrl;
+
+		rc = ldap_search_ext_s(ld, url->path, LDAP_SCOPE_SUBTREE, filter, attrs,
+				0, ctrls, NULL, time, (int) size, &res);
+
+		ldap_control_free(page_ctrl);
+		page_ctrl = NULL;
+
+		if (cookie.bv_val) ber_memfree(cookie.bv_val);
+		cookie.bv_val = NULL;
+		cookie.bv_len = 0;
+
+		if (rc != LDAP_SUCCESS && rc != LDAP_SIZELIMIT_EXCEEDED) {
+			PKI_log_err("LDAP: Search Error (0x%8.8x)", rc);
+			break;
+		}
+
+		_ldap_push_entries(ld, res, attrs[0], ret);
+
+		// The server returns the cookie for the next page (if any)
+		if (ldap_parse_result(ld, res, &err, NULL, NULL, NULL, &res_ctrls, 0) == LDAP_SUCCESS
+				&& res_ctrls != NULL) {
+			if ((ctrl = ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, res_ctrls, NULL)) != NULL)
+				ldap_parse_pageresponse_control(ld, ctrl, &count, &cookie);
+			ldap_controls_free(res_ctrls);
+			res_ctrls = NULL;
+		}
+		ldap_msgfree(res);
+		res = NULL;
+
+	} while (rc == LDAP_SUCCESS && cookie.bv_val != NULL && cookie.bv_len > 0);
+
+	if (cookie.bv_val) ber_memfree(cookie.bv_val);
+#elif defined(LDAP_VENDOR_MICROSOFT)
+	if ((rc = ldap_search_ext_s(ld, url->path, LDAP_SCOPE_SUBTREE, (char *) filter,
+			attrs, 0, NULL, NULL, time, (int) size, &res)) == LDAP_SUCCESS)
+		_ldap_push_entries(ld, res, attrs[0], ret);
 #else
-	if(ld) ldap_unbind( ld );
+	if ((rc = ldap_search_s(ld, url->path, LDAP_SCOPE_SUBTREE, (char *) filter,
+			attrs, 0, &res)) == LDAP_SUCCESS)
+		_ldap_push_entries(ld, res, attrs[0], ret);
 #endif
 
+	if (res) ldap_msgfree(res);
+
+	PKI_DB_POOL_put(conn, _ldap_is_reusable(rc));
+
+	if (PKI_STACK_MEM_elements(ret) <= 0) {
+		PKI_STACK_MEM_free(ret);
+		ret = NULL;
+	}
+
 	return (ret);
 }
 
 #endif /* LDAP */
+
+/*! \brief Closes the idle sessions of the LDAP sessions pool */
+
+void URL_ldap_pool_flush ( void ) {
+
+#ifdef HAVE_LDAP
+	if (ldap_pool) PKI_DB_POOL_flush ( ldap_pool );
+#endif
+	return;
+}
@@ -8,165 +8,6 @@
  
 #include <libpki/pki.h>
 
-char *parse_url_query ( const URL * url ) {
-
-	char * ret = NULL;
-	char * table = NULL;
-	char * tmp_s = NULL;
-	char * tmp_s2 = NULL;
-	int where = 0;
-	int add_and = 0;
-
-	char col[1024];
-	char val[1024];
-	char tmp[1024];
-
-	PKI_MEM *buf = NULL;
-
-	if( !url || !url->path ) return( NULL );
-
-	tmp_s = url->path;
-
-	while((tmp_s2 = strchr(tmp_s, '/')) != NULL ) {
-		tmp_s2++;
-		tmp_s = tmp_s2;
-	}
-
-	if((table = parse_url_table ( url )) == NULL) {
-		return (NULL);
-	}
-
-	if((buf = PKI_MEM_new_null()) == NULL ) {
-		return ( NULL );
-	}
-
-	snprintf( tmp, sizeof( tmp ), "SELECT %s from %s ", url->attrs, table );
-	PKI_Free (table);
-
-	PKI_MEM_add( buf, (const unsigned char *)tmp, strlen( tmp ));
-
-	where = 0;
-	while( sscanf(tmp_s, "(%[^)=]=%[^)])", col, val) > 1 ) {
-		if( where == 0 ) {
-			/* Let's add the WHERE clause */
-			PKI_MEM_add(buf, (const unsigned char *)"WHERE ", 6);
-			where = 1;
-		}
-		/* The tmp_s should point to the next token */
-		tmp_s += strlen(col) + strlen(val) + 3;
-
-		/* Control if we need to add the AND in the SQL statement */
-		if( add_and == 1 ) {
-			PKI_MEM_add( buf, (const unsigned char *)" AND ", 5);
-		}
-
-		PKI_MEM_add( buf, (const unsigned char *)col, strlen( col ));
-		PKI_MEM_add( buf, (const unsigned char *)"='", 2);
-		PKI_MEM_add( buf, (const unsigned char *)val, strlen( val ));
-		PKI_MEM_add( buf, (const unsigned char *)"' ", 2);
-
-		/* This triggers the adding of AND on the next iteration */
-		add_and = 1;
-	}
-
-	if( (ret = PKI_Malloc (buf->size+1)) == NULL ) {
-		PKI_MEM_free ( buf );
-		return( NULL );
-	}
-
-	memcpy( ret, buf->data, buf->size );
-
-	PKI_MEM_free ( buf );
-	return( ret );
-}
-
-char *parse_url_put_query ( const URL * url, const PKI_MEM *data ) {
-
-	char * ret = NULL;
-	char * table = NULL;
-	char * tmp_s = NULL;
-	char * tmp_s2 = NULL;
-
-	int where = 0;
-	int add_and = 0;
-
-	char col[1024];
-	char val[1024];
-	char tmp[1024];
-
-	// char buf[BUFF_MAX_SIZE];
-
-	PKI_MEM *buf = NULL;
-
-	if( !url || !url->path ) return( NULL );
-
-	tmp_s = url->path;
-
-	while((tmp_s2 = strchr(tmp_s, '/')) != NULL ) {
-		tmp_s2++;
-		tmp_s = tmp_s2;
-	}
-
-	if((table = parse_url_table ( url )) == NULL) {
-		return (NULL);
-	}
-
-	if((buf = PKI_MEM_new_null()) == NULL ) {
-		return ( NULL );
-	}
-
-	sprintf( tmp, "INSERT INTO %s (%s) VALUES ('", table, url->attrs );
-	PKI_MEM_add( buf, (const unsigned char *)tmp, strlen( tmp ));
-	PKI_MEM_add( buf, data->data, data->size );
-	PKI_MEM_add( buf, (const unsigned char *)"') ", 3);
-
-	where = 0;
-	while( (sscanf(tmp_s, "(%[^)=]=\"%[^)\"]\")", col, val) > 1) ||
-			(sscanf(tmp_s, "(%[^)=]=%[^)])", col, val) > 1)) {
-		if( where == 0 ) {
-			/* It is actually an update, let's update! */
-			snprintf( tmp, sizeof( tmp ),
-				"UPDATE %s SET %s='", table, url->attrs);
-			if( buf ) PKI_MEM_free ( buf );
-
-			buf = PKI_MEM_new_null();
-			PKI_MEM_add( buf, (const unsigned char *)tmp, strlen( tmp ));
-			PKI_MEM_add( buf, data->data, data->size );
-			PKI_MEM_add( buf, (const unsigned char *)"' WHERE ", 8);
-
-			/* Let's add the WHERE clause */
-			where = 1;
-		}
-		/* The tmp_s should point to the next token */
-		tmp_s += strlen(col) + strlen(val) + 3;
-
-		/* Control if we need to add the AND in the SQL statement */
-		if( add_and == 1 ) {
-			PKI_MEM_add( buf, (const unsigned char *)" AND ", 5);
-		}
-
-		PKI_MEM_add( buf, (const unsigned char *)col, strlen( col ));
-		PKI_MEM_add( buf, (const unsigned char *)"='", 2);
-		PKI_MEM_add( buf, (const unsigned char *)val, strlen( val ));
-		PKI_MEM_add( buf, (const unsigned char *)"' ", 2 );
-
-		/* This triggers the adding of AND on the next iteration */
-		add_and = 1;
-	}
-
-	PKI_Free (table);
-
-	if( (ret = PKI_Malloc(buf->size) + 1) == NULL ) {
-		if( buf ) PKI_MEM_free ( buf );
-		return( NULL );
-	}
-	memcpy( ret, buf->data, buf->size );
-
-	PKI_MEM_free ( buf );
-
-	return( ret );
-}
-
 char *parse_url_table ( const URL * url ) {
 	char *tmp_s = NULL;
 	char *tmp_s2 = NULL;
@@ -228,15 +69,16 @@ char *parse_url_dbname ( const URL *url ) {
 MYSQL *db_connect ( const URL *url ) {
 
 	MYSQL *sql = NULL;
-	char * table = NULL;
 	char * dbname = NULL;
 
+	// Initializes the MySQL client library (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_MYSQL);
+
 	if( (sql = mysql_init( NULL )) == NULL ) {
 		return NULL;
 	}
 
 	dbname = parse_url_dbname ( url );
-	table = parse_url_table ( url );
 
 	/* The old mysql_connect is no more supported, it seems! */
 	/* mysql_connect( sql, url->addr, url->usr, url->pwd ); */
@@ -248,7 +90,6 @@ MYSQL *db_connect ( const URL *url ) {
 	}
 
 	if( dbname ) PKI_Free (dbname);
-	if( table ) PKI_Free (table);
 
 	return( sql );
 
@@ -263,9 +104,115 @@ int db_close ( MYSQL *sql ) {
 	return (PKI_OK);
 }
 
+// MySQL 8.0 dropped the my_bool type (MariaDB still has it)
+#if defined(LIBMYSQL_VERSION_ID) && LIBMYSQL_VERSION_ID >= 80000 && !defined(MARIADB_PACKAGE_VERSION_ID)
+typedef bool my_bool;
+#endif
+
+static PKI_DB_POOL *mysql_pool = NULL;
+static pthread_once_t mysql_pool_once = PTHREAD_ONCE_INIT;
+
+static void * _mysql_pool_connect ( const URL *url ) {
+	return db_connect ( url );
+}
+
+static int _mysql_pool_ping ( void *handle ) {
+	return mysql_ping( (MYSQL *) handle ) == 0 ? PKI_OK : PKI_ERR;
+}
+
+static void _mysql_pool_close ( void *handle ) {
+	db_close( (MYSQL *) handle );
+}
+
+static void _mysql_pool_stmt_free ( void *handle, void *stmt ) {
+	mysql_stmt_close( (MYSQL_STMT *) stmt );
+}
+
+static const PKI_DB_POOL_CALLBACKS mysql_pool_cb = {
+	_mysql_pool_connect,
+	_mysql_pool_ping,
+	_mysql_pool_close,
+	_mysql_pool_stmt_free
+};
+
+static void _mysql_pool_init ( void ) {
+	mysql_pool = PKI_DB_POOL_new ( &mysql_pool_cb );
+}
+
+static PKI_DB_CONN * _mysql_pool_get ( const URL *url ) {
+
+	pthread_once(&mysql_pool_once, _mysql_pool_init);
+	if (!mysql_pool) return NULL;
+
+	return PKI_DB_POOL_get ( mysql_pool, url );
+}
+
+/* Returns the (cached) prepared statement for the SQL text */
+static MYSQL_STMT * _mysql_prepare ( PKI_DB_CONN *conn, const char *sql ) {
+
+	MYSQL_STMT *st = NULL;
+
+	if ((st = PKI_DB_CONN_get_stmt(conn, sql)) != NULL) return st;
+
+	if ((st = mysql_stmt_init((MYSQL *) conn->handle)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	if (mysql_stmt_prepare(st, sql, (unsigned long) strlen(sql)) != 0) {
+		PKI_log_err("Can not prepare SQL statement (%s)", mysql_stmt_error(st));
+		mysql_stmt_close(st);
+		return NULL;
+	}
+
+	if (PKI_DB_CONN_add_stmt(conn, sql, st) != PKI_OK) {
+		mysql_stmt_close(st);
+		return NULL;
+	}
+
+	return st;
+}
+
+/* Binds the data (if any) and the condition values, then executes */
+static int _mysql_execute ( MYSQL_STMT *st, const PKI_DB_QUERY *q, const PKI_MEM *data ) {
+
+	MYSQL_BIND bind[PKI_DB_QUERY_MAX_PARAMS + 1];
+	int i = 0, n = 0;
+
+	memset(bind, 0, sizeof(bind));
+
+	if (data) {
+		bind[n].buffer_type = MYSQL_TYPE_BLOB;
+		bind[n].buffer = data->data;
+		bind[n++].buffer_length = (unsigned long) data->size;
+	}
+
+	for (i = 0; i < q->params_num; i++) {
+		bind[n].buffer_type = MYSQL_TYPE_STRING;
+		bind[n].buffer = q->vals[i];
+		bind[n++].buffer_length = (unsigned long) strlen(q->vals[i]);
+	}
+
+	if ((n > 0 && mysql_stmt_bind_param(st, bind) != 0) || mysql_stmt_execute(st) != 0) {
+		PKI_log_err("Can not execute SQL statement (%s)", mysql_stmt_error(st));
+		return PKI_ERR;
+	}
+
+	return PKI_OK;
+}
 
 #endif
 
+/*! \brief Closes the idle connections of the MySQL connection pool */
+
+void URL_mysql_pool_flush ( void ) {
+
+#ifdef HAVE_MYSQL
+	if (mysql_pool) PKI_DB_POOL_flush ( mysql_pool );
+#endif
+	return;
+}
+
 PKI_MEM_STACK *URL_get_data_mysql ( const char *url_s, ssize_t size )
 {
 	PKI_MEM_STACK *ret = NULL;
@@ -304,14 +251,18 @@ PKI_MEM_STACK *URL_get_data_mysql ( const char *url_s, ssize_t size )
 PKI_MEM_STACK *URL_get_data_mysql_url ( const URL *url, ssize_t size ) {
 
 #ifdef HAVE_MYSQL
-	MYSQL_ROW row;
-	MYSQL * sql = NULL;
-	MYSQL_FIELD *fields = NULL;
-	MYSQL_RES *res = NULL;
-
-	unsigned long *lengths = NULL;
-	long long n_rows = 0;
-	int n_fields = 0;
+	PKI_DB_CONN * conn = NULL;
+	PKI_DB_QUERY * q = NULL;
+	MYSQL_STMT * st = NULL;
+	MYSQL_BIND * res = NULL;
+	MYSQL_BIND col;
+
+	unsigned long len = 0;
+	my_bool is_null = 0;
+	unsigned int n_fields = 0;
+	unsigned int i = 0;
+	int reusable = 0;
+	int rc = 0;
 
 	PKI_MEM *tmp_mem = NULL;
 	PKI_MEM_STACK *sk = NULL;
@@ -320,62 +271,81 @@ PKI_MEM_STACK *URL_get_data_mysql_url ( const URL *url, ssize_t size ) {
 
 	if( !url ) return (NULL);
 
-	if((sql = db_connect ( url )) == NULL )
-	{
-		return NULL;
-	}
-
-	if ((query = parse_url_query(url)) == NULL)
+	if ((q = PKI_DB_QUERY_new_url(url)) == NULL ||
+			(query = PKI_DB_QUERY_get_sql(q, PKI_DB_QUERY_SELECT, PKI_DB_PARAM_QMARK)) == NULL)
 	{
 		PKI_log_err("Can not parse URL query");
 		goto end;
 	}
-	else mysql_query(sql, query);
 
-	/* Get the Data */
-	if((res = mysql_store_result( sql )) == NULL)
+	if ((conn = _mysql_pool_get(url)) == NULL) goto end;
+
+	if ((st = _mysql_prepare(conn, query)) == NULL ||
+			_mysql_execute(st, q, NULL) != PKI_OK) goto end;
+
+	if ((n_fields = mysql_stmt_field_count(st)) < 1 ||
+			(res = PKI_Malloc(n_fields * sizeof(MYSQL_BIND))) == NULL)
 	{
-		PKI_log_err("Can not retrieve SQL data");
+		mysql_stmt_free_result(st);
 		goto end;
 	}
 
-	if( ((n_rows = (long long) mysql_num_rows( res )) < 1 ) || 
-			((sk = PKI_STACK_MEM_new()) == NULL))
+	// Only the first column is returned, its length is fetched first
+	// and the value is then read directly into the PKI_MEM
+	res[0].buffer_type = MYSQL_TYPE_BLOB;
+	res[0].length = &len;
+	res[0].is_null = &is_null;
+	for (i = 1; i < n_fields; i++) res[i].buffer_type = MYSQL_TYPE_NULL;
+
+	if (mysql_stmt_bind_result(st, res) != 0)
 	{
-		PKI_log_err("No returned rows found");
+		PKI_log_err("Can not bind SQL results (%s)", mysql_stmt_error(st));
+		mysql_stmt_free_result(st);
 		goto end;
 	}
 
-	while((row = mysql_fetch_row(res)) != NULL )
+	// Rows are streamed from the server (no client side result set)
+	while ((rc = mysql_stmt_fetch(st)) == 0 || rc == MYSQL_DATA_TRUNCATED)
 	{
-		/* Count the number of fields retrieved */
-		n_fields = (int) mysql_num_fields( res );
-		lengths = mysql_fetch_lengths( res );
-		fields = mysql_fetch_fields( res );
-		if (!fields)
-		{
-			PKI_ERROR(PKI_ERR_GENERAL, "can not fetch query fields");
-			break;
-		}
+		if (is_null || (size > 0 && len >= (unsigned long) size)) continue;
 
-		if (n_fields > 0)
-		{
-			tmp_mem = PKI_MEM_new_null();
-			if (size == 0 || (( size > 0 ) && ( lengths[0] < size)))
-			{
-				PKI_MEM_add(tmp_mem,row[0],lengths[0]);
+		if (!sk && (sk = PKI_STACK_MEM_new()) == NULL) break;
 
-				/* For now, let's only deal with one 
-				   field at the time */
-				PKI_STACK_push( sk, tmp_mem );
+		if (len == 0) {
+			tmp_mem = PKI_MEM_new_null();
+		} else if ((tmp_mem = PKI_MEM_new((size_t) len)) != NULL) {
+			memset(&col, 0, sizeof(col));
+			col.buffer_type = MYSQL_TYPE_BLOB;
+			col.buffer = tmp_mem->data;
+			col.buffer_length = len;
+			if (mysql_stmt_fetch_column(st, &col, 0, 0) != 0) {
+				PKI_MEM_free(tmp_mem);
+				tmp_mem = NULL;
 			}
 		}
+
+		if (!tmp_mem) {
+			PKI_ERROR(PKI_ERR_GENERAL, "can not fetch query fields");
+			break;
+		}
+
+		/* For now, let's only deal with one
+		   field at the time */
+		PKI_STACK_push( sk, tmp_mem );
 	}
 
+	// The connection can be reused when all the rows have been read
+	reusable = (rc == MYSQL_NO_DATA);
+	mysql_stmt_free_result(st);
+
+	if (!sk) PKI_log_debug("No returned rows found");
+
 end:
 
+	if (res) PKI_Free (res);
 	if (query) PKI_Free (query);
-	db_close ( sql );
+	if (q) PKI_DB_QUERY_free (q);
+	if (conn) PKI_DB_POOL_put (conn, reusable);
 
 	return ( sk );
 
@@ -424,32 +394,31 @@ int URL_put_data_mysql ( const char *url_s, const PKI_MEM *data ) {
 int URL_put_data_mysql_url ( const URL *url, const PKI_MEM *data ) {
 
 #ifdef HAVE_MYSQL
-	MYSQL * sql = NULL;
+	PKI_DB_CONN * conn = NULL;
+	PKI_DB_QUERY * q = NULL;
+	MYSQL_STMT * st = NULL;
 
 	char * query = NULL;
+	int ret = PKI_ERR;
 
-	if( !url ) return (PKI_ERR);
+	if( !url || !data ) return (PKI_ERR);
 
-	if((query = parse_url_put_query( url, data )) == NULL ) {
+	if ((q = PKI_DB_QUERY_new_url(url)) == NULL ||
+			(query = PKI_DB_QUERY_get_sql(q, PKI_DB_QUERY_PUT, PKI_DB_PARAM_QMARK)) == NULL) {
+		if (q) PKI_DB_QUERY_free(q);
 		return( PKI_ERR );
 	}
 
-	if((sql = db_connect ( url )) == NULL ) {
-		PKI_Free( query );
-		return(PKI_ERR);
-	}
-
-	if(mysql_query(sql, query ) != 0 ) {
-		PKI_Free ( query );
-		db_close( sql );
-
-		return( PKI_ERR );
+	if((conn = _mysql_pool_get ( url )) != NULL ) {
+		if ((st = _mysql_prepare(conn, query)) != NULL &&
+				_mysql_execute(st, q, data) == PKI_OK) ret = PKI_OK;
+		PKI_DB_POOL_put(conn, ret == PKI_OK);
 	}
 
 	PKI_Free (query);
-	db_close ( sql );
+	PKI_DB_QUERY_free (q);
 
-	return ( PKI_OK );
+	return ( ret );
 
 #else
 	return ( PKI_ERR );
@@ -8,173 +8,6 @@
  
 #include <libpki/pki.h>
 
-char *pg_parse_url_query ( const URL * url ) {
-
-	char * ret = NULL;
-	char * table = NULL;
-	char * tmp_s = NULL;
-	char * tmp_s2 = NULL;
-	int where = 0;
-	int add_and = 0;
-
-	char col[1024];
-	char val[1024];
-	char tmp[1024];
-
-	PKI_MEM *buf = NULL;
-
-	if( !url || !url->path ) return( NULL );
-
-	tmp_s = url->path;
-
-	while((tmp_s2 = strchr(tmp_s, '/')) != NULL ) {
-		tmp_s2++;
-		tmp_s = tmp_s2;
-	}
-
-	if((table = parse_url_table ( url )) == NULL) {
-		return (NULL);
-	}
-
-	if((buf = PKI_MEM_new_null()) == NULL ) {
-		return ( NULL );
-	}
-
-	snprintf( tmp, sizeof( tmp ), "SELECT %s from %s ", url->attrs, table );
-	PKI_Free (table);
-
-	PKI_MEM_add( buf, (const unsigned char *)tmp, strlen( tmp ));
-
-	where = 0;
-	while( sscanf(tmp_s, "(%[^)=]=%[^)])", col, val) > 1 ) {
-		if( where == 0 ) {
-			/* Let's add the WHERE clause */
-			PKI_MEM_add(buf, (const unsigned char *)"WHERE ", 6);
-			where = 1;
-		}
-		/* The tmp_s should point to the next token */
-		tmp_s += strlen(col) + strlen(val) + 3;
-
-		/* Control if we need to add the AND in the SQL statement */
-		if( add_and == 1 ) {
-			PKI_MEM_add( buf, (const unsigned char *)" AND ", 5);
-		}
-
-		PKI_MEM_add( buf, (const unsigned char *)col, strlen( col ));
-		PKI_MEM_add( buf, (const unsigned char *)"='", 2);
-		PKI_MEM_add( buf, (const unsigned char *)val, strlen( val ));
-		PKI_MEM_add( buf, (const unsigned char *)"' ", 2);
-
-		/* This triggers the adding of AND on the next iteration */
-		add_and = 1;
-	}
-
-	if( (ret = PKI_Malloc (buf->size+1)) == NULL ) {
-		PKI_MEM_free ( buf );
-		return( NULL );
-	}
-	memcpy( ret, buf->data, buf->size );
-
-	PKI_MEM_free ( buf );
-	return( ret );
-}
-
-char *pg_parse_url_put_query ( const URL * url, const PKI_MEM *data ) {
-
-	char * ret = NULL;
-	char * table = NULL;
-	char * tmp_s = NULL;
-	char * tmp_s2 = NULL;
-
-	int where = 0;
-	int add_and = 0;
-
-	char col[1024];
-	char val[1024];
-	char tmp[1024];
-
-	// char buf[BUFF_MAX_SIZE];
-
-	PKI_MEM *buf = NULL;
-
-	if( !url || !url->path ) return( NULL );
-
-	tmp_s = url->path;
-
-	while((tmp_s2 = strchr(tmp_s, '/')) != NULL ) {
-		tmp_s2++;
-		tmp_s = tmp_s2;
-	}
-
-	if((table = parse_url_table ( url )) == NULL) {
-		return (NULL);
-	}
-
-	if((buf = PKI_MEM_new_null()) == NULL ) {
-		return ( NULL );
-	}
-
-	sprintf( tmp, "INSERT INTO %s (%s) VALUES ('", table, url->attrs );
-	PKI_MEM_add( buf, (const unsigned char *)tmp, strlen( tmp ));
-	PKI_MEM_add( buf, data->data, data->size );
-	PKI_MEM_add( buf, (const unsigned char *)"') ", 3);
-
-	/*
-	base=strlen(buf);
-	for( i=0; i < data->size; i++ ) {
-		sprintf(buf + base + i, "%c", data->data[i]);
-	}
-	sprintf(buf+base+i,"') ");
-	*/
-
-	where = 0;
-	while( (sscanf(tmp_s, "(%[^)=]=\"%[^)\"]\")", col, val) > 1) ||
-			(sscanf(tmp_s, "(%[^)=]=%[^)])", col, val) > 1)) {
-		if( where == 0 ) {
-			/* It is actually an update, let's update! */
-			snprintf( tmp, sizeof( tmp ),
-				"UPDATE %s SET %s='", table, url->attrs);
-			if( buf ) PKI_MEM_free ( buf );
-
-			buf = PKI_MEM_new_null();
-			PKI_MEM_add( buf, (const unsigned char *)tmp, strlen( tmp ));
-			PKI_MEM_add( buf, data->data, data->size );
-			PKI_MEM_add( buf, (const unsigned char *)"' WHERE ", 8);
-
-			/* Let's add the WHERE clause */
-			where = 1;
-		}
-		/* The tmp_s should point to the next token */
-		tmp_s += strlen(col) + strlen(val) + 3;
-
-		/* Control if we need to add the AND in the SQL statement */
-		if( add_and == 1 ) {
-			PKI_MEM_add( buf, (const unsigned char *)" AND ", 5);
-		}
-
-		PKI_MEM_add( buf, (const unsigned char *)col, strlen( col ));
-		PKI_MEM_add( buf, (const unsigned char *)"='", 2);
-		PKI_MEM_add( buf, (const unsigned char *)val, strlen( val ));
-		PKI_MEM_add( buf, (const unsigned char *)"' ", 2 );
-
-		/* This triggers the adding of AND on the next iteration */
-		add_and = 1;
-	}
-
-	PKI_Free (table);
-
-	if( (ret = PKI_Malloc(buf->size) + 1) == NULL ) {
-		if( buf ) PKI_MEM_free ( buf );
-		return( NULL );
-	}
-	memcpy( ret, buf->data, buf->size );
-
-	PKI_MEM_free ( buf );
-
-	return( ret );
-}
-
-
 char *pg_parse_url_table ( const URL * url ) {
 	char *tmp_s = NULL;
 	char *tmp_s2 = NULL;
@@ -237,19 +70,22 @@ PGconn *pg_db_connect ( const URL *url ) {
 
         PGconn *sql = NULL;
 	char * dbname = NULL;
+	char port[16];
 
 	dbname = pg_parse_url_dbname ( url );
+	if (url->port > 0) snprintf(port, sizeof(port), "%d", url->port);
 
-	sql = PQsetdbLogin( url->addr, NULL, NULL, NULL,
+	sql = PQsetdbLogin( url->addr, url->port > 0 ? port : NULL, NULL, NULL,
        			                 dbname, url->usr, url->pwd );
 
+	if( dbname ) PKI_Free (dbname);
+
 	if(PQstatus(sql) == CONNECTION_BAD) {
-		if( dbname ) PKI_Free (dbname);
+		PKI_log_err("Can not connect to the DB (%s)", PQerrorMessage(sql));
 		pg_db_close( sql );
+		return ( NULL );
 	}
 
-	if( dbname ) PKI_Free (dbname);
-
 	return( sql );
 }
 
@@ -262,31 +98,138 @@ int pg_db_close ( PGconn *sql ) {
         return (PKI_OK);
 }
 
+static PKI_DB_POOL *pg_pool = NULL;
+static pthread_once_t pg_pool_once = PTHREAD_ONCE_INIT;
+
+static void * _pg_pool_connect ( const URL *url ) {
+	return pg_db_connect ( url );
+}
+
+static int _pg_pool_ping ( void *handle ) {
+
+	PGresult *res = NULL;
+	int ret = PKI_ERR;
+
+	if (PQstatus((PGconn *) handle) != CONNECTION_OK) return PKI_ERR;
+
+	// The empty query is a round trip to the server
+	if ((res = PQexec((PGconn *) handle, "")) != NULL &&
+			PQresultStatus(res) == PGRES_EMPTY_QUERY) ret = PKI_OK;
+
+	if (res) PQclear(res);
+
+	return ret;
+}
+
+static void _pg_pool_close ( void *handle ) {
+	pg_db_close( (PGconn *) handle );
+}
+
+/* Cached statements are the names of the server side prepared statements */
+static void _pg_pool_stmt_free ( void *handle, void *stmt ) {
+
+	PGresult *res = NULL;
+	char sql[64];
+
+	if (PQstatus((PGconn *) handle) == CONNECTION_OK) {
+		snprintf(sql, sizeof(sql), "DEALLOCATE %s", (char *) stmt);
+		if ((res = PQexec((PGconn *) handle, sql)) != NULL) PQclear(res);
+	}
+
+	free(stmt);
+}
+
+static const PKI_DB_POOL_CALLBACKS pg_pool_cb = {
+	_pg_pool_connect,
+	_pg_pool_ping,
+	_pg_pool_close,
+	_pg_pool_stmt_free
+};
+
+static void _pg_pool_init ( void ) {
+	pg_pool = PKI_DB_POOL_new ( &pg_pool_cb );
+}
+
+static PKI_DB_CONN * _pg_pool_get ( const URL *url ) {
+
+	pthread_once(&pg_pool_once, _pg_pool_init);
+	if (!pg_pool) return NULL;
+
+	return PKI_DB_POOL_get ( pg_pool, url );
+}
+
+/* Returns the name of the (cached) prepared statement for the SQL text */
+static const char * _pg_prepare ( PKI_DB_CONN *conn, const char *sql, int n_params ) {
+
+	PGresult *res = NULL;
+	char *ret = NULL;
+	char name[32];
+
+	if ((ret = PKI_DB_CONN_get_stmt(conn, sql)) != NULL) return ret;
+
+	snprintf(name, sizeof(name), "libpki_%lu", conn->stmts_count);
+
+	if ((res = PQprepare((PGconn *) conn->handle, name, sql, n_params, NULL)) == NULL ||
+			PQresultStatus(res) != PGRES_COMMAND_OK) {
+		PKI_log_err("Can not prepare SQL statement (%s)",
+			PQerrorMessage((PGconn *) conn->handle));
+		if (res) PQclear(res);
+		return NULL;
+	}
+	PQclear(res);
+
+	if ((ret = strdup(name)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	if (PKI_DB_CONN_add_stmt(conn, sql, ret) != PKI_OK) {
+		_pg_pool_stmt_free(conn->handle, ret);
+		return NULL;
+	}
+
+	return ret;
+}
 
 #endif
 
+/*! \brief Closes the idle connections of the PostgreSQL connection pool */
+
+void URL_pg_pool_flush ( void ) {
+
+#ifdef HAVE_PG
+	if (pg_pool) PKI_DB_POOL_flush ( pg_pool );
+#endif
+	return;
+}
+
 PKI_MEM_STACK *URL_get_data_pg ( const char *url_s, ssize_t size ) {
+
+	PKI_MEM_STACK *ret = NULL;
 	URL *url = NULL;
 
 	if( !url_s ) return (NULL);
 
-	if(((url = URL_new( url_s )) == NULL) ||
-		url->proto != URI_PROTO_PG ) {
-		return (NULL);
-	}
+	if ((url = URL_new( url_s )) == NULL) return (NULL);
+
+	if (url->proto == URI_PROTO_PG) ret = URL_get_data_pg_url( url, size );
+
+	URL_free ( url );
 
-	return ( URL_get_data_pg_url( url, size ));
+	return ( ret );
 }
 
 PKI_MEM_STACK *URL_get_data_pg_url ( const URL *url, ssize_t size ) {
 
 #ifdef HAVE_PG
-	PGconn *sql;
-        PGresult *res;
+	PKI_DB_CONN *conn = NULL;
+	PKI_DB_QUERY *q = NULL;
+	PGconn *sql = NULL;
+	PGresult *res = NULL;
+	const char *st = NULL;
 
-	int n_rows = 0;
-	int i = 0;
-	int n_fields = 0;
+	int len = 0;
+	int reusable = 0;
 
 	PKI_MEM *tmp_mem = NULL;
 	PKI_MEM_STACK *sk = NULL;
@@ -295,56 +238,62 @@ PKI_MEM_STACK *URL_get_data_pg_url ( const URL *url, ssize_t size ) {
 
 	if( !url ) return (NULL);
 
-	query = pg_parse_url_query( url );
+	if ((q = PKI_DB_QUERY_new_url(url)) == NULL ||
+			(query = PKI_DB_QUERY_get_sql(q, PKI_DB_QUERY_SELECT, PKI_DB_PARAM_DOLLAR)) == NULL) {
+		PKI_log_err("Can not parse URL query");
+		goto end;
+	}
 
-	if((sql = pg_db_connect ( url )) == NULL ) {
-		PKI_Free( query );
-		return(NULL);
+	if ((conn = _pg_pool_get(url)) == NULL) goto end;
+	sql = (PGconn *) conn->handle;
+
+	// Binary results return the column's data as-is
+	if ((st = _pg_prepare(conn, query, q->params_num)) == NULL ||
+			!PQsendQueryPrepared(sql, st, q->params_num,
+				(const char * const *) q->vals, NULL, NULL, 1)) {
+		PKI_log_err("Can not execute SQL statement (%s)", PQerrorMessage(sql));
+		goto end;
 	}
 
-	/* Get the Data */
-	if(((res = PQexec( sql, query )) == NULL) || 
-			(PQresultStatus( res ) != PGRES_COMMAND_OK )) {
+	// Rows are streamed from the server (no client side result set)
+	PQsetSingleRowMode(sql);
 
-		PQclear( res );
-		PKI_Free( query );
-                return(NULL);
-        }
+	while ((res = PQgetResult(sql)) != NULL) {
 
-        if( ((n_rows = PQntuples(res)) < 1 ) || 
-			((sk = PKI_STACK_MEM_new()) == NULL)) {
-		PKI_Free( query );
-		return(NULL);
-	}
+		if (PQresultStatus(res) == PGRES_SINGLE_TUPLE) {
 
-	/* Count the number of fields retrieved */
-	n_fields = PQnfields( res );
+			if (PQnfields(res) > 0 && !PQgetisnull(res, 0, 0)) {
 
-	for(i = 0; i < n_rows; i++ ) {
+				len = PQgetlength(res, 0, 0);
+				if (size == 0 || (size > 0 && len < size)) {
 
-		if( n_fields > 0 ) {
-			tmp_mem = PKI_MEM_new_null();
-			if( (size == 0 ) || 
-				    (( size > 0 ) && 
-					( PQgetlength(res, i, 0) < size)) ) {
+					if (!sk) sk = PKI_STACK_MEM_new();
 
-				PKI_MEM_add(tmp_mem,
-					PQgetvalue ( res, i, 0 ),
-					(size_t) PQgetlength( res, i, 0 )
-				);
+					if (len > 0) tmp_mem = PKI_MEM_new_data((size_t) len,
+							(const unsigned char *) PQgetvalue(res, 0, 0));
+					else tmp_mem = PKI_MEM_new_null();
 
-				/* For now, let's only deal with one 
-				   field at the time */
-				PKI_STACK_push( sk, tmp_mem );
+					/* For now, let's only deal with one
+					   field at the time */
+					if (sk && tmp_mem) PKI_STACK_push( sk, tmp_mem );
+					else if (tmp_mem) PKI_MEM_free(tmp_mem);
+				}
 			}
-                }
 
-        }
+		} else if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+			PKI_log_err("Can not retrieve SQL data (%s)", PQresultErrorMessage(res));
+		}
+
+		PQclear(res);
+	}
+
+	reusable = (PQstatus(sql) == CONNECTION_OK);
 
-	PQclear( res );
+end:
 
-	PKI_Free (query);
-	pg_db_close ( sql );
+	if (query) PKI_Free (query);
+	if (q) PKI_DB_QUERY_free (q);
+	if (conn) PKI_DB_POOL_put (conn, reusable);
 
 	return ( sk );
 
@@ -356,17 +305,15 @@ PKI_MEM_STACK *URL_get_data_pg_url ( const URL *url, ssize_t size ) {
 int URL_put_data_pg ( const char *url_s, const PKI_MEM *data ) {
 
 	URL *url = NULL;
-	int ret = 0;
+	int ret = PKI_ERR;
 
 	if( !url_s ) return (PKI_ERR);
 
-	if(((url = URL_new( url_s )) == NULL) ||
-		url->proto != URI_PROTO_PG ) {
-		return (PKI_ERR);
-	}
+	if ((url = URL_new( url_s )) == NULL) return (PKI_ERR);
+
+	if (url->proto == URI_PROTO_PG) ret = URL_put_data_pg_url( url, data );
 
-	ret = URL_put_data_pg_url( url, data );
-	if( url ) URL_free ( url );
+	URL_free ( url );
 
 	return ( ret );
 }
@@ -374,33 +321,55 @@ int URL_put_data_pg ( const char *url_s, const PKI_MEM *data ) {
 int URL_put_data_pg_url ( const URL *url, const PKI_MEM *data ) {
 
 #ifdef HAVE_PG
-	PGconn * sql = NULL;
-        PGresult *res = NULL;
+	PKI_DB_CONN *conn = NULL;
+	PKI_DB_QUERY *q = NULL;
+	PGresult *res = NULL;
+	const char *st = NULL;
 
-	int ret = PKI_OK;
+	const char *values[PKI_DB_QUERY_MAX_PARAMS + 1];
+	int lengths[PKI_DB_QUERY_MAX_PARAMS + 1];
+	int formats[PKI_DB_QUERY_MAX_PARAMS + 1];
+
+	int ret = PKI_ERR;
+	int i = 0;
 	char * query = NULL;
 
-	if( !url ) return (PKI_ERR);
+	if( !url || !data ) return (PKI_ERR);
 
-	if((query = pg_parse_url_put_query( url, data )) == NULL ) {
+	if ((q = PKI_DB_QUERY_new_url(url)) == NULL ||
+			(query = PKI_DB_QUERY_get_sql(q, PKI_DB_QUERY_PUT, PKI_DB_PARAM_DOLLAR)) == NULL) {
+		if (q) PKI_DB_QUERY_free(q);
 		return( PKI_ERR );
 	}
 
-	if((sql = pg_db_connect ( url )) == NULL ) {
-		PKI_Free( query );
-		return(PKI_ERR);
+	// The data is passed in binary format, the conditions as text
+	values[0] = (const char *) data->data;
+	lengths[0] = (int) data->size;
+	formats[0] = 1;
+	for (i = 0; i < q->params_num; i++) {
+		values[i + 1] = q->vals[i];
+		lengths[i + 1] = 0;
+		formats[i + 1] = 0;
 	}
 
-	/* Get the Data */
-	if(((res = PQexec( sql, query )) == NULL) || 
-			(PQresultStatus( res ) != PGRES_COMMAND_OK )) {
+	if ((conn = _pg_pool_get(url)) != NULL) {
 
-		// PQclear( res );
-		ret = PKI_ERR;
-        }
+		if ((st = _pg_prepare(conn, query, q->params_num + 1)) != NULL &&
+				(res = PQexecPrepared((PGconn *) conn->handle, st, q->params_num + 1,
+					values, lengths, formats, 0)) != NULL &&
+				PQresultStatus(res) == PGRES_COMMAND_OK) {
+			ret = PKI_OK;
+		} else {
+			PKI_log_err("Can not execute SQL statement (%s)",
+				PQerrorMessage((PGconn *) conn->handle));
+		}
+
+		if (res) PQclear(res);
+		PKI_DB_POOL_put(conn, PQstatus((PGconn *) conn->handle) == CONNECTION_OK);
+	}
 
-	if( res ) PQclear( res );
-	if( query ) PKI_Free (query);
+	PKI_Free (query);
+	PKI_DB_QUERY_free (q);
 
 	return ( ret );
 
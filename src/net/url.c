@@ -284,6 +284,11 @@ PKI_MEM_STACK *URL_get_data_url(const URL * url,
 		return NULL;
 	}
 
+	// Remote objects (e.g., CRLs and OCSP responses) are served from
+	// the fetch cache while fresh
+	if (!ssl && URL_CACHE_is_cacheable(url))
+		return URL_CACHE_get_data_url(url, timeout, size);
+
 	switch( url->proto ) {
 		case URI_PROTO_FD:
 			ret = URL_get_data_fd( url, size );
@@ -1060,9 +1065,9 @@ URL *URL_new(const char * url_s ) {
 				memcpy( ret->attrs, tmp_attrs + 1, len);
 
 				len = (size_t) (tmp_attrs - tmp_s2);
-				ret->path = (char *) malloc ( len );
-				memset( ret->path, 0, len);
-				memcpy( ret->path, tmp_s2, len - 1);
+				ret->path = (char *) malloc ( len + 1 );
+				memcpy( ret->path, tmp_s2, len);
+				ret->path[len] = '\x0';
 
 				if( !ret->addr ) {
 					len = (size_t) (tmp_s2 - tmp_s - 1);
@@ -0,0 +1,1016 @@
+/* src/net/url_cache.c */
+/*
+ * Fetch Cache for Remote Objects
+ * Copyright (c) 2007 by Massimiliano Pala and OpenCA Project
+ * OpenCA Licensed Code
+ */
+
+#include <libpki/pki.h>
+
+/*
+ * NOTE: the cache outlives the single requests, its memory is allocated
+ *       with malloc()/calloc() directly so it is never taken from a
+ *       request arena. The returned stacks are copies (PKI_Malloc).
+ */
+
+#define URL_CACHE_BUCKETS		256
+
+#define URL_CACHE_FILE_MAGIC		"LIBPKI-URL-CACHE 1"
+
+/* Results of a fetch */
+#define URL_CACHE_FETCH_ERR		-1
+#define URL_CACHE_FETCH_NOT_MODIFIED	0
+#define URL_CACHE_FETCH_NEW		1
+
+typedef struct url_cache_obj_st {
+	unsigned char * data;
+	size_t size;
+} URL_CACHE_OBJ;
+
+typedef struct url_cache_data_st {
+	URL_CACHE_OBJ * objs;
+	int objs_num;
+	/* Size limit used for the fetch (0 for none) */
+	ssize_t fetch_size;
+	time_t expires;
+	/* Validators (HTTP) */
+	char * etag;
+	char * last_modified;
+} URL_CACHE_DATA;
+
+typedef struct url_cache_entry_st {
+	char * key;
+	unsigned long hash;
+	/* No objects for entries being fetched the first time */
+	URL_CACHE_DATA data;
+	/* Single-flight state */
+	int fetching;
+	int waiters;
+	int failed;
+	unsigned long seq;
+	struct url_cache_entry_st * next;
+	struct url_cache_entry_st * lru_prev;
+	struct url_cache_entry_st * lru_next;
+} URL_CACHE_ENTRY;
+
+static pthread_mutex_t _cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _cache_cond = PTHREAD_COND_INITIALIZER;
+
+static URL_CACHE_ENTRY * _cache_buckets[URL_CACHE_BUCKETS];
+static URL_CACHE_ENTRY * _cache_lru_head = NULL;
+static URL_CACHE_ENTRY * _cache_lru_tail = NULL;
+static int _cache_num = 0;
+
+static int _cache_size = URL_CACHE_DEFAULT_SIZE;
+static int _cache_default_ttl = 0;
+static char * _cache_dir = NULL;
+
+// ==================
+// Entries Management
+// ==================
+
+static unsigned long _cache_hash(const char *key) {
+
+	unsigned long h = 2166136261UL;
+
+	for ( ; *key; key++) {
+		h ^= (unsigned char) *key;
+		h *= 16777619UL;
+	}
+
+	return h;
+}
+
+static void _cache_data_clear(URL_CACHE_DATA *d) {
+
+	int i = 0;
+
+	for (i = 0; i < d->objs_num; i++) free(d->objs[i].data);
+
+	free(d->objs);
+	free(d->etag);
+	free(d->last_modified);
+
+	memset(d, 0, sizeof(URL_CACHE_DATA));
+}
+
+static URL_CACHE_ENTRY * _cache_find(const char *key, unsigned long hash) {
+
+	URL_CACHE_ENTRY *e = NULL;
+
+	for (e = _cache_buckets[hash % URL_CACHE_BUCKETS]; e != NULL; e = e->next) {
+		if (e->hash == hash && strcmp(e->key, key) == 0) return e;
+	}
+
+	return NULL;
+}
+
+static void _cache_lru_unlink(URL_CACHE_ENTRY *e) {
+
+	if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+	else _cache_lru_head = e->lru_next;
+
+	if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+	else _cache_lru_tail = e->lru_prev;
+
+	e->lru_prev = e->lru_next = NULL;
+}
+
+static void _cache_lru_push(URL_CACHE_ENTRY *e) {
+
+	e->lru_prev = NULL;
+	e->lru_next = _cache_lru_head;
+
+	if (_cache_lru_head) _cache_lru_head->lru_prev = e;
+	else _cache_lru_tail = e;
+
+	_cache_lru_head = e;
+}
+
+/* Takes ownership of the key */
+static URL_CACHE_ENTRY * _cache_insert(char *key, unsigned long hash) {
+
+	URL_CACHE_ENTRY *e = NULL;
+
+	if ((e = calloc(1, sizeof(URL_CACHE_ENTRY))) == NULL) return NULL;
+
+	e->key = key;
+	e->hash = hash;
+	e->next = _cache_buckets[hash % URL_CACHE_BUCKETS];
+	_cache_buckets[hash % URL_CACHE_BUCKETS] = e;
+
+	_cache_lru_push(e);
+	_cache_num++;
+
+	return e;
+}
+
+static void _cache_remove(URL_CACHE_ENTRY *e) {
+
+	URL_CACHE_ENTRY **pp = NULL;
+
+	for (pp = &_cache_buckets[e->hash % URL_CACHE_BUCKETS]; *pp != NULL; pp = &(*pp)->next) {
+		if (*pp == e) {
+			*pp = e->next;
+			break;
+		}
+	}
+
+	_cache_lru_unlink(e);
+	_cache_data_clear(&e->data);
+	_cache_num--;
+
+	free(e->key);
+	free(e);
+}
+
+/* Removes the least recently used entries (not in use) over the size */
+static void _cache_evict(void) {
+
+	URL_CACHE_ENTRY *e = NULL, *prev = NULL;
+
+	for (e = _cache_lru_tail; e != NULL && _cache_num > _cache_size; e = prev) {
+		prev = e->lru_prev;
+		if (!e->fetching && !e->waiters) _cache_remove(e);
+	}
+}
+
+static PKI_MEM_STACK * _cache_copy_stack(const URL_CACHE_DATA *d) {
+
+	PKI_MEM_STACK *ret = NULL;
+	PKI_MEM *obj = NULL;
+	int i = 0;
+
+	if ((ret = PKI_STACK_MEM_new()) == NULL) return NULL;
+
+	for (i = 0; i < d->objs_num; i++) {
+
+		if (d->objs[i].size > 0) obj = PKI_MEM_new_data(d->objs[i].size, d->objs[i].data);
+		else obj = PKI_MEM_new_null();
+
+		if (!obj) {
+			PKI_STACK_MEM_free_all(ret);
+			return NULL;
+		}
+
+		PKI_STACK_MEM_push(ret, obj);
+	}
+
+	return ret;
+}
+
+static int _cache_set_objs(URL_CACHE_DATA *d, PKI_MEM_STACK *sk) {
+
+	PKI_MEM *obj = NULL;
+	int i = 0, num = 0;
+
+	if ((num = PKI_STACK_MEM_elements(sk)) <= 0) return PKI_ERR;
+
+	if ((d->objs = calloc((size_t) num, sizeof(URL_CACHE_OBJ))) == NULL) return PKI_ERR;
+
+	for (i = 0; i < num; i++) {
+		obj = PKI_STACK_MEM_get_num(sk, i);
+		if (obj && obj->size > 0) {
+			if ((d->objs[i].data = malloc(obj->size)) == NULL) {
+				_cache_data_clear(d);
+				return PKI_ERR;
+			}
+			memcpy(d->objs[i].data, obj->data, obj->size);
+			d->objs[i].size = obj->size;
+		}
+		d->objs_num++;
+	}
+
+	return PKI_OK;
+}
+
+/* Only data retrieved without (or with a larger) size limit is reused */
+static int _cache_size_ok(const URL_CACHE_DATA *d, ssize_t size) {
+	return (d->fetch_size <= 0 || (size > 0 && size <= d->fetch_size));
+}
+
+/* Normalized URL (lowercase protocol and host, explicit port) */
+static char * _cache_key(const URL *url) {
+
+	const char *proto = NULL;
+	const char *path = NULL;
+	char *ret = NULL;
+	size_t len = 0, i = 0, ofs = 0;
+
+	if ((proto = URL_proto_to_string((URI_PROTO) url->proto)) == NULL || !url->addr) return NULL;
+
+	path = url->path ? url->path : "";
+
+	len = strlen(proto) + strlen(url->addr) + strlen(path)
+		+ (url->attrs ? strlen(url->attrs) : 0) + 32;
+
+	if ((ret = malloc(len)) == NULL) return NULL;
+
+	snprintf(ret, len, "%s://%s:%d%s%s%s%s", proto, url->addr, url->port,
+		path[0] == '/' ? "" : "/", path, url->attrs ? "?" : "",
+		url->attrs ? url->attrs : "");
+
+	ofs = strlen(proto) + 3;
+	for (i = 0; i < ofs + strlen(url->addr); i++) ret[i] = (char) tolower((unsigned char) ret[i]);
+
+	return ret;
+}
+
+// ==================
+// Freshness
+// ==================
+
+/* Seconds since the epoch for a UTC broken-down time */
+static time_t _cache_timegm(int year, int mon, int mday, int hour, int min, int sec) {
+
+	long long y = year - (mon <= 2);
+	long long era = (y >= 0 ? y : y - 399) / 400;
+	long long yoe = y - era * 400;
+	long long doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+	long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	long long days = era * 146097 + doe - 719468;
+
+	return (time_t) (days * 86400 + hour * 3600 + min * 60 + sec);
+}
+
+/* Parses an HTTP date (RFC 7231 IMF-fixdate) */
+static time_t _cache_http_date(const char *s) {
+
+	static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	char mon[4];
+	const char *p = NULL;
+	int mday = 0, year = 0, hour = 0, min = 0, sec = 0;
+
+	if (!s || sscanf(s, "%*3s, %d %3s %d %d:%d:%d", &mday, mon, &year, &hour, &min, &sec) != 6)
+		return -1;
+
+	if ((p = strstr(months, mon)) == NULL || (p - months) % 3 != 0) return -1;
+
+	return _cache_timegm(year, (int) (p - months) / 3 + 1, mday, hour, min, sec);
+}
+
+static time_t _cache_asn1_time(const ASN1_TIME *t, time_t now) {
+
+	int day = 0, sec = 0;
+
+	if (!t || !ASN1_TIME_diff(&day, &sec, NULL, t)) return -1;
+
+	return now + (time_t) day * 86400 + sec;
+}
+
+/* Returns the earliest nextUpdate of the retrieved CRLs and OCSP responses */
+static time_t _cache_next_update(const URL_CACHE_DATA *d, time_t now) {
+
+	const unsigned char *p = NULL;
+	X509_CRL *crl = NULL;
+	OCSP_RESPONSE *resp = NULL;
+	OCSP_BASICRESP *bs = NULL;
+	ASN1_GENERALIZEDTIME *next = NULL;
+	BIO *bio = NULL;
+	time_t ret = -1, t = -1;
+	int i = 0, j = 0;
+
+	for (i = 0; i < d->objs_num; i++) {
+
+		if (d->objs[i].size < 2) continue;
+
+		p = d->objs[i].data;
+		if ((crl = d2i_X509_CRL(NULL, &p, (long) d->objs[i].size)) == NULL
+				&& d->objs[i].data[0] == '-'
+				&& (bio = BIO_new_mem_buf(d->objs[i].data, (int) d->objs[i].size)) != NULL) {
+			crl = PEM_read_bio_X509_CRL(bio, NULL, NULL, NULL);
+			BIO_free(bio);
+		}
+
+		if (crl) {
+			t = _cache_asn1_time(X509_CRL_get0_nextUpdate(crl), now);
+			if (t > 0 && (ret < 0 || t < ret)) ret = t;
+			X509_CRL_free(crl);
+			continue;
+		}
+
+		p = d->objs[i].data;
+		if ((resp = d2i_OCSP_RESPONSE(NULL, &p, (long) d->objs[i].size)) == NULL) continue;
+
+		if ((bs = OCSP_response_get1_basic(resp)) != NULL) {
+			for (j = 0; j < OCSP_resp_count(bs); j++) {
+				next = NULL;
+				OCSP_single_get0_status(OCSP_resp_get0(bs, j), NULL, NULL, NULL, &next);
+				t = _cache_asn1_time(next, now);
+				if (t > 0 && (ret < 0 || t < ret)) ret = t;
+			}
+			OCSP_BASICRESP_free(bs);
+		}
+		OCSP_RESPONSE_free(resp);
+	}
+
+	ERR_clear_error();
+
+	return ret;
+}
+
+/* Checks for a Cache-Control directive (and its value, if any) */
+static int _cache_control(const char *cc, const char *name, long *value) {
+
+	size_t len = strlen(name);
+
+	while (cc && *cc) {
+
+		while (*cc == ' ' || *cc == '\t' || *cc == ',') cc++;
+
+		if (strncmp_nocase(cc, name, (int) len) == 0
+				&& (cc[len] == '\x0' || cc[len] == ',' || cc[len] == ' ' || cc[len] == '=')) {
+			if (value) *value = (cc[len] == '=') ? strtol(cc + len + (cc[len + 1] == '"' ? 2 : 1), NULL, 10) : -1;
+			return 1;
+		}
+
+		cc = strchr(cc, ',');
+	}
+
+	return 0;
+}
+
+static char * _cache_header(const PKI_HTTP *msg, const char *name) {
+
+	char *tmp = NULL, *ret = NULL;
+
+	if ((tmp = PKI_HTTP_get_header(msg, name)) != NULL) {
+		ret = strdup(tmp);
+		PKI_Free(tmp);
+	}
+
+	return ret;
+}
+
+/*
+ * Sets the expiration of the data from the HTTP headers (if any) and the
+ * nextUpdate of the objects. Returns 0 when the data must not be stored.
+ */
+static int _cache_freshness(URL_CACHE_DATA *d, const PKI_HTTP *msg, time_t now) {
+
+	char *cc = NULL, *tmp = NULL;
+	time_t expires = -1, next = -1, date = -1, lm = -1;
+	long val = -1, age = 0;
+	int store = 1;
+
+	if (msg) {
+
+		cc = _cache_header(msg, "Cache-Control");
+
+		if (_cache_control(cc, "no-store", NULL)) store = 0;
+		else if (_cache_control(cc, "no-cache", NULL)) expires = now;
+		else if (_cache_control(cc, "s-maxage", &val) && val >= 0) expires = now + val;
+		else if (_cache_control(cc, "max-age", &val) && val >= 0) expires = now + val;
+
+		if (expires > now && (tmp = _cache_header(msg, "Age")) != NULL) {
+			if ((age = atol(tmp)) > 0) expires -= age;
+			free(tmp);
+		}
+
+		if (expires < 0 && (tmp = _cache_header(msg, "Expires")) != NULL) {
+			char *date_s = _cache_header(msg, "Date");
+			date = _cache_http_date(date_s);
+			expires = _cache_http_date(tmp);
+			// Expired for invalid dates (e.g., "0")
+			expires = (expires < 0) ? now : now + (expires - (date > 0 ? date : now));
+			free(date_s);
+			free(tmp);
+		}
+
+		free(cc);
+
+		if (!store) return 0;
+
+		if (!d->etag) d->etag = _cache_header(msg, "ETag");
+		if (!d->last_modified) d->last_modified = _cache_header(msg, "Last-Modified");
+	}
+
+	// Objects are never served past their nextUpdate
+	next = _cache_next_update(d, now);
+
+	if (expires >= 0) {
+		if (next > 0 && next < expires) expires = next;
+	} else if (next > 0) {
+		expires = next;
+	} else if ((lm = _cache_http_date(d->last_modified)) > 0 && lm < now) {
+		// Heuristic freshness (10% of the age of the object)
+		expires = now + ((now - lm) / 10 < URL_CACHE_HEURISTIC_MAX_TTL ?
+			(now - lm) / 10 : URL_CACHE_HEURISTIC_MAX_TTL);
+	} else {
+		expires = now + _cache_default_ttl;
+	}
+
+	if (expires > now + URL_CACHE_MAX_TTL) expires = now + URL_CACHE_MAX_TTL;
+	d->expires = expires;
+
+	// Stale data is kept only if it can be revalidated
+	return (expires > now || d->etag || d->last_modified);
+}
+
+// ==================
+// Fetching
+// ==================
+
+/*
+ * Retrieves the data from the network. The prior data validators are
+ * used for conditional HTTP requests (URL_CACHE_FETCH_NOT_MODIFIED is
+ * returned when the prior data is still valid, out has the freshness).
+ */
+static int _cache_fetch(const URL *url, int timeout, ssize_t size,
+			const URL_CACHE_DATA *prior, URL_CACHE_DATA *out, int *store) {
+
+	PKI_MEM_STACK *sk = NULL;
+	PKI_HTTP *msg = NULL;
+	char headers[1024];
+	size_t len = 0;
+	time_t now = 0;
+	int ret = URL_CACHE_FETCH_ERR;
+
+	*store = 0;
+	out->fetch_size = size;
+
+	if (url->proto == URI_PROTO_HTTP) {
+
+		headers[0] = '\x0';
+		if (prior && prior->objs && prior->etag && strlen(prior->etag) < 256) {
+			len += (size_t) snprintf(headers + len, sizeof(headers) - len,
+				"If-None-Match: %s\r\n", prior->etag);
+		}
+		if (prior && prior->objs && prior->last_modified && strlen(prior->last_modified) < 256) {
+			len += (size_t) snprintf(headers + len, sizeof(headers) - len,
+				"If-Modified-Since: %s\r\n", prior->last_modified);
+		}
+
+		if ((msg = PKI_HTTP_GET_message_url(url, headers, timeout,
+				size > 0 ? (size_t) size : 0)) == NULL) return URL_CACHE_FETCH_ERR;
+
+		now = time(NULL);
+
+		if (msg->code == 304 && len > 0) {
+			// Freshness of the prior objects with the new headers
+			out->objs = prior->objs;
+			out->objs_num = prior->objs_num;
+			*store = _cache_freshness(out, msg, now);
+			out->objs = NULL;
+			out->objs_num = 0;
+			ret = URL_CACHE_FETCH_NOT_MODIFIED;
+		} else if (msg->code == 200 && (sk = PKI_STACK_MEM_new()) != NULL) {
+			PKI_STACK_MEM_push(sk, msg->body ? msg->body : PKI_MEM_new_null());
+			msg->body = NULL;
+			if (_cache_set_objs(out, sk) == PKI_OK) {
+				*store = _cache_freshness(out, msg, now);
+				ret = URL_CACHE_FETCH_NEW;
+			}
+		} else {
+			PKI_log_debug("HTTP Return code [Code: %d]", msg->code);
+		}
+
+		PKI_HTTP_free(msg);
+
+	} else {
+
+		switch (url->proto) {
+#ifdef HAVE_LDAP
+			case URI_PROTO_LDAP:
+				sk = URL_get_data_ldap_url(url, timeout, size);
+				break;
+#endif
+#ifdef HAVE_LIBRESOLV
+			case URI_PROTO_DNS:
+				sk = URL_get_data_dns_url(url, size);
+				break;
+#endif
+			default:
+				break;
+		}
+
+		if (sk && _cache_set_objs(out, sk) == PKI_OK) {
+			*store = _cache_freshness(out, NULL, time(NULL));
+			ret = URL_CACHE_FETCH_NEW;
+		}
+	}
+
+	if (sk) PKI_STACK_MEM_free_all(sk);
+
+	return ret;
+}
+
+// ==================
+// Disk Tier
+// ==================
+
+static char * _cache_file(const char *dir, const char *key) {
+
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	unsigned int md_len = 0;
+	char *ret = NULL;
+	size_t len = 0;
+	int i = 0;
+
+	if (!EVP_Digest(key, strlen(key), md, &md_len, EVP_sha256(), NULL)) return NULL;
+
+	len = strlen(dir) + 2 * md_len + 16;
+	if ((ret = malloc(len)) == NULL) return NULL;
+
+	i = snprintf(ret, len, "%s/", dir);
+	for (md_len = 0; md_len < SHA256_DIGEST_LENGTH; md_len++) {
+		i += snprintf(ret + i, len - (size_t) i, "%2.2x", md[md_len]);
+	}
+	snprintf(ret + i, len - (size_t) i, ".cache");
+
+	return ret;
+}
+
+static int _cache_disk_store(const char *dir, const char *key, const URL_CACHE_DATA *d) {
+
+	char *path = NULL, *tmp = NULL;
+	FILE *fp = NULL;
+	size_t len = 0;
+	int i = 0, ok = 0;
+
+	if (strchr(key, '\n') || (path = _cache_file(dir, key)) == NULL) return PKI_ERR;
+
+	len = strlen(path) + 64;
+	if ((tmp = malloc(len)) == NULL) {
+		free(path);
+		return PKI_ERR;
+	}
+
+	// Written to a temporary file first, readers never see partial entries
+	snprintf(tmp, len, "%s.%ld.%lu", path, (long) getpid(),
+		(unsigned long) PKI_THREAD_self());
+
+	if ((fp = fopen(tmp, "wb")) != NULL) {
+
+		ok = (fprintf(fp, "%s\n%s\n%lld %lld %d\n%s\n%s\n", URL_CACHE_FILE_MAGIC, key,
+			(long long) d->expires, (long long) d->fetch_size, d->objs_num,
+			d->etag ? d->etag : "", d->last_modified ? d->last_modified : "") > 0);
+
+		for (i = 0; ok && i < d->objs_num; i++) {
+			ok = (fprintf(fp, "%lu\n", (unsigned long) d->objs[i].size) > 0
+				&& (d->objs[i].size == 0 ||
+					fwrite(d->objs[i].data, d->objs[i].size, 1, fp) == 1));
+		}
+
+		if (fclose(fp) != 0) ok = 0;
+		if (ok) ok = (rename(tmp, path) == 0);
+		if (!ok) unlink(tmp);
+	}
+
+	if (!ok) PKI_log_debug("Can not store the cache entry (%s)", path);
+
+	free(tmp);
+	free(path);
+
+	return ok ? PKI_OK : PKI_ERR;
+}
+
+/* Returns the next line (NUL terminated in place) */
+static char * _cache_line(char **p, char *end) {
+
+	char *ret = *p, *eol = NULL;
+
+	if (ret >= end || (eol = memchr(ret, '\n', (size_t) (end - ret))) == NULL) return NULL;
+
+	*eol = '\x0';
+	*p = eol + 1;
+
+	return ret;
+}
+
+static int _cache_disk_load(const char *dir, const char *key, URL_CACHE_DATA *d) {
+
+	char *path = NULL, *buf = NULL, *p = NULL, *end = NULL, *line = NULL;
+	long long expires = 0, fetch_size = 0;
+	unsigned long size = 0;
+	struct stat st;
+	FILE *fp = NULL;
+	int i = 0, num = 0, ok = 0;
+
+	if ((path = _cache_file(dir, key)) == NULL) return PKI_ERR;
+
+	if ((fp = fopen(path, "rb")) != NULL && fstat(fileno(fp), &st) == 0 && st.st_size > 0
+			&& (buf = malloc((size_t) st.st_size + 1)) != NULL
+			&& fread(buf, (size_t) st.st_size, 1, fp) == 1) {
+
+		p = buf;
+		end = buf + st.st_size;
+
+		ok = ((line = _cache_line(&p, end)) != NULL && strcmp(line, URL_CACHE_FILE_MAGIC) == 0
+			&& (line = _cache_line(&p, end)) != NULL && strcmp(line, key) == 0
+			&& (line = _cache_line(&p, end)) != NULL
+			&& sscanf(line, "%lld %lld %d", &expires, &fetch_size, &num) == 3
+			&& num > 0 && num < 65536
+			&& (d->objs = calloc((size_t) num, sizeof(URL_CACHE_OBJ))) != NULL);
+
+		if (ok && (line = _cache_line(&p, end)) != NULL && *line) d->etag = strdup(line);
+		if (ok && line && (line = _cache_line(&p, end)) != NULL && *line) d->last_modified = strdup(line);
+		if (!line) ok = 0;
+
+		for (i = 0; ok && i < num; i++) {
+			if ((line = _cache_line(&p, end)) == NULL || sscanf(line, "%lu", &size) != 1
+					|| size > (unsigned long) (end - p)) {
+				ok = 0;
+				break;
+			}
+			if (size > 0) {
+				if ((d->objs[i].data = malloc(size)) == NULL) {
+					ok = 0;
+					break;
+				}
+				memcpy(d->objs[i].data, p, size);
+				d->objs[i].size = size;
+			}
+			d->objs_num++;
+			p += size;
+		}
+
+		d->expires = (time_t) expires;
+		d->fetch_size = (ssize_t) fetch_size;
+	}
+
+	if (fp) fclose(fp);
+	free(buf);
+	free(path);
+
+	if (!ok) _cache_data_clear(d);
+
+	return ok ? PKI_OK : PKI_ERR;
+}
+
+// ==================
+// Exported Functions
+// ==================
+
+/*! \brief Sets the maximum number of cached URLs (0 disables the cache) */
+
+int URL_CACHE_set_size ( int entries ) {
+
+	if (entries < 0) return PKI_ERROR(PKI_ERR_PARAM_RANGE, NULL);
+
+	pthread_mutex_lock(&_cache_lock);
+	_cache_size = entries;
+	_cache_evict();
+	pthread_mutex_unlock(&_cache_lock);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Sets the freshness lifetime (secs) of objects without expiration
+ *
+ * The default (0) does not cache objects that have no HTTP expiration
+ * headers, no validators and no nextUpdate.
+ */
+
+int URL_CACHE_set_default_ttl ( int secs ) {
+
+	if (secs < 0 || secs > URL_CACHE_MAX_TTL) return PKI_ERROR(PKI_ERR_PARAM_RANGE, NULL);
+
+	pthread_mutex_lock(&_cache_lock);
+	_cache_default_ttl = secs;
+	pthread_mutex_unlock(&_cache_lock);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Sets the directory for the on-disk tier of the cache
+ *
+ * Entries are stored in the directory (one file per URL) and are loaded
+ * when they are not in memory. Pass NULL to disable the disk tier.
+ */
+
+int URL_CACHE_set_dir ( const char * dir ) {
+
+	char *tmp = NULL;
+
+	if (dir) {
+		if (access(dir, R_OK | W_OK | X_OK) != 0) {
+			PKI_log_err("Can not use %s as the URL cache directory", dir);
+			return PKI_ERROR(PKI_ERR_PARAM_TYPE, dir);
+		}
+		if ((tmp = strdup(dir)) == NULL) return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	pthread_mutex_lock(&_cache_lock);
+	free(_cache_dir);
+	_cache_dir = tmp;
+	pthread_mutex_unlock(&_cache_lock);
+
+	return PKI_OK;
+}
+
+/*! \brief Returns 1 if the data of the URL can be cached, 0 otherwise */
+
+int URL_CACHE_is_cacheable ( const URL * url ) {
+
+	if (!url || url->usr || url->pwd || _cache_size <= 0) return 0;
+
+	switch (url->proto) {
+		case URI_PROTO_HTTP:
+#ifdef HAVE_LDAP
+		case URI_PROTO_LDAP:
+#endif
+#ifdef HAVE_LIBRESOLV
+		case URI_PROTO_DNS:
+#endif
+			return 1;
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+/*!
+ * \brief Returns the data of the URL from the cache (or from the network)
+ *
+ * Fresh cached data is returned without contacting the server. Otherwise
+ * the data is retrieved (or revalidated) by a single caller while the
+ * other callers for the same URL wait for the result.
+ */
+
+PKI_MEM_STACK * URL_CACHE_get_data_url ( const URL * url,
+					 int         timeout,
+					 ssize_t     size ) {
+
+	URL_CACHE_ENTRY *e = NULL;
+	URL_CACHE_DATA prior, fetched, store_data;
+	PKI_MEM_STACK *ret = NULL;
+	char *key = NULL, *dir = NULL;
+	unsigned long hash = 0, seq = 0;
+	int prior_owned = 0, from_disk = 0;
+	int rc = URL_CACHE_FETCH_ERR, store = 0;
+
+	if (!url) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (!URL_CACHE_is_cacheable(url)) return URL_get_data_url(url, timeout, size, NULL);
+
+	if ((key = _cache_key(url)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+	hash = _cache_hash(key);
+
+	memset(&prior, 0, sizeof(prior));
+	memset(&fetched, 0, sizeof(fetched));
+	memset(&store_data, 0, sizeof(store_data));
+
+	pthread_mutex_lock(&_cache_lock);
+
+	for (;;) {
+
+		if ((e = _cache_find(key, hash)) == NULL) {
+			if ((e = _cache_insert(key, hash)) == NULL) {
+				pthread_mutex_unlock(&_cache_lock);
+				PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+				free(key);
+				return NULL;
+			}
+			key = NULL;
+			break;
+		}
+
+		// Waits for the fetch in progress (single-flight)
+		if (e->fetching) {
+			seq = e->seq;
+			e->waiters++;
+			while (e->fetching) pthread_cond_wait(&_cache_cond, &_cache_lock);
+			e->waiters--;
+			if (e->seq != seq && e->failed) {
+				if (!e->data.objs && !e->waiters && !e->fetching) _cache_remove(e);
+				pthread_mutex_unlock(&_cache_lock);
+				free(key);
+				return NULL;
+			}
+			continue;
+		}
+
+		if (e->data.objs && e->data.expires > time(NULL) && _cache_size_ok(&e->data, size)) {
+			ret = _cache_copy_stack(&e->data);
+			_cache_lru_unlink(e);
+			_cache_lru_push(e);
+			pthread_mutex_unlock(&_cache_lock);
+			free(key);
+			return ret;
+		}
+
+		break;
+	}
+
+	// This caller retrieves the data, the entry is not modified by
+	// others (nor removed) until the fetching flag is cleared
+	e->fetching = 1;
+	if (e->data.objs && _cache_size_ok(&e->data, size)) prior = e->data;
+	if (_cache_dir) dir = strdup(_cache_dir);
+
+	pthread_mutex_unlock(&_cache_lock);
+
+	free(key);
+	key = NULL;
+
+	if (!prior.objs && dir && _cache_disk_load(dir, e->key, &prior) == PKI_OK) {
+		if (_cache_size_ok(&prior, size)) {
+			prior_owned = 1;
+		} else _cache_data_clear(&prior);
+	}
+
+	if (prior_owned && prior.expires > time(NULL)) {
+		// Fresh data from the disk tier
+		fetched = prior;
+		memset(&prior, 0, sizeof(prior));
+		prior_owned = 0;
+		from_disk = 1;
+		store = 1;
+		rc = URL_CACHE_FETCH_NEW;
+	} else {
+		rc = _cache_fetch(url, timeout, size, &prior, &fetched, &store);
+	}
+
+	pthread_mutex_lock(&_cache_lock);
+
+	if (rc == URL_CACHE_FETCH_NEW) {
+
+		if (store) {
+			_cache_data_clear(&e->data);
+			e->data = fetched;
+			memset(&fetched, 0, sizeof(fetched));
+			ret = _cache_copy_stack(&e->data);
+		} else {
+			// The data is not kept (e.g., no-store)
+			_cache_data_clear(&e->data);
+			ret = _cache_copy_stack(&fetched);
+		}
+
+	} else if (rc == URL_CACHE_FETCH_NOT_MODIFIED) {
+
+		if (prior_owned) {
+			_cache_data_clear(&e->data);
+			e->data = prior;
+			memset(&prior, 0, sizeof(prior));
+			prior_owned = 0;
+		}
+
+		if (store) {
+			e->data.expires = fetched.expires;
+			if (fetched.etag) {
+				free(e->data.etag);
+				e->data.etag = fetched.etag;
+				fetched.etag = NULL;
+			}
+			if (fetched.last_modified) {
+				free(e->data.last_modified);
+				e->data.last_modified = fetched.last_modified;
+				fetched.last_modified = NULL;
+			}
+			ret = _cache_copy_stack(&e->data);
+		} else {
+			ret = _cache_copy_stack(&e->data);
+			_cache_data_clear(&e->data);
+		}
+	}
+
+	e->failed = (ret == NULL);
+	e->fetching = 0;
+	e->seq++;
+
+	// Snapshot for the disk tier (written outside the lock)
+	if (dir && store && !from_disk && e->data.objs) {
+		store_data = e->data;
+		store_data.objs = NULL;
+		store_data.objs_num = 0;
+		store_data.etag = NULL;
+		store_data.last_modified = NULL;
+		if ((store_data.objs = calloc((size_t) e->data.objs_num, sizeof(URL_CACHE_OBJ))) != NULL) {
+			int i = 0;
+			for (i = 0; i < e->data.objs_num; i++) {
+				if (e->data.objs[i].size > 0 &&
+						(store_data.objs[i].data = malloc(e->data.objs[i].size)) == NULL) break;
+				if (e->data.objs[i].size > 0) memcpy(store_data.objs[i].data,
+					e->data.objs[i].data, e->data.objs[i].size);
+				store_data.objs[i].size = e->data.objs[i].size;
+				store_data.objs_num++;
+			}
+			if (e->data.etag) store_data.etag = strdup(e->data.etag);
+			if (e->data.last_modified) store_data.last_modified = strdup(e->data.last_modified);
+			if (store_data.objs_num == e->data.objs_num) key = strdup(e->key);
+		}
+	}
+
+	if (!e->data.objs && !e->waiters) {
+		_cache_remove(e);
+	} else {
+		_cache_lru_unlink(e);
+		_cache_lru_push(e);
+	}
+
+	_cache_evict();
+
+	pthread_cond_broadcast(&_cache_cond);
+	pthread_mutex_unlock(&_cache_lock);
+
+	if (key) _cache_disk_store(dir, key, &store_data);
+
+	if (prior_owned) _cache_data_clear(&prior);
+	_cache_data_clear(&fetched);
+	_cache_data_clear(&store_data);
+	free(key);
+	free(dir);
+
+	return ret;
+}
+
+/*! \brief Removes the URL from the cache (memory and disk) */
+
+int URL_CACHE_invalidate ( const char * url_s ) {
+
+	URL_CACHE_ENTRY *e = NULL;
+	URL *url = NULL;
+	char *key = NULL, *path = NULL;
+
+	if (!url_s) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if ((url = URL_new(url_s)) == NULL || (key = _cache_key(url)) == NULL) {
+		if (url) URL_free(url);
+		return PKI_ERROR(PKI_ERR_URI_PARSE, url_s);
+	}
+	URL_free(url);
+
+	pthread_mutex_lock(&_cache_lock);
+
+	if ((e = _cache_find(key, _cache_hash(key))) != NULL) {
+		if (e->fetching || e->waiters) e->data.expires = 0;
+		else _cache_remove(e);
+	}
+
+	if (_cache_dir && (path = _cache_file(_cache_dir, key)) != NULL) {
+		unlink(path);
+		free(path);
+	}
+
+	pthread_mutex_unlock(&_cache_lock);
+
+	free(key);
+
+	return PKI_OK;
+}
+
+/*! \brief Removes all the entries from the memory cache */
+
+void URL_CACHE_flush ( void ) {
+
+	URL_CACHE_ENTRY *e = NULL, *next = NULL;
+
+	pthread_mutex_lock(&_cache_lock);
+
+	for (e = _cache_lru_head; e != NULL; e = next) {
+		next = e->lru_next;
+		if (!e->fetching && !e->waiters) _cache_remove(e);
+	}
+
+	pthread_mutex_unlock(&_cache_lock);
+}
@@ -204,6 +204,9 @@ void PKI_X509_ALGOR_VALUE_free(PKI_X509_ALGOR_VALUE *a) {
 	// Input check
 	if ( !a ) return;
 
+	// Shared values are never freed
+	if (PKI_X509_ALGOR_VALUE_is_interned(a)) return;
+
 	// Free the memory
 	X509_ALGOR_free(a);
 
@@ -323,45 +326,45 @@ PKI_X509_ALGOR_VALUE * PKI_X509_ALGOR_VALUE_new_pkey(const PKI_X509_KEYPAIR_VALU
 
 PKI_X509_ALGOR_VALUE * PKI_X509_ALGOR_VALUE_get_by_name ( const char *alg_s ) {
 
-	char *pnt, *data, *tk;
 	char buf[1024];
-	int i;
+	size_t len = 0;
+	size_t i = 0;
+
+	const char * dash = NULL;
+	int sep = 0;
 
 	PKI_ALGOR_ID alg_nid = PKI_ALGOR_ID_UNKNOWN;
 
 	/* Check the argument */
 	if (!alg_s) return (NULL);
 
-	if ((data = strdup(alg_s)) == NULL)
-	{
-		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
-		return NULL;
-	}
+	// PQC/Composite names are known once the methods are loaded
+	PKI_init_crypto_methods();
 
-	for (i = 0; i < strlen(data); i++)
-	{
-		data[i] = (char) toupper(data[i]);
-	}
+	// Skips leading separators, names without a token are rejected
+	while (*alg_s == '-') alg_s++;
+	if (*alg_s == '\0') return NULL;
 
-	if (( tk = strtok_r ( data, "-", &pnt )) == NULL ) {
-		// No '-' found in the algoritm, an error!
-		PKI_Free ( data );
-		return NULL;
-	}
-
-	if( strncmp_nocase(tk, "ECDSA", 5 ) == 0 ) {
-		snprintf(buf, sizeof(buf), "ecdsa-with");
-	} else {
-		snprintf(buf, sizeof(buf), "%s", tk );
+	// The "ECDSA-<digest>" names map to "ecdsa-with-<DIGEST>"
+	if ((dash = strchr(alg_s, '-')) != NULL
+			&& dash - alg_s == 5 && strncmp_nocase(alg_s, "ECDSA", 5) == 0) {
+		len = (size_t) snprintf(buf, sizeof(buf), "ecdsa-with");
+		alg_s = dash;
 	}
 
-	for ( tk = strtok_r ( NULL, "-", &pnt ); tk;
-					tk = strtok_r ( NULL, "\r\n", &pnt )) {
-
-		if ( tk == NULL ) break;
-		snprintf(buf+strlen(buf), sizeof(buf) - strlen(buf) - strlen(tk),
-			"-%s", tk );
+	// Copies the (uppercase) name, stops at the end of the line. The
+	// separators after the first token are collapsed into one, and
+	// dropped when nothing follows them (e.g., "RSA--SHA256", "SHA256-")
+	for (i = 0; alg_s[i] && alg_s[i] != '\r' && alg_s[i] != '\n'; i++) {
+		if (alg_s[i] == '-' && !sep) {
+			sep = 1;
+			while (alg_s[i + 1] == '-') i++;
+			if (!alg_s[i + 1] || alg_s[i + 1] == '\r' || alg_s[i + 1] == '\n') break;
+		}
+		if (len >= sizeof(buf) - 1) return NULL;
+		buf[len++] = (char) toupper((unsigned char) alg_s[i]);
 	}
+	buf[len] = '\0';
 
 	// Check if the object is a valid OID
 	if ((alg_nid = OBJ_sn2nid( buf )) <= 0) {
@@ -375,7 +378,7 @@ PKI_X509_ALGOR_VALUE * PKI_X509_ALGOR_VALUE_get_by_name ( const char *alg_s ) {
 		}
 	}
 
-	// Returns the pointer to the PKI_X509_ALGOR_VALUE structure
+	// Returns the pointer to the (shared) PKI_X509_ALGOR_VALUE structure
 	return PKI_X509_ALGOR_VALUE_get(alg_nid);
 }
 
@@ -1193,248 +1196,296 @@ int PKI_SCHEME_ID_security_bits(const PKI_SCHEME_ID   scheme_id,
 	return PKI_OK;
 }
 
-PKI_SCHEME_ID PKI_SCHEME_ID_get_by_name(const char * data, int *classic_sec_bits, int *quantum_sec_bits) {
+/* Scheme names and aliases, the security bits are set only for names that
+ * select a specific parameter set (zero means the scheme's default) */
+typedef struct pki_scheme_alias_st {
+	const char * name;
+	PKI_SCHEME_ID scheme;
+	int classic_sec_bits;
+	int quantum_sec_bits;
+} PKI_SCHEME_ALIAS;
 
-	PKI_SCHEME_ID ret = PKI_SCHEME_UNKNOWN;
-		// Return value
-
-	int default_sec_bits = 1;
-		// If set to 1, the function will return the default
-		// security bits for the given scheme
-
-	// Input Checks
-	if (!data) {
-		if (classic_sec_bits) *classic_sec_bits = 0;
-		if (quantum_sec_bits) *quantum_sec_bits = 0;
-		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
-		return PKI_SCHEME_UNKNOWN;
-	}
+static const PKI_SCHEME_ALIAS _scheme_aliases[] = {
 
 #ifdef ENABLE_COMPOSITE
 
 	// Generic Composite
-	if (ret == PKI_SCHEME_UNKNOWN) {
-		if (str_cmp_ex(data, "COMPOSITE", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE;
-		}
-	}
+	{ "COMPOSITE", PKI_SCHEME_COMPOSITE, 0, 0 },
 
 #if defined(ENABLE_OQS) || defined (ENABLE_OQSPROV)
 
-	// Explicit Composite
-	if (ret == PKI_SCHEME_UNKNOWN) {
-		// Explicit Composite - DILITHIUM3-P256
-		if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_P256_SHA256_OID, 0, 1) == 0 ||
-			str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_P256_SHA256_NAME, 0, 1) == 0 ||
-			str_cmp_ex(data, "DILITHIUM3-ECDSA", 0, 1) == 0 ||
-			str_cmp_ex(data, "DILITHIUM3-EC", 0, 1) == 0 ||
-			str_cmp_ex(data, "DILITHIUM3-P256", 0, 1) == 0 ||
-			str_cmp_ex(data, "D3-P256", 0, 1) == 0 ||
-			str_cmp_ex(data, "DILITHIUM-P256", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256;
-		// Explicit Composite - DILITHIUM3-RSA
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSA_SHA256_OID, 0, 1) == 0 ||
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSA_SHA256_NAME, 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-RSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "D3-RSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM3-RSA", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSA;
-		// Explicit Composite - DILITHIUM3-BRAINPOOL256
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_BRAINPOOL256_SHA256_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_BRAINPOOL256_SHA256_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "DILITHIUM-BRAINPOOL", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM3-BRAINPOOL", 0, 1) == 0 ||
-					str_cmp_ex(data, "D3-B256", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM3-B256", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_BRAINPOOL256;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_ED25519_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_ED25519_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "DILITHIUM-ED25519", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-25519", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM3-ED25519", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM3-25519", 0, 1) == 0 ||
-					str_cmp_ex(data, "D3-ED25519", 0, 1) == 0 ||
-					str_cmp_ex(data, "D3-25519", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM3-25519", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_P384_SHA384_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_P384_SHA384_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "DILITHIUM5-ECDSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM5-EC", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-P384", 0, 1) == 0 ||
-					str_cmp_ex(data, "D5-P384", 0, 1) == 0 ||
-					str_cmp_ex(data, "D5-ECDSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM5-P384", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_BRAINPOOL384_SHA384_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_BRAINPOOL384_SHA384_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "DILITHIUM5-BRAINPOOL", 0, 1) == 0 ||
-					str_cmp_ex(data, "D5-B384", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM5-B384", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_BRAINPOOL384;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_ED448_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_ED448_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "DILITHIUM5-448", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-ED448", 0, 1) == 0 ||
-					str_cmp_ex(data, "D5-ED448", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-448", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_ED448;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_P256_SHA256_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_P256_SHA256_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON512-P256", 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON-ECDSA", 0, 1) == 0 || 
-					str_cmp_ex(data, "F512-ECDSA", 0, 1) == 0 || 
-					str_cmp_ex(data, "F512-P256", 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON-P256", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_BRAINPOOL256_SHA256_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_BRAINPOOL256_SHA256_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON512-BRAINPOOL", 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON-BRAINPOOL256", 0, 1) == 0 || 
-					str_cmp_ex(data, "F512-B256", 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON-BRAINPOOL", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_BRAINPOOL256;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_ED25519_OID, 0, 1) == 0 ||
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_ED25519_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON512-25519", 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON-ED25519", 0, 1) == 0 || 
-					str_cmp_ex(data, "F512-ED25519", 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON-25519", 0, 1) == 0) {
-			return PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519;
-		// } else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_SPHINCS256_P256_SHA256_OID, 0, 1) == 0 || 
-		// 			str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_SPHINCS256_P256_SHA256_NAME, 0, 1) == 0 || 
-		// 			str_cmp_ex(data, "SPHINCS256-ECDSA", 0, 1) == 0 || 
-		// 			str_cmp_ex(data, "SPHINCS-ECDSA", 0, 1) == 0 || 
-		// 			str_cmp_ex(data, "SPHINCS-P256", 0, 1) == 0) {
-		// 	return PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSAPSS_SHA256_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSAPSS_SHA256_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "DILITHIUM3-RSAPSS", 0, 1) == 0 || 
-					str_cmp_ex(data, "D3-RSAPSS", 0, 1) == 0 || 
-					str_cmp_ex(data, "DILITHIUM-RSAPSS", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSAPSS;
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_RSA_SHA256_OID, 0, 1) == 0 || 
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_RSA_SHA256_NAME, 0, 1) == 0 || 
-					str_cmp_ex(data, "FALCON-RSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "F512-RSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "FALCON512-RSA", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_RSA;
-		// Explicit Composite - DILITHIUM5-FALCON1024-ECDSA-P521
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_P521_SHA512_OID, 0, 1) == 0 ||
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_P521_SHA512_NAME, 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-FALCON-EC", 0, 1) == 0 ||
-					str_cmp_ex(data, "D5-F1024-P521", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM5-FALCON1024-P521", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-FALCON-P521", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_P521;
-		// Explicit Composite - DILITHIUM5-FALCON1024-ECDSA-RSA
-		} else if (str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_RSA_SHA256_OID, 0, 1) == 0 ||
-					str_cmp_ex(data, OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_RSA_SHA256_NAME, 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM-FALCON-RSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "D5-F1024-RSA", 0, 1) == 0 ||
-					str_cmp_ex(data, "DILITHIUM5-FALCON1024-RSA", 0, 1) == 0) {
-			ret = PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_RSA;
-		}
-	}
+	// Explicit Composite - DILITHIUM3-P256
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_P256_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_P256_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256, 0, 0 },
+	{ "DILITHIUM3-ECDSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256, 0, 0 },
+	{ "DILITHIUM3-EC", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256, 0, 0 },
+	{ "DILITHIUM3-P256", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256, 0, 0 },
+	{ "D3-P256", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256, 0, 0 },
+	{ "DILITHIUM-P256", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_P256, 0, 0 },
+
+	// Explicit Composite - DILITHIUM3-RSA
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSA_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSA, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSA_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSA, 0, 0 },
+	{ "DILITHIUM-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSA, 0, 0 },
+	{ "D3-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSA, 0, 0 },
+	{ "DILITHIUM3-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSA, 0, 0 },
+
+	// Explicit Composite - DILITHIUM3-BRAINPOOL256
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_BRAINPOOL256_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_BRAINPOOL256, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_BRAINPOOL256_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_BRAINPOOL256, 0, 0 },
+	{ "DILITHIUM-BRAINPOOL", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_BRAINPOOL256, 0, 0 },
+	{ "DILITHIUM3-BRAINPOOL", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_BRAINPOOL256, 0, 0 },
+	{ "D3-B256", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_BRAINPOOL256, 0, 0 },
+	{ "DILITHIUM3-B256", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_BRAINPOOL256, 0, 0 },
+
+	// Explicit Composite - DILITHIUM3-ED25519
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_ED25519_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_ED25519_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+	{ "DILITHIUM-ED25519", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+	{ "DILITHIUM-25519", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+	{ "DILITHIUM3-ED25519", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+	{ "DILITHIUM3-25519", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+	{ "D3-ED25519", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+	{ "D3-25519", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_ED25519, 0, 0 },
+
+	// Explicit Composite - DILITHIUM5-P384
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_P384_SHA384_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_P384_SHA384_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+	{ "DILITHIUM5-ECDSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+	{ "DILITHIUM5-EC", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+	{ "DILITHIUM-P384", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+	{ "D5-P384", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+	{ "D5-ECDSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+	{ "DILITHIUM5-P384", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_P384, 0, 0 },
+
+	// Explicit Composite - DILITHIUM5-BRAINPOOL384
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_BRAINPOOL384_SHA384_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_BRAINPOOL384, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_BRAINPOOL384_SHA384_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_BRAINPOOL384, 0, 0 },
+	{ "DILITHIUM5-BRAINPOOL", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_BRAINPOOL384, 0, 0 },
+	{ "D5-B384", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_BRAINPOOL384, 0, 0 },
+	{ "DILITHIUM5-B384", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_BRAINPOOL384, 0, 0 },
+
+	// Explicit Composite - DILITHIUM5-ED448
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_ED448_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_ED448, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_ED448_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_ED448, 0, 0 },
+	{ "DILITHIUM5-448", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_ED448, 0, 0 },
+	{ "DILITHIUM-ED448", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_ED448, 0, 0 },
+	{ "D5-ED448", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_ED448, 0, 0 },
+	{ "DILITHIUM-448", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_ED448, 0, 0 },
+
+	// Explicit Composite - FALCON512-P256
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_P256_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_P256_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256, 0, 0 },
+	{ "FALCON512-P256", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256, 0, 0 },
+	{ "FALCON-ECDSA", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256, 0, 0 },
+	{ "F512-ECDSA", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256, 0, 0 },
+	{ "F512-P256", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256, 0, 0 },
+	{ "FALCON-P256", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_P256, 0, 0 },
+
+	// Explicit Composite - FALCON512-BRAINPOOL256
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_BRAINPOOL256_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_BRAINPOOL256, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_BRAINPOOL256_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_BRAINPOOL256, 0, 0 },
+	{ "FALCON512-BRAINPOOL", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_BRAINPOOL256, 0, 0 },
+	{ "FALCON-BRAINPOOL256", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_BRAINPOOL256, 0, 0 },
+	{ "F512-B256", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_BRAINPOOL256, 0, 0 },
+	{ "FALCON-BRAINPOOL", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_BRAINPOOL256, 0, 0 },
+
+	// Explicit Composite - FALCON512-ED25519
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_ED25519_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_ED25519_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519, 0, 0 },
+	{ "FALCON512-25519", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519, 0, 0 },
+	{ "FALCON-ED25519", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519, 0, 0 },
+	{ "F512-ED25519", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519, 0, 0 },
+	{ "FALCON-25519", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_ED25519, 0, 0 },
+
+	// Explicit Composite - DILITHIUM3-RSAPSS
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSAPSS_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSAPSS, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM3_RSAPSS_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSAPSS, 0, 0 },
+	{ "DILITHIUM3-RSAPSS", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSAPSS, 0, 0 },
+	{ "D3-RSAPSS", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSAPSS, 0, 0 },
+	{ "DILITHIUM-RSAPSS", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM3_RSAPSS, 0, 0 },
+
+	// Explicit Composite - FALCON512-RSA
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_RSA_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_RSA, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_FALCON512_RSA_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_RSA, 0, 0 },
+	{ "FALCON-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_RSA, 0, 0 },
+	{ "F512-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_RSA, 0, 0 },
+	{ "FALCON512-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_FALCON512_RSA, 0, 0 },
+
+	// Explicit Composite - DILITHIUM5-FALCON1024-ECDSA-P521
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_P521_SHA512_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_P521, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_P521_SHA512_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_P521, 0, 0 },
+	{ "DILITHIUM-FALCON-EC", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_P521, 0, 0 },
+	{ "D5-F1024-P521", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_P521, 0, 0 },
+	{ "DILITHIUM5-FALCON1024-P521", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_P521, 0, 0 },
+	{ "DILITHIUM-FALCON-P521", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_P521, 0, 0 },
+
+	// Explicit Composite - DILITHIUM5-FALCON1024-RSA
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_RSA_SHA256_OID, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_RSA, 0, 0 },
+	{ OPENCA_ALG_PKEY_EXP_COMP_EXPLICIT_DILITHIUM5_FALCON1024_RSA_SHA256_NAME, PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_RSA, 0, 0 },
+	{ "DILITHIUM-FALCON-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_RSA, 0, 0 },
+	{ "D5-F1024-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_RSA, 0, 0 },
+	{ "DILITHIUM5-FALCON1024-RSA", PKI_SCHEME_COMPOSITE_EXPLICIT_DILITHIUM5_FALCON1024_RSA, 0, 0 },
+
 #endif // End of ENABLE_OQS
 
 #endif // End of ENABLE_COMPOSITE
 
 #if defined(ENABLE_OQS) || defined(ENABLE_OQSPROV)
-	if (ret == PKI_SCHEME_UNKNOWN) {
-		if (str_cmp_ex(data, "DILITHIUMX3", 0, 1) == 0) { 
-			ret = PKI_SCHEME_DILITHIUMX3;
-		} else if (str_cmp_ex(data, "DILITHIUM2", 0, 1) == 0) {
-			default_sec_bits = 0;
-			if (classic_sec_bits) *classic_sec_bits = 128;
-			if (quantum_sec_bits) *quantum_sec_bits = 128;
-			ret = PKI_SCHEME_DILITHIUM;
-		} else if (str_cmp_ex(data, "DILITHIUM3", 0, 1) == 0) {
-			default_sec_bits = 0;
-			if (classic_sec_bits) *classic_sec_bits = 192;
-			if (quantum_sec_bits) *quantum_sec_bits = 192;
-			ret = PKI_SCHEME_DILITHIUM;
-		} else if (str_cmp_ex(data, "DILITHIUM5", 0, 1) == 0) {
-			default_sec_bits = 0;
-			if (classic_sec_bits) *classic_sec_bits = 256;
-			if (quantum_sec_bits) *quantum_sec_bits = 256;
-			ret = PKI_SCHEME_DILITHIUM;
-		} else if (str_cmp_ex(data, "DILITHIUM", 0, 1) == 0) {
-			ret = PKI_SCHEME_DILITHIUM;
-		} else if (str_cmp_ex(data, "FALCON512", 0, 1) == 0) {
-			default_sec_bits = 0;
-			if (classic_sec_bits) *classic_sec_bits = 128;
-			if (quantum_sec_bits) *quantum_sec_bits = 128;
-			ret = PKI_SCHEME_FALCON;
-		} else if (str_cmp_ex(data, "FALCON1024", 0, 1) == 0) {
-			default_sec_bits = 0;
-			if (classic_sec_bits) *classic_sec_bits = 256;
-			if (quantum_sec_bits) *quantum_sec_bits = 256;
-			ret = PKI_SCHEME_FALCON;
-		} else if (str_cmp_ex(data, "FALCON", 0, 1) == 0) {
-			ret = PKI_SCHEME_FALCON;
-		} else if (str_cmp_ex(data, "KYBER", 0, 1) == 0) {
-			ret = PKI_SCHEME_KYBER;
-		}
-	}
+
+	// Post-Quantum
+	{ "DILITHIUMX3", PKI_SCHEME_DILITHIUMX3, 0, 0 },
+	{ "DILITHIUM2", PKI_SCHEME_DILITHIUM, 128, 128 },
+	{ "DILITHIUM3", PKI_SCHEME_DILITHIUM, 192, 192 },
+	{ "DILITHIUM5", PKI_SCHEME_DILITHIUM, 256, 256 },
+	{ "DILITHIUM", PKI_SCHEME_DILITHIUM, 0, 0 },
+	{ "FALCON512", PKI_SCHEME_FALCON, 128, 128 },
+	{ "FALCON1024", PKI_SCHEME_FALCON, 256, 256 },
+	{ "FALCON", PKI_SCHEME_FALCON, 0, 0 },
+	{ "KYBER", PKI_SCHEME_KYBER, 0, 0 },
+
 #endif
 
-	// Checks for Traditional Crypto
-	// =============================
-	
-	if (ret == PKI_SCHEME_UNKNOWN) {
-		// RSA Option
-		if (str_cmp_ex(data, "RSA", 0, 1) == 0) {
-			ret = PKI_SCHEME_RSA;
-		// RSA-PSS Option
-		} else if (str_cmp_ex(data, "RSAPSS", 0, 1) == 0 ||
-				str_cmp_ex(data, "RSA-PSS", 0, 1) == 0) {
-			ret = PKI_SCHEME_RSAPSS;
+	// Traditional Crypto
+	{ "RSA", PKI_SCHEME_RSA, 0, 0 },
+	{ "RSAPSS", PKI_SCHEME_RSAPSS, 0, 0 },
+	{ "RSA-PSS", PKI_SCHEME_RSAPSS, 0, 0 },
 
 #ifdef ENABLE_ECDSA
-		// ED 25519 Option
-		} else if (str_cmp_ex(data, "ED25519", 0, 1) == 0) {
-			ret = PKI_SCHEME_ED25519;
-		// X25519 Option
-		} else if (str_cmp_ex(data, "X25519", 0, 1) == 0) {
-			ret = PKI_SCHEME_X25519;
-		// ED 448 Option
-		} else if (str_cmp_ex(data, "ED448", 0, 1) == 0) {
-			ret = PKI_SCHEME_ED448;
-		// X448 Option
-		} else if (str_cmp_ex(data, "X448", 0, 1) == 0) {
-			ret = PKI_SCHEME_X448;
-		// EC Option
-		} else if (str_cmp_ex(data, "EC", 0, 1) == 0 ||
-				str_cmp_ex(data, "ECDSA", 0, 1) == 0 ||
-				str_cmp_ex(data, "B128", 0, 1) == 0 ||
-				str_cmp_ex(data, "B192", 0, 1) == 0 ||
-				str_cmp_ex(data, "B256", 0, 1) == 0 ||
-				str_cmp_ex(data, "Brainpool", 9, 1) == 0 ||
-				str_cmp_ex(data, "P256", 0, 1) == 0 ||
-				str_cmp_ex(data, "P384", 0, 1) == 0 ||
-				str_cmp_ex(data, "P512", 0, 1) == 0) {
-			ret = PKI_SCHEME_ECDSA;
+	{ "ED25519", PKI_SCHEME_ED25519, 0, 0 },
+	{ "X25519", PKI_SCHEME_X25519, 0, 0 },
+	{ "ED448", PKI_SCHEME_ED448, 0, 0 },
+	{ "X448", PKI_SCHEME_X448, 0, 0 },
+	{ "EC", PKI_SCHEME_ECDSA, 0, 0 },
+	{ "ECDSA", PKI_SCHEME_ECDSA, 0, 0 },
+	{ "B128", PKI_SCHEME_ECDSA, 0, 0 },
+	{ "B192", PKI_SCHEME_ECDSA, 0, 0 },
+	{ "B256", PKI_SCHEME_ECDSA, 0, 0 },
+	{ "P256", PKI_SCHEME_ECDSA, 0, 0 },
+	{ "P384", PKI_SCHEME_ECDSA, 0, 0 },
+	{ "P512", PKI_SCHEME_ECDSA, 0, 0 },
 #endif // End of ENABLE_ECDSA
 
-		// DSA
-		} else if (str_cmp_ex(data, "DSA", 0, 1) == 0) {
-			ret = PKI_SCHEME_DSA;
+	{ "DSA", PKI_SCHEME_DSA, 0, 0 },
+};
+
+#define PKI_SCHEME_ALIAS_NUM \
+	((int)(sizeof(_scheme_aliases) / sizeof(_scheme_aliases[0])))
+
+/* Hash index over the alias table, the seed is chosen at runtime (when
+ * the index is first built) so that every alias gets its own slot
+ * (probing is only a fallback) */
+#define PKI_SCHEME_ALIAS_INDEX_SIZE		2048
+#define PKI_SCHEME_ALIAS_SEED_TRIES		4096
+
+static unsigned char _scheme_alias_index[PKI_SCHEME_ALIAS_INDEX_SIZE];
+static uint32_t _scheme_alias_seed = 0;
+static pthread_once_t _scheme_alias_once = PTHREAD_ONCE_INIT;
+
+/* Case-insensitive FNV-1a */
+static uint32_t _scheme_alias_hash(const char * name, uint32_t seed) {
+
+	uint32_t h = 2166136261u ^ seed;
+
+	while (*name) {
+		h ^= (uint32_t) toupper((unsigned char) *name++);
+		h *= 16777619u;
+	}
+
+	return h & (PKI_SCHEME_ALIAS_INDEX_SIZE - 1);
+}
+
+static int _scheme_alias_index_build(uint32_t seed, int allow_collisions) {
+
+	int i = 0;
+	uint32_t slot = 0;
+
+	memset(_scheme_alias_index, 0, sizeof(_scheme_alias_index));
+
+	for (i = 0; i < PKI_SCHEME_ALIAS_NUM; i++) {
+		slot = _scheme_alias_hash(_scheme_aliases[i].name, seed);
+		while (_scheme_alias_index[slot] != 0) {
+			if (!allow_collisions) return PKI_ERR;
+			slot = (slot + 1) & (PKI_SCHEME_ALIAS_INDEX_SIZE - 1);
 		}
+		// Slots store the (index + 1) of the entry, zero is empty
+		_scheme_alias_index[slot] = (unsigned char)(i + 1);
+	}
+
+	return PKI_OK;
+}
+
+static void _scheme_alias_init(void) {
+
+	uint32_t seed = 0;
+
+	for (seed = 0; seed < PKI_SCHEME_ALIAS_SEED_TRIES; seed++) {
+		if (_scheme_alias_index_build(seed, 0) == PKI_OK) {
+			_scheme_alias_seed = seed;
+			return;
+		}
+	}
+
+	// No collision-free seed, linear probing is still correct
+	_scheme_alias_seed = 0;
+	_scheme_alias_index_build(0, 1);
+}
+
+static const PKI_SCHEME_ALIAS * _scheme_alias_get(const char * name) {
+
+	const PKI_SCHEME_ALIAS * entry = NULL;
+	uint32_t slot = 0;
+
+	pthread_once(&_scheme_alias_once, _scheme_alias_init);
+
+	slot = _scheme_alias_hash(name, _scheme_alias_seed);
+	while (_scheme_alias_index[slot] != 0) {
+		entry = &_scheme_aliases[_scheme_alias_index[slot] - 1];
+		if (str_cmp_ex(name, entry->name, 0, 1) == 0) return entry;
+		slot = (slot + 1) & (PKI_SCHEME_ALIAS_INDEX_SIZE - 1);
+	}
+
+	return NULL;
+}
+
+PKI_SCHEME_ID PKI_SCHEME_ID_get_by_name(const char * data, int *classic_sec_bits, int *quantum_sec_bits) {
+
+	PKI_SCHEME_ID ret = PKI_SCHEME_UNKNOWN;
+		// Return value
+
+	const PKI_SCHEME_ALIAS * alias = NULL;
+		// Alias table entry
+
+	// Input Checks
+	if (!data) {
+		if (classic_sec_bits) *classic_sec_bits = 0;
+		if (quantum_sec_bits) *quantum_sec_bits = 0;
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return PKI_SCHEME_UNKNOWN;
+	}
+
+	if ((alias = _scheme_alias_get(data)) != NULL) {
+		ret = alias->scheme;
+#ifdef ENABLE_ECDSA
+	} else if (strncmp_nocase(data, "Brainpool", 9) == 0) {
+		// Any Brainpool curve name
+		ret = PKI_SCHEME_ECDSA;
+#endif
 	}
 
 	// Checks if we found the scheme
 	if (ret == PKI_SCHEME_UNKNOWN) {
 		// Some debugging
 		PKI_DEBUG("Cannot Convert [%s] into a recognized OID.", data);
+	} else if (alias && alias->classic_sec_bits > 0) {
+		// The name selects a specific parameter set
+		if (classic_sec_bits) *classic_sec_bits = alias->classic_sec_bits;
+		if (quantum_sec_bits) *quantum_sec_bits = alias->quantum_sec_bits;
 	} else {
-		// Checks if we need to retrieve the default security bits
-		if (default_sec_bits) {
-			// Returns the security bits for the scheme
-			if (PKI_ERR == PKI_SCHEME_ID_security_bits(ret, classic_sec_bits, quantum_sec_bits)) {
-				PKI_DEBUG("Cannot get security bits for scheme %d", ret);
-				return PKI_SCHEME_UNKNOWN;
-			}
+		// Returns the default security bits for the scheme
+		if (PKI_ERR == PKI_SCHEME_ID_security_bits(ret, classic_sec_bits, quantum_sec_bits)) {
+			PKI_DEBUG("Cannot get security bits for scheme %d", ret);
+			return PKI_SCHEME_UNKNOWN;
 		}
 	}
 
@@ -1447,16 +1498,102 @@ PKI_SCHEME_ID PKI_SCHEME_ID_get_by_name(const char * data, int *classic_sec_bits
  * \brief Build a PKI_ALGOR structure from its ID
  */
 
+/* Interned AlgorithmIdentifiers, one per algorithm ID. Slots are only added
+ * (under the lock) and never removed, readers do not need to lock */
+#define PKI_ALGOR_INTERN_SIZE		512
+
+typedef struct pki_algor_intern_st {
+	PKI_ALGOR_ID id;
+	PKI_X509_ALGOR_VALUE * value;
+} PKI_ALGOR_INTERN;
+
+static PKI_ALGOR_INTERN _algor_intern[PKI_ALGOR_INTERN_SIZE];
+static pthread_mutex_t _algor_intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static PKI_X509_ALGOR_VALUE * _algor_intern_find(PKI_ALGOR_ID id) {
+
+	PKI_X509_ALGOR_VALUE * value = NULL;
+	unsigned int slot = (unsigned int) id & (PKI_ALGOR_INTERN_SIZE - 1);
+	int i = 0;
+
+	for (i = 0; i < PKI_ALGOR_INTERN_SIZE; i++) {
+		// The value is published after the id
+		value = __atomic_load_n(&_algor_intern[slot].value, __ATOMIC_ACQUIRE);
+		if (!value) return NULL;
+		if (_algor_intern[slot].id == id) return value;
+		slot = (slot + 1) & (PKI_ALGOR_INTERN_SIZE - 1);
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Returns 1 if the value is shared (returned by PKI_X509_ALGOR_VALUE_get)
+ */
+
+int PKI_X509_ALGOR_VALUE_is_interned(const PKI_X509_ALGOR_VALUE * algor) {
+
+	if (!algor || !algor->algorithm) return 0;
+
+	return _algor_intern_find(OBJ_obj2nid(algor->algorithm)) == algor;
+}
+
+/*!
+ * \brief Returns the shared PKI_ALGOR structure for an algorithm ID
+ *
+ * The returned value is immutable and shared across calls, it must not be
+ * freed (PKI_X509_ALGOR_VALUE_free() ignores shared values). NULL is
+ * returned when the table of the shared values is full.
+ */
+
 PKI_X509_ALGOR_VALUE * PKI_X509_ALGOR_VALUE_get(PKI_ALGOR_ID algor) {
 
+	PKI_X509_ALGOR_VALUE * ret = NULL;
+	unsigned int slot = 0;
+	int i = 0;
+
 	// Input Checks
 	if (algor <= 0) {
 		PKI_ERROR(PKI_ERR_PARAM_NULL, "No Algorithm ID provided!");
 		return NULL;
 	}
 
+	// Fast path: already interned
+	if ((ret = _algor_intern_find(algor)) != NULL) return ret;
+
+	// Loads the providers and the PQC/Composite methods
+	PKI_init_crypto_methods();
+
+	pthread_mutex_lock(&_algor_intern_lock);
+
+	// Another thread might have added it
+	if ((ret = _algor_intern_find(algor)) == NULL
+			&& (ret = PKI_X509_ALGOR_VALUE_new_type(algor)) != NULL) {
+
+		slot = (unsigned int) algor & (PKI_ALGOR_INTERN_SIZE - 1);
+		for (i = 0; i < PKI_ALGOR_INTERN_SIZE; i++) {
+			if (_algor_intern[slot].value == NULL) {
+				_algor_intern[slot].id = algor;
+				__atomic_store_n(&_algor_intern[slot].value, ret, __ATOMIC_RELEASE);
+				break;
+			}
+			slot = (slot + 1) & (PKI_ALGOR_INTERN_SIZE - 1);
+		}
+
+		// The table is full, the value could not be shared
+		if (i == PKI_ALGOR_INTERN_SIZE) {
+			X509_ALGOR_free(ret);
+			ret = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&_algor_intern_lock);
+
+	if (i == PKI_ALGOR_INTERN_SIZE)
+		PKI_ERROR(PKI_ERR_ALGOR_GET, "Algorithm table full, %d is not shared", algor);
+
 	// Let's return the PKIX X509 Algorithm Data structure
-	return PKI_X509_ALGOR_VALUE_new_type(algor);
+	return ret;
 }
 
 // /*!
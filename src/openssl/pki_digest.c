@@ -9,6 +9,9 @@ void PKI_DIGEST_free ( PKI_DIGEST *data )
 {
 	if( !data ) return;
 
+	if (data->ctx) EVP_MD_CTX_free(data->ctx);
+	data->ctx = NULL; // Safety
+
 	if (data->digest) PKI_Free(data->digest);
 	data->digest = NULL; // Safety
 	data->algor = NULL; // Safety
@@ -193,6 +196,24 @@ PKI_DIGEST *PKI_DIGEST_URL_new(const PKI_DIGEST_ALG *alg, const URL *url ) {
 	PKI_MEM *data = NULL;
 	PKI_DIGEST *ret = NULL;
 
+	if (!url) return NULL;
+
+	// Files are digested while being read (never loaded in memory)
+	if (url->proto == URI_PROTO_FILE) {
+
+		int fd = -1;
+
+		if ((fd = open(url->addr, O_RDONLY)) == -1) {
+			PKI_ERROR(PKI_ERR_URI_READ, "Cannot open %s (%s)", url->addr, strerror(errno));
+			return NULL;
+		}
+
+		ret = PKI_DIGEST_new_fd(alg, fd);
+		close(fd);
+
+		return ret;
+	}
+
 	if(( stack = URL_get_data_url( url, 0, 0, NULL )) == NULL ) {
 		/* Error, Can not grab the data */
 		return ( NULL );
@@ -229,6 +250,686 @@ PKI_DIGEST *PKI_DIGEST_URL_new_by_name(const char *alg_name, const URL *url) {
 	return PKI_DIGEST_URL_new(alg, url);
 }
 
+/* ----------------------------- Batch Digests ----------------------------- */
+
+/*!
+ * \brief Calculates the digests of 'num' buffers in one call
+ *
+ * The values are written contiguously in 'out', which must hold at least
+ * num * PKI_DIGEST_get_size(alg) bytes ('out_size'). One context is used
+ * for all the buffers and nothing is allocated per buffer, which is what
+ * dominates for many small buffers (e.g., CertID name and key hashes).
+ */
+
+int PKI_DIGEST_batch(const PKI_DIGEST_ALG        * alg,
+                     const unsigned char * const * data,
+                     const size_t                * sizes,
+                     size_t                        num,
+                     unsigned char               * out,
+                     size_t                        out_size) {
+
+	const EVP_MD * md = alg;
+	EVP_MD_CTX * ctx = NULL;
+	size_t md_size = 0, i = 0;
+	int md_len = 0;
+	int ret = PKI_OK;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MD * fetched = NULL;
+#endif
+
+	// Input Checks
+	if (!alg || !data || !sizes || !out) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	// Digests without output (e.g., EVP_md_null()) are not batched
+	if ((md_len = EVP_MD_size(alg)) <= 0)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Unsupported digest size (%d)", md_len);
+
+	md_size = (size_t) md_len;
+	if (num > out_size / md_size)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Output buffer too small (%zu for %zu digests)",
+			out_size, num);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	// Explicitly fetched algorithms skip the lookup done by
+	// every initialization (that costs more than the digest
+	// of a small buffer)
+	if ((fetched = EVP_MD_fetch(NULL, EVP_MD_get0_name(alg), NULL)) != NULL) md = fetched;
+#endif
+
+	if ((ctx = EVP_MD_CTX_new()) == NULL) {
+		ret = PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		goto end;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (EVP_DigestInit_ex(ctx, md, NULL) != 1
+				|| (sizes[i] > 0 && EVP_DigestUpdate(ctx, data[i], sizes[i]) != 1)
+				|| EVP_DigestFinal_ex(ctx, out + i * md_size, NULL) != 1) {
+			ret = PKI_ERROR(PKI_ERR_GENERAL, "Cannot calculate the digest (%zu)", i);
+			break;
+		}
+	}
+
+	EVP_MD_CTX_free(ctx);
+
+end:
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	if (fetched) EVP_MD_free(fetched);
+#endif
+
+	return ret;
+}
+
+/* --------------------------- Streaming Digests --------------------------- */
+
+// Size of the slices used to feed multiple digests in one pass
+#define DIGEST_MULTI_SLICE_SIZE		65536
+
+// Blocks assigned to each thread in a parallel digest batch
+#define DIGEST_PARALLEL_BATCH_BLOCKS	16
+
+// Double buffered reader: the next buffer is read (in a separate
+// thread) while the current one is being digested
+typedef struct digest_fd_reader_st {
+	int fd;
+	size_t size;
+	unsigned char * buf[2];
+	size_t len[2];
+	int full[2];
+	int last[2];
+	int stop;
+	int error;
+	PKI_MUTEX lock;
+	PKI_COND cond;
+} DIGEST_FD_READER;
+
+typedef int (*DIGEST_FD_CB)(void * arg, const unsigned char * data, size_t size);
+
+static void * _digest_fd_reader(void * arg) {
+
+	DIGEST_FD_READER * r = (DIGEST_FD_READER *) arg;
+	ssize_t rv = 0;
+	size_t len = 0;
+	int i = 0, last = 0, err = 0;
+
+	while (!last) {
+
+		PKI_MUTEX_acquire(&r->lock);
+		while (r->full[i] && !r->stop) PKI_COND_wait(&r->cond, &r->lock);
+		if (r->stop) {
+			PKI_MUTEX_release(&r->lock);
+			break;
+		}
+		PKI_MUTEX_release(&r->lock);
+
+		// Fills the whole buffer (short reads are retried)
+		for (len = 0, rv = 0; len < r->size; len += (size_t) rv) {
+			if ((rv = read(r->fd, r->buf[i] + len, r->size - len)) < 0 && errno == EINTR) {
+				rv = 0;
+				continue;
+			}
+			if (rv <= 0) break;
+		}
+		last = (len < r->size);
+		err = (rv < 0 ? errno : 0);
+
+		PKI_MUTEX_acquire(&r->lock);
+		r->error = err;
+		r->len[i] = len;
+		r->last[i] = last;
+		r->full[i] = 1;
+		PKI_COND_broadcast(&r->cond);
+		PKI_MUTEX_release(&r->lock);
+
+		i ^= 1;
+	}
+
+	return NULL;
+}
+
+// Reads the fd until EOF and passes the data (in 'buf_size' chunks,
+// the last one might be shorter) to the callback
+static int _digest_fd_process(int fd, size_t buf_size, DIGEST_FD_CB cb, void * arg) {
+
+	DIGEST_FD_READER r;
+	PKI_THREAD * th = NULL;
+	int i = 0, last = 0, ret = PKI_OK;
+
+	memset(&r, 0, sizeof(r));
+	r.fd = fd;
+	r.size = buf_size;
+
+	if ((r.buf[0] = PKI_Malloc(buf_size)) == NULL ||
+	    (r.buf[1] = PKI_Malloc(buf_size)) == NULL) {
+		if (r.buf[0]) PKI_Free(r.buf[0]);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	PKI_MUTEX_init(&r.lock);
+	PKI_COND_init(&r.cond);
+
+	if ((th = PKI_THREAD_new(_digest_fd_reader, &r)) == NULL) {
+		ret = PKI_ERROR(PKI_ERR_GENERAL, "Cannot start the reader thread");
+		goto end;
+	}
+
+	while (!last) {
+
+		PKI_MUTEX_acquire(&r.lock);
+		while (!r.full[i]) PKI_COND_wait(&r.cond, &r.lock);
+		if (r.error) ret = PKI_ERROR(PKI_ERR_URI_READ, "%s", strerror(r.error));
+		PKI_MUTEX_release(&r.lock);
+
+		if (ret == PKI_OK && cb(arg, r.buf[i], r.len[i]) != PKI_OK) ret = PKI_ERR;
+
+		last = (r.last[i] || ret != PKI_OK);
+
+		// Gives the buffer back to the reader
+		PKI_MUTEX_acquire(&r.lock);
+		r.full[i] = 0;
+		if (ret != PKI_OK) r.stop = 1;
+		PKI_COND_broadcast(&r.cond);
+		PKI_MUTEX_release(&r.lock);
+
+		i ^= 1;
+	}
+
+	PKI_THREAD_join(th, NULL);
+	PKI_Free(th);
+
+end:
+	PKI_COND_destroy(&r.cond);
+	PKI_MUTEX_destroy(&r.lock);
+
+	PKI_Free(r.buf[0]);
+	PKI_Free(r.buf[1]);
+
+	return ret;
+}
+
+typedef struct digest_multi_st {
+	PKI_DIGEST ** dgsts;
+	int num;
+} DIGEST_MULTI;
+
+static int _digest_multi_cb(void * arg, const unsigned char * data, size_t size) {
+
+	DIGEST_MULTI * m = (DIGEST_MULTI *) arg;
+
+	return PKI_DIGEST_update_multi(m->dgsts, m->num, data, size);
+}
+
+/*!
+ * \brief Starts a streaming digest calculation
+ *
+ * Data is added with PKI_DIGEST_update() (or PKI_DIGEST_update_fd()) and
+ * the value is available after PKI_DIGEST_final().
+ */
+
+PKI_DIGEST *PKI_DIGEST_init(const PKI_DIGEST_ALG *alg) {
+
+	PKI_DIGEST * ret = NULL;
+
+	if (!alg) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((ret = PKI_Malloc(sizeof(PKI_DIGEST))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	if ((ret->ctx = EVP_MD_CTX_new()) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		PKI_DIGEST_free(ret);
+		return NULL;
+	}
+
+	if (EVP_DigestInit_ex(ret->ctx, alg, NULL) != 1) {
+		PKI_ERROR(PKI_ERR_DIGEST_TYPE_UNKNOWN, NULL);
+		PKI_DIGEST_free(ret);
+		return NULL;
+	}
+
+	ret->algor = alg;
+
+	return ret;
+}
+
+/*! \brief Adds data to a streaming digest (see PKI_DIGEST_init) */
+
+int PKI_DIGEST_update(PKI_DIGEST          * dgst,
+                      const unsigned char * data,
+                      size_t                size) {
+
+	if (!dgst || !dgst->ctx || (!data && size > 0))
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (size > 0 && EVP_DigestUpdate(dgst->ctx, data, size) != 1)
+		return PKI_ERROR(PKI_ERR_GENERAL, "Cannot update the digest");
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Adds the same data to multiple streaming digests in one pass
+ *
+ * The data is processed in slices that stay in the CPU caches while
+ * they are added to all the digests.
+ */
+
+int PKI_DIGEST_update_multi(PKI_DIGEST          ** dgsts,
+                            int                    num,
+                            const unsigned char  * data,
+                            size_t                 size) {
+
+	size_t offset = 0, len = 0;
+	int i = 0;
+
+	if (!dgsts || num <= 0) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	do {
+		len = size - offset;
+		if (len > DIGEST_MULTI_SLICE_SIZE) len = DIGEST_MULTI_SLICE_SIZE;
+
+		for (i = 0; i < num; i++) {
+			if (PKI_DIGEST_update(dgsts[i], data + offset, len) != PKI_OK)
+				return PKI_ERR;
+		}
+
+		offset += len;
+
+	} while (offset < size);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Adds the data read from a file descriptor (until EOF) to one
+ *        or more streaming digests
+ *
+ * The next chunk of data is read while the current one is digested,
+ * and each chunk is added to all the digests (single pass over data).
+ */
+
+int PKI_DIGEST_update_fd(PKI_DIGEST ** dgsts,
+                         int           num,
+                         int           fd) {
+
+	DIGEST_MULTI m;
+
+	if (!dgsts || num <= 0 || fd < 0)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	m.dgsts = dgsts;
+	m.num = num;
+
+	return _digest_fd_process(fd, PKI_DIGEST_FD_BUFFER_SIZE, _digest_multi_cb, &m);
+}
+
+/*! \brief Finalizes a streaming digest, the value is then available */
+
+int PKI_DIGEST_final(PKI_DIGEST *dgst) {
+
+	unsigned int size = 0;
+
+	if (!dgst || !dgst->ctx) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (!dgst->digest && (dgst->digest = PKI_Malloc(EVP_MAX_MD_SIZE)) == NULL)
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+	if (EVP_DigestFinal_ex(dgst->ctx, dgst->digest, &size) != 1)
+		return PKI_ERROR(PKI_ERR_GENERAL, "Cannot finalize the digest");
+
+	dgst->size = size;
+
+	EVP_MD_CTX_free(dgst->ctx);
+	dgst->ctx = NULL;
+
+	return PKI_OK;
+}
+
+/*! \brief Calculates the digest of the data read from a file descriptor */
+
+PKI_DIGEST *PKI_DIGEST_new_fd(const PKI_DIGEST_ALG * alg,
+                              int                    fd) {
+
+	PKI_DIGEST * ret = NULL;
+
+	if ((ret = PKI_DIGEST_init(alg)) == NULL) return NULL;
+
+	if (PKI_DIGEST_update_fd(&ret, 1, fd) != PKI_OK ||
+	    PKI_DIGEST_final(ret) != PKI_OK) {
+		PKI_DIGEST_free(ret);
+		return NULL;
+	}
+
+	return ret;
+}
+
+/* ---------------------- Parallel Digests (ParallelHash) ------------------ */
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+typedef struct digest_parallel_st {
+	/*! Chunks digest (SHAKE128 or SHAKE256) */
+	const EVP_MD * chunk_md;
+	/*! Size of the chunks digests (and of the output), in bytes */
+	size_t out_size;
+	/*! Chunks size */
+	size_t block;
+	int threads;
+	/*! Outer cSHAKE context */
+	EVP_MD_CTX * ctx;
+	/*! Processed chunks */
+	size_t chunks;
+	/*! Chunks digests of the current batch */
+	unsigned char * batch_out;
+} DIGEST_PARALLEL;
+
+typedef struct digest_parallel_job_st {
+	DIGEST_PARALLEL * p;
+	const unsigned char * data;
+	size_t size;
+	size_t first;
+	size_t num;
+	int ok;
+} DIGEST_PARALLEL_JOB;
+
+static size_t _left_encode(unsigned char * buf, uint64_t x) {
+
+	unsigned char tmp[8];
+	size_t n = 0;
+
+	do {
+		tmp[7 - n++] = (unsigned char) (x & 0xff);
+		x >>= 8;
+	} while (x > 0 && n < 8);
+
+	buf[0] = (unsigned char) n;
+	memcpy(buf + 1, tmp + 8 - n, n);
+
+	return n + 1;
+}
+
+static size_t _right_encode(unsigned char * buf, uint64_t x) {
+
+	size_t n = _left_encode(buf, x) - 1;
+
+	memmove(buf, buf + 1, n);
+	buf[n] = (unsigned char) n;
+
+	return n + 1;
+}
+
+// Digests the 'num' chunks starting at 'first' (relative to 'data')
+static void * _digest_parallel_job(void * arg) {
+
+	DIGEST_PARALLEL_JOB * job = (DIGEST_PARALLEL_JOB *) arg;
+	DIGEST_PARALLEL * p = job->p;
+	EVP_MD_CTX * ctx = NULL;
+	size_t i = 0, off = 0, len = 0;
+
+	job->ok = 0;
+
+	if ((ctx = EVP_MD_CTX_new()) == NULL) return NULL;
+
+	for (i = job->first; i < job->first + job->num; i++) {
+
+		off = i * p->block;
+		len = (job->size - off < p->block ? job->size - off : p->block);
+
+		if (EVP_DigestInit_ex(ctx, p->chunk_md, NULL) != 1
+				|| EVP_DigestUpdate(ctx, job->data + off, len) != 1
+				|| EVP_DigestFinalXOF(ctx, p->batch_out + i * p->out_size, p->out_size) != 1) {
+			EVP_MD_CTX_free(ctx);
+			return NULL;
+		}
+	}
+
+	EVP_MD_CTX_free(ctx);
+	job->ok = 1;
+
+	return NULL;
+}
+
+// Digests the chunks of a batch (at most threads * BATCH_BLOCKS) in
+// parallel and adds their digests (in order) to the outer context
+static int _digest_parallel_batch(DIGEST_PARALLEL * p, const unsigned char * data, size_t size) {
+
+	DIGEST_PARALLEL_JOB jobs[PKI_DIGEST_PARALLEL_MAX_THREADS];
+	PKI_THREAD * th[PKI_DIGEST_PARALLEL_MAX_THREADS];
+	size_t num = 0, per_job = 0, first = 0;
+	int i = 0, n = 0, ok = 1;
+
+	if ((num = (size + p->block - 1) / p->block) == 0) return PKI_OK;
+
+	per_job = (num + (size_t) p->threads - 1) / (size_t) p->threads;
+
+	for (n = 0, first = 0; first < num; n++, first += per_job) {
+		jobs[n].p = p;
+		jobs[n].data = data;
+		jobs[n].size = size;
+		jobs[n].first = first;
+		jobs[n].num = (num - first < per_job ? num - first : per_job);
+		th[n] = NULL;
+	}
+
+	// The calling thread takes the first job
+	for (i = 1; i < n; i++) th[i] = PKI_THREAD_new(_digest_parallel_job, &jobs[i]);
+	_digest_parallel_job(&jobs[0]);
+
+	for (i = 1; i < n; i++) {
+		if (th[i]) {
+			PKI_THREAD_join(th[i], NULL);
+			PKI_Free(th[i]);
+		} else {
+			// Could not start the thread, runs the job here
+			_digest_parallel_job(&jobs[i]);
+		}
+	}
+
+	for (i = 0; i < n; i++) if (!jobs[i].ok) ok = 0;
+
+	if (!ok || EVP_DigestUpdate(p->ctx, p->batch_out, num * p->out_size) != 1)
+		return PKI_ERROR(PKI_ERR_GENERAL, "Cannot calculate the chunks digests");
+
+	p->chunks += num;
+
+	return PKI_OK;
+}
+
+static int _digest_parallel_cb(void * arg, const unsigned char * data, size_t size) {
+
+	DIGEST_PARALLEL * p = (DIGEST_PARALLEL *) arg;
+	size_t batch = p->block * DIGEST_PARALLEL_BATCH_BLOCKS * (size_t) p->threads;
+	size_t offset = 0, len = 0;
+
+	// Only the last call can have a partial chunk (the callers
+	// use multiples of the batch size)
+	for (offset = 0; offset < size; offset += len) {
+		len = (size - offset < batch ? size - offset : batch);
+		if (_digest_parallel_batch(p, data + offset, len) != PKI_OK) return PKI_ERR;
+	}
+
+	return PKI_OK;
+}
+
+static void _digest_parallel_free(DIGEST_PARALLEL * p) {
+
+	if (p->ctx) EVP_MD_CTX_free(p->ctx);
+	if (p->batch_out) PKI_Free(p->batch_out);
+}
+
+static int _digest_parallel_init(DIGEST_PARALLEL * p, int bits, size_t block, int threads) {
+
+	static const char name[] = "ParallelHash";
+	unsigned char buf[200];
+	EVP_MD * md = NULL;
+	size_t rate = 0, len = 0;
+
+	memset(p, 0, sizeof(DIGEST_PARALLEL));
+
+	if (bits != 128 && bits != 256)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Unsupported security bits (%d)", bits);
+
+	if (block == 0) block = PKI_DIGEST_PARALLEL_BLOCK_SIZE;
+
+	if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	if (threads > PKI_DIGEST_PARALLEL_MAX_THREADS) threads = PKI_DIGEST_PARALLEL_MAX_THREADS;
+
+	p->chunk_md = (bits == 128 ? EVP_shake128() : EVP_shake256());
+	p->out_size = (size_t) bits / 4;
+	p->block = block;
+	p->threads = threads;
+	rate = (bits == 128 ? 168 : 136);
+
+	if ((p->batch_out = PKI_Malloc(p->out_size * DIGEST_PARALLEL_BATCH_BLOCKS * (size_t) threads)) == NULL ||
+	    (p->ctx = EVP_MD_CTX_new()) == NULL) {
+		_digest_parallel_free(p);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	// cSHAKE is Keccak with the KMAC padding, prefixed by
+	// bytepad(encode_string(N) || encode_string(S), rate)
+	if ((md = EVP_MD_fetch(NULL, bits == 128 ? "KECCAK-KMAC-128" : "KECCAK-KMAC-256", NULL)) == NULL
+			|| EVP_DigestInit_ex(p->ctx, md, NULL) != 1) {
+		if (md) EVP_MD_free(md);
+		_digest_parallel_free(p);
+		return PKI_ERROR(PKI_ERR_DIGEST_TYPE_UNKNOWN, "cSHAKE not available");
+	}
+	EVP_MD_free(md);
+
+	len = _left_encode(buf, rate);
+	len += _left_encode(buf + len, (sizeof(name) - 1) * 8);
+	memcpy(buf + len, name, sizeof(name) - 1);
+	len += sizeof(name) - 1;
+	len += _left_encode(buf + len, 0);
+	memset(buf + len, 0, rate - len);
+	len = rate;
+
+	// The chunk size is part of the input
+	len += _left_encode(buf + len, block);
+
+	if (EVP_DigestUpdate(p->ctx, buf, len) != 1) {
+		_digest_parallel_free(p);
+		return PKI_ERROR(PKI_ERR_GENERAL, NULL);
+	}
+
+	return PKI_OK;
+}
+
+static PKI_DIGEST * _digest_parallel_final(DIGEST_PARALLEL * p) {
+
+	unsigned char buf[20];
+	PKI_DIGEST * ret = NULL;
+	size_t len = 0;
+
+	len = _right_encode(buf, p->chunks);
+	len += _right_encode(buf + len, p->out_size * 8);
+
+	if ((ret = PKI_Malloc(sizeof(PKI_DIGEST))) == NULL ||
+	    (ret->digest = PKI_Malloc(p->out_size)) == NULL) {
+		if (ret) PKI_DIGEST_free(ret);
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	if (EVP_DigestUpdate(p->ctx, buf, len) != 1 ||
+	    EVP_DigestFinalXOF(p->ctx, ret->digest, p->out_size) != 1) {
+		PKI_ERROR(PKI_ERR_GENERAL, "Cannot finalize the digest");
+		PKI_DIGEST_free(ret);
+		return NULL;
+	}
+
+	ret->size = p->out_size;
+
+	return ret;
+}
+
+#endif
+
+/*!
+ * \brief Calculates a ParallelHash (NIST SP 800-185) over the data
+ *
+ * The data is split in 'block' sized chunks (PKI_DIGEST_PARALLEL_BLOCK_SIZE
+ * if 0) that are digested with SHAKE128 or SHAKE256 ('bits' is 128 or 256)
+ * by up to 'threads' threads (the number of CPUs if <= 0). The output is
+ * 32 (ParallelHash128) or 64 (ParallelHash256) bytes, with an empty
+ * customization string. The chunk size is part of the digest input.
+ */
+
+PKI_DIGEST *PKI_DIGEST_PARALLEL_new(int                   bits,
+                                    size_t                block,
+                                    int                   threads,
+                                    const unsigned char * data,
+                                    size_t                size) {
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+	DIGEST_PARALLEL p;
+	PKI_DIGEST * ret = NULL;
+
+	if (!data && size > 0) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (_digest_parallel_init(&p, bits, block, threads) != PKI_OK) return NULL;
+
+	if (_digest_parallel_cb(&p, data, size) == PKI_OK)
+		ret = _digest_parallel_final(&p);
+
+	_digest_parallel_free(&p);
+
+	return ret;
+
+#else
+	PKI_ERROR(PKI_ERR_NOT_IMPLEMENTED, "ParallelHash requires OpenSSL 3.0+");
+	return NULL;
+#endif
+}
+
+/*!
+ * \brief Calculates a ParallelHash (see PKI_DIGEST_PARALLEL_new) over the
+ *        data read from a file descriptor
+ */
+
+PKI_DIGEST *PKI_DIGEST_PARALLEL_new_fd(int    bits,
+                                       size_t block,
+                                       int    threads,
+                                       int    fd) {
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+	DIGEST_PARALLEL p;
+	PKI_DIGEST * ret = NULL;
+
+	if (fd < 0) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (_digest_parallel_init(&p, bits, block, threads) != PKI_OK) return NULL;
+
+	// Read buffers hold whole batches (chunks are never split)
+	if (_digest_fd_process(fd, p.block * DIGEST_PARALLEL_BATCH_BLOCKS * (size_t) p.threads,
+			_digest_parallel_cb, &p) == PKI_OK)
+		ret = _digest_parallel_final(&p);
+
+	_digest_parallel_free(&p);
+
+	return ret;
+
+#else
+	PKI_ERROR(PKI_ERR_NOT_IMPLEMENTED, "ParallelHash requires OpenSSL 3.0+");
+	return NULL;
+#endif
+}
+
 /*! \brief Returns the size of the output of the selected digest algorithm */
 
 ssize_t PKI_DIGEST_get_size(const PKI_DIGEST_ALG *alg)
@@ -220,6 +220,53 @@ int PKI_HMAC_finalize(PKI_HMAC *hmac)
 	return PKI_OK;
 }
 
+/*
+ * \brief Calculates the HMACs of 'num' buffers with the key and algorithm
+ *        of an initialized PKI_HMAC
+ *
+ * The values are written contiguously in 'out', which must hold at least
+ * num * (digest size) bytes ('out_size'). The context (and the keyed
+ * inner and outer states in it) is reused for every buffer, nothing is
+ * allocated per buffer. The PKI_HMAC value is not modified.
+ */
+int PKI_HMAC_batch(PKI_HMAC                    * hmac,
+                   const unsigned char * const * data,
+                   const size_t                * sizes,
+                   size_t                        num,
+                   unsigned char               * out,
+                   size_t                        out_size)
+{
+	unsigned int size = 0;
+	size_t md_size = 0;
+	size_t i = 0;
+
+	if (!hmac || !hmac->initialized)
+		return PKI_ERROR(PKI_ERR_GENERAL, "PKI_HMAC is not initialized");
+
+	if (!data || !sizes || !out) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	md_size = (size_t) EVP_MD_size(hmac->digestAlg);
+	if (num > out_size / md_size)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Output buffer too small (%zu for %zu HMACs)",
+			out_size, num);
+
+	for (i = 0; i < num; i++)
+	{
+		// Resets to the keyed state (the key is not processed again)
+		if (!HMAC_Init_ex(hmac->ctx, NULL, 0, NULL, NULL)
+				|| (sizes[i] > 0 && !HMAC_Update(hmac->ctx, data[i], sizes[i]))
+				|| !HMAC_Final(hmac->ctx, out + i * md_size, &size))
+		{
+			return PKI_ERROR(PKI_ERR_GENERAL, "Error while calculating the HMAC (%zu)", i);
+		}
+	}
+
+	// Leaves the context ready for PKI_HMAC_update()
+	HMAC_Init_ex(hmac->ctx, NULL, 0, NULL, NULL);
+
+	return PKI_OK;
+}
+
 /*
  * \brief Returns a PKI_MEM with the hmac raw value
  */
@@ -259,7 +306,7 @@ PKI_MEM *PKI_HMAC_get_value_b64(PKI_HMAC *hmac)
 
 PKI_MEM * PKI_HMAC_new_data(PKI_MEM *data, PKI_MEM *key, PKI_DIGEST_ALG *digest)
 {	
-	unsigned char *hmac_value = NULL;
+	unsigned char hmac_value[EVP_MAX_MD_SIZE];
 	unsigned int hmac_size = 0;
 
 	int key_size = 0;
@@ -278,16 +325,13 @@ PKI_MEM * PKI_HMAC_new_data(PKI_MEM *data, PKI_MEM *key, PKI_DIGEST_ALG *digest)
 	key_size = (int) key->size;
 	data_size = (size_t) data->size;
 
-	// Retrieve the data from the OpenSSL library
-	hmac_value = HMAC(digest ? digest : PKI_DIGEST_ALG_SHA1, 
+	// Retrieve the data from the OpenSSL library (without an output
+	// buffer, a static one would be used - not thread safe)
+	if (!HMAC(digest ? digest : PKI_DIGEST_ALG_SHA1, 
 		(unsigned char *) key->data, key_size, 
 		(unsigned char *) data->data, data_size, 
-		NULL, &hmac_size);
-
-	// If no data is returned or size is wrong, let's return null
-	if (!hmac_value || hmac_size <= 0)
+		hmac_value, &hmac_size) || hmac_size <= 0)
 	{
-		if (hmac_value) PKI_Free(hmac_value);
 		return NULL;
 	}
 
@@ -48,7 +48,7 @@ PKI_KEYPARAMS *PKI_KEYPARAMS_new(PKI_SCHEME_ID 			  scheme_id,
 
 	// Allocates the memory for the stack of keys (composite keys)
 	if ((kp->comp.k_stack = PKI_STACK_X509_KEYPAIR_new()) == NULL) {
-		OPENSSL_free(kp);
+		PKI_Free(kp);
 		return NULL;
 	}
 
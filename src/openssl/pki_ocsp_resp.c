@@ -174,7 +174,7 @@ int PKI_X509_OCSP_RESP_add (PKI_X509_OCSP_RESP *resp,
 							PKI_X509_EXTENSION *invalidityDate ) {
 
 	OCSP_SINGLERESP *single = NULL;
-	PKI_TIME *myThisUpdate = NULL;
+	const PKI_TIME *myThisUpdate = NULL;
 
 	PKI_X509_OCSP_RESP_VALUE *r = NULL;
 
@@ -194,12 +194,9 @@ int PKI_X509_OCSP_RESP_add (PKI_X509_OCSP_RESP *resp,
 		}
 	}
 
-	// If no thisUpdate is passed, let's use the current time
-	if (thisUpdate == NULL) {
-		myThisUpdate = X509_gmtime_adj(NULL,0);
-	} else {
-		myThisUpdate = PKI_TIME_dup(thisUpdate);
-	}
+	// If no thisUpdate is passed, let's use the current time (the
+	// times are copied in the single response)
+	if ((myThisUpdate = thisUpdate) == NULL) myThisUpdate = PKI_TIME_now();
 
 	single = OCSP_basic_add1_status(r->bs, 
 									cid,
@@ -208,9 +205,6 @@ int PKI_X509_OCSP_RESP_add (PKI_X509_OCSP_RESP *resp,
 									(ASN1_TIME *) revokeTime, 
 									(ASN1_TIME *) myThisUpdate,
 									(ASN1_TIME *) nextUpdate);
-
-	// Free allocated memory
-	if (myThisUpdate) PKI_TIME_free(myThisUpdate);
 	
 	// Checks the result
 	if (single == NULL)	{
@@ -14,6 +14,18 @@ PKI_TIME *PKI_TIME_new( long long offset ) {
 		return ( NULL );
 	}
 
+	/* The current time is copied from the coarse clock */
+	if ( offset == 0 ) {
+		const PKI_TIME *now = PKI_TIME_now();
+
+		if (!ASN1_STRING_set(time, now->data, now->length)) {
+			ASN1_GENERALIZEDTIME_free(time);
+			return ( NULL );
+		}
+
+		return ( time );
+	}
+
 	/* Set the time offset - if offset is 0 then it gets the current
 	   time */
 #if ( LIBPKI_OS_BITS == LIBPKI_OS32 )
@@ -157,3 +169,133 @@ PKI_TIME * PKI_TIME_set(PKI_TIME *time, time_t new_time) {
 	return ASN1_GENERALIZEDTIME_adj(time, new_time, 0, 0);
 }
 
+
+// ============
+// Coarse Clock
+// ============
+
+/*
+ * NOTE: every thread keeps its own copy of the current second (no locks),
+ *       the strings are formatted only when the second changes. The
+ *       cached PKI_TIME points to the thread's buffer: it is read-only and
+ *       must be copied (e.g., as done by the OCSP and CRL setters) to
+ *       outlive the current second.
+ */
+
+typedef struct pki_time_cache_st {
+	time_t sec;
+	char log_s[PKI_TIME_LOG_SIZE];
+	unsigned char der[PKI_TIME_DER_SIZE + 1];
+	ASN1_GENERALIZEDTIME now;
+} PKI_TIME_CACHE;
+
+static __thread PKI_TIME_CACHE _pki_time_cache = { -1, { 0 }, { 0 }, { 0 } };
+
+/* Writes the last num decimal digits of val (zero padded) */
+static unsigned char * _pki_time_digits(unsigned char *p, int val, int num) {
+
+	int i = 0;
+
+	for (i = num - 1; i >= 0; i--, val /= 10) p[i] = (unsigned char) ('0' + val % 10);
+
+	return p + num;
+}
+
+static PKI_TIME_CACHE * _pki_time_cache_get(long *nsec) {
+
+	PKI_TIME_CACHE *c = &_pki_time_cache;
+	struct timespec ts;
+	struct tm tm;
+	unsigned char *p = NULL;
+
+#ifdef CLOCK_REALTIME_COARSE
+	if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) != 0)
+#endif
+	if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
+		ts.tv_sec = time(NULL);
+		ts.tv_nsec = 0;
+	}
+
+	if (nsec) *nsec = ts.tv_nsec;
+
+	if (ts.tv_sec == c->sec) return c;
+
+	// New second, formats the log and the GeneralizedTime strings
+	localtime_r(&ts.tv_sec, &tm);
+	strftime(c->log_s, sizeof(c->log_s), "%Y-%m-%d %H:%M:%S", &tm);
+
+	// YYYYMMDDHHMMSSZ, the digits are written directly (fixed width)
+	gmtime_r(&ts.tv_sec, &tm);
+	p = c->der;
+	*p++ = V_ASN1_GENERALIZEDTIME;
+	*p++ = PKI_TIME_DER_SIZE - 2;
+	p = _pki_time_digits(p, (tm.tm_year + 1900) % 10000, 4);
+	p = _pki_time_digits(p, tm.tm_mon + 1, 2);
+	p = _pki_time_digits(p, tm.tm_mday, 2);
+	p = _pki_time_digits(p, tm.tm_hour, 2);
+	p = _pki_time_digits(p, tm.tm_min, 2);
+	p = _pki_time_digits(p, tm.tm_sec, 2);
+	*p++ = 'Z';
+	*p = '\0';
+
+	c->now.type = V_ASN1_GENERALIZEDTIME;
+	c->now.length = PKI_TIME_DER_SIZE - 2;
+	c->now.data = c->der + 2;
+	c->now.flags = 0;
+
+	c->sec = ts.tv_sec;
+
+	return c;
+}
+
+/*!
+ * \brief Returns the current time (secs) from the coarse clock
+ *
+ * The coarse clock (CLOCK_REALTIME_COARSE, where available) is read
+ * without a system call, its resolution is the one of the scheduler tick.
+ * The nanoseconds are returned in nsec, if not NULL.
+ */
+
+time_t PKI_TIME_now_coarse( long *nsec ) {
+
+	return _pki_time_cache_get(nsec)->sec;
+}
+
+/*!
+ * \brief Returns the current time as a read-only GeneralizedTime
+ *
+ * The returned object is owned by the calling thread and it is updated by
+ * the next calls in the following seconds. Use PKI_TIME_dup() to keep it.
+ */
+
+const PKI_TIME * PKI_TIME_now( void ) {
+
+	return &_pki_time_cache_get(NULL)->now;
+}
+
+/*! \brief Returns the DER of the current time (GeneralizedTime) */
+
+const unsigned char * PKI_TIME_now_der( size_t *size ) {
+
+	if (size) *size = PKI_TIME_DER_SIZE;
+
+	return _pki_time_cache_get(NULL)->der;
+}
+
+/*!
+ * \brief Writes the current local time ("YYYY-MM-DD HH:MM:SS.mmm") in the
+ *        buffer (at least PKI_TIME_LOG_SIZE + 4 bytes), returns the buffer
+ */
+
+char * PKI_TIME_now_log_s( char *buf, size_t size ) {
+
+	PKI_TIME_CACHE *c = NULL;
+	long nsec = 0;
+
+	if (!buf || size == 0) return NULL;
+
+	c = _pki_time_cache_get(&nsec);
+	snprintf(buf, size, "%s.%03ld", c->log_s, nsec / 1000000);
+
+	return buf;
+}
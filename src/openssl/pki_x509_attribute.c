@@ -76,7 +76,7 @@ const PKI_X509_ATTRIBUTE *PKI_STACK_X509_ATTRIBUTE_get(
 	PKI_X509_ATTRIBUTE *ret = NULL;
 	int pos = 0;
 
-	pos = X509at_get_attr_by_NID ( a_sk, attribute_id, 0);
+	pos = X509at_get_attr_by_NID ( a_sk, attribute_id, -1);
 	if( pos >= 0 ) {
 		ret = X509at_get_attr( a_sk, pos );
 	}
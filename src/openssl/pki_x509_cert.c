@@ -718,6 +718,9 @@ int PKI_X509_CERT_add_extension(PKI_X509_CERT            * x,
     return PKI_ERR;
   }
 
+  // Drops the cached encoding and digests
+  PKI_X509_CACHE_clear(x);
+
   // Retrieves the crypto layer pointer
   val = x->value;
 
@@ -743,6 +746,9 @@ int PKI_X509_CERT_add_extension_stack(PKI_X509_CERT                  * x,
     return PKI_ERR;
   }
 
+  // Drops the cached encoding and digests
+  PKI_X509_CACHE_clear(x);
+
   // Cycle through the entire stack
   for(int i = 0; i < PKI_STACK_X509_EXTENSION_elements(sk_ext); i++) {
     
@@ -985,6 +991,9 @@ int PKI_X509_CERT_set_data(PKI_X509_CERT *x, int type, void *data) {
     return (PKI_ERR);
   }
 
+  // Drops the cached encoding and digests
+  PKI_X509_CACHE_clear(x);
+
   // xVal = PKI_X509_get_value( x );
   xVal = x->value;
 
@@ -1028,6 +1037,10 @@ int PKI_X509_CERT_set_data(PKI_X509_CERT *x, int type, void *data) {
     case PKI_X509_DATA_ALGORITHM:
     case PKI_X509_DATA_SIGNATURE_ALG1:
       alg = data;
+      // Shared values can not be transferred, use a copy
+      if (PKI_X509_ALGOR_VALUE_is_interned(data))
+        data = alg = (LIBPKI_X509_ALGOR *) X509_ALGOR_dup((X509_ALGOR *)data);
+      if (!alg) break;
 #if OPENSSL_VERSION_NUMBER < 0x1010000fL
       if (xVal->cert_info != NULL)
         xVal->cert_info->signature = alg;
@@ -1052,6 +1065,10 @@ int PKI_X509_CERT_set_data(PKI_X509_CERT *x, int type, void *data) {
     case PKI_X509_DATA_SIGNATURE_ALG2:
       // if (xVal->sig_alg != NULL ) X509_ALGOR_free(xVal->sig_alg);
       alg = data;
+      // Shared values can not be transferred, use a copy
+      if (PKI_X509_ALGOR_VALUE_is_interned(data))
+        data = alg = (LIBPKI_X509_ALGOR *) X509_ALGOR_dup((X509_ALGOR *)data);
+      if (!alg) break;
 #if OPENSSL_VERSION_NUMBER < 0x1010000fL
       xVal->sig_alg = alg;
 #else
@@ -1280,6 +1297,10 @@ PKI_DIGEST *PKI_X509_CERT_fingerprint(const PKI_X509_CERT *x,
     alg = PKI_DIGEST_ALG_DEFAULT;
   }
 
+  /* Returns the memoized value, if any */
+  if ((ret = PKI_X509_CACHE_get_digest(x, PKI_X509_CACHE_DIGEST_FINGERPRINT, alg)) != NULL)
+    return ret;
+
   /* Calculate the Digest */
   if (!X509_digest(cert,alg,buf,&ret_size)) {
     /* ERROR */
@@ -1308,6 +1329,9 @@ PKI_DIGEST *PKI_X509_CERT_fingerprint(const PKI_X509_CERT *x,
   /* Sets the algorithm used */
   ret->algor = alg;
 
+  /* Memoizes the value for the next call */
+  PKI_X509_CACHE_set_digest(x, PKI_X509_CACHE_DIGEST_FINGERPRINT, ret);
+
   return ( ret );
 
 }
@@ -1338,12 +1362,17 @@ PKI_DIGEST *PKI_X509_CERT_key_hash(const PKI_X509_CERT *x,
 
   if ( !alg ) alg = PKI_DIGEST_ALG_DEFAULT;
 
+  if ((keyHash = PKI_X509_CACHE_get_digest(x, PKI_X509_CACHE_DIGEST_KEY_HASH, alg)) != NULL)
+    return keyHash;
+
   if ((key = PKI_X509_CERT_get_data(x, PKI_X509_DATA_KEYPAIR_VALUE)) == NULL)
     return NULL;
 
   if ((keyHash = PKI_X509_KEYPAIR_VALUE_pub_digest(key, alg)) == NULL)
     return NULL;
 
+  PKI_X509_CACHE_set_digest(x, PKI_X509_CACHE_DIGEST_KEY_HASH, keyHash);
+
   return keyHash;
 }
 
@@ -1,6 +1,7 @@
 /* openssl/pki_x509_cms.c */
 
 #include <openssl/opensslv.h>
+#include <openssl/pem.h>
 #include "internal/ossl_1_1_1/cms_lcl.h"
 #include <openssl/x509.h>
 
@@ -619,6 +620,333 @@ err:
 
 }
 
+/* ----------------------- Streaming (PKI_IO) Functions --------------------- */
+
+// Buffer size for the file descriptors based I/O
+#define CMS_STREAM_FD_BUFFER_SIZE	65536
+
+// Returns a buffered PKI_IO for the file descriptor (not closed on free)
+static PKI_IO * _cms_fd_io(int fd) {
+
+	PKI_IO * fd_io = NULL;
+	PKI_IO * buf_io = NULL;
+
+	if (fd < 0) return NULL;
+
+	if ((fd_io = BIO_new_fd(fd, BIO_NOCLOSE)) == NULL ||
+	    (buf_io = BIO_new(BIO_f_buffer())) == NULL) {
+		if (fd_io) BIO_free(fd_io);
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	BIO_set_buffer_size(buf_io, CMS_STREAM_FD_BUFFER_SIZE);
+
+	return BIO_push(buf_io, fd_io);
+}
+
+/*!
+ * \brief Processes the content from a PKI_IO source in constant memory
+ *
+ * For attached CMS (SignedData, EnvelopedData, etc.) the whole encoded
+ * CMS (PKI_DATA_FORMAT_ASN1 or PKI_DATA_FORMAT_PEM) is written to 'out'
+ * while the content is read, encoded with indefinite length. The value
+ * in the PKI_X509_CMS is finalized but it does not retain the content.
+ *
+ * For detached SignedData the content is only digested, the CMS is then
+ * written to 'out' (if not NULL).
+ */
+
+int PKI_X509_CMS_data_set_io(PKI_X509_CMS    * cms,
+                             PKI_IO          * in,
+                             PKI_IO          * out,
+                             PKI_DATA_FORMAT   format) {
+
+	PKI_X509_CMS_VALUE * value = NULL;
+	PKI_X509_CMS_TYPE type = PKI_X509_CMS_TYPE_UNKNOWN;
+	unsigned int flags = 0;
+	int ok = 0;
+
+	// Input Checks
+	if (!cms || !(value = cms->value) || !in)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (format != PKI_DATA_FORMAT_ASN1 && format != PKI_DATA_FORMAT_PEM)
+		return PKI_ERROR(PKI_ERR_DATA_FORMAT_UNKNOWN, NULL);
+
+	type = PKI_X509_CMS_get_type(cms);
+	flags = (unsigned int) cms->status | CMS_BINARY;
+
+	if (CMS_is_detached(value)) {
+
+		// The detached ciphertext would have no place to go
+		if (type != PKI_X509_CMS_TYPE_SIGNED && type != PKI_X509_CMS_TYPE_DIGEST)
+			return PKI_ERROR(PKI_ERR_X509_CMS_WRONG_TYPE,
+				"Detached content is only supported for signed or digested data");
+
+		// Content is read in chunks and digested (not copied)
+		if (!CMS_final(value, in, NULL, flags)) {
+			PKI_DEBUG("Cannot finalize CMS [%d::%s]",
+				HSM_get_errno(NULL), HSM_get_errdesc(HSM_get_errno(NULL), NULL));
+			return PKI_ERROR(PKI_ERR_X509_CMS_DATA_FINALIZE, NULL);
+		}
+
+		// Only the (small) CMS structure is written
+		if (!out) return PKI_OK;
+
+		if (format == PKI_DATA_FORMAT_PEM) ok = PEM_write_bio_CMS(out, value);
+		else ok = i2d_CMS_bio(out, value);
+
+	} else {
+
+		if (!out) return PKI_ERROR(PKI_ERR_PARAM_NULL, "Missing output for attached CMS");
+
+		// The content octets are streamed between the header and
+		// the trailer (signatures, etc.), finalized at the end
+		flags |= CMS_STREAM;
+		if (format == PKI_DATA_FORMAT_PEM) ok = PEM_write_bio_CMS_stream(out, value, in, (int) flags);
+		else ok = i2d_CMS_bio_stream(out, value, in, (int) flags);
+	}
+
+	if (!ok || BIO_flush(out) <= 0) {
+		PKI_DEBUG("Cannot write CMS [%d::%s]",
+			HSM_get_errno(NULL), HSM_get_errdesc(HSM_get_errno(NULL), NULL));
+		return PKI_ERROR(PKI_ERR_X509_CMS_DATA_WRITE, NULL);
+	}
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Processes the content from the 'in_fd' file descriptor and
+ *        writes the CMS to the 'out_fd' one (see PKI_X509_CMS_data_set_io)
+ */
+
+int PKI_X509_CMS_data_set_fd(PKI_X509_CMS    * cms,
+                             int               in_fd,
+                             int               out_fd,
+                             PKI_DATA_FORMAT   format) {
+
+	PKI_IO * in = NULL;
+	PKI_IO * out = NULL;
+	int ret = PKI_ERR;
+
+	if ((in = _cms_fd_io(in_fd)) == NULL)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Bad input descriptor (%d)", in_fd);
+
+	if (out_fd >= 0 && (out = _cms_fd_io(out_fd)) == NULL) {
+		PKI_IO_free(in);
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Bad output descriptor (%d)", out_fd);
+	}
+
+	ret = PKI_X509_CMS_data_set_io(cms, in, out, format);
+
+	PKI_IO_free(in);
+	if (out) PKI_IO_free(out);
+
+	return ret;
+}
+
+/*!
+ * \brief Reads a PKI_X509_CMS from a PKI_IO (PKI_DATA_FORMAT_ASN1 or
+ *        PKI_DATA_FORMAT_PEM)
+ *
+ * Attached content is part of the returned structure, detached content
+ * is never loaded (see PKI_X509_CMS_verify_io).
+ */
+
+PKI_X509_CMS * PKI_X509_CMS_get_io(PKI_IO          * io,
+                                   PKI_DATA_FORMAT   format) {
+
+	PKI_X509_CMS_VALUE * value = NULL;
+	PKI_X509_CMS * ret = NULL;
+
+	if (!io) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	switch (format) {
+
+		case PKI_DATA_FORMAT_PEM: {
+			value = PEM_read_bio_CMS(io, NULL, NULL, NULL);
+		} break;
+
+		case PKI_DATA_FORMAT_ASN1: {
+			value = d2i_CMS_bio(io, NULL);
+		} break;
+
+		default: {
+			PKI_ERROR(PKI_ERR_DATA_FORMAT_UNKNOWN, NULL);
+			return NULL;
+		}
+	}
+
+	if (!value) {
+		PKI_ERROR(PKI_ERR_X509_CMS_DATA_READ, NULL);
+		return NULL;
+	}
+
+	if ((ret = PKI_X509_CMS_new_value(value)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		CMS_ContentInfo_free(value);
+		return NULL;
+	}
+
+	return ret;
+}
+
+/*!
+ * \brief Verifies the signatures of a SignedData CMS
+ *
+ * The content (from the 'content' PKI_IO for detached CMS, the embedded
+ * one otherwise) is processed in chunks and copied to 'out' (if not NULL).
+ * Signer certificates are validated against the 'trusted' ones (if not
+ * NULL), otherwise only the signatures are checked.
+ */
+
+int PKI_X509_CMS_verify_io(const PKI_X509_CMS        * const cms,
+                           const PKI_X509_CERT_STACK * const trusted,
+                           PKI_IO                    * content,
+                           PKI_IO                    * out) {
+
+	X509_STORE * store = NULL;
+	unsigned int flags = CMS_BINARY;
+	int i = 0;
+	int ok = 0;
+
+	// Input Checks
+	if (!cms || !cms->value) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (PKI_X509_CMS_get_type(cms) != PKI_X509_CMS_TYPE_SIGNED)
+		return PKI_ERROR(PKI_ERR_X509_CMS_WRONG_TYPE, NULL);
+
+	if (CMS_is_detached(cms->value) && !content)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, "Missing detached content");
+
+	if (trusted) {
+
+		if ((store = X509_STORE_new()) == NULL)
+			return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+		for (i = 0; i < PKI_STACK_X509_CERT_elements(trusted); i++) {
+			PKI_X509_CERT * x = PKI_STACK_X509_CERT_get_num(trusted, i);
+			if (x && x->value) X509_STORE_add_cert(store, x->value);
+		}
+
+	} else {
+
+		flags |= CMS_NO_SIGNER_CERT_VERIFY;
+	}
+
+	ok = CMS_verify(cms->value, NULL, store, content, out, flags);
+
+	if (store) X509_STORE_free(store);
+
+	if (!ok) {
+		PKI_DEBUG("CMS Verify Failed [%d::%s]",
+			HSM_get_errno(NULL), HSM_get_errdesc(HSM_get_errno(NULL), NULL));
+		return PKI_ERROR(PKI_ERR_X509_CMS_VERIFY, NULL);
+	}
+
+	if (out) (void) BIO_flush(out);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Verifies a SignedData CMS with the (detached) content read from
+ *        the 'content_fd' file descriptor (see PKI_X509_CMS_verify_io)
+ */
+
+int PKI_X509_CMS_verify_fd(const PKI_X509_CMS        * const cms,
+                           const PKI_X509_CERT_STACK * const trusted,
+                           int                         content_fd,
+                           int                         out_fd) {
+
+	PKI_IO * content = NULL;
+	PKI_IO * out = NULL;
+	int ret = PKI_ERR;
+
+	if (content_fd >= 0 && (content = _cms_fd_io(content_fd)) == NULL)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Bad content descriptor (%d)", content_fd);
+
+	if (out_fd >= 0 && (out = _cms_fd_io(out_fd)) == NULL) {
+		if (content) PKI_IO_free(content);
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Bad output descriptor (%d)", out_fd);
+	}
+
+	ret = PKI_X509_CMS_verify_io(cms, trusted, content, out);
+
+	if (content) PKI_IO_free(content);
+	if (out) PKI_IO_free(out);
+
+	return ret;
+}
+
+/*!
+ * \brief Decrypts an EnvelopedData CMS, the plaintext is written to 'out'
+ *        in chunks (it is never buffered in full)
+ *
+ * The 'x' certificate (optional) selects the recipient info to use.
+ */
+
+int PKI_X509_CMS_decrypt_io(const PKI_X509_CMS     * const cms,
+                            const PKI_X509_KEYPAIR * const k,
+                            const PKI_X509_CERT    * const x,
+                            PKI_IO                 * content,
+                            PKI_IO                 * out) {
+
+	// Input Checks
+	if (!cms || !cms->value || !k || !k->value || !out)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (PKI_X509_CMS_get_type(cms) != PKI_X509_CMS_TYPE_ENVELOPED)
+		return PKI_ERROR(PKI_ERR_X509_CMS_WRONG_TYPE, NULL);
+
+	if (!CMS_decrypt(cms->value, k->value, x ? x->value : NULL,
+	                 content, out, CMS_BINARY)) {
+		PKI_DEBUG("CMS Decrypt Failed [%d::%s]",
+			HSM_get_errno(NULL), HSM_get_errdesc(HSM_get_errno(NULL), NULL));
+		return PKI_ERROR(PKI_ERR_X509_CMS_DECRYPT, NULL);
+	}
+
+	if (BIO_flush(out) <= 0) return PKI_ERROR(PKI_ERR_X509_CMS_DATA_WRITE, NULL);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Decrypts an EnvelopedData CMS to the 'out_fd' file descriptor
+ *        (see PKI_X509_CMS_decrypt_io)
+ */
+
+int PKI_X509_CMS_decrypt_fd(const PKI_X509_CMS     * const cms,
+                            const PKI_X509_KEYPAIR * const k,
+                            const PKI_X509_CERT    * const x,
+                            int                      content_fd,
+                            int                      out_fd) {
+
+	PKI_IO * content = NULL;
+	PKI_IO * out = NULL;
+	int ret = PKI_ERR;
+
+	if (content_fd >= 0 && (content = _cms_fd_io(content_fd)) == NULL)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Bad content descriptor (%d)", content_fd);
+
+	if ((out = _cms_fd_io(out_fd)) == NULL) {
+		if (content) PKI_IO_free(content);
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Bad output descriptor (%d)", out_fd);
+	}
+
+	ret = PKI_X509_CMS_decrypt_io(cms, k, x, content, out);
+
+	if (content) PKI_IO_free(content);
+	PKI_IO_free(out);
+
+	return ret;
+}
+
 PKI_X509_CMS * PKI_X509_CMS_wrap(PKI_X509_CMS      ** cms,
 								 PKI_X509_CMS_TYPE    type) {
 
@@ -1244,90 +1572,29 @@ int PKI_X509_CMS_encode(const PKI_X509_CMS * const cms,
 
 PKI_MEM *PKI_X509_CMS_get_raw_data(const PKI_X509_CMS * const cms ) {
 
-	PKI_ERROR(PKI_ERR_NOT_IMPLEMENTED,
-		"PKI_X509_CMS_get_recipient_cert() Not Implemented, yet.");
-
-	return NULL;
-
-	/*
-	unsigned char *data = NULL;
-	ssize_t len = -1;
-	int type = -1;
-
-	PKI_X509_CMS_VALUE *p7val = NULL;
-	PKI_MEM *ret = NULL;
-
-	if( !cms || !cms->value ) return ( NULL );
-
-	p7val = cms->value;
-	type = PKI_X509_CMS_get_type ( cms );
-
-	switch (type)
-	{
-		case PKI_X509_CMS_TYPE_DATA:
-			data = p7val->d.data->data;
-			len  = p7val->d.data->length;
-			break;
-
-		case PKI_X509_CMS_TYPE_SIGNED:
-			if (p7val->d.sign && p7val->d.sign->contents &&
-				p7val->d.sign->contents->d.data)
-			{
-				data = p7val->d.sign->contents->d.data->data;
-				len  = p7val->d.sign->contents->d.data->length;
-			}
-			break;
-
-		case PKI_X509_CMS_TYPE_ENCRYPTED:
-			if (p7val->d.enveloped && p7val->d.enveloped->enc_data &&
-				p7val->d.enveloped->enc_data->enc_data)
-			{
-				data = p7val->d.enveloped->enc_data->enc_data->data;
-				len  = p7val->d.enveloped->enc_data->enc_data->length;
-			}
-			break;
-
-		case PKI_X509_CMS_TYPE_SIGNEDANDENCRYPTED:
-			if (p7val->d.signed_and_enveloped &&
-				p7val->d.signed_and_enveloped->enc_data &&
-				p7val->d.signed_and_enveloped->enc_data->enc_data )
-			{
-				data = p7val->d.signed_and_enveloped->enc_data->enc_data->data;
-				len = p7val->d.signed_and_enveloped->enc_data->enc_data->length;
-			}
-			break;
+	ASN1_OCTET_STRING ** content = NULL;
+	PKI_MEM * ret = NULL;
 
-		default:
-			PKI_log_debug ("Unknown PKCS7 type");
-			return NULL;
+	// Input Checks
+	if (!cms || !cms->value) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
 	}
 
-	if ((ret = PKI_MEM_new_null()) == NULL)
-	{
-		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	// Gets the embedded content (encrypted for the enveloped
+	// and encrypted types, compressed for the compressed one)
+	if ((content = CMS_get0_content(cms->value)) == NULL || !*content) {
+		PKI_DEBUG("No embedded content (detached or streamed CMS)");
 		return NULL;
 	}
 
-	if (PKI_MEM_add(ret, (char *) data, (size_t) len) == PKI_ERR)
-	{
-		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, "Memory Failure (ret=%p, data=%p, len=%d)",
-				ret, data, len );
-		PKI_MEM_free ( ret );
+	if ((ret = PKI_MEM_new_data((size_t) ASN1_STRING_length(*content),
+	                            ASN1_STRING_get0_data(*content))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 		return NULL;
 	}
 
-	//
-  //      if((p7bio = PKCS7_dataInit(cms->value ,NULL)) != NULL ) {
-	//	(void)BIO_flush(p7bio);
-  //              ret = PKI_MEM_new_bio( p7bio, NULL );
-	//	BIO_free_all ( p7bio );
-  //      } else {
-	//	PKI_log_debug("PKCS7::get_raw_data()::Can not get data [%s]",
-	//		ERR_error_string(ERR_get_error(), NULL ));
-	// }
-
-	return ( ret );
-	*/
+	return ret;
 }
 
 /*!
@@ -1351,29 +1618,20 @@ PKI_MEM *PKI_X509_CMS_get_data(const PKI_X509_CMS * const cms,
 				 const PKI_X509_KEYPAIR * const k,
 				 const PKI_X509_CERT * const x ) {
 
-	PKI_ERROR(PKI_ERR_NOT_IMPLEMENTED,
-		"PKI_X509_CMS_get_recipient_cert() Not Implemented, yet.");
-
-	return NULL;
-
-	/*
-	PKI_ID type;
+	if (!cms || !cms->value) return NULL;
 
-	if( !cms || !cms->value ) return ( NULL );
+	switch (PKI_X509_CMS_get_type(cms)) {
 
-	type = PKI_X509_CMS_get_type ( cms );
+		case PKI_X509_CMS_TYPE_ENVELOPED: {
+			return PKI_X509_CMS_decode(cms, k, x);
+		} break;
 
-	switch ( type ) {
-		case PKI_X509_CMS_TYPE_ENCRYPTED:
-		case PKI_X509_CMS_TYPE_SIGNEDANDENCRYPTED:
-			PKI_log_debug("PKI_X509_CMS_get_data()::cms is encrypted!");
-			return PKI_X509_CMS_decode ( cms, k, x );
-			break;
-		default:
-			PKI_log_debug("PKI_X509_CMS_get_data()::cms not encrypted");
-			return PKI_X509_CMS_get_raw_data ( cms );
+		default: {
+			return PKI_X509_CMS_get_raw_data(cms);
+		}
 	}
-	*/
+
+	return NULL;
 }
 
 /*!
@@ -1385,54 +1643,22 @@ PKI_MEM *PKI_X509_CMS_decode(const PKI_X509_CMS * const cms,
 			       const PKI_X509_KEYPAIR * const k, 
 			       const PKI_X509_CERT * const x ) {
 
-	PKI_ERROR(PKI_ERR_NOT_IMPLEMENTED,
-		"PKI_X509_CMS_get_recipient_cert() Not Implemented, yet.");
-
-	return NULL;
+	PKI_IO * out = NULL;
+	PKI_MEM * ret = NULL;
 
-	/*
-	BIO *bio = NULL;
-	PKI_MEM *mem = NULL;
-	PKI_ID type = 0;
-	PKI_X509_CERT_VALUE *x_val = NULL;
-	PKI_X509_KEYPAIR_VALUE *pkey = NULL;
-
-	if ( !cms || !cms->value || !k || !k->value ) {
-		PKI_log_debug("PKI_X509_CMS_decode()::Missing cms or pkey!");
-		return ( NULL );
-	};
- 
-	pkey = k->value;
-
-	type = PKI_X509_CMS_get_type ( cms );
-
-	switch ( type ) {
-		case PKI_X509_CMS_TYPE_ENCRYPTED:
-		case PKI_X509_CMS_TYPE_SIGNEDANDENCRYPTED:
-			break;
-		default:
-			PKI_log_debug("PKI_X509_CMS_decode()::Wrong MSG type!");
-                	return PKI_ERR;
-        }
-
-	if ( x ) x_val = x->value;
-
-	if((bio = PKCS7_dataDecode(cms->value, pkey, NULL, x_val)) == NULL) {
-		PKI_log_debug ( "PKI_X509_CMS_decode()::Decrypt error [%s]",
-			ERR_error_string(ERR_get_error(), NULL ));
-		return ( NULL );
+	if ((out = BIO_new(BIO_s_mem())) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
 	}
 
-	if((mem = PKI_MEM_new_bio( (PKI_IO *) bio, NULL )) == NULL ) {
-		PKI_log_debug("PKI_X509_CMS_decode()::Memory Error!");
-		if( bio ) BIO_free_all ( bio );
-		return ( NULL );
-	}
+	// Decrypts the embedded content (see PKI_X509_CMS_decrypt_io
+	// for large or detached contents)
+	if (PKI_X509_CMS_decrypt_io(cms, k, x, NULL, out) == PKI_OK)
+		ret = PKI_MEM_new_bio(out, NULL);
 
-	if (bio ) BIO_free_all ( bio );
+	PKI_IO_free(out);
 
-	return ( mem );
-	*/
+	return ret;
 }
 
 /*! \brief Set the cipher in a encrypted (or signed and encrypted) PKCS7 */
@@ -481,7 +481,7 @@ PKI_X509_CRL_ENTRY * PKI_X509_CRL_ENTRY_new_serial(const char
   PKI_INTEGER * s_int = NULL;
     // ASN1 Integer
 
-  PKI_TIME * a_date = NULL;
+  const PKI_TIME * a_date = NULL;
     // ASN1 Rev Date
 
   // Input check
@@ -496,25 +496,9 @@ PKI_X509_CRL_ENTRY * PKI_X509_CRL_ENTRY_new_serial(const char
     return NULL;
   }
 
-  // If no revocation date is provided, let's use "now"
-  if (revDate == NULL) {
-    // Allocates a new ASN1_GENERALIZEDTIME
-    a_date = PKI_TIME_new(0);
-    // Checks for correct allocation
-    if (a_date == NULL) {
-      PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
-      return NULL;
-    }
-  } else {
-    // Copies the passed date
-    a_date = PKI_TIME_dup(revDate);
-    // Checks for correct copying
-    if (a_date == NULL) {
-      // Can not allocate the revocation date time
-      PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
-      return NULL;
-    }
-  }
+  // If no revocation date is provided, let's use "now" (the date is
+  // copied in the entry)
+  if ((a_date = revDate) == NULL) a_date = PKI_TIME_now();
 
   // Generates the integer carrying the serial number
   if ((s_int = PKI_INTEGER_new_char(serial)) != NULL) {
@@ -523,15 +507,11 @@ PKI_X509_CRL_ENTRY * PKI_X509_CRL_ENTRY_new_serial(const char
     if (X509_REVOKED_set_serialNumber(entry, s_int) == 1) {
 
       // Sets the revocation date
-      if (!X509_REVOKED_set_revocationDate(entry, a_date)) {
+      if (!X509_REVOKED_set_revocationDate(entry, (PKI_TIME *) a_date)) {
         PKI_ERROR(PKI_ERR_GENERAL, "Can not assign revocation date");
         goto err;
       }
 
-      // All Ok here
-      PKI_TIME_free(a_date); // Free Memory
-      a_date = NULL; // Safety
-
     } else {
 
       // Error While assigning the serial
@@ -666,7 +646,6 @@ err:
   // Free Allocated memory
   if (s_int) PKI_INTEGER_free(s_int);
   if (entry) X509_REVOKED_free((X509_REVOKED *) entry);
-  if (a_date) PKI_TIME_free(a_date);
 
   // Returns null (error)
   return NULL;
@@ -854,6 +833,9 @@ int PKI_X509_CRL_add_extension(const PKI_X509_CRL       * x,
     return PKI_ERR;
   }
 
+  // Drops the cached encoding and digests
+  PKI_X509_CACHE_clear((PKI_X509_CRL *)x);
+
   // Adds the Extension to the CRL
   if (!X509_CRL_add_ext((X509_CRL *)x->value, ext->value.x509_ext, -1)) {
     return PKI_ERR;
@@ -874,6 +856,9 @@ int PKI_X509_CRL_add_extension_stack(const PKI_X509_CRL             * x,
     return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
   }
 
+  // Drops the cached encoding and digests
+  PKI_X509_CACHE_clear((PKI_X509_CRL *)x);
+
   // Cycles through the stack elements
   for(int i = 0; i < PKI_STACK_X509_EXTENSION_elements(ext); i++ ) {
 
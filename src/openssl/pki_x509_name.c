@@ -27,6 +27,7 @@ PKI_X509_NAME *PKI_X509_NAME_new (const char *name) {
 	char *token = NULL;
 	const char *start = NULL;
 	const char *pnt = NULL;
+	const char *end = NULL;
 	int  mrdn = 0;
 
 	unsigned long ctype = MBSTRING_UTF8;
@@ -36,9 +37,11 @@ PKI_X509_NAME *PKI_X509_NAME_new (const char *name) {
 		return (NULL);
 	}
 
+	// The end of the string is computed once, the parsing is linear
 	start = name;
 	pnt = start;
-	while( ( pnt ) && (pnt < start + strlen(start)) && (status != 5) ) {
+	end = name ? name + strlen(name) : NULL;
+	while( ( pnt ) && (pnt < end) && (status != 5) ) {
 		if ( status == 0 ) {
 			if( *pnt == ' ' ) {
 				pnt++;
@@ -128,16 +131,17 @@ PKI_X509_NAME *PKI_X509_NAME_new (const char *name) {
 					err = PKI_ERROR_crypto_get_errdesc();
 					PKI_ERROR(PKI_ERR_GENERAL, err);
 
-					free(token);
-					free(key);
-					free(val);
+					PKI_Free(token);
+					PKI_Free(key);
+					PKI_Free(val);
+					PKI_X509_NAME_free(ret);
 
 					return ( NULL );
 				};
 
-				free( key );
-				free( val );
-				free ( token );
+				PKI_Free(key);
+				PKI_Free(val);
+				PKI_Free ( token );
 
 				token = NULL;
 
@@ -172,6 +176,8 @@ PKI_X509_NAME *PKI_X509_NAME_new (const char *name) {
 int PKI_X509_NAME_cmp ( const PKI_X509_NAME *a, const PKI_X509_NAME *b ) {
 	if (!a || !b ) return ( -1 );
 
+	if ( a == b ) return ( 0 );
+
 	return X509_NAME_cmp ( a, b );
 }
 
@@ -475,3 +481,392 @@ const char *PKI_X509_NAME_RDN_type_descr ( const PKI_X509_NAME_RDN *rdn ) {
         return PKI_OID_get_descr(oid);
 }
 
+
+// ==============
+// Interned Names
+// ==============
+
+/*
+ * NOTE: the interned names live until PKI_X509_NAME_intern_flush(), their
+ *       memory is allocated with malloc()/calloc() directly. The lookups
+ *       are keyed by the DER of the name (cached by OpenSSL), the names
+ *       are canonicalized only the first time an encoding is seen.
+ */
+
+#define NAME_INTERN_BUCKETS		256
+
+/* String types that X509_NAME_cmp() canonicalizes */
+#define NAME_CANON_MASK (B_ASN1_UTF8STRING | B_ASN1_BMPSTRING | \
+		B_ASN1_UNIVERSALSTRING | B_ASN1_PRINTABLESTRING | B_ASN1_T61STRING | \
+		B_ASN1_IA5STRING | B_ASN1_VISIBLESTRING)
+
+struct pki_x509_name_ref_st {
+	/* Copy of the name and its DER */
+	X509_NAME * name;
+	unsigned char * der;
+	size_t der_len;
+	uint64_t der_hash;
+	/* SHA-1 of the DER (OCSP issuerNameHash) */
+	unsigned char name_hash[SHA_DIGEST_LENGTH];
+	/* Canonical encoding (shared with the first ref of the same name) */
+	unsigned char * canon;
+	size_t canon_len;
+	uint64_t hash;
+	const struct pki_x509_name_ref_st * first;
+	/* Hash chains */
+	struct pki_x509_name_ref_st * next_der;
+	struct pki_x509_name_ref_st * next_canon;
+};
+
+static pthread_rwlock_t _intern_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static PKI_X509_NAME_REF ** _intern_der = NULL;
+static PKI_X509_NAME_REF ** _intern_canon = NULL;
+static size_t _intern_buckets = 0;
+static int _intern_num = 0;
+
+static uint64_t _intern_hash(const unsigned char *data, size_t size) {
+
+	uint64_t h = 14695981039346656037ULL;
+	size_t i = 0;
+
+	for (i = 0; i < size; i++) {
+		h ^= data[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+static int _canon_space(unsigned char c) {
+
+	return (c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r');
+}
+
+/* Adds the entry value as compared by X509_NAME_cmp() (UTF-8, trimmed,
+ * collapsed spaces and lower case ASCII) */
+static int _canon_add(X509_NAME *canon, const X509_NAME_ENTRY *ne, int set) {
+
+	const ASN1_STRING *val = X509_NAME_ENTRY_get_data(ne);
+	const ASN1_OBJECT *obj = X509_NAME_ENTRY_get_object(ne);
+	unsigned char *buf = NULL, *from = NULL, *to = NULL, *end = NULL;
+	int len = 0, ret = 0;
+
+	if (!(ASN1_tag2bit(ASN1_STRING_type(val)) & NAME_CANON_MASK))
+		return X509_NAME_add_entry_by_OBJ(canon, obj, ASN1_STRING_type(val),
+			ASN1_STRING_get0_data(val), ASN1_STRING_length(val), -1, set);
+
+	if ((len = ASN1_STRING_to_UTF8(&buf, val)) < 0) return 0;
+
+	from = buf;
+	end = buf + len;
+	while (from < end && _canon_space(*from)) from++;
+	while (end > from && _canon_space(*(end - 1))) end--;
+
+	for (to = buf; from < end; ) {
+		if (_canon_space(*from)) {
+			*to++ = ' ';
+			while (from < end && _canon_space(*from)) from++;
+		} else {
+			*to++ = (*from >= 'A' && *from <= 'Z') ? (unsigned char) (*from++ + 32) : *from++;
+		}
+	}
+
+	ret = X509_NAME_add_entry_by_OBJ(canon, obj, V_ASN1_UTF8STRING, buf,
+		(int) (to - buf), -1, set);
+
+	OPENSSL_free(buf);
+
+	return ret;
+}
+
+/* Canonical DER of the name */
+static unsigned char * _canon_der(const X509_NAME *name, size_t *size) {
+
+	X509_NAME *canon = NULL;
+	const X509_NAME_ENTRY *ne = NULL;
+	unsigned char *ret = NULL, *p = NULL;
+	int i = 0, len = 0, prev = -1;
+
+	if ((canon = X509_NAME_new()) == NULL) return NULL;
+
+	// Keeps the multi-valued RDNs together
+	for (i = 0; i < X509_NAME_entry_count(name); i++) {
+		ne = X509_NAME_get_entry(name, i);
+		if (!_canon_add(canon, ne, i > 0 && X509_NAME_ENTRY_set(ne) == prev ? -1 : 0))
+			goto end;
+		prev = X509_NAME_ENTRY_set(ne);
+	}
+
+	if ((len = i2d_X509_NAME(canon, NULL)) <= 0
+			|| (ret = malloc((size_t) len)) == NULL) goto end;
+
+	p = ret;
+	i2d_X509_NAME(canon, &p);
+	*size = (size_t) len;
+
+end:
+	X509_NAME_free(canon);
+
+	return ret;
+}
+
+static void _ref_free(PKI_X509_NAME_REF *ref) {
+
+	if (!ref) return;
+
+	if (ref->name) X509_NAME_free(ref->name);
+	if (ref->first == ref) free(ref->canon);
+	free(ref->der);
+	free(ref);
+}
+
+static PKI_X509_NAME_REF * _ref_new(const X509_NAME *name, const unsigned char *der,
+		size_t der_len, uint64_t der_hash) {
+
+	PKI_X509_NAME_REF *ret = NULL;
+
+	if ((ret = calloc(1, sizeof(PKI_X509_NAME_REF))) == NULL
+			|| (ret->der = malloc(der_len)) == NULL
+			|| (ret->name = X509_NAME_dup(name)) == NULL
+			|| (ret->canon = _canon_der(name, &ret->canon_len)) == NULL
+			|| !EVP_Digest(der, der_len, ret->name_hash, NULL, EVP_sha1(), NULL)) {
+		if (ret) ret->first = ret;
+		_ref_free(ret);
+		return NULL;
+	}
+
+	memcpy(ret->der, der, der_len);
+	ret->der_len = der_len;
+	ret->der_hash = der_hash;
+	ret->hash = _intern_hash(ret->canon, ret->canon_len);
+	ret->first = ret;
+
+	return ret;
+}
+
+/* Doubles the buckets (write lock held) */
+static int _intern_grow(void) {
+
+	PKI_X509_NAME_REF **der = NULL, **canon = NULL, *ref = NULL, *next = NULL;
+	size_t buckets = _intern_buckets ? _intern_buckets * 2 : NAME_INTERN_BUCKETS;
+	size_t i = 0, k = 0;
+
+	if ((der = calloc(buckets, sizeof(PKI_X509_NAME_REF *))) == NULL
+			|| (canon = calloc(buckets, sizeof(PKI_X509_NAME_REF *))) == NULL) {
+		free(der);
+		return PKI_ERR;
+	}
+
+	for (i = 0; i < _intern_buckets; i++) {
+		for (ref = _intern_der[i]; ref; ref = next) {
+			next = ref->next_der;
+			k = ref->der_hash % buckets;
+			ref->next_der = der[k];
+			der[k] = ref;
+		}
+		for (ref = _intern_canon[i]; ref; ref = next) {
+			next = ref->next_canon;
+			k = ref->hash % buckets;
+			ref->next_canon = canon[k];
+			canon[k] = ref;
+		}
+	}
+
+	free(_intern_der);
+	free(_intern_canon);
+
+	_intern_der = der;
+	_intern_canon = canon;
+	_intern_buckets = buckets;
+
+	return PKI_OK;
+}
+
+/* Lock held */
+static PKI_X509_NAME_REF * _intern_find(const unsigned char *der, size_t der_len,
+		uint64_t der_hash) {
+
+	PKI_X509_NAME_REF *ref = NULL;
+
+	if (!_intern_buckets) return NULL;
+
+	for (ref = _intern_der[der_hash % _intern_buckets]; ref; ref = ref->next_der) {
+		if (ref->der_hash == der_hash && ref->der_len == der_len
+				&& memcmp(ref->der, der, der_len) == 0) return ref;
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Returns the interned copy of a name
+ *
+ * Names that are equal for PKI_X509_NAME_cmp() share the canonical
+ * encoding and its hash, so PKI_X509_NAME_REF_cmp() compares pointers.
+ * The SHA-1 of the DER (as in the OCSP CertID) is computed once for every
+ * encoding. The refs are valid until PKI_X509_NAME_intern_flush(), NULL is
+ * returned when PKI_X509_NAME_INTERN_MAX encodings are already interned.
+ */
+
+const PKI_X509_NAME_REF * PKI_X509_NAME_intern(const PKI_X509_NAME *name) {
+
+	PKI_X509_NAME_REF *ret = NULL, *ref = NULL;
+	const unsigned char *der = NULL;
+	size_t der_len = 0;
+	uint64_t der_hash = 0;
+
+	if (!name) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (!X509_NAME_get0_der(name, &der, &der_len)) {
+		PKI_ERROR(PKI_ERR_DATA_ASN1_ENCODING, NULL);
+		return NULL;
+	}
+	der_hash = _intern_hash(der, der_len);
+
+	pthread_rwlock_rdlock(&_intern_lock);
+	ret = _intern_find(der, der_len, der_hash);
+	pthread_rwlock_unlock(&_intern_lock);
+
+	if (ret) return ret;
+
+	// First time the encoding is seen
+	if ((ref = _ref_new(name, der, der_len, der_hash)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	pthread_rwlock_wrlock(&_intern_lock);
+
+	if ((ret = _intern_find(der, der_len, der_hash)) != NULL) goto end;
+
+	if (_intern_num >= PKI_X509_NAME_INTERN_MAX
+			|| (_intern_num >= (int) _intern_buckets * 2 && _intern_grow() != PKI_OK))
+		goto end;
+
+	for (ret = _intern_canon[ref->hash % _intern_buckets]; ret; ret = ret->next_canon) {
+		if (ret->hash == ref->hash && ret->canon_len == ref->canon_len
+				&& memcmp(ret->canon, ref->canon, ref->canon_len) == 0) break;
+	}
+
+	if (ret) {
+		// Another encoding of an interned name
+		free(ref->canon);
+		ref->canon = ret->canon;
+		ref->first = ret;
+	} else {
+		ref->next_canon = _intern_canon[ref->hash % _intern_buckets];
+		_intern_canon[ref->hash % _intern_buckets] = ref;
+	}
+
+	ref->next_der = _intern_der[der_hash % _intern_buckets];
+	_intern_der[der_hash % _intern_buckets] = ref;
+	_intern_num++;
+
+	ret = ref;
+	ref = NULL;
+
+end:
+	pthread_rwlock_unlock(&_intern_lock);
+
+	if (ref) _ref_free(ref);
+
+	return ret;
+}
+
+/*! \brief Returns 0 if the two interned names are the same, non-zero
+ *         otherwise (the order is the one of the hashes) */
+
+int PKI_X509_NAME_REF_cmp(const PKI_X509_NAME_REF *a, const PKI_X509_NAME_REF *b) {
+
+	if (!a || !b) return -1;
+
+	if (a->first == b->first) return 0;
+
+	if (a->hash != b->hash) return a->hash < b->hash ? -1 : 1;
+
+	if (a->canon_len != b->canon_len) return a->canon_len < b->canon_len ? -1 : 1;
+
+	return memcmp(a->canon, b->canon, a->canon_len) < 0 ? -1 : 1;
+}
+
+/*! \brief Returns the interned name (read-only) */
+
+const PKI_X509_NAME * PKI_X509_NAME_REF_get_name(const PKI_X509_NAME_REF *ref) {
+
+	return ref ? ref->name : NULL;
+}
+
+/*! \brief Returns the 64-bit hash of the canonical encoding of the name */
+
+uint64_t PKI_X509_NAME_REF_get_hash(const PKI_X509_NAME_REF *ref) {
+
+	return ref ? ref->hash : 0;
+}
+
+/*! \brief Returns the canonical encoding of the name (as compared by
+ *         PKI_X509_NAME_cmp) */
+
+const unsigned char * PKI_X509_NAME_REF_get_canon(const PKI_X509_NAME_REF *ref,
+						  size_t *size) {
+
+	if (!ref) return NULL;
+
+	if (size) *size = ref->canon_len;
+
+	return ref->canon;
+}
+
+/*! \brief Returns the SHA-1 of the DER of the name (issuerNameHash) */
+
+const unsigned char * PKI_X509_NAME_REF_get_name_hash(const PKI_X509_NAME_REF *ref,
+						      size_t *size) {
+
+	if (!ref) return NULL;
+
+	if (size) *size = sizeof(ref->name_hash);
+
+	return ref->name_hash;
+}
+
+/*! \brief Returns the number of interned encodings */
+
+int PKI_X509_NAME_intern_num(void) {
+
+	int ret = 0;
+
+	pthread_rwlock_rdlock(&_intern_lock);
+	ret = _intern_num;
+	pthread_rwlock_unlock(&_intern_lock);
+
+	return ret;
+}
+
+/*! \brief Frees the interned names (the refs are no longer valid) */
+
+void PKI_X509_NAME_intern_flush(void) {
+
+	PKI_X509_NAME_REF *ref = NULL, *next = NULL;
+	size_t i = 0;
+
+	pthread_rwlock_wrlock(&_intern_lock);
+
+	for (i = 0; i < _intern_buckets; i++) {
+		for (ref = _intern_der[i]; ref; ref = next) {
+			next = ref->next_der;
+			_ref_free(ref);
+		}
+	}
+
+	free(_intern_der);
+	free(_intern_canon);
+
+	_intern_der = _intern_canon = NULL;
+	_intern_buckets = 0;
+	_intern_num = 0;
+
+	pthread_rwlock_unlock(&_intern_lock);
+}
@@ -294,7 +294,7 @@ PKI_X509_PKCS7 *PKI_X509_PKCS7_new(PKI_X509_PKCS7_TYPE type) {
 	PKI_X509_PKCS7       * p7    = NULL;
 	PKI_X509_PKCS7_VALUE * value = NULL;
 
-	if((value = p7->cb->create()) == NULL ) {
+	if((value = PKCS7_new()) == NULL ) {
 		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 		return NULL;
 	}
@@ -310,8 +310,7 @@ PKI_X509_PKCS7 *PKI_X509_PKCS7_new(PKI_X509_PKCS7_TYPE type) {
 		// If encrypted, we need to set the cipher
 		case PKI_X509_PKCS7_TYPE_ENCRYPTED:
 		case PKI_X509_PKCS7_TYPE_SIGNEDANDENCRYPTED: {
-			if (!PKI_X509_PKCS7_set_cipher(p7,
-				                           (EVP_CIPHER *) PKI_CIPHER_AES(256,cbc))) {
+			if (!PKCS7_set_cipher(value, PKI_CIPHER_AES(256,cbc))) {
 				// Reports the error
 				PKI_ERROR(PKI_ERR_X509_PKCS7_CIPHER, NULL);
 
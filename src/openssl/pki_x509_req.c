@@ -251,6 +251,9 @@ int PKI_X509_REQ_add_extension(PKI_X509_REQ * x, PKI_X509_EXTENSION * ext) {
 		return PKI_ERR;
 	}
 
+	// Drops the cached encoding and digests
+	PKI_X509_CACHE_clear(x);
+
 	// Gets the Internal Value
 	val = x->value;
 
@@ -314,6 +317,9 @@ int PKI_X509_REQ_add_extension_stack(PKI_X509_REQ 			  * x,
 		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 	}
 
+	// Drops the cached encoding and digests
+	PKI_X509_CACHE_clear(x);
+
 	// Generates a new Crypto-Layer Stack of extensions
 	if((sk = sk_X509_EXTENSION_new_null()) == NULL ) {
 		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
@@ -530,6 +536,9 @@ int PKI_X509_REQ_add_attribute ( PKI_X509_REQ *req, PKI_X509_ATTRIBUTE *attr ) {
 	if ( !req || !req->value || !attr ) return PKI_ERR;
 
 	val = req->value;
+
+	// Attributes are changed in place, forces re-encoding
+	PKI_X509_set_modified(req);
 #if OPENSSL_VERSION_NUMBER < 0x1010000fL
 	if (val->req_info != NULL) {
 		return PKI_STACK_X509_ATTRIBUTE_add(val->req_info->attributes, attr);
@@ -553,6 +562,9 @@ int PKI_X509_REQ_delete_attribute ( PKI_X509_REQ *req, PKI_ID id ) {
 
 	val = req->value;
 
+	// Attributes are changed in place, forces re-encoding
+	PKI_X509_set_modified(req);
+
 #if OPENSSL_VERSION_NUMBER > 0x1010000fL
 	if (!val->req_info.attributes) {
 		ret = PKI_ERROR(PKI_ERR_PARAM_NULL, "No Attributes present");
@@ -581,6 +593,9 @@ int PKI_X509_REQ_delete_attribute_by_num ( PKI_X509_REQ *req, int pos ) {
 
 	val = req->value;
 
+	// Attributes are changed in place, forces re-encoding
+	PKI_X509_set_modified(req);
+
 #if OPENSSL_VERSION_NUMBER > 0x1010000fL
 	if (val->req_info.attributes != NULL) {
 		ret = PKI_STACK_X509_ATTRIBUTE_delete_by_num(
@@ -606,6 +621,9 @@ int PKI_X509_REQ_delete_attribute_by_name ( PKI_X509_REQ *req, char *name ) {
 	if (!req || !req->value || !name) return PKI_ERR;
 	val = req->value;
 
+	// Attributes are changed in place, forces re-encoding
+	PKI_X509_set_modified(req);
+
 #if OPENSSL_VERSION_NUMBER > 0x1010000fL
 	if (val->req_info.attributes != NULL) {
 		ret = PKI_STACK_X509_ATTRIBUTE_delete_by_name(
@@ -633,6 +651,9 @@ int PKI_X509_REQ_clear_attributes ( PKI_X509_REQ *req ) {
 
 	val = req->value;
 
+	// Attributes are changed in place, forces re-encoding
+	PKI_X509_set_modified(req);
+
 
 #if OPENSSL_VERSION_NUMBER > 0x1010000fL
 	if (val->req_info.attributes != NULL) {
@@ -0,0 +1,416 @@
+/* Arena (bump) allocator for request-scoped allocations */
+
+#include <libpki/pki.h>
+
+// ==================
+// Internal Structures
+// ==================
+
+struct pki_arena_chunk_st {
+	struct pki_arena_chunk_st * next;
+	// Arena the chunk belongs to
+	PKI_ARENA * arena;
+	size_t size;
+	size_t used;
+	// Offset of the last allocation (for in-place growth)
+	size_t last;
+};
+
+/* Alignment of the returned memory */
+#define ARENA_ALIGN			16
+#define ARENA_ROUND(x)			(((x) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+/* Every allocation is preceded by its size and, right before the
+ * returned memory, a tag (aligned header) */
+#define ARENA_HDR_SIZE			ARENA_ROUND(2 * sizeof(size_t))
+#define ARENA_HDR_TAG(p)		((size_t *)((unsigned char *)(p) - sizeof(size_t)))
+
+/* The tag is not a plausible heap chunk size (the word before the
+ * memory returned by malloc) */
+#define ARENA_MAGIC			((size_t) 0xA5E4A11CA5E4A11CULL)
+#define ARENA_CHUNK_HDR_SIZE		ARENA_ROUND(sizeof(PKI_ARENA_CHUNK))
+
+#define ARENA_CHUNK_DATA(c)		((unsigned char *)(c) + ARENA_CHUNK_HDR_SIZE)
+
+static __thread PKI_ARENA * _pki_arena_current = NULL;
+
+// Live chunks of all the arenas, sorted by address, to recognize
+// arena memory freed after the unbind or by another thread
+static PKI_ARENA_CHUNK ** _arena_chunks = NULL;
+static size_t _arena_chunks_num = 0;
+static size_t _arena_chunks_size = 0;
+static pthread_rwlock_t _arena_chunks_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// ==================
+// Internal Functions
+// ==================
+
+// Returns the position of the first chunk not below ptr (lock held)
+static size_t _arena_chunks_pos(const void * ptr) {
+
+	size_t lo = 0, hi = _arena_chunks_num, mid = 0;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if ((const void *) _arena_chunks[mid] < ptr) lo = mid + 1;
+		else hi = mid;
+	}
+
+	return lo;
+}
+
+static PKI_ARENA_CHUNK * _arena_chunk_new(PKI_ARENA * arena, size_t size) {
+
+	PKI_ARENA_CHUNK * c = NULL;
+	size_t pos = 0;
+
+	// The chunks are not zeroized, allocations are
+	if ((c = (PKI_ARENA_CHUNK *) malloc(ARENA_CHUNK_HDR_SIZE + size)) == NULL) return NULL;
+
+	c->next = NULL;
+	c->arena = arena;
+	c->size = size;
+	c->used = 0;
+	c->last = 0;
+
+	pthread_rwlock_wrlock(&_arena_chunks_lock);
+
+	if (_arena_chunks_num == _arena_chunks_size) {
+		PKI_ARENA_CHUNK ** tmp = NULL;
+		size_t tmp_size = _arena_chunks_size ? _arena_chunks_size * 2 : 64;
+
+		if ((tmp = realloc(_arena_chunks, tmp_size * sizeof(PKI_ARENA_CHUNK *))) == NULL) {
+			pthread_rwlock_unlock(&_arena_chunks_lock);
+			free(c);
+			return NULL;
+		}
+		_arena_chunks = tmp;
+		_arena_chunks_size = tmp_size;
+	}
+
+	pos = _arena_chunks_pos(c);
+	memmove(&_arena_chunks[pos + 1], &_arena_chunks[pos],
+		(_arena_chunks_num - pos) * sizeof(PKI_ARENA_CHUNK *));
+	_arena_chunks[pos] = c;
+	__atomic_store_n(&_arena_chunks_num, _arena_chunks_num + 1, __ATOMIC_RELEASE);
+
+	pthread_rwlock_unlock(&_arena_chunks_lock);
+
+	return c;
+}
+
+static void _arena_chunk_free(PKI_ARENA_CHUNK * c) {
+
+	size_t pos = 0;
+
+	pthread_rwlock_wrlock(&_arena_chunks_lock);
+
+	pos = _arena_chunks_pos(c);
+	if (pos < _arena_chunks_num && _arena_chunks[pos] == c) {
+		memmove(&_arena_chunks[pos], &_arena_chunks[pos + 1],
+			(_arena_chunks_num - pos - 1) * sizeof(PKI_ARENA_CHUNK *));
+		__atomic_store_n(&_arena_chunks_num, _arena_chunks_num - 1, __ATOMIC_RELEASE);
+	}
+
+	pthread_rwlock_unlock(&_arena_chunks_lock);
+
+	free(c);
+}
+
+// Returns 1 if ptr carries the arena tag. For heap memory the word
+// belongs to the allocator header, which is why ASAN is not involved
+ATTRIBUTE_NO_SANITIZE_ADDRESS
+static int _arena_tagged(const void * ptr) {
+
+	return (*ARENA_HDR_TAG(ptr) == ARENA_MAGIC);
+}
+
+static PKI_ARENA_CHUNK * _arena_chunk_get(const PKI_ARENA * arena, const void * ptr) {
+
+	PKI_ARENA_CHUNK * c = NULL;
+	const unsigned char * p = (const unsigned char *) ptr;
+
+	for (c = arena->chunks; c != NULL; c = c->next) {
+		if (p >= ARENA_CHUNK_DATA(c) && p < ARENA_CHUNK_DATA(c) + c->used) return c;
+	}
+
+	return NULL;
+}
+
+// ==================
+// Exported Functions
+// ==================
+
+/*! \brief Allocates a new arena (chunk_size 0 selects PKI_ARENA_CHUNK_SIZE) */
+
+PKI_ARENA * PKI_ARENA_new(size_t chunk_size) {
+
+	PKI_ARENA * ret = NULL;
+
+	if ((ret = (PKI_ARENA *) calloc(1, sizeof(PKI_ARENA))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	ret->chunk_size = ARENA_ROUND(chunk_size > 0 ? chunk_size : PKI_ARENA_CHUNK_SIZE);
+
+	return ret;
+}
+
+/*! \brief Frees an arena and all the memory allocated from it */
+
+void PKI_ARENA_free(PKI_ARENA * arena) {
+
+	PKI_ARENA_CHUNK * c = NULL;
+
+	if (!arena) return;
+
+	if (arena->bound) {
+		PKI_DEBUG("Arena freed while bound to a thread");
+		if (_pki_arena_current == arena) _pki_arena_current = arena->prev;
+	}
+
+	while ((c = arena->chunks) != NULL) {
+		arena->chunks = c->next;
+		_arena_chunk_free(c);
+	}
+
+	free(arena);
+}
+
+/*! \brief Allocates zeroized memory from the arena */
+
+void * PKI_ARENA_alloc(PKI_ARENA * arena, size_t size) {
+
+	PKI_ARENA_CHUNK * c = NULL;
+	unsigned char * ret = NULL;
+	size_t need = 0;
+
+	if (!arena || size == 0) return NULL;
+
+	need = ARENA_HDR_SIZE + ARENA_ROUND(size);
+
+	if ((c = arena->chunks) == NULL || c->size - c->used < need) {
+
+		// Large allocations get their own chunk, behind the current one
+		if (need > arena->chunk_size / 4 && arena->chunks) {
+			if ((c = _arena_chunk_new(arena, need)) == NULL) return NULL;
+			c->next = arena->chunks->next;
+			arena->chunks->next = c;
+		} else {
+			if ((c = _arena_chunk_new(arena, need > arena->chunk_size ? need : arena->chunk_size)) == NULL)
+				return NULL;
+			c->next = arena->chunks;
+			arena->chunks = c;
+		}
+	}
+
+	ret = ARENA_CHUNK_DATA(c) + c->used;
+	*((size_t *) ret) = size;
+	*ARENA_HDR_TAG(ret + ARENA_HDR_SIZE) = ARENA_MAGIC;
+
+	c->last = c->used;
+	c->used += need;
+
+	memset(ret + ARENA_HDR_SIZE, 0, size);
+
+	return ret + ARENA_HDR_SIZE;
+}
+
+/*!
+ * \brief Resizes memory allocated from the arena
+ *
+ * The last allocation of a chunk is grown in place when possible,
+ * otherwise the data is copied to a new allocation. Like realloc(),
+ * the added memory is not zeroized.
+ */
+
+void * PKI_ARENA_realloc(PKI_ARENA * arena, void * ptr, size_t size) {
+
+	PKI_ARENA_CHUNK * c = NULL;
+	unsigned char * hdr = NULL;
+	size_t old_size = 0;
+	void * ret = NULL;
+
+	if (!arena) return NULL;
+	if (!ptr) return PKI_ARENA_alloc(arena, size);
+	if ((c = _arena_chunk_get(arena, ptr)) == NULL) return NULL;
+
+	hdr = (unsigned char *) ptr - ARENA_HDR_SIZE;
+	old_size = *((size_t *) hdr);
+
+	if (size <= old_size) {
+		*((size_t *) hdr) = size;
+		return ptr;
+	}
+
+	// Last allocation in the chunk
+	if (hdr == ARENA_CHUNK_DATA(c) + c->last
+			&& c->size - c->last >= ARENA_HDR_SIZE + ARENA_ROUND(size)) {
+		c->used = c->last + ARENA_HDR_SIZE + ARENA_ROUND(size);
+		*((size_t *) hdr) = size;
+		return ptr;
+	}
+
+	if ((ret = PKI_ARENA_alloc(arena, size)) == NULL) return NULL;
+	memcpy(ret, ptr, old_size);
+
+	return ret;
+}
+
+/*! \brief Returns 1 if the memory was allocated from the arena, 0 otherwise */
+
+int PKI_ARENA_owns(const PKI_ARENA * arena, const void * ptr) {
+
+	if (!arena || !ptr) return 0;
+
+	return (_arena_chunk_get(arena, ptr) != NULL);
+}
+
+/*!
+ * \brief Returns the arena the memory was allocated from (or NULL)
+ *
+ * The pointer must be one returned by PKI_Malloc() or PKI_Realloc().
+ * Unlike PKI_ARENA_owns(), every live arena is searched, bound or not
+ * and on any thread. Pointers to memory released by a reset of the
+ * arena are still recognized while the chunk is kept.
+ */
+
+PKI_ARENA * PKI_ARENA_find(const void * ptr) {
+
+	PKI_ARENA_CHUNK * c = NULL;
+	PKI_ARENA * ret = NULL;
+	const unsigned char * p = (const unsigned char *) ptr;
+	size_t pos = 0;
+
+	// No arenas, no locking
+	if (!ptr || __atomic_load_n(&_arena_chunks_num, __ATOMIC_ACQUIRE) == 0) return NULL;
+
+	// Heap memory is not tagged
+	if (!_arena_tagged(ptr)) return NULL;
+
+	// Arenas bound to the thread
+	for (ret = _pki_arena_current; ret != NULL; ret = ret->prev) {
+		if (_arena_chunk_get(ret, ptr) != NULL) return ret;
+	}
+
+	// Arenas no longer bound or of other threads
+	pthread_rwlock_rdlock(&_arena_chunks_lock);
+
+	// Last chunk starting below the pointer
+	pos = _arena_chunks_pos(ptr);
+	if (pos > 0) {
+		c = _arena_chunks[pos - 1];
+		if (p >= ARENA_CHUNK_DATA(c) && p < ARENA_CHUNK_DATA(c) + c->size) ret = c->arena;
+	}
+
+	pthread_rwlock_unlock(&_arena_chunks_lock);
+
+	return ret;
+}
+
+/*! \brief Returns the size of memory allocated from an arena */
+
+size_t PKI_ARENA_size(const void * ptr) {
+
+	if (!ptr) return 0;
+
+	return *((const size_t *) ((const unsigned char *) ptr - ARENA_HDR_SIZE));
+}
+
+/*!
+ * \brief Releases all the memory allocated from the arena
+ *
+ * One chunk is kept for the next allocations, the others are freed.
+ */
+
+void PKI_ARENA_reset(PKI_ARENA * arena) {
+
+	PKI_ARENA_CHUNK * c = NULL;
+	PKI_ARENA_CHUNK * keep = NULL;
+
+	if (!arena) return;
+
+	while ((c = arena->chunks) != NULL) {
+		arena->chunks = c->next;
+		if (!keep && c->size == arena->chunk_size) keep = c;
+		else _arena_chunk_free(c);
+	}
+
+	if (keep) {
+		keep->next = NULL;
+		keep->used = 0;
+		keep->last = 0;
+	}
+
+	arena->chunks = keep;
+}
+
+/*!
+ * \brief Binds the arena to the current thread
+ *
+ * PKI_Malloc() allocates from the arena until PKI_ARENA_unbind() is
+ * called. Scopes can be nested, the previous arena is restored when
+ * the arena is unbound.
+ */
+
+int PKI_ARENA_bind(PKI_ARENA * arena) {
+
+	if (!arena) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (arena->bound) return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Arena already bound");
+
+	arena->prev = _pki_arena_current;
+	arena->bound = 1;
+	_pki_arena_current = arena;
+
+	return PKI_OK;
+}
+
+/*! \brief Unbinds the arena (the last one bound) from the current thread */
+
+int PKI_ARENA_unbind(PKI_ARENA * arena) {
+
+	if (!arena) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (_pki_arena_current != arena)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Arena is not the current one");
+
+	_pki_arena_current = arena->prev;
+	arena->prev = NULL;
+	arena->bound = 0;
+
+	return PKI_OK;
+}
+
+/*! \brief Returns the arena bound to the current thread (or NULL) */
+
+PKI_ARENA * PKI_ARENA_get_current(void) {
+
+	return _pki_arena_current;
+}
+
+/*!
+ * \brief Suspends the arena bound to the current thread
+ *
+ * Until PKI_ARENA_resume() is called, PKI_Malloc() on the thread
+ * allocates from the heap. It is used for data that outlives the
+ * request (e.g., global caches and registries). The suspended arena
+ * (or NULL) is returned and must be passed to PKI_ARENA_resume().
+ */
+
+PKI_ARENA * PKI_ARENA_suspend(void) {
+
+	PKI_ARENA * ret = _pki_arena_current;
+
+	_pki_arena_current = NULL;
+
+	return ret;
+}
+
+/*! \brief Restores the arena suspended by PKI_ARENA_suspend() */
+
+void PKI_ARENA_resume(PKI_ARENA * arena) {
+
+	_pki_arena_current = arena;
+}
@@ -0,0 +1,417 @@
+/* Base64 Encoding and Decoding */
+
+#include <libpki/pki.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+# define PKI_B64_SIMD
+# include <immintrin.h>
+#endif
+
+// ==================
+// Internal Structures
+// ==================
+
+/* Values in the decoding table (besides 0..63) */
+#define B64_DEC_SKIP		0x40
+#define B64_DEC_PAD		0x41
+#define B64_DEC_INVALID		0x80
+
+/* Available implementations */
+#define B64_IMPL_SCALAR		0
+#define B64_IMPL_SSSE3		1
+#define B64_IMPL_AVX2		2
+
+static const unsigned char _b64_enc_table[64] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static unsigned char _b64_dec_table[256];
+static int _b64_impl = B64_IMPL_SCALAR;
+static pthread_once_t _b64_once = PTHREAD_ONCE_INIT;
+
+// =================
+// Static Functions
+// =================
+
+static void _b64_init(void) {
+
+	int i = 0;
+
+	for (i = 0; i < 256; i++) _b64_dec_table[i] = B64_DEC_INVALID;
+	for (i = 0; i < 64; i++) _b64_dec_table[_b64_enc_table[i]] = (unsigned char) i;
+
+	_b64_dec_table['='] = B64_DEC_PAD;
+	_b64_dec_table['\r'] = B64_DEC_SKIP;
+	_b64_dec_table['\n'] = B64_DEC_SKIP;
+	_b64_dec_table['\t'] = B64_DEC_SKIP;
+	_b64_dec_table[' '] = B64_DEC_SKIP;
+
+#ifdef PKI_B64_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) _b64_impl = B64_IMPL_AVX2;
+	else if (__builtin_cpu_supports("ssse3")) _b64_impl = B64_IMPL_SSSE3;
+#endif
+}
+
+#ifdef PKI_B64_SIMD
+
+// The SIMD code follows the approach described by W. Mula and D. Lemire
+// ("Faster Base64 Encoding and Decoding Using AVX2 Instructions"): the
+// 6-bit fields are moved in place with multiplies, and the ASCII values
+// are translated (and validated) via nibble-indexed lookup tables
+
+// Encodes 12 bytes per step (up to len bytes, reading up to avail bytes),
+// returns the number of bytes encoded
+__attribute__((target("ssse3")))
+static size_t _b64_enc_ssse3(unsigned char * dst, const unsigned char * src,
+			     size_t len, size_t avail) {
+
+	const __m128i shuf = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+					  -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i in, t0, t1, idx, red;
+	size_t i = 0;
+
+	// Loads 16 bytes to use 12 of them
+	for (i = 0; len - i >= 12 && avail - i >= 16; i += 12, dst += 16) {
+
+		in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i)), shuf);
+
+		t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+				     _mm_set1_epi32(0x04000040));
+		t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+				     _mm_set1_epi32(0x01000010));
+		idx = _mm_or_si128(t0, t1);
+
+		red = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+		red = _mm_sub_epi8(red, _mm_cmpgt_epi8(idx, _mm_set1_epi8(25)));
+
+		_mm_storeu_si128((__m128i *) dst, _mm_add_epi8(idx, _mm_shuffle_epi8(lut, red)));
+	}
+
+	return i;
+}
+
+// Encodes 24 bytes per step (see _b64_enc_ssse3)
+__attribute__((target("avx2")))
+static size_t _b64_enc_avx2(unsigned char * dst, const unsigned char * src,
+			    size_t len, size_t avail) {
+
+	const __m256i shuf = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+					      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+					     -4, -4, -4, -4, -19, -16, 0, 0,
+					     65, 71, -4, -4, -4, -4, -4, -4,
+					     -4, -4, -4, -4, -19, -16, 0, 0);
+	__m256i in, t0, t1, idx, red;
+	size_t i = 0;
+
+	// Loads 2 x 16 bytes to use 2 x 12 of them
+	for (i = 0; len - i >= 24 && avail - i >= 28; i += 24, dst += 32) {
+
+		in = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (src + i))),
+			_mm_loadu_si128((const __m128i *) (src + i + 12)), 1);
+		in = _mm256_shuffle_epi8(in, shuf);
+
+		t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+					_mm256_set1_epi32(0x04000040));
+		t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+					_mm256_set1_epi32(0x01000010));
+		idx = _mm256_or_si256(t0, t1);
+
+		red = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+		red = _mm256_sub_epi8(red, _mm256_cmpgt_epi8(idx, _mm256_set1_epi8(25)));
+
+		_mm256_storeu_si256((__m256i *) dst, _mm256_add_epi8(idx, _mm256_shuffle_epi8(lut, red)));
+	}
+
+	return i;
+}
+
+// Decodes 16 chars per step, stops at the first block that contains
+// anything but alphabet chars. Returns the number of chars decoded.
+__attribute__((target("ssse3")))
+static size_t _b64_dec_ssse3(unsigned char * dst, const unsigned char * src, size_t len) {
+
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+					     0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+					     0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+					       0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m128i mask_2f = _mm_set1_epi8(0x2f);
+	__m128i str, hi_nibbles, lo_nibbles, bad, roll, out;
+	unsigned char buf[16];
+	size_t i = 0;
+
+	for (i = 0; len - i >= 16; i += 16, dst += 12) {
+
+		str = _mm_loadu_si128((const __m128i *) (src + i));
+
+		hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+		lo_nibbles = _mm_and_si128(str, mask_2f);
+
+		bad = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles),
+				    _mm_shuffle_epi8(lut_hi, hi_nibbles));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) != 0xFFFF) break;
+
+		roll = _mm_shuffle_epi8(lut_roll,
+			_mm_add_epi8(_mm_cmpeq_epi8(str, mask_2f), hi_nibbles));
+		str = _mm_add_epi8(str, roll);
+
+		// Packs the 6-bit values into 12 bytes
+		out = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		out = _mm_madd_epi16(out, _mm_set1_epi32(0x00011000));
+		out = _mm_shuffle_epi8(out, pack);
+
+		// The output is not padded, only 12 bytes are written
+		_mm_storeu_si128((__m128i *) buf, out);
+		memcpy(dst, buf, 12);
+	}
+
+	return i;
+}
+
+// Decodes 32 chars per step (see _b64_dec_ssse3)
+__attribute__((target("avx2")))
+static size_t _b64_dec_avx2(unsigned char * dst, const unsigned char * src, size_t len) {
+
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+						0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+						0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+						  0, 0, 0, 0, 0, 0, 0, 0,
+						  0, 16, 19, 4, -65, -65, -71, -71,
+						  0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+					      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+	__m256i str, hi_nibbles, lo_nibbles, bad, roll, out;
+	unsigned char buf[32];
+	size_t i = 0;
+
+	for (i = 0; len - i >= 32; i += 32, dst += 24) {
+
+		str = _mm256_loadu_si256((const __m256i *) (src + i));
+
+		hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+		lo_nibbles = _mm256_and_si256(str, mask_2f);
+
+		bad = _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles),
+				       _mm256_shuffle_epi8(lut_hi, hi_nibbles));
+		if (!_mm256_testz_si256(bad, bad)) break;
+
+		roll = _mm256_shuffle_epi8(lut_roll,
+			_mm256_add_epi8(_mm256_cmpeq_epi8(str, mask_2f), hi_nibbles));
+		str = _mm256_add_epi8(str, roll);
+
+		out = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+		out = _mm256_madd_epi16(out, _mm256_set1_epi32(0x00011000));
+		out = _mm256_shuffle_epi8(out, pack);
+
+		// Moves the 12 bytes of each lane next to each other
+		out = _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+		_mm256_storeu_si256((__m256i *) buf, out);
+		memcpy(dst, buf, 24);
+	}
+
+	return i;
+}
+
+#endif /* PKI_B64_SIMD */
+
+// Encodes len bytes with no line breaks (avail bytes can be read from
+// src), returns the size of the output
+static size_t _b64_enc_run(unsigned char * dst, const unsigned char * src,
+			   size_t len, size_t avail) {
+
+	unsigned char * out = dst;
+	size_t i = 0, done = 0;
+
+#ifdef PKI_B64_SIMD
+	if (_b64_impl == B64_IMPL_AVX2) {
+		done = _b64_enc_avx2(out, src, len, avail);
+		out += done / 3 * 4;
+	}
+	if (_b64_impl >= B64_IMPL_SSSE3) {
+		i = _b64_enc_ssse3(out, src + done, len - done, avail - done);
+		done += i;
+		out += i / 3 * 4;
+	}
+#endif
+
+	for (i = done; len - i >= 3; i += 3) {
+		*out++ = _b64_enc_table[src[i] >> 2];
+		*out++ = _b64_enc_table[((src[i] & 0x03) << 4) | (src[i + 1] >> 4)];
+		*out++ = _b64_enc_table[((src[i + 1] & 0x0f) << 2) | (src[i + 2] >> 6)];
+		*out++ = _b64_enc_table[src[i + 2] & 0x3f];
+	}
+
+	if (len - i == 1) {
+		*out++ = _b64_enc_table[src[i] >> 2];
+		*out++ = _b64_enc_table[(src[i] & 0x03) << 4];
+		*out++ = '=';
+		*out++ = '=';
+	} else if (len - i == 2) {
+		*out++ = _b64_enc_table[src[i] >> 2];
+		*out++ = _b64_enc_table[((src[i] & 0x03) << 4) | (src[i + 1] >> 4)];
+		*out++ = _b64_enc_table[(src[i + 1] & 0x0f) << 2];
+		*out++ = '=';
+	}
+
+	return (size_t) (out - dst);
+}
+
+// Decodes whole blocks of alphabet chars, returns the chars consumed
+static size_t _b64_dec_blocks(unsigned char * dst, const unsigned char * src, size_t len) {
+
+	size_t done = 0;
+
+#ifdef PKI_B64_SIMD
+	if (_b64_impl == B64_IMPL_AVX2 && len >= 32) {
+		done = _b64_dec_avx2(dst, src, len);
+	}
+	if (_b64_impl >= B64_IMPL_SSSE3 && len - done >= 16) {
+		done += _b64_dec_ssse3(dst + done / 4 * 3, src + done, len - done);
+	}
+#endif
+
+	return done;
+}
+
+// =================
+// Public Functions
+// =================
+
+/*!
+ * \brief Returns the size of the encoded data (without the terminating
+ *        NUL char), with a line break every line_len chars (if > 0)
+ */
+
+size_t PKI_B64_encoded_size(size_t len, int line_len) {
+
+	size_t size = (len + 2) / 3 * 4;
+
+	if (line_len > 0 && (line_len &= ~3) == 0) line_len = 4;
+	if (line_len > 0 && size > 0) size += (size - 1) / (size_t) line_len;
+
+	return size;
+}
+
+/*! \brief Returns the maximum size of the decoded data */
+
+size_t PKI_B64_decoded_size(size_t len) {
+
+	return len / 4 * 3 + 3;
+}
+
+/*!
+ * \brief Encodes len bytes from src into dst
+ *
+ * When line_len is > 0, a new line is added every line_len chars (a
+ * multiple of 4), there is no new line after the last line. The dst
+ * buffer must be at least PKI_B64_encoded_size() bytes, the output is
+ * not NUL terminated. Returns the size of the encoded data.
+ */
+
+size_t PKI_B64_encode(unsigned char       * dst,
+		      const unsigned char * src,
+		      size_t                len,
+		      int                   line_len) {
+
+	size_t chunk = 0, i = 0, out = 0;
+
+	if (!dst || (!src && len > 0)) return 0;
+
+	pthread_once(&_b64_once, _b64_init);
+
+	if (line_len <= 0) return _b64_enc_run(dst, src, len, len);
+
+	if ((line_len &= ~3) == 0) line_len = 4;
+	chunk = (size_t) line_len / 4 * 3;
+
+	for (i = 0; i < len; i += chunk) {
+		if (i > 0) dst[out++] = '\n';
+		out += _b64_enc_run(dst + out, src + i, (len - i < chunk ? len - i : chunk), len - i);
+	}
+
+	return out;
+}
+
+/*!
+ * \brief Decodes len chars from src into dst
+ *
+ * Line breaks (CR and LF), tabs and spaces are skipped, the padding is
+ * optional. The dst buffer must be at least PKI_B64_decoded_size()
+ * bytes. Returns the size of the decoded data, or -1 if the data is
+ * not valid Base64.
+ */
+
+ssize_t PKI_B64_decode(unsigned char       * dst,
+		       const unsigned char * src,
+		       size_t                len) {
+
+	uint32_t quad = 0;
+	size_t i = 0, out = 0, done = 0;
+	int n = 0, pad = 0;
+	unsigned char v = 0;
+
+	if (!dst || (!src && len > 0)) return -1;
+
+	pthread_once(&_b64_once, _b64_init);
+
+	while (i < len) {
+
+		// Whole blocks are decoded via SIMD (at quad boundaries)
+		if (n == 0 && pad == 0 && len - i >= 16
+				&& (done = _b64_dec_blocks(dst + out, src + i, len - i)) > 0) {
+			i += done;
+			out += done / 4 * 3;
+			continue;
+		}
+
+		v = _b64_dec_table[src[i++]];
+
+		if (v < 64) {
+			// No data after the padding
+			if (pad) return -1;
+			quad = (quad << 6) | v;
+			if (++n == 4) {
+				dst[out++] = (unsigned char) (quad >> 16);
+				dst[out++] = (unsigned char) (quad >> 8);
+				dst[out++] = (unsigned char) quad;
+				quad = 0;
+				n = 0;
+			}
+		} else if (v == B64_DEC_PAD) {
+			// Padding completes a quad of 2 or 3 chars
+			if (n < 2 || n + (++pad) > 4) return -1;
+		} else if (v != B64_DEC_SKIP) {
+			return -1;
+		}
+	}
+
+	// Last (incomplete) quad
+	switch (n) {
+		case 0:
+			break;
+		case 2:
+			dst[out++] = (unsigned char) (quad >> 4);
+			break;
+		case 3:
+			dst[out++] = (unsigned char) (quad >> 10);
+			dst[out++] = (unsigned char) (quad >> 2);
+			break;
+		default:
+			return -1;
+	}
+
+	return (ssize_t) out;
+}
@@ -3,9 +3,15 @@
 #include <libpki/pki.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
+#include <errno.h>
 #include <libxml/xmlerror.h>
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
 /* Static function, to be used only internally */
 static char * _xml_search_namespace_add ( char *search );
 
@@ -39,6 +45,516 @@ void logXmlMessages( void *userData, xmlErrorPtr error ) {
 	return;
 }
 
+// ===============================
+// Configuration Cache and Registry
+// ===============================
+
+// Parsed documents kept in memory (the least recently used is evicted)
+#define PKI_CONFIG_CACHE_SIZE		64
+
+// Marks a directory that is not watched for changes
+#define PKI_CONFIG_NOTIFY_NONE		-1
+
+// Identifies the version of a file on disk
+typedef struct pki_config_stamp_st {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	long mtime_ns;
+	time_t ctime;
+	long ctime_ns;
+} PKI_CONFIG_STAMP;
+
+// Parsed document (owned by the cache, callers get a copy)
+typedef struct pki_config_cache_entry_st {
+	char * path;
+	PKI_CONFIG_STAMP stamp;
+	PKI_CONFIG * doc;
+	unsigned long long used;
+} PKI_CONFIG_CACHE_ENTRY;
+
+// Configuration file in a registered directory
+typedef struct pki_config_reg_file_st {
+	char * path;
+	char * name;
+	PKI_CONFIG_STAMP stamp;
+} PKI_CONFIG_REG_FILE;
+
+// Directory scanned once and refreshed only when it changes
+typedef struct pki_config_reg_dir_st {
+	char * path;
+	PKI_CONFIG_STAMP stamp;
+	int wd;
+	int stale;
+	PKI_CONFIG_REG_FILE * files;
+	int files_num;
+	int * names;
+	int names_size;
+	struct pki_config_reg_dir_st * next;
+} PKI_CONFIG_REG_DIR;
+
+static pthread_mutex_t _config_lock = PTHREAD_MUTEX_INITIALIZER;
+	// Protects the cache and the registry
+
+static PKI_CONFIG_CACHE_ENTRY _config_cache[PKI_CONFIG_CACHE_SIZE];
+static unsigned long long _config_cache_clock = 0;
+	// Parsed documents and LRU clock
+
+static PKI_CONFIG_REG_DIR * _config_registry = NULL;
+	// Registered directories
+
+static int _config_notify_fd = -1;
+	// Change notifications descriptor (-1 not yet open, -2 unavailable)
+
+static PKI_CONFIG * _config_parse(const char * path) {
+
+	PKI_CONFIG *doc = NULL;
+	xmlParserCtxt *parserCtxt = NULL;
+
+	if ((parserCtxt = xmlNewParserCtxt()) == NULL ) return NULL;
+
+#if LIBXML_VERSION > LIBXML_MIN_VERSION
+	xmlSetStructuredErrorFunc( parserCtxt, logXmlMessages );
+#endif
+
+	/* Do not Keep Blank Nodes */
+	xmlKeepBlanksDefault(0);
+
+	/*parse the file and get the DOM */
+#if LIBXML_VERSION > LIBXML_MIN_VERSION
+	doc = (PKI_CONFIG *) xmlCtxtReadFile(parserCtxt, path, NULL, 
+				XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING | 
+				XML_PARSE_NOENT );
+#else
+	doc = (PKI_CONFIG *) xmlCtxtReadFile(parserCtxt, path, NULL, 0);
+#endif
+
+	// xmlClearParserCtxt ( parserCtxt );
+	xmlFreeParserCtxt ( parserCtxt );
+
+	return doc;
+}
+
+static int _config_stamp(const char * path, PKI_CONFIG_STAMP * stamp) {
+
+	struct stat st;
+
+	if (stat(path, &st) != 0) return PKI_ERR;
+
+	memset(stamp, 0, sizeof(PKI_CONFIG_STAMP));
+	stamp->dev = st.st_dev;
+	stamp->ino = st.st_ino;
+	stamp->size = st.st_size;
+	stamp->mtime = st.st_mtime;
+	stamp->ctime = st.st_ctime;
+
+	// Same-size rewrites within the same second change the nanoseconds
+#ifdef LIBPKI_TARGET_OSX
+	stamp->mtime_ns = st.st_mtimespec.tv_nsec;
+	stamp->ctime_ns = st.st_ctimespec.tv_nsec;
+#else
+	stamp->mtime_ns = st.st_mtim.tv_nsec;
+	stamp->ctime_ns = st.st_ctim.tv_nsec;
+#endif
+
+	return PKI_OK;
+}
+
+static int _config_stamp_eq(const PKI_CONFIG_STAMP * a, const PKI_CONFIG_STAMP * b) {
+	return (a->dev == b->dev && a->ino == b->ino && a->size == b->size
+		&& a->mtime == b->mtime && a->mtime_ns == b->mtime_ns
+		&& a->ctime == b->ctime && a->ctime_ns == b->ctime_ns);
+}
+
+// Returns the cached document for the file version, if any (lock held)
+static PKI_CONFIG * _config_cache_get(const char * path, const PKI_CONFIG_STAMP * stamp) {
+
+	PKI_CONFIG_CACHE_ENTRY * e = NULL;
+	int i = 0;
+
+	for (i = 0; i < PKI_CONFIG_CACHE_SIZE; i++) {
+
+		e = &_config_cache[i];
+		if (!e->path || strcmp(e->path, path) != 0) continue;
+
+		// Drops outdated versions of the file
+		if (!_config_stamp_eq(&e->stamp, stamp)) {
+			xmlFreeDoc(e->doc);
+			free(e->path);
+			memset(e, 0, sizeof(PKI_CONFIG_CACHE_ENTRY));
+			return NULL;
+		}
+
+		e->used = ++_config_cache_clock;
+		return e->doc;
+	}
+
+	return NULL;
+}
+
+// Transfers the ownership of the document to the cache (lock held)
+static void _config_cache_put(const char * path, const PKI_CONFIG_STAMP * stamp,
+			      PKI_CONFIG * doc) {
+
+	PKI_CONFIG_CACHE_ENTRY * e = NULL;
+	char * path_dup = NULL;
+	int i = 0;
+
+	if ((path_dup = strdup(path)) == NULL) {
+		xmlFreeDoc(doc);
+		return;
+	}
+
+	// Reuses the entry for the same path, or the least recently used
+	for (i = 0; i < PKI_CONFIG_CACHE_SIZE; i++) {
+		if (_config_cache[i].path && strcmp(_config_cache[i].path, path) == 0) {
+			e = &_config_cache[i];
+			break;
+		}
+		if (!e || _config_cache[i].used < e->used) e = &_config_cache[i];
+	}
+
+	if (e->path) {
+		xmlFreeDoc(e->doc);
+		free(e->path);
+	}
+
+	e->path = path_dup;
+	e->stamp = *stamp;
+	e->doc = doc;
+	e->used = ++_config_cache_clock;
+}
+
+// Adds a change notification watch for the directory (lock held)
+static int _config_notify_watch(const char * path) {
+
+#ifdef HAVE_SYS_INOTIFY_H
+	int wd = PKI_CONFIG_NOTIFY_NONE;
+
+	if (_config_notify_fd == -1) {
+		if ((_config_notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+			PKI_DEBUG("Config change notifications not available (%s)", strerror(errno));
+			_config_notify_fd = -2;
+		}
+	}
+	if (_config_notify_fd < 0) return PKI_CONFIG_NOTIFY_NONE;
+
+	wd = inotify_add_watch(_config_notify_fd, path, IN_CREATE | IN_DELETE |
+		IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+		IN_DELETE_SELF | IN_MOVE_SELF);
+
+	return wd < 0 ? PKI_CONFIG_NOTIFY_NONE : wd;
+#else
+	return PKI_CONFIG_NOTIFY_NONE;
+#endif
+}
+
+// Marks the directories that changed since the last lookup (lock held)
+static void _config_notify_process(void) {
+
+#ifdef HAVE_SYS_INOTIFY_H
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event * ev = NULL;
+	PKI_CONFIG_REG_DIR * d = NULL;
+	ssize_t len = 0;
+	char * ptr = NULL;
+
+	if (_config_notify_fd < 0) return;
+
+	while ((len = read(_config_notify_fd, buf, sizeof(buf))) > 0) {
+
+		for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len) {
+
+			ev = (const struct inotify_event *) ptr;
+
+			for (d = _config_registry; d != NULL; d = d->next) {
+
+				// Lost events: every directory must be scanned again
+				if (ev->mask & IN_Q_OVERFLOW) d->stale = 1;
+				else if (d->wd != ev->wd) continue;
+
+				d->stale = 1;
+				if (ev->mask & IN_IGNORED) d->wd = PKI_CONFIG_NOTIFY_NONE;
+			}
+		}
+	}
+#endif
+}
+
+// Checks unwatched directories and their files for changes (lock held)
+static int _config_reg_changed(const PKI_CONFIG_REG_DIR * d) {
+
+	PKI_CONFIG_STAMP stamp;
+	int i = 0;
+
+	if (_config_stamp(d->path, &stamp) != PKI_OK
+			|| !_config_stamp_eq(&stamp, &d->stamp)) return 1;
+
+	// Files edited in place do not change the directory
+	for (i = 0; i < d->files_num; i++) {
+		if (_config_stamp(d->files[i].path, &stamp) != PKI_OK
+				|| !_config_stamp_eq(&stamp, &d->files[i].stamp)) return 1;
+	}
+
+	return 0;
+}
+
+static void _config_reg_files_free(PKI_CONFIG_REG_FILE * files, int files_num) {
+
+	int i = 0;
+
+	for (i = 0; i < files_num; i++) {
+		if (files[i].path) free(files[i].path);
+		if (files[i].name) free(files[i].name);
+	}
+	if (files) free(files);
+}
+
+// Case-insensitive FNV-1a of a configuration name
+static unsigned int _config_name_hash(const char * name) {
+
+	unsigned int h = 2166136261u;
+
+	while (*name) {
+		h ^= (unsigned int) toupper((unsigned char) *name++);
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+// Rebuilds the hash index over the files' names (lock held)
+static void _config_reg_index(PKI_CONFIG_REG_DIR * d) {
+
+	unsigned int slot = 0;
+	int size = 16, i = 0, j = 0;
+	int * names = NULL;
+
+	if (d->names) free(d->names);
+	d->names = NULL;
+	d->names_size = 0;
+
+	while (size < 2 * d->files_num) size *= 2;
+
+	// Without the index, lookups scan the files
+	if ((names = calloc((size_t) size, sizeof(int))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return;
+	}
+
+	for (i = 0; i < d->files_num; i++) {
+
+		if (!d->files[i].name) continue;
+
+		// Slots store the (index + 1) of the file, zero is empty. The
+		// first file with a name wins, as in the directory order.
+		slot = _config_name_hash(d->files[i].name) & (unsigned int)(size - 1);
+		while ((j = names[slot]) != 0
+				&& strcmp_nocase(d->files[j-1].name, d->files[i].name) != 0) {
+			slot = (slot + 1) & (unsigned int)(size - 1);
+		}
+		if (j == 0) names[slot] = i + 1;
+	}
+
+	d->names = names;
+	d->names_size = size;
+}
+
+// Returns the file with the configuration name, if any (lock held)
+static const PKI_CONFIG_REG_FILE * _config_reg_lookup(const PKI_CONFIG_REG_DIR * d,
+						      const char * name) {
+
+	unsigned int slot = 0;
+	int i = 0;
+
+	if (d->names == NULL) {
+		for (i = 0; i < d->files_num; i++) {
+			if (d->files[i].name && strcmp_nocase(d->files[i].name, name) == 0)
+				return &d->files[i];
+		}
+		return NULL;
+	}
+
+	slot = _config_name_hash(name) & (unsigned int)(d->names_size - 1);
+	while ((i = d->names[slot]) != 0) {
+		if (strcmp_nocase(d->files[i-1].name, name) == 0) return &d->files[i-1];
+		slot = (slot + 1) & (unsigned int)(d->names_size - 1);
+	}
+
+	return NULL;
+}
+
+// Rebuilds the name index, parsing only new or modified files (lock held)
+static int _config_reg_scan(PKI_CONFIG_REG_DIR * d) {
+
+	struct dirent *dd = NULL;
+	DIR *dirp = NULL;
+
+	PKI_CONFIG_REG_FILE * files = NULL;
+	int files_num = 0, files_size = 0;
+	int i = 0;
+
+	// Watches first, so that changes during the scan are not lost
+	if (d->wd == PKI_CONFIG_NOTIFY_NONE) d->wd = _config_notify_watch(d->path);
+
+	if (_config_stamp(d->path, &d->stamp) != PKI_OK
+			|| (dirp = opendir(d->path)) == NULL) {
+		PKI_DEBUG("Can not open directory [%s]", d->path);
+		return PKI_ERR;
+	}
+
+	while ((dd = readdir(dirp)) != NULL) {
+
+		char fullpath[BUFF_MAX_SIZE];
+		PKI_CONFIG_REG_FILE * f = NULL;
+		PKI_CONFIG * doc = NULL;
+		size_t len = strlen(dd->d_name);
+		size_t path_len = strlen(d->path);
+
+		if (len < 4 || strcmp(".xml", dd->d_name + len - 4) != 0) continue;
+
+		// Check the allowed size
+		if (path_len + len + 2 > sizeof(fullpath)) continue;
+		memcpy(fullpath, d->path, path_len);
+		fullpath[path_len] = '/';
+		memcpy(fullpath + path_len + 1, dd->d_name, len + 1);
+
+		if (files_num == files_size) {
+			PKI_CONFIG_REG_FILE * tmp = NULL;
+
+			files_size = files_size ? files_size * 2 : 16;
+			if ((tmp = realloc(files, files_size * sizeof(PKI_CONFIG_REG_FILE))) == NULL) {
+				PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+				break;
+			}
+			files = tmp;
+		}
+
+		f = &files[files_num];
+		memset(f, 0, sizeof(PKI_CONFIG_REG_FILE));
+
+		if (_config_stamp(fullpath, &f->stamp) != PKI_OK) continue;
+		if ((f->path = strdup(fullpath)) == NULL) continue;
+
+		// Unchanged files keep the name from the previous scan
+		for (i = 0; i < d->files_num; i++) {
+			if (d->files[i].path && strcmp(d->files[i].path, fullpath) == 0
+					&& _config_stamp_eq(&d->files[i].stamp, &f->stamp)) {
+				f->name = d->files[i].name;
+				d->files[i].name = NULL;
+				break;
+			}
+		}
+
+		if (i == d->files_num) {
+			// The parsed document is kept for the following load
+			if ((doc = _config_cache_get(fullpath, &f->stamp)) == NULL
+					&& (doc = _config_parse(fullpath)) != NULL) {
+				_config_cache_put(fullpath, &f->stamp, doc);
+			}
+			if (doc) f->name = PKI_CONFIG_get_value(doc, "/*/name");
+			PKI_DEBUG("Indexed %s (name: %s)", fullpath, f->name ? f->name : "none");
+		}
+
+		files_num++;
+	}
+	closedir(dirp);
+
+	_config_reg_files_free(d->files, d->files_num);
+	d->files = files;
+	d->files_num = files_num;
+	d->stale = 0;
+
+	_config_reg_index(d);
+
+	return PKI_OK;
+}
+
+// Returns the up-to-date registry entry for the directory (lock held)
+static PKI_CONFIG_REG_DIR * _config_reg_get(const char * path) {
+
+	PKI_CONFIG_REG_DIR * d = NULL;
+
+	_config_notify_process();
+
+	for (d = _config_registry; d != NULL; d = d->next) {
+		if (strcmp(d->path, path) == 0) break;
+	}
+
+	if (d == NULL) {
+
+		// Missing directories are not registered
+		if (access(path, R_OK | X_OK) != 0) return NULL;
+
+		// The registry outlives the request (not from the caller's arena)
+		if ((d = calloc(1, sizeof(PKI_CONFIG_REG_DIR))) == NULL
+				|| (d->path = strdup(path)) == NULL) {
+			if (d) free(d);
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			return NULL;
+		}
+		d->wd = PKI_CONFIG_NOTIFY_NONE;
+		d->stale = 1;
+		d->next = _config_registry;
+		_config_registry = d;
+
+	} else if (d->wd == PKI_CONFIG_NOTIFY_NONE && _config_reg_changed(d)) {
+		d->stale = 1;
+	}
+
+	if (d->stale && _config_reg_scan(d) != PKI_OK) {
+		// The directory went away, keeps an empty index
+		_config_reg_files_free(d->files, d->files_num);
+		d->files = NULL;
+		d->files_num = 0;
+		_config_reg_index(d);
+		return NULL;
+	}
+
+	return d;
+}
+
+/*!
+ * \brief Releases the cached configuration documents and the registry
+ *        of configuration directories.
+ *
+ * Following lookups scan the directories again. It is called by
+ * PKI_final_all().
+ */
+
+void PKI_CONFIG_cache_flush(void) {
+
+	PKI_CONFIG_REG_DIR * d = NULL;
+	int i = 0;
+
+	pthread_mutex_lock(&_config_lock);
+
+	for (i = 0; i < PKI_CONFIG_CACHE_SIZE; i++) {
+		if (_config_cache[i].path) {
+			xmlFreeDoc(_config_cache[i].doc);
+			free(_config_cache[i].path);
+		}
+		memset(&_config_cache[i], 0, sizeof(PKI_CONFIG_CACHE_ENTRY));
+	}
+
+	while ((d = _config_registry) != NULL) {
+		_config_registry = d->next;
+		_config_reg_files_free(d->files, d->files_num);
+		if (d->names) free(d->names);
+		free(d->path);
+		free(d);
+	}
+
+#ifdef HAVE_SYS_INOTIFY_H
+	// Closing the descriptor removes all the watches
+	if (_config_notify_fd >= 0) close(_config_notify_fd);
+#endif
+	_config_notify_fd = -1;
+
+	pthread_mutex_unlock(&_config_lock);
+}
+
 static char * _xml_search_namespace_add ( char *search ) {
 
 	char *my_search = NULL;
@@ -99,54 +615,59 @@ static char * _xml_search_namespace_add ( char *search ) {
 	return(ret);
 }
 
-/*! \brief Loads a PKI_CONFIG object (XML config file) */
+/*!
+ * \brief Loads a PKI_CONFIG object (XML config file)
+ *
+ * Parsed files are cached, loading the same (unmodified) file again
+ * returns a copy of the cached document instead of parsing it. The
+ * returned document is owned by the caller (see PKI_CONFIG_free()).
+ */
 
 PKI_CONFIG * PKI_CONFIG_load(const char *urlPath)
 {
-	FILE *file = NULL;
 	PKI_CONFIG *doc = NULL;
+	PKI_CONFIG *cached = NULL;
+	PKI_CONFIG_STAMP stamp;
 	URL *url = NULL;
-	xmlParserCtxt *parserCtxt = NULL;
 
 	LIBXML_TEST_VERSION
 
+	// Initializes the XML parser (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_XML);
+
 	if (urlPath) url = URL_new( urlPath );
   else return ( NULL );
 
 	// Let's check the URL was parsed correctly
-	if( !url || !url->addr ) return(PKI_ERR);
+	if( !url || !url->addr )
+	{
+		if (url) URL_free(url);
+		return(PKI_ERR);
+	}
 
-	if ((file = fopen(url->addr, "r")) == NULL)
+	if (_config_stamp(url->addr, &stamp) != PKI_OK)
 	{
 		URL_free(url);
 		return PKI_ERR;
 	}
-	fclose(file);
 
-	if ((parserCtxt = xmlNewParserCtxt()) == NULL )
+	// Checks for a cached copy of this version of the file
+	pthread_mutex_lock(&_config_lock);
+	if ((cached = _config_cache_get(url->addr, &stamp)) != NULL)
+		doc = xmlCopyDoc(cached, 1);
+	pthread_mutex_unlock(&_config_lock);
+
+	if (!doc && (doc = _config_parse(url->addr)) != NULL)
 	{
-		URL_free( url );
-		return(PKI_ERR);
+		// Keeps a copy for the following loads
+		if ((cached = xmlCopyDoc(doc, 1)) != NULL)
+		{
+			pthread_mutex_lock(&_config_lock);
+			_config_cache_put(url->addr, &stamp, cached);
+			pthread_mutex_unlock(&_config_lock);
+		}
 	}
 
-#if LIBXML_VERSION > LIBXML_MIN_VERSION
-	xmlSetStructuredErrorFunc( parserCtxt, logXmlMessages );
-#endif
-
-	/* Do not Keep Blank Nodes */
-	xmlKeepBlanksDefault(0);
-
-	/*parse the file and get the DOM */
-#if LIBXML_VERSION > LIBXML_MIN_VERSION
-	doc = (PKI_CONFIG *) xmlCtxtReadFile(parserCtxt, url->addr, NULL, 
-				XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING | 
-				XML_PARSE_NOENT );
-#else
-	doc = (PKI_CONFIG *) xmlCtxtReadFile(parserCtxt, url->addr, NULL, 0);
-#endif
-
-	// xmlClearParserCtxt ( parserCtxt );
-	xmlFreeParserCtxt ( parserCtxt );
 	URL_free(url);
 
 	return( doc );
@@ -654,15 +1175,19 @@ PKI_CONFIG_ELEMENT_STACK * PKI_CONFIG_get_element_children(PKI_CONFIG_ELEMENT *e
 /*!
  * \brief Returns a pointer to the filename of the configuration file that
           contains the configuration named 'name'.
+ *
+ * The directory is scanned once and its files are indexed (hashed) by
+ * their configuration name. The index is refreshed only when the directory
+ * or its files change (via inotify where available, otherwise by
+ * checking the files' modification times).
  */
 
 char * PKI_CONFIG_find(const char *dir, const char *name )
 {
-	struct dirent *dd = NULL;
-	DIR *dirp = NULL;
+	const PKI_CONFIG_REG_FILE *f = NULL;
+	PKI_CONFIG_REG_DIR *d = NULL;
 	URL *url = NULL;
 
-	int found = 0;
 	char *ret = NULL;
 
 	/* Check input */
@@ -681,88 +1206,75 @@ char * PKI_CONFIG_find(const char *dir, const char *name )
 	if (url->proto != URI_PROTO_FILE)
 	{
 		PKI_DEBUG("URL is not a file, skipping!", dir );
+		URL_free(url);
 		return (PKI_ERR);
 	}
 
-	if ((dirp = opendir(url->addr)) == NULL)
+	// Initializes the XML parser (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_XML);
+
+	pthread_mutex_lock(&_config_lock);
+
+	if ((d = _config_reg_get(url->addr)) != NULL)
 	{
-		PKI_DEBUG("Can not open directory [%s]", url->addr );
-		return (PKI_ERR);
+		if ((f = _config_reg_lookup(d, name)) != NULL)
+		{
+			ret = strdup(f->path);
+			PKI_DEBUG("Found %s in %s", name, f->path );
+		}
 	}
-	else
+	else PKI_DEBUG("Can not open directory [%s]", url->addr );
+
+	pthread_mutex_unlock(&_config_lock);
+
+	// Let's free the URL memory
+	URL_free(url);
+
+	return ret;
+}
+
+/*!
+ * \brief Returns a PKI_STACK with the names of the configurations in the
+ *        passed directory (NULL if the directory can not be accessed).
+ */
+
+PKI_STACK * PKI_CONFIG_get_names(const char *dir)
+{
+	PKI_CONFIG_REG_DIR *d = NULL;
+	PKI_STACK *ret = NULL;
+	URL *url = NULL;
+
+	int i = 0;
+
+	if (!dir) return NULL;
+
+	if ((url = URL_new(dir)) == NULL) return NULL;
+
+	if (url->proto != URI_PROTO_FILE)
 	{
-		while(( dd = readdir( dirp )) != NULL )
-		{
-			long len;
-			char *filename = NULL;
+		URL_free(url);
+		return NULL;
+	}
 
-			filename = dd->d_name;
-			len = (long) strlen( filename );
+	// Initializes the XML parser (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_XML);
 
-			PKI_DEBUG("Processing file [%s]", filename );
+	pthread_mutex_lock(&_config_lock);
 
-			if (len < 4 || strcmp(".xml", filename +len-4) != 0)
-			{
-				PKI_DEBUG("Skipping %s", filename );
-				continue;
-			}
-			else
-			{
-				char fullpath[BUFF_MAX_SIZE];
-				size_t fullsize = 0;
-
-				PKI_CONFIG *tmp_cfg = NULL;
-				char *tmp_name = NULL;
-
-				snprintf(fullpath, BUFF_MAX_SIZE,
-					"%s/%s", url->addr, filename );
-
-				PKI_DEBUG("Opening File %s", fullpath );
-
-				// Check the allowed size
-				fullsize = strlen(url->addr) + strlen( filename ) + 1;
-				if (fullsize > BUFF_MAX_SIZE) continue;
-				
-				if ((tmp_cfg = PKI_CONFIG_load(fullpath)) == NULL)
-				{
-					PKI_DEBUG("Can not load %s", fullpath );
-					continue;
-				}
-
-				PKI_DEBUG("Getting Name Param... ");
-				tmp_name = PKI_CONFIG_get_value(tmp_cfg, "/*/name");
-				PKI_CONFIG_free(tmp_cfg);
-
-				if (tmp_name != NULL)
-				{
-					PKI_DEBUG("Got Name::%s", tmp_name);
-					if (strcmp_nocase(tmp_name, name) == 0)
-					{
-						PKI_Free(tmp_name);
-						tmp_name = NULL; // Safety
-
-						found = 1;
-						ret = strdup(fullpath);
-						PKI_DEBUG("File successfully loaded %s", fullpath );
-						break;
-					}
-					PKI_Free(tmp_name);
-					tmp_name = NULL; // Safety
-				}
-				else PKI_DEBUG("No Name found!");
-			}
+	if ((d = _config_reg_get(url->addr)) != NULL
+			&& (ret = PKI_STACK_new(PKI_Free)) != NULL)
+	{
+		for (i = 0; i < d->files_num; i++)
+		{
+			if (d->files[i].name) PKI_STACK_push(ret, strdup(d->files[i].name));
 		}
-		closedir( dirp );
 	}
 
-	// Let's free the URL memory
-	if (url) URL_free(url);
+	pthread_mutex_unlock(&_config_lock);
 
-	// If found, let's return it
-	if (found == 1) return ret;
+	URL_free(url);
 
-	// If not found, we return NULL
-	return NULL;
+	return ret;
 }
 
 /*!
@@ -828,11 +1340,14 @@ char * PKI_CONFIG_find_all(const char *dir,
 PKI_CONFIG_STACK * PKI_CONFIG_load_dir(const char *dir,
 				       PKI_CONFIG_STACK *sk ) {
 
-        struct dirent *dd = NULL;
-	DIR *dirp = NULL;
+	PKI_CONFIG_REG_DIR *d = NULL;
+	PKI_STACK *paths = NULL;
 	URL *url = NULL;
 
+	char *path = NULL;
 	int found = 0;
+	int i = 0;
+
 	PKI_CONFIG_STACK *ret = NULL;
 
 	/* Check input */
@@ -847,70 +1362,69 @@ PKI_CONFIG_STACK * PKI_CONFIG_load_dir(const char *dir,
 
 	if( url->proto != URI_PROTO_FILE ) {
 		PKI_DEBUG( "Dir not valid for config (%s)", dir );
+		URL_free(url);
 		return (NULL);
 	}
 
-	if((dirp = opendir( url->addr )) == NULL ) {
+	// Initializes the XML parser (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_XML);
+
+	if ((paths = PKI_STACK_new(PKI_Free)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		URL_free(url);
+		return NULL;
+	}
+
+	// Gets the files from the directory index (scanned once)
+	pthread_mutex_lock(&_config_lock);
+	if ((d = _config_reg_get(url->addr)) != NULL) {
+		for (i = 0; i < d->files_num; i++)
+			PKI_STACK_push(paths, strdup(d->files[i].path));
+	}
+	pthread_mutex_unlock(&_config_lock);
+
+	if (d == NULL) {
 		PKI_log_err("Can not open dir %s!\n", url->addr );
+		PKI_STACK_free(paths);
+		URL_free(url);
 		return (NULL);
-	} else {
-
-		if( !sk ) {
-			if((ret = PKI_STACK_CONFIG_new()) == NULL ) {
-				PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
-				return NULL;
-			}
+	}
 
-		} else {
-			ret = sk;
+	if( !sk ) {
+		if((ret = PKI_STACK_CONFIG_new()) == NULL ) {
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			PKI_STACK_free_all(paths);
+			URL_free(url);
+			return NULL;
 		}
+	} else {
+		ret = sk;
+	}
 
-		while(( dd = readdir( dirp )) != NULL ) {
-			long len;
-			char *filename = NULL;
+	for (i = 0; i < PKI_STACK_elements(paths); i++) {
 
-			filename = dd->d_name;
-			len = (long) strlen( filename );
+		PKI_CONFIG *tmp_cfg = NULL;
 
-			if( (len < 4) || (strcmp( ".xml", filename +len -4 ))) {
-				PKI_DEBUG( "Skipping file %s", filename);
-				continue;
-			} else {
-			
-				char fullpath[BUFF_MAX_SIZE];
-				size_t fullsize = 0;
-
-				PKI_CONFIG *tmp_cfg = NULL;
-
-				PKI_DEBUG( "Loading file %s" LIBPKI_PATH_SEPARATOR "%s", 
-							url->addr, filename );
-
-				snprintf(fullpath, BUFF_MAX_SIZE,
-					"%s" LIBPKI_PATH_SEPARATOR "%s", url->addr, filename );
-
-				if ((fullsize = strlen(url->addr) + strlen(filename) + 1) > BUFF_MAX_SIZE) {
-					continue;
-				}
-				
-				if((tmp_cfg = PKI_CONFIG_load(fullpath)) == NULL) {
-					continue;
-				}
-
-				PKI_DEBUG( "Loaded %s file", fullpath );
-				PKI_STACK_CONFIG_push( ret, tmp_cfg );
-				found = 1;
-			}
+		path = PKI_STACK_get_num(paths, i);
+
+		// Parsed documents are served from the cache
+		if((tmp_cfg = PKI_CONFIG_load(path)) != NULL) {
+			PKI_DEBUG( "Loaded %s file", path );
+			PKI_STACK_CONFIG_push( ret, tmp_cfg );
+			found = 1;
 		}
-		closedir( dirp );
 	}
-	if( url ) URL_free (url);
+
+	PKI_STACK_free_all(paths);
+	URL_free (url);
 
 	if( found == 1 ) {
 		return (ret);
 	} else {
-		PKI_STACK_CONFIG_free( ret );
+		// Only frees the stack if it was allocated here
+		if (ret != sk) PKI_STACK_CONFIG_free( ret );
 		PKI_DEBUG("PKI_CONFIG_load_dir() Failed!\n" );
-		return ( NULL );
+		return ( sk );
 	}
 }
 
@@ -930,7 +1444,7 @@ PKI_CONFIG_STACK *PKI_CONFIG_load_all(const char * dir ) {
 	}
 
 	while( (name =  PKI_STACK_pop ( dir_list )) != NULL ) {
-		PKI_CONFIG_load_dir ( name, sk );
+		sk = PKI_CONFIG_load_dir ( name, sk );
 		PKI_Free ( name );
 	}
 
@@ -26,6 +26,7 @@ const PKI_ERR_ST __libpki_errors_st[] = {
 	{ PKI_ERR_POINTER_NULL, "Null Memory Pointer" },
 	{ PKI_ERR_PARAM_NULL, "Null Parameter" },
 	{ PKI_ERR_PARAM_TYPE, "Wrong Paramenter Type" },
+	{ PKI_ERR_PARAM_RANGE, "Parameter out of range" },
 	{ PKI_ERR_CALLBACK_NULL, "Missing or Null Callback" },
 	{ PKI_ERR_PKI_FORMAT_UNKNOW, "Unknow PKI Format" },
 	{ PKI_ERR_DATA_FORMAT_UNKNOWN, "Unknown Data Format" },
@@ -82,7 +83,9 @@ const PKI_ERR_ST __libpki_errors_st[] = {
 	/* Token Related */
 	{ PKI_ERR_TOKEN_INIT, "Can not initialize Token" },
 	{ PKI_ERR_TOKEN_LOGIN, "Error while logging into token" },
+	{ PKI_ERR_TOKEN_NOT_LOGGED_IN, "Token is not logged in" },
 	{ PKI_ERR_TOKEN_KEYPAIR_LOAD,  "Can not load Token Key" },
+	{ PKI_ERR_TOKEN_KEYPAIR_SET,  "Can not set Token Key" },
 	{ PKI_ERR_TOKEN_CERT_LOAD,  "Can not load Token certificate" },
 	{ PKI_ERR_TOKEN_CACERT_LOAD,  "Can not load Token CA certificate" },
 	{ PKI_ERR_TOKEN_OTHERCERTS_LOAD,  "Can not load Token other certificates" },
@@ -92,12 +95,20 @@ const PKI_ERR_ST __libpki_errors_st[] = {
 	{ PKI_ERR_TOKEN_PROFILE_LOAD, "Can not load Token's Profile" },
 	{ PKI_ERR_TOKEN_SET_ALGOR, "Error while setting Token's Algorithm" },
 	{ PKI_ERR_TOKEN_GET_ALGOR, "Error while retrieving Token's Algorithm" },
+	{ PKI_ERR_TOKEN_SET_STATUS, "Can not set Token's status" },
+	{ PKI_ERR_TOKEN_GET_STATUS, "Can not retrieve Token's status" },
 	{ PKI_ERR_TOKEN_,  "" },
 	/* Key Operations */
 	{ PKI_ERR_X509_KEYPAIR_SIZE, "Key Size Error" },
 	{ PKI_ERR_X509_KEYPAIR_SIZE_SHORT, "Key Size smaller than allowed minimum" },
 	{ PKI_ERR_X509_KEYPAIR_SIZE_LONG, "Key Size longer than supported maximum" },
 	{ PKI_ERR_X509_KEYPAIR_GENERATION, "Can not create new key material" },
+	{ PKI_ERR_X509_KEYPAIR_DECODE, "Can not decode key material" },
+	{ PKI_ERR_X509_KEYPAIR_ENCODE, "Can not encode key material" },
+	{ PKI_ERR_X509_KEYPAIR_ENCRYPT_INIT, "Can not initialize public key encryption" },
+	{ PKI_ERR_X509_KEYPAIR_ENCRYPT, "Error while encrypting with public key" },
+	{ PKI_ERR_X509_KEYPAIR_DECRYPT_INIT, "Can not initialize private key decryption" },
+	{ PKI_ERR_X509_KEYPAIR_DECRYPT, "Error while decrypting with private key" },
 	{ PKI_ERR_X509_KEYPAIR_, "" },
 	/* Certificate Operations */
 	{ PKI_ERR_X509_CERT_CREATE, "Can not create a certificate object" },
@@ -120,6 +131,12 @@ const PKI_ERR_ST __libpki_errors_st[] = {
 	{ PKI_ERR_X509_REQ_CREATE_ALGORITHM, "Can not set request Algorithm" },
 	{ PKI_ERR_X509_REQ_, "" },
 	/* CRL Errors */
+	{ PKI_ERR_X509_CRL_NUMBER, "Can not set the CRL number." },
+	{ PKI_ERR_X509_CRL_VERSION, "Can not set the CRL version." },
+	{ PKI_ERR_X509_CRL_REVOCATION_ENTRY, "Can not process the CRL revocation entry." },
+	{ PKI_ERR_X509_CRL_REVOCATION_ENTRY_DATE, "Can not set the CRL revocation entry date." },
+	{ PKI_ERR_X509_CRL_REVOCATION_ENTRY_REASON_CODE, "Can not set the CRL revocation entry reason code." },
+	{ PKI_ERR_X509_CRL_REVOCATION_ENTRY_EXTENSION, "Can not set the CRL revocation entry extension." },
 	{ PKI_ERR_X509_CRL_EXTENSION, "Can not set the requested extension in CRL." },
 	{ PKI_ERR_X509_CRL_, "" },
 	// PKI X509 PKCS7 ERRORS
@@ -142,6 +159,8 @@ const PKI_ERR_ST __libpki_errors_st[] = {
 	{ PKI_ERR_X509_CMS_RECIPIENT_ADD, "Cannot add the recipient to the CMS." },
 	{ PKI_ERR_X509_CMS_RECIPIENT_GET, "Cannot retrieve the recipient from the CMS." },
 	{ PKI_ERR_X509_CMS_SET_DETACHED, "Cannot set the detached status for the CMS."},
+	{ PKI_ERR_X509_CMS_VERIFY, "Cannot verify the CMS signatures." },
+	{ PKI_ERR_X509_CMS_DECRYPT, "Cannot decrypt the CMS content." },
 	{ PKI_ERR_X509_CMS_, "" },
 	// Generic PKI_X509_AUX_DATA Errors
 	{ PKI_ERR_X509_AUX_DATA_MEMORY_FREE_CB_NULL, "Missing AUX Data free callback function" },
@@ -200,47 +219,458 @@ static const int __libpki_err_size = sizeof ( __libpki_errors_st ) / sizeof ( PK
 /* Pointer to the Error Stack */
 PKI_STACK *pki_err_stack = NULL;
 
-/*!
- * \brief Set and logs library errors
- */
-#pragma GCC diagnostic ignored "-Wuninitialized"
-int __pki_error ( const char *file, int line, int err, const char *info, ... ) {
- 
-	int i, found;
-	PKI_ERR_ST *curr = NULL;
-	char fmt[2048];
+/* Code to Description Index (built once from __libpki_errors_st) */
+static const char * _pki_err_descr_idx[PKI_ERR_CODE_SIZE];
+static pthread_once_t _pki_err_descr_once = PTHREAD_ONCE_INIT;
 
-	va_list ap;
+/* Per-thread Error Queue */
+typedef struct pki_err_queue_st {
+	/* Ring of entries */
+	PKI_ERR_ENTRY entries[PKI_ERR_QUEUE_SIZE];
+
+	/* Position of the oldest entry */
+	unsigned int head;
+
+	/* Number of entries in the queue */
+	unsigned int count;
+} PKI_ERR_QUEUE;
+
+static __thread PKI_ERR_QUEUE _pki_err_queue;
+
+/* Errors are logged by default (if the log level allows it) */
+static int _pki_err_log_enabled = 1;
+
+/* Arguments of the detail format conversions */
+enum {
+	PKI_ERR_ARG_NONE = 0,
+	PKI_ERR_ARG_INT,
+	PKI_ERR_ARG_LONG,
+	PKI_ERR_ARG_LLONG,
+	PKI_ERR_ARG_SIZE,
+	PKI_ERR_ARG_INTMAX,
+	PKI_ERR_ARG_PTRDIFF,
+	PKI_ERR_ARG_DOUBLE,
+	PKI_ERR_ARG_STR,
+	PKI_ERR_ARG_PTR,
+	// Not kept (formatted when the error is raised)
+	PKI_ERR_ARG_UNSUPPORTED
+};
+
+/* Conversion of the detail format */
+typedef struct pki_err_conv_st {
+	/* Length of the conversion */
+	size_t len;
+	/* Argument type */
+	int type;
+	/* Number of '*' (int arguments before the value) */
+	int stars;
+	/* Precision (-1 if none, -2 if given by a '*') */
+	int prec;
+} PKI_ERR_CONV;
+
+static void _pki_err_descr_idx_init(void) {
+
+	int i = 0;
+
+	for (i = 0; i < __libpki_err_size; i++) {
+
+		const PKI_ERR_ST * curr = &__libpki_errors_st[i];
+
+		if (!curr->descr) continue;
+		if (curr->code < 0 || curr->code >= PKI_ERR_CODE_SIZE) continue;
+
+		_pki_err_descr_idx[curr->code] = curr->descr;
+	}
+}
 
-	found = -1;
-	for ( i = 0; i < __libpki_err_size ; i++ ) 
-	{
-		curr = (PKI_ERR_ST *) &__libpki_errors_st[i];
-
-		if ( ( curr ) && ( curr->code == err ) ) 
-		{
-			found = i;
-			if ( !curr->descr ) break;
-
-			if ( info == NULL ) {
-				snprintf(fmt, sizeof(fmt), "[%s:%d] %s (%d):", file, line, curr->descr, curr->code);
-				PKI_log_err_simple(fmt, NULL);
-			} else {
-				snprintf(fmt, sizeof(fmt), "[%s:%d] %s (%d): %s", file, line, curr->descr, curr->code, info );
-				PKI_log_err_simple( fmt, ap);
+// Parses the conversion at fmt (a '%')
+static void _pki_err_conv(const char * fmt, PKI_ERR_CONV * conv) {
+
+	size_t i = 1;
+	int mod = 0;
+
+	conv->type = PKI_ERR_ARG_UNSUPPORTED;
+	conv->stars = 0;
+	conv->prec = -1;
+
+	if (fmt[i] == '%') {
+		conv->type = PKI_ERR_ARG_NONE;
+		conv->len = 2;
+		return;
+	}
+
+	// Flags, width and precision
+	while (fmt[i] && strchr("-+ #0", fmt[i])) i++;
+	if (fmt[i] == '*') {
+		conv->stars++;
+		i++;
+	} else while (isdigit((unsigned char) fmt[i])) i++;
+	if (fmt[i] == '.') {
+		i++;
+		if (fmt[i] == '*') {
+			conv->stars++;
+			conv->prec = -2;
+			i++;
+		} else {
+			conv->prec = 0;
+			while (isdigit((unsigned char) fmt[i]))
+				conv->prec = conv->prec * 10 + (fmt[i++] - '0');
+		}
+	}
+
+	// Length modifier
+	switch (fmt[i]) {
+		case 'h': i++; if (fmt[i] == 'h') i++; break;
+		case 'l': i++; mod = 'l'; if (fmt[i] == 'l') { i++; mod = 'q'; } break;
+		case 'z': case 'j': case 't': mod = fmt[i++]; break;
+	}
+
+	conv->len = fmt[i] ? i + 1 : i;
+
+	switch (fmt[i]) {
+		case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+			switch (mod) {
+				case 'l': conv->type = PKI_ERR_ARG_LONG; break;
+				case 'q': conv->type = PKI_ERR_ARG_LLONG; break;
+				case 'z': conv->type = PKI_ERR_ARG_SIZE; break;
+				case 'j': conv->type = PKI_ERR_ARG_INTMAX; break;
+				case 't': conv->type = PKI_ERR_ARG_PTRDIFF; break;
+				default: conv->type = PKI_ERR_ARG_INT;
 			}
+			break;
+		case 'c':
+			if (!mod) conv->type = PKI_ERR_ARG_INT;
+			break;
+		case 'e': case 'E': case 'f': case 'F':
+		case 'g': case 'G': case 'a': case 'A':
+			if (!mod || mod == 'l') conv->type = PKI_ERR_ARG_DOUBLE;
+			break;
+		case 's':
+			if (!mod) conv->type = PKI_ERR_ARG_STR;
+			break;
+		case 'p':
+			if (!mod) conv->type = PKI_ERR_ARG_PTR;
+			break;
+	}
+}
+
+// Keeps the arguments of the detail format in the entry, the strings
+// are copied in the detail. Returns 0 if the format is not supported
+static int _pki_err_args_keep(PKI_ERR_ENTRY * e, const char * fmt, va_list ap) {
 
+	PKI_ERR_CONV conv;
+	const char * f = fmt;
+	const char * s = NULL;
+	size_t used = 0, len = 0;
+	int num = 0, j = 0, ok = 1;
+	va_list cp;
+
+	va_copy(cp, ap);
+
+	while (ok && *f) {
+
+		if (*f != '%') {
+			f++;
+			continue;
+		}
+
+		_pki_err_conv(f, &conv);
+		f += conv.len;
+
+		if (conv.type == PKI_ERR_ARG_UNSUPPORTED
+				|| num + conv.stars + 1 > PKI_ERR_ARGS_SIZE) {
+			ok = 0;
 			break;
 		}
+
+		for (j = 0; j < conv.stars; j++) e->args[num++].i = va_arg(cp, int);
+		if (conv.prec == -2) conv.prec = e->args[num - 1].i;
+
+		switch (conv.type) {
+			case PKI_ERR_ARG_INT: e->args[num++].i = va_arg(cp, int); break;
+			case PKI_ERR_ARG_LONG: e->args[num++].l = va_arg(cp, long); break;
+			case PKI_ERR_ARG_LLONG: e->args[num++].ll = va_arg(cp, long long); break;
+			case PKI_ERR_ARG_SIZE: e->args[num++].z = va_arg(cp, size_t); break;
+			case PKI_ERR_ARG_INTMAX: e->args[num++].j = va_arg(cp, intmax_t); break;
+			case PKI_ERR_ARG_PTRDIFF: e->args[num++].t = va_arg(cp, ptrdiff_t); break;
+			case PKI_ERR_ARG_DOUBLE: e->args[num++].d = va_arg(cp, double); break;
+			case PKI_ERR_ARG_PTR: e->args[num++].p = va_arg(cp, void *); break;
+			case PKI_ERR_ARG_STR:
+				// The string is kept at its offset in the detail
+				if ((s = va_arg(cp, const char *)) == NULL) s = "(null)";
+				if (used >= sizeof(e->detail)) {
+					ok = 0;
+					break;
+				}
+				len = conv.prec >= 0 ? strnlen(s, (size_t) conv.prec) : strlen(s);
+				if (len > sizeof(e->detail) - used - 1) len = sizeof(e->detail) - used - 1;
+				memcpy(e->detail + used, s, len);
+				e->detail[used + len] = '\0';
+				e->args[num++].z = used;
+				used += len + 1;
+				break;
+		}
+	}
+
+	va_end(cp);
+
+	e->fmt = ok ? fmt : NULL;
+
+	return ok;
+}
+
+// Formats the detail of the entry (if not formatted yet)
+static void _pki_err_detail_format(PKI_ERR_ENTRY * e) {
+
+	PKI_ERR_CONV conv;
+	char out[PKI_ERR_DETAIL_SIZE];
+	char spec[64];
+	const char * fmt = e->fmt;
+	size_t len = 0, k = 0, i = 0;
+	int num = 0, j = 0, n = 0;
+
+	if (!fmt) return;
+
+	while (*fmt && len < sizeof(out) - 1) {
+
+		if (*fmt != '%') {
+			out[len++] = *fmt++;
+			continue;
+		}
+
+		_pki_err_conv(fmt, &conv);
+
+		// Copies the conversion with the '*' replaced by their values
+		for (i = 0, k = 0, j = 0; i < conv.len && k < sizeof(spec) - 12; i++) {
+			if (fmt[i] == '*') k += (size_t) snprintf(spec + k, sizeof(spec) - k, "%d", e->args[num + j++].i);
+			else spec[k++] = fmt[i];
+		}
+		spec[k] = '\0';
+		num += conv.stars;
+		fmt += conv.len;
+
+		switch (conv.type) {
+			case PKI_ERR_ARG_NONE: out[len++] = '%'; n = 0; break;
+			case PKI_ERR_ARG_INT: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].i); break;
+			case PKI_ERR_ARG_LONG: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].l); break;
+			case PKI_ERR_ARG_LLONG: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].ll); break;
+			case PKI_ERR_ARG_SIZE: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].z); break;
+			case PKI_ERR_ARG_INTMAX: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].j); break;
+			case PKI_ERR_ARG_PTRDIFF: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].t); break;
+			case PKI_ERR_ARG_DOUBLE: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].d); break;
+			case PKI_ERR_ARG_PTR: n = snprintf(out + len, sizeof(out) - len, spec, e->args[num++].p); break;
+			case PKI_ERR_ARG_STR: n = snprintf(out + len, sizeof(out) - len, spec, e->detail + e->args[num++].z); break;
+			default: n = 0;
+		}
+
+		if (n < 0) break;
+		len += (size_t) n;
+		if (len > sizeof(out) - 1) len = sizeof(out) - 1;
 	}
 
-	if ( found < 0 ) err = PKI_ERR_UNKNOWN;
+	out[len] = '\0';
+	memcpy(e->detail, out, len + 1);
+	e->fmt = NULL;
+}
+
+/*!
+ * \brief Returns the description of an error code (or NULL)
+ */
+const char * PKI_ERR_get_descr(PKI_ERR_CODE code) {
+
+	if (code < 0 || code >= PKI_ERR_CODE_SIZE) return NULL;
+
+	pthread_once(&_pki_err_descr_once, _pki_err_descr_idx_init);
+
+	return _pki_err_descr_idx[code];
+}
+
+/*!
+ * \brief Returns the detail message of an error entry (or NULL)
+ */
+const char * PKI_ERR_ENTRY_get_detail(const PKI_ERR_ENTRY * entry) {
+
+	if (!entry || entry->detail[0] == '\0') return NULL;
+
+	return entry->detail;
+}
+
+/*!
+ * \brief Enables (!0) or disables (0) logging of library errors
+ */
+void PKI_ERR_set_log(int enabled) {
+	__atomic_store_n(&_pki_err_log_enabled, enabled, __ATOMIC_RELAXED);
+}
+
+static PKI_ERR_CODE _pki_err_entry_return(PKI_ERR_ENTRY * e,
+						PKI_ERR_ENTRY * entry) {
+
+	if (entry) {
+		_pki_err_detail_format(e);
+		memcpy(entry, e, sizeof(PKI_ERR_ENTRY));
+	}
+
+	return e->code;
+}
+
+/*!
+ * \brief Removes the oldest error from the calling thread's queue
+ *
+ * If entry is not NULL, the details of the error are copied
+ * into it. Returns PKI_ERR_NONE if the queue is empty.
+ */
+PKI_ERR_CODE PKI_ERR_get(PKI_ERR_ENTRY * entry) {
+
+	PKI_ERR_QUEUE * q = &_pki_err_queue;
+	PKI_ERR_ENTRY * e = NULL;
+
+	if (q->count == 0) return PKI_ERR_NONE;
+
+	e = &q->entries[q->head];
+
+	q->head = (q->head + 1) % PKI_ERR_QUEUE_SIZE;
+	q->count--;
+
+	return _pki_err_entry_return(e, entry);
+}
+
+/*!
+ * \brief Returns the oldest error without removing it from the queue
+ */
+PKI_ERR_CODE PKI_ERR_peek(PKI_ERR_ENTRY * entry) {
+
+	PKI_ERR_QUEUE * q = &_pki_err_queue;
+
+	if (q->count == 0) return PKI_ERR_NONE;
+
+	return _pki_err_entry_return(&q->entries[q->head], entry);
+}
+
+/*!
+ * \brief Returns the most recent error without removing it from the queue
+ */
+PKI_ERR_CODE PKI_ERR_peek_last(PKI_ERR_ENTRY * entry) {
+
+	PKI_ERR_QUEUE * q = &_pki_err_queue;
+
+	if (q->count == 0) return PKI_ERR_NONE;
+
+	return _pki_err_entry_return(
+		&q->entries[(q->head + q->count - 1) % PKI_ERR_QUEUE_SIZE], entry);
+}
+
+/*!
+ * \brief Returns the number of errors in the calling thread's queue
+ */
+int PKI_ERR_count(void) {
+	return (int) _pki_err_queue.count;
+}
+
+/*!
+ * \brief Removes all the errors from the calling thread's queue
+ */
+void PKI_ERR_clear(void) {
+	_pki_err_queue.head = 0;
+	_pki_err_queue.count = 0;
+}
+
+/*!
+ * \brief Set and logs library errors
+ *
+ * The error is added to the calling thread's queue (when the queue
+ * is full, the oldest entry is dropped) and logged only when error
+ * logging is enabled. The info string is always copied in the entry,
+ * it is used as a format only when has_args is not zero (as set by
+ * the PKI_ERROR() macro). The detail is formatted when the error is
+ * read or logged, the format is kept when lazy is not zero (it must
+ * be a string literal) and its arguments are supported.
+ */
+static int _pki_error_va ( const char *file, int line, int err,
+			int has_args, int lazy, const char *info, va_list ap ) {
+
+	PKI_ERR_QUEUE * q = &_pki_err_queue;
+	PKI_ERR_ENTRY * e = NULL;
+	const char * descr = NULL;
+
+	// Unknown codes are reported as such
+	if ((descr = PKI_ERR_get_descr(err)) == NULL) {
+		err = PKI_ERR_UNKNOWN;
+		descr = PKI_ERR_get_descr(err);
+	}
+
+	// Gets the next free slot (overwrites the oldest if full)
+	if (q->count == PKI_ERR_QUEUE_SIZE) {
+		q->head = (q->head + 1) % PKI_ERR_QUEUE_SIZE;
+		q->count--;
+	}
+	e = &q->entries[(q->head + q->count) % PKI_ERR_QUEUE_SIZE];
+	q->count++;
+
+	e->code = err;
+	e->file = file;
+	e->line = line;
+	e->detail[0] = '\0';
+	e->fmt = NULL;
+
+	// The caller's string might not outlive the entry, we keep a copy
+	if (info && has_args) {
+		if (!lazy || !_pki_err_args_keep(e, info, ap))
+			vsnprintf(e->detail, sizeof(e->detail), info, ap);
+	} else if (info) {
+		size_t len = strnlen(info, sizeof(e->detail) - 1);
+
+		memcpy(e->detail, info, len);
+		e->detail[len] = '\0';
+	}
+
+	// Logs the error, if enabled
+	if (__atomic_load_n(&_pki_err_log_enabled, __ATOMIC_RELAXED)
+			&& PKI_log_is_enabled(PKI_LOG_ERR)) {
+
+		const char * detail = NULL;
+
+		_pki_err_detail_format(e);
+		detail = PKI_ERR_ENTRY_get_detail(e);
+
+		if (detail) {
+			PKI_log_err_simple("[%s:%d] %s (%d): %s", file, line,
+				descr ? descr : "", err, detail);
+		} else {
+			PKI_log_err_simple("[%s:%d] %s (%d):", file, line,
+				descr ? descr : "", err);
+		}
+	}
 
 	return ( PKI_ERR );
 }
 
-#ifndef LIBPKI_TARGET_OSX
-# ifdef HAVE_GCC_PRAGMA_POP
-#  pragma GCC diagnostic pop
-# endif
-#endif
+int __pki_error_ex ( const char *file, int line, int err, int has_args,
+			const char *info, ... ) {
+
+	int ret = PKI_ERR;
+	va_list ap;
+
+	va_start(ap, info);
+	ret = _pki_error_va(file, line, err, has_args, 1, info, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+/*!
+ * \brief Set and logs library errors (callers built before PKI_ERROR()
+ *        used __pki_error_ex, the info is a format if it has a '%' and
+ *        it is formatted right away since it might not be a literal)
+ */
+int __pki_error ( const char *file, int line, int err, const char *info, ... ) {
+
+	int ret = PKI_ERR;
+	va_list ap;
+
+	va_start(ap, info);
+	ret = _pki_error_va(file, line, err,
+		info && strchr(info, '%') != NULL, 0, info, ap);
+	va_end(ap);
+
+	return ret;
+}
@@ -56,6 +56,9 @@ const long LIBPKI_OS_DETAILS = LIBPKI_OS_CLASS |
 static int _libpki_init = 0;
 static int _libpki_fips_mode = 0;
 
+// One-time initialization control for the core library
+static pthread_once_t _libpki_init_once = PTHREAD_ONCE_INIT;
+
 // Composite Methods
 extern EVP_PKEY_ASN1_METHOD composite_asn1_meth;
 extern EVP_PKEY_METHOD composite_pkey_meth;
@@ -108,85 +111,104 @@ static int _init_combined() {
 }
 #endif
 
-/*!
- * \brief Initialize libpki internal structures.
- */
-int PKI_init_all( void ) {
-
-	// Initialize OpenSSL so that it adds all 
-	// the needed algor and digest
-	if( _libpki_init == 0 ) {
-
-		// Enables Logging/Debugging during init
-		PKI_log_init (PKI_LOG_TYPE_STDERR, PKI_LOG_INFO,
-					  NULL,
-                      PKI_LOG_FLAGS_ENABLE_DEBUG,
-					  NULL );
-
-		// OpenSSL init
-		X509V3_add_standard_extensions();
-		OpenSSL_add_all_algorithms();
-		OpenSSL_add_all_digests();
-		OpenSSL_add_all_ciphers();
+// ==============================
+// Lazy Subsystems Initialization
+// ==============================
+
+static void _init_subsystem_providers(void);
+static void _init_subsystem_pqc(void);
+static void _init_subsystem_composite(void);
+static void _init_subsystem_prqp(void);
+static void _init_subsystem_scep(void);
+static void _init_subsystem_xml(void);
+static void _init_subsystem_mysql(void);
+
+typedef struct pki_init_subsystem_st {
+	// Name of the subsystem (for debugging)
+	const char * name;
+	// Initialization function (called only once)
+	void (*init)(void);
+	// One-time initialization control
+	pthread_once_t once;
+	// Status (set with release semantics when done)
+	int status;
+} PKI_INIT_SUBSYSTEM_ENTRY;
+
+// Indexed by PKI_INIT_SUBSYSTEM
+static PKI_INIT_SUBSYSTEM_ENTRY _libpki_subsystems[PKI_INIT_SUBSYSTEM_SIZE] = {
+	{ "providers", _init_subsystem_providers, PTHREAD_ONCE_INIT, 0 },
+	{ "pqc", _init_subsystem_pqc, PTHREAD_ONCE_INIT, 0 },
+	{ "composite", _init_subsystem_composite, PTHREAD_ONCE_INIT, 0 },
+	{ "prqp", _init_subsystem_prqp, PTHREAD_ONCE_INIT, 0 },
+	{ "scep", _init_subsystem_scep, PTHREAD_ONCE_INIT, 0 },
+	{ "xml", _init_subsystem_xml, PTHREAD_ONCE_INIT, 0 },
+	{ "mysql", _init_subsystem_mysql, PTHREAD_ONCE_INIT, 0 },
+};
 
-		// Pthread Initialization
-		OpenSSL_pthread_init();
+#define _SUBSYSTEM_DONE(id) \
+	__atomic_store_n(&_libpki_subsystems[id].status, 1, __ATOMIC_RELEASE)
 
-		// Initializes the SSL layer
-		SSL_library_init();
+static void _init_subsystem_providers(void) {
 
-#if OPENSSL_VERSION_NUMBER < 0x30000000
-		ERR_load_ERR_strings();
-		ERR_load_crypto_strings();
+#if OPENSSL_VERSION_NUMBER >= 0x3000000fL
+	// Loads the default, legacy (and OQS) providers
+	PKI_init_providers();
 #endif
 
-		// Parser for Config files
-		xmlInitParser();
+	_SUBSYSTEM_DONE(PKI_INIT_SUBSYSTEM_PROVIDERS);
+}
 
-		// Initializes the OID layer
-		PKI_X509_OID_init();
+static void _init_subsystem_pqc(void) {
 
-		// PKI Discovery Services
-		PRQP_init_all_services();
+#ifdef ENABLE_OQS
+	// Post-Quantum Crypto Implementation
+	PKI_PQC_init();
+#endif
 
-		// SCEP Init
-		PKI_X509_SCEP_init();
+	_SUBSYSTEM_DONE(PKI_INIT_SUBSYSTEM_PQC);
+}
 
-#if OPENSSL_VERSION_NUMBER >= 0x3000000fL
-		// Initializes the OQS Provider layer
-		PKI_init_providers();
-#endif
+static void _init_subsystem_composite(void) {
 
-#ifdef ENABLE_OQS
-		// Post-Quantum Crypto Implementation
-		PKI_PQC_init();
-#endif
 #ifdef ENABLE_COMPOSITE
-		// Generic Composite Crypto (both AND and OR)
-		PKI_COMPOSITE_init();
-		// // Explicit Composite Crypto
-		PKI_EXPLICIT_COMPOSITE_init();
+	// Generic Composite Crypto (both AND and OR)
+	PKI_COMPOSITE_init();
+	// // Explicit Composite Crypto
+	PKI_EXPLICIT_COMPOSITE_init();
 #endif
 #ifdef ENABLE_COMBINED
-		// Multikey Crypto (multi-keys OR)
-		_init_combined();
+	// Multikey Crypto (multi-keys OR)
+	_init_combined();
 #endif
-	}
 
-	/* Enable Proxy Certificates Support */
-	PKI_set_env( "OPENSSL_ALLOW_PROXY", "1");
+	_SUBSYSTEM_DONE(PKI_INIT_SUBSYSTEM_COMPOSITE);
+}
 
-	/* Set the initialization bit */
-	_libpki_init = 1;
+static void _init_subsystem_prqp(void) {
 
-	/* Check Application and LibPKI coherence */
-	if ((LIBPKI_OS_CLASS | LIBPKI_OS_BITS | LIBPKI_OS_VENDOR ) !=
-							LIBPKI_OS_DETAILS ) {
-		PKI_log_err ("WARNING::LibPKI and Application OS details are "
-				"different [%d/%d]", LIBPKI_OS_DETAILS,
-				LIBPKI_OS_CLASS | LIBPKI_OS_BITS | 
-					LIBPKI_OS_VENDOR);
-	}
+	// PKI Discovery Services
+	PRQP_init_all_services();
+
+	_SUBSYSTEM_DONE(PKI_INIT_SUBSYSTEM_PRQP);
+}
+
+static void _init_subsystem_scep(void) {
+
+	// SCEP Attributes
+	PKI_X509_SCEP_init();
+
+	_SUBSYSTEM_DONE(PKI_INIT_SUBSYSTEM_SCEP);
+}
+
+static void _init_subsystem_xml(void) {
+
+	// Parser for Config files
+	xmlInitParser();
+
+	_SUBSYSTEM_DONE(PKI_INIT_SUBSYSTEM_XML);
+}
+
+static void _init_subsystem_mysql(void) {
 
 #ifdef HAVE_MYSQL
 	/* MySQL Initialization */
@@ -198,6 +220,118 @@ int PKI_init_all( void ) {
 	}
 #endif
 
+	_SUBSYSTEM_DONE(PKI_INIT_SUBSYSTEM_MYSQL);
+}
+
+/*!
+ * \brief Initializes (once) one of the lazily loaded subsystems
+ *
+ * The first caller runs the subsystem initialization while concurrent
+ * callers wait for it to complete. After that, the call costs a single
+ * atomic load.
+ */
+int PKI_init_subsystem(PKI_INIT_SUBSYSTEM id) {
+
+	PKI_INIT_SUBSYSTEM_ENTRY * entry = NULL;
+	PKI_ARENA * arena = NULL;
+
+	// Input Checks
+	if (id < 0 || id >= PKI_INIT_SUBSYSTEM_SIZE) {
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Unknown subsystem (%d)", id);
+	}
+
+	entry = &_libpki_subsystems[id];
+
+	// Fast Path: the subsystem is already up
+	if (__builtin_expect(__atomic_load_n(&entry->status, __ATOMIC_ACQUIRE), 1))
+		return PKI_OK;
+
+	// Makes sure the core is initialized first
+	PKI_init_all();
+
+	// Runs the initialization only once (global data is not
+	// allocated from the caller's arena)
+	arena = PKI_ARENA_suspend();
+	pthread_once(&entry->once, entry->init);
+	PKI_ARENA_resume(arena);
+
+	// All Done
+	return PKI_OK;
+}
+
+/*!
+ * \brief Returns PKI_STATUS_INIT if the subsystem has been initialized
+ */
+int PKI_get_subsystem_status(PKI_INIT_SUBSYSTEM id) {
+
+	if (id < 0 || id >= PKI_INIT_SUBSYSTEM_SIZE) return PKI_STATUS_NOT_INIT;
+
+	if (__atomic_load_n(&_libpki_subsystems[id].status, __ATOMIC_ACQUIRE))
+		return PKI_STATUS_INIT;
+
+	return PKI_STATUS_NOT_INIT;
+}
+
+/*!
+ * \brief Loads the crypto providers and the PQC/Composite methods
+ *
+ * Key generation, parsing, and signature operations need the
+ * dynamically registered methods, this function makes sure they
+ * are available before the first use.
+ */
+int PKI_init_crypto_methods(void) {
+
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PROVIDERS);
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PQC);
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_COMPOSITE);
+
+	return PKI_OK;
+}
+
+// ===================
+// Core Initialization
+// ===================
+
+static void _init_core(void) {
+
+	// Enables Logging/Debugging during init
+	PKI_log_init (PKI_LOG_TYPE_STDERR, PKI_LOG_INFO,
+				  NULL,
+                  PKI_LOG_FLAGS_ENABLE_DEBUG,
+				  NULL );
+
+	// OpenSSL init
+	X509V3_add_standard_extensions();
+	OpenSSL_add_all_algorithms();
+	OpenSSL_add_all_digests();
+	OpenSSL_add_all_ciphers();
+
+	// Pthread Initialization
+	OpenSSL_pthread_init();
+
+	// Initializes the SSL layer
+	SSL_library_init();
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000
+	ERR_load_ERR_strings();
+	ERR_load_crypto_strings();
+#endif
+
+	// Initializes the OID layer
+	PKI_X509_OID_init();
+
+	/* Enable Proxy Certificates Support */
+	PKI_set_env( "OPENSSL_ALLOW_PROXY", "1");
+
+	/* Check Application and LibPKI coherence */
+	if ((LIBPKI_OS_CLASS | LIBPKI_OS_BITS | LIBPKI_OS_VENDOR ) !=
+							LIBPKI_OS_DETAILS ) {
+		PKI_log_err ("WARNING::LibPKI and Application OS details are "
+				"different [%d/%d]", LIBPKI_OS_DETAILS,
+				LIBPKI_OS_CLASS | LIBPKI_OS_BITS | 
+					LIBPKI_OS_VENDOR);
+	}
+
 	/* If FIPS mode is available, let's enforce it by default */
 	/*
 	if (!PKI_set_fips_mode(1))
@@ -208,6 +342,33 @@ int PKI_init_all( void ) {
 	}
 	*/
 
+	/* Set the initialization bit */
+	__atomic_store_n(&_libpki_init, 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ * \brief Initialize libpki internal structures.
+ *
+ * The core initialization is executed only once, subsequent calls
+ * only cost an atomic load. Providers, PQC and Composite methods,
+ * PRQP services, SCEP attributes, the XML parser, and the MySQL
+ * client library are initialized on first use (see
+ * PKI_init_subsystem()).
+ */
+int PKI_init_all( void ) {
+
+	PKI_ARENA * arena = NULL;
+
+	// Fast Path: the library is already initialized
+	if (__builtin_expect(__atomic_load_n(&_libpki_init, __ATOMIC_ACQUIRE), 1))
+		return PKI_OK;
+
+	// Initialize OpenSSL so that it adds all 
+	// the needed algor and digest (not from the caller's arena)
+	arena = PKI_ARENA_suspend();
+	pthread_once(&_libpki_init_once, _init_core);
+	PKI_ARENA_resume(arena);
+
 	return ( PKI_OK );
 }
 
@@ -217,9 +378,14 @@ int PKI_init_all( void ) {
 
 void PKI_final_all( void )
 {
-	if ( _libpki_init != 0)
+	if ( __atomic_load_n(&_libpki_init, __ATOMIC_ACQUIRE) != 0)
 	{
-		xmlCleanupParser();
+		if (PKI_get_subsystem_status(PKI_INIT_SUBSYSTEM_XML) == PKI_STATUS_INIT) {
+			PKI_CONFIG_cache_flush();
+			xmlCleanupParser();
+		}
+		// Stops the PRQP refresh thread before the crypto cleanup
+		PKI_PRQP_CACHE_flush();
 		ERR_free_strings();
 		EVP_cleanup();
 		OpenSSL_pthread_cleanup();
@@ -227,8 +393,17 @@ void PKI_final_all( void )
 		EVP_cleanup();
 		CRYPTO_cleanup_all_ex_data();
 		PKI_cleanup_providers();
+		// Closes the pooled DB connections
+		URL_pg_pool_flush();
+		URL_ldap_pool_flush();
+		URL_mysql_pool_flush();
+		// Releases the cached remote objects
+		URL_CACHE_flush();
+		// Releases the interned names
+		PKI_X509_NAME_intern_flush();
 #if HAVE_MYSQL
-		mysql_library_end();
+		if (PKI_get_subsystem_status(PKI_INIT_SUBSYSTEM_MYSQL) == PKI_STATUS_INIT)
+			mysql_library_end();
 #endif
 	}
 }
@@ -278,7 +453,7 @@ int PKI_is_fips_mode()
 
 int PKI_get_init_status ( void ) {
 
-	if( _libpki_init == 0 ) {
+	if( __atomic_load_n(&_libpki_init, __ATOMIC_ACQUIRE) == 0 ) {
 		return PKI_STATUS_NOT_INIT;
 	}
 
@@ -317,14 +492,14 @@ PKI_STACK * PKI_list_all_tokens ( char *dir ) {
 
 PKI_STACK * PKI_list_all_tokens_dir ( char * dir, PKI_STACK *list ) {
 
-        struct dirent *dd = NULL;
-	DIR *dirp = NULL;
+	PKI_STACK *names = NULL;
 	URL *url = NULL;
 
 	char *token_dir = NULL;
 	size_t token_dir_size = 0;
 
 	PKI_STACK *ret = NULL;
+	int i = 0;
 
 	if( !dir ) return ( NULL );
 
@@ -355,63 +530,32 @@ PKI_STACK * PKI_list_all_tokens_dir ( char * dir, PKI_STACK *list ) {
 
 	PKI_log_debug("PKI_list_all_tokens_dir()::Opening dir %s", token_dir);
 
-	if((dirp = opendir( token_dir )) == NULL ) {
+	// The configuration names come from the directory index
+	if((names = PKI_CONFIG_get_names( token_dir )) == NULL ) {
 
 		snprintf( token_dir, token_dir_size, "%s", url->addr );
 
 		PKI_log_debug("PKI_list_all_tokens_dir()::Opening dir %s", token_dir);
-		if((dirp = opendir( token_dir)) == NULL ) {
+		if((names = PKI_CONFIG_get_names( token_dir )) == NULL ) {
 			if( url ) URL_free (url );
 			if( token_dir ) PKI_Free ( token_dir );
 			return ( ret );
 		}
 	}
 
-	while(( dd = readdir( dirp )) != NULL ) {
-		long len;
-		char *filename = NULL;
-		PKI_TOKEN *tk = NULL;
+	for ( i = 0; i < PKI_STACK_elements( names ); i++ ) {
 
-		filename = dd->d_name;
-		len = (long) strlen( filename );
-
-		if( (len < 4) || (strcmp( ".xml", filename +len -4 ))) {
-			continue;
-		} else {
-			char fullpath[BUFF_MAX_SIZE];
-			size_t fullsize = 0;
-
-			PKI_CONFIG *tmp_cfg = NULL;
-			char *tmp_name = NULL;
-
-			snprintf(fullpath, BUFF_MAX_SIZE,
-				"%s/%s", token_dir, filename );
-
-			if((fullsize = strlen(token_dir) + 
-				strlen( filename ) + 1) > 
-						BUFF_MAX_SIZE) {
-				continue;
-			}
-				
-			if((tmp_cfg = PKI_CONFIG_load( fullpath )) ==
-								NULL ) {
-				continue;
-			}
-
-			if((tmp_name = PKI_CONFIG_get_value( tmp_cfg,
-						"/*/name")) != NULL) {
+		char *tmp_name = PKI_STACK_get_num( names, i );
+		PKI_TOKEN *tk = NULL;
 
-				if((tk = PKI_TOKEN_new_null()) != NULL ) {
-					if((PKI_TOKEN_init( tk, token_dir, tmp_name )) != PKI_ERR ) {
-						PKI_STACK_push( list, strdup(tmp_name));
-					}
-					PKI_TOKEN_free( tk );
-				}
+		if((tk = PKI_TOKEN_new_null()) != NULL ) {
+			if((PKI_TOKEN_init( tk, token_dir, tmp_name )) != PKI_ERR ) {
+				PKI_STACK_push( ret, strdup(tmp_name));
 			}
-
+			PKI_TOKEN_free( tk );
 		}
 	}
-	closedir( dirp );
+	PKI_STACK_free_all( names );
 
 	if( url ) URL_free (url);
 	if( token_dir ) PKI_Free ( token_dir );
@@ -451,14 +595,14 @@ PKI_TOKEN_STACK *PKI_get_all_tokens ( char *dir ) {
 
 PKI_TOKEN_STACK *PKI_get_all_tokens_dir ( char *dir, PKI_TOKEN_STACK *list ) {
 
-	struct dirent *dd = NULL;
-	DIR *dirp = NULL;
+	PKI_STACK *names = NULL;
 	URL *url = NULL;
 
 	char *token_dir = NULL;
 	size_t token_dir_size = 0;
 
 	PKI_TOKEN_STACK *ret = NULL;
+	int i = 0;
 
 	if( !dir ) return ( NULL );
 
@@ -489,64 +633,33 @@ PKI_TOKEN_STACK *PKI_get_all_tokens_dir ( char *dir, PKI_TOKEN_STACK *list ) {
 
 	PKI_log_debug("PKI_list_all_tokens_dir()::Opening dir %s", token_dir);
 
-	if((dirp = opendir( token_dir )) == NULL ) {
+	// The configuration names come from the directory index
+	if((names = PKI_CONFIG_get_names( token_dir )) == NULL ) {
 
 		snprintf( token_dir, token_dir_size, "%s", url->addr );
 
 		PKI_log_debug("PKI_list_all_tokens_dir()::Opening dir %s", token_dir);
-		if((dirp = opendir( token_dir)) == NULL ) {
+		if((names = PKI_CONFIG_get_names( token_dir )) == NULL ) {
 			if( url ) URL_free (url );
 			if( token_dir ) PKI_Free ( token_dir );
 			return ( ret );
 		}
 	}
 
-	while(( dd = readdir( dirp )) != NULL ) {
-		long len;
-		char *filename = NULL;
-		PKI_TOKEN *tk = NULL;
-
-		filename = dd->d_name;
-		len = (long) strlen( filename );
-
-		if( (len < 4) || (strcmp( ".xml", filename +len -4 ))) {
-			continue;
-		} else {
-			char fullpath[BUFF_MAX_SIZE];
-			size_t fullsize = 0;
-
-			PKI_CONFIG *tmp_cfg = NULL;
-			char *tmp_name = NULL;
-
-			snprintf(fullpath, BUFF_MAX_SIZE,
-				"%s/%s", token_dir, filename );
-
-			if((fullsize = strlen(token_dir) + 
-				strlen( filename ) + 1) > 
-						BUFF_MAX_SIZE) {
-				continue;
-			}
-				
-			if((tmp_cfg = PKI_CONFIG_load( fullpath )) ==
-								NULL ) {
-				continue;
-			}
+	for ( i = 0; i < PKI_STACK_elements( names ); i++ ) {
 
-			if((tmp_name = PKI_CONFIG_get_value( tmp_cfg,
-						"/*/name")) != NULL) {
+		char *tmp_name = PKI_STACK_get_num( names, i );
+		PKI_TOKEN *tk = NULL;
 
-				if((tk = PKI_TOKEN_new_null()) != NULL ) {
-					if((PKI_TOKEN_init( tk, dir, tmp_name )) != PKI_ERR ) {
-						PKI_STACK_TOKEN_push( list, tk);
-					} else {
-						PKI_TOKEN_free( tk );
-					}
-				}
+		if((tk = PKI_TOKEN_new_null()) != NULL ) {
+			if((PKI_TOKEN_init( tk, dir, tmp_name )) != PKI_ERR ) {
+				PKI_STACK_TOKEN_push( ret, tk);
+			} else {
+				PKI_TOKEN_free( tk );
 			}
-
 		}
 	}
-	closedir( dirp );
+	PKI_STACK_free_all( names );
 
 	if( url ) URL_free (url);
 	if( token_dir ) PKI_Free ( token_dir );
@@ -567,9 +680,16 @@ int PKI_init_providers(void) {
 	OSSL_PROVIDER* provider = NULL;
 		// Internal pointer
 
-	OSSL_LIB_CTX * lib_ctx = PKI_init_get_ossl_library_ctx();
+	OSSL_LIB_CTX * lib_ctx = NULL;
 		// OpenSSL Library Context
 
+	// Creates the library context, if needed
+	if (_ossl_lib_ctx == NULL) _ossl_lib_ctx = OSSL_LIB_CTX_new();
+	if ((lib_ctx = _ossl_lib_ctx) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return 0;
+	}
+
 	// Loads the Default Provider
 	if (ossl_providers[0] == NULL) {
 		provider = OSSL_PROVIDER_load(lib_ctx, "default");
@@ -623,9 +743,9 @@ int PKI_cleanup_providers(void) {
 
 #if OPENSSL_VERSION_NUMBER > 0x3000000fL
 OSSL_LIB_CTX * PKI_init_get_ossl_library_ctx() {
-	if (_ossl_lib_ctx == NULL) {
-		_ossl_lib_ctx = OSSL_LIB_CTX_new();
-	}
+	// The context is created (and the providers are
+	// loaded) when the subsystem is first initialized
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PROVIDERS);
 	if (!_ossl_lib_ctx) {
 		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 		return NULL;
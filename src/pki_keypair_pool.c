@@ -0,0 +1,422 @@
+/* Pre-generated Keypairs Pool */
+
+#include <libpki/pki.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+// ==================
+// Internal Structures
+// ==================
+
+typedef struct pki_keypair_pool_queue_st {
+	/*! Keypairs type */
+	PKI_SCHEME_ID scheme;
+	int bits;
+
+	/*! Watermarks */
+	int low;
+	int high;
+
+	/*! Pre-generated keypairs (up to 'high') */
+	PKI_X509_KEYPAIR ** keys;
+	int num;
+
+	/*! Keypairs being generated */
+	int pending;
+
+	/*! Set when the queue reaches 'low', until it is back at 'high' */
+	int refill;
+
+	struct pki_keypair_pool_queue_st * next;
+} PKI_KEYPAIR_POOL_QUEUE;
+
+struct pki_keypair_pool_st {
+	/*! Protects the queues */
+	PKI_MUTEX lock;
+
+	/*! Wakes up the generation threads */
+	PKI_COND cond;
+
+	/*! Configured queues */
+	PKI_KEYPAIR_POOL_QUEUE * queues;
+
+	/*! Generation threads */
+	PKI_THREAD ** workers;
+	int workers_num;
+
+	/*! Set when the pool is being freed */
+	int stop;
+};
+
+// =================
+// Static Functions
+// =================
+
+// Returns the queue for the scheme and size (lock held)
+static PKI_KEYPAIR_POOL_QUEUE * _pool_queue(PKI_KEYPAIR_POOL * pool,
+					    PKI_SCHEME_ID scheme, int bits) {
+
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+
+	for (q = pool->queues; q != NULL; q = q->next) {
+		if (q->scheme == scheme && q->bits == bits) return q;
+	}
+
+	return NULL;
+}
+
+// Returns a queue that needs one more keypair (lock held)
+static PKI_KEYPAIR_POOL_QUEUE * _pool_queue_to_fill(PKI_KEYPAIR_POOL * pool) {
+
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+
+	for (q = pool->queues; q != NULL; q = q->next) {
+		if (q->refill && q->num + q->pending < q->high) return q;
+	}
+
+	return NULL;
+}
+
+static void _pool_key_discard(PKI_X509_KEYPAIR * key) {
+
+	// The crypto library clears the private key material when
+	// freeing the key (clear-free of the key components)
+	PKI_X509_KEYPAIR_free(key);
+}
+
+static PKI_X509_KEYPAIR * _pool_keygen(PKI_SCHEME_ID scheme, int bits) {
+
+	return PKI_X509_KEYPAIR_new(scheme, bits, NULL, NULL, NULL);
+}
+
+static void * _pool_worker(void * arg) {
+
+	PKI_KEYPAIR_POOL * pool = (PKI_KEYPAIR_POOL *) arg;
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+	PKI_X509_KEYPAIR * key = NULL;
+
+#ifdef __linux__
+	// Key generation should not compete with the requests
+	// (on Linux, the nice value is per-thread)
+	setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), 19);
+#endif
+
+	PKI_MUTEX_acquire(&pool->lock);
+
+	while (!pool->stop) {
+
+		if ((q = _pool_queue_to_fill(pool)) == NULL) {
+			PKI_COND_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+
+		// Generates the key without holding the lock
+		q->pending++;
+		PKI_MUTEX_release(&pool->lock);
+
+		key = _pool_keygen(q->scheme, q->bits);
+
+		PKI_MUTEX_acquire(&pool->lock);
+		q->pending--;
+
+		if (!key) {
+			// Stops refilling, the next pop will try again
+			PKI_DEBUG("Can not generate a keypair for the pool (scheme %d, bits %d)",
+				q->scheme, q->bits);
+			q->refill = 0;
+			continue;
+		}
+
+		if (pool->stop || q->num >= q->high) _pool_key_discard(key);
+		else q->keys[q->num++] = key;
+
+		if (q->num >= q->high) q->refill = 0;
+	}
+
+	PKI_MUTEX_release(&pool->lock);
+
+	return NULL;
+}
+
+// Allocates the pool and starts the workers
+static PKI_KEYPAIR_POOL * _pool_new(int threads) {
+
+	PKI_KEYPAIR_POOL * pool = NULL;
+	int i = 0;
+
+	if ((pool = PKI_Malloc(sizeof(PKI_KEYPAIR_POOL))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	PKI_MUTEX_init(&pool->lock);
+	PKI_COND_init(&pool->cond);
+
+	if ((pool->workers = PKI_Malloc(sizeof(PKI_THREAD *) * (size_t) threads)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		PKI_KEYPAIR_POOL_free(pool);
+		return NULL;
+	}
+
+	for (i = 0; i < threads; i++) {
+		if ((pool->workers[i] = PKI_THREAD_new(_pool_worker, pool)) == NULL) {
+			PKI_ERROR(PKI_ERR_GENERAL, "Can not start the keypair pool threads");
+			PKI_KEYPAIR_POOL_free(pool);
+			return NULL;
+		}
+		pool->workers_num++;
+	}
+
+	return pool;
+}
+
+// =================
+// Public Functions
+// =================
+
+/*!
+ * \brief Returns a new (empty) keypair pool
+ *
+ * The pool uses 'threads' low-priority threads to generate keypairs
+ * (PKI_KEYPAIR_POOL_THREADS if <= 0). Queues are configured via the
+ * PKI_KEYPAIR_POOL_add_scheme() function.
+ */
+
+PKI_KEYPAIR_POOL * PKI_KEYPAIR_POOL_new(int threads) {
+
+	PKI_KEYPAIR_POOL * pool = NULL;
+	PKI_ARENA * arena = NULL;
+
+	if (threads <= 0) threads = PKI_KEYPAIR_POOL_THREADS;
+
+	// The pool outlives the request (not allocated from its arena)
+	arena = PKI_ARENA_suspend();
+	pool = _pool_new(threads);
+	PKI_ARENA_resume(arena);
+
+	return pool;
+}
+
+/*!
+ * \brief Frees the pool
+ *
+ * Pending generations are completed and the pooled keypairs are
+ * discarded (their private key material is cleared).
+ */
+
+void PKI_KEYPAIR_POOL_free(PKI_KEYPAIR_POOL *pool) {
+
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+	int i = 0;
+
+	if (!pool) return;
+
+	PKI_MUTEX_acquire(&pool->lock);
+	pool->stop = 1;
+	PKI_COND_broadcast(&pool->cond);
+	PKI_MUTEX_release(&pool->lock);
+
+	for (i = 0; i < pool->workers_num; i++) {
+		PKI_THREAD_join(pool->workers[i], NULL);
+		PKI_Free(pool->workers[i]);
+	}
+	if (pool->workers) PKI_Free(pool->workers);
+
+	while ((q = pool->queues) != NULL) {
+		pool->queues = q->next;
+		for (i = 0; i < q->num; i++) _pool_key_discard(q->keys[i]);
+		PKI_Free(q->keys);
+		PKI_Free(q);
+	}
+
+	PKI_COND_destroy(&pool->cond);
+	PKI_MUTEX_destroy(&pool->lock);
+
+	PKI_Free(pool);
+}
+
+/*!
+ * \brief Configures the queue for a scheme and size
+ *
+ * The queue is refilled up to 'high' keypairs every time it drops to
+ * 'low' keypairs (or below). The queue starts filling right away.
+ * Adding an existing queue updates its watermarks, extra keypairs
+ * are discarded.
+ */
+
+int PKI_KEYPAIR_POOL_add_scheme(PKI_KEYPAIR_POOL *pool,
+				PKI_SCHEME_ID     scheme,
+				int               bits,
+				int               low,
+				int               high) {
+
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+	PKI_X509_KEYPAIR ** keys = NULL;
+	PKI_ARENA * arena = NULL;
+
+	if (!pool) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (high <= 0 || low < 0 || low >= high)
+		return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Watermarks (low %d, high %d)", low, high);
+
+	// The queues live as long as the pool (not from the caller's arena)
+	arena = PKI_ARENA_suspend();
+	keys = PKI_Malloc(sizeof(PKI_X509_KEYPAIR *) * (size_t) high);
+	PKI_ARENA_resume(arena);
+
+	if (keys == NULL) return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+	PKI_MUTEX_acquire(&pool->lock);
+
+	if ((q = _pool_queue(pool, scheme, bits)) == NULL) {
+		arena = PKI_ARENA_suspend();
+		q = PKI_Malloc(sizeof(PKI_KEYPAIR_POOL_QUEUE));
+		PKI_ARENA_resume(arena);
+
+		if (q == NULL) {
+			PKI_MUTEX_release(&pool->lock);
+			PKI_Free(keys);
+			return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		}
+		q->scheme = scheme;
+		q->bits = bits;
+		q->next = pool->queues;
+		pool->queues = q;
+	}
+
+	// Moves the existing keypairs (up to the new size)
+	while (q->num > high) _pool_key_discard(q->keys[--q->num]);
+	if (q->num > 0) memcpy(keys, q->keys, sizeof(PKI_X509_KEYPAIR *) * (size_t) q->num);
+	if (q->keys) PKI_Free(q->keys);
+
+	q->keys = keys;
+	q->low = low;
+	q->high = high;
+	q->refill = (q->num < high);
+
+	PKI_COND_broadcast(&pool->cond);
+	PKI_MUTEX_release(&pool->lock);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Fills all the queues up to their high watermark (in the
+ *        calling thread), useful to warm up the pool at startup
+ */
+
+int PKI_KEYPAIR_POOL_fill(PKI_KEYPAIR_POOL *pool) {
+
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+	PKI_X509_KEYPAIR * key = NULL;
+	PKI_ARENA * arena = NULL;
+
+	if (!pool) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	PKI_MUTEX_acquire(&pool->lock);
+
+	q = pool->queues;
+	while (q != NULL) {
+
+		// Keypairs being generated by the threads are not waited
+		// for, an extra keypair is discarded instead
+		if (q->num >= q->high) {
+			q = q->next;
+			continue;
+		}
+
+		q->pending++;
+		PKI_MUTEX_release(&pool->lock);
+
+		// Pooled keypairs outlive the caller's arena
+		arena = PKI_ARENA_suspend();
+		key = _pool_keygen(q->scheme, q->bits);
+		PKI_ARENA_resume(arena);
+
+		PKI_MUTEX_acquire(&pool->lock);
+		q->pending--;
+
+		if (!key) {
+			q->refill = 0;
+			PKI_MUTEX_release(&pool->lock);
+			return PKI_ERROR(PKI_ERR_X509_KEYPAIR_GENERATION, NULL);
+		}
+
+		if (q->num < q->high) q->keys[q->num++] = key;
+		else _pool_key_discard(key);
+
+		if (q->num >= q->high) q->refill = 0;
+	}
+
+	PKI_MUTEX_release(&pool->lock);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Returns a keypair for the scheme and size
+ *
+ * The keypair is taken from the pool if available, otherwise it is
+ * generated in the calling thread. The returned keypair is owned by
+ * the caller.
+ */
+
+PKI_X509_KEYPAIR * PKI_KEYPAIR_POOL_get(PKI_KEYPAIR_POOL *pool,
+					PKI_SCHEME_ID     scheme,
+					int               bits) {
+
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+	PKI_X509_KEYPAIR * key = NULL;
+
+	if (!pool) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	PKI_MUTEX_acquire(&pool->lock);
+
+	if ((q = _pool_queue(pool, scheme, bits)) != NULL) {
+
+		if (q->num > 0) {
+			key = q->keys[--q->num];
+			q->keys[q->num] = NULL;
+		}
+
+		// Wakes up the generation threads at the low watermark
+		if (q->num <= q->low && !q->refill) {
+			q->refill = 1;
+			PKI_COND_broadcast(&pool->cond);
+		}
+	}
+
+	PKI_MUTEX_release(&pool->lock);
+
+	// Empty (or not configured) queue
+	if (!key) {
+		PKI_DEBUG("Keypair pool miss (scheme %d, bits %d)", scheme, bits);
+		key = _pool_keygen(scheme, bits);
+	}
+
+	return key;
+}
+
+/*! \brief Returns the number of pooled keypairs for the scheme and size */
+
+int PKI_KEYPAIR_POOL_size(PKI_KEYPAIR_POOL *pool,
+			  PKI_SCHEME_ID     scheme,
+			  int               bits) {
+
+	PKI_KEYPAIR_POOL_QUEUE * q = NULL;
+	int ret = 0;
+
+	if (!pool) return 0;
+
+	PKI_MUTEX_acquire(&pool->lock);
+	if ((q = _pool_queue(pool, scheme, bits)) != NULL) ret = q->num;
+	PKI_MUTEX_release(&pool->lock);
+
+	return ret;
+}
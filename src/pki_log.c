@@ -74,6 +74,10 @@ static PKI_LOG _log_st = {
 	NULL,
 };
 
+/* Copies of the level and flags for the inline checks (see pki_log.h) */
+int __libpki_log_level = PKI_LOG_ERR;
+int __libpki_log_flags = PKI_LOG_FLAGS_NONE;
+
 /*!
  * \brief Initialize the log subsystem 
 */
@@ -104,6 +108,9 @@ int PKI_log_init ( PKI_LOG_TYPE type, PKI_LOG_LEVEL level, char *resource,
 
 	_log_st.flags = flags;
 
+	__libpki_log_level = _log_st.level;
+	__libpki_log_flags = _log_st.flags;
+
 	/* Check consistency between the token and the signature flag */
 	if( tk ) {
 		_log_st.tk = tk;
@@ -205,6 +212,9 @@ int PKI_log_end( void )
 	_log_st.finalize = NULL;
 	_log_st.entry_sign = NULL;
 
+	__libpki_log_level = _log_st.level;
+	__libpki_log_flags = _log_st.flags;
+
 	pthread_cond_signal ( &log_cond );
 	pthread_mutex_unlock( &log_mutex );
 
@@ -235,6 +245,15 @@ void PKI_log( int level, const char *fmt, ... ) {
 	return;
 }
 
+/*! \brief Returns !0 if entries at the passed level are logged */
+
+int PKI_log_is_enabled( int level ) {
+
+	if (!_log_st.add) return 0;
+
+	return PKI_log_level_enabled(level);
+}
+
 /*! \brief Add an entry in the Debug log */
 
 void PKI_log_debug_simple( const char *fmt, ... ) {
@@ -365,51 +384,8 @@ static char *_get_info_string( int level ) {
 	return( info );
 }
 
-static char * _pki_get_time_s( void ) {
-
-	struct timespec now;
-		// Current Time
-
-	const size_t time_s_size = 50;
-		// Time String Size
-
-	char * time_s = PKI_Malloc(time_s_size);
-		// Time String
-
-	// Get the current time
-	if (clock_gettime(CLOCK_MONOTONIC, &now) >= 0) {
-
-		long millisec = 0;
-			// Milliseconds
-
-		millisec = now.tv_nsec / 1000;
-		strftime(time_s, time_s_size, "%Y-%m-%d %H:%M:%S", localtime(&now.tv_sec));
-		strncat(time_s, ".", time_s_size - strlen(time_s) - 1);
-		snprintf(time_s + strlen(time_s), time_s_size - strlen(time_s) - 1,
-			"%ld", millisec);
-	
-	} else {
-
-		PKI_TIME *now = PKI_TIME_new(0);
-			// Current GMT Time
-
-		char * now_s = PKI_TIME_get_parsed(now);
-			// Text Representation of the now time
-
-		// Let's make sure we have some text to write
-		if (now_s == NULL) now_s = strdup("<time error>");
-
-		// Copy the string to the time_s variable
-		snprintf(time_s, time_s_size, "%s", now_s);
-	
-		// Free Memory
-		if (now) PKI_TIME_free( now );
-		if (now_s) PKI_Free(now_s);
-	}
-
-	// Return the time string
-	return ( time_s );
-}
+/* Size of the time strings of the log entries */
+#define PKI_LOG_TIME_SIZE	(PKI_TIME_LOG_SIZE + 8)
 
 /*! \brief Add an entry in the log 
 */
@@ -447,34 +423,30 @@ static void _pki_syslog_add( int level, const char *fmt, va_list ap ) {
 
 static void _pki_stdout_add( int level, const char *fmt, va_list ap ) {
 
-	char * now_s = _pki_get_time_s();
+	char now_s[PKI_LOG_TIME_SIZE];
 
 	/* Let's print the log entry */
 	fprintf ( stdout, "%s [%d] %s: ",
-		now_s, getpid(), _get_info_string(level));
+		PKI_TIME_now_log_s(now_s, sizeof(now_s)), getpid(),
+		_get_info_string(level));
 	vfprintf( stdout, fmt, ap );
 	fprintf ( stdout, "\n" );
 
-	// Free Memory
-	if (now_s) PKI_Free(now_s);
-
 	// All Done
 	return;
 }
 
 static void _pki_stderr_add( int level, const char *fmt, va_list ap ) {
 
-	char * now_s = _pki_get_time_s();
+	char now_s[PKI_LOG_TIME_SIZE];
 
 	/* Let's print the log entry */
 	fprintf(stderr, "%s [%d] %s: ", 
-		now_s, getpid(), _get_info_string(level));
+		PKI_TIME_now_log_s(now_s, sizeof(now_s)), getpid(),
+		_get_info_string(level));
 	vfprintf( stderr, fmt, ap );
 	fprintf ( stderr, "\n" );
 
-	// Free Memory
-	if (now_s) PKI_Free(now_s);
-
 	// All Done
 	return;
 }
@@ -484,7 +456,7 @@ static void _pki_file_add( int level, const char *fmt, va_list ap ) {
 	int fd = 0;
 	FILE *file = NULL;
 
-	char * now_s = NULL;
+	char now_s[PKI_LOG_TIME_SIZE];
 		// Text Representation of the now time
 
 	if( ! _log_st.resource ) return;
@@ -501,19 +473,13 @@ static void _pki_file_add( int level, const char *fmt, va_list ap ) {
 		return;
 	}
 
-	// Gets the Current Time
-	now_s = _pki_get_time_s();
-
 	/* Let's print the log entry */
 	fprintf ( file, "%s [%d]: %s: ", 
-		now_s, getpid(), _get_info_string( level ));
+		PKI_TIME_now_log_s(now_s, sizeof(now_s)), getpid(),
+		_get_info_string( level ));
 	vfprintf( file, fmt, ap );
 	fprintf ( file, "\n");
 
-	// Free Memory
-	// PKI_TIME_free(now);
-	if (now_s) PKI_Free(now_s);
-
 	/* Now close the file stream */
 	fclose( file );
 
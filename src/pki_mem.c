@@ -195,8 +195,16 @@ int PKI_MEM_grow( PKI_MEM *buf, size_t data_size )
 	}
 	else
 	{
+		unsigned char *data = NULL;
+
 		new_size = buf->size + data_size;
-		buf->data = realloc(buf->data, new_size);
+		if ((data = PKI_Realloc(buf->data, new_size)) == NULL)
+		{
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			return (PKI_ERR);
+		}
+
+		buf->data = data;
 		buf->size = new_size;
 	}
 
@@ -289,10 +297,15 @@ char * PKI_MEM_get_parsed(PKI_MEM *buf)
 void *PKI_Malloc( size_t size )
 {
 	void *ret = NULL;
+	PKI_ARENA *arena = NULL;
 
 	// Checks we have a sensitive size to malloc
 	if ( size == 0 ) return NULL;
 
+	// Request-scoped allocations come from the thread's arena
+	if ((arena = PKI_ARENA_get_current()) != NULL)
+		return PKI_ARENA_alloc(arena, size);
+
 	// Allocates and zeroize memory (this might prevent
 	// some cross-process / cross-thread information leaking)
 #ifdef HAVE_CALLOC
@@ -312,13 +325,43 @@ void PKI_Free( void *ret )
 {
 	// Checks we have a valid pointer
 	if( ret == NULL ) return;
-	
+
+	// Arena memory is released together with the arena (also
+	// when the arena is no longer bound to the thread)
+	if (PKI_ARENA_find(ret) != NULL) return;
+
 	// Frees the associated memory
 	free ( ret );
 
 	return;
 }
 
+/*! \brief Resizes memory allocated with PKI_Malloc (added memory is not zeroized) */
+
+void *PKI_Realloc( void *ptr, size_t size )
+{
+	PKI_ARENA *arena = NULL;
+	PKI_ARENA *owner = NULL;
+	void *ret = NULL;
+	size_t old_size = 0;
+
+	if (ptr == NULL) return PKI_Malloc(size);
+
+	if ((owner = PKI_ARENA_find(ptr)) == NULL) return realloc(ptr, size);
+
+	// Arenas bound to the thread grow their own memory
+	for (arena = PKI_ARENA_get_current(); arena != NULL; arena = arena->prev) {
+		if (arena == owner) return PKI_ARENA_realloc(arena, ptr, size);
+	}
+
+	// Memory of other arenas is copied (the original is left to its arena)
+	if ((ret = PKI_Malloc(size)) == NULL) return NULL;
+	old_size = PKI_ARENA_size(ptr);
+	memcpy(ret, ptr, old_size < size ? old_size : size);
+
+	return ret;
+}
+
 /*! \brief Frees and Zeroizes memory associated with a pointer */
 
 void PKI_ZFree ( void *pnt, size_t size ) {
@@ -442,107 +485,148 @@ PKI_MEM *PKI_MEM_new_bio(PKI_IO *io, PKI_MEM **mem)
 /*! \brief Returns a new B64-encoded PKI_MEM.
  *
  * @param mem The first parameter should be a pointer to a valid PKI_MEM container.
- * @param skipNewLines The second parameter controls the format of the B64 data. If
- *     set to non-0 values, the encoded data will be bound with new lines every 76
+ * @param addNewLines The second parameter controls the format of the B64 data. If
+ *     set to non-0 values, the encoded data will be bound with new lines every 64
  *     chars. Otherwise (if 0) no line breaks will be added to the resulting PKI_MEM.
  * @return This function returns a new PKI_MEM container with the B64-encoded content
+ *     (NUL terminated, the terminator is not included in the size)
  */
 
 PKI_MEM *PKI_MEM_get_b64_encoded (PKI_MEM *mem, int addNewLines)
 {
-	PKI_IO *b64 = NULL;
-	PKI_IO *bio = NULL;
-
 	PKI_MEM *encoded = NULL;
+	int line_len = (addNewLines ? PKI_B64_LINE_LEN : 0);
 
-	if(!(b64 = BIO_new(BIO_f_base64()))) {
+	if (!mem || (!mem->data && mem->size > 0))
+	{
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 		return NULL;
 	}
 
-	// Sets the flag to not output any new-line (only one line)
-	if (addNewLines == 0) BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-
-	if(!(bio = BIO_new(BIO_s_mem()))) {
-		BIO_free_all ( b64 );
+	if ((encoded = PKI_MEM_new(PKI_B64_encoded_size(mem->size, line_len) + 1)) == NULL)
 		return NULL;
-	}
 
-	bio = BIO_push(b64, bio);
-	BIO_write ( bio, mem->data, (int) mem->size );
-	(void) BIO_flush (bio);
-	bio = BIO_pop ( bio );
-	BIO_free ( b64 );
+	encoded->size = PKI_B64_encode(encoded->data, mem->data, mem->size, line_len);
+	encoded->data[encoded->size] = '\x0';
+
+	return encoded;
+}
+
+/*! \brief Returns a new PKI_MEM from a B64-encoded one.
+ *
+ * @param mem The first parameter should be a pointer to a valid PKI_MEM container.
+ * @param withNewLines The second parameter is kept for compatibility: line breaks
+ *    (and blanks) are skipped regardless of its value, the data is decoded in
+ *    a single pass.
+ * @return This function returns a new PKI_MEM container with the B64-decoded content,
+ *    or NULL if the data is not valid B64
+ */
+
+PKI_MEM *PKI_MEM_get_b64_decoded(PKI_MEM *mem, int withNewLines)
+{
+	PKI_MEM *decoded = NULL;
+	ssize_t size = 0;
 
-	/* Now we get back the info from the bio */
-	if((encoded = PKI_MEM_new_bio( bio, NULL )) != NULL)
+	if (!mem || (!mem->data && mem->size > 0))
 	{
-		// The new data might have an ending EOL added to it, let's get
-		// rid of it
-		size_t size = encoded->size;
-		while (size > 0)
-		{
-			if (encoded->data[size] == '\n' || encoded->data[size] == '\r' || encoded->data[size] == '\x0')
-			{
-				if (encoded->data[size] != '\x0') encoded->size--;
-				encoded->data[size] = '\x0';
-				size--;
-			}
-			else break;
-		}
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
 	}
-	else
+
+	if ((decoded = PKI_MEM_new(PKI_B64_decoded_size(mem->size))) == NULL)
+		return NULL;
+
+	if ((size = PKI_B64_decode(decoded->data, mem->data, mem->size)) < 0)
 	{
-		BIO_free ( bio );
+		PKI_ERROR(PKI_ERR_DATA_FORMAT_UNKNOWN, "Invalid B64 data");
+		PKI_MEM_free(decoded);
 		return NULL;
 	}
+	decoded->size = (size_t) size;
 
-	BIO_free ( bio );
-
-	return encoded;
+	return decoded;
 }
 
-/*! \brief Returns a new PKI_MEM from a B64-encoded one.
+/*! \brief Returns a new PKI_MEM with the data from the first PEM block
  *
- * @param b64_mem The first parameter should be a pointer to a valid PKI_MEM container.
- * @param withNewLines The second parameter controls the format of the expected B64 data. If set to
- *    negative values, the B64 data is expected to be on one line, if set to positive
- *    values, the data is expected to be on multiple lines. If set to 0, the data is
- *    assumed to be separated in 76 chars lines.
- * @return This function returns a new PKI_MEM container with the B64-decoded content
+ * @param mem The first parameter should be a pointer to a valid PKI_MEM container.
+ * @param label The second parameter, if not NULL, is filled in with the label of
+ *    the PEM block (e.g., "CERTIFICATE").
+ * @param label_size The size of the label buffer.
+ * @return This function returns a new PKI_MEM container with the decoded content
+ *    of the first PEM block. NULL is returned if there is no PEM block, or if the
+ *    block has encapsulated headers (e.g., encrypted keys) as these are processed
+ *    by the crypto library PEM functions.
  */
 
-PKI_MEM *PKI_MEM_get_b64_decoded(PKI_MEM *mem, int withNewLines)
+PKI_MEM *PKI_MEM_get_pem_decoded(const PKI_MEM *mem, char *label, size_t label_size)
 {
+	static const char begin[] = "-----BEGIN ";
+	static const char end[] = "-----END ";
+	static const char dashes[] = "-----";
+
+	const unsigned char *data = NULL, *body = NULL, *eol = NULL;
+	const unsigned char *label_start = NULL;
+	size_t size = 0, label_len = 0, i = 0;
 	PKI_MEM *decoded = NULL;
+	ssize_t len = 0;
 
-	PKI_IO *b64 = NULL;
-	PKI_IO *bio = NULL;
+	if (!mem || !mem->data || mem->size <= 0)
+	{
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
 
-	int n = 0;
+	data = mem->data;
+	size = mem->size;
 
-	char buf[4096];
+	// Looks for the BEGIN line (at the start of a line)
+	for (i = 0; i + sizeof(begin) - 1 <= size; i++)
+	{
+		if ((i == 0 || data[i-1] == '\n') && memcmp(data + i, begin, sizeof(begin) - 1) == 0)
+			break;
+	}
+	if (i + sizeof(begin) - 1 > size) return NULL;
 
-	if (!(b64 = BIO_new(BIO_f_base64()))) return NULL;
-	if (withNewLines <= 0) BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
+	label_start = data + i + sizeof(begin) - 1;
+	if ((eol = memchr(label_start, '\n', size - (size_t)(label_start - data))) == NULL)
+		return NULL;
 
-	if ((bio = BIO_new_mem_buf(mem->data, (int) mem->size)) == NULL)
+	// The label is followed by the dashes
+	for (label_len = 0; label_start + label_len + sizeof(dashes) - 1 <= eol; label_len++)
 	{
-		BIO_free_all(b64);
-		return NULL;
+		if (memcmp(label_start + label_len, dashes, sizeof(dashes) - 1) == 0) break;
 	}
-	BIO_push(b64, bio);
+	if (label_start + label_len + sizeof(dashes) - 1 > eol) return NULL;
 
-	if ((decoded = PKI_MEM_new_null()) == NULL)
+	if (label)
 	{
-		BIO_free_all(b64);
-		return NULL;
+		if (label_len >= label_size) return NULL;
+		memcpy(label, label_start, label_len);
+		label[label_len] = '\x0';
 	}
 
-	while ((n = BIO_read(b64, buf, sizeof(buf))) > 0)
+	body = eol + 1;
+
+	// Looks for the END line
+	for (i = (size_t)(body - data); i + sizeof(end) - 1 <= size; i++)
 	{
-		PKI_MEM_add(decoded, (const unsigned char *)buf, (size_t)n);
+		if (data[i-1] == '\n' && memcmp(data + i, end, sizeof(end) - 1) == 0) break;
+
+		// Encapsulated headers are left to the crypto library
+		if (data[i] == ':') return NULL;
 	}
-	BIO_free_all(b64);
+	if (i + sizeof(end) - 1 > size) return NULL;
+
+	if ((decoded = PKI_MEM_new(PKI_B64_decoded_size(i - (size_t)(body - data)))) == NULL)
+		return NULL;
+
+	if ((len = PKI_B64_decode(decoded->data, body, i - (size_t)(body - data))) <= 0)
+	{
+		PKI_MEM_free(decoded);
+		return NULL;
+	}
+	decoded->size = (size_t) len;
 
 	return decoded;
 }
@@ -768,22 +852,11 @@ int PKI_MEM_encode(PKI_MEM *mem, PKI_DATA_FORMAT format, int opts)
 		return PKI_ERR;
 	}
 
-	// Removes and Frees the data in the PKI_MEM
+	// Replaces the data in the PKI_MEM
 	PKI_MEM_transfer(mem, encoded);
 
-	// Clears the memory for the old PKI_MEM
-	// if (mem->data) PKI_Free(mem->data);
-
-	// Transfer ownership of the data
-	mem->data = encoded->data;
-	mem->size = encoded->size;
-
-	// Clears the encoded data container
-	// encoded->data = NULL;
-	// encoded->size = 0;
-
 	// Free the newly-allocated (now empty) container
-	// PKI_MEM_free(encoded);
+	PKI_MEM_free(encoded);
 
 	// Returns success
 	return PKI_OK;
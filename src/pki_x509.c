@@ -14,6 +14,30 @@ typedef struct tbs_asn1_st {
 	const void * data;
 } PKI_TBS_ASN1;
 
+typedef struct pki_x509_cache_digest_st {
+	PKI_X509_CACHE_DIGEST type;
+	int alg_id;
+	size_t size;
+	unsigned char value[EVP_MAX_MD_SIZE];
+} PKI_X509_CACHE_DIGEST_ENTRY;
+
+struct pki_x509_cache_st {
+	/* Protects lookups and fills from concurrent readers */
+	PKI_MUTEX lock;
+
+	/* Internal value the cached data refers to */
+	const void * value;
+
+	/* DER encoding of the whole object and of its toBeSigned part */
+	PKI_MEM * der;
+	PKI_MEM * tbs;
+
+	/* Fingerprints and key hashes, oldest entry is replaced when full */
+	PKI_X509_CACHE_DIGEST_ENTRY digests[PKI_X509_CACHE_DIGEST_SIZE];
+	int digests_num;
+	int digests_next;
+};
+
 struct parsed_datatypes_st __parsed_datatypes[] = {
 	/* X509 types */
 	{ "Unknown", PKI_DATATYPE_UNKNOWN },
@@ -291,6 +315,9 @@ PKI_X509 *PKI_X509_new ( PKI_DATATYPE type, struct hsm_st *hsm ) {
 	// For PKI_X509_KEYPAIR, digest requirement
 	ret->signature_digest_required = -1;
 
+	// Cached encodings and digests (allocated on first use)
+	ret->cache = NULL;
+
 	// All Done
 	return ret;
 }
@@ -323,6 +350,12 @@ void PKI_X509_free ( PKI_X509 *x ) {
 
 	if (x->hsm) HSM_free(x->hsm);
 
+	if (x->cache) {
+		PKI_X509_CACHE_clear(x);
+		PKI_MUTEX_destroy(&x->cache->lock);
+		PKI_Free(x->cache);
+	}
+
 	PKI_ZFree ( x, sizeof(PKI_X509) );
 
 	return;
@@ -394,11 +427,8 @@ PKI_X509 *PKI_X509_new_dup_value (PKI_DATATYPE    type,
 	return ret;
 }
 
-/*!
- * \brief Sets the Modified bit (required in some crypto lib to force re-encoding)
- */
-
-int PKI_X509_set_modified ( PKI_X509 *x ) {
+/* Sets the crypto library's modified flag, the cache is not touched */
+static int _set_encoding_modified ( PKI_X509 *x ) {
 
 #if ( OPENSSL_VERSION_NUMBER >= 0x0090900f )
 
@@ -475,6 +505,252 @@ int PKI_X509_set_modified ( PKI_X509 *x ) {
 	return PKI_OK;
 };
 
+/*!
+ * \brief Sets the Modified bit (required in some crypto lib to force re-encoding)
+ *
+ * Every function that changes the internal value of a PKI_X509 object should
+ * call this function: it also drops the cached DER encoding and digests.
+ */
+
+int PKI_X509_set_modified ( PKI_X509 *x ) {
+
+	if ( !x || !x->value ) return PKI_ERR;
+
+	// The cached data refers to the previous contents
+	PKI_X509_CACHE_clear ( x );
+
+	return _set_encoding_modified ( x );
+}
+
+/* Returns the (locked) cache, allocates it on first use. The cache is
+ * not part of the object's value, so we can update it on const objects */
+// The cache lives as long as the object: from the bound arena only when
+// the object was allocated from it, from the heap otherwise. Returns the
+// arena to pass to PKI_ARENA_resume().
+static PKI_ARENA * _cache_alloc_begin(const PKI_X509 *x) {
+
+	PKI_ARENA * ret = PKI_ARENA_get_current();
+
+	if (ret && PKI_ARENA_find(x) != ret) PKI_ARENA_suspend();
+
+	return ret;
+}
+
+static struct pki_x509_cache_st * _cache_lock(const PKI_X509 *x) {
+
+	struct pki_x509_cache_st * cache = NULL;
+	struct pki_x509_cache_st * expected = NULL;
+	PKI_ARENA * arena = NULL;
+
+	if (!x || !x->value) return NULL;
+
+	// Only certificates, CRLs, and requests are cached: their contents
+	// change only via the PKI_X509 API. Keypairs are never cached to avoid
+	// extra copies of the private key.
+	switch (x->type) {
+		case PKI_DATATYPE_X509_CERT:
+		case PKI_DATATYPE_X509_CRL:
+		case PKI_DATATYPE_X509_REQ:
+			break;
+		default:
+			return NULL;
+	}
+
+	if ((cache = __atomic_load_n(&x->cache, __ATOMIC_ACQUIRE)) == NULL) {
+
+		arena = _cache_alloc_begin(x);
+		cache = PKI_Malloc(sizeof(struct pki_x509_cache_st));
+		PKI_ARENA_resume(arena);
+
+		if (cache == NULL) {
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			return NULL;
+		}
+		PKI_MUTEX_init(&cache->lock);
+
+		// Another thread might have installed its own cache
+		if (!__atomic_compare_exchange_n(&((PKI_X509 *)x)->cache, &expected,
+				cache, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			PKI_MUTEX_destroy(&cache->lock);
+			PKI_Free(cache);
+			cache = expected;
+		}
+	}
+
+	PKI_MUTEX_acquire(&cache->lock);
+
+	// The value was replaced without going through the PKI_X509 API
+	if (cache->value != x->value) {
+		if (cache->der) PKI_MEM_free(cache->der);
+		if (cache->tbs) PKI_MEM_free(cache->tbs);
+		cache->der = cache->tbs = NULL;
+		cache->digests_num = cache->digests_next = 0;
+		cache->value = x->value;
+	}
+
+	return cache;
+}
+
+/*! \brief Drops the cached encoding and digests of a PKI_X509 object */
+
+void PKI_X509_CACHE_clear ( PKI_X509 *x ) {
+
+	struct pki_x509_cache_st * cache = NULL;
+
+	if (!x || (cache = x->cache) == NULL) return;
+
+	PKI_MUTEX_acquire(&cache->lock);
+
+	if (cache->der) PKI_MEM_free(cache->der);
+	if (cache->tbs) PKI_MEM_free(cache->tbs);
+
+	cache->der = cache->tbs = NULL;
+	cache->digests_num = cache->digests_next = 0;
+	cache->value = NULL;
+
+	PKI_MUTEX_release(&cache->lock);
+}
+
+/* Fills the cached DER encoding (the cache must be locked) */
+static const PKI_MEM * _cache_der(const PKI_X509 *x, struct pki_x509_cache_st *cache) {
+
+	PKI_ARENA * arena = NULL;
+
+	if (!cache->der) {
+		// Makes sure the crypto library re-encodes the value once
+		_set_encoding_modified((PKI_X509 *)x);
+		arena = _cache_alloc_begin(x);
+		cache->der = PKI_X509_put_mem_value(x->value, x->type, NULL,
+			PKI_DATA_FORMAT_ASN1, NULL, x->hsm);
+		PKI_ARENA_resume(arena);
+	}
+
+	return cache->der;
+}
+
+/*! \brief Returns the (cached) DER encoding of a PKI_X509 object */
+
+const PKI_MEM * PKI_X509_get_der(const PKI_X509 *x) {
+
+	struct pki_x509_cache_st * cache = NULL;
+	const PKI_MEM * ret = NULL;
+
+	if ((cache = _cache_lock(x)) == NULL) return NULL;
+
+	ret = _cache_der(x, cache);
+
+	PKI_MUTEX_release(&cache->lock);
+
+	return ret;
+}
+
+/*!
+ * \brief Copies the (cached) DER encoding of a PKI_X509 object
+ *
+ * The encoding is copied while the cache is locked: in a new PKI_MEM if mem
+ * is NULL, in *mem if it is NULL or at the end of *mem otherwise. Returns
+ * NULL if the object can not be cached (or on error).
+ */
+
+PKI_MEM * PKI_X509_get_der_copy(const PKI_X509 *x, PKI_MEM **mem) {
+
+	struct pki_x509_cache_st * cache = NULL;
+	const PKI_MEM * der = NULL;
+	PKI_MEM * ret = NULL;
+
+	if ((cache = _cache_lock(x)) == NULL) return NULL;
+
+	if ((der = _cache_der(x, cache)) != NULL) {
+		if (mem == NULL) ret = PKI_MEM_new_data(der->size, der->data);
+		else if (*mem == NULL) ret = (*mem = PKI_MEM_new_data(der->size, der->data));
+		else if (PKI_MEM_add(*mem, der->data, der->size) == PKI_OK) ret = *mem;
+	}
+
+	PKI_MUTEX_release(&cache->lock);
+
+	return ret;
+}
+
+/*! \brief Returns a copy of a cached digest (NULL if not cached) */
+
+PKI_DIGEST * PKI_X509_CACHE_get_digest(const PKI_X509           * x,
+                                       PKI_X509_CACHE_DIGEST      type,
+                                       const PKI_DIGEST_ALG     * alg) {
+
+	struct pki_x509_cache_st * cache = NULL;
+	PKI_X509_CACHE_DIGEST_ENTRY * e = NULL;
+	PKI_DIGEST * ret = NULL;
+	int i = 0;
+
+	if (!alg || (cache = _cache_lock(x)) == NULL) return NULL;
+
+	for (i = 0; i < cache->digests_num; i++) {
+
+		// Fetched algorithms are matched by identifier, not by pointer
+		e = &cache->digests[i];
+		if (e->type != type || e->alg_id != EVP_MD_nid(alg)) continue;
+
+		if ((ret = PKI_Malloc(sizeof(PKI_DIGEST))) == NULL
+				|| (ret->digest = PKI_Malloc(e->size)) == NULL) {
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			if (ret) PKI_Free(ret);
+			ret = NULL;
+			break;
+		}
+
+		memcpy(ret->digest, e->value, e->size);
+		ret->size = e->size;
+		ret->algor = alg;
+		break;
+	}
+
+	PKI_MUTEX_release(&cache->lock);
+
+	return ret;
+}
+
+/*! \brief Stores a digest in the object's cache */
+
+int PKI_X509_CACHE_set_digest(const PKI_X509        * x,
+                              PKI_X509_CACHE_DIGEST   type,
+                              const PKI_DIGEST      * digest) {
+
+	struct pki_x509_cache_st * cache = NULL;
+	PKI_X509_CACHE_DIGEST_ENTRY * e = NULL;
+	int i = 0;
+
+	if (!digest || !digest->algor || !digest->digest 
+			|| digest->size > EVP_MAX_MD_SIZE) {
+		return PKI_ERR;
+	}
+
+	if ((cache = _cache_lock(x)) == NULL) return PKI_ERR;
+
+	// Replaces the existing entry, if any
+	for (i = 0; i < cache->digests_num; i++) {
+		if (cache->digests[i].type == type
+				&& cache->digests[i].alg_id == EVP_MD_nid(digest->algor)) {
+			e = &cache->digests[i];
+			break;
+		}
+	}
+
+	if (!e) {
+		e = &cache->digests[cache->digests_next];
+		cache->digests_next = (cache->digests_next + 1) % PKI_X509_CACHE_DIGEST_SIZE;
+		if (cache->digests_num < PKI_X509_CACHE_DIGEST_SIZE) cache->digests_num++;
+	}
+
+	e->type = type;
+	e->alg_id = EVP_MD_nid(digest->algor);
+	e->size = digest->size;
+	memcpy(e->value, digest->digest, digest->size);
+
+	PKI_MUTEX_release(&cache->lock);
+
+	return PKI_OK;
+}
+
 /*! \brief Returns the type of a PKI_X509 object */
 
 PKI_DATATYPE PKI_X509_get_type(const PKI_X509 *x) {
@@ -570,6 +846,8 @@ int PKI_X509_set_value ( PKI_X509 *x, void *data ) {
 		x->cb->free ( x->value );
 	}
 
+	PKI_X509_CACHE_clear ( x );
+
 	x->value = data;
 
 	return PKI_OK;
@@ -605,6 +883,9 @@ PKI_X509 * PKI_X509_dup (const PKI_X509 *x ) {
 
 	memcpy ( ret, x, sizeof ( PKI_X509 ));
 
+	// The cache is rebuilt on demand for the new object
+	ret->cache = NULL;
+
 	if( x->value )
 	{
 		ret->value = PKI_X509_dup_value(x);
@@ -698,9 +979,30 @@ PKI_MEM * PKI_X509_VALUE_get_tbs_asn1(const void         * v,
 
 
 PKI_MEM * PKI_X509_get_tbs_asn1(const PKI_X509 *x) {
-	
-	return PKI_X509_VALUE_get_tbs_asn1(x->value, x->type);
 
+	struct pki_x509_cache_st * cache = NULL;
+	PKI_ARENA * arena = NULL;
+	PKI_MEM * ret = NULL;
+
+	if (!x || !x->value) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	// Objects that can not be cached are encoded every time
+	if ((cache = _cache_lock(x)) == NULL)
+		return PKI_X509_VALUE_get_tbs_asn1(x->value, x->type);
+
+	if (!cache->tbs) {
+		arena = _cache_alloc_begin(x);
+		cache->tbs = PKI_X509_VALUE_get_tbs_asn1(x->value, x->type);
+		PKI_ARENA_resume(arena);
+	}
+	if (cache->tbs) ret = PKI_MEM_dup(cache->tbs);
+
+	PKI_MUTEX_release(&cache->lock);
+
+	return ret;
 }
 
 void * PKI_X509_get_parsed(const PKI_X509 *x, PKI_X509_DATA type ) {
@@ -754,6 +1056,9 @@ int PKI_X509_detach(PKI_X509 * x, void ** data, PKI_DATATYPE * type, HSM **hsm)
 	// Input Checks
 	if (!x || !data) return PKI_ERR;
 
+	// Cached data refers to the detached value
+	PKI_X509_CACHE_clear(x);
+
 	// Sets the output values
 	if (data) {
 		*data = x->value;
@@ -799,6 +1104,9 @@ int PKI_X509_attach(PKI_X509 * x, PKI_DATATYPE type, void * data, HSM * hsm) {
 	// Sets the type of value
 	x->type = type;
 
+	// Cached data refers to the current value
+	PKI_X509_CACHE_clear(x);
+
 	// Frees the current value, if any
 	if (x->value) {
 		if (x->cb->free)
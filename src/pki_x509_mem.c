@@ -4,8 +4,44 @@
 
 /* Static function for managing read callbacks for auto format downloading */
 
-static void * __get_data_callback (PKI_MEM *io, const PKI_X509_CALLBACKS *cb,
-				PKI_DATA_FORMAT format, PKI_CRED *cred);
+static void * __get_data_callback (PKI_MEM *io, PKI_DATATYPE type,
+				const PKI_X509_CALLBACKS *cb, PKI_DATA_FORMAT format,
+				PKI_CRED *cred);
+
+/* PEM labels and the type of the encapsulated objects */
+
+typedef struct pki_x509_pem_label_st {
+	PKI_DATATYPE type;
+	const char * label;
+	// If the decoded data can be read via the DER callback
+	int der;
+} PKI_X509_PEM_LABEL;
+
+/* PEM callback only (e.g., encrypted keys) */
+#define PKI_PEM_LABEL_DER_NONE		0
+/* DER callback */
+#define PKI_PEM_LABEL_DER		1
+/* DER callback, unless there is auxiliary data (e.g., trust settings) */
+#define PKI_PEM_LABEL_DER_NOAUX		2
+
+static const PKI_X509_PEM_LABEL __pem_labels[] = {
+	{ PKI_DATATYPE_X509_CERT, "CERTIFICATE", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_CERT, "X509 CERTIFICATE", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_CERT, "TRUSTED CERTIFICATE", PKI_PEM_LABEL_DER_NOAUX },
+	{ PKI_DATATYPE_X509_CRL, "X509 CRL", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_REQ, "CERTIFICATE REQUEST", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_REQ, "NEW CERTIFICATE REQUEST", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_PKCS7, "PKCS7", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_CMS, "CMS", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_CMS, "PKCS7", PKI_PEM_LABEL_DER },
+	{ PKI_DATATYPE_X509_KEYPAIR, "PRIVATE KEY", PKI_PEM_LABEL_DER_NONE },
+	{ PKI_DATATYPE_X509_KEYPAIR, "ENCRYPTED PRIVATE KEY", PKI_PEM_LABEL_DER_NONE },
+	{ PKI_DATATYPE_X509_KEYPAIR, "RSA PRIVATE KEY", PKI_PEM_LABEL_DER_NONE },
+	{ PKI_DATATYPE_X509_KEYPAIR, "EC PRIVATE KEY", PKI_PEM_LABEL_DER_NONE },
+	{ PKI_DATATYPE_X509_KEYPAIR, "DSA PRIVATE KEY", PKI_PEM_LABEL_DER_NONE },
+	{ PKI_DATATYPE_X509_KEYPAIR, "PUBLIC KEY", PKI_PEM_LABEL_DER_NONE },
+	{ PKI_DATATYPE_UNKNOWN, NULL, PKI_PEM_LABEL_DER_NONE }
+};
 
 /* -------------------------- X509 mem Operations -------------------- */
 
@@ -47,8 +83,73 @@ void * PKI_X509_get_mem_value ( PKI_MEM *mem, PKI_DATATYPE type,
 }
 
 
-static void * __get_data_callback(PKI_MEM *mem, const PKI_X509_CALLBACKS *cb,
-				PKI_DATA_FORMAT format, PKI_CRED *cred ) {
+// Reads the DER value of a PEM block via the DER callback, returns NULL
+// if the object type (or the block) requires the PEM callback instead
+static void * __get_pem_der_data(const PKI_MEM *der, const char *label,
+				PKI_DATATYPE type, const PKI_X509_CALLBACKS *cb) {
+
+	const PKI_X509_PEM_LABEL *pl = NULL;
+	PKI_IO *ro = NULL;
+	void *ret = NULL;
+
+	if (!cb->read_der) return NULL;
+
+	for (pl = __pem_labels; pl->label != NULL; pl++) {
+		if (pl->type == type && pl->der != PKI_PEM_LABEL_DER_NONE
+				&& strcmp(pl->label, label) == 0) break;
+	}
+	if (!pl->label) return NULL;
+
+	// Auxiliary data (e.g., trust settings) requires the PEM callback,
+	// the DER value must be the whole content
+	if (pl->der == PKI_PEM_LABEL_DER_NOAUX) {
+		const unsigned char *p = der->data;
+		long len = 0;
+		int tag = 0, xclass = 0;
+
+		if ((ASN1_get_object(&p, &len, &tag, &xclass, (long) der->size) & 0x81) != 0
+				|| (size_t) (p - der->data) + (size_t) len != der->size) return NULL;
+	}
+
+	if ((ro = BIO_new_mem_buf(der->data, (int) der->size)) != NULL) {
+		ret = cb->read_der(ro, NULL);
+		BIO_free_all(ro);
+	}
+
+	return ret;
+}
+
+// Decodes the first PEM block and uses the DER callback, returns NULL
+// if the object type (or the block) requires the PEM callback instead
+static void * __get_pem_data(PKI_MEM *mem, PKI_DATATYPE type,
+				const PKI_X509_CALLBACKS *cb) {
+
+	char label[64];
+	const PKI_X509_PEM_LABEL *pl = NULL;
+	PKI_MEM *der = NULL;
+	void *ret = NULL;
+
+	if (!cb->read_der) return NULL;
+
+	// Object types with a DER equivalent for their PEM labels only
+	for (pl = __pem_labels; pl->label != NULL; pl++) {
+		if (pl->type == type && pl->der != PKI_PEM_LABEL_DER_NONE) break;
+	}
+	if (!pl->label) return NULL;
+
+	if ((der = PKI_MEM_get_pem_decoded(mem, label, sizeof(label))) == NULL)
+		return NULL;
+
+	ret = __get_pem_der_data(der, label, type, cb);
+
+	PKI_MEM_free(der);
+
+	return ret;
+}
+
+static void * __get_data_callback(PKI_MEM *mem, PKI_DATATYPE type,
+				const PKI_X509_CALLBACKS *cb, PKI_DATA_FORMAT format,
+				PKI_CRED *cred ) {
 
 	PKI_IO *ro = NULL;
 
@@ -79,6 +180,10 @@ static void * __get_data_callback(PKI_MEM *mem, const PKI_X509_CALLBACKS *cb,
 	switch ( format )
 	{
 		case PKI_DATA_FORMAT_PEM: {
+			// Common PEM objects are decoded directly, the PEM
+			// callback handles the others (e.g., encrypted keys)
+			if ((ret = __get_pem_data(mem, type, cb)) != NULL) break;
+
 			if( cb->read_pem ) {
 				// Read PEM formatted data
 				ret = cb->read_pem(ro, NULL, NULL, pwd);
@@ -116,27 +221,12 @@ static void * __get_data_callback(PKI_MEM *mem, const PKI_X509_CALLBACKS *cb,
 
 			} else if (cb->read_der) {
 
-				// Temporary Duplicate Memory
-				PKI_MEM * dup_mem = NULL;
+				// Decoded data (line breaks are skipped)
+				PKI_MEM * der = NULL;
 
-				// We need to duplicate the buffer as PKI_MEM_decode()
-				// alter the contents of the buffer
-				if ((dup_mem = PKI_MEM_dup(mem)) == NULL) {
-					// Here we duplicate the data to avoid issues with
-					// the double decoding (if the first fails the data
-					// would be altered, we want to be able to work on
-					// the original data)
-					PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
-					break;
-				}
-
-				if (PKI_MEM_decode(dup_mem, PKI_DATA_FORMAT_B64, 1) == PKI_ERR &&
-					PKI_MEM_decode(dup_mem, PKI_DATA_FORMAT_B64, 0) == PKI_ERR) {
+				if ((der = PKI_MEM_get_b64_decoded(mem, 1)) == NULL) {
 					// Can not B64 decode
 					PKI_ERROR(PKI_ERR_DATA_FORMAT_UNKNOWN, NULL);
-					// Free Memory
-					PKI_MEM_free(dup_mem);
-					// All Done
 					break;
 				}
 
@@ -144,28 +234,31 @@ static void * __get_data_callback(PKI_MEM *mem, const PKI_X509_CALLBACKS *cb,
 				BIO_free_all(ro);
 				ro = NULL;
 
-				// Checks we have data to duplicate, if not, we are done
-				if (!dup_mem->data || dup_mem->size <= 0) break;
+				// Checks we have data to read, if not, we are done
+				if (der->size <= 0) {
+					PKI_MEM_free(der);
+					break;
+				}
 
 				// Create a read only memory buffer for further usage it's faster
 				// than a read/write one
-				if ((ro = BIO_new_mem_buf(dup_mem->data, 
-										(int)dup_mem->size)) == NULL) {
+				if ((ro = BIO_new_mem_buf(der->data, (int)der->size)) == NULL) {
 					// Error, can not allocate another RO BIO
 					PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 					// Free Memory
-					PKI_MEM_free(dup_mem);
-					dup_mem = NULL; //Safety
+					PKI_MEM_free(der);
 					break;
 				}
 
-				// Free Memory
-				if (dup_mem) PKI_MEM_free(dup_mem);
-
 				// And use the DER reader to retrieve the
 				// requested object
 				ret = cb->read_der(ro, NULL);
 
+				// The BIO does not copy the data
+				BIO_free_all(ro);
+				ro = NULL;
+				PKI_MEM_free(der);
+
 			} else {
 				// No support for data decoding
 				PKI_DEBUG("No Callback for B64 decoding");
@@ -200,6 +293,132 @@ static void * __get_data_callback(PKI_MEM *mem, const PKI_X509_CALLBACKS *cb,
 	return ret;
 }
 
+// Copies the label of the first PEM block, returns 0 if there is none
+static int __pem_label(const unsigned char *data, size_t size,
+				char *label, size_t label_size) {
+
+	static const char begin[] = "-----BEGIN ";
+	size_t i = 0, j = 0;
+
+	for (i = 0; i + sizeof(begin) - 1 <= size; i++) {
+
+		if ((i > 0 && data[i-1] != '\n') || data[i] != '-'
+				|| memcmp(data + i, begin, sizeof(begin) - 1) != 0) continue;
+
+		// The label ends with the dashes, on the same line
+		for (i += sizeof(begin) - 1, j = 0; i < size && j < label_size - 1; i++, j++) {
+			if (data[i] == '-' || data[i] == '\n') break;
+			label[j] = (char) data[i];
+		}
+		label[j] = '\x0';
+
+		return (i < size && data[i] == '-' && j > 0);
+	}
+
+	return 0;
+}
+
+// Checks for the PKCS#12 PFX structure (version 3, then the authSafe
+// content info of type data or signedData)
+static int __der_is_pkcs12(const unsigned char *data, size_t size) {
+
+	static const unsigned char version[] = { 0x02, 0x01, 0x03 };
+	static const unsigned char p7_oid[] = { 0x06, 0x09, 0x2A, 0x86, 0x48,
+						0x86, 0xF7, 0x0D, 0x01, 0x07 };
+	const unsigned char *p = data;
+	long len = 0;
+	int tag = 0, xclass = 0;
+
+	// Outer SEQUENCE
+	if (ASN1_get_object(&p, &len, &tag, &xclass, (long) size) & 0x80) return 0;
+
+	if ((size_t)(p - data) + sizeof(version) > size
+			|| memcmp(p, version, sizeof(version)) != 0) return 0;
+	p += sizeof(version);
+
+	// AuthSafe (ContentInfo)
+	if (ASN1_get_object(&p, &len, &tag, &xclass, (long) (size - (size_t)(p - data))) & 0x80
+			|| tag != V_ASN1_SEQUENCE) return 0;
+
+	if ((size_t)(p - data) + sizeof(p7_oid) + 1 > size
+			|| memcmp(p, p7_oid, sizeof(p7_oid)) != 0) return 0;
+
+	return (p[sizeof(p7_oid)] == 0x01 || p[sizeof(p7_oid)] == 0x02);
+}
+
+/*!
+ * \brief Detects the format of the data in a PKI_MEM
+ *
+ * Only the first bytes (or the PEM labels) are inspected, the data is
+ * not decoded. When type is not NULL, it is set to the type of object
+ * when it can be inferred (PEM labels, PKCS#12 structures), otherwise
+ * to PKI_DATATYPE_UNKNOWN.
+ *
+ * @return the detected format, or PKI_DATA_FORMAT_UNKNOWN
+ */
+
+PKI_DATA_FORMAT PKI_X509_get_mem_format(const PKI_MEM *mem, PKI_DATATYPE *type) {
+
+	const PKI_X509_PEM_LABEL *pl = NULL;
+	const unsigned char *data = NULL, *p = NULL;
+	char label[64];
+	size_t size = 0, i = 0;
+	long len = 0;
+	int tag = 0, xclass = 0, ret = 0;
+
+	if (type) *type = PKI_DATATYPE_UNKNOWN;
+
+	if (!mem || !mem->data || mem->size <= 0) return PKI_DATA_FORMAT_UNKNOWN;
+
+	data = mem->data;
+	size = mem->size;
+
+	// DER: a SEQUENCE that covers all the data (or of indefinite length)
+	if (data[0] == (V_ASN1_CONSTRUCTED | V_ASN1_SEQUENCE)) {
+		p = data;
+		ret = ASN1_get_object(&p, &len, &tag, &xclass, (long) size);
+		if (!(ret & 0x80) && ((ret & 0x01) || (size_t)(p - data) + (size_t) len == size)) {
+			if (type && __der_is_pkcs12(data, size)) *type = PKI_DATATYPE_X509_PKCS12;
+			return PKI_DATA_FORMAT_ASN1;
+		}
+	}
+
+	// PEM: anywhere in the data (e.g., after the text version)
+	if (__pem_label(data, size, label, sizeof(label))) {
+		if (type) {
+			for (pl = __pem_labels; pl->label != NULL; pl++) {
+				if (strcmp(pl->label, label) == 0) break;
+			}
+			*type = pl->type;
+		}
+		return PKI_DATA_FORMAT_PEM;
+	}
+
+	// Skips the leading blanks
+	while (size > 0 && isspace(*data)) {
+		data++;
+		size--;
+	}
+	if (size == 0) return PKI_DATA_FORMAT_UNKNOWN;
+
+	if (data[0] == '<') return PKI_DATA_FORMAT_XML;
+
+	// B64 or text (the first 1k chars are inspected)
+	if (size > 1024) size = 1024;
+
+	for (i = 0; i < size; i++) {
+		if (!isalnum(data[i]) && data[i] != '+' && data[i] != '/'
+				&& data[i] != '=' && !isspace(data[i])) break;
+	}
+	if (i == size) return PKI_DATA_FORMAT_B64;
+
+	for ( ; i < size; i++) {
+		if (!isprint(data[i]) && !isspace(data[i])) return PKI_DATA_FORMAT_UNKNOWN;
+	}
+
+	return PKI_DATA_FORMAT_TXT;
+}
+
 /*! \brief Returns a stack of objects read from the passed PKI_MEM */
 
 PKI_X509_STACK *PKI_X509_STACK_get_mem ( PKI_MEM *mem, PKI_DATATYPE type,
@@ -214,6 +433,9 @@ PKI_X509_STACK *PKI_X509_STACK_get_mem ( PKI_MEM *mem, PKI_DATATYPE type,
 	// Checks for valid input
 	if( !mem || mem->size <= 0 ) return NULL;
 
+	// Loads the providers and the PQC/Composite methods
+	PKI_init_crypto_methods();
+
 	if((cb = PKI_X509_CALLBACKS_get(type, hsm)) == NULL)
 	{
 		// We have not found the callbacks - we can not proceed
@@ -242,20 +464,27 @@ PKI_X509_STACK *PKI_X509_STACK_get_mem ( PKI_MEM *mem, PKI_DATATYPE type,
 		return NULL;
 	}
 
+	// Fix for older applications using -1 as format
+	if (format == 4294967295) {
+		PKI_DEBUG("Wrong DATA format used in application (-1),"
+			"please replace with PKI_DATA_FORMAT_UNKNOWN (%d)", 
+			PKI_DATA_FORMAT_UNKNOWN);
+	}
+
+	// Detects the format instead of trying all the decoders
+	if (format == 4294967295 || format == PKI_DATA_FORMAT_UNKNOWN) {
+		format = PKI_X509_get_mem_format(mem, NULL);
+		PKI_DEBUG("Detected data format %d for object type %d", format, type);
+	}
+
 	// We cycle through the different data types we support to enable
-	// automatic data conversion on load.
+	// automatic data conversion on load (when the format could not be
+	// detected)
 	//
 	// NOTE: we start from 1 as this is the first valid one after the
 	//       unknown datatype (PKI_DATATYPE_UNKNOW)
 	for (i = PKI_DATA_FORMAT_START; i < PKI_DATA_FORMAT_END; i++) {
 
-			// Fix for older applications using -1 as format
-		if (format == 4294967295) {
-			PKI_DEBUG("Wrong DATA format used in application (-1),"
-				"please replace with PKI_DATA_FORMAT_UNKNOWN (%d)", 
-				PKI_DATA_FORMAT_UNKNOWN);
-		}
-
 		// A Format was selected, so we skip the others
 		if (format != 4294967295 && 
 		    format != PKI_DATA_FORMAT_UNKNOWN && 
@@ -265,7 +494,7 @@ PKI_X509_STACK *PKI_X509_STACK_get_mem ( PKI_MEM *mem, PKI_DATATYPE type,
 		    continue;
 		}
 
-		if ((x_obj->value = __get_data_callback(mem, cb, i, cred)) != NULL) {
+		if ((x_obj->value = __get_data_callback(mem, type, cb, i, cred)) != NULL) {
 
 			// Let's add the right properties to the object
 			x_obj->cred = PKI_CRED_dup(cred);
@@ -291,12 +520,298 @@ PKI_X509_STACK *PKI_X509_STACK_get_mem ( PKI_MEM *mem, PKI_DATATYPE type,
 	return NULL;
 }
 
+/* Object (PEM block or DER value) found by the bulk loader */
+
+typedef struct pki_x509_bulk_item_st {
+	PKI_MEM data;
+	int pem;
+	PKI_X509 *x;
+	unsigned char md[SHA256_DIGEST_LENGTH];
+} PKI_X509_BULK_ITEM;
+
+typedef struct pki_x509_bulk_job_st {
+	PKI_X509_BULK_ITEM *items;
+	size_t first;
+	size_t num;
+	PKI_DATATYPE type;
+	const PKI_X509_CALLBACKS *cb;
+	PKI_CRED *cred;
+	HSM *hsm;
+} PKI_X509_BULK_JOB;
+
+// Splits the data at the PEM blocks boundaries (single scan), returns
+// the number of blocks found
+static size_t __bulk_split_pem(const PKI_MEM *mem, PKI_X509_BULK_ITEM **items) {
+
+	static const char begin[] = "-----BEGIN ";
+	static const char end[] = "-----END ";
+	const unsigned char *data = mem->data, *line = NULL, *nl = NULL;
+	const unsigned char *start = NULL, *last = mem->data + mem->size;
+	PKI_X509_BULK_ITEM *tmp = NULL;
+	size_t num = 0, size = 0;
+
+	for (line = data; line < last; line = nl + 1) {
+
+		if ((nl = memchr(line, '\n', (size_t)(last - line))) == NULL) nl = last - 1;
+
+		if (*line != '-') continue;
+
+		if (!start) {
+			if ((size_t)(nl - line) >= sizeof(begin) - 1
+					&& memcmp(line, begin, sizeof(begin) - 1) == 0) start = line;
+			continue;
+		}
+
+		if ((size_t)(nl - line) < sizeof(end) - 1
+				|| memcmp(line, end, sizeof(end) - 1) != 0) continue;
+
+		if (num == size) {
+			size = size ? size * 2 : 64;
+			if ((tmp = PKI_Malloc(size * sizeof(PKI_X509_BULK_ITEM))) == NULL) break;
+			if (*items) {
+				memcpy(tmp, *items, num * sizeof(PKI_X509_BULK_ITEM));
+				PKI_Free(*items);
+			}
+			*items = tmp;
+		}
+
+		(*items)[num].data.data = (unsigned char *) start;
+		(*items)[num].data.size = (size_t)(nl - start) + 1;
+		(*items)[num++].pem = 1;
+		start = NULL;
+	}
+
+	return num;
+}
+
+// Splits concatenated DER values (definite length only), returns the
+// number of values found
+static size_t __bulk_split_der(const PKI_MEM *mem, PKI_X509_BULK_ITEM **items) {
+
+	const unsigned char *p = mem->data, *obj = NULL, *last = mem->data + mem->size;
+	PKI_X509_BULK_ITEM *tmp = NULL;
+	size_t num = 0, size = 0;
+	long len = 0;
+	int tag = 0, xclass = 0;
+
+	while (p < last) {
+
+		obj = p;
+		if (ASN1_get_object(&p, &len, &tag, &xclass, (long)(last - p)) & 0x81) break;
+		if ((size_t) len > (size_t)(last - p)) break;
+		p += len;
+
+		if (num == size) {
+			size = size ? size * 2 : 64;
+			if ((tmp = PKI_Malloc(size * sizeof(PKI_X509_BULK_ITEM))) == NULL) break;
+			if (*items) {
+				memcpy(tmp, *items, num * sizeof(PKI_X509_BULK_ITEM));
+				PKI_Free(*items);
+			}
+			*items = tmp;
+		}
+
+		(*items)[num].data.data = (unsigned char *) obj;
+		(*items)[num].data.size = (size_t)(p - obj);
+		(*items)[num++].pem = 0;
+	}
+
+	return num;
+}
+
+// Decodes the items of a job and calculates their fingerprints (the
+// SHA-256 of the DER value, or of the PEM block when it can not be
+// decoded directly)
+static void * __bulk_job(void *arg) {
+
+	PKI_X509_BULK_JOB *job = (PKI_X509_BULK_JOB *) arg;
+	PKI_X509_BULK_ITEM *item = NULL;
+	const PKI_MEM *md_data = NULL;
+	PKI_MEM *der = NULL;
+	EVP_MD_CTX *ctx = NULL;
+	char label[64];
+	void *value = NULL;
+	size_t i = 0;
+
+	if ((ctx = EVP_MD_CTX_new()) == NULL) return NULL;
+
+	for (i = job->first; i < job->first + job->num; i++) {
+
+		item = &job->items[i];
+		md_data = &item->data;
+		value = NULL;
+		der = NULL;
+
+		if (item->pem) {
+			if ((der = PKI_MEM_get_pem_decoded(&item->data, label, sizeof(label))) != NULL) {
+				value = __get_pem_der_data(der, label, job->type, job->cb);
+				md_data = der;
+			}
+			if (!value) value = __get_data_callback(&item->data, job->type, job->cb,
+							PKI_DATA_FORMAT_PEM, job->cred);
+		} else {
+			value = __get_data_callback(&item->data, job->type, job->cb,
+							PKI_DATA_FORMAT_ASN1, job->cred);
+		}
+
+		if (value && (item->x = PKI_X509_new_value(job->type, value, job->hsm)) != NULL) {
+			item->x->cred = PKI_CRED_dup(job->cred);
+			item->x->hsm = job->hsm;
+			if (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1
+					|| EVP_DigestUpdate(ctx, md_data->data, md_data->size) != 1
+					|| EVP_DigestFinal_ex(ctx, item->md, NULL) != 1) {
+				PKI_X509_free(item->x);
+				item->x = NULL;
+			}
+		} else if (value) {
+			job->cb->free(value);
+		}
+
+		if (der) PKI_MEM_free(der);
+	}
+
+	EVP_MD_CTX_free(ctx);
+
+	return NULL;
+}
+
+/*!
+ * \brief Returns all the objects from a PEM bundle or a sequence of DER values
+ *
+ * The data is split at the objects boundaries in a single scan, then the
+ * objects are decoded in parallel by 'threads' threads (when <= 0, one
+ * per online processor). Duplicated objects (same SHA-256 fingerprint)
+ * are returned once, in the order of their first occurrence.
+ *
+ * Only the PKI_DATA_FORMAT_PEM, PKI_DATA_FORMAT_ASN1 and
+ * PKI_DATA_FORMAT_UNKNOWN (detected) formats are split, the others are
+ * read via PKI_X509_STACK_get_mem().
+ *
+ * @return the stack of objects, or NULL if no object could be read
+ */
+
+PKI_X509_STACK *PKI_X509_STACK_get_mem_bulk ( PKI_MEM *mem, PKI_DATATYPE type,
+			PKI_DATA_FORMAT format, int threads, PKI_CRED *cred, HSM *hsm ) {
+
+	PKI_X509_BULK_JOB jobs[PKI_X509_BULK_MAX_THREADS];
+	PKI_THREAD *th[PKI_X509_BULK_MAX_THREADS];
+	PKI_X509_BULK_ITEM *items = NULL;
+	PKI_X509_STACK *sk = NULL;
+	const PKI_X509_CALLBACKS *cb = NULL;
+	size_t num = 0, per_job = 0, first = 0, i = 0, j = 0, mask = 0;
+	size_t *set = NULL;
+	int n = 0, k = 0;
+
+	if (!mem || !mem->data || mem->size <= 0) return NULL;
+
+	// Loads the providers and the PQC/Composite methods (before the
+	// decoding threads are started)
+	PKI_init_crypto_methods();
+
+	if ((cb = PKI_X509_CALLBACKS_get(type, hsm)) == NULL) {
+		PKI_log_debug("Object type not supported [%d]", type);
+		return NULL;
+	}
+
+	if (format == 4294967295 || format == PKI_DATA_FORMAT_UNKNOWN) {
+		// Concatenated DER values are not detected as PKI_DATA_FORMAT_ASN1
+		format = (mem->data[0] == (V_ASN1_CONSTRUCTED | V_ASN1_SEQUENCE) ?
+				PKI_DATA_FORMAT_ASN1 : PKI_X509_get_mem_format(mem, NULL));
+	}
+
+	if (format == PKI_DATA_FORMAT_PEM) num = __bulk_split_pem(mem, &items);
+	else if (format == PKI_DATA_FORMAT_ASN1) num = __bulk_split_der(mem, &items);
+
+	// Nothing to split, uses the generic loader
+	if (num == 0) {
+		if (items) PKI_Free(items);
+		return PKI_X509_STACK_get_mem(mem, type, format, cred, hsm);
+	}
+
+	if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	if (threads > PKI_X509_BULK_MAX_THREADS) threads = PKI_X509_BULK_MAX_THREADS;
+	if ((size_t) threads > (num + PKI_X509_BULK_MIN_OBJECTS - 1) / PKI_X509_BULK_MIN_OBJECTS)
+		threads = (int) ((num + PKI_X509_BULK_MIN_OBJECTS - 1) / PKI_X509_BULK_MIN_OBJECTS);
+
+	per_job = (num + (size_t) threads - 1) / (size_t) threads;
+
+	for (n = 0, first = 0; first < num; n++, first += per_job) {
+		jobs[n].items = items;
+		jobs[n].first = first;
+		jobs[n].num = (num - first < per_job ? num - first : per_job);
+		jobs[n].type = type;
+		jobs[n].cb = cb;
+		jobs[n].cred = cred;
+		jobs[n].hsm = hsm;
+		th[n] = NULL;
+	}
+
+	// The calling thread takes the first job
+	for (k = 1; k < n; k++) th[k] = PKI_THREAD_new(__bulk_job, &jobs[k]);
+	__bulk_job(&jobs[0]);
+
+	for (k = 1; k < n; k++) {
+		if (th[k]) {
+			PKI_THREAD_join(th[k], NULL);
+			PKI_Free(th[k]);
+		} else {
+			// Could not start the thread, runs the job here
+			__bulk_job(&jobs[k]);
+		}
+	}
+
+	// Removes the duplicates (open addressing on the fingerprints)
+	for (mask = 1; mask < num * 2; mask <<= 1);
+	if ((set = PKI_Malloc(mask * sizeof(size_t))) == NULL
+			|| (sk = PKI_STACK_X509_new()) == NULL
+			|| PKI_STACK_reserve(sk, (int) num) != PKI_OK) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		for (i = 0; i < num; i++) if (items[i].x) PKI_X509_free(items[i].x);
+		if (sk) PKI_STACK_X509_free(sk);
+		if (set) PKI_Free(set);
+		PKI_Free(items);
+		return NULL;
+	}
+	mask--;
+
+	for (i = 0; i < num; i++) {
+
+		if (!items[i].x) continue;
+
+		// Slots store the item index + 1 (0 is empty)
+		memcpy(&j, items[i].md, sizeof(size_t));
+		for (j &= mask; set[j] != 0; j = (j + 1) & mask) {
+			if (memcmp(items[set[j] - 1].md, items[i].md, SHA256_DIGEST_LENGTH) == 0) break;
+		}
+
+		if (set[j] != 0) {
+			PKI_X509_free(items[i].x);
+			continue;
+		}
+
+		set[j] = i + 1;
+		PKI_STACK_X509_push(sk, items[i].x);
+	}
+
+	PKI_Free(set);
+	PKI_Free(items);
+
+	if (PKI_STACK_X509_elements(sk) <= 0) {
+		PKI_STACK_X509_free(sk);
+		return NULL;
+	}
+
+	return sk;
+}
+
 /*! \brief Writes a PKI_X509 object to a PKI_MEM structure */
 
 PKI_MEM *PKI_X509_put_mem (PKI_X509 *x, PKI_DATA_FORMAT format, 
 				PKI_MEM **mem, PKI_CRED *cred ) {
 
 	PKI_DATATYPE type = PKI_DATATYPE_UNKNOWN;
+	PKI_MEM *ret = NULL;
 
 	// Checks the input
 	if (!x || !x->value)
@@ -320,8 +835,16 @@ PKI_MEM *PKI_X509_put_mem (PKI_X509 *x, PKI_DATA_FORMAT format,
 		return NULL;
 	}
 
-	// We need to be sure that the data structures are properly updated
-	PKI_X509_set_modified ( x );
+	// DER output is copied from (and fills) the cached encoding, which
+	// is dropped whenever the object is modified via the PKI_X509 API
+	if ((format == PKI_DATA_FORMAT_ASN1 || format == PKI_DATA_FORMAT_URL)
+			&& (ret = PKI_X509_get_der_copy(x, mem)) != NULL) return ret;
+
+	// Objects with a cached encoding were re-encoded when the cache was
+	// filled: writing them is a read (the cache is kept and the crypto
+	// library's encoding is not marked as modified again). The others
+	// are re-encoded every time.
+	if (PKI_X509_get_der(x) == NULL) PKI_X509_set_modified ( x );
 
 	// Returns the actual PKI_MEM with the encoded value
 	return PKI_X509_put_mem_value ( x->value, type, mem, 
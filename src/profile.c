@@ -31,6 +31,9 @@ PKI_X509_PROFILE * PKI_X509_PROFILE_load(const char *urlPath) {
      */
     LIBXML_TEST_VERSION
 
+    // Initializes the XML parser (first use only)
+    PKI_init_subsystem(PKI_INIT_SUBSYSTEM_XML);
+
     if (urlPath) {
         url = URL_new(urlPath);
     } else {
@@ -98,6 +101,9 @@ PKI_X509_PROFILE *PKI_X509_PROFILE_new(const char *name) {
 
 	if ( !name ) return NULL;
 
+	// Initializes the XML parser (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_XML);
+
 	doc = xmlNewDoc( BAD_CAST "1.0");
 
 	// root_node = xmlNewNode(NULL, BAD_CAST PKI_NAMESPACE_PREFIX ":profile");
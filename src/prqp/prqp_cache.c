@@ -0,0 +1,542 @@
+/* PKI Resource Query Protocol - Service Map Cache
+ * (c) 2006-2010 by Massimiliano Pala and OpenCA Group
+ * All Rights Reserved
+ *
+ * This software is released under the GPL2 License included
+ * in the archive. You can not remove this copyright notice.
+ */
+
+#include <libpki/pki.h>
+
+/*
+ * NOTE: the cache outlives the single requests, its memory is allocated
+ *       with malloc()/calloc() directly so it is never taken from a
+ *       request arena. The returned stacks are copies.
+ */
+
+typedef struct prqp_cache_srv_st {
+	char * name;
+	char ** urls;
+	int urls_num;
+	time_t expires;
+	time_t refresh_at;
+	/* Used since the last fetch (only used entries are refreshed) */
+	int used;
+	int refreshing;
+	struct prqp_cache_srv_st * next;
+} PRQP_CACHE_SRV;
+
+typedef struct prqp_cache_ca_st {
+	CERT_IDENTIFIER * ca_id;
+	/* Reference to the CA certificate, for the refresh requests */
+	X509 * ca_cert;
+	/* RQA address (NULL for the configured ones) */
+	char * rqa;
+	time_t last_used;
+	PRQP_CACHE_SRV * services;
+	struct prqp_cache_ca_st * next;
+} PRQP_CACHE_CA;
+
+static pthread_mutex_t _prqp_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _prqp_cache_cond = PTHREAD_COND_INITIALIZER;
+
+static PRQP_CACHE_CA * _prqp_cache = NULL;
+static int _prqp_cache_num = 0;
+static int _prqp_cache_ttl = PKI_PRQP_CACHE_DEFAULT_TTL;
+
+static PKI_THREAD _prqp_refresher;
+static int _prqp_refresher_running = 0;
+static int _prqp_refresher_stop = 0;
+
+// ==================
+// Entries Management
+// ==================
+
+static void _srv_free(PRQP_CACHE_SRV *s) {
+
+	int i = 0;
+
+	for (i = 0; i < s->urls_num; i++) free(s->urls[i]);
+
+	free(s->urls);
+	free(s->name);
+	free(s);
+}
+
+static void _ca_free(PRQP_CACHE_CA *ca) {
+
+	PRQP_CACHE_SRV *s = NULL;
+
+	while ((s = ca->services) != NULL) {
+		ca->services = s->next;
+		_srv_free(s);
+	}
+
+	if (ca->ca_id) CERT_IDENTIFIER_free(ca->ca_id);
+	if (ca->ca_cert) X509_free(ca->ca_cert);
+
+	free(ca->rqa);
+	free(ca);
+}
+
+static int _ca_busy(const PRQP_CACHE_CA *ca) {
+
+	const PRQP_CACHE_SRV *s = NULL;
+
+	for (s = ca->services; s != NULL; s = s->next) {
+		if (s->refreshing) return 1;
+	}
+
+	return 0;
+}
+
+static void _ca_unlink(PRQP_CACHE_CA *ca) {
+
+	PRQP_CACHE_CA **pp = NULL;
+
+	for (pp = &_prqp_cache; *pp != NULL; pp = &(*pp)->next) {
+		if (*pp == ca) {
+			*pp = ca->next;
+			_prqp_cache_num--;
+			break;
+		}
+	}
+}
+
+static PRQP_CACHE_CA * _ca_find(CERT_IDENTIFIER *id, const char *rqa) {
+
+	PRQP_CACHE_CA *ca = NULL;
+
+	for (ca = _prqp_cache; ca != NULL; ca = ca->next) {
+		if ((ca->rqa == NULL) != (rqa == NULL)) continue;
+		if (rqa && strcmp(ca->rqa, rqa) != 0) continue;
+		if (CERT_IDENTIFIER_cmp(ca->ca_id, id) == 0) return ca;
+	}
+
+	return NULL;
+}
+
+static PRQP_CACHE_SRV * _srv_find(PRQP_CACHE_CA *ca, const char *srv) {
+
+	PRQP_CACHE_SRV *s = NULL;
+
+	for (s = ca->services; s != NULL; s = s->next) {
+		if (strcmp(s->name, srv) == 0) return s;
+	}
+
+	return NULL;
+}
+
+static PKI_STACK * _srv_urls(const PRQP_CACHE_SRV *s) {
+
+	PKI_STACK *ret = NULL;
+	int i = 0;
+
+	if ((ret = PKI_STACK_new_null()) == NULL) return NULL;
+
+	for (i = 0; i < s->urls_num; i++) PKI_STACK_push(ret, strdup(s->urls[i]));
+
+	return ret;
+}
+
+static int _srv_set(PRQP_CACHE_SRV *s, PKI_STACK *url_sk, time_t expires, time_t now) {
+
+	char **urls = NULL;
+	char *url_s = NULL;
+	int i = 0, num = 0;
+
+	num = PKI_STACK_elements(url_sk);
+
+	if ((urls = calloc((size_t) num, sizeof(char *))) == NULL) return PKI_ERR;
+
+	for (i = 0; i < num; i++) {
+		if ((url_s = PKI_STACK_get_num(url_sk, i)) == NULL
+				|| (urls[i] = strdup(url_s)) == NULL) {
+			while (i-- > 0) free(urls[i]);
+			free(urls);
+			return PKI_ERR;
+		}
+	}
+
+	for (i = 0; i < s->urls_num; i++) free(s->urls[i]);
+	free(s->urls);
+
+	s->urls = urls;
+	s->urls_num = num;
+	s->expires = expires;
+	s->refresh_at = now + (expires - now) * PKI_PRQP_CACHE_REFRESH_PCT / 100;
+	s->used = 0;
+
+	return PKI_OK;
+}
+
+// ==================
+// Discovery
+// ==================
+
+/* Retrieves the URLs of the service and their expiration */
+static PKI_STACK * _prqp_discover(PKI_X509_CERT *caCert, const char *srv,
+				const char *rqa, time_t *expires) {
+
+	PKI_X509_PRQP_REQ *p = NULL;
+	PKI_X509_PRQP_RESP *r = NULL;
+	PKI_STACK *services = NULL;
+	PKI_STACK *ret = NULL;
+	ASN1_TIME *next = NULL;
+	int day = 0, sec = 0;
+	long ttl = 0;
+
+	*expires = 0;
+
+	if ((services = PKI_STACK_new_null()) == NULL) return NULL;
+	PKI_STACK_push(services, strdup(srv));
+
+	p = PKI_X509_PRQP_REQ_new_certs_res(caCert, NULL, NULL, services);
+	PKI_STACK_free_all(services);
+
+	if (!p) {
+		PKI_log_debug("Can not generate the PRQP request");
+		return NULL;
+	}
+
+	if ((r = PKI_DISCOVER_get_resp(p, (char *) rqa)) != NULL) {
+
+		ret = PKI_X509_PRQP_RESP_url_sk(r);
+
+		pthread_mutex_lock(&_prqp_cache_lock);
+		ttl = _prqp_cache_ttl;
+		pthread_mutex_unlock(&_prqp_cache_lock);
+
+		// The nextUpdate (if any) sets the lifetime of the URLs
+		next = PKI_X509_PRQP_RESP_get_data(r, PKI_X509_DATA_NEXTUPDATE);
+		if (next && ASN1_TIME_diff(&day, &sec, NULL, next)) ttl = (long) day * 86400 + sec;
+
+		if (ttl > PKI_PRQP_CACHE_MAX_TTL) ttl = PKI_PRQP_CACHE_MAX_TTL;
+		if (ttl > 0) *expires = time(NULL) + ttl;
+
+		PKI_X509_PRQP_RESP_free(r);
+	}
+
+	PKI_X509_PRQP_REQ_free(p);
+
+	return ret;
+}
+
+// ==================
+// Refresh
+// ==================
+
+/* Refreshes the used entries before they expire */
+static void * _prqp_cache_refresh(void *arg) {
+
+	PRQP_CACHE_CA *ca = NULL, *ca_next = NULL;
+	PRQP_CACHE_SRV *s = NULL, **sp = NULL;
+	PRQP_CACHE_SRV *pick = NULL;
+	PRQP_CACHE_CA *pick_ca = NULL;
+	CERT_IDENTIFIER *id = NULL;
+	PKI_X509_CERT *cert = NULL;
+	PKI_STACK *sk = NULL;
+	X509 *x = NULL;
+	char *name = NULL, *rqa = NULL;
+	struct timespec ts;
+	time_t now = 0, wake = 0, expires = 0;
+
+	pthread_mutex_lock(&_prqp_cache_lock);
+
+	while (!_prqp_refresher_stop) {
+
+		now = time(NULL);
+		wake = now + 60;
+		pick = NULL;
+
+		for (ca = _prqp_cache; ca != NULL; ca = ca_next) {
+
+			ca_next = ca->next;
+
+			for (sp = &ca->services; (s = *sp) != NULL; ) {
+
+				// Expired and not used anymore
+				if (!s->refreshing && s->expires <= now) {
+					*sp = s->next;
+					_srv_free(s);
+					continue;
+				}
+
+				if (!s->refreshing && !pick && s->used && s->refresh_at <= now) {
+					pick = s;
+					pick_ca = ca;
+				} else if (s->refresh_at > now && s->refresh_at < wake) {
+					wake = s->refresh_at;
+				} else if (s->expires < wake) {
+					wake = s->expires;
+				}
+
+				sp = &s->next;
+			}
+
+			if (!ca->services) {
+				_ca_unlink(ca);
+				_ca_free(ca);
+			}
+		}
+
+		if (!pick) {
+			ts.tv_sec = wake;
+			ts.tv_nsec = 0;
+			pthread_cond_timedwait(&_prqp_cache_cond, &_prqp_cache_lock, &ts);
+			continue;
+		}
+
+		pick->refreshing = 1;
+		pick->used = 0;
+
+		X509_up_ref(pick_ca->ca_cert);
+		x = pick_ca->ca_cert;
+		id = CERT_IDENTIFIER_dup(pick_ca->ca_id);
+		name = strdup(pick->name);
+		rqa = pick_ca->rqa ? strdup(pick_ca->rqa) : NULL;
+
+		pthread_mutex_unlock(&_prqp_cache_lock);
+
+		PKI_log_debug("Refreshing the PRQP service %s", name);
+
+		sk = NULL;
+		if ((cert = PKI_X509_new_value(PKI_DATATYPE_X509_CERT, x, NULL)) != NULL) {
+			sk = _prqp_discover(cert, name, rqa, &expires);
+			PKI_X509_CERT_free(cert);
+		} else X509_free(x);
+
+		pthread_mutex_lock(&_prqp_cache_lock);
+
+		now = time(NULL);
+
+		if (id && name && (ca = _ca_find(id, rqa)) != NULL && (s = _srv_find(ca, name)) != NULL) {
+			s->refreshing = 0;
+			if (s->expires <= 0) {
+				// Invalidated during the refresh
+			} else if (!sk || PKI_STACK_elements(sk) <= 0 || expires <= now
+					|| _srv_set(s, sk, expires, now) != PKI_OK) {
+				// Keeps the current URLs, retries later
+				PKI_log_debug("Can not refresh the PRQP service %s", name);
+				s->refresh_at = now + PKI_PRQP_CACHE_RETRY;
+				s->used = 1;
+			}
+		}
+
+		if (sk) PKI_STACK_free_all(sk);
+		if (id) CERT_IDENTIFIER_free(id);
+		free(name);
+		free(rqa);
+	}
+
+	pthread_mutex_unlock(&_prqp_cache_lock);
+
+	return NULL;
+}
+
+/* Stores the URLs of the service (takes ownership of the identifier) */
+static void _prqp_cache_store(CERT_IDENTIFIER *id, PKI_X509_CERT *caCert,
+			const char *srv, const char *rqa, PKI_STACK *url_sk, time_t expires) {
+
+	PRQP_CACHE_CA *ca = NULL, *lru = NULL;
+	PRQP_CACHE_SRV *s = NULL;
+	time_t now = time(NULL);
+
+	pthread_mutex_lock(&_prqp_cache_lock);
+
+	if ((ca = _ca_find(id, rqa)) == NULL) {
+
+		// Makes room for the new CA (least recently used)
+		if (_prqp_cache_num >= PKI_PRQP_CACHE_MAX_CAS) {
+			for (ca = _prqp_cache; ca != NULL; ca = ca->next) {
+				if (!_ca_busy(ca) && (!lru || ca->last_used < lru->last_used)) lru = ca;
+			}
+			if (lru) {
+				_ca_unlink(lru);
+				_ca_free(lru);
+			}
+		}
+
+		if ((ca = calloc(1, sizeof(PRQP_CACHE_CA))) == NULL
+				|| (rqa && (ca->rqa = strdup(rqa)) == NULL)) {
+			free(ca);
+			CERT_IDENTIFIER_free(id);
+			pthread_mutex_unlock(&_prqp_cache_lock);
+			return;
+		}
+
+		ca->ca_id = id;
+		X509_up_ref((X509 *) caCert->value);
+		ca->ca_cert = (X509 *) caCert->value;
+
+		ca->next = _prqp_cache;
+		_prqp_cache = ca;
+		_prqp_cache_num++;
+
+	} else CERT_IDENTIFIER_free(id);
+
+	ca->last_used = now;
+
+	if ((s = _srv_find(ca, srv)) == NULL) {
+		if ((s = calloc(1, sizeof(PRQP_CACHE_SRV))) == NULL
+				|| (s->name = strdup(srv)) == NULL) {
+			free(s);
+			pthread_mutex_unlock(&_prqp_cache_lock);
+			return;
+		}
+		s->next = ca->services;
+		ca->services = s;
+	}
+
+	// Data from a refresh in progress is overwritten by the refresher
+	_srv_set(s, url_sk, expires, now);
+
+	if (!_prqp_refresher_running && !_prqp_refresher_stop) {
+		if (PKI_THREAD_create(&_prqp_refresher, NULL, _prqp_cache_refresh, NULL) == 0)
+			_prqp_refresher_running = 1;
+		else PKI_log_err("Can not start the PRQP cache refresh thread");
+	}
+
+	pthread_cond_broadcast(&_prqp_cache_cond);
+	pthread_mutex_unlock(&_prqp_cache_lock);
+}
+
+// ==================
+// Exported Functions
+// ==================
+
+/*!
+ * \brief Returns the URLs of a CA service from the cache (or from a PRQP server)
+ *
+ * The URLs are retrieved from the PRQP server (url_s or the configured RQAs)
+ * only when they are not cached or expired. The returned stack must be
+ * freed with PKI_STACK_free_all().
+ */
+
+PKI_STACK * PKI_PRQP_CACHE_get_service_sk ( PKI_X509_CERT * caCert,
+					    const char    * srv,
+					    const char    * url_s ) {
+
+	CERT_IDENTIFIER *id = NULL;
+	PRQP_CACHE_CA *ca = NULL;
+	PRQP_CACHE_SRV *s = NULL;
+	PKI_STACK *ret = NULL;
+	time_t expires = 0;
+
+	if (!caCert || !caCert->value || !srv) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if ((id = PKI_PRQP_CERTID_new_cert(caCert, NULL, NULL, NULL, NULL, NULL)) != NULL) {
+
+		pthread_mutex_lock(&_prqp_cache_lock);
+
+		if ((ca = _ca_find(id, url_s)) != NULL && (s = _srv_find(ca, srv)) != NULL
+				&& s->expires > time(NULL)) {
+			ret = _srv_urls(s);
+			s->used = 1;
+			ca->last_used = time(NULL);
+			if (!s->refreshing && s->refresh_at <= ca->last_used)
+				pthread_cond_broadcast(&_prqp_cache_cond);
+		}
+
+		pthread_mutex_unlock(&_prqp_cache_lock);
+
+		if (ret) {
+			CERT_IDENTIFIER_free(id);
+			return ret;
+		}
+	}
+
+	ret = _prqp_discover(caCert, srv, url_s, &expires);
+
+	if (id && ret && PKI_STACK_elements(ret) > 0 && expires > time(NULL)) {
+		_prqp_cache_store(id, caCert, srv, url_s, ret, expires);
+	} else if (id) CERT_IDENTIFIER_free(id);
+
+	return ret;
+}
+
+/*! \brief Sets the lifetime (secs) of the responses without nextUpdate */
+
+int PKI_PRQP_CACHE_set_default_ttl ( int secs ) {
+
+	if (secs < 0 || secs > PKI_PRQP_CACHE_MAX_TTL) return PKI_ERROR(PKI_ERR_PARAM_RANGE, NULL);
+
+	pthread_mutex_lock(&_prqp_cache_lock);
+	_prqp_cache_ttl = secs;
+	pthread_mutex_unlock(&_prqp_cache_lock);
+
+	return PKI_OK;
+}
+
+/*! \brief Removes the cached services of a CA */
+
+int PKI_PRQP_CACHE_invalidate ( PKI_X509_CERT * caCert ) {
+
+	CERT_IDENTIFIER *id = NULL;
+	PRQP_CACHE_CA *ca = NULL, *next = NULL;
+	PRQP_CACHE_SRV *s = NULL;
+
+	if (!caCert) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if ((id = PKI_PRQP_CERTID_new_cert(caCert, NULL, NULL, NULL, NULL, NULL)) == NULL)
+		return PKI_ERR;
+
+	pthread_mutex_lock(&_prqp_cache_lock);
+
+	for (ca = _prqp_cache; ca != NULL; ca = next) {
+
+		next = ca->next;
+
+		if (CERT_IDENTIFIER_cmp(ca->ca_id, id) != 0) continue;
+
+		if (!_ca_busy(ca)) {
+			_ca_unlink(ca);
+			_ca_free(ca);
+			continue;
+		}
+
+		// Expired, removed by the refresher when done
+		for (s = ca->services; s != NULL; s = s->next) {
+			s->expires = 0;
+			s->used = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&_prqp_cache_lock);
+
+	CERT_IDENTIFIER_free(id);
+
+	return PKI_OK;
+}
+
+/*! \brief Stops the refresh thread and removes all the cached services */
+
+void PKI_PRQP_CACHE_flush ( void ) {
+
+	PRQP_CACHE_CA *ca = NULL;
+	int running = 0;
+
+	pthread_mutex_lock(&_prqp_cache_lock);
+	running = _prqp_refresher_running;
+	_prqp_refresher_stop = 1;
+	pthread_cond_broadcast(&_prqp_cache_cond);
+	pthread_mutex_unlock(&_prqp_cache_lock);
+
+	if (running) PKI_THREAD_join(&_prqp_refresher, NULL);
+
+	pthread_mutex_lock(&_prqp_cache_lock);
+
+	while ((ca = _prqp_cache) != NULL) {
+		_prqp_cache = ca->next;
+		_ca_free(ca);
+	}
+
+	_prqp_cache_num = 0;
+	_prqp_refresher_running = 0;
+	_prqp_refresher_stop = 0;
+
+	pthread_mutex_unlock(&_prqp_cache_lock);
+}
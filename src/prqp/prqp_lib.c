@@ -544,17 +544,29 @@ CERT_IDENTIFIER *PKI_PRQP_CERTID_new(
 
 	PKI_DIGEST *digest = NULL;
 	PKI_STRING *str = NULL;
+	const PKI_X509_NAME_REF *name_ref = NULL;
+	const unsigned char *name_hash = NULL;
+	size_t name_hash_size = 0;
 
-	digest = PKI_X509_NAME_get_digest(caIssuerName, dgst);
-	if (digest == NULL)
+	// The SHA-1 of the interned names is computed once
+	if (nid == NID_sha1 && (name_ref = PKI_X509_NAME_intern(caIssuerName)) != NULL)
+	{
+		name_hash = PKI_X509_NAME_REF_get_name_hash(name_ref, &name_hash_size);
+	}
+	else if ((digest = PKI_X509_NAME_get_digest(caIssuerName, dgst)) != NULL)
+	{
+		name_hash = digest->digest;
+		name_hash_size = digest->size;
+	}
+	else
 	{
 		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 		if( ca_id ) CERT_IDENTIFIER_free ( ca_id );
 		return NULL;
 	}
 
-	if ((str = PKI_STRING_new(PKI_STRING_OCTET, (char *) digest->digest, 
-		(int) digest->size))==NULL)
+	if ((str = PKI_STRING_new(PKI_STRING_OCTET, (char *) name_hash, 
+		(int) name_hash_size))==NULL)
 	{
 		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 
@@ -565,7 +577,7 @@ CERT_IDENTIFIER *PKI_PRQP_CERTID_new(
 
 	ca_id->basicCertId->issuerNameHash = str;
 
-	PKI_DIGEST_free ( digest );
+	if (digest) PKI_DIGEST_free ( digest );
 
 	if ((serial) && (!(ca_id->basicCertId->serialNumber = PKI_INTEGER_dup(serial))))
 	{
@@ -601,6 +613,9 @@ CERT_IDENTIFIER *PKI_PRQP_CERTID_new(
 
 void *PKI_X509_PRQP_REQ_new_null( void )
 {
+	// Registers the PRQP services (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PRQP);
+
 	return PKI_X509_new(PKI_DATATYPE_X509_PRQP_REQ, NULL);
 }
 
@@ -815,6 +830,9 @@ int PKI_X509_PRQP_REQ_add_service ( PKI_X509_PRQP_REQ *p, char *ss ) {
 
 	if( !p || !p->value || !ss ) return (PKI_ERR);
 
+	// Registers the PRQP services (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PRQP);
+
 	val = p->value;
 
 	if( !val->requestData || !val->requestData->serviceToken ||
@@ -1063,6 +1081,8 @@ int PKI_X509_PRQP_RESP_add_service ( PKI_X509_PRQP_RESP *r,
 		return PKI_ERR;
 	}
 
+	if ( url ) PKI_STACK_push ( sk, strdup( url ));
+
 	ret = PKI_X509_PRQP_RESP_add_service_stack ( r, resId, sk,
 				version, comment, oid );
 
@@ -1125,7 +1145,10 @@ int PKI_X509_PRQP_RESP_add_service_stack ( PKI_X509_PRQP_RESP *r,
 		resp_tk->textInfo = NULL;
 	}
 
-	if (url_stack)
+	if (url_stack && !resp_tk->resLocatorList)
+		resp_tk->resLocatorList = sk_ASN1_IA5STRING_new_null();
+
+	if (url_stack && resp_tk->resLocatorList)
 	{
 		for (i = 0; i < PKI_STACK_elements( url_stack ); i++)
 		{
@@ -1160,6 +1183,9 @@ int PKI_X509_PRQP_RESP_add_service_stack ( PKI_X509_PRQP_RESP *r,
 
 void *PKI_X509_PRQP_RESP_new_null(void)
 {
+	// Registers the PRQP services (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PRQP);
+
 	return ((void *) PKI_X509_new( PKI_DATATYPE_X509_PRQP_RESP, NULL));
 }
 
@@ -1351,8 +1377,6 @@ PKI_STACK * PKI_X509_PRQP_RESP_url_sk ( PKI_X509_PRQP_RESP *r ) {
 		int i = 0;
                 RESOURCE_RESPONSE_TOKEN *res = NULL;
 
-		url_sk = PKI_STACK_new_null();
-
 		for( i = 0; i < 
 			PKI_STACK_RESOURCE_RESPONSE_TOKEN_elements (pki_sk ); 
 									i++) {
@@ -1581,6 +1605,9 @@ int PKI_X509_PRQP_REQ_VALUE_print_bio ( PKI_PRQP_REQ *req, BIO *bio ) {
 
 	if( !req || !req->requestData || !bio ) return (PKI_ERR);
 
+	// Service names are needed for printing
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PRQP);
+
 	rd = req->requestData;
 
 	BIO_printf( bio, "PRQP Request:\r\n");
@@ -1762,6 +1789,9 @@ int PKI_X509_PRQP_RESP_VALUE_print_bio (PKI_X509_PRQP_RESP_VALUE *resp, BIO *bio
 
 	if( !resp || !resp->respData || !bio ) return PKI_ERR;
 
+	// Service names are needed for printing
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PRQP);
+
 	rd = resp->respData;
 
 	BIO_printf( bio, "PRQP Response:\r\n");
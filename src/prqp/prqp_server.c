@@ -0,0 +1,853 @@
+/* PKI Resource Query Protocol (PRQP) - Embedded Responder
+ * (c) 2006-2010 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ */
+
+#include <libpki/pki.h>
+
+/*
+ * NOTE: the server data lives as long as the server, its memory is
+ *       allocated with malloc()/calloc() directly so it is never taken
+ *       from a request arena. The responses are returned in a PKI_MEM.
+ *
+ * The responses are assembled in DER from precomputed fragments:
+ *
+ *   PRQPResponse ::= SEQUENCE {
+ *     TBSRespData ::= SEQUENCE {
+ *       version, [0] nonce, producedAt, [1] nextUpdate  <- per request
+ *       pkiStatus                                       <- precomputed
+ *       caCertId                                        <- from request
+ *       [2] SEQUENCE OF ResourceResponseToken }         <- precomputed
+ *     [0] Signature ::= SEQUENCE {
+ *       signatureAlgorithm                              <- precomputed
+ *       signature BIT STRING                            <- per request
+ *       signerCert, [1] otherCerts } }                  <- precomputed
+ *
+ * The nonce is part of the signed data, therefore the TBSRespData is
+ * signed for every request.
+ */
+
+#define PRQP_SERVER_STATUS_NUM		4
+
+typedef struct prqp_der_st {
+	unsigned char * data;
+	size_t size;
+} PRQP_DER;
+
+typedef struct prqp_server_srv_st {
+	ASN1_OBJECT * oid;
+	RESOURCE_RESPONSE_TOKEN * token;
+	PRQP_DER der;
+} PRQP_SERVER_SRV;
+
+typedef struct prqp_server_ca_st {
+	PKI_X509_CERT * ca_cert;
+	CERT_IDENTIFIER * ca_id;
+	PRQP_SERVER_SRV services[PKI_PRQP_SERVER_MAX_SERVICES];
+	int services_num;
+	/* [2] EXPLICIT SEQUENCE OF ResourceResponseToken (all services) */
+	PRQP_DER all;
+	struct prqp_server_ca_st * next;
+} PRQP_SERVER_CA;
+
+struct pki_prqp_server_st {
+	PRQP_SERVER_CA * cas;
+	long validity;
+
+	/* Signer */
+	const PKI_X509_KEYPAIR * key;
+	const PKI_DIGEST_ALG * dgst;
+	PRQP_DER sig_alg;
+	/* signerCert and [1] otherCerts */
+	PRQP_DER sig_certs;
+
+	/* PKIStatusInfo for each status */
+	PRQP_DER status[PRQP_SERVER_STATUS_NUM];
+
+	/* Token loaded from the configuration (owned) */
+	PKI_TOKEN * tk;
+};
+
+// ==================
+// DER Helpers
+// ==================
+
+static size_t _der_hdr_size(size_t len) {
+
+	size_t n = 2;
+
+	if (len < 0x80) return n;
+	while (len > 0) {
+		n++;
+		len >>= 8;
+	}
+
+	return n;
+}
+
+static unsigned char * _der_hdr(unsigned char *p, unsigned char tag, size_t len) {
+
+	size_t n = 0, i = 0;
+
+	*p++ = tag;
+
+	if (len < 0x80) {
+		*p++ = (unsigned char) len;
+		return p;
+	}
+
+	n = _der_hdr_size(len) - 2;
+	*p++ = (unsigned char) (0x80 | n);
+	for (i = n; i > 0; i--) *p++ = (unsigned char) (len >> (8 * (i - 1)));
+
+	return p;
+}
+
+static void _der_free(PRQP_DER *der) {
+
+	free(der->data);
+	der->data = NULL;
+	der->size = 0;
+}
+
+static int _der_item(PRQP_DER *der, const void *val, const ASN1_ITEM *it) {
+
+	unsigned char *p = NULL;
+	int len = 0;
+
+	_der_free(der);
+
+	if ((len = ASN1_item_i2d((ASN1_VALUE *) val, NULL, it)) <= 0) return PKI_ERR;
+	if ((der->data = malloc((size_t) len)) == NULL) return PKI_ERR;
+
+	p = der->data;
+	der->size = (size_t) ASN1_item_i2d((ASN1_VALUE *) val, &p, it);
+
+	return PKI_OK;
+}
+
+static unsigned char * _gtime(unsigned char *p, time_t t) {
+
+	struct tm tm;
+	char buf[32];
+
+	gmtime_r(&t, &tm);
+	strftime(buf, sizeof(buf), "%Y%m%d%H%M%SZ", &tm);
+
+	p = _der_hdr(p, V_ASN1_GENERALIZEDTIME, 15);
+	memcpy(p, buf, 15);
+
+	return p + 15;
+}
+
+/* Signs the DER of the response data with the configured keypair */
+static int _sign(PRQP_DER *sig, const unsigned char *data, size_t size,
+		const PKI_DIGEST_ALG *md, const PKI_X509_KEYPAIR *k) {
+
+	EVP_MD_CTX *ctx = NULL;
+	size_t len = 0;
+	int ret = PKI_ERR;
+
+	_der_free(sig);
+
+	if ((ctx = EVP_MD_CTX_new()) == NULL) return PKI_ERR;
+
+	if (EVP_DigestSignInit(ctx, NULL, md == PKI_DIGEST_ALG_NULL ? NULL : md,
+			NULL, (EVP_PKEY *) k->value) != 1
+			|| EVP_DigestSign(ctx, NULL, &len, data, size) != 1
+			|| (sig->data = malloc(len)) == NULL
+			|| EVP_DigestSign(ctx, sig->data, &len, data, size) != 1) {
+		_der_free(sig);
+		goto end;
+	}
+
+	sig->size = len;
+	ret = PKI_OK;
+
+end:
+	EVP_MD_CTX_free(ctx);
+
+	return ret;
+}
+
+// ==================
+// Precomputation
+// ==================
+
+static int _status_der(PRQP_DER *der, int status, const char *text) {
+
+	PKI_STATUS_INFO *st = NULL;
+	int ret = PKI_ERR;
+
+	if ((st = PKI_STATUS_INFO_new()) == NULL) return PKI_ERR;
+
+	ASN1_INTEGER_set(st->status, status);
+
+	if (text && (st->statusString = ASN1_UTF8STRING_new()) != NULL)
+		ASN1_STRING_set(st->statusString, text, (int) strlen(text));
+
+	ret = _der_item(der, st, ASN1_ITEM_rptr(PKI_STATUS_INFO));
+
+	PKI_STATUS_INFO_free(st);
+
+	return ret;
+}
+
+/* Encodes the [2] EXPLICIT SEQUENCE OF ResourceResponseToken of the CA */
+static int _ca_precompute(PRQP_SERVER_CA *ca) {
+
+	unsigned char *p = NULL;
+	size_t len = 0, seq = 0;
+	int i = 0;
+
+	_der_free(&ca->all);
+
+	for (i = 0; i < ca->services_num; i++) len += ca->services[i].der.size;
+
+	seq = _der_hdr_size(len) + len;
+	ca->all.size = _der_hdr_size(seq) + seq;
+
+	if ((ca->all.data = malloc(ca->all.size)) == NULL) {
+		ca->all.size = 0;
+		return PKI_ERR;
+	}
+
+	p = _der_hdr(ca->all.data, 0xA2, seq);
+	p = _der_hdr(p, V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED, len);
+
+	for (i = 0; i < ca->services_num; i++) {
+		memcpy(p, ca->services[i].der.data, ca->services[i].der.size);
+		p += ca->services[i].der.size;
+	}
+
+	return PKI_OK;
+}
+
+static void _ca_free(PRQP_SERVER_CA *ca) {
+
+	int i = 0;
+
+	if (!ca) return;
+
+	for (i = 0; i < ca->services_num; i++) {
+		if (ca->services[i].oid) ASN1_OBJECT_free(ca->services[i].oid);
+		if (ca->services[i].token) RESOURCE_RESPONSE_TOKEN_free(ca->services[i].token);
+		_der_free(&ca->services[i].der);
+	}
+
+	if (ca->ca_id) CERT_IDENTIFIER_free(ca->ca_id);
+	if (ca->ca_cert) PKI_X509_CERT_free(ca->ca_cert);
+	_der_free(&ca->all);
+
+	free(ca);
+}
+
+static PRQP_SERVER_CA * _ca_get(PKI_PRQP_SERVER *srv, PKI_X509_CERT *caCert) {
+
+	PRQP_SERVER_CA *ca = NULL;
+	CERT_IDENTIFIER *id = NULL;
+
+	if ((id = PKI_PRQP_CERTID_new_cert(caCert, NULL, NULL, NULL, NULL, NULL)) == NULL)
+		return NULL;
+
+	for (ca = srv->cas; ca != NULL; ca = ca->next) {
+		if (CERT_IDENTIFIER_cmp(ca->ca_id, id) == 0) {
+			CERT_IDENTIFIER_free(id);
+			return ca;
+		}
+	}
+
+	if ((ca = calloc(1, sizeof(PRQP_SERVER_CA))) == NULL
+			|| (ca->ca_cert = PKI_X509_dup(caCert)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		CERT_IDENTIFIER_free(id);
+		_ca_free(ca);
+		return NULL;
+	}
+
+	ca->ca_id = id;
+	ca->next = srv->cas;
+	srv->cas = ca;
+
+	return ca;
+}
+
+// ==================
+// Server
+// ==================
+
+/*! \brief Returns a new (empty) PRQP responder */
+
+PKI_PRQP_SERVER * PKI_PRQP_SERVER_new(void) {
+
+	PKI_PRQP_SERVER *srv = NULL;
+
+	// Registers the PRQP services (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PRQP);
+
+	if ((srv = calloc(1, sizeof(PKI_PRQP_SERVER))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	srv->validity = PKI_PRQP_SERVER_VALIDITY;
+
+	if (_status_der(&srv->status[PKI_X509_PRQP_STATUS_OK], PKI_X509_PRQP_STATUS_OK, NULL) != PKI_OK
+			|| _status_der(&srv->status[PKI_X509_PRQP_STATUS_BAD_REQUEST],
+				PKI_X509_PRQP_STATUS_BAD_REQUEST,
+				PKI_X509_PRQP_STATUS_STRING_BAD_REQUEST) != PKI_OK
+			|| _status_der(&srv->status[PKI_X509_PRQP_STATUS_CA_NOT_PRESENT],
+				PKI_X509_PRQP_STATUS_CA_NOT_PRESENT,
+				PKI_X509_PRQP_STATUS_STRING_CA_NOT_PRESENT) != PKI_OK
+			|| _status_der(&srv->status[PKI_X509_PRQP_STATUS_SYS_FAILURE],
+				PKI_X509_PRQP_STATUS_SYS_FAILURE,
+				PKI_X509_PRQP_STATUS_STRING_SYS_FAILURE) != PKI_OK) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		PKI_PRQP_SERVER_free(srv);
+		return NULL;
+	}
+
+	return srv;
+}
+
+/*! \brief Frees the responder (and the token loaded from its config) */
+
+void PKI_PRQP_SERVER_free(PKI_PRQP_SERVER *srv) {
+
+	PRQP_SERVER_CA *ca = NULL;
+	int i = 0;
+
+	if (!srv) return;
+
+	while ((ca = srv->cas) != NULL) {
+		srv->cas = ca->next;
+		_ca_free(ca);
+	}
+
+	for (i = 0; i < PRQP_SERVER_STATUS_NUM; i++) _der_free(&srv->status[i]);
+
+	_der_free(&srv->sig_alg);
+	_der_free(&srv->sig_certs);
+
+	if (srv->tk) PKI_TOKEN_free(srv->tk);
+
+	free(srv);
+}
+
+/*!
+ * \brief Sets the signing key and certificate of the responses
+ *
+ * The key is referenced by the server and must be valid while the server
+ * is in use, the certificates are encoded once.
+ */
+
+int PKI_PRQP_SERVER_set_signer(PKI_PRQP_SERVER *srv, PKI_X509_KEYPAIR *k,
+		PKI_X509_CERT *x, PKI_DIGEST_ALG *dgst, PKI_X509_CERT_STACK *certs) {
+
+	const PKI_DIGEST_ALG *md = dgst;
+	X509_ALGOR *alg = NULL;
+	PRQP_DER cert = { NULL, 0 }, others = { NULL, 0 };
+	PKI_X509_CERT *c = NULL;
+	unsigned char *p = NULL;
+	size_t len = 0;
+	int pkey_type = 0, sig_nid = NID_undef;
+	int i = 0, ret = PKI_ERR;
+
+	if (!srv || !k || !k->value || !x || !x->value)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (!md) md = PKI_DIGEST_ALG_get_default(k);
+
+	pkey_type = PKI_X509_KEYPAIR_VALUE_get_id(k->value);
+
+	// The algorithm identifier is the same for all the responses
+	if (!OBJ_find_sigid_by_algs(&sig_nid, (md && md != PKI_DIGEST_ALG_NULL) ?
+			EVP_MD_type(md) : NID_undef, pkey_type)) {
+		PKI_DEBUG("No signature algorithm for %s with %s", PKI_ID_get_txt(pkey_type),
+			md ? PKI_DIGEST_ALG_get_parsed(md) : "NULL");
+		return PKI_ERROR(PKI_ERR_ALGOR_UNKNOWN, NULL);
+	}
+
+	if ((alg = X509_ALGOR_new()) == NULL)
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+
+	X509_ALGOR_set0(alg, OBJ_nid2obj(sig_nid),
+		pkey_type == EVP_PKEY_RSA ? V_ASN1_NULL : V_ASN1_UNDEF, NULL);
+
+	if (_der_item(&srv->sig_alg, alg, ASN1_ITEM_rptr(X509_ALGOR)) != PKI_OK
+			|| _der_item(&cert, x->value, ASN1_ITEM_rptr(X509)) != PKI_OK) goto end;
+
+	// SEQUENCE OF Certificate (otherCerts)
+	for (i = 0; certs && i < PKI_STACK_X509_CERT_elements(certs); i++) {
+		if ((c = PKI_STACK_X509_CERT_get_num(certs, i)) != NULL && c->value)
+			len += (size_t) i2d_X509((X509 *) c->value, NULL);
+	}
+
+	if (len > 0) {
+
+		others.size = _der_hdr_size(len) + len;
+		if ((others.data = malloc(others.size)) == NULL) goto end;
+
+		p = _der_hdr(others.data, V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED, len);
+		for (i = 0; i < PKI_STACK_X509_CERT_elements(certs); i++) {
+			if ((c = PKI_STACK_X509_CERT_get_num(certs, i)) != NULL && c->value)
+				i2d_X509((X509 *) c->value, &p);
+		}
+	}
+
+	_der_free(&srv->sig_certs);
+
+	srv->sig_certs.size = cert.size + (others.size ?
+		_der_hdr_size(others.size) + others.size : 0);
+
+	if ((srv->sig_certs.data = malloc(srv->sig_certs.size)) == NULL) {
+		srv->sig_certs.size = 0;
+		goto end;
+	}
+
+	memcpy(srv->sig_certs.data, cert.data, cert.size);
+	if (others.size) {
+		p = _der_hdr(srv->sig_certs.data + cert.size, 0xA1, others.size);
+		memcpy(p, others.data, others.size);
+	}
+
+	srv->key = k;
+	srv->dgst = md;
+
+	ret = PKI_OK;
+
+end:
+	if (ret != PKI_OK) _der_free(&srv->sig_alg);
+	_der_free(&cert);
+	_der_free(&others);
+	X509_ALGOR_free(alg);
+
+	return ret;
+}
+
+/*! \brief Signs the responses with the keypair and certificates of a token */
+
+int PKI_PRQP_SERVER_set_token(PKI_PRQP_SERVER *srv, PKI_TOKEN *tk,
+				PKI_DIGEST_ALG *dgst) {
+
+	if (!srv || !tk || !tk->keypair || !tk->cert)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	return PKI_PRQP_SERVER_set_signer(srv, tk->keypair, tk->cert,
+		dgst, tk->otherCerts);
+}
+
+/*! \brief Sets the lifetime (nextUpdate) of the responses */
+
+int PKI_PRQP_SERVER_set_validity(PKI_PRQP_SERVER *srv, long secs) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (secs <= 0) return PKI_ERROR(PKI_ERR_PARAM_RANGE, NULL);
+
+	srv->validity = secs;
+
+	return PKI_OK;
+}
+
+/*! \brief Adds the URL of a service (e.g., "scepGateway") for a CA */
+
+int PKI_PRQP_SERVER_add_service(PKI_PRQP_SERVER *srv, PKI_X509_CERT *caCert,
+				const char *service, const char *url) {
+
+	PRQP_SERVER_CA *ca = NULL;
+	PRQP_SERVER_SRV *s = NULL;
+	ASN1_OBJECT *oid = NULL;
+	ASN1_IA5STRING *str = NULL;
+	int i = 0;
+
+	if (!srv || !caCert || !caCert->value || !service || !url)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if ((oid = PKI_OID_get(service)) == NULL)
+		return PKI_ERROR(PKI_ERR_OBJECT_TYPE_UNKNOWN, "Unknown PRQP service %s", service);
+
+	if ((ca = _ca_get(srv, caCert)) == NULL) {
+		ASN1_OBJECT_free(oid);
+		return PKI_ERR;
+	}
+
+	for (i = 0; i < ca->services_num; i++) {
+		if (OBJ_cmp(ca->services[i].oid, oid) == 0) {
+			s = &ca->services[i];
+			ASN1_OBJECT_free(oid);
+			break;
+		}
+	}
+
+	if (!s) {
+
+		if (ca->services_num >= PKI_PRQP_SERVER_MAX_SERVICES) {
+			ASN1_OBJECT_free(oid);
+			return PKI_ERROR(PKI_ERR_PARAM_RANGE, "Too many PRQP services");
+		}
+
+		s = &ca->services[ca->services_num];
+
+		if ((s->token = RESOURCE_RESPONSE_TOKEN_new()) == NULL
+				|| (s->token->resourceId = OBJ_dup(oid)) == NULL
+				|| (!s->token->resLocatorList && (s->token->resLocatorList =
+					sk_ASN1_IA5STRING_new_null()) == NULL)) {
+			if (s->token) RESOURCE_RESPONSE_TOKEN_free(s->token);
+			s->token = NULL;
+			ASN1_OBJECT_free(oid);
+			return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		}
+
+		s->oid = oid;
+		ca->services_num++;
+	}
+
+	if ((str = ASN1_IA5STRING_new()) == NULL
+			|| !ASN1_STRING_set(str, url, (int) strlen(url))
+			|| !sk_ASN1_IA5STRING_push(s->token->resLocatorList, str)) {
+		if (str) ASN1_IA5STRING_free(str);
+		return PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+	}
+
+	// Re-encodes the token and the CA services
+	if (_der_item(&s->der, s->token, ASN1_ITEM_rptr(RESOURCE_RESPONSE_TOKEN)) != PKI_OK
+			|| _ca_precompute(ca) != PKI_OK)
+		return PKI_ERROR(PKI_ERR_DATA_ASN1_ENCODING, NULL);
+
+	return PKI_OK;
+}
+
+/*!
+ * \brief Loads the CA -> services map (and the signing token) from an
+ *        XML configuration file
+ */
+
+int PKI_PRQP_SERVER_load_config(PKI_PRQP_SERVER *srv, const char *url_s,
+				const char *token_dir) {
+
+	PKI_CONFIG *cfg = NULL;
+	PKI_CONFIG_ELEMENT_STACK *sk = NULL;
+	PKI_CONFIG_ELEMENT *ca_el = NULL, *el = NULL, *s_el = NULL;
+	PKI_X509_CERT *caCert = NULL;
+	char *val = NULL, *name = NULL, *srv_name = NULL;
+	int ret = PKI_OK;
+
+	if (!srv || !url_s) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if ((cfg = PKI_CONFIG_load(url_s)) == NULL)
+		return PKI_ERROR(PKI_ERR_CONFIG_LOAD, "Can not load %s", url_s);
+
+	if ((val = PKI_CONFIG_get_value(cfg, "/prqpConfig/validity")) != NULL) {
+		if (atol(val) > 0) srv->validity = atol(val);
+		PKI_Free(val);
+	}
+
+	if ((val = PKI_CONFIG_get_value(cfg, "/prqpConfig/token")) != NULL) {
+
+		if (srv->tk) PKI_TOKEN_free(srv->tk);
+
+		if ((srv->tk = PKI_TOKEN_new(token_dir, val)) == NULL
+				|| PKI_PRQP_SERVER_set_token(srv, srv->tk, NULL) != PKI_OK) {
+			PKI_log_err("Can not load the PRQP signing token %s", val);
+			ret = PKI_ERR;
+		}
+
+		PKI_Free(val);
+	}
+
+	if (ret == PKI_OK && (sk = PKI_CONFIG_get_element_stack(cfg, "/prqpConfig/ca")) != NULL) {
+
+		while (ret == PKI_OK && (ca_el = PKI_STACK_CONFIG_ELEMENT_pop(sk)) != NULL) {
+
+			caCert = NULL;
+
+			// The CA certificate first, then its services
+			for (el = PKI_CONFIG_get_element_child(ca_el); el && !caCert;
+					el = PKI_CONFIG_get_element_next(el)) {
+				if (strcmp(PKI_CONFIG_get_element_name(el), "caCert") != 0) continue;
+				if ((val = PKI_CONFIG_get_element_value(el)) == NULL) continue;
+				caCert = PKI_X509_CERT_get(val, PKI_DATA_FORMAT_UNKNOWN, NULL, NULL);
+				if (!caCert) PKI_log_err("Can not load the CA certificate %s", val);
+				PKI_Free(val);
+			}
+
+			if (!caCert) {
+				ret = PKI_ERR;
+				break;
+			}
+
+			for (el = PKI_CONFIG_get_element_child(ca_el); el && ret == PKI_OK;
+					el = PKI_CONFIG_get_element_next(el)) {
+
+				if (strcmp(PKI_CONFIG_get_element_name(el), "service") != 0) continue;
+
+				srv_name = NULL;
+				for (s_el = PKI_CONFIG_get_element_child(el); s_el && !srv_name;
+						s_el = PKI_CONFIG_get_element_next(s_el)) {
+					if (strcmp(PKI_CONFIG_get_element_name(s_el), "name") == 0)
+						srv_name = PKI_CONFIG_get_element_value(s_el);
+				}
+
+				if (!srv_name) {
+					PKI_log_err("PRQP service without name in %s", url_s);
+					ret = PKI_ERR;
+					break;
+				}
+
+				for (s_el = PKI_CONFIG_get_element_child(el); s_el && ret == PKI_OK;
+						s_el = PKI_CONFIG_get_element_next(s_el)) {
+					name = PKI_CONFIG_get_element_name(s_el);
+					if (strcmp(name, "url") != 0) continue;
+					if ((val = PKI_CONFIG_get_element_value(s_el)) == NULL) continue;
+					ret = PKI_PRQP_SERVER_add_service(srv, caCert, srv_name, val);
+					PKI_Free(val);
+				}
+
+				PKI_Free(srv_name);
+			}
+
+			PKI_X509_CERT_free(caCert);
+		}
+
+		while ((ca_el = PKI_STACK_CONFIG_ELEMENT_pop(sk)) != NULL) {
+			// Nothing to do, the nodes belong to the document
+		}
+		PKI_STACK_CONFIG_ELEMENT_free_all(sk);
+	}
+
+	PKI_CONFIG_free(cfg);
+
+	return ret;
+}
+
+// ==================
+// Responses
+// ==================
+
+static const PRQP_SERVER_CA * _ca_find(const PKI_PRQP_SERVER *srv, CERT_IDENTIFIER *id) {
+
+	const PRQP_SERVER_CA *ca = NULL;
+	CERT_IDENTIFIER *tmp = NULL;
+	const EVP_MD *md = NULL;
+	int cmp = 0;
+
+	for (ca = srv->cas; ca != NULL; ca = ca->next) {
+
+		if ((cmp = CERT_IDENTIFIER_cmp(ca->ca_id, id)) == 0) return ca;
+
+		// Identifier computed with a different hash algorithm
+		if (cmp == 1 && (md = EVP_get_digestbyobj(id->hashAlgorithm->algorithm)) != NULL
+				&& (tmp = PKI_PRQP_CERTID_new_cert(ca->ca_cert, NULL, NULL,
+					NULL, NULL, (PKI_DIGEST_ALG *) md)) != NULL) {
+			cmp = CERT_IDENTIFIER_cmp(tmp, id);
+			CERT_IDENTIFIER_free(tmp);
+			if (cmp == 0) return ca;
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Processes a PRQP request (DER) and returns the signed response
+ *        (DER), NULL if the request can not be parsed
+ */
+
+PKI_MEM * PKI_PRQP_SERVER_process(PKI_PRQP_SERVER *srv, const PKI_MEM *req) {
+
+	PKI_PRQP_REQ *r = NULL;
+	RESOURCE_REQUEST_TOKEN *tk = NULL;
+	RESOURCE_IDENTIFIER *res = NULL;
+	const PRQP_SERVER_CA *ca = NULL;
+	const PRQP_DER *status = NULL;
+	PRQP_DER ca_id = { NULL, 0 }, nonce = { NULL, 0 };
+	const PRQP_DER *picked[PKI_PRQP_SERVER_MAX_SERVICES];
+	PRQP_DER sig = { NULL, 0 };
+	PKI_MEM *ret = NULL;
+	unsigned char *tbs = NULL, *p = NULL;
+	const unsigned char *cp = NULL;
+	size_t tbs_len = 0, tbs_size = 0, tokens_len = 0, seq_len = 0;
+	size_t bits_len = 0, psig_len = 0, psig_wrap = 0;
+	int picked_num = 0, all = 0, i = 0, j = 0;
+	time_t now = 0;
+
+	if (!srv || !req || !req->data || !req->size) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (!srv->key) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, "Missing PRQP signer");
+		return NULL;
+	}
+
+	cp = req->data;
+	if ((r = d2i_PKI_PRQP_REQ(NULL, &cp, (long) req->size)) == NULL
+			|| !r->requestData || (tk = r->requestData->serviceToken) == NULL
+			|| !tk->ca || !tk->ca->hashAlgorithm || !tk->ca->basicCertId) {
+		PKI_DEBUG("Malformed PRQP request");
+		goto end;
+	}
+
+	if (_der_item(&ca_id, tk->ca, ASN1_ITEM_rptr(CERT_IDENTIFIER)) != PKI_OK
+			|| (r->requestData->nonce && _der_item(&nonce, r->requestData->nonce,
+				ASN1_ITEM_rptr(ASN1_INTEGER)) != PKI_OK)) {
+		PKI_ERROR(PKI_ERR_DATA_ASN1_ENCODING, NULL);
+		goto end;
+	}
+
+	// Selects the precomputed status and tokens
+	if ((ca = _ca_find(srv, tk->ca)) == NULL) {
+		status = &srv->status[PKI_X509_PRQP_STATUS_CA_NOT_PRESENT];
+	} else {
+		status = &srv->status[PKI_X509_PRQP_STATUS_OK];
+
+		if (!tk->resourceList || sk_RESOURCE_IDENTIFIER_num(tk->resourceList) <= 0) {
+			all = 1;
+		} else for (i = 0; i < sk_RESOURCE_IDENTIFIER_num(tk->resourceList); i++) {
+			res = sk_RESOURCE_IDENTIFIER_value(tk->resourceList, i);
+			for (j = 0; res && j < ca->services_num && picked_num < PKI_PRQP_SERVER_MAX_SERVICES; j++) {
+				if (OBJ_cmp(ca->services[j].oid, res->resourceId) == 0) {
+					picked[picked_num++] = &ca->services[j].der;
+					tokens_len += ca->services[j].der.size;
+					break;
+				}
+			}
+		}
+	}
+
+	// TBSRespData
+	now = time(NULL);
+
+	tbs_len = 3 + 17 + 19 + status->size + ca_id.size;
+	if (nonce.size) tbs_len += _der_hdr_size(nonce.size) + nonce.size;
+	if (all) {
+		tbs_len += ca->all.size;
+	} else if (picked_num > 0) {
+		seq_len = _der_hdr_size(tokens_len) + tokens_len;
+		tbs_len += _der_hdr_size(seq_len) + seq_len;
+	}
+	tbs_size = _der_hdr_size(tbs_len) + tbs_len;
+
+	if ((tbs = malloc(tbs_size)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		goto end;
+	}
+
+	p = _der_hdr(tbs, V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED, tbs_len);
+
+	// version v(1)
+	*p++ = V_ASN1_INTEGER;
+	*p++ = 0x01;
+	*p++ = 0x01;
+
+	if (nonce.size) {
+		p = _der_hdr(p, 0xA0, nonce.size);
+		memcpy(p, nonce.data, nonce.size);
+		p += nonce.size;
+	}
+
+	p = _gtime(p, now);
+	p = _der_hdr(p, 0xA1, 17);
+	p = _gtime(p, now + srv->validity);
+
+	memcpy(p, status->data, status->size);
+	p += status->size;
+
+	memcpy(p, ca_id.data, ca_id.size);
+	p += ca_id.size;
+
+	if (all) {
+		memcpy(p, ca->all.data, ca->all.size);
+		p += ca->all.size;
+	} else if (picked_num > 0) {
+		p = _der_hdr(p, 0xA2, seq_len);
+		p = _der_hdr(p, V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED, tokens_len);
+		for (i = 0; i < picked_num; i++) {
+			memcpy(p, picked[i]->data, picked[i]->size);
+			p += picked[i]->size;
+		}
+	}
+
+	// Signature over the TBSRespData
+	if (_sign(&sig, tbs, tbs_size, srv->dgst, srv->key) != PKI_OK) {
+		PKI_ERROR(PKI_ERR_SIGNATURE_CREATE, NULL);
+		goto end;
+	}
+
+	bits_len = sig.size + 1;
+	psig_len = srv->sig_alg.size + _der_hdr_size(bits_len) + bits_len + srv->sig_certs.size;
+	psig_wrap = _der_hdr_size(psig_len) + psig_len;
+
+	if ((ret = PKI_MEM_new(_der_hdr_size(tbs_size + _der_hdr_size(psig_wrap) + psig_wrap)
+			+ tbs_size + _der_hdr_size(psig_wrap) + psig_wrap)) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		goto end;
+	}
+
+	p = _der_hdr(ret->data, V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED,
+		tbs_size + _der_hdr_size(psig_wrap) + psig_wrap);
+
+	memcpy(p, tbs, tbs_size);
+	p += tbs_size;
+
+	// [0] EXPLICIT Signature
+	p = _der_hdr(p, 0xA0, psig_wrap);
+	p = _der_hdr(p, V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED, psig_len);
+
+	memcpy(p, srv->sig_alg.data, srv->sig_alg.size);
+	p += srv->sig_alg.size;
+
+	p = _der_hdr(p, V_ASN1_BIT_STRING, bits_len);
+	*p++ = 0x00;
+	memcpy(p, sig.data, sig.size);
+	p += sig.size;
+
+	memcpy(p, srv->sig_certs.data, srv->sig_certs.size);
+
+end:
+	_der_free(&sig);
+	if (r) PKI_PRQP_REQ_free(r);
+	free(tbs);
+	_der_free(&ca_id);
+	_der_free(&nonce);
+
+	return ret;
+}
+
+// ==================
+// HTTP
+// ==================
+
+static int _prqp_http_handler(const PKI_HTTP *req, PKI_HTTP *resp, void *ctx) {
+
+	PKI_PRQP_SERVER *srv = ctx;
+
+	if (req->method != PKI_HTTP_METHOD_POST) {
+		resp->code = 405;
+		return PKI_ERR;
+	}
+
+	if (!req->body || !req->body->size
+			|| (resp->body = PKI_PRQP_SERVER_process(srv, req->body)) == NULL) {
+		resp->code = 400;
+		return PKI_ERR;
+	}
+
+	resp->code = 200;
+	resp->type = strdup(PKI_PRQP_RESP_CONTENT_TYPE);
+
+	return PKI_OK;
+}
+
+/*! \brief Serves the PRQP requests (POST) under the path of an HTTP server */
+
+int PKI_PRQP_SERVER_attach(PKI_PRQP_SERVER *srv, PKI_HTTP_SERVER *http,
+			   const char *path) {
+
+	if (!srv || !http) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	return PKI_HTTP_SERVER_add_handler(http, path ? path : "/",
+		_prqp_http_handler, srv);
+}
@@ -17,6 +17,9 @@
  * the default config file /etc/pki.conf for the configured Resource Query
  * Authority (PRQP Server).
  *
+ * When only the CA certificate and the services are given, the URLs
+ * of each service come from the PRQP cache.
+ *
  */
 
 PKI_STACK * PKI_get_ca_resources(PKI_X509_CERT *caCert, 
@@ -26,6 +29,39 @@ PKI_STACK * PKI_get_ca_resources(PKI_X509_CERT *caCert,
 	PKI_X509_PRQP_REQ *p = NULL;
 	PKI_X509_PRQP_RESP *r = NULL;
 	PKI_STACK *addr_sk = NULL;
+	PKI_STACK *srv_sk = NULL;
+	char *srv = NULL;
+	int i = 0;
+
+	/* Same query as the cache (the CA certificate only) */
+	if ( caCert && !caIssuerCert && !issuedCert
+			&& sk_services && PKI_STACK_elements( sk_services ) > 0 ) {
+
+		if ((addr_sk = PKI_STACK_new_null()) == NULL) return NULL;
+
+		for ( i = 0; i < PKI_STACK_elements( sk_services ); i++ ) {
+
+			srv = (char *) PKI_STACK_get_num( sk_services, i );
+			if ( !srv ) continue;
+
+			if ((srv_sk = PKI_PRQP_CACHE_get_service_sk( caCert, srv,
+								url_s )) == NULL)
+				continue;
+
+			while ( PKI_STACK_elements( srv_sk ) > 0 )
+				PKI_STACK_push( addr_sk, PKI_STACK_del_num( srv_sk, 0 ));
+
+			PKI_STACK_free_all( srv_sk );
+		}
+
+		if ( PKI_STACK_elements( addr_sk ) == 0 ) {
+			PKI_log_debug ("PKI_get_ca_resources()::No list of address is returned!");
+			PKI_STACK_free( addr_sk );
+			return NULL;
+		}
+
+		return addr_sk;
+	}
 
 	p = PKI_X509_PRQP_REQ_new_certs_res ( caCert, caIssuerCert, 
 						issuedCert, sk_services );
@@ -70,24 +106,11 @@ PKI_STACK * PKI_get_ca_resources(PKI_X509_CERT *caCert,
 PKI_STACK * PKI_get_ca_service_sk( PKI_X509_CERT *caCert, 
 					char *srv, char *url_s ) {
 
-	PKI_STACK *services = NULL;
-	PKI_STACK *ret_sk = NULL;
-
 	if( !srv || !caCert ) return ( NULL );
 
-	if((services = PKI_STACK_new_null()) == NULL ) {
-		PKI_log_debug("Stack creation error in %s:%d",
-						__FILE__, __LINE__ );
-		return ( NULL );
-	}
-
-	PKI_STACK_push( services, strdup( srv ));
-
-	ret_sk = PKI_get_ca_resources( caCert, NULL, NULL, services, url_s );
-
-	PKI_STACK_free_all( services );
-
-	return ( ret_sk );
+	/* Resolved services are cached per CA, discovery only happens
+	 * on the first use (or after the URLs expire) */
+	return PKI_PRQP_CACHE_get_service_sk( caCert, srv, url_s );
 }
 
 PKI_STACK * PKI_get_cert_service_sk( PKI_X509_CERT *cert, 
@@ -128,25 +151,15 @@ PKI_STACK * PKI_get_cert_service_sk( PKI_X509_CERT *cert,
 
 char * PKI_get_ca_service( PKI_X509_CERT *caCert, char *srv, char *url_s ) {
 
-	PKI_STACK *services = NULL;
 	PKI_STACK *ret_sk = NULL;
 
 	char *ret_s = NULL;
 
 	if( !srv || !caCert ) return ( NULL );
 
-	if((services = PKI_STACK_new_null()) == NULL ) {
-		PKI_log_debug("Stack creation error in %s:%d",
-						__FILE__, __LINE__ );
-		return ( NULL );
-	}
-
 	PKI_log_debug ("Getting Address for %s", srv );
 
-	PKI_STACK_push( services, strdup(srv) );
-	ret_sk = PKI_get_ca_resources( caCert, NULL, NULL, services, url_s );
-
-	PKI_STACK_free_all( services );
+	ret_sk = PKI_get_ca_service_sk( caCert, srv, url_s );
 
 	if( !ret_sk ) {
 		PKI_log_debug("No address returned for %s", srv );
@@ -168,6 +181,7 @@ char * PKI_get_ca_service( PKI_X509_CERT *caCert, char *srv, char *url_s ) {
 
 PKI_X509_PRQP_RESP * PKI_DISCOVER_get_resp ( PKI_X509_PRQP_REQ *p, char *url_s ) {
 
+	PKI_X509_PRQP_RESP *ret = NULL;
 	URL *url = NULL;
 
 	if( p == NULL ) return (NULL);
@@ -178,7 +192,11 @@ PKI_X509_PRQP_RESP * PKI_DISCOVER_get_resp ( PKI_X509_PRQP_REQ *p, char *url_s )
 		}
 	}
 
-	return( PKI_DISCOVER_get_resp_url( p, url ));
+	ret = PKI_DISCOVER_get_resp_url( p, url );
+
+	if ( url ) URL_free ( url );
+
+	return ( ret );
 }
 
 /*!
@@ -80,6 +80,9 @@ PKI_ID PKI_X509_SCEP_ATTRIBUTE_get_nid ( SCEP_ATTRIBUTE_TYPE num ) {
 	SCEP_CONF_ATTRIBUTE *curr = NULL;
 	int i = 0;
 
+	// Registers the SCEP attributes (first use only)
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_SCEP);
+
 	i = 0;
         while( i < SCEP_CONF_LIST_SIZE ) {
 		curr = &SCEP_ATTRIBUTE_list[i];
@@ -219,7 +222,7 @@ PKI_MEM * PKI_X509_SCEP_MSG_get_attr_value(const PKI_X509_SCEP_MSG * const msg,
 	int nid = NID_undef;
 
 	// Input Check
-	if (!msg || msg->value) {
+	if (!msg || !msg->value) {
 		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 		return NULL;
 	}
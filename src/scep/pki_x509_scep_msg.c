@@ -104,6 +104,7 @@ PKI_X509_SCEP_MSG * PKI_X509_SCEP_MSG_new_certreq ( PKI_X509_KEYPAIR *key,
 
 	PKI_X509_SCEP_MSG *ret = NULL;
 	PKI_X509_SCEP_DATA *scep_data = NULL;
+	PKI_MEM *trans_id = NULL;
 
 	PKI_X509_REQ *my_request = NULL;
 	PKI_X509_CERT *my_signer = NULL;
@@ -196,6 +197,11 @@ PKI_X509_SCEP_MSG * PKI_X509_SCEP_MSG_new_certreq ( PKI_X509_KEYPAIR *key,
 		goto err;
 	}
 
+	if ((trans_id = PKI_X509_SCEP_MSG_new_trans_id ( key )) != NULL ) {
+		PKI_X509_SCEP_MSG_set_trans_id ( ret, trans_id );
+		PKI_MEM_free ( trans_id );
+	}
+
 	PKI_X509_SCEP_MSG_set_sender_nonce ( ret, NULL );
 	PKI_X509_SCEP_MSG_set_type ( ret, PKI_X509_SCEP_MSG_PKCSREQ );
 
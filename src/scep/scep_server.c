@@ -0,0 +1,770 @@
+/*
+ * OpenCA SCEP - Server side message pipeline
+ * (c) 2009 by Massimiliano Pala and OpenCA Labs
+ * All Rights Reserved
+ *
+ * The request is parsed once into the OpenSSL structures and every
+ * stage works on them directly: the signed attributes, the signer
+ * certificate and the embedded EnvelopedData are referenced in place
+ * (no re-encoding through PKI_X509 wrappers). The CertRep is built with
+ * the signer certificate of the request as the only recipient and with
+ * the content cipher used by the client.
+ */
+
+#include <libpki/pki.h>
+
+/* Request being processed (references into the decoded message) */
+typedef struct scep_server_req_st {
+	PKCS7 *p7;
+	PKCS7_SIGNER_INFO *si;
+	X509 *signer;
+	int type;
+	ASN1_TYPE *trans_id;
+	ASN1_TYPE *nonce;
+	PKCS7 *env;
+	const EVP_CIPHER *cipher;
+	X509_REQ *req;
+	PKI_X509_CERT *issued;
+	SCEP_STATUS status;
+	SCEP_FAILURE fail;
+} SCEP_SERVER_REQ;
+
+struct pki_scep_server_st {
+	/* RA credentials (references) */
+	EVP_PKEY *ra_key;
+	X509 *ra_cert;
+	const EVP_MD *md;
+
+	/* GetCACert response (degenerate SignedData) */
+	unsigned char *ca_certs;
+	size_t ca_certs_size;
+
+	/* Issuance callback */
+	PKI_SCEP_SERVER_ISSUE_CB cb;
+	void *cb_ctx;
+
+	/* NIDs of the SCEP attributes */
+	int nid[SCEP_ATTRIBUTE_PROXY_AUTH + 1];
+
+	PKI_SCEP_SERVER_STATS stats;
+};
+
+// ==================
+// Helpers
+// ==================
+
+static uint64_t _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void _stage_end(PKI_SCEP_SERVER *srv, PKI_SCEP_SERVER_STAGE stage, uint64_t start) {
+
+	uint64_t ns = _now_ns() - start;
+	uint64_t max = __atomic_load_n(&srv->stats.stage_max_ns[stage], __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&srv->stats.stage_count[stage], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&srv->stats.stage_ns[stage], ns, __ATOMIC_RELAXED);
+
+	while (ns > max && !__atomic_compare_exchange_n(&srv->stats.stage_max_ns[stage],
+			&max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static int _attr_int(const PKCS7_SIGNER_INFO *si, int nid) {
+
+	ASN1_TYPE *a = NULL;
+	char buf[16];
+	int len = 0;
+
+	if ((a = PKCS7_get_signed_attribute(si, nid)) == NULL
+			|| a->type != V_ASN1_PRINTABLESTRING) return -1;
+
+	if ((len = a->value.printablestring->length) <= 0 || len >= (int) sizeof(buf))
+		return -1;
+
+	memcpy(buf, a->value.printablestring->data, (size_t) len);
+	buf[len] = '\x0';
+
+	return atoi(buf);
+}
+
+static int _add_attr_int(PKCS7_SIGNER_INFO *si, int nid, int val) {
+
+	ASN1_PRINTABLESTRING *s = NULL;
+	char buf[16];
+
+	snprintf(buf, sizeof(buf), "%d", val);
+
+	if ((s = ASN1_PRINTABLESTRING_new()) == NULL
+			|| !ASN1_STRING_set(s, buf, (int) strlen(buf))
+			|| !PKCS7_add_signed_attribute(si, nid, V_ASN1_PRINTABLESTRING, s)) {
+		if (s) ASN1_PRINTABLESTRING_free(s);
+		return PKI_ERR;
+	}
+
+	return PKI_OK;
+}
+
+static int _add_attr_dup(PKCS7_SIGNER_INFO *si, int nid, const ASN1_TYPE *a) {
+
+	ASN1_STRING *s = NULL;
+
+	if ((s = ASN1_STRING_dup(a->value.asn1_string)) == NULL
+			|| !PKCS7_add_signed_attribute(si, nid, a->type, s)) {
+		if (s) ASN1_STRING_free(s);
+		return PKI_ERR;
+	}
+
+	return PKI_OK;
+}
+
+/* Reads all the data from a BIO into a malloc'd buffer */
+static unsigned char * _bio_read_all(BIO *bio, size_t *size) {
+
+	unsigned char *buf = NULL, *tmp = NULL;
+	size_t len = 0, alloc = 0;
+	int n = 0;
+
+	for (;;) {
+		if (alloc - len < 4096) {
+			alloc = alloc ? alloc * 2 : 8192;
+			if ((tmp = realloc(buf, alloc)) == NULL) {
+				free(buf);
+				return NULL;
+			}
+			buf = tmp;
+		}
+		if ((n = BIO_read(bio, buf + len, (int) (alloc - len))) <= 0) break;
+		len += (size_t) n;
+	}
+
+	*size = len;
+
+	return buf;
+}
+
+// ==================
+// Server
+// ==================
+
+/*! \brief Returns a new SCEP server (RA and callback are set separately) */
+
+PKI_SCEP_SERVER * PKI_SCEP_SERVER_new(void) {
+
+	PKI_SCEP_SERVER *srv = NULL;
+	int i = 0;
+
+	if ((srv = calloc(1, sizeof(PKI_SCEP_SERVER))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	// Registers the SCEP attributes (first use only)
+	for (i = SCEP_ATTRIBUTE_MESSAGE_TYPE; i <= SCEP_ATTRIBUTE_PROXY_AUTH; i++)
+		srv->nid[i] = PKI_X509_SCEP_ATTRIBUTE_get_nid((SCEP_ATTRIBUTE_TYPE) i);
+
+	return srv;
+}
+
+/*! \brief Frees the memory associated with a PKI_SCEP_SERVER */
+
+void PKI_SCEP_SERVER_free(PKI_SCEP_SERVER *srv) {
+
+	if (!srv) return;
+
+	if (srv->ra_key) EVP_PKEY_free(srv->ra_key);
+	if (srv->ra_cert) X509_free(srv->ra_cert);
+	free(srv->ca_certs);
+
+	free(srv);
+}
+
+/*!
+ * \brief Sets the RA keypair (RSA) and certificate used to decrypt the
+ *        requests and to sign the responses. The RA certificate and the
+ *        ca_certs (if any) are returned for GetCACert.
+ */
+
+int PKI_SCEP_SERVER_set_ra(PKI_SCEP_SERVER *srv, PKI_X509_KEYPAIR *k,
+		PKI_X509_CERT *x, PKI_DIGEST_ALG *dgst, PKI_X509_CERT_STACK *ca_certs) {
+
+	const EVP_MD *md = dgst;
+	PKCS7 *p7 = NULL;
+	PKI_X509_CERT *c = NULL;
+	unsigned char *der = NULL, *p = NULL;
+	int len = 0, i = 0;
+
+	if (!srv || !k || !k->value || !x || !x->value)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	// PKCS#7 key transport is RSA only
+	if (EVP_PKEY_base_id((EVP_PKEY *) k->value) != EVP_PKEY_RSA)
+		return PKI_ERROR(PKI_ERR_PARAM_TYPE, "SCEP requires an RSA RA key");
+
+	if (!md || md == PKI_DIGEST_ALG_NULL) md = EVP_sha256();
+
+	// GetCACert response
+	if ((p7 = PKCS7_new()) == NULL || !PKCS7_set_type(p7, NID_pkcs7_signed)
+			|| !PKCS7_content_new(p7, NID_pkcs7_data)
+			|| !PKCS7_add_certificate(p7, (X509 *) x->value)) goto err;
+
+	for (i = 0; ca_certs && i < PKI_STACK_X509_CERT_elements(ca_certs); i++) {
+		if ((c = PKI_STACK_X509_CERT_get_num(ca_certs, i)) != NULL && c->value
+				&& !PKCS7_add_certificate(p7, (X509 *) c->value)) goto err;
+	}
+
+	if ((len = i2d_PKCS7(p7, NULL)) <= 0 || (der = malloc((size_t) len)) == NULL)
+		goto err;
+
+	p = der;
+	i2d_PKCS7(p7, &p);
+	PKCS7_free(p7);
+
+	EVP_PKEY_up_ref((EVP_PKEY *) k->value);
+	X509_up_ref((X509 *) x->value);
+
+	if (srv->ra_key) EVP_PKEY_free(srv->ra_key);
+	if (srv->ra_cert) X509_free(srv->ra_cert);
+	free(srv->ca_certs);
+
+	srv->ra_key = k->value;
+	srv->ra_cert = x->value;
+	srv->md = md;
+	srv->ca_certs = der;
+	srv->ca_certs_size = (size_t) len;
+
+	return PKI_OK;
+
+err:
+	if (p7) PKCS7_free(p7);
+	free(der);
+
+	return PKI_ERROR(PKI_ERR_X509_PKCS7_, NULL);
+}
+
+/*! \brief Uses the keypair, certificate and CA certificate of a token */
+
+int PKI_SCEP_SERVER_set_token(PKI_SCEP_SERVER *srv, PKI_TOKEN *tk,
+				PKI_DIGEST_ALG *dgst) {
+
+	PKI_X509_CERT_STACK *sk = NULL;
+	int ret = PKI_ERR;
+
+	if (!srv || !tk || !tk->keypair || !tk->cert)
+		return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (tk->cacert && (sk = PKI_STACK_X509_CERT_new()) != NULL)
+		PKI_STACK_X509_CERT_push(sk, tk->cacert);
+
+	ret = PKI_SCEP_SERVER_set_ra(srv, tk->keypair, tk->cert, dgst, sk);
+
+	if (sk) PKI_STACK_X509_CERT_free(sk);
+
+	return ret;
+}
+
+/*! \brief Sets the callback that issues the certificates */
+
+int PKI_SCEP_SERVER_set_issue_cb(PKI_SCEP_SERVER *srv,
+		PKI_SCEP_SERVER_ISSUE_CB cb, void *ctx) {
+
+	if (!srv) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	srv->cb = cb;
+	srv->cb_ctx = ctx;
+
+	return PKI_OK;
+}
+
+// ==================
+// Pipeline
+// ==================
+
+/* Parses the SignedData and references the signer and the attributes */
+static int _decode(PKI_SCEP_SERVER *srv, SCEP_SERVER_REQ *r, const PKI_MEM *req) {
+
+	STACK_OF(PKCS7_SIGNER_INFO) *sk = NULL;
+	const unsigned char *p = req->data;
+
+	if ((r->p7 = d2i_PKCS7(NULL, &p, (long) req->size)) == NULL
+			|| !PKCS7_type_is_signed(r->p7)) return PKI_ERR;
+
+	if ((sk = PKCS7_get_signer_info(r->p7)) == NULL
+			|| (r->si = sk_PKCS7_SIGNER_INFO_value(sk, 0)) == NULL
+			|| (r->signer = PKCS7_cert_from_signer_info(r->p7, r->si)) == NULL)
+		return PKI_ERR;
+
+	r->type = _attr_int(r->si, srv->nid[SCEP_ATTRIBUTE_MESSAGE_TYPE]);
+
+	if ((r->trans_id = PKCS7_get_signed_attribute(r->si,
+			srv->nid[SCEP_ATTRIBUTE_TRANS_ID])) != NULL
+				&& r->trans_id->type != V_ASN1_PRINTABLESTRING)
+		r->trans_id = NULL;
+
+	if ((r->nonce = PKCS7_get_signed_attribute(r->si,
+			srv->nid[SCEP_ATTRIBUTE_SENDER_NONCE])) != NULL
+				&& r->nonce->type != V_ASN1_OCTET_STRING)
+		r->nonce = NULL;
+
+	if (!r->trans_id || !r->nonce) {
+		r->status = SCEP_STATUS_FAILURE;
+		r->fail = SCEP_FAILURE_BADREQUEST;
+	}
+
+	return PKI_OK;
+}
+
+/* Verifies the signature over the embedded content */
+static void _verify(SCEP_SERVER_REQ *r) {
+
+	unsigned char buf[4096];
+	BIO *bio = NULL;
+
+	if ((bio = PKCS7_dataInit(r->p7, NULL)) != NULL) {
+		while (BIO_read(bio, buf, sizeof(buf)) > 0);
+		if (PKCS7_signatureVerify(bio, r->p7, r->si, r->signer) == 1) {
+			BIO_free_all(bio);
+			return;
+		}
+		BIO_free_all(bio);
+	}
+
+	r->status = SCEP_STATUS_FAILURE;
+	r->fail = SCEP_FAILURE_BADMESSAGECHECK;
+}
+
+/* Decrypts the EnvelopedData and parses the certificate request */
+static void _decrypt(PKI_SCEP_SERVER *srv, SCEP_SERVER_REQ *r) {
+
+	PKCS7 *content = r->p7->d.sign->contents;
+	const unsigned char *p = NULL;
+	unsigned char *der = NULL;
+	size_t size = 0;
+	BIO *bio = NULL;
+
+	r->status = SCEP_STATUS_FAILURE;
+	r->fail = SCEP_FAILURE_BADREQUEST;
+
+	if (!content || !PKCS7_type_is_data(content) || !content->d.data) return;
+
+	p = content->d.data->data;
+	if ((r->env = d2i_PKCS7(NULL, &p, content->d.data->length)) == NULL
+			|| !PKCS7_type_is_enveloped(r->env)) return;
+
+	r->cipher = EVP_get_cipherbyobj(r->env->d.enveloped->enc_data->algorithm->algorithm);
+
+	if ((bio = PKCS7_dataDecode(r->env, srv->ra_key, NULL, srv->ra_cert)) == NULL) {
+		r->fail = SCEP_FAILURE_BADMESSAGECHECK;
+		return;
+	}
+
+	der = _bio_read_all(bio, &size);
+	BIO_free_all(bio);
+
+	if (!der || size == 0) {
+		free(der);
+		return;
+	}
+
+	// CertPoll carries an IssuerAndSubject, the transId is used instead
+	if (r->type == PKI_X509_SCEP_MSG_GETCERTINITIAL) {
+		free(der);
+		r->status = SCEP_STATUS_SUCCESS;
+		return;
+	}
+
+	p = der;
+	r->req = d2i_X509_REQ(NULL, &p, (long) size);
+	free(der);
+
+	if (!r->req) return;
+
+	// Proof of possession
+	if (X509_REQ_verify(r->req, X509_REQ_get0_pubkey(r->req)) != 1) {
+		r->fail = SCEP_FAILURE_BADMESSAGECHECK;
+		return;
+	}
+
+	r->status = SCEP_STATUS_SUCCESS;
+}
+
+/* Dispatches the request to the issuance callback */
+static void _issue(PKI_SCEP_SERVER *srv, SCEP_SERVER_REQ *r) {
+
+	PKI_X509_REQ *req = NULL;
+	PKI_X509_CERT *signer = NULL;
+	char *trans_id = NULL;
+	ASN1_STRING *s = r->trans_id->value.printablestring;
+
+	r->fail = SCEP_FAILURE_BADREQUEST;
+
+	if (!srv->cb) {
+		r->status = SCEP_STATUS_FAILURE;
+		return;
+	}
+
+	if (r->req && (req = PKI_X509_new_value(PKI_DATATYPE_X509_REQ, r->req, NULL)) != NULL)
+		r->req = NULL;
+
+	X509_up_ref(r->signer);
+	if ((signer = PKI_X509_new_value(PKI_DATATYPE_X509_CERT, r->signer, NULL)) == NULL)
+		X509_free(r->signer);
+
+	if ((trans_id = malloc((size_t) s->length + 1)) != NULL) {
+		memcpy(trans_id, s->data, (size_t) s->length);
+		trans_id[s->length] = '\x0';
+	}
+
+	if (!signer || !trans_id || (r->type != PKI_X509_SCEP_MSG_GETCERTINITIAL && !req)) {
+		r->status = SCEP_STATUS_FAILURE;
+	} else {
+		r->status = srv->cb(req, signer, (SCEP_MESSAGE_TYPE) r->type, trans_id,
+			&r->issued, &r->fail, srv->cb_ctx);
+	}
+
+	if (r->status == SCEP_STATUS_SUCCESS && (!r->issued || !r->issued->value)) {
+		r->status = SCEP_STATUS_FAILURE;
+		r->fail = SCEP_FAILURE_BADREQUEST;
+	}
+
+	if (req) PKI_X509_REQ_free(req);
+	if (signer) PKI_X509_CERT_free(signer);
+	free(trans_id);
+}
+
+/* Encrypts the issued certificate (degenerate SignedData) for the signer */
+static unsigned char * _encrypt(SCEP_SERVER_REQ *r, int *len) {
+
+	PKCS7 *certs = NULL, *env = NULL;
+	STACK_OF(X509) *recips = NULL;
+	unsigned char *der = NULL, *ret = NULL;
+	BIO *in = NULL;
+	int der_len = 0;
+
+	*len = 0;
+
+	if ((certs = PKCS7_new()) == NULL || !PKCS7_set_type(certs, NID_pkcs7_signed)
+			|| !PKCS7_content_new(certs, NID_pkcs7_data)
+			|| !PKCS7_add_certificate(certs, (X509 *) r->issued->value)
+			|| (der_len = i2d_PKCS7(certs, &der)) <= 0) goto end;
+
+	if ((recips = sk_X509_new_null()) == NULL || !sk_X509_push(recips, r->signer)
+			|| (in = BIO_new_mem_buf(der, der_len)) == NULL) goto end;
+
+	if ((env = PKCS7_encrypt(recips, in, r->cipher ? r->cipher :
+			PKI_CIPHER_AES(256,cbc), PKCS7_BINARY)) == NULL) goto end;
+
+	*len = i2d_PKCS7(env, &ret);
+
+end:
+	if (env) PKCS7_free(env);
+	if (in) BIO_free(in);
+	if (recips) sk_X509_free(recips);
+	if (certs) PKCS7_free(certs);
+	OPENSSL_free(der);
+
+	return ret;
+}
+
+/* Builds and signs the CertRep */
+static PKI_MEM * _sign(PKI_SCEP_SERVER *srv, const SCEP_SERVER_REQ *r,
+		const unsigned char *env, int env_len) {
+
+	PKCS7 *p7 = NULL;
+	PKCS7_SIGNER_INFO *si = NULL;
+	ASN1_OCTET_STRING *nonce = NULL;
+	unsigned char buf[PKI_SCEP_SERVER_NONCE_SIZE];
+	unsigned char *p = NULL;
+	PKI_MEM *ret = NULL;
+	BIO *bio = NULL;
+	int len = 0;
+
+	if ((p7 = PKCS7_new()) == NULL || !PKCS7_set_type(p7, NID_pkcs7_signed)
+			|| (si = PKCS7_add_signature(p7, srv->ra_cert, srv->ra_key, srv->md)) == NULL
+			|| !PKCS7_add_certificate(p7, srv->ra_cert)
+			|| !PKCS7_content_new(p7, NID_pkcs7_data)) goto end;
+
+	// Signed attributes
+	if (!PKCS7_add_signed_attribute(si, NID_pkcs9_contentType, V_ASN1_OBJECT,
+				OBJ_nid2obj(NID_pkcs7_data))
+			|| _add_attr_int(si, srv->nid[SCEP_ATTRIBUTE_MESSAGE_TYPE],
+				PKI_X509_SCEP_MSG_CERTREP) != PKI_OK
+			|| _add_attr_int(si, srv->nid[SCEP_ATTRIBUTE_PKI_STATUS],
+				(int) r->status) != PKI_OK) goto end;
+
+	if (r->status == SCEP_STATUS_FAILURE && _add_attr_int(si,
+			srv->nid[SCEP_ATTRIBUTE_FAIL_INFO], (int) r->fail) != PKI_OK) goto end;
+
+	if (r->trans_id && _add_attr_dup(si, srv->nid[SCEP_ATTRIBUTE_TRANS_ID],
+			r->trans_id) != PKI_OK) goto end;
+
+	if (r->nonce && _add_attr_dup(si, srv->nid[SCEP_ATTRIBUTE_RECIPIENT_NONCE],
+			r->nonce) != PKI_OK) goto end;
+
+	if (RAND_bytes(buf, sizeof(buf)) != 1 || (nonce = ASN1_OCTET_STRING_new()) == NULL
+			|| !ASN1_OCTET_STRING_set(nonce, buf, sizeof(buf))
+			|| !PKCS7_add_signed_attribute(si, srv->nid[SCEP_ATTRIBUTE_SENDER_NONCE],
+				V_ASN1_OCTET_STRING, nonce)) {
+		if (nonce) ASN1_OCTET_STRING_free(nonce);
+		goto end;
+	}
+
+	// Content (EnvelopedData, empty for failures) and signature
+	if ((bio = PKCS7_dataInit(p7, NULL)) == NULL
+			|| (env_len > 0 && BIO_write(bio, env, env_len) != env_len)) goto end;
+
+	(void) BIO_flush(bio);
+
+	if (!PKCS7_dataFinal(p7, bio) || (len = i2d_PKCS7(p7, NULL)) <= 0
+			|| (ret = PKI_MEM_new((size_t) len)) == NULL) goto end;
+
+	p = ret->data;
+	i2d_PKCS7(p7, &p);
+
+end:
+	if (bio) BIO_free_all(bio);
+	if (p7) PKCS7_free(p7);
+
+	return ret;
+}
+
+/*!
+ * \brief Processes a PKIOperation message (DER) and returns the signed
+ *        CertRep (DER), NULL if the request can not be answered (i.e.,
+ *        it can not be parsed or there is no signer certificate)
+ */
+
+PKI_MEM * PKI_SCEP_SERVER_process(PKI_SCEP_SERVER *srv, const PKI_MEM *req) {
+
+	SCEP_SERVER_REQ r;
+	unsigned char *env = NULL;
+	PKI_MEM *ret = NULL;
+	uint64_t start = 0;
+	int env_len = 0;
+
+	if (!srv || !req || !req->data || !req->size) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	if (!srv->ra_key) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, "SCEP RA is not configured");
+		return NULL;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.status = SCEP_STATUS_SUCCESS;
+
+	__atomic_fetch_add(&srv->stats.requests, 1, __ATOMIC_RELAXED);
+
+	start = _now_ns();
+	if (_decode(srv, &r, req) != PKI_OK) {
+		__atomic_fetch_add(&srv->stats.errors, 1, __ATOMIC_RELAXED);
+		if (r.p7) PKCS7_free(r.p7);
+		return NULL;
+	}
+	_stage_end(srv, PKI_SCEP_SERVER_STAGE_DECODE, start);
+
+	if (r.status == SCEP_STATUS_SUCCESS) {
+		start = _now_ns();
+		_verify(&r);
+		_stage_end(srv, PKI_SCEP_SERVER_STAGE_VERIFY, start);
+	}
+
+	if (r.status == SCEP_STATUS_SUCCESS) {
+		switch (r.type) {
+			case PKI_X509_SCEP_MSG_PKCSREQ:
+			case PKI_X509_SCEP_MSG_V2REQUEST:
+			case PKI_X509_SCEP_MSG_GETCERTINITIAL:
+				start = _now_ns();
+				_decrypt(srv, &r);
+				_stage_end(srv, PKI_SCEP_SERVER_STAGE_DECRYPT, start);
+				break;
+
+			default:
+				r.status = SCEP_STATUS_FAILURE;
+				r.fail = SCEP_FAILURE_BADREQUEST;
+		}
+	}
+
+	if (r.status == SCEP_STATUS_SUCCESS) {
+		start = _now_ns();
+		_issue(srv, &r);
+		_stage_end(srv, PKI_SCEP_SERVER_STAGE_ISSUE, start);
+	}
+
+	if (r.status == SCEP_STATUS_SUCCESS) {
+		start = _now_ns();
+		if ((env = _encrypt(&r, &env_len)) == NULL) {
+			r.status = SCEP_STATUS_FAILURE;
+			r.fail = SCEP_FAILURE_BADALG;
+		}
+		_stage_end(srv, PKI_SCEP_SERVER_STAGE_ENCRYPT, start);
+	}
+
+	start = _now_ns();
+	ret = _sign(srv, &r, env, env_len);
+	_stage_end(srv, PKI_SCEP_SERVER_STAGE_SIGN, start);
+
+	if (!ret) {
+		PKI_ERROR(PKI_ERR_SIGNATURE_CREATE, NULL);
+		__atomic_fetch_add(&srv->stats.errors, 1, __ATOMIC_RELAXED);
+	} else switch (r.status) {
+		case SCEP_STATUS_SUCCESS:
+			__atomic_fetch_add(&srv->stats.success, 1, __ATOMIC_RELAXED);
+			break;
+		case SCEP_STATUS_PENDING:
+			__atomic_fetch_add(&srv->stats.pending, 1, __ATOMIC_RELAXED);
+			break;
+		default:
+			__atomic_fetch_add(&srv->stats.failure, 1, __ATOMIC_RELAXED);
+	}
+
+	OPENSSL_free(env);
+	if (r.issued) PKI_X509_CERT_free(r.issued);
+	if (r.req) X509_REQ_free(r.req);
+	if (r.env) PKCS7_free(r.env);
+	PKCS7_free(r.p7);
+
+	return ret;
+}
+
+/*! \brief Returns the GetCACert response (RA and CA certificates) */
+
+PKI_MEM * PKI_SCEP_SERVER_get_ca_certs(const PKI_SCEP_SERVER *srv) {
+
+	if (!srv || !srv->ca_certs) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	return PKI_MEM_new_data(srv->ca_certs_size, srv->ca_certs);
+}
+
+/*! \brief Copies the counters of the server */
+
+int PKI_SCEP_SERVER_get_stats(const PKI_SCEP_SERVER *srv, PKI_SCEP_SERVER_STATS *stats) {
+
+	const uint64_t *src = NULL;
+	uint64_t *dst = NULL;
+	size_t i = 0;
+
+	if (!srv || !stats) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	src = (const uint64_t *) &srv->stats;
+	dst = (uint64_t *) stats;
+
+	for (i = 0; i < sizeof(PKI_SCEP_SERVER_STATS) / sizeof(uint64_t); i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+
+	return PKI_OK;
+}
+
+/*! \brief Resets the counters of the server */
+
+void PKI_SCEP_SERVER_reset_stats(PKI_SCEP_SERVER *srv) {
+
+	uint64_t *dst = NULL;
+	size_t i = 0;
+
+	if (!srv) return;
+
+	dst = (uint64_t *) &srv->stats;
+
+	for (i = 0; i < sizeof(PKI_SCEP_SERVER_STATS) / sizeof(uint64_t); i++)
+		__atomic_store_n(&dst[i], 0, __ATOMIC_RELAXED);
+}
+
+// ==================
+// HTTP
+// ==================
+
+/* Returns a PKI_Malloc'd copy of a query parameter, NULL if not present */
+static char * _query_param(const char *path, const char *name) {
+
+	const char *p = NULL, *end = NULL;
+	size_t len = strlen(name);
+	char *ret = NULL;
+
+	if (!path || (p = strchr(path, '?')) == NULL) return NULL;
+
+	while (p && *p) {
+		p++;
+		if (strncmp(p, name, len) == 0 && p[len] == '=') {
+			p += len + 1;
+			if ((end = strchr(p, '&')) == NULL) end = p + strlen(p);
+			if ((ret = PKI_Malloc((size_t) (end - p) + 1)) != NULL)
+				memcpy(ret, p, (size_t) (end - p));
+			return ret;
+		}
+		p = strchr(p, '&');
+	}
+
+	return NULL;
+}
+
+static int _scep_http_handler(const PKI_HTTP *req, PKI_HTTP *resp, void *ctx) {
+
+	PKI_SCEP_SERVER *srv = ctx;
+	PKI_MEM *msg = NULL;
+	char *op = NULL, *val = NULL;
+	int ret = PKI_ERR;
+
+	resp->code = 400;
+
+	if ((op = _query_param(req->path, "operation")) == NULL) return PKI_ERR;
+
+	if (strcmp(op, "GetCACaps") == 0) {
+
+		resp->body = PKI_MEM_new_data(strlen(PKI_SCEP_SERVER_CAPS),
+			(const unsigned char *) PKI_SCEP_SERVER_CAPS);
+		resp->type = strdup(PKI_SCEP_SERVER_TYPE_CAPS);
+
+	} else if (strcmp(op, "GetCACert") == 0) {
+
+		resp->body = PKI_SCEP_SERVER_get_ca_certs(srv);
+		resp->type = strdup(PKI_SCEP_SERVER_TYPE_CA_RA_CERT);
+
+	} else if (strcmp(op, "PKIOperation") == 0) {
+
+		if (req->method == PKI_HTTP_METHOD_POST) {
+			msg = req->body;
+		} else if ((val = _query_param(req->path, "message")) != NULL
+				&& (msg = PKI_MEM_new_data(strlen(val), (unsigned char *) val)) != NULL
+				&& (PKI_MEM_decode(msg, PKI_DATA_FORMAT_URL, 0) != PKI_OK
+					|| PKI_MEM_decode(msg, PKI_DATA_FORMAT_B64, 0) != PKI_OK)) {
+			PKI_MEM_free(msg);
+			msg = NULL;
+		}
+
+		if (msg && msg->size > 0 && (resp->body = PKI_SCEP_SERVER_process(srv, msg)) != NULL)
+			resp->type = strdup(PKI_SCEP_SERVER_TYPE_MESSAGE);
+
+		if (msg && msg != req->body) PKI_MEM_free(msg);
+	}
+
+	if (resp->body) {
+		resp->code = 200;
+		ret = PKI_OK;
+	}
+
+	if (val) PKI_Free(val);
+	PKI_Free(op);
+
+	return ret;
+}
+
+/*! \brief Serves the SCEP operations under the path of an HTTP server */
+
+int PKI_SCEP_SERVER_attach(PKI_SCEP_SERVER *srv, PKI_HTTP_SERVER *http,
+			   const char *path) {
+
+	if (!srv || !http) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	return PKI_HTTP_SERVER_add_handler(http, path ? path : "/",
+		_scep_http_handler, srv);
+}
@@ -18,30 +18,31 @@
 #include <libpki/stack.h>
 #include <pki.h>
 
-static PKI_STACK_NODE * _PKI_STACK_NODE_new( void *data )
+/* Initial number of slots allocated for the data array */
+#define PKI_STACK_MIN_SIZE		8
+
+static int _PKI_STACK_grow(PKI_STACK *st, int num)
 {
-	PKI_STACK_NODE *ret = NULL;
+	void **data = NULL;
+	int size = 0;
+
+	if (num <= st->size) return PKI_STACK_OK;
+
+	// Doubles the size to keep the pushes amortized O(1)
+	size = st->size ? st->size : PKI_STACK_MIN_SIZE;
+	while (size < num) size *= 2;
 
-	if ((ret = (PKI_STACK_NODE *) PKI_Malloc(sizeof(PKI_STACK))) == NULL)
+	// The array stays where it was allocated (heap or arena)
+	if ((data = (void **) PKI_Realloc(st->data, sizeof(void *) * (size_t) size)) == NULL)
 	{
 		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
-		return(NULL);
+		return PKI_STACK_ERR;
 	}
 
-	ret->next = NULL;
-	ret->prev = NULL;
-	ret->data = data;
-
-	return (ret);
-}
-
-static int _PKI_STACK_NODE_free(PKI_STACK_NODE *n)
-{
-	if (!n) return (PKI_STACK_ERR);
-
-	PKI_Free(n);
+	st->data = data;
+	st->size = size;
 
-	return(0);
+	return PKI_STACK_OK;
 }
 
 /*!
@@ -61,8 +62,8 @@ PKI_STACK * PKI_STACK_new( void (*free)())
 		return(NULL);
 	}
 
-	ret->head = NULL;
-	ret->tail = NULL;
+	ret->data = NULL;
+	ret->size = 0;
 	ret->elements = 0;
 
 	if (ret->free) ret->free = free;
@@ -88,11 +89,29 @@ PKI_STACK * PKI_STACK_new_null( void ) {
 	return ( PKI_STACK_new( NULL ));
 }
 
+/*!
+ * \brief Pre-allocates space for a number of elements in a PKI_STACK
+ *
+ * Use this function before pushing a large number of elements to avoid
+ * the re-allocation of the internal array. Returns PKI_STACK_OK in case
+ * of success or PKI_STACK_ERR otherwise.
+ */
+int PKI_STACK_reserve ( PKI_STACK *st, int num )
+{
+	if (st == NULL || num < 0)
+	{
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return PKI_STACK_ERR;
+	}
+
+	return _PKI_STACK_grow(st, num);
+}
+
 /*!
  * \brief PKI_STACK free all function
  *
  * This function frees the memory used by a PKI_STACK structure.
- * If the structure is not empty, the pointers to every node are freed,
+ * If the structure is not empty, the internal array is freed,
  * but the pointers to the actualy DATA are not freed. If you want to
  * completely clean up memorty, use the PKI_STACK_free_all().
  *
@@ -102,19 +121,13 @@ PKI_STACK * PKI_STACK_new_null( void ) {
 */
 int PKI_STACK_free (PKI_STACK * st)
 {
-	void * data = NULL;
-
 	if (st == NULL)
 	{
 		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 		return(PKI_STACK_ERR);
 	}
 
-	data = PKI_STACK_pop(st);
-	while (data != NULL)
-	{
-		data = PKI_STACK_pop(st);
-	}
+	if (st->data) PKI_Free(st->data);
 
 	PKI_Free ( st );
 
@@ -151,55 +164,29 @@ int PKI_STACK_free_all (PKI_STACK * st)
 	while (PKI_STACK_pop_free(st) == PKI_OK);
 
 	// Let's free the PKI_STACK data structure's memory
-	PKI_Free(st);
-
-	// All Done.
-	return PKI_OK;
+	return PKI_STACK_free(st);
 }
 
 /*!
  * \brief Pops the last element in PKI_STACK
  *
  * This function returns the data pointed by the last element of a PKI_STACK
- * and frees the internal memory. The calling program will have to free the
+ * and removes it from the stack. The calling program will have to free the
  * memory related to the returned pointer.
  */
 
 void * PKI_STACK_pop ( PKI_STACK *st ) {
 
-	PKI_STACK_NODE *n = NULL;
 	void *data = NULL;
 
 	// Checks the input
-	if ((st == NULL) || ( st->tail == NULL)) return NULL;
+	if ((st == NULL) || (st->elements <= 0)) return NULL;
 
-	// Get the last node of the structure
-	n = st->tail;
+	// Detaches the last element
+	data = st->data[--st->elements];
+	st->data[st->elements] = NULL; // Safety
 
-	// Let's update the tail pointers
-	st->tail = n ? n->prev : NULL;
-
-	// Let's check if the node we popped was also the head
-	if (st->head == n)
-	{
-		// We are actually emptying the list
-		st->elements = 0;
-		st->head = NULL;
-	}
-	else
-	{
-		// Updates the number of elements
-		st->elements--;
-	}
-
-	// Let's save the data pointer (we will return that)
-	data = n->data;
-	n->data = NULL; // Safety
-
-	// Now let's free the node data structure
-	PKI_Free(n);
-
-	// We return the data from the freed node
+	// We return the data from the removed element
 	return data;
 }
 
@@ -251,35 +238,18 @@ int PKI_STACK_pop_free ( PKI_STACK *st )
  */
 int PKI_STACK_push(PKI_STACK *st, void *obj)
 {
-	PKI_STACK_NODE *n = NULL;
-
 	if (st == NULL || obj == NULL)
 	{
 		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 		return(PKI_STACK_ERR);
 	}
 
-	if((n = _PKI_STACK_NODE_new(obj)) == NULL)
+	if (_PKI_STACK_grow(st, st->elements + 1) != PKI_STACK_OK)
 	{
-		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
 		return(PKI_STACK_ERR);
 	}
 
-	if (st->tail)
-	{
-		n->prev = st->tail;
-		n->next = NULL;
-
-		st->tail->next = n;
-		st->tail = n;
-	}
-	else
-	{
-		st->tail = n;
-		st->head = n;
-	}
-
-	st->elements++;
+	st->data[st->elements++] = obj;
 
 	return(st->elements);
 }
@@ -308,22 +278,9 @@ int PKI_STACK_elements(PKI_STACK *st)
  */
 void * PKI_STACK_get_num(PKI_STACK *st, int num)
 {
-	PKI_STACK_NODE *n;
-	int i;
-
-	if ((st == NULL) || (st->elements < num)) return NULL;
-
-	i = 0;
-	n = st->head;
+	if ((st == NULL) || (num < 0) || (num >= st->elements)) return NULL;
 
-	while (n)
-	{
-		if (i == num) return n->data;
-		n=n->next;
-		i++;
-	}
-
-	return NULL;
+	return st->data[num];
 }
 
 /*!
@@ -338,65 +295,25 @@ void * PKI_STACK_get_num(PKI_STACK *st, int num)
 
 int PKI_STACK_ins_num ( PKI_STACK *st, int num, void *obj )
 {
-	PKI_STACK_NODE *n = NULL;
-	PKI_STACK_NODE *new_n = NULL;
-
-	int i;
-
 	// Input checks
 	if (st == NULL || obj == NULL) {
 		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
 		return PKI_STACK_ERR;
 	}
 
-	if (num > st->elements) {
+	if (num < 0 || num > st->elements) {
 		PKI_ERROR(PKI_ERR_PARAM_RANGE, NULL);
 		return PKI_STACK_ERR;
 	}
 
-	// Gets the head pointer
-	n = st->head;
-	i = 0;
-
-	// Cycles through the nodes
-	while (n) {
-
-		// Stops at the i-th entry
-		if (i == num) break;
-
-		// Range check
-		if (i > num) return PKI_STACK_ERR;
-
-		// Gets the next entry
-		n = n->next;
-		i++;
-	}
-
-	// Allocates the new node
-	if ((new_n = _PKI_STACK_NODE_new ( obj )) == NULL) {
+	if (_PKI_STACK_grow(st, st->elements + 1) != PKI_STACK_OK) {
 		return PKI_STACK_ERR;
 	}
 
-	// Adds the current i-th node to the new next
-	new_n->next = n;
-
-	// Updates the prev and next
-	if (n) {
-		new_n->prev = n->prev;
-		n->prev = new_n;
-	} 
-
-	// Updates the head
-	if (num == 0 || st->head == n) {
-		st->head = new_n;
-	} else {
-		new_n->prev->next = new_n;
-	}
-
-	// Updates the tail
-	if (num == st->elements) {
-		st->tail = new_n;
-	}
+	// Shifts the following elements and stores the new one
+	memmove(&st->data[num + 1], &st->data[num],
+		sizeof(void *) * (size_t) (st->elements - num));
+	st->data[num] = obj;
 
 	// Updates the number of elements
 	st->elements++;
@@ -417,48 +334,19 @@ int PKI_STACK_ins_num ( PKI_STACK *st, int num, void *obj )
  * NULL.
  */
 void * PKI_STACK_del_num ( PKI_STACK *st, int num ) {
-	PKI_STACK_NODE *tmp_n = NULL;
-	PKI_STACK_NODE *n = NULL;
 
-	int i;
 	void *obj = NULL;
 
-	if( st == NULL ) return (NULL);
-
-	tmp_n = st->head; i = 0;
-	while ( tmp_n ) {
-		if ( i == num ) {
-			n = tmp_n;
-			break;
-		}
-		i++;
-		tmp_n = tmp_n->next;
-	}
-	if( n == NULL) return( NULL);
-
-	if( n->prev != NULL ) {
-		n->prev->next = n->next;
-	}
+	if ( st == NULL || num < 0 || num >= st->elements ) return (NULL);
 
-	if( n->next ) {
-		n->next->prev = n->prev;
-	}
+	obj = st->data[num];
 
-	if( num == 0 ) {
-		st->head = n->next;
-	}
+	// Shifts the following elements
+	memmove(&st->data[num], &st->data[num + 1],
+		sizeof(void *) * (size_t) (st->elements - num - 1));
 
-	if( num == PKI_STACK_elements( st ) ) {
-		st->tail = n->prev;
-	}
-
-	obj = n->data;
-	n->data = NULL;
-
-	_PKI_STACK_NODE_free( n );
 	st->elements--;
+	st->data[st->elements] = NULL;
 	
 	return(obj);
 }
-
-
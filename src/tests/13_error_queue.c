@@ -0,0 +1,238 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Thirteen (13) - Error Queue"
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Errors are checked via the queue, no need to log them
+	PKI_ERR_set_log(0);
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_ERR_ENTRY entry;
+	char *buf = NULL;
+
+	printf("   - Subtest 1: Get, Peek, and Clear\n");
+
+	PKI_ERR_clear();
+
+	if (PKI_ERR_get(NULL) != PKI_ERR_NONE) {
+		printf("     + Empty queue ...: Failed\n");
+		return 0;
+	}
+
+	PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+	PKI_ERROR(PKI_ERR_MEMORY_ALLOC, "Allocating %d bytes", 64);
+
+	if (PKI_ERR_count() != 2) {
+		printf("     + Queue size (%d) ...: Failed\n", PKI_ERR_count());
+		return 0;
+	}
+
+	if (PKI_ERR_peek(NULL) != PKI_ERR_PARAM_NULL
+			|| PKI_ERR_peek_last(NULL) != PKI_ERR_MEMORY_ALLOC) {
+		printf("     + Peek ...: Failed\n");
+		return 0;
+	}
+	printf("     + Peek ...: Ok\n");
+
+	if (PKI_ERR_get(&entry) != PKI_ERR_PARAM_NULL
+			|| PKI_ERR_ENTRY_get_detail(&entry) != NULL
+			|| entry.line <= 0 || !entry.file) {
+		printf("     + Get (no detail) ...: Failed\n");
+		return 0;
+	}
+
+	if (PKI_ERR_get(&entry) != PKI_ERR_MEMORY_ALLOC
+			|| strcmp(PKI_ERR_ENTRY_get_detail(&entry), "Allocating 64 bytes") != 0) {
+		printf("     + Get (formatted detail) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Get ...: Ok\n");
+
+	// The info string is copied (and it is not a format without arguments)
+	if ((buf = strdup("Cannot load 100% of the file")) == NULL) return 0;
+	PKI_ERROR(PKI_ERR_GENERAL, buf);
+	memset(buf, 'x', strlen(buf));
+	free(buf);
+
+	if (PKI_ERR_get(&entry) != PKI_ERR_GENERAL
+			|| strcmp(PKI_ERR_ENTRY_get_detail(&entry), "Cannot load 100% of the file") != 0) {
+		printf("     + Get (copied detail) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Copied detail ...: Ok\n");
+
+	// The detail is formatted when read, string arguments are copied
+	if ((buf = strdup("token.xml")) == NULL) return 0;
+	PKI_ERROR(PKI_ERR_CONFIG_LOAD, "%s: %-4d|%*.*s|%zu %ld %.2f %x %c %%",
+		buf, 12, 5, 3, "abcdef", (size_t) 7, -3L, 1.5, 255, 'z');
+	memset(buf, 'x', strlen(buf));
+	free(buf);
+
+	if (PKI_ERR_get(&entry) != PKI_ERR_CONFIG_LOAD
+			|| strcmp(PKI_ERR_ENTRY_get_detail(&entry), "token.xml: 12  |  abc|7 -3 1.50 ff z %") != 0) {
+		printf("     + Get (deferred detail) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Deferred detail ...: Ok\n");
+
+	PKI_ERROR(PKI_ERR_GENERAL, NULL);
+	PKI_ERR_clear();
+
+	if (PKI_ERR_count() != 0 || PKI_ERR_peek(NULL) != PKI_ERR_NONE) {
+		printf("     + Clear ...: Failed\n");
+		return 0;
+	}
+	printf("     + Clear ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	int i = 0;
+
+	printf("   - Subtest 2: Queue Overflow and Descriptions\n");
+
+	PKI_ERR_clear();
+
+	// Fills the queue beyond its capacity
+	for (i = 0; i < PKI_ERR_QUEUE_SIZE + 3; i++) {
+		PKI_ERROR(i == 3 ? PKI_ERR_URI_PARSE : PKI_ERR_GENERAL, NULL);
+	}
+
+	if (PKI_ERR_count() != PKI_ERR_QUEUE_SIZE) {
+		printf("     + Overflow ...: Failed\n");
+		return 0;
+	}
+
+	// The three oldest entries were dropped
+	if (PKI_ERR_peek(NULL) != PKI_ERR_URI_PARSE) {
+		printf("     + Oldest entry dropped ...: Failed\n");
+		return 0;
+	}
+	printf("     + Overflow ...: Ok\n");
+
+	PKI_ERR_clear();
+
+	// Unknown codes are reported as unknown
+	PKI_ERROR(PKI_ERR_CODE_SIZE + 10, NULL);
+	if (PKI_ERR_get(NULL) != PKI_ERR_UNKNOWN) {
+		printf("     + Unknown code ...: Failed\n");
+		return 0;
+	}
+
+	if (!PKI_ERR_get_descr(PKI_ERR_PARAM_RANGE)
+			|| strcmp(PKI_ERR_get_descr(PKI_ERR_MEMORY_ALLOC), "Memory Allocation Error") != 0
+			|| PKI_ERR_get_descr(PKI_ERR_NONE) != NULL) {
+		printf("     + Descriptions ...: Failed\n");
+		return 0;
+	}
+	printf("     + Descriptions ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+static void * _thread_errors(void * arg) {
+
+	intptr_t ret = 1;
+
+	// New threads start with an empty queue
+	if (PKI_ERR_count() != 0) ret = 0;
+
+	PKI_ERROR(PKI_ERR_SIGNATURE_VERIFY, NULL);
+
+	if (PKI_ERR_get(NULL) != PKI_ERR_SIGNATURE_VERIFY) ret = 0;
+
+	return (void *) ret;
+}
+
+int subtest3() {
+
+	PKI_THREAD *th = NULL;
+	void * ret = NULL;
+
+	printf("   - Subtest 3: Per-Thread Queues\n");
+
+	PKI_ERR_clear();
+	PKI_ERROR(PKI_ERR_GENERAL, NULL);
+
+	if ((th = PKI_THREAD_new(_thread_errors, NULL)) == NULL) {
+		printf("     + Thread creation ...: Failed\n");
+		return 0;
+	}
+
+	PKI_THREAD_join(th, &ret);
+	PKI_Free(th);
+
+	if (!ret) {
+		printf("     + Thread queue ...: Failed\n");
+		return 0;
+	}
+
+	// Our own queue is untouched
+	if (PKI_ERR_count() != 1 || PKI_ERR_get(NULL) != PKI_ERR_GENERAL) {
+		printf("     + Main thread queue ...: Failed\n");
+		return 0;
+	}
+	printf("     + Thread isolation ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
@@ -0,0 +1,288 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Fourteen (14) - Cached Encodings and Digests"
+
+// Threads writing the same certificate
+#define CACHE_THREADS	4
+#define CACHE_ROUNDS	200
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1(PKI_X509_CERT *cert);
+int subtest2(PKI_X509_CERT *cert);
+int subtest3(PKI_X509_CERT *cert, PKI_X509_KEYPAIR *key);
+
+static int _digest_equal(const PKI_DIGEST *a, const PKI_DIGEST *b);
+static void * _put_job(void *arg);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_KEYPAIR *key = NULL;
+	PKI_X509_CERT *cert = NULL;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// Self-signed certificate used by all subtests
+	key = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	if (key) cert = PKI_X509_CERT_new(NULL, key, NULL, "CN=Cache Test", NULL,
+		PKI_VALIDITY_ONE_HOUR, NULL, NULL, NULL, NULL);
+	if (!key || !cert) {
+		printf("* %s: Failed (cannot generate the certificate).\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1(cert)
+		&& subtest2(cert)
+		&& subtest3(cert, key)
+	);
+
+	PKI_X509_CERT_free(cert);
+	PKI_X509_KEYPAIR_free(key);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+static int _digest_equal(const PKI_DIGEST *a, const PKI_DIGEST *b) {
+
+	if (!a || !b || a->size != b->size) return 0;
+
+	return memcmp(a->digest, b->digest, a->size) == 0;
+}
+
+// Writes the certificate in DER and PEM, returns it if all the DER match
+static void * _put_job(void *arg) {
+
+	PKI_X509_CERT *cert = arg;
+	PKI_MEM *der = NULL, *mem = NULL;
+	void *ret = cert;
+	int i = 0;
+
+	if ((der = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_ASN1, NULL, NULL)) == NULL) return NULL;
+
+	for (i = 0; ret && i < CACHE_ROUNDS; i++) {
+		if ((mem = PKI_X509_put_mem(cert, i % 2 ? PKI_DATA_FORMAT_PEM
+				: PKI_DATA_FORMAT_ASN1, NULL, NULL)) == NULL
+				|| (i % 2 == 0 && (mem->size != der->size
+					|| memcmp(mem->data, der->data, der->size)))) ret = NULL;
+		if (mem) PKI_MEM_free(mem);
+	}
+
+	PKI_MEM_free(der);
+
+	return ret;
+}
+
+int subtest1(PKI_X509_CERT *cert) {
+
+	PKI_X509_CERT *dup = NULL;
+	PKI_DIGEST *d1 = NULL, *d2 = NULL, *d3 = NULL;
+	int ret = 0;
+
+	printf("   - Subtest 1: Memoized Fingerprints and Key Hashes\n");
+
+	// The duplicate does not share the cache
+	if ((dup = PKI_X509_CERT_dup(cert)) == NULL) {
+		printf("     + Duplicate ...: Failed\n");
+		return 0;
+	}
+
+	d1 = PKI_X509_CERT_fingerprint(cert, PKI_DIGEST_ALG_SHA256);
+	d2 = PKI_X509_CERT_fingerprint(cert, PKI_DIGEST_ALG_SHA256);
+	d3 = PKI_X509_CERT_fingerprint(dup, PKI_DIGEST_ALG_SHA256);
+
+	if (!_digest_equal(d1, d2) || !_digest_equal(d1, d3) || d1->digest == d2->digest) {
+		printf("     + Fingerprint ...: Failed\n");
+		goto end;
+	}
+	printf("     + Fingerprint ...: Ok\n");
+
+	PKI_DIGEST_free(d1); PKI_DIGEST_free(d2); PKI_DIGEST_free(d3);
+
+	d1 = PKI_X509_CERT_key_hash(cert, PKI_DIGEST_ALG_SHA1);
+	d2 = PKI_X509_CERT_key_hash(cert, PKI_DIGEST_ALG_SHA1);
+	d3 = PKI_X509_CERT_key_hash(dup, PKI_DIGEST_ALG_SHA1);
+
+	if (!_digest_equal(d1, d2) || !_digest_equal(d1, d3) || d1->size != 20) {
+		printf("     + Key Hash ...: Failed\n");
+		goto end;
+	}
+	printf("     + Key Hash ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+	ret = 1;
+
+end:
+	PKI_DIGEST_free(d1); PKI_DIGEST_free(d2); PKI_DIGEST_free(d3);
+	PKI_X509_CERT_free(dup);
+
+	return ret;
+}
+
+int subtest2(PKI_X509_CERT *cert) {
+
+	const PKI_MEM *der = NULL;
+	PKI_MEM *mem = NULL, *tbs1 = NULL, *tbs2 = NULL;
+	PKI_DIGEST *d = NULL;
+	PKI_THREAD *th[CACHE_THREADS];
+	void *res = NULL;
+	int i = 0, ok = 1, ret = 0;
+
+	printf("   - Subtest 2: Cached DER and TBS Encodings\n");
+
+	der = PKI_X509_get_der(cert);
+	if (!der || der != PKI_X509_get_der(cert)) {
+		printf("     + Cached DER ...: Failed\n");
+		return 0;
+	}
+
+	mem = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+	if (!mem || mem->size != der->size || memcmp(mem->data, der->data, der->size)) {
+		printf("     + Put Mem (DER) ...: Failed\n");
+		goto end;
+	}
+	PKI_MEM_free(mem);
+
+	// Other formats are a read as well (the cache is kept)
+	mem = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_PEM, NULL, NULL);
+	if (!mem || !mem->size || der != PKI_X509_get_der(cert)
+			|| (d = PKI_X509_CACHE_get_digest(cert, PKI_X509_CACHE_DIGEST_FINGERPRINT,
+				PKI_DIGEST_ALG_SHA256)) == NULL) {
+		printf("     + Put Mem (PEM) ...: Failed\n");
+		goto end;
+	}
+	PKI_MEM_free(mem);
+
+	// Concurrent writes in both formats
+	for (i = 0; i < CACHE_THREADS; i++) th[i] = PKI_THREAD_new(_put_job, cert);
+	for (i = 0; i < CACHE_THREADS; i++) {
+		if (!th[i]) {
+			ok = 0;
+			continue;
+		}
+		PKI_THREAD_join(th[i], &res);
+		PKI_Free(th[i]);
+		if (res != cert) ok = 0;
+	}
+
+	mem = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+	if (!ok || !mem || der != PKI_X509_get_der(cert)
+			|| mem->size != der->size || memcmp(mem->data, der->data, der->size)) {
+		printf("     + Concurrent Put Mem ...: Failed\n");
+		goto end;
+	}
+	printf("     + Put Mem ...: Ok\n");
+
+	tbs1 = PKI_X509_get_tbs_asn1(cert);
+	tbs2 = PKI_X509_get_tbs_asn1(cert);
+	if (!tbs1 || !tbs2 || tbs1->size != tbs2->size 
+			|| memcmp(tbs1->data, tbs2->data, tbs1->size)
+			|| tbs1->size >= der->size) {
+		printf("     + TBS ...: Failed\n");
+		goto end;
+	}
+	printf("     + TBS ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+	ret = 1;
+
+end:
+	if (d) PKI_DIGEST_free(d);
+	if (mem) PKI_MEM_free(mem);
+	if (tbs1) PKI_MEM_free(tbs1);
+	if (tbs2) PKI_MEM_free(tbs2);
+
+	return ret;
+}
+
+int subtest3(PKI_X509_CERT *cert, PKI_X509_KEYPAIR *key) {
+
+	PKI_DIGEST *d1 = NULL, *d2 = NULL;
+	PKI_MEM *mem = NULL;
+	const PKI_MEM *der = NULL;
+	int ret = 0;
+
+	printf("   - Subtest 3: Invalidation\n");
+
+	d1 = PKI_X509_CERT_fingerprint(cert, PKI_DIGEST_ALG_SHA256);
+
+	// Re-signing changes the encoding
+	if (PKI_X509_sign(cert, PKI_DIGEST_ALG_SHA384, key) != PKI_OK) {
+		printf("     + Re-sign ...: Failed\n");
+		goto end;
+	}
+
+	d2 = PKI_X509_CERT_fingerprint(cert, PKI_DIGEST_ALG_SHA256);
+	if (!d1 || !d2 || _digest_equal(d1, d2)) {
+		printf("     + Fingerprint after signing ...: Failed\n");
+		goto end;
+	}
+
+	der = PKI_X509_get_der(cert);
+	mem = PKI_X509_put_mem_value(PKI_X509_get_value(cert), PKI_DATATYPE_X509_CERT,
+		NULL, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+	if (!der || !mem || mem->size != der->size || memcmp(mem->data, der->data, der->size)) {
+		printf("     + DER after signing ...: Failed\n");
+		goto end;
+	}
+	printf("     + Signing ...: Ok\n");
+
+	PKI_DIGEST_free(d1);
+	d1 = d2;
+
+	// Explicit invalidation
+	if (PKI_X509_set_modified(cert) != PKI_OK) {
+		printf("     + Set Modified ...: Failed\n");
+		goto end;
+	}
+
+	d2 = PKI_X509_CERT_fingerprint(cert, PKI_DIGEST_ALG_SHA256);
+	if (!_digest_equal(d1, d2)) {
+		printf("     + Fingerprint after set_modified ...: Failed\n");
+		goto end;
+	}
+	printf("     + Set Modified ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+	ret = 1;
+
+end:
+	if (d1) PKI_DIGEST_free(d1);
+	if (d2 && d2 != d1) PKI_DIGEST_free(d2);
+	if (mem) PKI_MEM_free(mem);
+
+	return ret;
+}
@@ -0,0 +1,153 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Fifteen (15) - Algorithm and Scheme Names"
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+	);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+#if defined(ENABLE_OQS) || defined(ENABLE_OQSPROV)
+	int classic = 0, quantum = 0;
+#endif
+
+	printf("   - Subtest 1: Scheme Names\n");
+
+	if (PKI_SCHEME_ID_get_by_name("rsa", NULL, NULL) != PKI_SCHEME_RSA
+			|| PKI_SCHEME_ID_get_by_name("RSA-PSS", NULL, NULL) != PKI_SCHEME_RSAPSS
+			|| PKI_SCHEME_ID_get_by_name("DSA", NULL, NULL) != PKI_SCHEME_DSA) {
+		printf("     + Traditional ...: Failed\n");
+		return 0;
+	}
+
+#ifdef ENABLE_ECDSA
+	if (PKI_SCHEME_ID_get_by_name("p384", NULL, NULL) != PKI_SCHEME_ECDSA
+			|| PKI_SCHEME_ID_get_by_name("brainpoolP256r1", NULL, NULL) != PKI_SCHEME_ECDSA
+			|| PKI_SCHEME_ID_get_by_name("Ed25519", NULL, NULL) != PKI_SCHEME_ED25519) {
+		printf("     + Elliptic Curves ...: Failed\n");
+		return 0;
+	}
+#endif
+
+#if defined(ENABLE_OQS) || defined(ENABLE_OQSPROV)
+	if (PKI_SCHEME_ID_get_by_name("dilithium3", &classic, &quantum) != PKI_SCHEME_DILITHIUM
+			|| classic != 192 || quantum != 192) {
+		printf("     + Post-Quantum ...: Failed\n");
+		return 0;
+	}
+#endif
+
+	if (PKI_SCHEME_ID_get_by_name("RSA2", NULL, NULL) != PKI_SCHEME_UNKNOWN
+			|| PKI_SCHEME_ID_get_by_name("", NULL, NULL) != PKI_SCHEME_UNKNOWN) {
+		printf("     + Unknown Names ...: Failed\n");
+		return 0;
+	}
+	printf("     + Lookup ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_X509_ALGOR_VALUE *a1 = NULL, *a2 = NULL, *a3 = NULL;
+
+	printf("   - Subtest 2: Shared Algorithm Identifiers\n");
+
+	a1 = PKI_X509_ALGOR_VALUE_get(PKI_ALGOR_ID_RSA_SHA256);
+	a2 = PKI_X509_ALGOR_VALUE_get_by_name("rsa-sha256");
+	if (!a1 || a1 != a2 || PKI_X509_ALGOR_VALUE_get_id(a1) != PKI_ALGOR_ID_RSA_SHA256) {
+		printf("     + Interned ...: Failed\n");
+		return 0;
+	}
+
+	// Repeated and trailing separators
+	if (PKI_X509_ALGOR_VALUE_get_by_name("--RSA--SHA256") != a1
+			|| PKI_X509_ALGOR_VALUE_get_by_name("SHA256-") != PKI_X509_ALGOR_VALUE_get(NID_sha256)
+			|| PKI_X509_ALGOR_VALUE_get_by_name("---") != NULL) {
+		printf("     + Separators ...: Failed\n");
+		return 0;
+	}
+
+#ifdef ENABLE_ECDSA
+	a3 = PKI_X509_ALGOR_VALUE_get_by_name("ECDSA-SHA384");
+	if (!a3 || PKI_X509_ALGOR_VALUE_get_id(a3) != PKI_ALGOR_ID_ECDSA_SHA384) {
+		printf("     + ECDSA Names ...: Failed\n");
+		return 0;
+	}
+#endif
+
+	// Shared values survive a free
+	PKI_X509_ALGOR_VALUE_free(a1);
+	if (!PKI_X509_ALGOR_VALUE_is_interned(a2)
+			|| PKI_X509_ALGOR_VALUE_get(PKI_ALGOR_ID_RSA_SHA256) != a2) {
+		printf("     + Free ...: Failed\n");
+		return 0;
+	}
+
+	// Allocated values are not shared
+	a3 = PKI_X509_ALGOR_VALUE_new_type(PKI_ALGOR_ID_RSA_SHA256);
+	if (!a3 || PKI_X509_ALGOR_VALUE_is_interned(a3)) {
+		printf("     + Allocated ...: Failed\n");
+		return 0;
+	}
+	PKI_X509_ALGOR_VALUE_free(a3);
+	printf("     + Interned ...: Ok\n");
+
+	if (PKI_X509_ALGOR_VALUE_get_by_name("NOT-AN-ALGORITHM") != NULL) {
+		printf("     + Unknown Names ...: Failed\n");
+		return 0;
+	}
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
@@ -0,0 +1,254 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Sixteen (16) - Config Registry"
+#define test_dir  "results/config-registry"
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static int _write_config(const char *file, const char *name);
+static int _find_is(const char *name, const char *file);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// Test directory with two configurations
+	mkdir("results", 0755);
+	mkdir(test_dir, 0755);
+	unlink(test_dir "/c.xml");
+
+	if (!_write_config("a.xml", "alpha") || !_write_config("b.xml", "beta")) {
+		printf("* %s: Can not write the test configurations.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	unlink(test_dir "/a.xml");
+	unlink(test_dir "/b.xml");
+	unlink(test_dir "/c.xml");
+	rmdir(test_dir);
+
+	PKI_CONFIG_cache_flush();
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_STACK *names = NULL;
+	int num = 0;
+
+	printf("   - Subtest 1: Lookup by Name\n");
+
+	if (!_find_is("alpha", "a.xml") || !_find_is("BETA", "b.xml")) {
+		printf("     + Find ...: Failed\n");
+		return 0;
+	}
+
+	// Repeated lookups are served from the index
+	if (!_find_is("Alpha", "a.xml") || !_find_is("gamma", NULL)) {
+		printf("     + Find (indexed) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Find ...: Ok\n");
+
+	if ((names = PKI_CONFIG_get_names(test_dir)) == NULL) {
+		printf("     + Names ...: Failed\n");
+		return 0;
+	}
+	num = PKI_STACK_elements(names);
+	PKI_STACK_free_all(names);
+
+	if (num != 2 || PKI_CONFIG_get_names(test_dir "/missing") != NULL) {
+		printf("     + Names (%d) ...: Failed\n", num);
+		return 0;
+	}
+	printf("     + Names ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_CONFIG *doc1 = NULL, *doc2 = NULL;
+	PKI_CONFIG_STACK *sk = NULL;
+	char *val1 = NULL, *val2 = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 2: Cached Documents\n");
+
+	doc1 = PKI_CONFIG_load(test_dir "/a.xml");
+	doc2 = PKI_CONFIG_load(test_dir "/a.xml");
+
+	if (doc1 && doc2) {
+		val1 = PKI_CONFIG_get_value(doc1, "/*/name");
+		val2 = PKI_CONFIG_get_value(doc2, "/*/name");
+	}
+
+	// Each load returns an independent document
+	ok = (doc1 != doc2 && val1 && val2 && strcmp(val1, "alpha") == 0
+		&& strcmp(val1, val2) == 0);
+
+	if (val1) PKI_Free(val1);
+	if (val2) PKI_Free(val2);
+	PKI_CONFIG_free(doc1);
+
+	// The cached copy is not affected by freeing a loaded one
+	if (ok && (val2 = PKI_CONFIG_get_value(doc2, "/*/name")) != NULL) {
+		PKI_Free(val2);
+	} else ok = 0;
+	PKI_CONFIG_free(doc2);
+
+	if (!ok) {
+		printf("     + Load (cached) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Load (cached) ...: Ok\n");
+
+	if ((sk = PKI_CONFIG_load_dir(test_dir, NULL)) == NULL
+			|| PKI_STACK_CONFIG_elements(sk) != 2) {
+		printf("     + Load dir ...: Failed\n");
+		return 0;
+	}
+	PKI_STACK_free_all((PKI_STACK *) sk);
+	printf("     + Load dir ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_CONFIG *doc = NULL;
+	char *val = NULL;
+
+	printf("   - Subtest 3: Invalidation\n");
+
+	// File modified in place
+	if (!_write_config("b.xml", "gamma")) return 0;
+
+	if (!_find_is("gamma", "b.xml") || !_find_is("beta", NULL)) {
+		printf("     + Modified file ...: Failed\n");
+		return 0;
+	}
+
+	if ((doc = PKI_CONFIG_load(test_dir "/b.xml")) == NULL
+			|| (val = PKI_CONFIG_get_value(doc, "/*/name")) == NULL
+			|| strcmp(val, "gamma") != 0) {
+		printf("     + Modified file (load) ...: Failed\n");
+		return 0;
+	}
+	PKI_Free(val);
+	PKI_CONFIG_free(doc);
+	printf("     + Modified file ...: Ok\n");
+
+	// Same size rewrite (usually within the same second)
+	if (!_write_config("b.xml", "omega")) return 0;
+
+	if ((doc = PKI_CONFIG_load(test_dir "/b.xml")) == NULL
+			|| (val = PKI_CONFIG_get_value(doc, "/*/name")) == NULL
+			|| strcmp(val, "omega") != 0 || !_find_is("omega", "b.xml")) {
+		printf("     + Same size rewrite ...: Failed\n");
+		return 0;
+	}
+	PKI_Free(val);
+	PKI_CONFIG_free(doc);
+	printf("     + Same size rewrite ...: Ok\n");
+
+	// New and removed files
+	if (!_write_config("c.xml", "delta")) return 0;
+	unlink(test_dir "/a.xml");
+
+	if (!_find_is("delta", "c.xml") || !_find_is("alpha", NULL)) {
+		printf("     + Added and removed files ...: Failed\n");
+		return 0;
+	}
+	printf("     + Added and removed files ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+static int _write_config(const char *file, const char *name) {
+
+	char path[BUFF_MAX_SIZE];
+	FILE *fp = NULL;
+
+	snprintf(path, sizeof(path), "%s/%s", test_dir, file);
+
+	if ((fp = fopen(path, "w")) == NULL) return 0;
+
+	fprintf(fp, "<?xml version=\"1.0\" ?>\n"
+		"<pki:tokenConfig xmlns:pki=\"http://www.openca.org/openca/pki/1/0/0\">\n"
+		"  <pki:name>%s</pki:name>\n"
+		"  <pki:type>software</pki:type>\n"
+		"</pki:tokenConfig>\n", name);
+	fclose(fp);
+
+	return 1;
+}
+
+static int _find_is(const char *name, const char *file) {
+
+	char path[BUFF_MAX_SIZE];
+	char *found = NULL;
+	int ret = 0;
+
+	found = PKI_CONFIG_find(test_dir, name);
+
+	if (!file) ret = (found == NULL);
+	else {
+		snprintf(path, sizeof(path), "%s/%s", test_dir, file);
+		ret = (found != NULL && strcmp(found, path) == 0);
+	}
+
+	if (found) PKI_Free(found);
+
+	return ret;
+}
@@ -0,0 +1,340 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Seventeen (17) - Token Handle Reload"
+#define test_dir  "results/token-handle"
+
+#define TEST_THREADS		4
+#define TEST_SIGNATURES		100
+#define TEST_RELOADS		20
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+int subtest4();
+
+static int _write_token(const char *cn);
+static int _snapshot_cn_is(PKI_TOKEN_SNAPSHOT *s, const char *cn);
+
+static PKI_TOKEN_HANDLE *handle = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// Token configuration, keypair, and certificate
+	mkdir("results", 0755);
+	mkdir(test_dir, 0755);
+	mkdir(test_dir "/token.d", 0755);
+	mkdir(test_dir "/profile.d", 0755);
+
+	if (!_write_token("Handle 1")) {
+		printf("* %s: Can not write the test token.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+		&& subtest4()
+	);
+
+	unlink(test_dir "/token.d/handle.xml");
+	unlink(test_dir "/key.pem");
+	unlink(test_dir "/cert.pem");
+	rmdir(test_dir "/token.d");
+	rmdir(test_dir "/profile.d");
+	rmdir(test_dir);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_TOKEN_SNAPSHOT *s = NULL;
+
+	printf("   - Subtest 1: Handle and Snapshots\n");
+
+	if ((handle = PKI_TOKEN_HANDLE_new(test_dir, "handle", NULL, NULL)) == NULL) {
+		printf("     + Handle creation ...: Failed\n");
+		return 0;
+	}
+
+	s = PKI_TOKEN_HANDLE_acquire(handle);
+	if (!s || !PKI_TOKEN_SNAPSHOT_get_token(s)->keypair
+			|| !_snapshot_cn_is(s, "Handle 1")
+			|| PKI_TOKEN_SNAPSHOT_get_generation(s) != 1) {
+		printf("     + Snapshot ...: Failed\n");
+		return 0;
+	}
+	PKI_TOKEN_SNAPSHOT_release(s);
+	printf("     + Snapshot ...: Ok\n");
+
+	// Nothing changed, nothing to reload
+	if (PKI_TOKEN_HANDLE_refresh(handle) != PKI_OK
+			|| PKI_TOKEN_HANDLE_get_generation(handle) != 1) {
+		printf("     + Refresh (unchanged) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Refresh (unchanged) ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_TOKEN_SNAPSHOT *old = NULL, *s = NULL;
+	PKI_X509_REQ *req = NULL;
+	PKI_TOKEN *tk = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 2: Reload on Change\n");
+
+	old = PKI_TOKEN_HANDLE_acquire(handle);
+
+	// Rotates the certificate
+	if (!_write_token("Handle 2")) return 0;
+
+	if (PKI_TOKEN_HANDLE_refresh(handle) != PKI_OK
+			|| PKI_TOKEN_HANDLE_get_generation(handle) != 2) {
+		printf("     + Refresh (changed) ...: Failed\n");
+		return 0;
+	}
+
+	s = PKI_TOKEN_HANDLE_acquire(handle);
+	if (!_snapshot_cn_is(s, "Handle 2")) {
+		printf("     + New snapshot ...: Failed\n");
+		return 0;
+	}
+	PKI_TOKEN_SNAPSHOT_release(s);
+	printf("     + New snapshot ...: Ok\n");
+
+	// The old snapshot is still usable
+	tk = PKI_TOKEN_SNAPSHOT_get_token(old);
+	req = PKI_X509_REQ_new(tk->keypair, "CN=Old Snapshot", NULL, NULL,
+		PKI_DIGEST_ALG_SHA256, NULL);
+	ok = (req && _snapshot_cn_is(old, "Handle 1")
+		&& PKI_X509_sign(req, NULL, tk->keypair) == PKI_OK);
+
+	if (req) PKI_X509_REQ_free(req);
+	PKI_TOKEN_SNAPSHOT_release(old);
+
+	if (!ok) {
+		printf("     + Old snapshot ...: Failed\n");
+		return 0;
+	}
+	printf("     + Old snapshot ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+static void * _thread_sign(void * arg) {
+
+	PKI_TOKEN_SNAPSHOT *s = NULL;
+	PKI_X509_REQ *req = NULL;
+	PKI_TOKEN *tk = NULL;
+	intptr_t ret = 1;
+	int i = 0;
+
+	for (i = 0; i < TEST_SIGNATURES && ret; i++) {
+
+		if ((s = PKI_TOKEN_HANDLE_acquire(handle)) == NULL) return NULL;
+		tk = PKI_TOKEN_SNAPSHOT_get_token(s);
+
+		if (!req) req = PKI_X509_REQ_new(tk->keypair, "CN=Signer", NULL,
+			NULL, PKI_DIGEST_ALG_SHA256, NULL);
+
+		if (!req || PKI_X509_sign(req, NULL, tk->keypair) != PKI_OK) ret = 0;
+
+		PKI_TOKEN_SNAPSHOT_release(s);
+	}
+
+	if (req) PKI_X509_REQ_free(req);
+
+	return (void *) ret;
+}
+
+int subtest3() {
+
+	PKI_THREAD *th[TEST_THREADS];
+	unsigned long gen = 0;
+	void *ret = NULL;
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 3: Reloads During Signing\n");
+
+	gen = PKI_TOKEN_HANDLE_get_generation(handle);
+
+	for (i = 0; i < TEST_THREADS; i++) {
+		if ((th[i] = PKI_THREAD_new(_thread_sign, NULL)) == NULL) {
+			printf("     + Thread creation ...: Failed\n");
+			return 0;
+		}
+	}
+
+	for (i = 0; i < TEST_RELOADS; i++) {
+		if (PKI_TOKEN_HANDLE_reload(handle) != PKI_OK) ok = 0;
+	}
+
+	for (i = 0; i < TEST_THREADS; i++) {
+		PKI_THREAD_join(th[i], &ret);
+		PKI_Free(th[i]);
+		if (!ret) ok = 0;
+	}
+
+	if (!ok || PKI_TOKEN_HANDLE_get_generation(handle) != gen + TEST_RELOADS) {
+		printf("     + Concurrent signing and reloads ...: Failed\n");
+		return 0;
+	}
+	printf("     + Concurrent signing and reloads ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+int subtest4() {
+
+	PKI_TOKEN_SNAPSHOT *s = NULL;
+	unsigned long gen = 0;
+	int i = 0;
+
+	printf("   - Subtest 4: Background Reload\n");
+
+	gen = PKI_TOKEN_HANDLE_get_generation(handle);
+
+	if (PKI_TOKEN_HANDLE_watch_start(handle, 20) != PKI_OK) {
+		printf("     + Watcher start ...: Failed\n");
+		return 0;
+	}
+
+	if (!_write_token("Handle 3")) return 0;
+
+	// Waits (up to 5 secs) for the watcher to pick up the change
+	for (i = 0; i < 500 && PKI_TOKEN_HANDLE_get_generation(handle) == gen; i++) {
+		usleep(10000);
+	}
+
+	PKI_TOKEN_HANDLE_watch_stop(handle);
+
+	s = PKI_TOKEN_HANDLE_acquire(handle);
+	if (PKI_TOKEN_HANDLE_get_generation(handle) == gen || !_snapshot_cn_is(s, "Handle 3")) {
+		printf("     + Watcher reload ...: Failed\n");
+		return 0;
+	}
+	printf("     + Watcher reload ...: Ok\n");
+
+	// Snapshots outlive the handle
+	PKI_TOKEN_HANDLE_free(handle);
+	handle = NULL;
+
+	if (!_snapshot_cn_is(s, "Handle 3")) {
+		printf("     + Snapshot after free ...: Failed\n");
+		return 0;
+	}
+	PKI_TOKEN_SNAPSHOT_release(s);
+	printf("     + Snapshot after free ...: Ok\n");
+
+	printf("   - Subtest 4: Passed\n\n");
+
+	return 1;
+}
+
+static int _write_token(const char *cn) {
+
+	char subject[128];
+	PKI_X509_KEYPAIR *key = NULL;
+	PKI_X509_CERT *cert = NULL;
+	FILE *fp = NULL;
+	int ok = 0;
+
+	snprintf(subject, sizeof(subject), "CN=%s, O=OpenCA", cn);
+
+	if ((key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 256, NULL, NULL, NULL)) != NULL)
+		cert = PKI_X509_CERT_new(NULL, key, NULL, subject, "1", 3600,
+			NULL, NULL, NULL, NULL);
+
+	// Files are replaced atomically (as in a real rotation)
+	ok = (cert
+		&& PKI_X509_KEYPAIR_put(key, PKI_DATA_FORMAT_PEM, test_dir "/key.tmp", NULL, NULL) == PKI_OK
+		&& PKI_X509_CERT_put(cert, PKI_DATA_FORMAT_PEM, test_dir "/cert.tmp", NULL, NULL, NULL) == PKI_OK
+		&& rename(test_dir "/key.tmp", test_dir "/key.pem") == 0
+		&& rename(test_dir "/cert.tmp", test_dir "/cert.pem") == 0);
+
+	if (cert) PKI_X509_CERT_free(cert);
+	if (key) PKI_X509_KEYPAIR_free(key);
+
+	if (!ok) return 0;
+
+	// The token configuration is only written once
+	if (access(test_dir "/token.d/handle.xml", F_OK) == 0) return 1;
+
+	if ((fp = fopen(test_dir "/token.d/handle.xml", "w")) == NULL) return 0;
+
+	fprintf(fp, "<?xml version=\"1.0\" ?>\n"
+		"<pki:tokenConfig xmlns:pki=\"http://www.openca.org/openca/pki/1/0/0\">\n"
+		"  <pki:name>handle</pki:name>\n"
+		"  <pki:type>software</pki:type>\n"
+		"  <pki:keypair>" test_dir "/key.pem</pki:keypair>\n"
+		"  <pki:cert>" test_dir "/cert.pem</pki:cert>\n"
+		"  <pki:passin>none</pki:passin>\n"
+		"</pki:tokenConfig>\n");
+	fclose(fp);
+
+	return 1;
+}
+
+static int _snapshot_cn_is(PKI_TOKEN_SNAPSHOT *s, const char *cn) {
+
+	PKI_TOKEN *tk = NULL;
+	char *subject = NULL;
+	int ret = 0;
+
+	if ((tk = PKI_TOKEN_SNAPSHOT_get_token(s)) == NULL || !tk->cert) return 0;
+
+	if ((subject = PKI_X509_CERT_get_parsed(tk->cert, PKI_X509_DATA_SUBJECT)) != NULL) {
+		ret = (strstr(subject, cn) != NULL);
+		PKI_Free(subject);
+	}
+
+	return ret;
+}
@@ -0,0 +1,216 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Eighteen (18) - Keypair Pool"
+
+#define POOL_LOW	2
+#define POOL_HIGH	6
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static int _wait_size(PKI_KEYPAIR_POOL *pool, PKI_SCHEME_ID scheme, int bits, int size);
+static int _key_works(PKI_X509_KEYPAIR *key);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_KEYPAIR_POOL *pool = NULL;
+	PKI_X509_KEYPAIR *keys[POOL_HIGH];
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 1: Background Fill and Watermarks\n");
+
+	if ((pool = PKI_KEYPAIR_POOL_new(2)) == NULL) {
+		printf("     + Pool creation ...: Failed\n");
+		return 0;
+	}
+
+	if (PKI_KEYPAIR_POOL_add_scheme(pool, PKI_SCHEME_ECDSA, 128, POOL_LOW, POOL_HIGH) != PKI_OK
+			|| PKI_KEYPAIR_POOL_add_scheme(pool, PKI_SCHEME_ECDSA, 192, 3, 3) == PKI_OK) {
+		printf("     + Queue configuration ...: Failed\n");
+		return 0;
+	}
+
+	if (!_wait_size(pool, PKI_SCHEME_ECDSA, 128, POOL_HIGH)) {
+		printf("     + Background fill ...: Failed\n");
+		return 0;
+	}
+	printf("     + Background fill ...: Ok\n");
+
+	// Takes the keypairs down to the low watermark
+	for (i = 0; i < POOL_HIGH - POOL_LOW; i++) {
+		keys[i] = PKI_KEYPAIR_POOL_get(pool, PKI_SCHEME_ECDSA, 128);
+		if (!keys[i] || (i > 0 && keys[i] == keys[i-1])) ok = 0;
+	}
+
+	if (!ok || !_key_works(keys[0])) {
+		printf("     + Get ...: Failed\n");
+		return 0;
+	}
+	for (i = 0; i < POOL_HIGH - POOL_LOW; i++) PKI_X509_KEYPAIR_free(keys[i]);
+	printf("     + Get ...: Ok\n");
+
+	// Reaching the low watermark refills the queue
+	if (!_wait_size(pool, PKI_SCHEME_ECDSA, 128, POOL_HIGH)) {
+		printf("     + Refill ...: Failed\n");
+		return 0;
+	}
+	printf("     + Refill ...: Ok\n");
+
+	PKI_KEYPAIR_POOL_free(pool);
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_KEYPAIR_POOL *pool = NULL;
+	PKI_X509_KEYPAIR *key = NULL;
+	PKI_ARENA *arena = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 2: Misses and Warm Up\n");
+
+	// The pool outlives the request it was created in
+	if ((arena = PKI_ARENA_new(0)) == NULL || PKI_ARENA_bind(arena) != PKI_OK) return 0;
+	pool = PKI_KEYPAIR_POOL_new(1);
+	ok = (pool && PKI_ARENA_find(pool) == NULL);
+	PKI_ARENA_unbind(arena);
+	PKI_ARENA_free(arena);
+
+	if (!ok) {
+		printf("     + Created in a request ...: Failed\n");
+		return 0;
+	}
+	printf("     + Created in a request ...: Ok\n");
+
+	// Not configured: generated in the calling thread
+	key = PKI_KEYPAIR_POOL_get(pool, PKI_SCHEME_ECDSA, 192);
+	if (!key || !_key_works(key) || PKI_KEYPAIR_POOL_size(pool, PKI_SCHEME_ECDSA, 192) != 0) {
+		printf("     + Miss ...: Failed\n");
+		return 0;
+	}
+	PKI_X509_KEYPAIR_free(key);
+	printf("     + Miss ...: Ok\n");
+
+	if (PKI_KEYPAIR_POOL_add_scheme(pool, PKI_SCHEME_ECDSA, 192, 1, 4) != PKI_OK
+			|| PKI_KEYPAIR_POOL_fill(pool) != PKI_OK
+			|| PKI_KEYPAIR_POOL_size(pool, PKI_SCHEME_ECDSA, 192) != 4) {
+		printf("     + Warm up ...: Failed\n");
+		return 0;
+	}
+	printf("     + Warm up ...: Ok\n");
+
+	// Shrinking the queue discards the extra keypairs
+	if (PKI_KEYPAIR_POOL_add_scheme(pool, PKI_SCHEME_ECDSA, 192, 0, 2) != PKI_OK
+			|| PKI_KEYPAIR_POOL_size(pool, PKI_SCHEME_ECDSA, 192) != 2) {
+		printf("     + Shrink ...: Failed\n");
+		return 0;
+	}
+	printf("     + Shrink ...: Ok\n");
+
+	PKI_KEYPAIR_POOL_free(pool);
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_KEYPAIR_POOL *pool = NULL;
+
+	printf("   - Subtest 3: Free During Generation\n");
+
+	if ((pool = PKI_KEYPAIR_POOL_new(2)) == NULL) return 0;
+
+	// Workers are busy generating RSA keys when the pool is freed
+	if (PKI_KEYPAIR_POOL_add_scheme(pool, PKI_SCHEME_RSA, 2048, 1, 8) != PKI_OK) {
+		printf("     + Queue configuration ...: Failed\n");
+		return 0;
+	}
+
+	PKI_KEYPAIR_POOL_free(pool);
+	printf("     + Free ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+static int _wait_size(PKI_KEYPAIR_POOL *pool, PKI_SCHEME_ID scheme, int bits, int size) {
+
+	int i = 0;
+
+	// Waits up to 20 secs
+	for (i = 0; i < 2000; i++) {
+		if (PKI_KEYPAIR_POOL_size(pool, scheme, bits) == size) return 1;
+		usleep(10000);
+	}
+
+	return 0;
+}
+
+static int _key_works(PKI_X509_KEYPAIR *key) {
+
+	PKI_X509_REQ *req = NULL;
+	int ret = 0;
+
+	if ((req = PKI_X509_REQ_new(key, "CN=Pooled Key", NULL, NULL,
+			PKI_DIGEST_ALG_SHA256, NULL)) != NULL) {
+		ret = (PKI_X509_sign(req, NULL, key) == PKI_OK);
+		PKI_X509_REQ_free(req);
+	}
+
+	return ret;
+}
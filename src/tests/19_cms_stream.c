@@ -0,0 +1,332 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Nineteen (19) - CMS Streaming"
+#define test_dir  "results/cms-stream"
+
+#define TEST_DATA_SIZE		(4 * 1024 * 1024 + 123)
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static int _write_data(const char *file, size_t size);
+static int _files_equal(const char *a, const char *b);
+
+static PKI_X509_KEYPAIR *signer_key = NULL;
+static PKI_X509_CERT *signer_cert = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	mkdir("results", 0755);
+	mkdir(test_dir, 0755);
+
+	if (!_write_data(test_dir "/data.bin", TEST_DATA_SIZE)) {
+		printf("* %s: Can not write the test data.\n\n", test_name);
+		return 1;
+	}
+
+	// Signer (and recipient) credentials
+	if ((signer_key = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (signer_cert = PKI_X509_CERT_new(NULL, signer_key, NULL,
+				"CN=CMS Streaming, O=OpenCA", "1", 3600, NULL, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test credentials.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	PKI_X509_CERT_free(signer_cert);
+	PKI_X509_KEYPAIR_free(signer_key);
+
+	unlink(test_dir "/data.bin");
+	unlink(test_dir "/data.out");
+	unlink(test_dir "/signed.der");
+	unlink(test_dir "/detached.pem");
+	unlink(test_dir "/enveloped.der");
+	rmdir(test_dir);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_X509_CMS *cms = NULL;
+	PKI_X509_CERT_STACK *trusted = NULL;
+	PKI_IO *io = NULL;
+	int in_fd = -1, out_fd = -1;
+	int ok = 0;
+
+	printf("   - Subtest 1: Attached SignedData\n");
+
+	if ((cms = PKI_X509_CMS_new(PKI_X509_CMS_TYPE_SIGNED, 0)) == NULL
+			|| PKI_X509_CMS_add_signer(cms, signer_cert, signer_key, NULL, 0) != PKI_OK) {
+		printf("     + CMS creation ...: Failed\n");
+		return 0;
+	}
+
+	in_fd = open(test_dir "/data.bin", O_RDONLY);
+	out_fd = open(test_dir "/signed.der", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	ok = (PKI_X509_CMS_data_set_fd(cms, in_fd, out_fd, PKI_DATA_FORMAT_ASN1) == PKI_OK);
+
+	close(in_fd);
+	close(out_fd);
+	PKI_X509_CMS_free(cms);
+
+	if (!ok) {
+		printf("     + Streaming sign ...: Failed\n");
+		return 0;
+	}
+	printf("     + Streaming sign ...: Ok\n");
+
+	// Reads back the CMS and extracts the content
+	if ((io = BIO_new_file(test_dir "/signed.der", "rb")) == NULL
+			|| (cms = PKI_X509_CMS_get_io(io, PKI_DATA_FORMAT_ASN1)) == NULL) {
+		printf("     + Read CMS ...: Failed\n");
+		return 0;
+	}
+	PKI_IO_free(io);
+
+	trusted = PKI_STACK_X509_CERT_new();
+	PKI_STACK_X509_CERT_push(trusted, signer_cert);
+
+	out_fd = open(test_dir "/data.out", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ok = (PKI_X509_CMS_verify_fd(cms, trusted, -1, out_fd) == PKI_OK);
+	close(out_fd);
+
+	PKI_STACK_X509_CERT_free(trusted);
+	PKI_X509_CMS_free(cms);
+
+	if (!ok || !_files_equal(test_dir "/data.bin", test_dir "/data.out")) {
+		printf("     + Verify ...: Failed\n");
+		return 0;
+	}
+	printf("     + Verify ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_X509_CMS *cms = NULL;
+	PKI_IO *io = NULL, *content = NULL;
+	int in_fd = -1, out_fd = -1;
+	int ok = 0;
+
+	printf("   - Subtest 2: Detached SignedData\n");
+
+	if ((cms = PKI_X509_CMS_new(PKI_X509_CMS_TYPE_SIGNED,
+			PKI_X509_CMS_FLAGS_INIT_DEFAULT | PKI_X509_CMS_FLAGS_DETACHED)) == NULL
+			|| PKI_X509_CMS_add_signer(cms, signer_cert, signer_key, NULL, 0) != PKI_OK) {
+		printf("     + CMS creation ...: Failed\n");
+		return 0;
+	}
+
+	in_fd = open(test_dir "/data.bin", O_RDONLY);
+	out_fd = open(test_dir "/detached.pem", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	ok = (PKI_X509_CMS_data_set_fd(cms, in_fd, out_fd, PKI_DATA_FORMAT_PEM) == PKI_OK);
+
+	close(in_fd);
+	close(out_fd);
+	PKI_X509_CMS_free(cms);
+
+	if (!ok) {
+		printf("     + Streaming sign ...: Failed\n");
+		return 0;
+	}
+	printf("     + Streaming sign ...: Ok\n");
+
+	if ((io = BIO_new_file(test_dir "/detached.pem", "r")) == NULL
+			|| (cms = PKI_X509_CMS_get_io(io, PKI_DATA_FORMAT_PEM)) == NULL) {
+		printf("     + Read CMS ...: Failed\n");
+		return 0;
+	}
+	PKI_IO_free(io);
+
+	// The content is read from the original file
+	in_fd = open(test_dir "/data.bin", O_RDONLY);
+	ok = (PKI_X509_CMS_verify_fd(cms, NULL, in_fd, -1) == PKI_OK);
+	close(in_fd);
+
+	if (!ok) {
+		printf("     + Verify ...: Failed\n");
+		return 0;
+	}
+	printf("     + Verify ...: Ok\n");
+
+	// Modified content
+	content = BIO_new_mem_buf("Not the signed content", -1);
+	ok = (PKI_X509_CMS_verify_io(cms, NULL, content, NULL) != PKI_OK);
+	PKI_IO_free(content);
+	PKI_X509_CMS_free(cms);
+
+	if (!ok) {
+		printf("     + Verify (modified content) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Verify (modified content) ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_X509_CMS *cms = NULL;
+	PKI_MEM *mem = NULL;
+	PKI_IO *io = NULL;
+	int in_fd = -1, out_fd = -1;
+	int ok = 0;
+
+	printf("   - Subtest 3: EnvelopedData\n");
+
+	if ((cms = PKI_X509_CMS_new(PKI_X509_CMS_TYPE_ENVELOPED, 0)) == NULL
+			|| PKI_X509_CMS_add_recipient(cms, signer_cert, NULL, 0) != PKI_OK) {
+		printf("     + CMS creation ...: Failed\n");
+		return 0;
+	}
+
+	in_fd = open(test_dir "/data.bin", O_RDONLY);
+	out_fd = open(test_dir "/enveloped.der", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	ok = (PKI_X509_CMS_data_set_fd(cms, in_fd, out_fd, PKI_DATA_FORMAT_ASN1) == PKI_OK);
+
+	close(in_fd);
+	close(out_fd);
+	PKI_X509_CMS_free(cms);
+
+	if (!ok) {
+		printf("     + Streaming encrypt ...: Failed\n");
+		return 0;
+	}
+	printf("     + Streaming encrypt ...: Ok\n");
+
+	if ((io = BIO_new_file(test_dir "/enveloped.der", "rb")) == NULL
+			|| (cms = PKI_X509_CMS_get_io(io, PKI_DATA_FORMAT_ASN1)) == NULL) {
+		printf("     + Read CMS ...: Failed\n");
+		return 0;
+	}
+	PKI_IO_free(io);
+
+	out_fd = open(test_dir "/data.out", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ok = (PKI_X509_CMS_decrypt_fd(cms, signer_key, signer_cert, -1, out_fd) == PKI_OK);
+	close(out_fd);
+
+	if (!ok || !_files_equal(test_dir "/data.bin", test_dir "/data.out")) {
+		printf("     + Streaming decrypt ...: Failed\n");
+		return 0;
+	}
+	printf("     + Streaming decrypt ...: Ok\n");
+
+	// Decryption to memory
+	mem = PKI_X509_CMS_get_data(cms, signer_key, NULL);
+	ok = (mem && mem->size == TEST_DATA_SIZE);
+	if (mem) PKI_MEM_free(mem);
+	PKI_X509_CMS_free(cms);
+
+	if (!ok) {
+		printf("     + Get data ...: Failed\n");
+		return 0;
+	}
+	printf("     + Get data ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+static int _write_data(const char *file, size_t size) {
+
+	unsigned char buf[4096];
+	uint32_t seed = 0x12345678;
+	size_t i = 0, j = 0, len = 0;
+	FILE *fp = NULL;
+
+	if ((fp = fopen(file, "wb")) == NULL) return 0;
+
+	for (i = 0; i < size; i += len) {
+		len = (size - i < sizeof(buf) ? size - i : sizeof(buf));
+		for (j = 0; j < len; j++) {
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			buf[j] = (unsigned char) seed;
+		}
+		if (fwrite(buf, 1, len, fp) != len) {
+			fclose(fp);
+			return 0;
+		}
+	}
+
+	fclose(fp);
+
+	return 1;
+}
+
+static int _files_equal(const char *a, const char *b) {
+
+	unsigned char buf_a[4096], buf_b[4096];
+	FILE *fa = NULL, *fb = NULL;
+	size_t len_a = 0, len_b = 0;
+	int ret = 1;
+
+	if ((fa = fopen(a, "rb")) == NULL) return 0;
+	if ((fb = fopen(b, "rb")) == NULL) {
+		fclose(fa);
+		return 0;
+	}
+
+	do {
+		len_a = fread(buf_a, 1, sizeof(buf_a), fa);
+		len_b = fread(buf_b, 1, sizeof(buf_b), fb);
+		if (len_a != len_b || memcmp(buf_a, buf_b, len_a) != 0) ret = 0;
+	} while (ret && len_a > 0);
+
+	fclose(fa);
+	fclose(fb);
+
+	return ret;
+}
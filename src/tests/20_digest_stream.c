@@ -0,0 +1,249 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty (20) - Streaming and Parallel Digests"
+#define test_dir  "results/digest-stream"
+
+#define TEST_DATA_SIZE		(3 * 1024 * 1024 + 4097)
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static int _digest_is(const PKI_DIGEST *dgst, const char *hex);
+static int _digest_eq(const PKI_DIGEST *a, const PKI_DIGEST *b);
+
+static unsigned char *test_data = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	uint32_t seed = 0x9e3779b9;
+	size_t i = 0;
+	FILE *fp = NULL;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	mkdir("results", 0755);
+	mkdir(test_dir, 0755);
+
+	if ((test_data = PKI_Malloc(TEST_DATA_SIZE)) == NULL) return 1;
+	for (i = 0; i < TEST_DATA_SIZE; i++) {
+		seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+		test_data[i] = (unsigned char) seed;
+	}
+
+	if ((fp = fopen(test_dir "/data.bin", "wb")) == NULL
+			|| fwrite(test_data, 1, TEST_DATA_SIZE, fp) != TEST_DATA_SIZE) {
+		printf("* %s: Can not write the test data.\n\n", test_name);
+		return 1;
+	}
+	fclose(fp);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	unlink(test_dir "/data.bin");
+	rmdir(test_dir);
+	PKI_Free(test_data);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_DIGEST *one = NULL, *dgst = NULL;
+	size_t offset = 0, len = 1;
+	int ok = 1;
+
+	printf("   - Subtest 1: Init, Update, and Final\n");
+
+	one = PKI_DIGEST_new(PKI_DIGEST_ALG_SHA256, test_data, TEST_DATA_SIZE);
+
+	// Updates of growing (odd) sizes
+	if ((dgst = PKI_DIGEST_init(PKI_DIGEST_ALG_SHA256)) == NULL) ok = 0;
+	for (offset = 0; ok && offset < TEST_DATA_SIZE; offset += len, len = len * 3 + 1) {
+		if (len > TEST_DATA_SIZE - offset) len = TEST_DATA_SIZE - offset;
+		if (PKI_DIGEST_update(dgst, test_data + offset, len) != PKI_OK) ok = 0;
+	}
+
+	if (!ok || PKI_DIGEST_final(dgst) != PKI_OK || !_digest_eq(one, dgst)
+			|| PKI_DIGEST_update(dgst, test_data, 1) == PKI_OK) {
+		printf("     + Streaming digest ...: Failed\n");
+		return 0;
+	}
+	printf("     + Streaming digest ...: Ok\n");
+
+	PKI_DIGEST_free(dgst);
+	PKI_DIGEST_free(one);
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	const PKI_DIGEST_ALG *algs[3];
+	PKI_DIGEST *dgsts[3];
+	PKI_DIGEST *one = NULL;
+	URL *url = NULL;
+	int fd = -1, i = 0, ok = 1;
+
+	printf("   - Subtest 2: File Descriptors and Multiple Digests\n");
+
+	algs[0] = PKI_DIGEST_ALG_SHA256;
+	algs[1] = PKI_DIGEST_ALG_SHA512;
+	algs[2] = PKI_DIGEST_ALG_SHA1;
+
+	for (i = 0; i < 3; i++) dgsts[i] = PKI_DIGEST_init(algs[i]);
+
+	// All the digests in one pass over the file
+	fd = open(test_dir "/data.bin", O_RDONLY);
+	if (PKI_DIGEST_update_fd(dgsts, 3, fd) != PKI_OK) ok = 0;
+	close(fd);
+
+	for (i = 0; ok && i < 3; i++) {
+		one = PKI_DIGEST_new(algs[i], test_data, TEST_DATA_SIZE);
+		if (PKI_DIGEST_final(dgsts[i]) != PKI_OK || !_digest_eq(one, dgsts[i])) ok = 0;
+		PKI_DIGEST_free(one);
+	}
+	for (i = 0; i < 3; i++) PKI_DIGEST_free(dgsts[i]);
+
+	if (!ok) {
+		printf("     + Multiple digests (fd) ...: Failed\n");
+		return 0;
+	}
+	printf("     + Multiple digests (fd) ...: Ok\n");
+
+	// File URLs are digested while being read
+	one = PKI_DIGEST_new(PKI_DIGEST_ALG_SHA256, test_data, TEST_DATA_SIZE);
+	url = URL_new(test_dir "/data.bin");
+	dgsts[0] = PKI_DIGEST_URL_new(PKI_DIGEST_ALG_SHA256, url);
+
+	ok = _digest_eq(one, dgsts[0]);
+
+	if (dgsts[0]) PKI_DIGEST_free(dgsts[0]);
+	PKI_DIGEST_free(one);
+	URL_free(url);
+
+	if (!ok) {
+		printf("     + File URL digest ...: Failed\n");
+		return 0;
+	}
+	printf("     + File URL digest ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	unsigned char sample[24];
+	PKI_DIGEST *a = NULL, *b = NULL, *c = NULL;
+	int fd = -1, i = 0, ok = 0;
+
+	printf("   - Subtest 3: Parallel Digests (ParallelHash)\n");
+
+	// NIST SP 800-185 samples (B = 8, empty customization string)
+	for (i = 0; i < 24; i++) sample[i] = (unsigned char) ((i / 8) * 16 + (i % 8));
+
+	a = PKI_DIGEST_PARALLEL_new(128, 8, 2, sample, sizeof(sample));
+	b = PKI_DIGEST_PARALLEL_new(256, 8, 2, sample, sizeof(sample));
+
+	ok = (_digest_is(a, "ba8dc1d1d979331d3f813603c67f72609ab5e44b94a0b8f9af46514454a2b4f5")
+		&& _digest_is(b, "bc1ef124da34495e948ead207dd9842235da432d2bbc54b4c110e64c451105531b"
+			"7f2a3e0ce055c02805e7c2de1fb746af97a1dd01f43b824e31b87612410429"));
+
+	if (a) PKI_DIGEST_free(a);
+	if (b) PKI_DIGEST_free(b);
+
+	if (!ok) {
+		printf("     + Test vectors ...: Failed\n");
+		return 0;
+	}
+	printf("     + Test vectors ...: Ok\n");
+
+	// Same value regardless of the threads, from memory or fd
+	a = PKI_DIGEST_PARALLEL_new(128, 0, 1, test_data, TEST_DATA_SIZE);
+	b = PKI_DIGEST_PARALLEL_new(128, 0, 4, test_data, TEST_DATA_SIZE);
+
+	fd = open(test_dir "/data.bin", O_RDONLY);
+	c = PKI_DIGEST_PARALLEL_new_fd(128, 0, 3, fd);
+	close(fd);
+
+	ok = (a && _digest_eq(a, b) && _digest_eq(a, c));
+
+	if (a) PKI_DIGEST_free(a);
+	if (b) PKI_DIGEST_free(b);
+	if (c) PKI_DIGEST_free(c);
+
+	if (!ok) {
+		printf("     + Threads and fd ...: Failed\n");
+		return 0;
+	}
+	printf("     + Threads and fd ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+static int _digest_is(const PKI_DIGEST *dgst, const char *hex) {
+
+	char buf[3];
+	size_t i = 0;
+
+	if (!dgst || dgst->size * 2 != strlen(hex)) return 0;
+
+	for (i = 0; i < dgst->size; i++) {
+		snprintf(buf, sizeof(buf), "%2.2x", dgst->digest[i]);
+		if (strncmp(buf, hex + 2 * i, 2) != 0) return 0;
+	}
+
+	return 1;
+}
+
+static int _digest_eq(const PKI_DIGEST *a, const PKI_DIGEST *b) {
+
+	if (!a || !b || a->size == 0 || a->size != b->size) return 0;
+
+	return (memcmp(a->digest, b->digest, a->size) == 0);
+}
@@ -0,0 +1,195 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-One (21) - Batch Digests and HMACs"
+
+#define TEST_MESSAGES		1000
+#define TEST_MAX_SIZE		200
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+
+static unsigned char *messages[TEST_MESSAGES];
+static size_t sizes[TEST_MESSAGES];
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	uint32_t seed = 0x2545f491;
+	int i = 0;
+	size_t j = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// Small messages of different sizes (including empty ones)
+	for (i = 0; i < TEST_MESSAGES; i++) {
+		seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+		sizes[i] = seed % TEST_MAX_SIZE;
+		messages[i] = PKI_Malloc(TEST_MAX_SIZE);
+		for (j = 0; j < sizes[i]; j++) messages[i][j] = (unsigned char) (seed >> (j % 24));
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+	);
+
+	for (i = 0; i < TEST_MESSAGES; i++) PKI_Free(messages[i]);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	const PKI_DIGEST_ALG *algs[2];
+	unsigned char *out = NULL;
+	unsigned char *value = NULL;
+	unsigned char none[16];
+	size_t md_size = 0;
+	int i = 0, a = 0, ok = 1;
+
+	printf("   - Subtest 1: Batch Digests\n");
+
+	algs[0] = PKI_DIGEST_ALG_SHA256;
+	algs[1] = PKI_DIGEST_ALG_SHA1;
+
+	for (a = 0; ok && a < 2; a++) {
+
+		md_size = (size_t) PKI_DIGEST_get_size(algs[a]);
+		out = PKI_Malloc(md_size * TEST_MESSAGES);
+
+		if (PKI_DIGEST_batch(algs[a], (const unsigned char * const *) messages, sizes,
+				TEST_MESSAGES, out, md_size * TEST_MESSAGES) != PKI_OK) ok = 0;
+
+		// Same values as the single digests
+		for (i = 0; ok && i < TEST_MESSAGES; i++) {
+			value = NULL;
+			if (PKI_DIGEST_new_value(&value, algs[a], messages[i], sizes[i]) != (int) md_size
+					|| memcmp(value, out + i * md_size, md_size) != 0) ok = 0;
+			if (value) PKI_Free(value);
+		}
+
+		// Output buffer too small
+		if (PKI_DIGEST_batch(algs[a], (const unsigned char * const *) messages, sizes,
+				TEST_MESSAGES, out, md_size * TEST_MESSAGES - 1) == PKI_OK) ok = 0;
+
+		PKI_Free(out);
+	}
+
+	// Digests without output are rejected
+	if (ok && PKI_DIGEST_batch(EVP_md_null(), (const unsigned char * const *) messages,
+			sizes, TEST_MESSAGES, none, sizeof(none)) == PKI_OK) ok = 0;
+
+	if (!ok) {
+		printf("     + Batch digests ...: Failed\n");
+		return 0;
+	}
+	printf("     + Batch digests ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	// RFC 4231, Test Case 2
+	static const unsigned char rfc_value[32] = {
+		0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26,
+		0x08, 0x95, 0x75, 0xc7, 0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83,
+		0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43 };
+	const unsigned char *rfc_data[2];
+	size_t rfc_sizes[2];
+
+	unsigned char *out = NULL;
+	PKI_MEM *key = NULL, *data = NULL, *value = NULL;
+	PKI_HMAC *hmac = NULL;
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 2: Batch HMACs\n");
+
+	rfc_data[0] = rfc_data[1] = (const unsigned char *) "what do ya want for nothing?";
+	rfc_sizes[0] = rfc_sizes[1] = 28;
+
+	out = PKI_Malloc(32 * TEST_MESSAGES);
+
+	hmac = PKI_HMAC_new((unsigned char *) "Jefe", 4, PKI_DIGEST_ALG_SHA256, NULL);
+	if (!hmac || PKI_HMAC_batch(hmac, rfc_data, rfc_sizes, 2, out, 64) != PKI_OK
+			|| memcmp(out, rfc_value, 32) != 0 || memcmp(out + 32, rfc_value, 32) != 0) {
+		printf("     + Test vector ...: Failed\n");
+		return 0;
+	}
+
+	// The context is still usable after the batch
+	if (PKI_HMAC_update(hmac, (unsigned char *) rfc_data[0], rfc_sizes[0]) != PKI_OK
+			|| PKI_HMAC_finalize(hmac) != PKI_OK
+			|| memcmp(hmac->value->data, rfc_value, 32) != 0) {
+		printf("     + Update after batch ...: Failed\n");
+		return 0;
+	}
+	PKI_HMAC_free(hmac);
+	printf("     + Test vector ...: Ok\n");
+
+	// Same values as the single HMACs
+	key = PKI_MEM_new_data(20, (const unsigned char *) "0123456789abcdefghij");
+	hmac = PKI_HMAC_new_mem(key, PKI_DIGEST_ALG_SHA256, NULL);
+
+	if (!hmac || PKI_HMAC_batch(hmac, (const unsigned char * const *) messages, sizes,
+			TEST_MESSAGES, out, 32 * TEST_MESSAGES) != PKI_OK) ok = 0;
+
+	for (i = 0; ok && i < TEST_MESSAGES; i++) {
+		if (sizes[i] == 0) continue;
+		data = PKI_MEM_new_data(sizes[i], messages[i]);
+		value = PKI_HMAC_new_data(data, key, PKI_DIGEST_ALG_SHA256);
+		if (!value || value->size != 32 || memcmp(value->data, out + i * 32, 32) != 0) ok = 0;
+		if (value) PKI_MEM_free(value);
+		PKI_MEM_free(data);
+	}
+
+	if (hmac) PKI_HMAC_free(hmac);
+	PKI_MEM_free(key);
+	PKI_Free(out);
+
+	if (!ok) {
+		printf("     + Batch HMACs ...: Failed\n");
+		return 0;
+	}
+	printf("     + Batch HMACs ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
@@ -0,0 +1,288 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-Two (22) - Base64 and PEM Decoding"
+
+#define TEST_DATA_SIZE		(256 * 1024 + 7)
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static int _same_der(PKI_X509 *x, const PKI_MEM *der);
+
+static unsigned char *test_data = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	uint32_t seed = 0x6a09e667;
+	size_t i = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	if ((test_data = PKI_Malloc(TEST_DATA_SIZE)) == NULL) return 1;
+	for (i = 0; i < TEST_DATA_SIZE; i++) {
+		seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+		test_data[i] = (unsigned char) seed;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	PKI_Free(test_data);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	unsigned char *enc = NULL, *ref = NULL, *dec = NULL;
+	size_t len = 0, size = 0;
+	ssize_t dec_size = 0;
+	int ok = 1;
+
+	printf("   - Subtest 1: Encoding and Decoding\n");
+
+	enc = PKI_Malloc(PKI_B64_encoded_size(TEST_DATA_SIZE, 0) + 1);
+	ref = PKI_Malloc(PKI_B64_encoded_size(TEST_DATA_SIZE, 0) + 1);
+	dec = PKI_Malloc(PKI_B64_decoded_size(PKI_B64_encoded_size(TEST_DATA_SIZE, 0)));
+
+	// All the sizes up to 300 bytes, from different offsets
+	for (len = 0; ok && len <= 300; len++) {
+		size = PKI_B64_encode(enc, test_data + len, len, 0);
+		if (size != PKI_B64_encoded_size(len, 0)
+				|| (size_t) EVP_EncodeBlock(ref, test_data + len, (int) len) != size
+				|| memcmp(enc, ref, size) != 0) ok = 0;
+
+		dec_size = PKI_B64_decode(dec, enc, size);
+		if (dec_size != (ssize_t) len || memcmp(dec, test_data + len, len) != 0) ok = 0;
+	}
+
+	// Large data
+	size = PKI_B64_encode(enc, test_data, TEST_DATA_SIZE, 0);
+	if ((size_t) EVP_EncodeBlock(ref, test_data, TEST_DATA_SIZE) != size
+			|| memcmp(enc, ref, size) != 0) ok = 0;
+	dec_size = PKI_B64_decode(dec, enc, size);
+	if (dec_size != TEST_DATA_SIZE || memcmp(dec, test_data, TEST_DATA_SIZE) != 0) ok = 0;
+
+	if (!ok) {
+		printf("     + Encode and decode ...: Failed\n");
+		return 0;
+	}
+	printf("     + Encode and decode ...: Ok\n");
+
+	// Invalid data
+	if (PKI_B64_decode(dec, (const unsigned char *) "QUJD*EVG", 8) >= 0
+			|| PKI_B64_decode(dec, (const unsigned char *) "QQ==QQ==", 8) >= 0
+			|| PKI_B64_decode(dec, (const unsigned char *) "Q===", 4) >= 0
+			|| PKI_B64_decode(dec, (const unsigned char *) "QUJDR", 5) >= 0
+			|| PKI_B64_decode(dec, (const unsigned char *)
+				"QUJDREVGR0hJSktMTU5PUFFSU1RVVldY\x80VowYWJj", 40) >= 0) {
+		printf("     + Invalid data ...: Failed\n");
+		return 0;
+	}
+
+	// Missing padding and blanks
+	if (PKI_B64_decode(dec, (const unsigned char *) "QUI", 3) != 2 || memcmp(dec, "AB", 2) != 0
+			|| PKI_B64_decode(dec, (const unsigned char *) " QU\r\nJD\tRA== \n", 14) != 4
+			|| memcmp(dec, "ABCD", 4) != 0) {
+		printf("     + Padding and blanks ...: Failed\n");
+		return 0;
+	}
+	printf("     + Invalid data ...: Ok\n");
+
+	PKI_Free(enc);
+	PKI_Free(ref);
+	PKI_Free(dec);
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	static const int line_lens[] = { 64, 76, 4, 100 };
+	unsigned char *enc = NULL, *crlf = NULL, *dec = NULL;
+	size_t size = 0, i = 0, j = 0;
+	ssize_t dec_size = 0;
+	PKI_MEM *mem = NULL, *b64 = NULL;
+	int l = 0, ok = 1;
+
+	printf("   - Subtest 2: Line Breaks\n");
+
+	enc = PKI_Malloc(PKI_B64_encoded_size(TEST_DATA_SIZE, 4));
+	crlf = PKI_Malloc(PKI_B64_encoded_size(TEST_DATA_SIZE, 4) * 2);
+	dec = PKI_Malloc(TEST_DATA_SIZE + 3);
+
+	for (l = 0; ok && l < 4; l++) {
+
+		size = PKI_B64_encode(enc, test_data, TEST_DATA_SIZE, line_lens[l]);
+		if (size != PKI_B64_encoded_size(TEST_DATA_SIZE, line_lens[l])
+				|| enc[line_lens[l]] != '\n' || enc[size - 1] == '\n') ok = 0;
+
+		dec_size = PKI_B64_decode(dec, enc, size);
+		if (dec_size != TEST_DATA_SIZE || memcmp(dec, test_data, TEST_DATA_SIZE) != 0) ok = 0;
+
+		// Same data with CRLF line breaks
+		for (i = 0, j = 0; i < size; i++) {
+			if (enc[i] == '\n') crlf[j++] = '\r';
+			crlf[j++] = enc[i];
+		}
+
+		dec_size = PKI_B64_decode(dec, crlf, j);
+		if (dec_size != TEST_DATA_SIZE || memcmp(dec, test_data, TEST_DATA_SIZE) != 0) ok = 0;
+	}
+
+	PKI_Free(enc);
+	PKI_Free(crlf);
+	PKI_Free(dec);
+
+	if (!ok) {
+		printf("     + Line lengths ...: Failed\n");
+		return 0;
+	}
+	printf("     + Line lengths ...: Ok\n");
+
+	// PKI_MEM encoding and decoding
+	mem = PKI_MEM_new_data(TEST_DATA_SIZE, test_data);
+
+	if ((b64 = PKI_MEM_get_b64_encoded(mem, 1)) == NULL
+			|| strlen((char *) b64->data) != b64->size
+			|| PKI_MEM_decode(b64, PKI_DATA_FORMAT_B64, 0) != PKI_OK
+			|| b64->size != TEST_DATA_SIZE || memcmp(b64->data, test_data, TEST_DATA_SIZE) != 0
+			|| PKI_MEM_encode(mem, PKI_DATA_FORMAT_B64, 0) != PKI_OK
+			|| mem->size != PKI_B64_encoded_size(TEST_DATA_SIZE, 0)) ok = 0;
+
+	if (b64) PKI_MEM_free(b64);
+	PKI_MEM_free(mem);
+
+	if (!ok) {
+		printf("     + PKI_MEM encode and decode ...: Failed\n");
+		return 0;
+	}
+	printf("     + PKI_MEM encode and decode ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_X509_KEYPAIR *key = NULL;
+	PKI_X509_CERT *cert = NULL, *x = NULL;
+	PKI_MEM *pem = NULL, *der = NULL, *b64 = NULL, *p = NULL;
+	char label[64];
+	int ok = 0;
+
+	printf("   - Subtest 3: PEM and B64 Objects\n");
+
+	if ((key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 128, NULL, NULL, NULL)) == NULL
+			|| (cert = PKI_X509_CERT_new(NULL, key, NULL, "CN=Base64, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL) {
+		printf("     + Credentials ...: Failed\n");
+		return 0;
+	}
+
+	pem = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_PEM, NULL, NULL);
+	der = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+
+	p = PKI_MEM_get_pem_decoded(pem, label, sizeof(label));
+	ok = (p && strcmp(label, "TRUSTED CERTIFICATE") == 0
+		&& p->size == der->size && memcmp(p->data, der->data, der->size) == 0);
+	if (p) PKI_MEM_free(p);
+
+	if (!ok) {
+		printf("     + PEM decoding ...: Failed\n");
+		return 0;
+	}
+	printf("     + PEM decoding ...: Ok\n");
+
+	// PEM, B64 and auto-detected formats
+	x = PKI_X509_get_mem(pem, PKI_DATATYPE_X509_CERT, PKI_DATA_FORMAT_PEM, NULL, NULL);
+	ok = _same_der(x, der);
+	if (x) PKI_X509_CERT_free(x);
+
+	if (ok) {
+		b64 = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_B64, NULL, NULL);
+		x = PKI_X509_get_mem(b64, PKI_DATATYPE_X509_CERT, PKI_DATA_FORMAT_UNKNOWN, NULL, NULL);
+		ok = (b64 && _same_der(x, der));
+		if (x) PKI_X509_CERT_free(x);
+	}
+
+	// Keys are still read via the PEM callback
+	if (ok) {
+		p = PKI_X509_put_mem(key, PKI_DATA_FORMAT_PEM, NULL, NULL);
+		x = PKI_X509_get_mem(p, PKI_DATATYPE_X509_KEYPAIR, PKI_DATA_FORMAT_PEM, NULL, NULL);
+		ok = (x != NULL);
+		if (x) PKI_X509_KEYPAIR_free(x);
+		if (p) PKI_MEM_free(p);
+	}
+
+	if (b64) PKI_MEM_free(b64);
+	PKI_MEM_free(pem);
+	PKI_MEM_free(der);
+	PKI_X509_CERT_free(cert);
+	PKI_X509_KEYPAIR_free(key);
+
+	if (!ok) {
+		printf("     + Objects ...: Failed\n");
+		return 0;
+	}
+	printf("     + Objects ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+static int _same_der(PKI_X509 *x, const PKI_MEM *der) {
+
+	PKI_MEM *mem = NULL;
+	int ret = 0;
+
+	if (!x || (mem = PKI_X509_put_mem(x, PKI_DATA_FORMAT_ASN1, NULL, NULL)) == NULL) return 0;
+
+	ret = (mem->size == der->size && memcmp(mem->data, der->data, der->size) == 0);
+	PKI_MEM_free(mem);
+
+	return ret;
+}
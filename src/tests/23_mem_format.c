@@ -0,0 +1,191 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-Three (23) - Data Format Detection"
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+
+static int _format_is(PKI_MEM *mem, PKI_DATA_FORMAT format, PKI_DATATYPE type);
+
+static PKI_X509_KEYPAIR *key = NULL;
+static PKI_X509_CERT *cert = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	if ((key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 128, NULL, NULL, NULL)) == NULL
+			|| (cert = PKI_X509_CERT_new(NULL, key, NULL, "CN=Format, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test credentials.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+	);
+
+	PKI_X509_CERT_free(cert);
+	PKI_X509_KEYPAIR_free(key);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_MEM *pem = NULL, *der = NULL, *b64 = NULL, *txt = NULL, *key_pem = NULL;
+	PKI_MEM *mem = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 1: Format Detection\n");
+
+	pem = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_PEM, NULL, NULL);
+	der = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+	b64 = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_B64, NULL, NULL);
+	txt = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_TXT, NULL, NULL);
+	key_pem = PKI_X509_put_mem(key, PKI_DATA_FORMAT_PEM, NULL, NULL);
+
+	ok = (_format_is(pem, PKI_DATA_FORMAT_PEM, PKI_DATATYPE_X509_CERT)
+		&& _format_is(der, PKI_DATA_FORMAT_ASN1, PKI_DATATYPE_UNKNOWN)
+		&& _format_is(b64, PKI_DATA_FORMAT_B64, PKI_DATATYPE_UNKNOWN)
+		&& _format_is(txt, PKI_DATA_FORMAT_TXT, PKI_DATATYPE_UNKNOWN)
+		&& _format_is(key_pem, PKI_DATA_FORMAT_PEM, PKI_DATATYPE_X509_KEYPAIR));
+
+	if (ok) {
+		// Text followed by the PEM block
+		mem = PKI_MEM_new_data(txt->size, txt->data);
+		PKI_MEM_add(mem, pem->data, pem->size);
+		ok = _format_is(mem, PKI_DATA_FORMAT_PEM, PKI_DATATYPE_X509_CERT);
+		PKI_MEM_free(mem);
+	}
+
+	if (ok) {
+		// Text starting with the SEQUENCE tag ('0')
+		mem = PKI_MEM_new_data(20, (const unsigned char *) "0123456789abcdef:xyz");
+		ok = _format_is(mem, PKI_DATA_FORMAT_TXT, PKI_DATATYPE_UNKNOWN);
+		PKI_MEM_free(mem);
+	}
+
+	if (ok) {
+		mem = PKI_MEM_new_data(12, (const unsigned char *) "  <xml></xml>");
+		ok = _format_is(mem, PKI_DATA_FORMAT_XML, PKI_DATATYPE_UNKNOWN);
+		PKI_MEM_free(mem);
+	}
+
+	if (!ok) {
+		printf("     + Detection ...: Failed\n");
+		return 0;
+	}
+	printf("     + Detection ...: Ok\n");
+
+	// Objects are loaded with the detected format
+	ok = 1;
+	mem = pem;
+	while (ok && mem) {
+		PKI_X509_CERT *x = PKI_X509_get_mem(mem, PKI_DATATYPE_X509_CERT,
+					PKI_DATA_FORMAT_UNKNOWN, NULL, NULL);
+		ok = (x != NULL);
+		if (x) PKI_X509_CERT_free(x);
+		mem = (mem == pem ? der : (mem == der ? b64 : NULL));
+	}
+
+	PKI_MEM_free(pem);
+	PKI_MEM_free(der);
+	PKI_MEM_free(b64);
+	PKI_MEM_free(txt);
+	PKI_MEM_free(key_pem);
+
+	if (!ok) {
+		printf("     + Load ...: Failed\n");
+		return 0;
+	}
+	printf("     + Load ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_X509_PKCS12_DATA *data = NULL;
+	PKI_X509_PKCS12 *p12 = NULL;
+	PKI_CRED *cred = NULL;
+	PKI_MEM *der = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 2: PKCS#12\n");
+
+	cred = PKI_CRED_new(NULL, "secret");
+	data = PKI_X509_PKCS12_DATA_new();
+
+	if (!data || PKI_X509_PKCS12_DATA_add_keypair(data, key, cred) != PKI_OK
+			|| PKI_X509_PKCS12_DATA_add_certs(data, cert, NULL, NULL, cred) != PKI_OK
+			|| (p12 = PKI_X509_PKCS12_new(data, cred)) == NULL) {
+		printf("     + PKCS#12 creation ...: Failed\n");
+		return 0;
+	}
+	PKI_X509_PKCS12_DATA_free(data);
+	PKI_CRED_free(cred);
+
+	der = PKI_X509_put_mem(p12, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+	ok = _format_is(der, PKI_DATA_FORMAT_ASN1, PKI_DATATYPE_X509_PKCS12);
+
+	if (der) PKI_MEM_free(der);
+	PKI_X509_PKCS12_free(p12);
+
+	if (!ok) {
+		printf("     + PKCS#12 detection ...: Failed\n");
+		return 0;
+	}
+	printf("     + PKCS#12 detection ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+static int _format_is(PKI_MEM *mem, PKI_DATA_FORMAT format, PKI_DATATYPE type) {
+
+	PKI_DATATYPE detected = PKI_DATATYPE_UNKNOWN;
+
+	if (!mem) return 0;
+
+	return (PKI_X509_get_mem_format(mem, &detected) == format && detected == type);
+}
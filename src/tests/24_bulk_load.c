@@ -0,0 +1,305 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-Four (24) - Bulk Certificate Loading"
+
+#define TEST_CERTS		50
+#define TEST_COPIES		4
+
+#define TEST_CHAIN		"results/24-bulk-load-chain.pem"
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+int subtest4();
+
+static int _same_certs(PKI_X509_CERT_STACK *sk, int num);
+
+static PKI_X509_CERT *certs[TEST_CERTS];
+static PKI_MEM *pem[TEST_CERTS];
+static PKI_MEM *der[TEST_CERTS];
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_KEYPAIR *key = NULL;
+	char serial[16];
+	int i = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	if ((key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 128, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test key.\n\n", test_name);
+		return 1;
+	}
+
+	for (i = 0; i < TEST_CERTS; i++) {
+		snprintf(serial, sizeof(serial), "%d", i + 1);
+		if ((certs[i] = PKI_X509_CERT_new(NULL, key, NULL, "CN=Bulk, O=OpenCA",
+				serial, 3600, NULL, NULL, NULL, NULL)) == NULL
+				|| (pem[i] = PKI_X509_put_mem(certs[i], PKI_DATA_FORMAT_PEM, NULL, NULL)) == NULL
+				|| (der[i] = PKI_X509_put_mem(certs[i], PKI_DATA_FORMAT_ASN1, NULL, NULL)) == NULL) {
+			printf("* %s: Can not generate the test certificates.\n\n", test_name);
+			return 1;
+		}
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+		&& subtest4()
+	);
+
+	for (i = 0; i < TEST_CERTS; i++) {
+		PKI_X509_CERT_free(certs[i]);
+		PKI_MEM_free(pem[i]);
+		PKI_MEM_free(der[i]);
+	}
+	PKI_X509_KEYPAIR_free(key);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_STACK *st = NULL;
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 1: Stack Operations\n");
+
+	st = PKI_STACK_new_null();
+
+	for (i = 0; ok && i < 1000; i++) {
+		if (PKI_STACK_push(st, (void *)(intptr_t)(i + 1)) != i + 1) ok = 0;
+	}
+
+	for (i = 0; ok && i < 1000; i++) {
+		if (PKI_STACK_get_num(st, i) != (void *)(intptr_t)(i + 1)) ok = 0;
+	}
+
+	if (PKI_STACK_get_num(st, 1000) != NULL || PKI_STACK_get_num(st, -1) != NULL) ok = 0;
+
+	// Insertion and deletion in the middle, at the head and at the tail
+	if (PKI_STACK_ins_num(st, 500, (void *) 5000) != PKI_OK
+			|| PKI_STACK_ins_num(st, 0, (void *) 6000) != PKI_OK
+			|| PKI_STACK_ins_num(st, 1002, (void *) 7000) != PKI_OK
+			|| PKI_STACK_ins_num(st, 1004, (void *) 8000) == PKI_OK
+			|| PKI_STACK_elements(st) != 1003
+			|| PKI_STACK_get_num(st, 501) != (void *) 5000
+			|| PKI_STACK_get_num(st, 0) != (void *) 6000
+			|| PKI_STACK_del_num(st, 1002) != (void *) 7000
+			|| PKI_STACK_del_num(st, 501) != (void *) 5000
+			|| PKI_STACK_del_num(st, 0) != (void *) 6000
+			|| PKI_STACK_del_num(st, 1000) != NULL
+			|| PKI_STACK_elements(st) != 1000
+			|| PKI_STACK_get_num(st, 500) != (void *) 501) ok = 0;
+
+	for (i = 1000; ok && i > 0; i--) {
+		if (PKI_STACK_pop(st) != (void *)(intptr_t) i) ok = 0;
+	}
+
+	if (PKI_STACK_pop(st) != NULL || PKI_STACK_elements(st) != 0) ok = 0;
+
+	PKI_STACK_free(st);
+
+	if (!ok) {
+		printf("     + Push, get, insert, delete and pop ...: Failed\n");
+		return 0;
+	}
+	printf("     + Push, get, insert, delete and pop ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	static const char invalid[] = "-----BEGIN CERTIFICATE-----\nQUJD\n-----END CERTIFICATE-----\n";
+	PKI_X509_CERT_STACK *sk = NULL;
+	PKI_MEM *bundle = NULL;
+	int i = 0, c = 0, ok = 1;
+
+	printf("   - Subtest 2: PEM Bundles\n");
+
+	// Text and blank lines between the blocks, then the duplicates
+	bundle = PKI_MEM_new_null();
+	for (c = 0; c < TEST_COPIES; c++) {
+		for (i = 0; i < TEST_CERTS; i++) {
+			PKI_MEM_add(bundle, (const unsigned char *) "# Bulk\n\n", 8);
+			PKI_MEM_add(bundle, pem[i]->data, pem[i]->size);
+		}
+	}
+
+	// Single thread, multiple threads and the default
+	for (i = 1; ok && i <= 8; i *= 2) {
+		sk = PKI_X509_STACK_get_mem_bulk(bundle, PKI_DATATYPE_X509_CERT,
+					PKI_DATA_FORMAT_UNKNOWN, i == 8 ? 0 : i, NULL, NULL);
+		ok = _same_certs(sk, TEST_CERTS);
+		if (sk) PKI_STACK_X509_CERT_free_all(sk);
+	}
+
+	PKI_MEM_free(bundle);
+
+	if (!ok) {
+		printf("     + PEM bundle ...: Failed\n");
+		return 0;
+	}
+	printf("     + PEM bundle ...: Ok\n");
+
+	// Not matching objects are skipped
+	bundle = PKI_MEM_new_data(pem[0]->size, pem[0]->data);
+	PKI_MEM_add(bundle, (const unsigned char *) invalid, strlen(invalid));
+	PKI_MEM_add(bundle, pem[1]->data, pem[1]->size);
+
+	sk = PKI_X509_STACK_get_mem_bulk(bundle, PKI_DATATYPE_X509_CERT,
+					PKI_DATA_FORMAT_PEM, 2, NULL, NULL);
+	ok = _same_certs(sk, 2);
+	if (sk) PKI_STACK_X509_CERT_free_all(sk);
+	PKI_MEM_free(bundle);
+
+	if (!ok) {
+		printf("     + Invalid objects ...: Failed\n");
+		return 0;
+	}
+	printf("     + Invalid objects ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_X509_CERT_STACK *sk = NULL;
+	PKI_MEM *bundle = NULL;
+	int i = 0, c = 0, ok = 1;
+
+	printf("   - Subtest 3: DER Sequences\n");
+
+	bundle = PKI_MEM_new_null();
+	for (c = 0; c < TEST_COPIES; c++) {
+		for (i = 0; i < TEST_CERTS; i++) PKI_MEM_add(bundle, der[i]->data, der[i]->size);
+	}
+
+	sk = PKI_X509_STACK_get_mem_bulk(bundle, PKI_DATATYPE_X509_CERT,
+					PKI_DATA_FORMAT_UNKNOWN, 4, NULL, NULL);
+	ok = _same_certs(sk, TEST_CERTS);
+	if (sk) PKI_STACK_X509_CERT_free_all(sk);
+
+	// A single object is also loaded
+	if (ok) {
+		sk = PKI_X509_STACK_get_mem_bulk(der[0], PKI_DATATYPE_X509_CERT,
+					PKI_DATA_FORMAT_ASN1, 0, NULL, NULL);
+		ok = _same_certs(sk, 1);
+		if (sk) PKI_STACK_X509_CERT_free_all(sk);
+	}
+
+	PKI_MEM_free(bundle);
+
+	if (!ok) {
+		printf("     + DER sequence ...: Failed\n");
+		return 0;
+	}
+	printf("     + DER sequence ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+int subtest4() {
+
+	PKI_X509_CERT_STACK *sk = NULL;
+	PKI_X509_CERT *x = NULL;
+	PKI_MEM *mem = NULL;
+	FILE *fp = NULL;
+	int i = 0, ok = 0;
+
+	printf("   - Subtest 4: URL Loading\n");
+
+	// Leaf, intermediate and root
+	mkdir("results", 0755);
+	if ((fp = fopen(TEST_CHAIN, "w")) == NULL) return 0;
+	for (i = 0; i < 3; i++) fwrite(pem[i]->data, 1, pem[i]->size, fp);
+	fclose(fp);
+
+	// The first object is returned
+	if ((x = PKI_X509_CERT_get(TEST_CHAIN, PKI_DATA_FORMAT_UNKNOWN, NULL, NULL)) != NULL
+			&& (mem = PKI_X509_put_mem(x, PKI_DATA_FORMAT_ASN1, NULL, NULL)) != NULL) {
+		ok = (mem->size == der[0]->size && memcmp(mem->data, der[0]->data, mem->size) == 0);
+	}
+	if (mem) PKI_MEM_free(mem);
+	if (x) PKI_X509_CERT_free(x);
+
+	// All the objects are returned, in order
+	if (ok) {
+		sk = PKI_X509_CERT_STACK_get(TEST_CHAIN, PKI_DATA_FORMAT_UNKNOWN, NULL, NULL);
+		ok = _same_certs(sk, 3);
+		if (sk) PKI_STACK_X509_CERT_free_all(sk);
+	}
+
+	unlink(TEST_CHAIN);
+
+	if (!ok) {
+		printf("     + First object and stack ...: Failed\n");
+		return 0;
+	}
+	printf("     + First object and stack ...: Ok\n");
+
+	printf("   - Subtest 4: Passed\n\n");
+
+	return 1;
+}
+
+// Checks the stack contains the first 'num' certificates, in order
+static int _same_certs(PKI_X509_CERT_STACK *sk, int num) {
+
+	PKI_MEM *mem = NULL;
+	int i = 0, ok = 1;
+
+	if (!sk || PKI_STACK_X509_CERT_elements(sk) != num) return 0;
+
+	for (i = 0; ok && i < num; i++) {
+		mem = PKI_X509_put_mem(PKI_STACK_X509_CERT_get_num(sk, i),
+					PKI_DATA_FORMAT_ASN1, NULL, NULL);
+		ok = (mem && mem->size == der[i]->size && memcmp(mem->data, der[i]->data, mem->size) == 0);
+		if (mem) PKI_MEM_free(mem);
+	}
+
+	return ok;
+}
@@ -0,0 +1,351 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-Five (25) - Arena Allocator"
+
+#define TEST_REQUESTS		100
+
+#define test_dir  "results/arena-config"
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+int subtest4();
+
+static void * _thread_alloc(void *arg);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+		&& subtest4()
+	);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_ARENA *arena = NULL;
+	unsigned char *p = NULL, *q = NULL, *r = NULL;
+	size_t i = 0;
+	int ok = 1;
+
+	printf("   - Subtest 1: Allocations\n");
+
+	arena = PKI_ARENA_new(4096);
+
+	// Aligned and zeroized memory
+	for (i = 1; ok && i < 2000; i += 7) {
+		p = PKI_ARENA_alloc(arena, i);
+		if (!p || ((uintptr_t) p & 15) != 0 || !PKI_ARENA_owns(arena, p)
+				|| p[0] != 0 || p[i-1] != 0) ok = 0;
+		if (ok) memset(p, 0xAA, i);
+	}
+
+	// Large allocations and not owned memory
+	p = PKI_ARENA_alloc(arena, 100000);
+	q = PKI_Malloc(16);
+	if (!p || !PKI_ARENA_owns(arena, p) || !PKI_ARENA_owns(arena, p + 99999)
+			|| PKI_ARENA_owns(arena, q) || PKI_ARENA_alloc(arena, 0) != NULL) ok = 0;
+	PKI_Free(q);
+
+	if (!ok) {
+		printf("     + Alloc ...: Failed\n");
+		return 0;
+	}
+	printf("     + Alloc ...: Ok\n");
+
+	// In-place growth of the last allocation, copy otherwise
+	PKI_ARENA_reset(arena);
+	p = PKI_ARENA_alloc(arena, 10);
+	memcpy(p, "0123456789", 10);
+	q = PKI_ARENA_realloc(arena, p, 100);
+	r = PKI_ARENA_alloc(arena, 10);
+	if (q != p || r == NULL) ok = 0;
+	q = PKI_ARENA_realloc(arena, p, 200);
+	if (q == p || memcmp(q, "0123456789", 10) != 0) ok = 0;
+
+	if (!ok) {
+		printf("     + Realloc ...: Failed\n");
+		return 0;
+	}
+	printf("     + Realloc ...: Ok\n");
+
+	PKI_ARENA_reset(arena);
+	if (PKI_ARENA_owns(arena, p) || PKI_ARENA_owns(arena, q)
+			|| (p = PKI_ARENA_alloc(arena, 32)) == NULL || p[0] != 0) ok = 0;
+
+	PKI_ARENA_free(arena);
+
+	if (!ok) {
+		printf("     + Reset ...: Failed\n");
+		return 0;
+	}
+	printf("     + Reset ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_ARENA *arena = NULL, *inner = NULL;
+	PKI_THREAD *th = NULL;
+	PKI_STACK *st = NULL;
+	PKI_MEM *mem = NULL;
+	void *heap = NULL, *p = NULL, *ret = NULL;
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 2: Thread Binding\n");
+
+	arena = PKI_ARENA_new(0);
+	inner = PKI_ARENA_new(0);
+	heap = PKI_Malloc(64);
+
+	if (PKI_ARENA_bind(arena) != PKI_OK || PKI_ARENA_get_current() != arena
+			|| PKI_ARENA_bind(arena) == PKI_OK) ok = 0;
+
+	// PKI_MEM and PKI_STACK allocations
+	mem = PKI_MEM_new_data(5, (const unsigned char *) "Hello");
+	for (i = 0; ok && i < 1000; i++) PKI_MEM_add(mem, (const unsigned char *) "!", 1);
+	if (!mem || !PKI_ARENA_owns(arena, mem) || !PKI_ARENA_owns(arena, mem->data)
+			|| mem->size != 1005 || memcmp(mem->data, "Hello!", 6) != 0) ok = 0;
+
+	st = PKI_STACK_new_null();
+	for (i = 0; ok && i < 1000; i++) PKI_STACK_push(st, mem);
+	if (!st || !PKI_ARENA_owns(arena, st) || PKI_STACK_elements(st) != 1000) ok = 0;
+
+	// Freeing arena and heap memory
+	PKI_STACK_free(st);
+	PKI_MEM_free(mem);
+	PKI_Free(heap);
+
+	// Other threads are not affected
+	if ((th = PKI_THREAD_new(_thread_alloc, arena)) == NULL
+			|| PKI_THREAD_join(th, &ret) != PKI_OK || ret != NULL) ok = 0;
+	if (th) PKI_Free(th);
+
+	// Nested scopes
+	if (PKI_ARENA_bind(inner) != PKI_OK || (p = PKI_Malloc(8)) == NULL
+			|| !PKI_ARENA_owns(inner, p) || PKI_ARENA_owns(arena, p)
+			|| PKI_ARENA_unbind(arena) == PKI_OK || PKI_ARENA_unbind(inner) != PKI_OK
+			|| PKI_ARENA_get_current() != arena) ok = 0;
+
+	if (PKI_ARENA_unbind(arena) != PKI_OK || PKI_ARENA_get_current() != NULL) ok = 0;
+
+	p = PKI_Malloc(8);
+	if (PKI_ARENA_owns(arena, p)) ok = 0;
+	PKI_Free(p);
+
+	PKI_ARENA_free(inner);
+	PKI_ARENA_free(arena);
+
+	if (!ok) {
+		printf("     + Bind and unbind ...: Failed\n");
+		return 0;
+	}
+	printf("     + Bind and unbind ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_X509_KEYPAIR *key = NULL;
+	PKI_X509_CERT *cert = NULL, *x = NULL;
+	PKI_ARENA *arena = NULL;
+	PKI_MEM *pem = NULL, *b64 = NULL;
+	char *subject = NULL;
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 3: Request Scopes\n");
+
+	if ((key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 128, NULL, NULL, NULL)) == NULL
+			|| (cert = PKI_X509_CERT_new(NULL, key, NULL, "CN=Arena, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL
+			|| (pem = PKI_X509_put_mem(cert, PKI_DATA_FORMAT_PEM, NULL, NULL)) == NULL) {
+		printf("     + Credentials ...: Failed\n");
+		return 0;
+	}
+
+	arena = PKI_ARENA_new(0);
+
+	// Decode, encode and release every request at once
+	for (i = 0; ok && i < TEST_REQUESTS; i++) {
+
+		PKI_ARENA_bind(arena);
+
+		x = PKI_X509_get_mem(pem, PKI_DATATYPE_X509_CERT, PKI_DATA_FORMAT_UNKNOWN, NULL, NULL);
+		b64 = x ? PKI_X509_put_mem(x, PKI_DATA_FORMAT_B64, NULL, NULL) : NULL;
+		subject = x ? PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_SUBJECT) : NULL;
+
+		if (!x || !b64 || !PKI_ARENA_owns(arena, x) || !PKI_ARENA_owns(arena, b64)
+				|| !subject || strstr(subject, "Arena") == NULL) ok = 0;
+
+		// Freeing is still allowed (and does not release arena memory)
+		if (x) PKI_X509_CERT_free(x);
+		if (subject) PKI_Free(subject);
+
+		PKI_ARENA_unbind(arena);
+		PKI_ARENA_reset(arena);
+	}
+
+	PKI_ARENA_free(arena);
+	PKI_MEM_free(pem);
+	PKI_X509_CERT_free(cert);
+	PKI_X509_KEYPAIR_free(key);
+
+	if (!ok) {
+		printf("     + Certificate requests ...: Failed\n");
+		return 0;
+	}
+	printf("     + Certificate requests ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+int subtest4() {
+
+	PKI_ARENA *arena = NULL, *suspended = NULL;
+	PKI_MEM *mem = NULL;
+	char *p = NULL, *q = NULL, *found = NULL;
+	FILE *fp = NULL;
+	int ok = 1;
+
+	printf("   - Subtest 4: Long-Lived Data\n");
+
+	arena = PKI_ARENA_new(0);
+
+	// Arena memory freed and resized after the unbind
+	PKI_ARENA_bind(arena);
+	p = PKI_Malloc(32);
+	mem = PKI_MEM_new_data(5, (const unsigned char *) "Hello");
+	PKI_ARENA_unbind(arena);
+
+	if (!p || !mem || PKI_ARENA_find(p) != arena || PKI_ARENA_find(mem->data) != arena) ok = 0;
+	if (ok) {
+		memcpy(p, "0123456789", 10);
+		q = PKI_Realloc(p, 64);
+		if (!q || q == p || PKI_ARENA_find(q) != NULL || memcmp(q, "0123456789", 10) != 0) ok = 0;
+		PKI_Free(q);
+	}
+	PKI_MEM_free(mem);
+	PKI_Free(p);
+
+	if (!ok) {
+		printf("     + Free after unbind ...: Failed\n");
+		return 0;
+	}
+	printf("     + Free after unbind ...: Ok\n");
+
+	// Heap allocations while the arena is suspended
+	PKI_ARENA_bind(arena);
+	suspended = PKI_ARENA_suspend();
+	p = PKI_Malloc(16);
+	PKI_ARENA_resume(suspended);
+	q = PKI_Malloc(16);
+
+	if (suspended != arena || PKI_ARENA_get_current() != arena || !p || !q
+			|| PKI_ARENA_find(p) != NULL || PKI_ARENA_find(q) != arena) ok = 0;
+	PKI_Free(p);
+
+	// The configuration registry is not allocated from the arena
+	mkdir("results", 0755);
+	mkdir(test_dir, 0755);
+	if ((fp = fopen(test_dir "/arena.xml", "w")) != NULL) {
+		fprintf(fp, "<?xml version=\"1.0\" ?>\n"
+			"<pki:tokenConfig xmlns:pki=\"http://www.openca.org/openca/pki/1/0/0\">\n"
+			"  <pki:name>arena</pki:name>\n"
+			"</pki:tokenConfig>\n");
+		fclose(fp);
+	} else ok = 0;
+
+	found = PKI_CONFIG_find(test_dir, "arena");
+	if (!found || strcmp(found, test_dir "/arena.xml") != 0) ok = 0;
+	PKI_Free(found);
+
+	PKI_ARENA_unbind(arena);
+	PKI_ARENA_reset(arena);
+
+	// Overwrites the released arena memory
+	PKI_ARENA_bind(arena);
+	if ((p = PKI_Malloc(PKI_ARENA_CHUNK_SIZE / 2)) != NULL) memset(p, 0xAA, PKI_ARENA_CHUNK_SIZE / 2);
+	PKI_ARENA_unbind(arena);
+
+	found = PKI_CONFIG_find(test_dir, "ARENA");
+	if (!found || strcmp(found, test_dir "/arena.xml") != 0) ok = 0;
+	PKI_Free(found);
+
+	PKI_ARENA_free(arena);
+
+	unlink(test_dir "/arena.xml");
+	rmdir(test_dir);
+	PKI_CONFIG_cache_flush();
+
+	if (!ok) {
+		printf("     + Registry across requests ...: Failed\n");
+		return 0;
+	}
+	printf("     + Registry across requests ...: Ok\n");
+
+	printf("   - Subtest 4: Passed\n\n");
+
+	return 1;
+}
+
+static void * _thread_alloc(void *arg) {
+
+	PKI_ARENA *arena = (PKI_ARENA *) arg;
+	void *p = NULL;
+	int ok = 0;
+
+	p = PKI_Malloc(32);
+	ok = (PKI_ARENA_get_current() == NULL && p != NULL && !PKI_ARENA_owns(arena, p));
+	PKI_Free(p);
+
+	return ok ? NULL : arg;
+}
@@ -0,0 +1,392 @@
+#include <libpki/pki.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-Seven (27) - Remote Objects Cache"
+
+#define SLOW_CLIENTS	4
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+int subtest4();
+
+static void * _server(void *arg);
+static void * _slow_client(void *arg);
+static int _get(const char *path, PKI_MEM **data);
+
+static int srv_fd = -1;
+static int srv_port = 0;
+
+// Requests received for each path
+static int hits_cc = 0, hits_etag = 0, hits_304 = 0;
+static int hits_crl = 0, hits_none = 0, hits_slow = 0;
+
+static unsigned char *crl_der = NULL;
+static int crl_der_len = 0;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	PKI_THREAD *th = NULL;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// Local HTTP server
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((srv_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+			|| bind(srv_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+			|| listen(srv_fd, 16) != 0
+			|| getsockname(srv_fd, (struct sockaddr *) &addr, &addr_len) != 0
+			|| (th = PKI_THREAD_new(_server, NULL)) == NULL) {
+		printf("* %s: Can not start the local HTTP server.\n\n", test_name);
+		return 1;
+	}
+	srv_port = ntohs(addr.sin_port);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+		&& subtest4()
+	);
+
+	_get("/quit", NULL);
+	PKI_THREAD_join(th, NULL);
+	close(srv_fd);
+
+	OPENSSL_free(crl_der);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_MEM *a = NULL, *b = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 1: HTTP Freshness\n");
+
+	ok = (_get("/cc", &a) && _get("/cc", &b) && hits_cc == 1
+		&& a->size == b->size && memcmp(a->data, b->data, a->size) == 0);
+
+	if (a) PKI_MEM_free(a);
+	if (b) PKI_MEM_free(b);
+	a = b = NULL;
+
+	if (!ok) {
+		printf("     + Cache-Control max-age ...: Failed\n");
+		return 0;
+	}
+	printf("     + Cache-Control max-age ...: Ok\n");
+
+	// Revalidated with a conditional GET (304)
+	ok = (_get("/etag", &a) && _get("/etag", &b) && hits_etag == 2 && hits_304 == 1
+		&& a->size == b->size && memcmp(a->data, b->data, a->size) == 0);
+
+	if (a) PKI_MEM_free(a);
+	if (b) PKI_MEM_free(b);
+	a = b = NULL;
+
+	if (!ok) {
+		printf("     + ETag revalidation ...: Failed\n");
+		return 0;
+	}
+	printf("     + ETag revalidation ...: Ok\n");
+
+	// No freshness information, always retrieved
+	ok = (_get("/none", &a) && _get("/none", &b) && hits_none == 2);
+
+	if (a) PKI_MEM_free(a);
+	if (b) PKI_MEM_free(b);
+
+	if (!ok) {
+		printf("     + Uncacheable ...: Failed\n");
+		return 0;
+	}
+	printf("     + Uncacheable ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	X509_CRL *crl = NULL;
+	EVP_PKEY *pkey = NULL;
+	X509_NAME *name = NULL;
+	ASN1_TIME *t = NULL;
+	PKI_MEM *a = NULL, *b = NULL;
+	char buf[64];
+	int ok = 0;
+
+	printf("   - Subtest 2: CRL nextUpdate\n");
+
+	// CRL without HTTP caching headers, valid for one hour
+	pkey = EVP_EC_gen("P-256");
+	crl = X509_CRL_new();
+	name = X509_NAME_new();
+
+	if (pkey && crl && name
+			&& X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+				(const unsigned char *) "Cache CA", -1, -1, 0)
+			&& X509_CRL_set_issuer_name(crl, name)
+			&& (t = X509_time_adj_ex(NULL, 0, 0, NULL)) != NULL
+			&& X509_CRL_set1_lastUpdate(crl, t)
+			&& X509_time_adj_ex(t, 0, 3600, NULL) != NULL
+			&& X509_CRL_set1_nextUpdate(crl, t)
+			&& X509_CRL_sign(crl, pkey, EVP_sha256())) {
+		crl_der_len = i2d_X509_CRL(crl, &crl_der);
+	}
+
+	if (t) ASN1_TIME_free(t);
+	if (name) X509_NAME_free(name);
+	if (crl) X509_CRL_free(crl);
+	if (pkey) EVP_PKEY_free(pkey);
+
+	ok = (crl_der_len > 0 && _get("/crl", &a) && _get("/crl", &b) && hits_crl == 1
+		&& (int) b->size == crl_der_len && memcmp(b->data, crl_der, b->size) == 0);
+
+	if (a) PKI_MEM_free(a);
+	if (b) PKI_MEM_free(b);
+	a = NULL;
+
+	if (!ok) {
+		printf("     + CRL freshness ...: Failed\n");
+		return 0;
+	}
+	printf("     + CRL freshness ...: Ok\n");
+
+	// Invalidation
+	snprintf(buf, sizeof(buf), "http://127.0.0.1:%d/crl", srv_port);
+	ok = (URL_CACHE_invalidate(buf) == PKI_OK && _get("/crl", &a) && hits_crl == 2);
+	if (a) PKI_MEM_free(a);
+
+	if (!ok) {
+		printf("     + Invalidation ...: Failed\n");
+		return 0;
+	}
+	printf("     + Invalidation ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_THREAD *th[SLOW_CLIENTS];
+	void *ret = NULL;
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 3: Concurrent Requests\n");
+
+	for (i = 0; i < SLOW_CLIENTS; i++) th[i] = PKI_THREAD_new(_slow_client, NULL);
+
+	for (i = 0; i < SLOW_CLIENTS; i++) {
+		ret = NULL;
+		if (!th[i] || PKI_THREAD_join(th[i], &ret) != PKI_OK || !ret) ok = 0;
+	}
+
+	if (!ok || hits_slow != 1) {
+		printf("     + Single fetch ...: Failed (%d requests)\n", hits_slow);
+		return 0;
+	}
+	printf("     + Single fetch ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+int subtest4() {
+
+	char dir[] = "/tmp/libpki-cache-XXXXXX";
+	char buf[64];
+	PKI_MEM *a = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 4: Disk Cache\n");
+
+	if (mkdtemp(dir) == NULL || URL_CACHE_set_dir(dir) != PKI_OK) {
+		printf("     + Cache directory ...: Failed\n");
+		return 0;
+	}
+
+	// Stored on disk, then loaded after the memory flush
+	URL_CACHE_flush();
+	ok = (_get("/crl", &a) && hits_crl == 3);
+	if (a) PKI_MEM_free(a);
+	a = NULL;
+
+	URL_CACHE_flush();
+	ok = (ok && _get("/crl", &a) && hits_crl == 3
+		&& (int) a->size == crl_der_len && memcmp(a->data, crl_der, a->size) == 0);
+	if (a) PKI_MEM_free(a);
+	a = NULL;
+
+	if (!ok) {
+		printf("     + Disk tier ...: Failed\n");
+		return 0;
+	}
+	printf("     + Disk tier ...: Ok\n");
+
+	// Invalidation removes the stored entry
+	snprintf(buf, sizeof(buf), "http://127.0.0.1:%d/crl", srv_port);
+	ok = (URL_CACHE_invalidate(buf) == PKI_OK && _get("/crl", &a) && hits_crl == 4);
+	if (a) PKI_MEM_free(a);
+
+	URL_CACHE_invalidate(buf);
+	URL_CACHE_set_dir(NULL);
+	rmdir(dir);
+
+	if (!ok) {
+		printf("     + Disk invalidation ...: Failed\n");
+		return 0;
+	}
+	printf("     + Disk invalidation ...: Ok\n");
+
+	printf("   - Subtest 4: Passed\n\n");
+
+	return 1;
+}
+
+static int _get(const char *path, PKI_MEM **data) {
+
+	PKI_MEM_STACK *sk = NULL;
+	URL *url = NULL;
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "http://127.0.0.1:%d%s", srv_port, path);
+
+	if ((url = URL_new(buf)) == NULL) return 0;
+
+	sk = URL_get_data_url(url, 10, 0, NULL);
+	URL_free(url);
+
+	if (!sk) return 0;
+
+	if (data) *data = PKI_STACK_MEM_pop(sk);
+	PKI_STACK_MEM_free_all(sk);
+
+	return (!data || *data != NULL);
+}
+
+static void * _slow_client(void *arg) {
+
+	PKI_MEM *data = NULL;
+
+	if (!_get("/slow", &data)) return NULL;
+
+	PKI_MEM_free(data);
+
+	return (void *) 1;
+}
+
+static void _reply(int fd, const char *status, const char *headers,
+			const unsigned char *body, size_t body_len) {
+
+	char head[512];
+	int len = 0;
+
+	len = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Length: %lu\r\n"
+		"Connection: close\r\n%s\r\n", status, (unsigned long) body_len, headers);
+
+	if (write(fd, head, (size_t) len) != len) return;
+	if (body_len > 0 && write(fd, body, body_len) != (ssize_t) body_len) return;
+}
+
+static void * _server(void *arg) {
+
+	char req[2048];
+	const unsigned char *body = (const unsigned char *) "OpenCA Test Object";
+	size_t body_len = strlen((const char *) body);
+	ssize_t rv = 0;
+	size_t len = 0;
+	int fd = -1, quit = 0;
+
+	while (!quit && (fd = accept(srv_fd, NULL, NULL)) >= 0) {
+
+		// Reads the request headers
+		len = 0;
+		while (len < sizeof(req) - 1 && (rv = read(fd, req + len, sizeof(req) - 1 - len)) > 0) {
+			len += (size_t) rv;
+			req[len] = '\x0';
+			if (strstr(req, "\r\n\r\n")) break;
+		}
+		req[len] = '\x0';
+
+		if (strncmp(req, "GET /cc ", 8) == 0) {
+			hits_cc++;
+			_reply(fd, "200 OK", "Cache-Control: max-age=60\r\n", body, body_len);
+		} else if (strncmp(req, "GET /etag ", 10) == 0) {
+			hits_etag++;
+			if (strstr(req, "If-None-Match: \"v1\"")) {
+				hits_304++;
+				_reply(fd, "304 Not Modified", "ETag: \"v1\"\r\n", NULL, 0);
+			} else {
+				_reply(fd, "200 OK", "Cache-Control: no-cache\r\nETag: \"v1\"\r\n",
+					body, body_len);
+			}
+		} else if (strncmp(req, "GET /crl ", 9) == 0) {
+			hits_crl++;
+			_reply(fd, "200 OK", "", crl_der, (size_t) crl_der_len);
+		} else if (strncmp(req, "GET /none ", 10) == 0) {
+			hits_none++;
+			_reply(fd, "200 OK", "", body, body_len);
+		} else if (strncmp(req, "GET /slow ", 10) == 0) {
+			hits_slow++;
+			sleep(1);
+			_reply(fd, "200 OK", "Cache-Control: max-age=60\r\n", body, body_len);
+		} else {
+			quit = (strncmp(req, "GET /quit ", 10) == 0);
+			_reply(fd, "404 Not Found", "", NULL, 0);
+		}
+
+		close(fd);
+	}
+
+	return NULL;
+}
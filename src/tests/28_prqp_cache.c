@@ -0,0 +1,294 @@
+#include <libpki/pki.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-Eight (28) - PRQP Service Map Cache"
+
+// Lifetime of the PRQP responses (nextUpdate)
+#define RESP_SECS	5
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static void * _server(void *arg);
+static char * _lookup(void);
+
+static int srv_fd = -1;
+static int srv_port = 0;
+static char rqa_url[64];
+
+// PRQP requests received
+static int hits = 0;
+
+static PKI_X509_KEYPAIR *key = NULL;
+static PKI_X509_CERT *cacert = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	PKI_THREAD th;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// The PRQP OIDs are registered lazily, the server thread
+	// resolves its service OID by name before any PRQP call
+	PKI_init_subsystem(PKI_INIT_SUBSYSTEM_PRQP);
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	if ((key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 128, NULL, NULL, NULL)) == NULL
+			|| (cacert = PKI_X509_CERT_new(NULL, key, NULL, "CN=PRQP Test CA, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test credentials.\n\n", test_name);
+		return 1;
+	}
+
+	// Local PRQP server (HTTP)
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((srv_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+			|| bind(srv_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+			|| listen(srv_fd, 16) != 0
+			|| getsockname(srv_fd, (struct sockaddr *) &addr, &addr_len) != 0
+			|| PKI_THREAD_create(&th, NULL, _server, NULL) != 0) {
+		printf("* %s: Can not start the local PRQP server.\n\n", test_name);
+		return 1;
+	}
+	srv_port = ntohs(addr.sin_port);
+	snprintf(rqa_url, sizeof(rqa_url), "http://127.0.0.1:%d/prqp", srv_port);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	PKI_PRQP_CACHE_flush();
+
+	// Stops the server
+	shutdown(srv_fd, SHUT_RDWR);
+	PKI_THREAD_join(&th, NULL);
+	close(srv_fd);
+
+	PKI_X509_CERT_free(cacert);
+	PKI_X509_KEYPAIR_free(key);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	char *a = NULL, *b = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 1: Cached Lookups\n");
+
+	a = _lookup();
+	b = _lookup();
+
+	ok = (a && b && strcmp(a, "http://ca.openca.org/scep/1") == 0
+		&& strcmp(a, b) == 0 && hits == 1);
+
+	if (a) PKI_Free(a);
+	if (b) PKI_Free(b);
+
+	if (!ok) {
+		printf("     + Single discovery ...: Failed\n");
+		return 0;
+	}
+	printf("     + Single discovery ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	char *a = NULL;
+	int i = 0, ok = 0;
+
+	printf("   - Subtest 2: Background Refresh\n");
+
+	// The used entry is refreshed before the nextUpdate
+	for (i = 0; i < 4 * RESP_SECS && hits < 2; i++) usleep(250000);
+
+	a = _lookup();
+	ok = (a && strcmp(a, "http://ca.openca.org/scep/2") == 0 && hits == 2);
+
+	if (a) PKI_Free(a);
+
+	if (!ok) {
+		printf("     + Refresh ahead ...: Failed (%d requests)\n", hits);
+		return 0;
+	}
+	printf("     + Refresh ahead ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_STACK *services = NULL, *sk = NULL;
+	char *a = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 3: Invalidation\n");
+
+	ok = (PKI_PRQP_CACHE_invalidate(cacert) == PKI_OK
+		&& (a = _lookup()) != NULL && strcmp(a, "http://ca.openca.org/scep/3") == 0
+		&& hits == 3);
+
+	if (a) PKI_Free(a);
+
+	if (!ok) {
+		printf("     + Invalidation ...: Failed\n");
+		return 0;
+	}
+	printf("     + Invalidation ...: Ok\n");
+
+	// CA resources are served from the cache as well
+	ok = 0;
+	if ((services = PKI_STACK_new_null()) != NULL
+			&& PKI_STACK_push(services, strdup("scepGateway")) > 0
+			&& (sk = PKI_get_ca_resources(cacert, NULL, NULL, services, rqa_url)) != NULL) {
+		ok = (PKI_STACK_elements(sk) == 1
+			&& strcmp(PKI_STACK_get_num(sk, 0), "http://ca.openca.org/scep/3") == 0
+			&& hits == 3);
+	}
+
+	if (sk) PKI_STACK_free_all(sk);
+	if (services) PKI_STACK_free_all(services);
+
+	if (!ok) {
+		printf("     + CA resources ...: Failed\n");
+		return 0;
+	}
+	printf("     + CA resources ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+static char * _lookup(void) {
+
+	return PKI_get_ca_service(cacert, "scepGateway", rqa_url);
+}
+
+static void _reply(int fd, PKI_MEM *body) {
+
+	char head[256];
+	int len = 0;
+
+	len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\n"
+		"Content-Length: %lu\r\nConnection: close\r\n\r\n",
+		PKI_PRQP_RESP_CONTENT_TYPE, (unsigned long) body->size);
+
+	if (write(fd, head, (size_t) len) != len) return;
+	if (write(fd, body->data, body->size) != (ssize_t) body->size) return;
+}
+
+static void * _server(void *arg) {
+
+	PKI_X509_PRQP_REQ *req = NULL;
+	PKI_X509_PRQP_RESP *resp = NULL;
+	PKI_MEM *mem = NULL, *out = NULL;
+	PKI_OID *srv_oid = NULL;
+	char buf[8192], url_s[64];
+	char *body = NULL, *cl = NULL;
+	size_t len = 0, need = 0;
+	ssize_t rv = 0;
+	int fd = -1;
+
+	srv_oid = PKI_OID_get("scepGateway");
+
+	while ((fd = accept(srv_fd, NULL, NULL)) >= 0) {
+
+		// Reads the headers and the body (Content-Length)
+		len = 0;
+		need = 0;
+		body = NULL;
+		while (len < sizeof(buf) - 1 && (rv = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) {
+			len += (size_t) rv;
+			buf[len] = '\x0';
+			if (!body && (body = strstr(buf, "\r\n\r\n")) != NULL) {
+				body += 4;
+				if ((cl = strstr(buf, "Content-Length:")) != NULL) need = (size_t) atol(cl + 15);
+			}
+			if (body && len - (size_t) (body - buf) >= need) break;
+		}
+
+		req = NULL;
+		resp = NULL;
+		out = NULL;
+
+		if (body && (mem = PKI_MEM_new_data(len - (size_t) (body - buf),
+				(unsigned char *) body)) != NULL) {
+			req = PKI_X509_PRQP_REQ_get_mem(mem, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+			PKI_MEM_free(mem);
+		}
+
+		if (req && (resp = PKI_X509_PRQP_RESP_new_req(NULL, req,
+				PKI_X509_PRQP_STATUS_OK, RESP_SECS)) != NULL) {
+			hits++;
+			snprintf(url_s, sizeof(url_s), "http://ca.openca.org/scep/%d", hits);
+			PKI_X509_PRQP_RESP_add_service(resp, srv_oid,
+				url_s, 0, NULL, NULL);
+			out = PKI_X509_PRQP_RESP_put_mem(resp, PKI_DATA_FORMAT_ASN1, NULL, NULL, NULL);
+		}
+
+		if (out) _reply(fd, out);
+
+		if (out) PKI_MEM_free(out);
+		if (resp) PKI_X509_PRQP_RESP_free(resp);
+		if (req) PKI_X509_PRQP_REQ_free(req);
+
+		close(fd);
+	}
+
+	if (srv_oid) PKI_OID_free(srv_oid);
+
+	return NULL;
+}
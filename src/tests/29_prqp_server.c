@@ -0,0 +1,375 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Twenty-Nine (29) - Embedded PRQP Responder"
+
+// Concurrent HTTP clients (subtest 4)
+#define CLIENTS		4
+#define CLIENT_REQS	10
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+int subtest4();
+
+static PKI_X509_PRQP_RESP * _process(PKI_X509_CERT *ca, const char *service);
+static int _nonce_ok(PKI_X509_PRQP_REQ *req, PKI_X509_PRQP_RESP *resp);
+
+static PKI_PRQP_SERVER *prqp = NULL;
+static PKI_HTTP_SERVER *http = NULL;
+static char rqa_url[64];
+
+static PKI_X509_KEYPAIR *key = NULL;
+static PKI_X509_CERT *cacert = NULL;
+static PKI_X509_CERT *othercert = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	if ((key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 128, NULL, NULL, NULL)) == NULL
+			|| (cacert = PKI_X509_CERT_new(NULL, key, NULL, "CN=PRQP Test CA, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL
+			|| (othercert = PKI_X509_CERT_new(NULL, key, NULL, "CN=PRQP Other CA, O=OpenCA",
+				"2", 3600, NULL, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test credentials.\n\n", test_name);
+		return 1;
+	}
+
+	if ((prqp = PKI_PRQP_SERVER_new()) == NULL
+			|| PKI_PRQP_SERVER_set_signer(prqp, key, cacert, NULL, NULL) != PKI_OK) {
+		printf("* %s: Can not create the PRQP responder.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+		&& subtest4()
+	);
+
+	PKI_PRQP_CACHE_flush();
+
+	PKI_HTTP_SERVER_free(http);
+	PKI_PRQP_SERVER_free(prqp);
+
+	PKI_X509_CERT_free(othercert);
+	PKI_X509_CERT_free(cacert);
+	PKI_X509_KEYPAIR_free(key);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	char dir[] = "/tmp/libpki-prqp-XXXXXX";
+	char cert_s[128], conf_s[128];
+	FILE *fp = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 1: XML Configuration\n");
+
+	if (mkdtemp(dir) == NULL) {
+		printf("     + Configuration ...: Failed\n");
+		return 0;
+	}
+
+	snprintf(cert_s, sizeof(cert_s), "%s/cacert.pem", dir);
+	snprintf(conf_s, sizeof(conf_s), "%s/prqp.xml", dir);
+
+	if (PKI_X509_CERT_put(cacert, PKI_DATA_FORMAT_PEM, cert_s, NULL, NULL, NULL) == PKI_OK
+			&& (fp = fopen(conf_s, "w")) != NULL) {
+		fprintf(fp, "<?xml version=\"1.0\" ?>\n"
+			"<pki:prqpConfig xmlns:pki=\"http://www.openca.org/openca/pki/1/0/0\">\n"
+			"  <pki:validity>600</pki:validity>\n"
+			"  <pki:ca>\n"
+			"    <pki:caCert>file://%s</pki:caCert>\n"
+			"    <pki:service>\n"
+			"      <pki:name>scepGateway</pki:name>\n"
+			"      <pki:url>http://ca.openca.org/scep</pki:url>\n"
+			"      <pki:url>http://backup.openca.org/scep</pki:url>\n"
+			"    </pki:service>\n"
+			"    <pki:service>\n"
+			"      <pki:name>ocspServer</pki:name>\n"
+			"      <pki:url>http://ocsp.openca.org/</pki:url>\n"
+			"    </pki:service>\n"
+			"  </pki:ca>\n"
+			"</pki:prqpConfig>\n", cert_s);
+		fclose(fp);
+
+		ok = (PKI_PRQP_SERVER_load_config(prqp, conf_s, NULL) == PKI_OK);
+	}
+
+	unlink(conf_s);
+	unlink(cert_s);
+	rmdir(dir);
+
+	if (!ok) {
+		printf("     + Configuration ...: Failed\n");
+		return 0;
+	}
+	printf("     + Configuration ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return 1;
+}
+
+int subtest2() {
+
+	PKI_X509_PRQP_RESP *resp = NULL;
+	PKI_PRQP_RESP *val = NULL;
+	PRQP_SIGNATURE *psig = NULL;
+	RESOURCE_RESPONSE_TOKEN *tk = NULL;
+	PKI_MEM tbs = { NULL, 0 }, sig = { NULL, 0 };
+	int ok = 0, len = 0;
+
+	printf("   - Subtest 2: Signed Responses\n");
+
+	if ((resp = _process(cacert, "ocspServer")) == NULL) {
+		printf("     + Response ...: Failed\n");
+		return 0;
+	}
+
+	val = resp->value;
+	psig = val->prqpSignature;
+
+	// Only the requested service is returned
+	ok = (ASN1_INTEGER_get(val->respData->pkiStatus->status) == PKI_X509_PRQP_STATUS_OK
+		&& val->respData->nextUpdate != NULL
+		&& sk_RESOURCE_RESPONSE_TOKEN_num(val->respData->responseToken) == 1
+		&& (tk = sk_RESOURCE_RESPONSE_TOKEN_value(val->respData->responseToken, 0)) != NULL
+		&& OBJ_obj2nid(tk->resourceId) == OBJ_txt2nid("ocspServer")
+		&& sk_ASN1_IA5STRING_num(tk->resLocatorList) == 1);
+
+	if (!ok) {
+		printf("     + Selected services ...: Failed\n");
+		PKI_X509_PRQP_RESP_free(resp);
+		return 0;
+	}
+	printf("     + Selected services ...: Ok\n");
+
+	// The signature covers the TBSRespData
+	if (psig && psig->signature && (len = i2d_PRQP_TBS_RESP_DATA(val->respData,
+			&tbs.data)) > 0) {
+		tbs.size = (size_t) len;
+		sig.data = psig->signature->data;
+		sig.size = (size_t) psig->signature->length;
+		ok = (PKI_verify_signature(&tbs, &sig, psig->signatureAlgorithm, NULL, key) == PKI_OK
+			&& X509_cmp(psig->signerCert, cacert->value) == 0);
+	} else ok = 0;
+
+	if (tbs.data) OPENSSL_free(tbs.data);
+	PKI_X509_PRQP_RESP_free(resp);
+
+	if (!ok) {
+		printf("     + Signature ...: Failed\n");
+		return 0;
+	}
+	printf("     + Signature ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+int subtest3() {
+
+	PKI_X509_PRQP_RESP *resp = NULL;
+	PKI_PRQP_RESP *val = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 3: Unknown CA\n");
+
+	if ((resp = _process(othercert, NULL)) != NULL) {
+		val = resp->value;
+		ok = (ASN1_INTEGER_get(val->respData->pkiStatus->status)
+				== PKI_X509_PRQP_STATUS_CA_NOT_PRESENT
+			&& sk_RESOURCE_RESPONSE_TOKEN_num(val->respData->responseToken) <= 0);
+		PKI_X509_PRQP_RESP_free(resp);
+	}
+
+	if (!ok) {
+		printf("     + CA not present ...: Failed\n");
+		return 0;
+	}
+	printf("     + CA not present ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return 1;
+}
+
+static void * _client(void *arg) {
+
+	PKI_X509_PRQP_REQ *req = NULL;
+	PKI_X509_PRQP_RESP *resp = NULL;
+	PKI_STACK *sk = NULL;
+	int i = 0, *ok = arg;
+
+	for (i = 0; i < CLIENT_REQS; i++) {
+
+		sk = PKI_STACK_new_null();
+		PKI_STACK_push(sk, strdup("scepGateway"));
+
+		req = PKI_X509_PRQP_REQ_new_certs_res(cacert, NULL, NULL, sk);
+		resp = req ? PKI_DISCOVER_get_resp(req, rqa_url) : NULL;
+
+		if (resp && _nonce_ok(req, resp)) (*ok)++;
+
+		if (resp) PKI_X509_PRQP_RESP_free(resp);
+		if (req) PKI_X509_PRQP_REQ_free(req);
+		PKI_STACK_free_all(sk);
+	}
+
+	return NULL;
+}
+
+int subtest4() {
+
+	PKI_THREAD th[CLIENTS];
+	PKI_STACK *sk = NULL;
+	char url_s[64];
+	int ok[CLIENTS];
+	int i = 0, total = 0;
+
+	printf("   - Subtest 4: HTTP Listener\n");
+
+	if ((http = PKI_HTTP_SERVER_new("127.0.0.1", 0, 2)) == NULL
+			|| PKI_PRQP_SERVER_attach(prqp, http, "/prqp") != PKI_OK
+			|| PKI_HTTP_SERVER_start(http) != PKI_OK) {
+		printf("     + Server start ...: Failed\n");
+		return 0;
+	}
+	snprintf(rqa_url, sizeof(rqa_url), "http://127.0.0.1:%d/prqp",
+		PKI_HTTP_SERVER_get_port(http));
+
+	// Client lookup
+	sk = PKI_get_ca_service_sk(cacert, "scepGateway", rqa_url);
+	if (!sk || PKI_STACK_elements(sk) != 2
+			|| strcmp(PKI_STACK_get_num(sk, 0), "http://ca.openca.org/scep") != 0
+			|| strcmp(PKI_STACK_get_num(sk, 1), "http://backup.openca.org/scep") != 0) {
+		printf("     + Service lookup ...: Failed\n");
+		if (sk) PKI_STACK_free_all(sk);
+		return 0;
+	}
+	PKI_STACK_free_all(sk);
+	printf("     + Service lookup ...: Ok\n");
+
+	// Unknown paths are not served
+	snprintf(url_s, sizeof(url_s), "http://127.0.0.1:%d/none",
+		PKI_HTTP_SERVER_get_port(http));
+	if ((sk = PKI_get_ca_resources(othercert, NULL, NULL, NULL, url_s)) != NULL) {
+		printf("     + Unknown path ...: Failed\n");
+		PKI_STACK_free_all(sk);
+		return 0;
+	}
+	printf("     + Unknown path ...: Ok\n");
+
+	// Concurrent clients
+	for (i = 0; i < CLIENTS; i++) {
+		ok[i] = 0;
+		if (PKI_THREAD_create(&th[i], NULL, _client, &ok[i]) != 0) {
+			printf("     + Concurrent clients ...: Failed\n");
+			return 0;
+		}
+	}
+	for (i = 0; i < CLIENTS; i++) {
+		PKI_THREAD_join(&th[i], NULL);
+		total += ok[i];
+	}
+
+	if (total != CLIENTS * CLIENT_REQS) {
+		printf("     + Concurrent clients ...: Failed (%d/%d)\n",
+			total, CLIENTS * CLIENT_REQS);
+		return 0;
+	}
+	printf("     + Concurrent clients ...: Ok\n");
+
+	if (PKI_HTTP_SERVER_stop(http) != PKI_OK) {
+		printf("     + Server stop ...: Failed\n");
+		return 0;
+	}
+	printf("     + Server stop ...: Ok\n");
+
+	printf("   - Subtest 4: Passed\n\n");
+
+	return 1;
+}
+
+static int _nonce_ok(PKI_X509_PRQP_REQ *req, PKI_X509_PRQP_RESP *resp) {
+
+	PKI_PRQP_REQ *rq = req->value;
+	PKI_PRQP_RESP *rs = resp->value;
+
+	if (!rq->requestData->nonce || !rs->respData->nonce) return 0;
+
+	return ASN1_INTEGER_cmp(rq->requestData->nonce, rs->respData->nonce) == 0;
+}
+
+static PKI_X509_PRQP_RESP * _process(PKI_X509_CERT *ca, const char *service) {
+
+	PKI_X509_PRQP_REQ *req = NULL;
+	PKI_X509_PRQP_RESP *resp = NULL;
+	PKI_MEM *der = NULL, *out = NULL;
+	PKI_STACK *sk = NULL;
+
+	// No services requested: all the services of the CA are returned
+	sk = PKI_STACK_new_null();
+	if (service) PKI_STACK_push(sk, strdup(service));
+
+	if ((req = PKI_X509_PRQP_REQ_new_certs_res(ca, NULL, NULL, sk)) != NULL
+			&& (der = PKI_X509_PRQP_REQ_put_mem(req, PKI_DATA_FORMAT_ASN1,
+				NULL, NULL, NULL)) != NULL
+			&& (out = PKI_PRQP_SERVER_process(prqp, der)) != NULL) {
+		resp = PKI_X509_PRQP_RESP_get_mem(out, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+	}
+
+	// The nonce of the request is returned
+	if (resp && !_nonce_ok(req, resp)) {
+		PKI_X509_PRQP_RESP_free(resp);
+		resp = NULL;
+	}
+
+	if (out) PKI_MEM_free(out);
+	if (der) PKI_MEM_free(der);
+	if (req) PKI_X509_PRQP_REQ_free(req);
+	if (sk) PKI_STACK_free_all(sk);
+
+	return resp;
+}
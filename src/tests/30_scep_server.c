@@ -0,0 +1,487 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Thirty (30) - SCEP Server Pipeline"
+
+// Concurrent HTTP clients (subtest 3)
+#define CLIENTS		4
+#define CLIENT_REQS	5
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static PKI_MEM * _certreq(const char *subject, PKI_X509_CERT **signer);
+static PKI_X509_PKCS7 * _certrep(PKI_MEM *out, PKI_MEM *req);
+static PKI_X509_CERT * _issued(PKI_X509_PKCS7 *rep, PKI_X509_CERT *signer);
+
+static SCEP_STATUS _issue_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *signer,
+		SCEP_MESSAGE_TYPE type, const char *trans_id, PKI_X509_CERT **issued,
+		SCEP_FAILURE *fail, void *ctx);
+
+static PKI_SCEP_SERVER *scep = NULL;
+static PKI_HTTP_SERVER *http = NULL;
+static char scep_url[64];
+
+static PKI_X509_KEYPAIR *rakey = NULL;
+static PKI_X509_CERT *racert = NULL;
+static PKI_X509_KEYPAIR *clikey = NULL;
+
+static int serial = 0;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	if ((rakey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (clikey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (racert = PKI_X509_CERT_new(NULL, rakey, NULL, "CN=SCEP Test RA, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test credentials.\n\n", test_name);
+		return 1;
+	}
+
+	if ((scep = PKI_SCEP_SERVER_new()) == NULL
+			|| PKI_SCEP_SERVER_set_ra(scep, rakey, racert, NULL, NULL) != PKI_OK
+			|| PKI_SCEP_SERVER_set_issue_cb(scep, _issue_cb, NULL) != PKI_OK) {
+		printf("* %s: Can not create the SCEP server.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	PKI_HTTP_SERVER_free(http);
+	PKI_SCEP_SERVER_free(scep);
+
+	PKI_X509_CERT_free(racert);
+	PKI_X509_KEYPAIR_free(clikey);
+	PKI_X509_KEYPAIR_free(rakey);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_MEM *req = NULL, *out = NULL;
+	PKI_X509_CERT *signer = NULL, *x = NULL;
+	PKI_X509_PKCS7 *rep = NULL;
+	char *subject = NULL, *issuer = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 1: Enrollment (PKCSReq)\n");
+
+	if ((req = _certreq("CN=device-1, O=OpenCA", &signer)) != NULL
+			&& (out = PKI_SCEP_SERVER_process(scep, req)) != NULL
+			&& (rep = _certrep(out, req)) != NULL) {
+		ok = (PKI_X509_SCEP_MSG_get_status(rep) == SCEP_STATUS_SUCCESS);
+	}
+
+	if (!ok) {
+		printf("     + CertRep ...: Failed\n");
+		goto end;
+	}
+	printf("     + CertRep ...: Ok\n");
+
+	// Issued certificate (encrypted for the signer of the request)
+	ok = 0;
+	if ((x = _issued(rep, signer)) != NULL) {
+		subject = PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_SUBJECT);
+		issuer = PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_ISSUER);
+		ok = (subject && issuer && strstr(subject, "CN=device-1") != NULL
+			&& strstr(issuer, "CN=SCEP Test RA") != NULL);
+	}
+
+	if (!ok) {
+		printf("     + Issued certificate ...: Failed\n");
+		goto end;
+	}
+	printf("     + Issued certificate ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+end:
+	if (subject) PKI_Free(subject);
+	if (issuer) PKI_Free(issuer);
+	if (x) PKI_X509_CERT_free(x);
+	if (rep) PKI_X509_PKCS7_free(rep);
+	if (signer) PKI_X509_CERT_free(signer);
+	if (out) PKI_MEM_free(out);
+	if (req) PKI_MEM_free(req);
+
+	return ok;
+}
+
+int subtest2() {
+
+	PKI_MEM *req = NULL, *out = NULL;
+	PKI_X509_CERT *signer = NULL;
+	PKI_X509_PKCS7 *rep = NULL;
+	PKI_MEM junk = { (unsigned char *) "not a scep message", 18 };
+	int ok = 0;
+
+	printf("   - Subtest 2: Failures\n");
+
+	// Rejected by the issuance callback
+	if ((req = _certreq("CN=reject, O=OpenCA", &signer)) != NULL
+			&& (out = PKI_SCEP_SERVER_process(scep, req)) != NULL
+			&& (rep = _certrep(out, req)) != NULL) {
+		ok = (PKI_X509_SCEP_MSG_get_status(rep) == SCEP_STATUS_FAILURE
+			&& PKI_X509_SCEP_MSG_get_failinfo(rep) == SCEP_FAILURE_BADREQUEST
+			&& PKI_X509_PKCS7_get_recipients_num(rep) <= 0);
+	}
+
+	if (rep) PKI_X509_PKCS7_free(rep);
+	if (signer) PKI_X509_CERT_free(signer);
+	if (out) PKI_MEM_free(out);
+	if (req) PKI_MEM_free(req);
+
+	if (!ok) {
+		printf("     + Rejected request ...: Failed\n");
+		return 0;
+	}
+	printf("     + Rejected request ...: Ok\n");
+
+	// Not a SCEP message
+	if ((out = PKI_SCEP_SERVER_process(scep, &junk)) != NULL) {
+		PKI_MEM_free(out);
+		printf("     + Malformed request ...: Failed\n");
+		return 0;
+	}
+	printf("     + Malformed request ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return 1;
+}
+
+static void * _client(void *arg) {
+
+	PKI_MEM *req = arg;
+	PKI_MEM_STACK *sk = NULL;
+	PKI_MEM *out = NULL;
+	PKI_X509_PKCS7 *rep = NULL;
+	char url_s[128];
+	int i = 0;
+	intptr_t ok = 0;
+
+	snprintf(url_s, sizeof(url_s), "%s?operation=PKIOperation", scep_url);
+
+	for (i = 0; i < CLIENT_REQS; i++) {
+
+		sk = NULL;
+		if (PKI_HTTP_POST_data(url_s, (const char *) req->data, req->size,
+				PKI_SCEP_SERVER_TYPE_MESSAGE, 30, 0, &sk, NULL) == PKI_OK
+				&& sk && (out = PKI_STACK_MEM_pop(sk)) != NULL
+				&& (rep = _certrep(out, req)) != NULL
+				&& PKI_X509_SCEP_MSG_get_status(rep) == SCEP_STATUS_SUCCESS) ok++;
+
+		if (rep) PKI_X509_PKCS7_free(rep);
+		if (out) PKI_MEM_free(out);
+		if (sk) PKI_STACK_MEM_free_all(sk);
+		rep = NULL;
+		out = NULL;
+	}
+
+	return (void *) ok;
+}
+
+int subtest3() {
+
+	PKI_THREAD th[CLIENTS];
+	PKI_SCEP_SERVER_STATS st;
+	PKI_MEM_STACK *sk = NULL;
+	PKI_MEM *req = NULL, *msg = NULL, *out = NULL;
+	PKI_X509_CERT *signer = NULL, *x = NULL;
+	PKI_X509_PKCS7 *p7 = NULL, *rep = NULL;
+	char url_s[16384];
+	void *ret = NULL;
+	int i = 0, total = 0, ok = 0;
+
+	printf("   - Subtest 3: HTTP Operations\n");
+
+	PKI_SCEP_SERVER_reset_stats(scep);
+
+	if ((http = PKI_HTTP_SERVER_new("127.0.0.1", 0, 4)) == NULL
+			|| PKI_SCEP_SERVER_attach(scep, http, "/scep") != PKI_OK
+			|| PKI_HTTP_SERVER_start(http) != PKI_OK) {
+		printf("     + Server start ...: Failed\n");
+		return 0;
+	}
+	snprintf(scep_url, sizeof(scep_url), "http://127.0.0.1:%d/scep",
+		PKI_HTTP_SERVER_get_port(http));
+
+	// GetCACaps and GetCACert
+	snprintf(url_s, sizeof(url_s), "%s?operation=GetCACaps", scep_url);
+	if (PKI_HTTP_GET_data(url_s, 30, 0, &sk, NULL) == PKI_OK && sk
+			&& (out = PKI_STACK_MEM_pop(sk)) != NULL) {
+		ok = (out->size == strlen(PKI_SCEP_SERVER_CAPS)
+			&& memcmp(out->data, PKI_SCEP_SERVER_CAPS, out->size) == 0);
+	}
+	if (out) PKI_MEM_free(out);
+	if (sk) PKI_STACK_MEM_free_all(sk);
+	out = NULL;
+	sk = NULL;
+
+	if (ok) {
+		ok = 0;
+		snprintf(url_s, sizeof(url_s), "%s?operation=GetCACert&message=", scep_url);
+		if (PKI_HTTP_GET_data(url_s, 30, 0, &sk, NULL) == PKI_OK && sk
+				&& (out = PKI_STACK_MEM_pop(sk)) != NULL
+				&& (p7 = PKI_X509_PKCS7_get_mem(out, PKI_DATA_FORMAT_ASN1, NULL)) != NULL
+				&& (x = PKI_X509_PKCS7_get_cert(p7, 0)) != NULL) {
+			ok = (X509_cmp(x->value, racert->value) == 0);
+		}
+		if (x) PKI_X509_CERT_free(x);
+		if (p7) PKI_X509_PKCS7_free(p7);
+		if (out) PKI_MEM_free(out);
+		if (sk) PKI_STACK_MEM_free_all(sk);
+		out = NULL;
+		sk = NULL;
+	}
+
+	if (!ok) {
+		printf("     + GetCACaps / GetCACert ...: Failed\n");
+		return 0;
+	}
+	printf("     + GetCACaps / GetCACert ...: Ok\n");
+
+	if ((req = _certreq("CN=device-2, O=OpenCA", &signer)) == NULL) {
+		printf("     + PKIOperation (GET) ...: Failed\n");
+		return 0;
+	}
+
+	// PKIOperation with the message in the query (as sent by the client)
+	ok = 0;
+	if ((msg = PKI_MEM_new_data(req->size, req->data)) != NULL
+			&& PKI_MEM_encode(msg, PKI_DATA_FORMAT_B64, 0) == PKI_OK
+			&& PKI_MEM_encode(msg, PKI_DATA_FORMAT_URL, 1) == PKI_OK) {
+		snprintf(url_s, sizeof(url_s), "%s?operation=PKIOperation&message=%.*s",
+			scep_url, (int) msg->size, msg->data);
+		if (PKI_HTTP_GET_data(url_s, 30, 0, &sk, NULL) == PKI_OK && sk
+				&& (out = PKI_STACK_MEM_pop(sk)) != NULL
+				&& (rep = _certrep(out, req)) != NULL
+				&& (x = _issued(rep, signer)) != NULL) ok = 1;
+	}
+	if (x) PKI_X509_CERT_free(x);
+	if (rep) PKI_X509_PKCS7_free(rep);
+	if (out) PKI_MEM_free(out);
+	if (msg) PKI_MEM_free(msg);
+	if (sk) PKI_STACK_MEM_free_all(sk);
+
+	if (!ok) {
+		printf("     + PKIOperation (GET) ...: Failed\n");
+		goto end;
+	}
+	printf("     + PKIOperation (GET) ...: Ok\n");
+
+	// Concurrent POST clients
+	for (i = 0; i < CLIENTS; i++) {
+		if (PKI_THREAD_create(&th[i], NULL, _client, req) != 0) {
+			printf("     + Concurrent clients ...: Failed\n");
+			ok = 0;
+			goto end;
+		}
+	}
+	for (i = 0; i < CLIENTS; i++) {
+		PKI_THREAD_join(&th[i], &ret);
+		total += (int) (intptr_t) ret;
+	}
+
+	if ((ok = (total == CLIENTS * CLIENT_REQS)) == 0) {
+		printf("     + Concurrent clients ...: Failed (%d/%d)\n",
+			total, CLIENTS * CLIENT_REQS);
+		goto end;
+	}
+	printf("     + Concurrent clients ...: Ok\n");
+
+	// Per-stage counters
+	ok = (PKI_SCEP_SERVER_get_stats(scep, &st) == PKI_OK
+		&& st.requests == (uint64_t) (1 + CLIENTS * CLIENT_REQS)
+		&& st.success == st.requests && st.errors == 0);
+	for (i = 0; ok && i < PKI_SCEP_SERVER_STAGE_NUM; i++) {
+		ok = (st.stage_count[i] == st.requests && st.stage_ns[i] > 0
+			&& st.stage_max_ns[i] > 0);
+	}
+
+	if (!ok) {
+		printf("     + Stage counters ...: Failed\n");
+		goto end;
+	}
+	printf("     + Stage counters ...: Ok\n");
+
+	if ((ok = (PKI_HTTP_SERVER_stop(http) == PKI_OK)) == 0) {
+		printf("     + Server stop ...: Failed\n");
+		goto end;
+	}
+	printf("     + Server stop ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+end:
+	if (signer) PKI_X509_CERT_free(signer);
+	if (req) PKI_MEM_free(req);
+
+	return ok;
+}
+
+// Issues the requests, except the ones for CN=reject
+static SCEP_STATUS _issue_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *signer,
+		SCEP_MESSAGE_TYPE type, const char *trans_id, PKI_X509_CERT **issued,
+		SCEP_FAILURE *fail, void *ctx) {
+
+	char *subject = NULL;
+	char serial_s[16];
+	int reject = 0;
+
+	if (!req || type != PKI_X509_SCEP_MSG_PKCSREQ || !trans_id || !signer)
+		return SCEP_STATUS_FAILURE;
+
+	if ((subject = (char *) PKI_X509_REQ_get_parsed(req, PKI_X509_DATA_SUBJECT)) != NULL) {
+		reject = (strstr(subject, "CN=reject") != NULL);
+		PKI_Free(subject);
+	}
+
+	if (reject) {
+		*fail = SCEP_FAILURE_BADREQUEST;
+		return SCEP_STATUS_FAILURE;
+	}
+
+	snprintf(serial_s, sizeof(serial_s), "%d",
+		__atomic_add_fetch(&serial, 1, __ATOMIC_RELAXED) + 1);
+
+	if ((*issued = PKI_X509_CERT_new(racert, rakey, req, NULL, serial_s,
+			3600, NULL, NULL, NULL, NULL)) == NULL) return SCEP_STATUS_FAILURE;
+
+	return SCEP_STATUS_SUCCESS;
+}
+
+// PKCSReq from the client side API (DER)
+static PKI_MEM * _certreq(const char *subject, PKI_X509_CERT **signer) {
+
+	PKI_X509_REQ *req = NULL;
+	PKI_X509_CERT_STACK *recipients = NULL;
+	PKI_X509_SCEP_MSG *msg = NULL;
+	PKI_MEM *ret = NULL;
+
+	*signer = NULL;
+
+	if ((req = PKI_X509_REQ_new(clikey, subject, NULL, NULL,
+			PKI_DIGEST_ALG_SHA256, NULL)) == NULL
+			|| (*signer = PKI_X509_CERT_new(NULL, clikey, req, NULL, "1",
+				3600, NULL, NULL, NULL, NULL)) == NULL
+			|| (recipients = PKI_STACK_X509_CERT_new()) == NULL) goto end;
+
+	PKI_STACK_X509_CERT_push(recipients, racert);
+
+	if ((msg = PKI_X509_SCEP_MSG_new_certreq(clikey, req, *signer,
+			recipients, NULL)) != NULL)
+		ret = PKI_X509_put_mem(msg, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+
+end:
+	if (msg) PKI_X509_SCEP_MSG_free(msg);
+	if (recipients) PKI_STACK_X509_CERT_free(recipients);
+	if (req) PKI_X509_REQ_free(req);
+
+	return ret;
+}
+
+// Parses the CertRep and checks signature, transId and nonces
+static PKI_X509_PKCS7 * _certrep(PKI_MEM *out, PKI_MEM *req) {
+
+	PKI_X509_PKCS7 *rep = NULL, *p7 = NULL;
+	PKI_MEM *a = NULL, *b = NULL;
+	char *tid_a = NULL, *tid_b = NULL;
+	BIO *bio = NULL;
+	int ok = 0;
+
+	if ((rep = PKI_X509_PKCS7_get_mem(out, PKI_DATA_FORMAT_ASN1, NULL)) == NULL
+			|| (p7 = PKI_X509_PKCS7_get_mem(req, PKI_DATA_FORMAT_ASN1, NULL)) == NULL)
+		goto end;
+
+	// Signed by the RA
+	if ((bio = BIO_new(BIO_s_null())) == NULL
+			|| PKCS7_verify(rep->value, NULL, NULL, NULL, bio, PKCS7_NOVERIFY) != 1
+			|| PKI_X509_SCEP_MSG_get_type(rep) != PKI_X509_SCEP_MSG_CERTREP) goto end;
+
+	// The transId is echoed and the senderNonce is returned as recipientNonce
+	tid_a = PKI_X509_SCEP_MSG_get_trans_id(rep);
+	tid_b = PKI_X509_SCEP_MSG_get_trans_id(p7);
+	a = PKI_X509_SCEP_MSG_get_recipient_nonce(rep);
+	b = PKI_X509_SCEP_MSG_get_sender_nonce(p7);
+
+	ok = (tid_a && tid_b && strcmp(tid_a, tid_b) == 0 && a && b
+		&& a->size == b->size && memcmp(a->data, b->data, a->size) == 0);
+
+end:
+	if (bio) BIO_free(bio);
+	if (a) PKI_MEM_free(a);
+	if (b) PKI_MEM_free(b);
+	if (tid_a) PKI_Free(tid_a);
+	if (tid_b) PKI_Free(tid_b);
+	if (p7) PKI_X509_PKCS7_free(p7);
+	if (!ok && rep) {
+		PKI_X509_PKCS7_free(rep);
+		rep = NULL;
+	}
+
+	return rep;
+}
+
+// Decrypts the CertRep content and returns the issued certificate
+static PKI_X509_CERT * _issued(PKI_X509_PKCS7 *rep, PKI_X509_CERT *signer) {
+
+	PKI_X509_PKCS7 *env = NULL, *certs = NULL;
+	PKI_MEM *der = NULL, *inner = NULL;
+	PKI_X509_CERT *ret = NULL;
+
+	if ((der = PKI_X509_PKCS7_get_raw_data(rep)) != NULL
+			&& (env = PKI_X509_PKCS7_get_mem(der, PKI_DATA_FORMAT_ASN1, NULL)) != NULL
+			&& (inner = PKI_X509_PKCS7_decode(env, clikey, signer)) != NULL
+			&& (certs = PKI_X509_PKCS7_get_mem(inner, PKI_DATA_FORMAT_ASN1, NULL)) != NULL)
+		ret = PKI_X509_PKCS7_get_cert(certs, 0);
+
+	if (certs) PKI_X509_PKCS7_free(certs);
+	if (inner) PKI_MEM_free(inner);
+	if (env) PKI_X509_PKCS7_free(env);
+	if (der) PKI_MEM_free(der);
+
+	return ret;
+}
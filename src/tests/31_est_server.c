@@ -0,0 +1,632 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Thirty-One (31) - EST Server"
+
+// Requests of the bulk enrollments
+#define BATCH_REQS	20
+
+// Requests of the large bulkenroll
+#define BULK_REQS	600
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static PKI_X509_REQ * _csr(const char *subject);
+static PKI_MEM * _csr_der(const char *subject);
+static PKI_MEM * _request(const char *op, PKI_MEM *body, PKI_TOKEN *tk);
+static PKI_MEM * _bulk_request(PKI_MEM *body, char **status);
+static PKI_X509_PKCS7 * _certs(PKI_MEM *body);
+static int _certs_num(PKI_MEM *body, const char *subject);
+
+static int _auth_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *peer,
+		PKI_EST_SERVER_OP op, void *ctx);
+
+static PKI_EST_SERVER *est = NULL;
+static PKI_HTTP_SERVER *http = NULL;
+static char est_url[64];
+
+static PKI_X509_KEYPAIR *cakey = NULL;
+static PKI_X509_CERT *cacert = NULL;
+static PKI_X509_KEYPAIR *clikey = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_PROFILE *prof = NULL;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// The CA certificate needs the basicConstraints to verify TLS clients
+	if ((prof = PKI_X509_PROFILE_new("ca")) == NULL
+			|| PKI_X509_PROFILE_add_extension(prof, "basicConstraints",
+				"TRUE", "CA", 1) == NULL
+			|| (cakey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (clikey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (cacert = PKI_X509_CERT_new(NULL, cakey, NULL, "CN=EST Test CA, O=OpenCA",
+				"1", 3600, prof, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test credentials.\n\n", test_name);
+		return 1;
+	}
+	PKI_X509_PROFILE_free(prof);
+
+	if ((est = PKI_EST_SERVER_new()) == NULL
+			|| PKI_EST_SERVER_set_ca(est, cakey, cacert, NULL) != PKI_OK
+			|| PKI_EST_SERVER_set_profile(est, NULL, 3600) != PKI_OK
+			|| PKI_EST_SERVER_set_auth_cb(est, _auth_cb, NULL) != PKI_OK
+			|| PKI_EST_SERVER_set_threads(est, 4) != PKI_OK) {
+		printf("* %s: Can not create the EST server.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	PKI_HTTP_SERVER_free(http);
+	PKI_EST_SERVER_free(est);
+
+	PKI_X509_CERT_free(cacert);
+	PKI_X509_KEYPAIR_free(clikey);
+	PKI_X509_KEYPAIR_free(cakey);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_X509_REQ *req = NULL;
+	PKI_X509_CERT *x = NULL, *y = NULL;
+	PKI_MEM *certs = NULL;
+	char *subject = NULL, *issuer = NULL;
+	int ok = 0;
+
+	printf("   - Subtest 1: Enrollment\n");
+
+	// CA certificates
+	if ((certs = PKI_EST_SERVER_get_ca_certs(est)) != NULL)
+		ok = (_certs_num(certs, "CN=EST Test CA") == 1);
+	if (certs) PKI_MEM_free(certs);
+
+	if (!ok) {
+		printf("     + CA certificates ...: Failed\n");
+		return 0;
+	}
+	printf("     + CA certificates ...: Ok\n");
+
+	// Issued by the CA
+	ok = 0;
+	if ((req = _csr("CN=device-1, O=OpenCA")) != NULL
+			&& (x = PKI_EST_SERVER_enroll(est, req, NULL, 0)) != NULL) {
+		subject = PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_SUBJECT);
+		issuer = PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_ISSUER);
+		ok = (subject && issuer && strstr(subject, "CN=device-1") != NULL
+			&& strstr(issuer, "CN=EST Test CA") != NULL
+			&& X509_verify(x->value, X509_get0_pubkey(cacert->value)) == 1);
+	}
+
+	if (!ok) {
+		printf("     + Simple enrollment ...: Failed\n");
+		goto end;
+	}
+	printf("     + Simple enrollment ...: Ok\n");
+
+	// Renewals need the certificate being renewed
+	ok = ((y = PKI_EST_SERVER_enroll(est, req, NULL, 1)) == NULL
+		&& (y = PKI_EST_SERVER_enroll(est, req, x, 1)) != NULL);
+
+	if (!ok) {
+		printf("     + Re-enrollment ...: Failed\n");
+		goto end;
+	}
+	printf("     + Re-enrollment ...: Ok\n");
+
+	// Rejected by the authorization callback
+	PKI_X509_REQ_free(req);
+	if ((ok = ((req = _csr("CN=reject, O=OpenCA")) != NULL
+			&& PKI_EST_SERVER_enroll(est, req, NULL, 0) == NULL)) == 0) {
+		printf("     + Rejected request ...: Failed\n");
+		goto end;
+	}
+	printf("     + Rejected request ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+end:
+	if (subject) PKI_Free(subject);
+	if (issuer) PKI_Free(issuer);
+	if (y) PKI_X509_CERT_free(y);
+	if (x) PKI_X509_CERT_free(x);
+	if (req) PKI_X509_REQ_free(req);
+
+	return ok;
+}
+
+int subtest2() {
+
+	PKI_X509_REQ_STACK *reqs = NULL;
+	PKI_X509_CERT_STACK *sk = NULL;
+	PKI_X509_REQ *req = NULL;
+	PKI_X509_CERT *x = NULL;
+	char subject_s[64];
+	char *subject = NULL;
+	int status[BATCH_REQS];
+	int i = 0, num = 0, rejected = 0, ok = 0;
+
+	printf("   - Subtest 2: Batch Enrollment\n");
+
+	if ((reqs = PKI_STACK_X509_REQ_new()) == NULL) return 0;
+
+	// Every fifth request is rejected
+	for (i = 0; i < BATCH_REQS; i++) {
+		snprintf(subject_s, sizeof(subject_s), "CN=%s-%d, O=OpenCA",
+			i % 5 == 4 ? "reject" : "batch", i);
+		if ((req = _csr(subject_s)) == NULL) goto end;
+		PKI_STACK_X509_REQ_push(reqs, req);
+	}
+
+	if ((sk = PKI_EST_SERVER_enroll_batch(est, reqs, NULL, &rejected, status)) != NULL
+			&& (num = PKI_STACK_X509_CERT_elements(sk)) == BATCH_REQS - BATCH_REQS / 5
+			&& rejected == BATCH_REQS / 5) {
+
+		// The status is reported for every request
+		for (ok = 1, i = 0; ok && i < BATCH_REQS; i++) ok = (status[i] == (i % 5 != 4));
+
+		// Certificates are in the order of the requests
+		for (i = 0; ok && i < num; i++) {
+			x = PKI_STACK_X509_CERT_get_num(sk, i);
+			snprintf(subject_s, sizeof(subject_s), "CN=batch-%d,", i + i / 4);
+			subject = PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_SUBJECT);
+			ok = (subject && strstr(subject, subject_s) != NULL);
+			if (subject) PKI_Free(subject);
+		}
+	}
+
+	if (!ok) {
+		printf("     + Issued certificates ...: Failed (%d/%d)\n", num, BATCH_REQS);
+		goto end;
+	}
+	printf("     + Issued certificates ...: Ok\n");
+	printf("     + Rejected requests ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+end:
+	if (sk) PKI_STACK_X509_CERT_free_all(sk);
+	if (reqs) PKI_STACK_X509_free_all(reqs);
+
+	return ok;
+}
+
+int subtest3() {
+
+	PKI_KEYPAIR_POOL *pool = NULL;
+	PKI_X509_KEYPAIR *srvkey = NULL;
+	PKI_X509_CERT *srvcert = NULL, *x = NULL;
+	PKI_X509_CERT_STACK *trusted = NULL;
+	PKI_X509_REQ *req = NULL;
+	PKI_EST_SERVER_STATS st;
+	PKI_TOKEN *tk = NULL;
+	PKI_X509_PKCS7 *p7 = NULL;
+	PKI_MEM *body = NULL, *out = NULL, *der = NULL;
+	char status_s[2 * BATCH_REQS + 16];
+	char *status = NULL;
+	char subject_s[64];
+	int i = 0, ok = 0;
+
+	printf("   - Subtest 3: HTTPS Operations\n");
+
+	PKI_EST_SERVER_reset_stats(est);
+
+	// Server keys are taken from the pool
+	if ((pool = PKI_KEYPAIR_POOL_new(1)) == NULL
+			|| PKI_KEYPAIR_POOL_add_scheme(pool, PKI_SCHEME_ECDSA, 256, 1, 2) != PKI_OK
+			|| PKI_KEYPAIR_POOL_fill(pool) != PKI_OK
+			|| PKI_EST_SERVER_set_keygen(est, pool, PKI_SCHEME_ECDSA, 256) != PKI_OK) {
+		printf("     + Keypair pool ...: Failed\n");
+		goto end;
+	}
+
+	// TLS server credentials, the clients are optionally authenticated
+	if ((srvkey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (req = PKI_X509_REQ_new(srvkey, "CN=127.0.0.1, O=OpenCA", NULL, NULL,
+				PKI_DIGEST_ALG_SHA256, NULL)) == NULL
+			|| (srvcert = PKI_X509_CERT_new(cacert, cakey, req, NULL, NULL, 3600,
+				NULL, NULL, NULL, NULL)) == NULL
+			|| (trusted = PKI_STACK_X509_CERT_new()) == NULL) {
+		printf("     + Server credentials ...: Failed\n");
+		goto end;
+	}
+	PKI_STACK_X509_CERT_push(trusted, cacert);
+	PKI_X509_REQ_free(req);
+	req = NULL;
+
+	if ((http = PKI_HTTP_SERVER_new("127.0.0.1", 0, 4)) == NULL
+			|| PKI_HTTP_SERVER_set_tls(http, srvkey, srvcert, NULL, trusted) != PKI_OK
+			|| PKI_EST_SERVER_attach(est, http, NULL) != PKI_OK
+			|| PKI_HTTP_SERVER_start(http) != PKI_OK) {
+		printf("     + Server start ...: Failed\n");
+		goto end;
+	}
+	snprintf(est_url, sizeof(est_url), "https://127.0.0.1:%d%s",
+		PKI_HTTP_SERVER_get_port(http), PKI_EST_SERVER_PATH);
+
+	// cacerts
+	if ((out = _request("cacerts", NULL, NULL)) != NULL)
+		ok = (_certs_num(out, "CN=EST Test CA") == 1);
+	if (out) PKI_MEM_free(out);
+	out = NULL;
+
+	if (!ok) {
+		printf("     + cacerts ...: Failed\n");
+		goto end;
+	}
+	printf("     + cacerts ...: Ok\n");
+
+	// simpleenroll, the issued certificate authenticates the renewals
+	ok = 0;
+	if ((body = _csr_der("CN=device-2, O=OpenCA")) != NULL
+			&& (out = _request("simpleenroll", body, NULL)) != NULL
+			&& _certs_num(out, "CN=device-2") == 1
+			&& (p7 = _certs(out)) != NULL) {
+		ok = ((x = PKI_X509_PKCS7_get_cert(p7, 0)) != NULL);
+		PKI_X509_PKCS7_free(p7);
+	}
+	if (out) PKI_MEM_free(out);
+	out = NULL;
+
+	if (!ok) {
+		printf("     + simpleenroll ...: Failed\n");
+		goto end;
+	}
+	printf("     + simpleenroll ...: Ok\n");
+
+	// simplereenroll with and without the client certificate
+	ok = 0;
+	if ((tk = PKI_TOKEN_new_null()) != NULL
+			&& PKI_TOKEN_set_keypair(tk, clikey) == PKI_OK
+			&& PKI_TOKEN_set_cert(tk, x) == PKI_OK) {
+		x = NULL;
+		if ((out = _request("simplereenroll", body, tk)) != NULL)
+			ok = (_certs_num(out, "CN=device-2") == 1);
+		if (out) PKI_MEM_free(out);
+		out = NULL;
+	}
+
+	if (ok) {
+		ok = ((out = _request("simplereenroll", body, NULL)) == NULL);
+		PKI_MEM_free(body);
+		if (ok && (body = _csr_der("CN=device-3, O=OpenCA")) != NULL)
+			ok = ((out = _request("simplereenroll", body, tk)) == NULL);
+		if (out) PKI_MEM_free(out);
+		out = NULL;
+	}
+
+	if (!ok) {
+		printf("     + simplereenroll ...: Failed\n");
+		goto end;
+	}
+	printf("     + simplereenroll ...: Ok\n");
+
+	// serverkeygen returns the key and the certificate
+	ok = 0;
+	if ((out = _request("serverkeygen", body, NULL)) != NULL
+			&& PKI_MEM_add(out, (unsigned char *) "", 1) == PKI_OK) {
+		ok = (strstr((char *) out->data, "--" PKI_EST_SERVER_BOUNDARY "\r\n"
+				"Content-Type: " PKI_EST_SERVER_TYPE_KEY) != NULL
+			&& strstr((char *) out->data, "Content-Type: "
+				PKI_EST_SERVER_TYPE_CERTS) != NULL
+			&& strstr((char *) out->data, "--" PKI_EST_SERVER_BOUNDARY "--") != NULL);
+	}
+	if (out) PKI_MEM_free(out);
+	out = NULL;
+
+	if (!ok) {
+		printf("     + serverkeygen ...: Failed\n");
+		goto end;
+	}
+	printf("     + serverkeygen ...: Ok\n");
+
+	// bulkenroll of concatenated DER requests (one rejected, one repeated
+	// and one malformed), the status is reported in the order of the requests
+	ok = 0;
+	if ((der = PKI_MEM_new_null()) == NULL) goto end;
+	for (i = 0; i <= BATCH_REQS; i++) {
+		PKI_MEM_free(body);
+		snprintf(subject_s, sizeof(subject_s), "CN=%s-%d, O=OpenCA",
+			i == 7 ? "reject" : "bulk", i % BATCH_REQS);
+		if ((body = _csr_der(subject_s)) == NULL) goto end;
+		PKI_MEM_add(der, body->data, body->size);
+	}
+	PKI_MEM_add(der, (unsigned char *) "\x30\x03\x02\x01\x00", 5);
+
+	strcpy(status_s, "issued=");
+	for (i = 0; i <= BATCH_REQS; i++) strcat(status_s, i == 7 ? "0," : "1,");
+	strcat(status_s, "0");
+
+	if ((out = _bulk_request(der, &status)) != NULL)
+		ok = (_certs_num(out, "CN=bulk-") == BATCH_REQS
+			&& _certs_num(out, "CN=bulk-0,") == 2
+			&& status && strcmp(status, status_s) == 0);
+	if (out) PKI_MEM_free(out);
+	out = NULL;
+
+	if (!ok) {
+		printf("     + bulkenroll ...: Failed (%s)\n", status ? status : "no status");
+		goto end;
+	}
+	printf("     + bulkenroll ...: Ok\n");
+
+	// A large batch, the status header is longer than a usual response head
+	ok = 0;
+	PKI_MEM_free(der);
+	PKI_Free(status);
+	status = NULL;
+	if ((der = PKI_MEM_new_null()) == NULL) goto end;
+	for (i = 0; i < BULK_REQS; i++) PKI_MEM_add(der, body->data, body->size);
+
+	if ((out = _bulk_request(der, &status)) != NULL && status
+			&& strlen(status) == strlen("issued=") + 2 * BULK_REQS - 1
+			&& strncmp(status, "issued=1,", 9) == 0 && strstr(status, "0") == NULL)
+		ok = (_certs_num(out, "CN=bulk-") == BULK_REQS);
+	if (out) PKI_MEM_free(out);
+	out = NULL;
+
+	if (!ok) {
+		printf("     + bulkenroll (%d requests) ...: Failed\n", BULK_REQS);
+		goto end;
+	}
+	printf("     + bulkenroll (%d requests) ...: Ok\n", BULK_REQS);
+
+	// Unknown operation and wrong method
+	if ((ok = ((out = _request("fullcmc", der, NULL)) == NULL
+			&& (out = _request("simpleenroll", NULL, NULL)) == NULL)) == 0) {
+		printf("     + Unsupported operations ...: Failed\n");
+		goto end;
+	}
+	printf("     + Unsupported operations ...: Ok\n");
+
+	ok = (PKI_EST_SERVER_get_stats(est, &st) == PKI_OK
+		&& st.requests[PKI_EST_SERVER_OP_CACERTS] == 1
+		&& st.requests[PKI_EST_SERVER_OP_SIMPLEENROLL] == 1
+		&& st.requests[PKI_EST_SERVER_OP_SIMPLEREENROLL] == 3
+		&& st.requests[PKI_EST_SERVER_OP_SERVERKEYGEN] == 1
+		&& st.requests[PKI_EST_SERVER_OP_BULKENROLL] == 2
+		&& st.issued == (uint64_t) (3 + BATCH_REQS + BULK_REQS)
+		&& st.rejected == 4);
+
+	if (!ok) {
+		printf("     + Counters ...: Failed\n");
+		goto end;
+	}
+	printf("     + Counters ...: Ok\n");
+
+	if ((ok = (PKI_HTTP_SERVER_stop(http) == PKI_OK)) == 0) {
+		printf("     + Server stop ...: Failed\n");
+		goto end;
+	}
+	printf("     + Server stop ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+end:
+	// The token owns the client key and certificate
+	if (tk) {
+		clikey = NULL;
+		PKI_TOKEN_free(tk);
+	}
+	if (x) PKI_X509_CERT_free(x);
+	if (status) PKI_Free(status);
+	if (der) PKI_MEM_free(der);
+	if (body) PKI_MEM_free(body);
+	if (req) PKI_X509_REQ_free(req);
+	if (trusted) PKI_STACK_X509_CERT_free(trusted);
+	if (srvcert) PKI_X509_CERT_free(srvcert);
+	if (srvkey) PKI_X509_KEYPAIR_free(srvkey);
+	if (pool) {
+		PKI_HTTP_SERVER_free(http);
+		http = NULL;
+		PKI_EST_SERVER_set_keygen(est, NULL, PKI_SCHEME_ECDSA, 256);
+		PKI_KEYPAIR_POOL_free(pool);
+	}
+
+	return ok;
+}
+
+// Rejects the requests for CN=reject-*
+static int _auth_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *peer,
+		PKI_EST_SERVER_OP op, void *ctx) {
+
+	char *subject = NULL;
+	int ret = PKI_OK;
+
+	if ((subject = (char *) PKI_X509_REQ_get_parsed(req, PKI_X509_DATA_SUBJECT)) != NULL) {
+		if (strstr(subject, "CN=reject") != NULL) ret = PKI_ERR;
+		PKI_Free(subject);
+	}
+
+	return ret;
+}
+
+static PKI_X509_REQ * _csr(const char *subject) {
+
+	return PKI_X509_REQ_new(clikey, subject, NULL, NULL, PKI_DIGEST_ALG_SHA256, NULL);
+}
+
+// DER PKCS#10 request
+static PKI_MEM * _csr_der(const char *subject) {
+
+	PKI_X509_REQ *req = NULL;
+	PKI_MEM *ret = NULL;
+
+	if ((req = _csr(subject)) == NULL) return NULL;
+
+	ret = PKI_X509_put_mem(req, PKI_DATA_FORMAT_ASN1, NULL, NULL);
+	PKI_X509_REQ_free(req);
+
+	return ret;
+}
+
+// POSTs the body (base64 encoded as by the EST clients) to the operation,
+// or GETs it without a body. Returns the response body on success.
+static PKI_MEM * _request(const char *op, PKI_MEM *body, PKI_TOKEN *tk) {
+
+	PKI_SSL *ssl = NULL;
+	PKI_MEM_STACK *sk = NULL;
+	PKI_MEM *data = NULL, *ret = NULL;
+	char url_s[128];
+
+	snprintf(url_s, sizeof(url_s), "%s/%s", est_url, op);
+
+	if (body && ((data = PKI_MEM_new_data(body->size, body->data)) == NULL
+			|| PKI_MEM_encode(data, PKI_DATA_FORMAT_B64, 1) != PKI_OK)) goto end;
+
+	// The connection takes the ownership of the PKI_SSL
+	if ((ssl = PKI_SSL_new(NULL)) == NULL) goto end;
+
+	PKI_SSL_set_verify(ssl, PKI_SSL_VERIFY_NONE);
+	if (tk) PKI_SSL_set_token(ssl, tk);
+
+	if (!data) {
+		if (PKI_HTTP_GET_data(url_s, 30, 0, &sk, ssl) == PKI_OK && sk)
+			ret = PKI_STACK_MEM_pop(sk);
+	} else if (PKI_HTTP_POST_data(url_s, (const char *) data->data, data->size,
+			PKI_EST_SERVER_TYPE_CSR, 30, 0, &sk, ssl) == PKI_OK && sk) {
+		ret = PKI_STACK_MEM_pop(sk);
+	}
+
+end:
+	if (sk) PKI_STACK_MEM_free_all(sk);
+	if (data) PKI_MEM_free(data);
+
+	return ret;
+}
+
+// POSTs the bulkenroll body as _request() does, the value of the batch
+// status header is returned in *status
+static PKI_MEM * _bulk_request(PKI_MEM *body, char **status) {
+
+	PKI_SSL *ssl = NULL;
+	PKI_SOCKET *sock = NULL;
+	PKI_HTTP *msg = NULL;
+	PKI_MEM *data = NULL, *ret = NULL;
+	char url_s[128], head[256];
+	int len = 0;
+
+	*status = NULL;
+
+	snprintf(url_s, sizeof(url_s), "%s/bulkenroll", est_url);
+
+	if ((data = PKI_MEM_new_data(body->size, body->data)) == NULL
+			|| PKI_MEM_encode(data, PKI_DATA_FORMAT_B64, 1) != PKI_OK
+			|| (ssl = PKI_SSL_new(NULL)) == NULL) goto end;
+
+	// The socket takes the ownership of the PKI_SSL
+	PKI_SSL_set_verify(ssl, PKI_SSL_VERIFY_NONE);
+	if ((sock = PKI_SOCKET_new_ssl(ssl)) == NULL) {
+		PKI_SSL_free(ssl);
+		goto end;
+	}
+
+	len = snprintf(head, sizeof(head), "POST %s HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+		"Connection: close\r\nContent-Type: %s\r\nContent-Length: %d\r\n\r\n",
+		strstr(url_s + 8, "/"), PKI_EST_SERVER_TYPE_CSR, (int) data->size);
+
+	if (PKI_SOCKET_open(sock, url_s, 30) != PKI_OK
+			|| PKI_SOCKET_write(sock, head, (size_t) len) < 0
+			|| PKI_SOCKET_write(sock, (const char *) data->data, data->size) < 0
+			|| (msg = PKI_HTTP_get_message(sock, 30, 0)) == NULL
+			|| msg->code != 200 || !msg->body) goto end;
+
+	*status = PKI_HTTP_get_header(msg, PKI_EST_SERVER_HEADER_BATCH);
+
+	ret = msg->body;
+	msg->body = NULL;
+
+end:
+	if (msg) PKI_HTTP_free(msg);
+	if (sock) {
+		PKI_SOCKET_close(sock);
+		PKI_SOCKET_free(sock);
+	}
+	if (data) PKI_MEM_free(data);
+
+	return ret;
+}
+
+// Parses a base64 certs-only body
+static PKI_X509_PKCS7 * _certs(PKI_MEM *body) {
+
+	PKI_MEM *der = NULL;
+	PKI_X509_PKCS7 *ret = NULL;
+
+	if ((der = PKI_MEM_new_data(body->size, body->data)) != NULL
+			&& PKI_MEM_decode(der, PKI_DATA_FORMAT_B64, 0) == PKI_OK)
+		ret = PKI_X509_PKCS7_get_mem(der, PKI_DATA_FORMAT_ASN1, NULL);
+
+	if (der) PKI_MEM_free(der);
+
+	return ret;
+}
+
+// Number of certificates in a base64 certs-only body with the subject
+static int _certs_num(PKI_MEM *body, const char *subject) {
+
+	PKI_X509_PKCS7 *p7 = NULL;
+	PKI_X509_CERT *x = NULL;
+	char *s = NULL;
+	int i = 0, num = 0, ret = -1;
+
+	if ((p7 = _certs(body)) == NULL
+			|| (num = PKI_X509_PKCS7_get_certs_num(p7)) <= 0) goto end;
+
+	for (ret = 0, i = 0; i < num; i++) {
+		if ((x = PKI_X509_PKCS7_get_cert(p7, i)) == NULL) continue;
+		if ((s = PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_SUBJECT)) != NULL) {
+			if (strstr(s, subject) != NULL) ret++;
+			PKI_Free(s);
+		}
+		PKI_X509_CERT_free(x);
+	}
+
+end:
+	if (p7) PKI_X509_PKCS7_free(p7);
+
+	return ret;
+}
@@ -0,0 +1,507 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Thirty-Two (32) - CMC Server"
+
+// TaggedRequests of the Full PKI Requests
+#define BATCH_REQS	20
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static PKI_MEM * _request(const char *prefix, int num, const PKI_X509_CERT *signer);
+#ifdef PKI_CMC_CRMF
+static PKI_MEM * _crm_request(void);
+# define CRM_REQS 2
+#else
+# define CRM_REQS 0
+#endif
+static int _statuses(PKI_MEM *resp, int num, PKI_CMC_STATUS status, PKI_CMC_FAIL fail);
+static int _certs_num(PKI_MEM *resp, const char *subject);
+
+static int _auth_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *signer,
+		long body_part_id, void *ctx);
+
+static PKI_CMC_SERVER *cmc = NULL;
+
+static PKI_X509_KEYPAIR *cakey = NULL;
+static PKI_X509_CERT *cacert = NULL;
+static PKI_X509_KEYPAIR *clikey = NULL;
+static PKI_X509_CERT *clicert = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// The requests are signed with a self-signed certificate
+	if ((cakey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (clikey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL)) == NULL
+			|| (cacert = PKI_X509_CERT_new(NULL, cakey, NULL, "CN=CMC Test CA, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL
+			|| (clicert = PKI_X509_CERT_new(NULL, clikey, NULL, "CN=RA, O=OpenCA",
+				"1", 3600, NULL, NULL, NULL, NULL)) == NULL) {
+		printf("* %s: Can not generate the test credentials.\n\n", test_name);
+		return 1;
+	}
+
+	if ((cmc = PKI_CMC_SERVER_new()) == NULL
+			|| PKI_CMC_SERVER_set_ca(cmc, cakey, cacert) != PKI_OK
+			|| PKI_CMC_SERVER_set_profile(cmc, NULL, 3600) != PKI_OK
+			|| PKI_CMC_SERVER_set_auth_cb(cmc, _auth_cb, NULL) != PKI_OK
+			|| PKI_CMC_SERVER_set_threads(cmc, 4) != PKI_OK) {
+		printf("* %s: Can not create the CMC server.\n\n", test_name);
+		return 1;
+	}
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	PKI_CMC_SERVER_free(cmc);
+
+	PKI_X509_CERT_free(clicert);
+	PKI_X509_CERT_free(cacert);
+	PKI_X509_KEYPAIR_free(clikey);
+	PKI_X509_KEYPAIR_free(cakey);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_MEM *req = NULL, *resp = NULL;
+	PKI_X509_CERT_STACK *sk = NULL;
+	PKI_X509_CERT *x = NULL;
+	int i = 0, ok = 0;
+
+	printf("   - Subtest 1: Full PKI Request\n");
+
+	if ((req = _request("device", BATCH_REQS, clicert)) != NULL
+			&& (resp = PKI_CMC_SERVER_process(cmc, req)) != NULL)
+		ok = _statuses(resp, BATCH_REQS, PKI_CMC_STATUS_SUCCESS, PKI_CMC_FAIL_NONE);
+
+	if (!ok) {
+		printf("     + Statuses ...: Failed\n");
+		goto end;
+	}
+	printf("     + Statuses ...: Ok\n");
+
+	// The CA certificate is returned with the issued ones
+	ok = (_certs_num(resp, "CN=device-") == BATCH_REQS
+		&& _certs_num(resp, "CN=CMC Test CA") == 1);
+
+	if (ok && (sk = PKI_CMC_RESPONSE_get_certs(resp)) != NULL) {
+		for (i = 0; ok && i < PKI_STACK_X509_CERT_elements(sk); i++) {
+			x = PKI_STACK_X509_CERT_get_num(sk, i);
+			ok = (X509_verify(x->value, X509_get0_pubkey(cacert->value)) == 1);
+		}
+	}
+
+	if (!ok) {
+		printf("     + Issued certificates ...: Failed\n");
+		goto end;
+	}
+	printf("     + Issued certificates ...: Ok\n");
+
+	// Unknown bodyPartID
+	if ((ok = (PKI_CMC_RESPONSE_get_status(resp, BATCH_REQS * 4, NULL)
+			== PKI_CMC_STATUS_UNKNOWN)) == 0) {
+		printf("     + Unknown body part ...: Failed\n");
+		goto end;
+	}
+	printf("     + Unknown body part ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+end:
+	if (sk) PKI_STACK_X509_CERT_free_all(sk);
+	if (resp) PKI_MEM_free(resp);
+	if (req) PKI_MEM_free(req);
+
+	return ok;
+}
+
+int subtest2() {
+
+	PKI_X509_REQ_STACK *reqs = NULL;
+	PKI_X509_REQ *r = NULL;
+	PKI_X509_KEYPAIR *k = NULL;
+	PKI_X509_CERT_STACK *trusted = NULL;
+	PKI_CMC_SERVER_STATS st;
+	PKI_MEM *req = NULL, *resp = NULL;
+	PKI_CMC_FAIL fail = PKI_CMC_FAIL_NONE;
+	int ok = 0;
+
+	printf("   - Subtest 2: Rejected Requests\n");
+
+	PKI_CMC_SERVER_reset_stats(cmc);
+
+	// Rejected by the authorization callback
+	if ((req = _request("reject", BATCH_REQS, clicert)) != NULL
+			&& (resp = PKI_CMC_SERVER_process(cmc, req)) != NULL)
+		ok = (_statuses(resp, BATCH_REQS, PKI_CMC_STATUS_FAILED, PKI_CMC_FAIL_BAD_REQUEST)
+			&& _certs_num(resp, "CN=reject-") == 0);
+
+	if (!ok) {
+		printf("     + Authorization ...: Failed\n");
+		goto end;
+	}
+	printf("     + Authorization ...: Ok\n");
+
+	// The public key does not match the signature of the second request
+	ok = 0;
+	PKI_MEM_free(req);
+	PKI_MEM_free(resp);
+	req = resp = NULL;
+	if ((reqs = PKI_STACK_X509_REQ_new()) != NULL
+			&& (r = PKI_X509_REQ_new(clikey, "CN=pop-1, O=OpenCA", NULL, NULL,
+				PKI_DIGEST_ALG_SHA256, NULL)) != NULL
+			&& PKI_STACK_X509_REQ_push(reqs, r) > 0
+			&& (r = PKI_X509_REQ_new(clikey, "CN=pop-2, O=OpenCA", NULL, NULL,
+				PKI_DIGEST_ALG_SHA256, NULL)) != NULL
+			&& PKI_STACK_X509_REQ_push(reqs, r) > 0
+			&& (k = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 256, NULL, NULL, NULL)) != NULL
+			&& X509_REQ_set_pubkey(r->value, k->value) == 1
+			&& (req = PKI_CMC_REQUEST_new(reqs, clikey, clicert)) != NULL
+			&& (resp = PKI_CMC_SERVER_process(cmc, req)) != NULL) {
+		ok = (PKI_CMC_RESPONSE_get_status(resp, 1, &fail) == PKI_CMC_STATUS_SUCCESS
+			&& fail == PKI_CMC_FAIL_NONE
+			&& PKI_CMC_RESPONSE_get_status(resp, 2, &fail) == PKI_CMC_STATUS_FAILED
+			&& fail == PKI_CMC_FAIL_POP_FAILED
+			&& _certs_num(resp, "CN=pop-") == 1);
+	}
+
+	if (!ok) {
+		printf("     + Proof of possession ...: Failed\n");
+		goto end;
+	}
+	printf("     + Proof of possession ...: Ok\n");
+
+	// A PKCS#10 request (bodyPartID 1) and two CRMF ones (certReqId 7 and 8)
+	ok = 0;
+	PKI_MEM_free(req);
+	PKI_MEM_free(resp);
+	req = resp = NULL;
+#ifdef PKI_CMC_CRMF
+	if ((req = _crm_request()) != NULL
+			&& (resp = PKI_CMC_SERVER_process(cmc, req)) != NULL) {
+		ok = (PKI_CMC_RESPONSE_get_status(resp, 1, &fail) == PKI_CMC_STATUS_SUCCESS
+			&& PKI_CMC_RESPONSE_get_status(resp, 7, &fail) == PKI_CMC_STATUS_NOSUPPORT
+			&& PKI_CMC_RESPONSE_get_status(resp, 8, &fail) == PKI_CMC_STATUS_NOSUPPORT
+			&& PKI_CMC_RESPONSE_get_status(resp, 0, &fail) == PKI_CMC_STATUS_UNKNOWN
+			&& _certs_num(resp, "CN=crm-") == 1);
+	}
+#else
+	// No CRMF support, the PKCS#10 request is sent alone
+	if ((req = _request("crm", 1, clicert)) != NULL
+			&& (resp = PKI_CMC_SERVER_process(cmc, req)) != NULL)
+		ok = (PKI_CMC_RESPONSE_get_status(resp, 1, &fail) == PKI_CMC_STATUS_SUCCESS);
+#endif
+
+	if (!ok) {
+		printf("     + CRMF requests ...: Failed\n");
+		goto end;
+	}
+	printf("     + CRMF requests ...: Ok\n");
+
+	// The signer does not chain up to the trusted certificates
+	ok = 0;
+	PKI_MEM_free(req);
+	PKI_MEM_free(resp);
+	req = resp = NULL;
+	if ((trusted = PKI_STACK_X509_CERT_new()) != NULL
+			&& PKI_STACK_X509_CERT_push(trusted, cacert) > 0
+			&& PKI_CMC_SERVER_set_trusted(cmc, trusted) == PKI_OK
+			&& (req = _request("device", BATCH_REQS, clicert)) != NULL
+			&& (resp = PKI_CMC_SERVER_process(cmc, req)) != NULL) {
+		ok = (_statuses(resp, BATCH_REQS, PKI_CMC_STATUS_FAILED,
+				PKI_CMC_FAIL_BAD_MESSAGE_CHECK)
+			&& _certs_num(resp, "CN=device-") == 0);
+	}
+	PKI_CMC_SERVER_set_trusted(cmc, NULL);
+
+	if (!ok) {
+		printf("     + Message check ...: Failed\n");
+		goto end;
+	}
+	printf("     + Message check ...: Ok\n");
+
+	// Truncated message and not a SignedData
+	PKI_MEM_free(resp);
+	resp = NULL;
+	req->size /= 2;
+	ok = ((resp = PKI_CMC_SERVER_process(cmc, req)) == NULL);
+	PKI_MEM_free(req);
+	if (ok && (req = PKI_MEM_new_data(5, (unsigned char *) "\x30\x03\x02\x01\x00")) != NULL)
+		ok = ((resp = PKI_CMC_SERVER_process(cmc, req)) == NULL);
+	else req = NULL;
+
+	if (!ok) {
+		printf("     + Malformed message ...: Failed\n");
+		goto end;
+	}
+	printf("     + Malformed message ...: Ok\n");
+
+	ok = (PKI_CMC_SERVER_get_stats(cmc, &st) == PKI_OK
+		&& st.requests == 6
+		&& st.bad_messages == 3
+		&& st.issued == 2
+		&& st.rejected == (uint64_t) (2 * BATCH_REQS + 1 + CRM_REQS));
+
+	if (!ok) {
+		printf("     + Counters ...: Failed\n");
+		goto end;
+	}
+	printf("     + Counters ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+end:
+	if (trusted) PKI_STACK_X509_CERT_free(trusted);
+	if (k) PKI_X509_KEYPAIR_free(k);
+	if (reqs) PKI_STACK_X509_free_all(reqs);
+	if (resp) PKI_MEM_free(resp);
+	if (req) PKI_MEM_free(req);
+
+	return ok;
+}
+
+int subtest3() {
+
+	PKI_HTTP_SERVER *http = NULL;
+	PKI_MEM_STACK *sk = NULL;
+	PKI_MEM *req = NULL, *resp = NULL;
+	char url_s[64];
+	int ok = 0;
+
+	printf("   - Subtest 3: HTTP Transport\n");
+
+	if ((http = PKI_HTTP_SERVER_new("127.0.0.1", 0, 2)) == NULL
+			|| PKI_CMC_SERVER_attach(cmc, http, "/cmc") != PKI_OK
+			|| PKI_HTTP_SERVER_start(http) != PKI_OK) {
+		printf("     + Server start ...: Failed\n");
+		goto end;
+	}
+	snprintf(url_s, sizeof(url_s), "http://127.0.0.1:%d/cmc",
+		PKI_HTTP_SERVER_get_port(http));
+
+	if ((req = _request("http", 4, clicert)) != NULL
+			&& PKI_HTTP_POST_data(url_s, (const char *) req->data, req->size,
+				PKI_CMC_SERVER_TYPE_REQUEST, 30, 0, &sk, NULL) == PKI_OK
+			&& sk && (resp = PKI_STACK_MEM_pop(sk)) != NULL) {
+		ok = (_statuses(resp, 4, PKI_CMC_STATUS_SUCCESS, PKI_CMC_FAIL_NONE)
+			&& _certs_num(resp, "CN=http-") == 4);
+	}
+
+	if (!ok) {
+		printf("     + POST ...: Failed\n");
+		goto end;
+	}
+	printf("     + POST ...: Ok\n");
+
+	if ((ok = (PKI_HTTP_SERVER_stop(http) == PKI_OK)) == 0) {
+		printf("     + Server stop ...: Failed\n");
+		goto end;
+	}
+	printf("     + Server stop ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+end:
+	if (sk) PKI_STACK_MEM_free_all(sk);
+	if (resp) PKI_MEM_free(resp);
+	if (req) PKI_MEM_free(req);
+	if (http) PKI_HTTP_SERVER_free(http);
+
+	return ok;
+}
+
+// Rejects the requests for CN=reject-*
+static int _auth_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *signer,
+		long body_part_id, void *ctx) {
+
+	char *subject = NULL;
+	int ret = PKI_OK;
+
+	if (!signer) return PKI_ERR;
+
+	if ((subject = (char *) PKI_X509_REQ_get_parsed(req, PKI_X509_DATA_SUBJECT)) != NULL) {
+		if (strstr(subject, "CN=reject") != NULL) ret = PKI_ERR;
+		PKI_Free(subject);
+	}
+
+	return ret;
+}
+
+// Full PKI Request for CN=<prefix>-<n> (bodyPartIDs from 1)
+static PKI_MEM * _request(const char *prefix, int num, const PKI_X509_CERT *signer) {
+
+	PKI_X509_REQ_STACK *reqs = NULL;
+	PKI_X509_REQ *req = NULL;
+	PKI_MEM *ret = NULL;
+	char subject_s[64];
+	int i = 0;
+
+	if ((reqs = PKI_STACK_X509_REQ_new()) == NULL) return NULL;
+
+	for (i = 0; i < num; i++) {
+		snprintf(subject_s, sizeof(subject_s), "CN=%s-%d, O=OpenCA", prefix, i);
+		if ((req = PKI_X509_REQ_new(clikey, subject_s, NULL, NULL,
+				PKI_DIGEST_ALG_SHA256, NULL)) == NULL) goto end;
+		PKI_STACK_X509_REQ_push(reqs, req);
+	}
+
+	ret = PKI_CMC_REQUEST_new(reqs, clikey, signer);
+
+end:
+	PKI_STACK_X509_free_all(reqs);
+
+	return ret;
+}
+
+#ifdef PKI_CMC_CRMF
+// Full PKI Request with a PKCS#10 request (bodyPartID 1) and two CRMF
+// (RFC 4211) requests with certReqId 7 and 8
+static PKI_MEM * _crm_request(void) {
+
+	PKI_DATA *data = NULL;
+	TAGGED_REQUEST *tr = NULL;
+	PKI_X509_REQ *req = NULL;
+	OSSL_CRMF_MSG *crm = NULL;
+	X509_NAME *subject = NULL;
+	CMS_ContentInfo *cms = NULL;
+	BIO *bio = NULL;
+	PKI_MEM *ret = NULL;
+	unsigned char *der = NULL, *p = NULL;
+	unsigned int flags = CMS_BINARY | CMS_PARTIAL | CMS_NOSMIMECAP;
+	int len = 0, i = 0;
+
+	if ((req = PKI_X509_REQ_new(clikey, "CN=crm-1, O=OpenCA", NULL, NULL,
+			PKI_DIGEST_ALG_SHA256, NULL)) == NULL
+			|| (data = PKI_DATA_new()) == NULL) goto end;
+
+	if ((tr = TAGGED_REQUEST_new()) == NULL
+			|| (tr->value.tcr = TAGGED_CERTIFICATION_REQUEST_new()) == NULL) goto end;
+	tr->type = 0;
+	X509_REQ_free(tr->value.tcr->certificationRequest);
+	if ((tr->value.tcr->certificationRequest = X509_REQ_dup(req->value)) == NULL
+			|| !ASN1_INTEGER_set(tr->value.tcr->bodyPartID, 1)
+			|| !sk_TAGGED_REQUEST_push(data->reqSequence, tr)) goto end;
+	tr = NULL;
+
+	if ((subject = X509_NAME_new()) == NULL
+			|| !X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+				(const unsigned char *) "crm-2", -1, -1, 0)) goto end;
+
+	for (i = 7; i <= 8; i++) {
+		if ((crm = OSSL_CRMF_MSG_new()) == NULL
+				|| !OSSL_CRMF_MSG_set_certReqId(crm, i)
+				|| !OSSL_CRMF_CERTTEMPLATE_fill(OSSL_CRMF_MSG_get0_tmpl(crm),
+					clikey->value, subject, NULL, NULL)
+				|| !OSSL_CRMF_MSG_create_popo(OSSL_CRMF_POPO_SIGNATURE, crm,
+					clikey->value, EVP_sha256(), NULL, NULL)
+				|| (tr = TAGGED_REQUEST_new()) == NULL) goto end;
+		tr->type = 1;
+		tr->value.crm = crm;
+		crm = NULL;
+		if (!sk_TAGGED_REQUEST_push(data->reqSequence, tr)) goto end;
+		tr = NULL;
+	}
+
+	if ((len = i2d_PKI_DATA(data, &der)) <= 0
+			|| (bio = BIO_new_mem_buf(der, len)) == NULL
+			|| (cms = CMS_sign(clicert->value, clikey->value, NULL, NULL, flags)) == NULL
+			|| !CMS_set1_eContentType(cms, OBJ_nid2obj(NID_id_cct_PKIData))
+			|| !CMS_final(cms, bio, NULL, flags)
+			|| (len = i2d_CMS_ContentInfo(cms, NULL)) <= 0
+			|| (ret = PKI_MEM_new((size_t) len)) == NULL) goto end;
+
+	p = ret->data;
+	i2d_CMS_ContentInfo(cms, &p);
+
+end:
+	if (cms) CMS_ContentInfo_free(cms);
+	if (bio) BIO_free(bio);
+	if (der) OPENSSL_free(der);
+	if (crm) OSSL_CRMF_MSG_free(crm);
+	if (tr) TAGGED_REQUEST_free(tr);
+	if (subject) X509_NAME_free(subject);
+	if (data) PKI_DATA_free(data);
+	if (req) PKI_X509_REQ_free(req);
+
+	return ret;
+}
+#endif
+
+// Checks the status of the body parts 1..num
+static int _statuses(PKI_MEM *resp, int num, PKI_CMC_STATUS status, PKI_CMC_FAIL fail) {
+
+	PKI_CMC_FAIL f = PKI_CMC_FAIL_NONE;
+	int i = 0;
+
+	for (i = 1; i <= num; i++) {
+		if (PKI_CMC_RESPONSE_get_status(resp, i, &f) != status || f != fail) return 0;
+	}
+
+	return 1;
+}
+
+// Number of certificates in the response with the subject
+static int _certs_num(PKI_MEM *resp, const char *subject) {
+
+	PKI_X509_CERT_STACK *sk = NULL;
+	PKI_X509_CERT *x = NULL;
+	char *s = NULL;
+	int i = 0, ret = 0;
+
+	if ((sk = PKI_CMC_RESPONSE_get_certs(resp)) == NULL) return -1;
+
+	for (i = 0; i < PKI_STACK_X509_CERT_elements(sk); i++) {
+		x = PKI_STACK_X509_CERT_get_num(sk, i);
+		if ((s = PKI_X509_CERT_get_parsed(x, PKI_X509_DATA_SUBJECT)) != NULL) {
+			if (strstr(s, subject) != NULL) ret++;
+			PKI_Free(s);
+		}
+	}
+
+	PKI_STACK_X509_CERT_free_all(sk);
+
+	return ret;
+}
@@ -0,0 +1,248 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Thirty-Three (33) - Interned Names"
+
+// RDNs of the long DN
+#define LONG_DN_RDNS	2000
+
+// Threads interning the same names
+#define INTERN_THREADS	4
+#define INTERN_NAMES	64
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static void * _intern_job(void *arg);
+
+static const PKI_X509_NAME_REF * refs[INTERN_THREADS][INTERN_NAMES];
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	PKI_X509_NAME_intern_flush();
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	PKI_X509_NAME *name = NULL;
+	PKI_MEM *dn = NULL;
+	char *parsed = NULL;
+	char rdn_s[32];
+	int i = 0, ok = 0;
+
+	printf("   - Subtest 1: DN Parsing\n");
+
+	// Separators, escapes and multi-valued RDNs
+	if ((name = PKI_X509_NAME_new("CN=Test\\, User+UID=42, O=OpenCA; C=US")) != NULL
+			&& (parsed = PKI_X509_NAME_get_parsed(name)) != NULL) {
+		ok = (X509_NAME_entry_count(name) == 4
+			&& X509_NAME_ENTRY_set(X509_NAME_get_entry(name, 1))
+				!= X509_NAME_ENTRY_set(X509_NAME_get_entry(name, 2))
+			&& strstr(parsed, "CN=Test, User") != NULL
+			&& strstr(parsed, "O=OpenCA") != NULL);
+	}
+	if (parsed) PKI_Free(parsed);
+	if (name) PKI_X509_NAME_free(name);
+	name = NULL;
+
+	if (!ok) {
+		printf("     + Parsing ...: Failed\n");
+		return 0;
+	}
+	printf("     + Parsing ...: Ok\n");
+
+	// Malformed names
+	if ((ok = (PKI_X509_NAME_new("") == NULL
+			&& PKI_X509_NAME_new("CN") == NULL
+			&& PKI_X509_NAME_new("XX=unknown, CN=test") == NULL)) == 0) {
+		printf("     + Malformed names ...: Failed\n");
+		return 0;
+	}
+	printf("     + Malformed names ...: Ok\n");
+
+	// Long names
+	ok = 0;
+	if ((dn = PKI_MEM_new_null()) == NULL) return 0;
+	for (i = 0; i < LONG_DN_RDNS; i++) {
+		snprintf(rdn_s, sizeof(rdn_s), "%sOU=unit-%d", i ? ", " : "", i);
+		PKI_MEM_add(dn, (unsigned char *) rdn_s, strlen(rdn_s));
+	}
+	PKI_MEM_add(dn, (unsigned char *) "", 1);
+
+	if ((name = PKI_X509_NAME_new((char *) dn->data)) != NULL)
+		ok = (X509_NAME_entry_count(name) == LONG_DN_RDNS);
+	if (name) PKI_X509_NAME_free(name);
+	PKI_MEM_free(dn);
+
+	if (!ok) {
+		printf("     + Long names ...: Failed\n");
+		return 0;
+	}
+	printf("     + Long names ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return ok;
+}
+
+int subtest2() {
+
+	PKI_X509_NAME *a = NULL, *b = NULL, *c = NULL, *d = NULL;
+	const PKI_X509_NAME_REF *ra = NULL, *rb = NULL, *rc = NULL, *rd = NULL;
+	unsigned char md[EVP_MAX_MD_SIZE];
+	const unsigned char *name_hash = NULL;
+	unsigned int md_len = 0;
+	size_t size = 0;
+	int ok = 0;
+
+	printf("   - Subtest 2: Interned Names\n");
+
+	// Equal names for X509_NAME_cmp (case and spaces), a different one
+	if ((a = PKI_X509_NAME_new("CN=Test User, O=OpenCA")) == NULL
+			|| (b = PKI_X509_NAME_new("CN=  test   USER , O=openca")) == NULL
+			|| (c = PKI_X509_NAME_new("CN=Test User, O=OpenCA")) == NULL
+			|| (d = PKI_X509_NAME_new("CN=Test User, O=OpenCA Labs")) == NULL) {
+		printf("     + Names ...: Failed\n");
+		goto end;
+	}
+
+	if ((ra = PKI_X509_NAME_intern(a)) != NULL
+			&& (rb = PKI_X509_NAME_intern(b)) != NULL
+			&& (rc = PKI_X509_NAME_intern(c)) != NULL
+			&& (rd = PKI_X509_NAME_intern(d)) != NULL) {
+		ok = (ra == rc && ra != rb
+			&& PKI_X509_NAME_REF_cmp(ra, rb) == 0
+			&& PKI_X509_NAME_cmp(a, b) == 0
+			&& PKI_X509_NAME_REF_get_hash(ra) == PKI_X509_NAME_REF_get_hash(rb)
+			&& PKI_X509_NAME_REF_cmp(ra, rd) != 0
+			&& PKI_X509_NAME_REF_cmp(ra, rd) == -PKI_X509_NAME_REF_cmp(rd, ra)
+			&& PKI_X509_NAME_cmp(PKI_X509_NAME_REF_get_name(ra), a) == 0);
+	}
+
+	if (!ok) {
+		printf("     + Equality ...: Failed\n");
+		goto end;
+	}
+	printf("     + Equality ...: Ok\n");
+
+	// SHA-1 of the DER of each encoding
+	ok = 0;
+	if ((name_hash = PKI_X509_NAME_REF_get_name_hash(rb, &size)) != NULL
+			&& X509_NAME_digest(b, EVP_sha1(), md, &md_len)) {
+		ok = (size == md_len && memcmp(name_hash, md, size) == 0
+			&& memcmp(PKI_X509_NAME_REF_get_name_hash(ra, NULL), md, size) != 0);
+	}
+
+	if (!ok) {
+		printf("     + Name hash ...: Failed\n");
+		goto end;
+	}
+	printf("     + Name hash ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+end:
+	if (d) PKI_X509_NAME_free(d);
+	if (c) PKI_X509_NAME_free(c);
+	if (b) PKI_X509_NAME_free(b);
+	if (a) PKI_X509_NAME_free(a);
+
+	return ok;
+}
+
+int subtest3() {
+
+	PKI_THREAD *th[INTERN_THREADS];
+	int i = 0, j = 0, num = 0, ok = 0;
+
+	printf("   - Subtest 3: Concurrent Interning\n");
+
+	num = PKI_X509_NAME_intern_num();
+
+	for (i = 0; i < INTERN_THREADS; i++) th[i] = PKI_THREAD_new(_intern_job, refs[i]);
+	for (i = 0; i < INTERN_THREADS; i++) {
+		if (th[i]) {
+			PKI_THREAD_join(th[i], NULL);
+			PKI_Free(th[i]);
+		} else _intern_job(refs[i]);
+	}
+
+	// The same name gives the same ref in every thread
+	for (ok = 1, i = 0; ok && i < INTERN_NAMES; i++) {
+		for (j = 0; ok && j < INTERN_THREADS; j++)
+			ok = (refs[j][i] != NULL && refs[j][i] == refs[0][i]);
+	}
+	ok = (ok && PKI_X509_NAME_intern_num() == num + INTERN_NAMES);
+
+	if (!ok) {
+		printf("     + Shared refs ...: Failed\n");
+		return 0;
+	}
+	printf("     + Shared refs ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return ok;
+}
+
+static void * _intern_job(void *arg) {
+
+	const PKI_X509_NAME_REF **ret = arg;
+	PKI_X509_NAME *name = NULL;
+	char name_s[64];
+	int i = 0;
+
+	for (i = 0; i < INTERN_NAMES; i++) {
+		snprintf(name_s, sizeof(name_s), "CN=Thread Name %d, O=OpenCA", i);
+		if ((name = PKI_X509_NAME_new(name_s)) == NULL) continue;
+		ret[i] = PKI_X509_NAME_intern(name);
+		PKI_X509_NAME_free(name);
+	}
+
+	return NULL;
+}
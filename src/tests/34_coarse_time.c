@@ -0,0 +1,209 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define test_name "Test Thirty-Four (34) - Coarse Clock"
+
+// Threads reading the clock
+#define CLOCK_THREADS	4
+
+// ===================
+// Function Prototypes
+// ===================
+
+int subtest1();
+int subtest2();
+int subtest3();
+
+static void * _clock_job(void *arg);
+
+static const PKI_TIME * thread_now[CLOCK_THREADS];
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Test - Massimiliano Pala <madwolf@openca.org>\n");
+	printf("(c) 2006 by Massimiliano Pala and OpenCA Project\n");
+	printf("OpenCA Licensed Software\n\n");
+
+	PKI_init_all();
+
+	// Info
+	printf("* %s Begin\n", test_name);
+
+	// SubTests Execution
+	int success = (
+		subtest1()
+		&& subtest2()
+		&& subtest3()
+	);
+
+	// Info
+	if (success) {
+		printf("* %s: Passed Successfully.\n\n", test_name);
+	} else {
+		printf("* %s: Failed.\n\n", test_name);
+	}
+
+	// Error Condition
+	if (!success) return 1;
+
+	// Success
+	return 0;
+}
+
+int subtest1() {
+
+	const PKI_TIME *now = NULL;
+	const unsigned char *der = NULL, *pnt = NULL;
+	ASN1_GENERALIZEDTIME *parsed = NULL;
+	PKI_TIME *t = NULL;
+	char log_s[PKI_TIME_LOG_SIZE + 4];
+	time_t sec = 0, sys = 0;
+	long nsec = 0;
+	size_t size = 0;
+	int day = 0, secs = 0, ok = 0;
+
+	printf("   - Subtest 1: Current Time\n");
+
+	// Coarse clock against time()
+	sys = time(NULL);
+	sec = PKI_TIME_now_coarse(&nsec);
+	if (!(sec >= sys - 2 && sec <= sys + 2 && nsec >= 0 && nsec < 1000000000L)) {
+		printf("     + Coarse clock ...: Failed\n");
+		return 0;
+	}
+	printf("     + Coarse clock ...: Ok\n");
+
+	// GeneralizedTime and its DER
+	if ((now = PKI_TIME_now()) != NULL
+			&& (der = PKI_TIME_now_der(&size)) != NULL
+			&& size == PKI_TIME_DER_SIZE) {
+
+		pnt = der;
+		if ((parsed = d2i_ASN1_GENERALIZEDTIME(NULL, &pnt, (long) size)) != NULL
+				&& ASN1_GENERALIZEDTIME_check(parsed)
+				&& ASN1_TIME_diff(&day, &secs, parsed, now)) {
+			ok = (day == 0 && secs >= -1 && secs <= 1
+				&& now->length == PKI_TIME_DER_SIZE - 2
+				&& now->data[now->length - 1] == 'Z');
+		}
+		if (parsed) ASN1_GENERALIZEDTIME_free(parsed);
+	}
+
+	if (!ok) {
+		printf("     + GeneralizedTime ...: Failed\n");
+		return 0;
+	}
+	printf("     + GeneralizedTime ...: Ok\n");
+
+	// PKI_TIME_new(0) is a copy of the current time
+	ok = 0;
+	if ((t = PKI_TIME_new(0)) != NULL) {
+		ok = (t != PKI_TIME_now()
+			&& ASN1_TIME_diff(&day, &secs, t, PKI_TIME_now())
+			&& day == 0 && secs >= 0 && secs <= 1);
+		PKI_TIME_free(t);
+	}
+
+	if (!ok) {
+		printf("     + PKI_TIME_new(0) ...: Failed\n");
+		return 0;
+	}
+	printf("     + PKI_TIME_new(0) ...: Ok\n");
+
+	// Log timestamps ("YYYY-MM-DD HH:MM:SS.mmm")
+	ok = (PKI_TIME_now_log_s(log_s, sizeof(log_s)) == log_s
+		&& strlen(log_s) == PKI_TIME_LOG_SIZE + 3
+		&& log_s[4] == '-' && log_s[10] == ' ' && log_s[19] == '.'
+		&& atoi(log_s) >= 2000
+		&& PKI_TIME_now_log_s(log_s, 0) == NULL);
+
+	if (!ok) {
+		printf("     + Log timestamps ...: Failed\n");
+		return 0;
+	}
+	printf("     + Log timestamps ...: Ok\n");
+
+	printf("   - Subtest 1: Passed\n\n");
+
+	return ok;
+}
+
+int subtest2() {
+
+	PKI_THREAD *th[CLOCK_THREADS];
+	int i = 0, ok = 1;
+
+	printf("   - Subtest 2: Per-Thread Clocks\n");
+
+	for (i = 0; i < CLOCK_THREADS; i++) th[i] = PKI_THREAD_new(_clock_job, &thread_now[i]);
+	for (i = 0; i < CLOCK_THREADS; i++) {
+		if (th[i]) {
+			PKI_THREAD_join(th[i], NULL);
+			PKI_Free(th[i]);
+		} else ok = 0;
+	}
+
+	// Every thread has its own copy (not the main one)
+	for (i = 0; ok && i < CLOCK_THREADS; i++)
+		ok = (thread_now[i] != NULL && thread_now[i] != PKI_TIME_now());
+	ok = (ok && PKI_TIME_now() == PKI_TIME_now());
+
+	if (!ok) {
+		printf("     + Thread copies ...: Failed\n");
+		return 0;
+	}
+	printf("     + Thread copies ...: Ok\n");
+
+	printf("   - Subtest 2: Passed\n\n");
+
+	return ok;
+}
+
+int subtest3() {
+
+	PKI_X509_CRL_ENTRY *entry = NULL;
+	const ASN1_TIME *rev_date = NULL;
+	int day = 0, secs = 0, ok = 0;
+
+	printf("   - Subtest 3: CRL Entries\n");
+
+	// No revocation date, the current time is copied in the entry
+	if ((entry = PKI_X509_CRL_ENTRY_new_serial("12345", PKI_X509_CRL_REASON_KEY_COMPROMISE,
+			NULL, NULL, NULL)) != NULL) {
+		rev_date = X509_REVOKED_get0_revocationDate((X509_REVOKED *) entry);
+		ok = (rev_date != NULL && rev_date != PKI_TIME_now()
+			&& ASN1_TIME_diff(&day, &secs, rev_date, PKI_TIME_now())
+			&& day == 0 && secs >= 0 && secs <= 1);
+		PKI_X509_CRL_ENTRY_free(entry);
+	}
+
+	if (!ok) {
+		printf("     + Revocation date ...: Failed\n");
+		return 0;
+	}
+	printf("     + Revocation date ...: Ok\n");
+
+	printf("   - Subtest 3: Passed\n\n");
+
+	return ok;
+}
+
+static void * _clock_job(void *arg) {
+
+	const PKI_TIME **ret = arg;
+
+	*ret = PKI_TIME_now();
+
+	return NULL;
+}
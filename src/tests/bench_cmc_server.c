@@ -0,0 +1,135 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define bench_name "CMC Full PKI Request Processing"
+
+#define BENCH_MESSAGES		8
+#define BENCH_BATCH		256
+
+// ===================
+// Function Prototypes
+// ===================
+
+static double _now_ns(void);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_KEYPAIR * cakey = NULL, * key = NULL;
+	PKI_X509_CERT * cacert = NULL, * signer = NULL;
+	PKI_X509_REQ * req = NULL;
+	PKI_X509_REQ_STACK * reqs = NULL;
+	PKI_CMC_SERVER * cmc = NULL;
+	PKI_CMC_SERVER_STATS st;
+	PKI_MEM * msg = NULL, * resp = NULL;
+
+	int threads[] = { 1, 2, 4, 8 };
+	double start = 0, single_ns = 0, batch_ns = 0;
+	int i = 0, j = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Benchmark - %s\n\n", bench_name);
+
+	PKI_init_all();
+
+	if ((PKI_log_init(PKI_LOG_TYPE_STDERR, PKI_LOG_ERR, NULL,
+			PKI_LOG_FLAGS_NONE, NULL)) == PKI_ERR) {
+		fprintf(stderr, "ERROR: cannot initialize the log!\n");
+		return 1;
+	}
+
+	// CA and signer (RA) credentials
+	cakey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	key = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	if (cakey) cacert = PKI_X509_CERT_new(NULL, cakey, NULL, "CN=CMC Benchmark CA",
+		"1", 3600, NULL, NULL, NULL, NULL);
+	if (key) signer = PKI_X509_CERT_new(NULL, key, NULL, "CN=CMC Benchmark RA",
+		"1", 3600, NULL, NULL, NULL, NULL);
+
+	if ((cmc = PKI_CMC_SERVER_new()) == NULL || !cacert || !signer
+			|| PKI_CMC_SERVER_set_ca(cmc, cakey, cacert) != PKI_OK) {
+		fprintf(stderr, "ERROR: cannot create the CMC server!\n");
+		return 1;
+	}
+
+	if (key) req = PKI_X509_REQ_new(key, "CN=bench-device", NULL, NULL,
+		PKI_DIGEST_ALG_SHA256, NULL);
+	if (!req || (reqs = PKI_STACK_X509_REQ_new()) == NULL) {
+		fprintf(stderr, "ERROR: cannot generate the request!\n");
+		return 1;
+	}
+
+	// One TaggedRequest per message
+	PKI_STACK_X509_REQ_push(reqs, req);
+	if ((msg = PKI_CMC_REQUEST_new(reqs, key, signer)) == NULL) return 1;
+
+	start = _now_ns();
+	for (i = 0; i < BENCH_MESSAGES * 8; i++) {
+		if ((resp = PKI_CMC_SERVER_process(cmc, msg)) == NULL) {
+			fprintf(stderr, "ERROR: cannot process the request!\n");
+			return 1;
+		}
+		PKI_MEM_free(resp);
+	}
+	single_ns = (_now_ns() - start) / (BENCH_MESSAGES * 8);
+
+	printf("  - Single request messages ............: %.2f us, %.1f certs/s\n",
+		single_ns / 1000, 1e9 / single_ns);
+
+	// The same request in every TaggedRequest
+	PKI_MEM_free(msg);
+	for (i = 1; i < BENCH_BATCH; i++) PKI_STACK_X509_REQ_push(reqs, req);
+	if ((msg = PKI_CMC_REQUEST_new(reqs, key, signer)) == NULL) return 1;
+
+	for (j = 0; j < (int) (sizeof(threads) / sizeof(threads[0])); j++) {
+
+		PKI_CMC_SERVER_set_threads(cmc, threads[j]);
+		PKI_CMC_SERVER_reset_stats(cmc);
+
+		start = _now_ns();
+		for (i = 0; i < BENCH_MESSAGES; i++) {
+			if ((resp = PKI_CMC_SERVER_process(cmc, msg)) == NULL) {
+				fprintf(stderr, "ERROR: cannot process the request!\n");
+				return 1;
+			}
+			PKI_MEM_free(resp);
+		}
+		batch_ns = (_now_ns() - start) / (BENCH_MESSAGES * BENCH_BATCH);
+
+		PKI_CMC_SERVER_get_stats(cmc, &st);
+
+		printf("  - %d requests/message (%d threads) ....: %.2f us, %.1f certs/s (%llu/%d)\n",
+			BENCH_BATCH, threads[j], batch_ns / 1000, 1e9 / batch_ns,
+			(unsigned long long) st.issued, BENCH_MESSAGES * BENCH_BATCH);
+	}
+	printf("\n");
+
+	PKI_MEM_free(msg);
+	PKI_STACK_X509_REQ_free(reqs);
+	PKI_CMC_SERVER_free(cmc);
+	PKI_X509_REQ_free(req);
+	PKI_X509_CERT_free(signer);
+	PKI_X509_CERT_free(cacert);
+	PKI_X509_KEYPAIR_free(key);
+	PKI_X509_KEYPAIR_free(cakey);
+
+	return 0;
+}
+
+static double _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
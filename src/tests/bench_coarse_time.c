@@ -0,0 +1,86 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define bench_name "Coarse Clock and Timestamps"
+
+#define BENCH_ROUNDS		1000000
+
+// ===================
+// Function Prototypes
+// ===================
+
+static double _now_ns(void);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	ASN1_GENERALIZEDTIME * t = NULL;
+	PKI_TIME * p = NULL;
+	struct timespec ts;
+	struct tm tm;
+	char log_s[PKI_TIME_LOG_SIZE + 8];
+	char tmp_s[64];
+
+	double start = 0, adj_ns = 0, new_ns = 0, fmt_ns = 0, log_ns = 0;
+	int i = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Benchmark - %s\n\n", bench_name);
+
+	PKI_init_all();
+
+	// Current GeneralizedTime, with and without the coarse clock
+	start = _now_ns();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		if ((t = ASN1_GENERALIZEDTIME_new()) == NULL
+				|| X509_gmtime_adj(t, 0) == NULL) return 1;
+		ASN1_GENERALIZEDTIME_free(t);
+	}
+	adj_ns = (_now_ns() - start) / BENCH_ROUNDS;
+
+	start = _now_ns();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		if ((p = PKI_TIME_new(0)) == NULL) return 1;
+		PKI_TIME_free(p);
+	}
+	new_ns = (_now_ns() - start) / BENCH_ROUNDS;
+
+	// Log timestamps, formatted every time or once per second
+	start = _now_ns();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		localtime_r(&ts.tv_sec, &tm);
+		strftime(tmp_s, sizeof(tmp_s), "%Y-%m-%d %H:%M:%S", &tm);
+		snprintf(log_s, sizeof(log_s), "%s.%03ld", tmp_s, ts.tv_nsec / 1000000);
+	}
+	fmt_ns = (_now_ns() - start) / BENCH_ROUNDS;
+
+	start = _now_ns();
+	for (i = 0; i < BENCH_ROUNDS; i++) PKI_TIME_now_log_s(log_s, sizeof(log_s));
+	log_ns = (_now_ns() - start) / BENCH_ROUNDS;
+
+	printf("  - X509_gmtime_adj (new + free) .......: %.2f ns\n", adj_ns);
+	printf("  - PKI_TIME_new(0) (new + free) .......: %.2f ns\n", new_ns);
+	printf("  - Log timestamp (strftime) ...........: %.2f ns\n", fmt_ns);
+	printf("  - Log timestamp (PKI_TIME_now_log_s) .: %.2f ns\n\n", log_ns);
+
+	return 0;
+}
+
+static double _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
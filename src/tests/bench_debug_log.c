@@ -0,0 +1,136 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define bench_name "Debug Log Statements Overhead"
+#define log_name   "results/bench-debug-log.log"
+
+#define BENCH_STATEMENTS	10000000
+#define BENCH_SIGNATURES	2000
+
+// ===================
+// Function Prototypes
+// ===================
+
+static double _now_ns(void);
+static int _count_debug_statements(PKI_X509_REQ *req, PKI_X509_KEYPAIR *key);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_KEYPAIR * key = NULL;
+	PKI_X509_REQ * req = NULL;
+
+	double start = 0, legacy_ns = 0, gated_ns = 0, sign_ns = 0;
+	int i = 0, statements = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Benchmark - %s\n\n", bench_name);
+
+	PKI_init_all();
+
+	// Debug disabled (default for production)
+	if ((PKI_log_init(PKI_LOG_TYPE_STDERR, PKI_LOG_ERR, NULL,
+			PKI_LOG_FLAGS_NONE, NULL)) == PKI_ERR) {
+		fprintf(stderr, "ERROR: cannot initialize the log!\n");
+		return 1;
+	}
+
+	// Signing key and request (re-signed at every iteration)
+	key = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	if (key) req = PKI_X509_REQ_new(key, "CN=Debug Log Benchmark", NULL,
+		NULL, PKI_DIGEST_ALG_SHA256, NULL);
+	if (!key || !req) {
+		fprintf(stderr, "ERROR: cannot generate the signing key or request!\n");
+		return 1;
+	}
+
+	// Number of debug statements reached by one signature
+	if ((statements = _count_debug_statements(req, key)) < 0) {
+		fprintf(stderr, "ERROR: cannot count the debug statements!\n");
+		return 1;
+	}
+
+	// Legacy path: the varargs function is always called
+	start = _now_ns();
+	for (i = 0; i < BENCH_STATEMENTS; i++) {
+		PKI_log_debug_simple((const char *)"[%s:%d] [%s()] [DEBUG]: Iteration %d (%s)",
+			__FILE__, __LINE__, __func__, i, PKI_ID_get_txt(PKI_ID_get_by_name("sha256")));
+	}
+	legacy_ns = (_now_ns() - start) / BENCH_STATEMENTS;
+
+	// Gated path: the arguments are not evaluated
+	start = _now_ns();
+	for (i = 0; i < BENCH_STATEMENTS; i++) {
+		PKI_DEBUG("Iteration %d (%s)", i, PKI_ID_get_txt(PKI_ID_get_by_name("sha256")));
+	}
+	gated_ns = (_now_ns() - start) / BENCH_STATEMENTS;
+
+	// Signature cost (debug disabled)
+	start = _now_ns();
+	for (i = 0; i < BENCH_SIGNATURES; i++) {
+		if (PKI_X509_sign(req, NULL, key) != PKI_OK) {
+			fprintf(stderr, "ERROR: cannot generate the signature!\n");
+			return 1;
+		}
+	}
+	sign_ns = (_now_ns() - start) / BENCH_SIGNATURES;
+
+	printf("  - Debug statements per signature .....: %d\n", statements);
+	printf("  - Disabled statement (legacy) ........: %.2f ns\n", legacy_ns);
+	printf("  - Disabled statement (gated) .........: %.2f ns\n", gated_ns);
+	printf("  - Signature (RSA-2048, default) ......: %.2f us\n", sign_ns / 1000);
+	printf("  - Overhead saved per signature .......: %.2f ns (%.3f%%)\n\n",
+		(legacy_ns - gated_ns) * statements,
+		100 * (legacy_ns - gated_ns) * statements / sign_ns);
+
+	PKI_X509_REQ_free(req);
+	PKI_X509_KEYPAIR_free(key);
+
+	return 0;
+}
+
+static double _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static int _count_debug_statements(PKI_X509_REQ *req, PKI_X509_KEYPAIR *key) {
+
+	int rv = PKI_ERR;
+	FILE * fp = NULL;
+	int c = 0, lines = 0;
+
+	// Logs one signature with debug enabled
+	unlink(log_name);
+	if ((PKI_log_init(PKI_LOG_TYPE_FILE, PKI_LOG_ERR, log_name,
+			PKI_LOG_FLAGS_ENABLE_DEBUG, NULL)) == PKI_ERR) {
+		return -1;
+	}
+
+	rv = PKI_X509_sign(req, NULL, key);
+
+	PKI_log_init(PKI_LOG_TYPE_STDERR, PKI_LOG_ERR, NULL,
+		PKI_LOG_FLAGS_NONE, NULL);
+
+	if (rv != PKI_OK) return -1;
+
+	// Each statement is one line in the log
+	if ((fp = fopen(log_name, "r")) == NULL) return 0;
+	while ((c = fgetc(fp)) != EOF) if (c == '\n') lines++;
+	fclose(fp);
+
+	return lines;
+}
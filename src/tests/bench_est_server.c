@@ -0,0 +1,180 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define bench_name "EST Server Enrollment"
+
+#define BENCH_REQUESTS		64
+#define BENCH_CLIENTS		4
+#define BENCH_BATCH		256
+#define BENCH_THREADS		4
+
+// ===================
+// Function Prototypes
+// ===================
+
+static double _now_ns(void);
+static void * _client(void *arg);
+
+static PKI_EST_SERVER *est = NULL;
+static PKI_MEM *csr = NULL;
+static char est_url[64];
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_PROFILE * prof = NULL;
+	PKI_X509_KEYPAIR * cakey = NULL, * srvkey = NULL, * key = NULL;
+	PKI_X509_CERT * cacert = NULL, * srvcert = NULL, * x = NULL;
+	PKI_X509_REQ * req = NULL;
+	PKI_X509_REQ_STACK * reqs = NULL;
+	PKI_X509_CERT_STACK * sk = NULL;
+	PKI_HTTP_SERVER * http = NULL;
+	PKI_THREAD th[BENCH_CLIENTS];
+	PKI_EST_SERVER_STATS st;
+
+	double start = 0, direct_ns = 0, https_ns = 0, batch_ns = 0;
+	int i = 0, rejected = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Benchmark - %s\n\n", bench_name);
+
+	PKI_init_all();
+
+	if ((PKI_log_init(PKI_LOG_TYPE_STDERR, PKI_LOG_ERR, NULL,
+			PKI_LOG_FLAGS_NONE, NULL)) == PKI_ERR) {
+		fprintf(stderr, "ERROR: cannot initialize the log!\n");
+		return 1;
+	}
+
+	// CA and TLS server credentials
+	if ((prof = PKI_X509_PROFILE_new("ca")) != NULL)
+		PKI_X509_PROFILE_add_extension(prof, "basicConstraints", "TRUE", "CA", 1);
+	cakey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	srvkey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	if (cakey) cacert = PKI_X509_CERT_new(NULL, cakey, NULL, "CN=EST Benchmark CA",
+		"1", 3600, prof, NULL, NULL, NULL);
+	if (srvkey) srvcert = PKI_X509_CERT_new(NULL, srvkey, NULL, "CN=127.0.0.1",
+		"1", 3600, NULL, NULL, NULL, NULL);
+
+	if ((est = PKI_EST_SERVER_new()) == NULL || !cacert || !srvcert
+			|| PKI_EST_SERVER_set_ca(est, cakey, cacert, NULL) != PKI_OK
+			|| PKI_EST_SERVER_set_threads(est, BENCH_THREADS) != PKI_OK
+			|| (http = PKI_HTTP_SERVER_new("127.0.0.1", 0, BENCH_CLIENTS)) == NULL
+			|| PKI_HTTP_SERVER_set_tls(http, srvkey, srvcert, NULL, NULL) != PKI_OK
+			|| PKI_EST_SERVER_attach(est, http, NULL) != PKI_OK
+			|| PKI_HTTP_SERVER_start(http) != PKI_OK) {
+		fprintf(stderr, "ERROR: cannot create the EST server!\n");
+		return 1;
+	}
+	snprintf(est_url, sizeof(est_url), "https://127.0.0.1:%d%s/simpleenroll",
+		PKI_HTTP_SERVER_get_port(http), PKI_EST_SERVER_PATH);
+
+	// Client PKCS#10 request
+	key = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	if (key) req = PKI_X509_REQ_new(key, "CN=bench-device", NULL, NULL,
+		PKI_DIGEST_ALG_SHA256, NULL);
+	if (!req || (csr = PKI_X509_put_mem(req, PKI_DATA_FORMAT_ASN1, NULL, NULL)) == NULL
+			|| PKI_MEM_encode(csr, PKI_DATA_FORMAT_B64, 1) != PKI_OK) {
+		fprintf(stderr, "ERROR: cannot generate the request!\n");
+		return 1;
+	}
+
+	// Issuance only
+	start = _now_ns();
+	for (i = 0; i < BENCH_REQUESTS; i++) {
+		if ((x = PKI_EST_SERVER_enroll(est, req, NULL, 0)) == NULL) {
+			fprintf(stderr, "ERROR: cannot issue the certificate!\n");
+			return 1;
+		}
+		PKI_X509_CERT_free(x);
+	}
+	direct_ns = (_now_ns() - start) / BENCH_REQUESTS;
+
+	// simpleenroll over TLS (one handshake per request)
+	PKI_EST_SERVER_reset_stats(est);
+
+	start = _now_ns();
+	for (i = 0; i < BENCH_CLIENTS; i++) {
+		if (PKI_THREAD_create(&th[i], NULL, _client, NULL) != 0) {
+			fprintf(stderr, "ERROR: cannot start the client threads!\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < BENCH_CLIENTS; i++) PKI_THREAD_join(&th[i], NULL);
+	https_ns = (_now_ns() - start) / BENCH_REQUESTS;
+
+	PKI_EST_SERVER_get_stats(est, &st);
+
+	// The same request issued in batches
+	if ((reqs = PKI_STACK_X509_REQ_new()) == NULL) return 1;
+	for (i = 0; i < BENCH_BATCH; i++) PKI_STACK_X509_REQ_push(reqs, req);
+
+	start = _now_ns();
+	sk = PKI_EST_SERVER_enroll_batch(est, reqs, NULL, &rejected, NULL);
+	batch_ns = (_now_ns() - start) / BENCH_BATCH;
+
+	printf("  - Enrollment (issuance only) .........: %.2f us, %.1f certs/s\n",
+		direct_ns / 1000, 1e9 / direct_ns);
+	printf("  - simpleenroll (%d TLS clients) ......: %.2f us, %.1f certs/s (%llu/%d)\n",
+		BENCH_CLIENTS, https_ns / 1000, 1e9 / https_ns,
+		(unsigned long long) st.issued, BENCH_REQUESTS);
+	printf("  - Batch enrollment (%d threads) ......: %.2f us, %.1f certs/s (%d/%d)\n\n",
+		BENCH_THREADS, batch_ns / 1000, 1e9 / batch_ns,
+		sk ? PKI_STACK_X509_CERT_elements(sk) : 0, BENCH_BATCH);
+
+	if (sk) PKI_STACK_X509_CERT_free_all(sk);
+	PKI_STACK_X509_REQ_free(reqs);
+
+	PKI_HTTP_SERVER_free(http);
+	PKI_EST_SERVER_free(est);
+	PKI_MEM_free(csr);
+	PKI_X509_REQ_free(req);
+	PKI_X509_KEYPAIR_free(key);
+	PKI_X509_CERT_free(srvcert);
+	PKI_X509_KEYPAIR_free(srvkey);
+	PKI_X509_CERT_free(cacert);
+	PKI_X509_KEYPAIR_free(cakey);
+	if (prof) PKI_X509_PROFILE_free(prof);
+
+	return 0;
+}
+
+static double _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void * _client(void *arg) {
+
+	PKI_SSL *ssl = NULL;
+	PKI_MEM_STACK *sk = NULL;
+	int i = 0;
+
+	for (i = 0; i < BENCH_REQUESTS / BENCH_CLIENTS; i++) {
+
+		if ((ssl = PKI_SSL_new(NULL)) == NULL) break;
+		PKI_SSL_set_verify(ssl, PKI_SSL_VERIFY_NONE);
+
+		sk = NULL;
+		PKI_HTTP_POST_data(est_url, (const char *) csr->data, csr->size,
+			PKI_EST_SERVER_TYPE_CSR, 30, 0, &sk, ssl);
+
+		// The connection takes the ownership of the PKI_SSL
+		if (sk) PKI_STACK_MEM_free_all(sk);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,190 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define bench_name "PRQP Responder (precomputed responses)"
+
+#define BENCH_RESPONSES		2000
+#define BENCH_HTTP_REQS		500
+#define BENCH_SERVICES		8
+
+// ===================
+// Function Prototypes
+// ===================
+
+static double _now_ns(void);
+static PKI_MEM * _build_response(PKI_MEM *der, PKI_X509_KEYPAIR *key, PKI_X509_CERT *x);
+
+static const char *services[BENCH_SERVICES] = {
+	"ocspServer", "subjectCert", "issuerCert", "timeStamp",
+	"crlDistribution", "cmcGateway", "scepGateway", "htmlGateway"
+};
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_KEYPAIR * key = NULL;
+	PKI_X509_CERT * cacert = NULL;
+	PKI_PRQP_SERVER * prqp = NULL;
+	PKI_HTTP_SERVER * http = NULL;
+	PKI_X509_PRQP_REQ * req = NULL;
+	PKI_X509_PRQP_RESP * resp = NULL;
+	PKI_MEM * der = NULL, * out = NULL;
+	PKI_STACK * sk = NULL;
+	char url_s[128];
+
+	double start = 0, legacy_ns = 0, precomp_ns = 0, http_ns = 0;
+	int i = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Benchmark - %s\n\n", bench_name);
+
+	PKI_init_all();
+
+	if ((PKI_log_init(PKI_LOG_TYPE_STDERR, PKI_LOG_ERR, NULL,
+			PKI_LOG_FLAGS_NONE, NULL)) == PKI_ERR) {
+		fprintf(stderr, "ERROR: cannot initialize the log!\n");
+		return 1;
+	}
+
+	// Responder credentials and service map
+	key = PKI_X509_KEYPAIR_new(PKI_SCHEME_ECDSA, 128, NULL, NULL, NULL);
+	if (key) cacert = PKI_X509_CERT_new(NULL, key, NULL, "CN=PRQP Benchmark CA",
+		"1", 3600, NULL, NULL, NULL, NULL);
+	if ((prqp = PKI_PRQP_SERVER_new()) == NULL || !cacert
+			|| PKI_PRQP_SERVER_set_signer(prqp, key, cacert, NULL, NULL) != PKI_OK) {
+		fprintf(stderr, "ERROR: cannot create the PRQP responder!\n");
+		return 1;
+	}
+
+	for (i = 0; i < BENCH_SERVICES; i++) {
+		snprintf(url_s, sizeof(url_s), "http://pki.openca.org/%s", services[i]);
+		if (PKI_PRQP_SERVER_add_service(prqp, cacert, services[i], url_s) != PKI_OK) {
+			fprintf(stderr, "ERROR: cannot add the service %s!\n", services[i]);
+			return 1;
+		}
+	}
+
+	// Request for all the services of the CA
+	sk = PKI_STACK_new_null();
+	if ((req = PKI_X509_PRQP_REQ_new_certs_res(cacert, NULL, NULL, sk)) == NULL
+			|| (der = PKI_X509_PRQP_REQ_put_mem(req, PKI_DATA_FORMAT_ASN1,
+				NULL, NULL, NULL)) == NULL) {
+		fprintf(stderr, "ERROR: cannot generate the PRQP request!\n");
+		return 1;
+	}
+
+	// Legacy path: the whole response is built, encoded and signed
+	start = _now_ns();
+	for (i = 0; i < BENCH_RESPONSES; i++) {
+		if ((out = _build_response(der, key, cacert)) == NULL) {
+			fprintf(stderr, "ERROR: cannot build the response!\n");
+			return 1;
+		}
+		PKI_MEM_free(out);
+	}
+	legacy_ns = (_now_ns() - start) / BENCH_RESPONSES;
+
+	// Precomputed path: only the response data is assembled and signed
+	start = _now_ns();
+	for (i = 0; i < BENCH_RESPONSES; i++) {
+		if ((out = PKI_PRQP_SERVER_process(prqp, der)) == NULL) {
+			fprintf(stderr, "ERROR: cannot process the request!\n");
+			return 1;
+		}
+		PKI_MEM_free(out);
+	}
+	precomp_ns = (_now_ns() - start) / BENCH_RESPONSES;
+
+	// Round trips over the shared HTTP listener
+	if ((http = PKI_HTTP_SERVER_new("127.0.0.1", 0, PKI_HTTP_SERVER_WORKERS)) == NULL
+			|| PKI_PRQP_SERVER_attach(prqp, http, "/prqp") != PKI_OK
+			|| PKI_HTTP_SERVER_start(http) != PKI_OK) {
+		fprintf(stderr, "ERROR: cannot start the HTTP listener!\n");
+		return 1;
+	}
+	snprintf(url_s, sizeof(url_s), "http://127.0.0.1:%d/prqp",
+		PKI_HTTP_SERVER_get_port(http));
+
+	start = _now_ns();
+	for (i = 0; i < BENCH_HTTP_REQS; i++) {
+		if ((resp = PKI_DISCOVER_get_resp(req, url_s)) == NULL) {
+			fprintf(stderr, "ERROR: no response from the HTTP listener!\n");
+			return 1;
+		}
+		PKI_X509_PRQP_RESP_free(resp);
+	}
+	http_ns = (_now_ns() - start) / BENCH_HTTP_REQS;
+
+	printf("  - Services per response ..............: %d\n", BENCH_SERVICES);
+	printf("  - Response (built and signed) ........: %.2f us\n", legacy_ns / 1000);
+	printf("  - Response (precomputed) .............: %.2f us\n", precomp_ns / 1000);
+	printf("  - Speedup ............................: %.2fx\n", legacy_ns / precomp_ns);
+	printf("  - HTTP round trip (precomputed) ......: %.2f us\n\n", http_ns / 1000);
+
+	PKI_HTTP_SERVER_free(http);
+	PKI_PRQP_SERVER_free(prqp);
+	PKI_MEM_free(der);
+	PKI_X509_PRQP_REQ_free(req);
+	PKI_STACK_free(sk);
+	PKI_X509_CERT_free(cacert);
+	PKI_X509_KEYPAIR_free(key);
+
+	return 0;
+}
+
+static double _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static PKI_MEM * _build_response(PKI_MEM *der, PKI_X509_KEYPAIR *key, PKI_X509_CERT *x) {
+
+	PKI_X509_PRQP_REQ *req = NULL;
+	PKI_X509_PRQP_RESP *resp = NULL;
+	PKI_PRQP_RESP *val = NULL;
+	PKI_OID *oid = NULL;
+	PKI_MEM *out = NULL;
+	char url_s[128];
+	int i = 0;
+
+	if ((req = PKI_X509_PRQP_REQ_get_mem(der, PKI_DATA_FORMAT_ASN1, NULL, NULL)) == NULL)
+		return NULL;
+
+	resp = PKI_X509_PRQP_RESP_new_req(NULL, req, PKI_X509_PRQP_STATUS_OK,
+		PKI_PRQP_SERVER_VALIDITY);
+
+	for (i = 0; resp && i < BENCH_SERVICES; i++) {
+		oid = PKI_OID_get(services[i]);
+		snprintf(url_s, sizeof(url_s), "http://pki.openca.org/%s", services[i]);
+		PKI_X509_PRQP_RESP_add_service(resp, oid, url_s, 0, NULL, NULL);
+		PKI_OID_free(oid);
+	}
+
+	// Signs the response data and encodes the whole response
+	if (resp && (val = resp->value) != NULL
+			&& (val->prqpSignature = PRQP_SIGNATURE_new()) != NULL
+			&& (val->prqpSignature->signerCert = X509_dup(x->value)) != NULL
+			&& ASN1_item_sign(ASN1_ITEM_rptr(PRQP_TBS_RESP_DATA),
+				val->prqpSignature->signatureAlgorithm, NULL,
+				val->prqpSignature->signature, val->respData,
+				key->value, EVP_sha256()) > 0)
+		out = PKI_X509_PRQP_RESP_put_mem(resp, PKI_DATA_FORMAT_ASN1, NULL, NULL, NULL);
+
+	if (resp) PKI_X509_PRQP_RESP_free(resp);
+	PKI_X509_PRQP_REQ_free(req);
+
+	return out;
+}
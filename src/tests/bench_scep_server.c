@@ -0,0 +1,183 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define bench_name "SCEP Server Pipeline (PKCSReq)"
+
+#define BENCH_REQUESTS		200
+#define BENCH_THREADS		4
+
+// ===================
+// Function Prototypes
+// ===================
+
+static double _now_ns(void);
+static void * _worker(void *arg);
+
+static SCEP_STATUS _issue_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *signer,
+		SCEP_MESSAGE_TYPE type, const char *trans_id, PKI_X509_CERT **issued,
+		SCEP_FAILURE *fail, void *ctx);
+
+static const char *stages[PKI_SCEP_SERVER_STAGE_NUM] = {
+	"decode", "verify", "decrypt", "issue", "encrypt", "sign"
+};
+
+static PKI_SCEP_SERVER *scep = NULL;
+static PKI_X509_KEYPAIR *rakey = NULL;
+static PKI_X509_CERT *racert = NULL;
+static PKI_MEM *der = NULL;
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_KEYPAIR * key = NULL;
+	PKI_X509_REQ * req = NULL;
+	PKI_X509_CERT * signer = NULL;
+	PKI_X509_CERT_STACK * recipients = NULL;
+	PKI_X509_SCEP_MSG * msg = NULL;
+	PKI_SCEP_SERVER_STATS st;
+	PKI_THREAD th[BENCH_THREADS];
+	PKI_MEM * out = NULL;
+
+	double start = 0, serial_ns = 0, threaded_ns = 0;
+	int i = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Benchmark - %s\n\n", bench_name);
+
+	PKI_init_all();
+
+	if ((PKI_log_init(PKI_LOG_TYPE_STDERR, PKI_LOG_ERR, NULL,
+			PKI_LOG_FLAGS_NONE, NULL)) == PKI_ERR) {
+		fprintf(stderr, "ERROR: cannot initialize the log!\n");
+		return 1;
+	}
+
+	// RA credentials
+	rakey = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	if (rakey) racert = PKI_X509_CERT_new(NULL, rakey, NULL, "CN=SCEP Benchmark RA",
+		"1", 3600, NULL, NULL, NULL, NULL);
+	if ((scep = PKI_SCEP_SERVER_new()) == NULL || !racert
+			|| PKI_SCEP_SERVER_set_ra(scep, rakey, racert, NULL, NULL) != PKI_OK
+			|| PKI_SCEP_SERVER_set_issue_cb(scep, _issue_cb, NULL) != PKI_OK) {
+		fprintf(stderr, "ERROR: cannot create the SCEP server!\n");
+		return 1;
+	}
+
+	// Client PKCSReq
+	key = PKI_X509_KEYPAIR_new(PKI_SCHEME_RSA, 2048, NULL, NULL, NULL);
+	if (key) req = PKI_X509_REQ_new(key, "CN=bench-device", NULL, NULL,
+		PKI_DIGEST_ALG_SHA256, NULL);
+	if (req) signer = PKI_X509_CERT_new(NULL, key, req, NULL, "1", 3600,
+		NULL, NULL, NULL, NULL);
+	if (signer && (recipients = PKI_STACK_X509_CERT_new()) != NULL) {
+		PKI_STACK_X509_CERT_push(recipients, racert);
+		msg = PKI_X509_SCEP_MSG_new_certreq(key, req, signer, recipients, NULL);
+	}
+	if (!msg || (der = PKI_X509_put_mem(msg, PKI_DATA_FORMAT_ASN1, NULL, NULL)) == NULL) {
+		fprintf(stderr, "ERROR: cannot generate the SCEP request!\n");
+		return 1;
+	}
+
+	// One request at a time
+	start = _now_ns();
+	for (i = 0; i < BENCH_REQUESTS; i++) {
+		if ((out = PKI_SCEP_SERVER_process(scep, der)) == NULL) {
+			fprintf(stderr, "ERROR: cannot process the request!\n");
+			return 1;
+		}
+		PKI_MEM_free(out);
+	}
+	serial_ns = (_now_ns() - start) / BENCH_REQUESTS;
+
+	PKI_SCEP_SERVER_get_stats(scep, &st);
+
+	printf("  - Requests ...........................: %d\n", BENCH_REQUESTS);
+	printf("  - Request (one thread) ...............: %.2f us\n", serial_ns / 1000);
+	for (i = 0; i < PKI_SCEP_SERVER_STAGE_NUM; i++) {
+		printf("    . %-8s avg %10.2f us, max %10.2f us\n", stages[i],
+			st.stage_count[i] ? (double) st.stage_ns[i] / st.stage_count[i] / 1000 : 0,
+			(double) st.stage_max_ns[i] / 1000);
+	}
+
+	// Same requests split across the worker threads
+	PKI_SCEP_SERVER_reset_stats(scep);
+
+	start = _now_ns();
+	for (i = 0; i < BENCH_THREADS; i++) {
+		if (PKI_THREAD_create(&th[i], NULL, _worker, NULL) != 0) {
+			fprintf(stderr, "ERROR: cannot start the worker threads!\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < BENCH_THREADS; i++) PKI_THREAD_join(&th[i], NULL);
+	threaded_ns = (_now_ns() - start) / BENCH_REQUESTS;
+
+	PKI_SCEP_SERVER_get_stats(scep, &st);
+
+	printf("  - Request (%d threads) ................: %.2f us\n",
+		BENCH_THREADS, threaded_ns / 1000);
+	printf("  - Throughput (%d threads) .............: %.1f req/s\n",
+		BENCH_THREADS, 1e9 / threaded_ns);
+	printf("  - Successful CertReps ................: %llu/%d\n\n",
+		(unsigned long long) st.success, BENCH_REQUESTS);
+
+	PKI_SCEP_SERVER_free(scep);
+	PKI_MEM_free(der);
+	PKI_X509_SCEP_MSG_free(msg);
+	PKI_STACK_X509_CERT_free(recipients);
+	PKI_X509_CERT_free(signer);
+	PKI_X509_REQ_free(req);
+	PKI_X509_KEYPAIR_free(key);
+	PKI_X509_CERT_free(racert);
+	PKI_X509_KEYPAIR_free(rakey);
+
+	return 0;
+}
+
+static double _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static void * _worker(void *arg) {
+
+	PKI_MEM *out = NULL;
+	int i = 0;
+
+	for (i = 0; i < BENCH_REQUESTS / BENCH_THREADS; i++) {
+		if ((out = PKI_SCEP_SERVER_process(scep, der)) != NULL) PKI_MEM_free(out);
+	}
+
+	return NULL;
+}
+
+static SCEP_STATUS _issue_cb(const PKI_X509_REQ *req, const PKI_X509_CERT *signer,
+		SCEP_MESSAGE_TYPE type, const char *trans_id, PKI_X509_CERT **issued,
+		SCEP_FAILURE *fail, void *ctx) {
+
+	static int serial = 1;
+	char serial_s[16];
+
+	if (!req) return SCEP_STATUS_FAILURE;
+
+	snprintf(serial_s, sizeof(serial_s), "%d",
+		__atomic_add_fetch(&serial, 1, __ATOMIC_RELAXED));
+
+	if ((*issued = PKI_X509_CERT_new(racert, rakey, req, NULL, serial_s,
+			3600, NULL, NULL, NULL, NULL)) == NULL) return SCEP_STATUS_FAILURE;
+
+	return SCEP_STATUS_SUCCESS;
+}
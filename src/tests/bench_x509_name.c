@@ -0,0 +1,118 @@
+#include <libpki/pki.h>
+
+// ==============
+// Global Defines
+// ==============
+
+#define bench_name "X509 Name Parsing and Comparison"
+
+#define BENCH_NAMES		256
+#define BENCH_ROUNDS		200
+#define BENCH_LONG_RDNS		4000
+
+// ===================
+// Function Prototypes
+// ===================
+
+static double _now_ns(void);
+
+// ====
+// Main
+// ====
+
+int main (int argc, char *argv[] ) {
+
+	PKI_X509_NAME * names[BENCH_NAMES];
+	PKI_X509_NAME * name = NULL;
+	const PKI_X509_NAME_REF * refs[BENCH_NAMES];
+	PKI_MEM * dn = NULL;
+	char name_s[128];
+
+	double start = 0, parse_ns = 0, cmp_ns = 0, ref_ns = 0, intern_ns = 0;
+	int i = 0, j = 0, k = 0, eq_cmp = 0, eq_ref = 0;
+
+	// Changes the current directory to be the working
+	// main directory to make sure all file paths are correct
+	chdir("../..");
+
+	printf("\n\nlibpki Benchmark - %s\n\n", bench_name);
+
+	PKI_init_all();
+
+	if ((PKI_log_init(PKI_LOG_TYPE_STDERR, PKI_LOG_ERR, NULL,
+			PKI_LOG_FLAGS_NONE, NULL)) == PKI_ERR) {
+		fprintf(stderr, "ERROR: cannot initialize the log!\n");
+		return 1;
+	}
+
+	// Long DN (quadratic with the old parser)
+	if ((dn = PKI_MEM_new_null()) == NULL) return 1;
+	for (i = 0; i < BENCH_LONG_RDNS; i++) {
+		snprintf(name_s, sizeof(name_s), "%sOU=organizational-unit-%d", i ? ", " : "", i);
+		PKI_MEM_add(dn, (unsigned char *) name_s, strlen(name_s));
+	}
+	PKI_MEM_add(dn, (unsigned char *) "", 1);
+
+	start = _now_ns();
+	if ((name = PKI_X509_NAME_new((char *) dn->data)) == NULL) {
+		fprintf(stderr, "ERROR: cannot parse the long name!\n");
+		return 1;
+	}
+	parse_ns = _now_ns() - start;
+	PKI_X509_NAME_free(name);
+	PKI_MEM_free(dn);
+
+	// Issuer-like names (half of them equal to another one)
+	for (i = 0; i < BENCH_NAMES; i++) {
+		snprintf(name_s, sizeof(name_s), "CN=Issuing CA %d, OU=Certification Services, "
+			"O=OpenCA Labs, L=New York, C=US", i % (BENCH_NAMES / 2));
+		if ((names[i] = PKI_X509_NAME_new(name_s)) == NULL) return 1;
+	}
+
+	// Interning (first time)
+	start = _now_ns();
+	for (i = 0; i < BENCH_NAMES; i++) refs[i] = PKI_X509_NAME_intern(names[i]);
+	intern_ns = (_now_ns() - start) / BENCH_NAMES;
+
+	// All the pairs
+	start = _now_ns();
+	for (k = 0; k < BENCH_ROUNDS; k++) {
+		for (i = 0; i < BENCH_NAMES; i++) {
+			for (j = 0; j < BENCH_NAMES; j++)
+				if (PKI_X509_NAME_cmp(names[i], names[j]) == 0) eq_cmp++;
+		}
+	}
+	cmp_ns = (_now_ns() - start) / ((double) BENCH_ROUNDS * BENCH_NAMES * BENCH_NAMES);
+
+	start = _now_ns();
+	for (k = 0; k < BENCH_ROUNDS; k++) {
+		for (i = 0; i < BENCH_NAMES; i++) {
+			for (j = 0; j < BENCH_NAMES; j++)
+				if (PKI_X509_NAME_REF_cmp(refs[i], refs[j]) == 0) eq_ref++;
+		}
+	}
+	ref_ns = (_now_ns() - start) / ((double) BENCH_ROUNDS * BENCH_NAMES * BENCH_NAMES);
+
+	printf("  - Parsing (%d RDNs) .................: %.2f ms\n",
+		BENCH_LONG_RDNS, parse_ns / 1e6);
+	printf("  - Interning (new names) ..............: %.2f us/name\n",
+		intern_ns / 1000);
+	printf("  - PKI_X509_NAME_cmp ..................: %.2f ns/cmp (%d equal)\n",
+		cmp_ns, eq_cmp);
+	printf("  - PKI_X509_NAME_REF_cmp ..............: %.2f ns/cmp (%d equal)\n\n",
+		ref_ns, eq_ref);
+
+	for (i = 0; i < BENCH_NAMES; i++) PKI_X509_NAME_free(names[i]);
+	PKI_X509_NAME_intern_flush();
+
+	return 0;
+}
+
+static double _now_ns(void) {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
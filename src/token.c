@@ -552,7 +552,7 @@ int PKI_TOKEN_free( PKI_TOKEN *tk )
 
 	if (tk->algor)
 	{
-		X509_ALGOR_free(tk->algor);
+		PKI_X509_ALGOR_VALUE_free(tk->algor);
 		tk->algor = NULL;
 	}
 
@@ -1561,7 +1561,7 @@ int PKI_TOKEN_new_keypair_url_ex ( PKI_TOKEN *tk, PKI_KEYPARAMS *kp,
 
 	if (free_params && kp) PKI_KEYPARAMS_free(kp);
 
-	if (tk->algor) X509_ALGOR_free(tk->algor);
+	if (tk->algor) PKI_X509_ALGOR_VALUE_free(tk->algor);
 	tk->algor = PKI_X509_KEYPAIR_get_algor(tk->keypair, tk->digest);
 
 	return PKI_OK;
@@ -0,0 +1,574 @@
+/* TOKEN Handle (hot-reloadable tokens) Management Functions */
+
+#include <libpki/pki.h>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sched.h>
+
+// ==================
+// Internal Structures
+// ==================
+
+// File the token was loaded from (config, profiles, keys, certs)
+typedef struct pki_token_handle_file_st {
+	char * path;
+	int present;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	long mtime_ns;
+	time_t ctime;
+	long ctime_ns;
+} PKI_TOKEN_HANDLE_FILE;
+
+struct pki_token_snapshot_st {
+	/*! Token (never modified after publication) */
+	PKI_TOKEN * token;
+
+	/*! References (the handle holds one while current) */
+	unsigned long refs;
+
+	/*! Reload counter value when published */
+	unsigned long generation;
+
+	/*! Files (and their status) the token was built from */
+	PKI_TOKEN_HANDLE_FILE * files;
+	int files_num;
+};
+
+struct pki_token_handle_st {
+	/*! Token configuration (directory and name) */
+	char * config_dir;
+	char * name;
+
+	/*! Setup executed on every new token */
+	PKI_TOKEN_HANDLE_SETUP_CB setup_cb;
+	void * setup_arg;
+
+	/*! Published snapshot */
+	PKI_TOKEN_SNAPSHOT * current;
+
+	/*! Readers in the current (and previous) epoch */
+	unsigned long epoch;
+	unsigned long readers[2];
+
+	/*! Number of published snapshots */
+	unsigned long generation;
+
+	/*! Serializes reloads (readers never take it) */
+	PKI_MUTEX reload_lock;
+
+	/*! Background reload */
+	PKI_THREAD * watcher;
+	int watch_interval;
+	int watch_stop;
+};
+
+// =================
+// Static Functions
+// =================
+
+static void _file_stat(PKI_TOKEN_HANDLE_FILE * f) {
+
+	struct stat st;
+
+	if (stat(f->path, &st) != 0) {
+		f->present = 0;
+		return;
+	}
+
+	f->present = 1;
+	f->dev = st.st_dev;
+	f->ino = st.st_ino;
+	f->size = st.st_size;
+	f->mtime = st.st_mtime;
+	f->ctime = st.st_ctime;
+
+	// Same-size rewrites within the same second change the nanoseconds
+#ifdef LIBPKI_TARGET_OSX
+	f->mtime_ns = st.st_mtimespec.tv_nsec;
+	f->ctime_ns = st.st_ctimespec.tv_nsec;
+#else
+	f->mtime_ns = st.st_mtim.tv_nsec;
+	f->ctime_ns = st.st_ctim.tv_nsec;
+#endif
+}
+
+static int _file_changed(const PKI_TOKEN_HANDLE_FILE * f) {
+
+	PKI_TOKEN_HANDLE_FILE cur;
+
+	memset(&cur, 0, sizeof(cur));
+	cur.path = f->path;
+	_file_stat(&cur);
+
+	if (cur.present != f->present) return 1;
+	if (!cur.present) return 0;
+
+	return (cur.dev != f->dev || cur.ino != f->ino || cur.size != f->size
+		|| cur.mtime != f->mtime || cur.mtime_ns != f->mtime_ns
+		|| cur.ctime != f->ctime || cur.ctime_ns != f->ctime_ns);
+}
+
+static void _snapshot_add_file(PKI_TOKEN_SNAPSHOT * s, const char * path, int * size) {
+
+	PKI_TOKEN_HANDLE_FILE * tmp = NULL;
+	PKI_TOKEN_HANDLE_FILE * f = NULL;
+
+	if (!path || !*path) return;
+
+	if (s->files_num == *size) {
+		*size = *size ? *size * 2 : 8;
+		if ((tmp = realloc(s->files, (size_t) *size * sizeof(PKI_TOKEN_HANDLE_FILE))) == NULL) {
+			PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+			return;
+		}
+		s->files = tmp;
+	}
+
+	f = &s->files[s->files_num];
+	memset(f, 0, sizeof(PKI_TOKEN_HANDLE_FILE));
+	if ((f->path = strdup(path)) == NULL) return;
+
+	_file_stat(f);
+	s->files_num++;
+}
+
+static void _snapshot_add_url(PKI_TOKEN_SNAPSHOT * s, const char * url_s, int * size) {
+
+	URL * url = NULL;
+
+	if (!url_s) return;
+
+	// Only local files can be checked for changes
+	if ((url = URL_new(url_s)) != NULL) {
+		if (url->proto == URI_PROTO_FILE) _snapshot_add_file(s, url->addr, size);
+		URL_free(url);
+	}
+}
+
+// Records the files used by the snapshot's token
+static void _snapshot_files(PKI_TOKEN_SNAPSHOT * s) {
+
+	char buff[BUFF_MAX_SIZE];
+	struct dirent * dd = NULL;
+	DIR * dirp = NULL;
+
+	PKI_TOKEN * tk = s->token;
+	int size = 0;
+
+	if (tk->config && tk->config->URL)
+		_snapshot_add_file(s, (const char *) tk->config->URL, &size);
+
+	if (!tk->config_dir) return;
+
+	snprintf(buff, sizeof(buff), "%s/%s", tk->config_dir, PKI_DEFAULT_CONF_OID_FILE);
+	_snapshot_add_file(s, buff, &size);
+
+	// The profiles directory catches added and removed profiles
+	snprintf(buff, sizeof(buff), "%s/%s", tk->config_dir, PKI_DEFAULT_PROFILE_DIR);
+	_snapshot_add_file(s, buff, &size);
+
+	if ((dirp = opendir(buff)) != NULL) {
+
+		size_t dir_len = strlen(buff);
+
+		while ((dd = readdir(dirp)) != NULL) {
+
+			char fullpath[BUFF_MAX_SIZE];
+			size_t len = strlen(dd->d_name);
+
+			if (len < 4 || strcmp(".xml", dd->d_name + len - 4) != 0) continue;
+
+			// Skips paths that do not fit
+			if (dir_len + len + 2 > sizeof(fullpath)) continue;
+			memcpy(fullpath, buff, dir_len);
+			fullpath[dir_len] = '/';
+			memcpy(fullpath + dir_len + 1, dd->d_name, len + 1);
+
+			_snapshot_add_file(s, fullpath, &size);
+		}
+		closedir(dirp);
+	}
+
+	_snapshot_add_url(s, tk->key_id, &size);
+	_snapshot_add_url(s, tk->cert_id, &size);
+	_snapshot_add_url(s, tk->cacert_id, &size);
+}
+
+static void _snapshot_free(PKI_TOKEN_SNAPSHOT * s) {
+
+	int i = 0;
+
+	if (!s) return;
+
+	for (i = 0; i < s->files_num; i++) PKI_Free(s->files[i].path);
+	if (s->files) PKI_Free(s->files);
+
+	if (s->token) PKI_TOKEN_free(s->token);
+
+	PKI_Free(s);
+}
+
+// Builds a new token from the current configuration
+static PKI_TOKEN_SNAPSHOT * _snapshot_build(PKI_TOKEN_HANDLE * h) {
+
+	PKI_TOKEN_SNAPSHOT * s = NULL;
+	PKI_TOKEN * tk = NULL;
+
+	if ((tk = PKI_TOKEN_new_null()) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	if (PKI_TOKEN_init(tk, h->config_dir, h->name) != PKI_OK) {
+		PKI_ERROR(PKI_ERR_TOKEN_INIT, h->name);
+		PKI_TOKEN_free(tk);
+		return NULL;
+	}
+
+	// By default, loads the keypair before publishing
+	if (h->setup_cb) {
+		if (h->setup_cb(tk, h->setup_arg) != PKI_OK) {
+			PKI_ERROR(PKI_ERR_TOKEN_INIT, "Setup callback failed (%s)", h->name);
+			PKI_TOKEN_free(tk);
+			return NULL;
+		}
+	} else if (PKI_TOKEN_login(tk) != PKI_OK) {
+		PKI_TOKEN_free(tk);
+		return NULL;
+	}
+
+	if ((s = PKI_Malloc(sizeof(PKI_TOKEN_SNAPSHOT))) == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		PKI_TOKEN_free(tk);
+		return NULL;
+	}
+
+	s->token = tk;
+	s->refs = 1;
+
+	_snapshot_files(s);
+
+	return s;
+}
+
+// Snapshots outlive the request that triggers the reload (not from
+// the caller's arena)
+static PKI_TOKEN_SNAPSHOT * _snapshot_new(PKI_TOKEN_HANDLE * h) {
+
+	PKI_TOKEN_SNAPSHOT * ret = NULL;
+	PKI_ARENA * arena = NULL;
+
+	arena = PKI_ARENA_suspend();
+	ret = _snapshot_build(h);
+	PKI_ARENA_resume(arena);
+
+	return ret;
+}
+
+// Publishes the snapshot and releases the previous one (reload lock held)
+static void _handle_publish(PKI_TOKEN_HANDLE * h, PKI_TOKEN_SNAPSHOT * s) {
+
+	PKI_TOKEN_SNAPSHOT * old = NULL;
+	unsigned long e = 0;
+
+	if (s) s->generation = __atomic_add_fetch(&h->generation, 1, __ATOMIC_RELEASE);
+
+	old = __atomic_exchange_n(&h->current, s, __ATOMIC_SEQ_CST);
+
+	// Waits for the readers that might still be taking a reference to
+	// the old snapshot (a few instructions), new readers get the new one.
+	// Readers announced in the previous epoch were drained by the
+	// previous publish (publishes are serialized by the reload lock), and
+	// late ones retry after seeing the epoch change.
+	e = __atomic_fetch_add(&h->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+	while (__atomic_load_n(&h->readers[e], __ATOMIC_SEQ_CST) != 0) sched_yield();
+
+	// In-flight operations keep the old token until they release it
+	if (old) PKI_TOKEN_SNAPSHOT_release(old);
+}
+
+// Reloads the token if forced or if any of its files changed (reload lock held)
+static int _handle_reload(PKI_TOKEN_HANDLE * h, int force) {
+
+	PKI_TOKEN_SNAPSHOT * cur = h->current;
+	PKI_TOKEN_SNAPSHOT * s = NULL;
+	int i = 0;
+
+	if (!force && cur) {
+		for (i = 0; i < cur->files_num; i++) {
+			if (_file_changed(&cur->files[i])) break;
+		}
+		if (i == cur->files_num) return PKI_OK;
+
+		PKI_DEBUG("Token %s: %s changed, reloading", h->name, cur->files[i].path);
+	}
+
+	// On failure, the current token keeps being used
+	if ((s = _snapshot_new(h)) == NULL) return PKI_ERR;
+
+	_handle_publish(h, s);
+
+	return PKI_OK;
+}
+
+static void * _handle_watch(void * arg) {
+
+	PKI_TOKEN_HANDLE * h = (PKI_TOKEN_HANDLE *) arg;
+	struct timespec ts;
+	int elapsed = 0;
+
+	// Sleeps in short steps to react quickly to a stop request
+	ts.tv_sec = 0;
+	ts.tv_nsec = 10 * 1000000;
+
+	while (!__atomic_load_n(&h->watch_stop, __ATOMIC_ACQUIRE)) {
+
+		nanosleep(&ts, NULL);
+		if ((elapsed += 10) < h->watch_interval) continue;
+		elapsed = 0;
+
+		PKI_TOKEN_HANDLE_refresh(h);
+	}
+
+	return NULL;
+}
+
+// =================
+// Public Functions
+// =================
+
+/*!
+ * \brief Returns a new handle for the token 'name' in 'config_dir'
+ *
+ * The token is loaded, and the setup callback (if any) is executed on
+ * it, before the handle is returned. Without a callback, the token is
+ * logged in (i.e., the keypair is loaded). The same setup is repeated
+ * on every reload, therefore interactive credentials callbacks should
+ * not be used with the background reload.
+ */
+
+PKI_TOKEN_HANDLE * PKI_TOKEN_HANDLE_new(const char * const config_dir,
+					const char * const name,
+					PKI_TOKEN_HANDLE_SETUP_CB setup_cb,
+					void * setup_arg) {
+
+	PKI_TOKEN_HANDLE * h = NULL;
+	PKI_TOKEN_SNAPSHOT * s = NULL;
+	PKI_ARENA * arena = NULL;
+
+	if (!name) {
+		PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+		return NULL;
+	}
+
+	// The handle is shared by the requests (not from the caller's arena)
+	arena = PKI_ARENA_suspend();
+	h = PKI_Malloc(sizeof(PKI_TOKEN_HANDLE));
+	PKI_ARENA_resume(arena);
+
+	if (h == NULL) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		return NULL;
+	}
+
+	h->name = strdup(name);
+	if (config_dir) h->config_dir = strdup(config_dir);
+	h->setup_cb = setup_cb;
+	h->setup_arg = setup_arg;
+
+	PKI_MUTEX_init(&h->reload_lock);
+
+	if (!h->name || (config_dir && !h->config_dir)) {
+		PKI_ERROR(PKI_ERR_MEMORY_ALLOC, NULL);
+		PKI_TOKEN_HANDLE_free(h);
+		return NULL;
+	}
+
+	if ((s = _snapshot_new(h)) == NULL) {
+		PKI_TOKEN_HANDLE_free(h);
+		return NULL;
+	}
+
+	_handle_publish(h, s);
+
+	return h;
+}
+
+/*!
+ * \brief Frees the handle (stops the background reload, if running)
+ *
+ * Snapshots still acquired remain valid until they are released.
+ */
+
+void PKI_TOKEN_HANDLE_free(PKI_TOKEN_HANDLE *h) {
+
+	if (!h) return;
+
+	PKI_TOKEN_HANDLE_watch_stop(h);
+
+	PKI_MUTEX_acquire(&h->reload_lock);
+	_handle_publish(h, NULL);
+	PKI_MUTEX_release(&h->reload_lock);
+
+	PKI_MUTEX_destroy(&h->reload_lock);
+
+	if (h->config_dir) PKI_Free(h->config_dir);
+	if (h->name) PKI_Free(h->name);
+
+	PKI_Free(h);
+}
+
+/*!
+ * \brief Loads a new token and swaps it in
+ *
+ * Readers are never blocked. If the new token can not be loaded, the
+ * current one stays in use and PKI_ERR is returned.
+ */
+
+int PKI_TOKEN_HANDLE_reload(PKI_TOKEN_HANDLE *h) {
+
+	int ret = PKI_ERR;
+
+	if (!h) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	PKI_MUTEX_acquire(&h->reload_lock);
+	ret = _handle_reload(h, 1);
+	PKI_MUTEX_release(&h->reload_lock);
+
+	return ret;
+}
+
+/*!
+ * \brief Reloads the token if its configuration, profiles, OIDs, key,
+ *        certificate, or CA certificate files changed
+ *
+ * Returns PKI_OK if the token is up to date (or it was reloaded), and
+ * PKI_ERR if the reload failed (the current token stays in use).
+ */
+
+int PKI_TOKEN_HANDLE_refresh(PKI_TOKEN_HANDLE *h) {
+
+	int ret = PKI_ERR;
+
+	if (!h) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	PKI_MUTEX_acquire(&h->reload_lock);
+	ret = _handle_reload(h, 0);
+	PKI_MUTEX_release(&h->reload_lock);
+
+	return ret;
+}
+
+/*!
+ * \brief Starts a thread that refreshes the token every 'interval_ms'
+ *        milliseconds (PKI_TOKEN_HANDLE_WATCH_INTERVAL if <= 0)
+ */
+
+int PKI_TOKEN_HANDLE_watch_start(PKI_TOKEN_HANDLE *h, int interval_ms) {
+
+	if (!h) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (h->watcher) PKI_TOKEN_HANDLE_watch_stop(h);
+
+	h->watch_interval = interval_ms > 0 ? interval_ms : PKI_TOKEN_HANDLE_WATCH_INTERVAL;
+	__atomic_store_n(&h->watch_stop, 0, __ATOMIC_RELEASE);
+
+	if ((h->watcher = PKI_THREAD_new(_handle_watch, h)) == NULL) {
+		return PKI_ERROR(PKI_ERR_GENERAL, "Can not start the token watcher");
+	}
+
+	return PKI_OK;
+}
+
+/*! \brief Stops the background reload thread */
+
+int PKI_TOKEN_HANDLE_watch_stop(PKI_TOKEN_HANDLE *h) {
+
+	if (!h) return PKI_ERROR(PKI_ERR_PARAM_NULL, NULL);
+
+	if (!h->watcher) return PKI_OK;
+
+	__atomic_store_n(&h->watch_stop, 1, __ATOMIC_RELEASE);
+
+	PKI_THREAD_join(h->watcher, NULL);
+	PKI_Free(h->watcher);
+	h->watcher = NULL;
+
+	return PKI_OK;
+}
+
+/*! \brief Returns the number of tokens published by the handle */
+
+unsigned long PKI_TOKEN_HANDLE_get_generation(const PKI_TOKEN_HANDLE *h) {
+
+	if (!h) return 0;
+
+	return __atomic_load_n(&h->generation, __ATOMIC_ACQUIRE);
+}
+
+/*!
+ * \brief Returns a reference to the current token snapshot
+ *
+ * This function does not take any lock. The snapshot (and its token)
+ * stays valid until PKI_TOKEN_SNAPSHOT_release() is called, even if
+ * the handle is reloaded in the meantime.
+ */
+
+PKI_TOKEN_SNAPSHOT * PKI_TOKEN_HANDLE_acquire(PKI_TOKEN_HANDLE *h) {
+
+	PKI_TOKEN_SNAPSHOT * s = NULL;
+	unsigned long e = 0;
+
+	if (!h) return NULL;
+
+	// Announces the reader in the current epoch, the publisher waits
+	// for it before releasing the snapshot we are about to reference.
+	// If the epoch changed before we were counted, a publish might have
+	// already drained that counter: we retry in the new epoch.
+	for (;;) {
+		e = __atomic_load_n(&h->epoch, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&h->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+
+		if (__atomic_load_n(&h->epoch, __ATOMIC_SEQ_CST) == e) break;
+
+		__atomic_sub_fetch(&h->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+	}
+
+	if ((s = __atomic_load_n(&h->current, __ATOMIC_SEQ_CST)) != NULL)
+		__atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+
+	__atomic_sub_fetch(&h->readers[e & 1], 1, __ATOMIC_SEQ_CST);
+
+	return s;
+}
+
+/*! \brief Releases a snapshot (the last reference frees the token) */
+
+void PKI_TOKEN_SNAPSHOT_release(PKI_TOKEN_SNAPSHOT *s) {
+
+	if (!s) return;
+
+	if (__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) == 0) _snapshot_free(s);
+}
+
+/*! \brief Returns the token of the snapshot */
+
+PKI_TOKEN * PKI_TOKEN_SNAPSHOT_get_token(const PKI_TOKEN_SNAPSHOT *s) {
+
+	if (!s) return NULL;
+
+	return s->token;
+}
+
+/*! \brief Returns the generation (reload number) of the snapshot */
+
+unsigned long PKI_TOKEN_SNAPSHOT_get_generation(const PKI_TOKEN_SNAPSHOT *s) {
+
+	if (!s) return 0;
+
+	return s->generation;
+}